@@ -4,14 +4,82 @@
 #include <string.h>
 
 #include "compressed_archive_builder.h"
+#include "dictionary.h"
 #include "path_utils.h"
 #include "types.h"
 
+// Общая часть создания архива и дозаписи в него; построитель
+// уничтожается здесь
+static Result add_input_and_finalize(CompressedArchiveBuilder* builder,
+                                     const char* input_path, bool dedup,
+                                     Size solid_block_size,
+                                     const char* dictionary_path,
+                                     Stats* stats)
+{
+  if (dedup && compressed_archive_builder_set_dedup(builder, true) != RESULT_OK)
+  {
+    printf("Предупреждение: не удалось включить дедупликацию\n");
+  }
+
+  if (compressed_archive_builder_set_solid_block_size(
+        builder, solid_block_size) != RESULT_OK)
+  {
+    printf("Предупреждение: недопустимый размер сплошного блока %zu\n",
+           solid_block_size);
+  }
+
+  // Словарь должен жить до завершения построения архива
+  Dictionary* dictionary = NULL;
+  if (dictionary_path != NULL)
+  {
+    dictionary = dictionary_load(dictionary_path);
+    if (dictionary == NULL)
+    {
+      printf("Произошла ошибка при загрузке словаря: %s\n", dictionary_path);
+      compressed_archive_builder_destroy(builder);
+      return RESULT_IO_ERROR;
+    }
+    compressed_archive_builder_set_dictionary(builder, dictionary);
+  }
+
+  compressed_archive_builder_set_stats(builder, stats);
+
+  Result result;
+  if (path_utils_is_directory(input_path))
+  {
+    printf("Добавление директории: %s\n", input_path);
+    result = compressed_archive_builder_add_directory(builder, input_path);
+  }
+  else
+  {
+    printf("Добавление файла: %s\n", input_path);
+    result = compressed_archive_builder_add_file(builder, input_path);
+  }
+
+  if (result != RESULT_OK)
+  {
+    printf("Произошла ошибка при добавлении файлов в архив!\n");
+    compressed_archive_builder_destroy(builder);
+    dictionary_destroy(dictionary);
+    return result;
+  }
+
+  result = compressed_archive_builder_finalize(builder);
+  compressed_archive_builder_destroy(builder);
+  dictionary_destroy(dictionary);
+
+  return result;
+}
+
 Result compressed_archive_encode_extended(const char* input_path,
                                           const char* output_filename,
                                           const char* algorithm,
                                           const char* secondary_algorithm,
-                                          bool two_staged)
+                                          bool two_staged, int level,
+                                          bool dedup, Size solid_block_size,
+                                          bool align, QWord volume_size,
+                                          const char* dictionary_path,
+                                          Stats* stats)
 {
   if (input_path == NULL || output_filename == NULL)
   {
@@ -60,28 +128,30 @@ Result compressed_archive_encode_extended(const char* input_path,
     }
   }
 
-  Result result;
-  if (path_utils_is_directory(input_path))
+  if (level != 0 &&
+      compressed_archive_builder_set_level(builder, level) != RESULT_OK)
   {
-    printf("Добавление директории: %s\n", input_path);
-    result = compressed_archive_builder_add_directory(builder, input_path);
+    printf("Предупреждение: недопустимый уровень сжатия %d (допустимо %d-%d)\n",
+           level, COMPRESSED_ARCHIVE_LEVEL_MIN, COMPRESSED_ARCHIVE_LEVEL_MAX);
   }
-  else
+
+  if (align &&
+      compressed_archive_builder_set_alignment(builder, true) != RESULT_OK)
   {
-    printf("Добавление файла: %s\n", input_path);
-    result = compressed_archive_builder_add_file(builder, input_path);
+    printf("Предупреждение: не удалось включить выравнивание\n");
   }
 
-  if (result != RESULT_OK)
+  if (volume_size > 0 &&
+      compressed_archive_builder_set_volume_size(builder, volume_size) !=
+        RESULT_OK)
   {
-    printf("Произошла ошибка при добавлении файлов в архив!\n");
+    printf("Произошла ошибка при разбиении архива на тома!\n");
     compressed_archive_builder_destroy(builder);
-    return result;
+    return RESULT_ERROR;
   }
 
-  result = compressed_archive_builder_finalize(builder);
-  compressed_archive_builder_destroy(builder);
-
+  Result result = add_input_and_finalize(
+    builder, input_path, dedup, solid_block_size, dictionary_path, stats);
   if (result == RESULT_OK)
   {
     printf("Сжатый архив успешно создан: %s\n", output_filename);
@@ -98,5 +168,40 @@ Result compressed_archive_encode(const char* input_path,
                                  const char* output_filename)
 {
   return compressed_archive_encode_extended(input_path, output_filename, NULL,
-                                            NULL, false);
+                                            NULL, false, 0, false, 0, false,
+                                            0, NULL, NULL);
+}
+
+Result compressed_archive_append(const char* input_path,
+                                 const char* archive_filename, bool dedup,
+                                 Size solid_block_size,
+                                 const char* dictionary_path, Stats* stats)
+{
+  if (input_path == NULL || archive_filename == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  printf("Дозапись в сжатый архив: %s -> %s\n", input_path, archive_filename);
+
+  CompressedArchiveBuilder* builder =
+    compressed_archive_builder_open_append(archive_filename);
+  if (builder == NULL)
+  {
+    printf("Произошла ошибка при открытии архива для дозаписи!\n");
+    return RESULT_IO_ERROR;
+  }
+
+  Result result = add_input_and_finalize(
+    builder, input_path, dedup, solid_block_size, dictionary_path, stats);
+  if (result == RESULT_OK)
+  {
+    printf("Дозапись в архив завершена: %s\n", archive_filename);
+  }
+  else
+  {
+    printf("Произошла ошибка при дозаписи в архив!\n");
+  }
+
+  return result;
 }
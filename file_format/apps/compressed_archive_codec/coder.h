@@ -1,6 +1,7 @@
 #ifndef COMPRESSED_ARCHIVE_CODEC_CODER_H
 #define COMPRESSED_ARCHIVE_CODEC_CODER_H
 
+#include "stats.h"
 #include "types.h"
 
 Result compressed_archive_encode(const char* input_path,
@@ -9,6 +10,15 @@ Result compressed_archive_encode_extended(const char* input_path,
                                           const char* output_filename,
                                           const char* algorithm,
                                           const char* secondary_algorithm,
-                                          bool two_staged);
+                                          bool two_staged, int level,
+                                          bool dedup, Size solid_block_size,
+                                          bool align, QWord volume_size,
+                                          const char* dictionary_path,
+                                          Stats* stats);
+// Добавляет в архив новые и измененные файлы, сжимая их моделями архива
+Result compressed_archive_append(const char* input_path,
+                                 const char* archive_filename, bool dedup,
+                                 Size solid_block_size,
+                                 const char* dictionary_path, Stats* stats);
 
 #endif  // COMPRESSED_ARCHIVE_CODEC_CODER_H
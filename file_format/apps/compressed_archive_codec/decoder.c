@@ -3,10 +3,12 @@
 #include <stdio.h>
 
 #include "compressed_archive_reader.h"
+#include "dictionary.h"
 #include "types.h"
 
 Result compressed_archive_decode(const char* input_filename,
-                                 const char* output_path)
+                                 const char* output_path,
+                                 const char* dictionary_path, Stats* stats)
 {
   if (input_filename == NULL || output_path == NULL)
   {
@@ -15,16 +17,41 @@ Result compressed_archive_decode(const char* input_filename,
 
   printf("Извлечение сжатого архива: %s -> %s\n", input_filename, output_path);
 
+  // Открытие читает заголовок, таблицу файлов и модели
+  StatsSpan span;
+  stats_span_begin(stats, &span, STATS_STAGE_READ, "open");
   CompressedArchiveReader* reader =
     compressed_archive_reader_create(input_filename);
+  stats_span_end(stats, &span, 0, 0);
   if (reader == NULL)
   {
     printf("Произошла ошибка при открытии сжатого архива!\n");
     return RESULT_ERROR;
   }
 
-  Result result = compressed_archive_reader_extract_all(reader, output_path);
+  compressed_archive_reader_set_stats(reader, stats);
+
+  // Модели архива со словарем строятся из его частот при установке
+  Dictionary* dictionary = NULL;
+  Result result = RESULT_OK;
+  if (dictionary_path != NULL)
+  {
+    dictionary = dictionary_load(dictionary_path);
+    result = dictionary != NULL
+               ? compressed_archive_reader_set_dictionary(reader, dictionary)
+               : RESULT_IO_ERROR;
+    if (result != RESULT_OK)
+    {
+      printf("Произошла ошибка при загрузке словаря: %s\n", dictionary_path);
+    }
+  }
+
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_reader_extract_all(reader, output_path);
+  }
   compressed_archive_reader_destroy(reader);
+  dictionary_destroy(dictionary);
 
   if (result == RESULT_OK)
   {
@@ -1,9 +1,11 @@
 #ifndef COMPRESSED_ARCHIVE_CODEC_DECODER_H
 #define COMPRESSED_ARCHIVE_CODEC_DECODER_H
 
+#include "stats.h"
 #include "types.h"
 
 Result compressed_archive_decode(const char* input_filename,
-                                 const char* output_path);
+                                 const char* output_path,
+                                 const char* dictionary_path, Stats* stats);
 
 #endif  // COMPRESSED_ARCHIVE_CODEC_DECODER_H
@@ -0,0 +1,191 @@
+#include "lister.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "compressed_archive_header.h"
+#include "compressed_archive_layout.h"
+#include "file.h"
+#include "file_table.h"
+#include "types.h"
+
+static double elapsed_seconds(const struct timespec* start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void format_mtime(QWord mtime, char* buffer, Size size)
+{
+  time_t seconds = (time_t)(mtime / 1000000000ULL);
+  struct tm local;
+  if (mtime == 0 || localtime_r(&seconds, &local) == NULL ||
+      strftime(buffer, size, "%Y-%m-%d %H:%M", &local) == 0)
+  {
+    snprintf(buffer, size, "%16s", "-");
+  }
+}
+
+// printf выравнивает по байтам, а названия колонок и "блок" в UTF-8
+static void print_column(const char* text, int width, bool left)
+{
+  int length = 0;
+  for (const char* c = text; *c != '\0'; c++)
+  {
+    length += ((unsigned char)*c & 0xC0) != 0x80;
+  }
+
+  int padding = width > length ? width - length : 0;
+  if (left)
+  {
+    printf("%s%*s ", text, padding, "");
+  }
+  else
+  {
+    printf("%*s%s ", padding, "", text);
+  }
+}
+
+static void print_table(const CompressedArchiveHeader* header,
+                        const FileTable* table, const FileNameIndex* names)
+{
+  print_column("Размер", 12, false);
+  print_column("В архиве", 12, false);
+  print_column("Изменен", 16, true);
+  printf("Имя\n");
+  for (DWord i = 0; i < file_table_get_count(table); i++)
+  {
+    const FileEntry* entry = file_table_get_entry(table, i);
+    char stored[32];
+    DWord block = file_table_find_solid_block(table, i);
+    if (block != FILE_TABLE_NO_ENTRY)
+    {
+      snprintf(stored, sizeof(stored), "блок %u", block + 1);
+    }
+    else
+    {
+      snprintf(stored, sizeof(stored), "%llu",
+               (unsigned long long)entry->compressed_size);
+    }
+
+    char mtime[32];
+    format_mtime(file_table_get_mtime(table, i), mtime, sizeof(mtime));
+    bool superseded =
+      names != NULL && file_name_index_find(names, entry->filename) != i;
+    printf("%12llu ", (unsigned long long)file_table_get_file_size(table, i));
+    print_column(stored, 12, false);
+    printf("%-16s %s%s\n", mtime, entry->filename,
+           superseded ? " (заменен)" : "");
+  }
+
+  printf("Алгоритм: %s",
+         compressed_archive_algorithm_name(header->primary_compression));
+  if (header->flags & FLAG_TWO_STAGE_COMPRESSION)
+  {
+    printf(" + %s",
+           compressed_archive_algorithm_name(header->secondary_compression));
+  }
+  printf(", версия формата %u.%u\n", header->version_major,
+         header->version_minor);
+}
+
+Result compressed_archive_list(const char* input_filename, Stats* stats)
+{
+  if (input_filename == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  File* file = file_create(input_filename);
+  FileTable* table = file_table_create();
+  if (file == NULL || table == NULL)
+  {
+    printf("Произошла ошибка при выделении памяти!\n");
+    file_destroy(file);
+    file_table_destroy(table);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  StatsSpan span;
+  stats_span_begin(stats, &span, STATS_STAGE_READ, "table");
+  CompressedArchiveHeader header;
+  QWord model_offset = 0;
+  Result result = file_open_for_read_volumes(file);
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_header_read(&header, file);
+  }
+  if (result == RESULT_OK && !compressed_archive_header_is_valid(&header))
+  {
+    printf("Неверный заголовок архива!\n");
+    result = RESULT_ERROR;
+  }
+  if (result == RESULT_OK)
+  {
+    result =
+      compressed_archive_read_table(&header, file, table, &model_offset);
+  }
+
+  QWord table_bytes = 0;
+  QWord archive_size = 0;
+  if (result == RESULT_OK)
+  {
+    table_bytes = COMPRESSED_ARCHIVE_HEADER_SIZE +
+                  compressed_archive_table_size(table);
+    file_seek(file, 0, SEEK_END);
+    archive_size = (QWord)file_tell(file);
+  }
+  stats_span_end(stats, &span, table_bytes, 0);
+  double seconds = elapsed_seconds(&start);
+
+  // После дозаписи прежние записи файла заменены последней
+  FileNameIndex* names = NULL;
+  if (result == RESULT_OK && (header.flags & FLAG_APPENDED))
+  {
+    names = file_name_index_create(table);
+    result = names != NULL ? RESULT_OK : RESULT_MEMORY_ERROR;
+  }
+
+  if (result == RESULT_OK)
+  {
+    print_table(&header, table, names);
+    QWord total_size = 0;
+    for (DWord i = 0; i < file_table_get_count(table); i++)
+    {
+      total_size += file_table_get_file_size(table, i);
+    }
+
+    printf("Записей: %u, сплошных блоков: %u\n", file_table_get_count(table),
+           file_table_get_solid_block_count(table));
+    printf("Исходный объем: %llu байт, размер архива: %llu байт",
+           (unsigned long long)total_size,
+           (unsigned long long)archive_size);
+    if (total_size > 0)
+    {
+      printf(" (%.1f%%)", (double)archive_size * 100.0 / (double)total_size);
+    }
+    if (file_get_volume_count(file) > 0)
+    {
+      printf(", томов: %u", file_get_volume_count(file));
+    }
+    printf("\nТаблица прочитана за %.3f с (%.0f записей/с)\n", seconds,
+           seconds > 0 ? (double)file_table_get_count(table) / seconds : 0.0);
+  }
+  else
+  {
+    printf("Произошла ошибка при чтении таблицы архива: %s\n",
+           input_filename);
+  }
+
+  file_name_index_destroy(names);
+  file_table_destroy(table);
+  file_close(file);
+  file_destroy(file);
+  return result;
+}
@@ -0,0 +1,11 @@
+#ifndef COMPRESSED_ARCHIVE_CODEC_LISTER_H
+#define COMPRESSED_ARCHIVE_CODEC_LISTER_H
+
+#include "stats.h"
+#include "types.h"
+
+// Печатает содержимое архива. Читаются только заголовок и таблица файлов,
+// данные записей и модели не трогаются
+Result compressed_archive_list(const char* input_filename, Stats* stats);
+
+#endif  // COMPRESSED_ARCHIVE_CODEC_LISTER_H
@@ -3,8 +3,16 @@
 #include <string.h>
 
 #include "arguments.h"
+#include "codec.h"
 #include "coder.h"
+#include "compressed_archive_builder.h"
 #include "decoder.h"
+#include "lister.h"
+#include "log.h"
+#include "pipe.h"
+#include "stats.h"
+#include "tester.h"
+#include "trainer.h"
 #include "types.h"
 
 #define DELIMETER "---------------\n"
@@ -13,6 +21,10 @@ typedef enum
 {
   MODE_ENCODE,
   MODE_DECODE,
+  MODE_TRAIN,
+  MODE_APPEND,
+  MODE_LIST,
+  MODE_TEST,
   MODE_UNKNOWN
 } OperationMode;
 
@@ -23,8 +35,10 @@ typedef enum
   ALGORITHM_ARITHMETIC,
   ALGORITHM_SHANNON,
   ALGORITHM_RLE,
+  ALGORITHM_RLE_VARINT,
   ALGORITHM_LZ78,
   ALGORITHM_LZ77,
+  ALGORITHM_LZH,
   ALGORITHM_NONE,
   ALGORITHM_UNKNOWN,
 } CompressionAlgorithmChoice;
@@ -33,6 +47,8 @@ static OperationMode parse_operation_mode(const char* mode_str);
 static CompressionAlgorithmChoice parse_algorithm(const char* algorithm);
 static const char* algorithm_to_string(CompressionAlgorithmChoice algo);
 static void print_usage();
+static void write_stats_reports(const Stats* stats, const char* stats_format,
+                                const char* trace_path);
 
 int main(int argc, char** argv)
 {
@@ -50,6 +66,12 @@ int main(int argc, char** argv)
     return EXIT_FAILURE;
   }
 
+  const char* log_level_argument = program_arguments_get_log_level(args);
+  if (log_level_argument != NULL)
+  {
+    log_set_level(log_level_from_name(log_level_argument));
+  }
+
   const char* mode_argument = program_arguments_get_mode(args);
   const char* input_path = program_arguments_get_input(args);
   const char* output_path = program_arguments_get_output(args);
@@ -57,6 +79,12 @@ int main(int argc, char** argv)
   const char* secondary_algorithm_argument =
     program_arguments_get_secondary_algorithm(args);
   bool two_staged = program_arguments_get_two_staged(args);
+  bool dedup = program_arguments_get_dedup(args);
+  bool align = program_arguments_get_align(args);
+  QWord volume_size = (QWord)program_arguments_get_volume_size(args) * 1024;
+  int level = program_arguments_get_level(args);
+  Size solid_block_size = (Size)program_arguments_get_solid_block(args) * 1024;
+  const char* dictionary_path = program_arguments_get_dictionary(args);
 
   OperationMode mode = parse_operation_mode(mode_argument);
   if (mode == MODE_UNKNOWN)
@@ -98,12 +126,18 @@ int main(int argc, char** argv)
       case ALGORITHM_RLE:
         algorithm_str = "rle";
         break;
+      case ALGORITHM_RLE_VARINT:
+        algorithm_str = "rle-varint";
+        break;
       case ALGORITHM_LZ78:
         algorithm_str = "lz78";
         break;
       case ALGORITHM_LZ77:
         algorithm_str = "lz77";
         break;
+      case ALGORITHM_LZH:
+        algorithm_str = "lzh";
+        break;
       case ALGORITHM_NONE:
         algorithm_str = "none";
         break;
@@ -140,12 +174,18 @@ int main(int argc, char** argv)
       case ALGORITHM_RLE:
         secondary_algorithm_str = "rle";
         break;
+      case ALGORITHM_RLE_VARINT:
+        secondary_algorithm_str = "rle-varint";
+        break;
       case ALGORITHM_LZ78:
         secondary_algorithm_str = "lz78";
         break;
       case ALGORITHM_LZ77:
         secondary_algorithm_str = "lz77";
         break;
+      case ALGORITHM_LZH:
+        secondary_algorithm_str = "lzh";
+        break;
       case ALGORITHM_NONE:
         secondary_algorithm_str = "none";
         break;
@@ -163,49 +203,194 @@ int main(int argc, char** argv)
     secondary_algorithm_str = NULL;
   }
 
+  // Потоковый режим пишет данные в stdout, поэтому весь журнал и
+  // сообщения уходят в stderr
+  bool streaming =
+    pipe_is_stdio_path(input_path) || pipe_is_stdio_path(output_path);
+  if (streaming)
+  {
+    log_set_stream(stderr);
+    if (two_staged || secondary_algorithm_argument)
+    {
+      fprintf(stderr, "Двухэтапное сжатие недоступно в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+    if (mode == MODE_TRAIN || dictionary_path != NULL)
+    {
+      fprintf(stderr, "Словари недоступны в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+    if (dedup)
+    {
+      fprintf(stderr, "Дедупликация недоступна в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+    if (solid_block_size > 0)
+    {
+      fprintf(stderr, "Сплошные блоки недоступны в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+    if (align)
+    {
+      fprintf(stderr, "Выравнивание недоступно в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+    if (volume_size > 0)
+    {
+      fprintf(stderr, "Тома недоступны в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+    if (mode == MODE_LIST || mode == MODE_TEST)
+    {
+      fprintf(stderr,
+              "Просмотр и проверка архива недоступны в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+    if (mode == MODE_APPEND)
+    {
+      fprintf(stderr, "Дозапись недоступна в потоковом режиме!\n");
+      program_arguments_destroy(args);
+      return EXIT_FAILURE;
+    }
+  }
+  FILE* console = streaming ? stderr : stdout;
+
+  const char* stats_format = program_arguments_get_stats_format(args);
+  const char* trace_path = program_arguments_get_trace(args);
+  Stats* stats = NULL;
+  if (stats_format != NULL || trace_path != NULL)
+  {
+    stats = stats_create();
+  }
+
   Result result;
 
-  switch (mode)
-  {
-    case MODE_ENCODE:
-      printf("Создание сжатого архива\n%s", DELIMETER);
-      printf("Основной алгоритм: %s\n", algorithm_to_string(algorithm));
-      if (two_staged || secondary_algorithm_argument)
-      {
-        printf("Вторичный алгоритм: %s\n",
-               algorithm_to_string(secondary_algorithm));
-      }
-      if (two_staged)
-      {
-        printf("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
-      }
-      result = compressed_archive_encode_extended(
-        input_path, output_path, algorithm_str, secondary_algorithm_str,
-        two_staged);
-      break;
-
-    case MODE_DECODE:
-      printf("Извлечение из сжатого архива\n%s", DELIMETER);
-      result = compressed_archive_decode(input_path, output_path);
-      break;
+  if (streaming)
+  {
+    result = mode == MODE_ENCODE
+               ? compressed_stream_encode(input_path, output_path,
+                                          algorithm_str, stats)
+               : compressed_stream_decode(input_path, output_path, stats);
+  }
+  else
+  {
+    switch (mode)
+    {
+      case MODE_ENCODE:
+        printf("Создание сжатого архива\n%s", DELIMETER);
+        printf("Основной алгоритм: %s\n", algorithm_to_string(algorithm));
+        if (two_staged || secondary_algorithm_argument)
+        {
+          printf("Вторичный алгоритм: %s\n",
+                 algorithm_to_string(secondary_algorithm));
+        }
+        if (two_staged)
+        {
+          printf("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
+        }
+        result = compressed_archive_encode_extended(
+          input_path, output_path, algorithm_str, secondary_algorithm_str,
+          two_staged, level, dedup, solid_block_size, align, volume_size,
+          dictionary_path, stats);
+        break;
+
+      case MODE_APPEND:
+        printf("Дозапись в сжатый архив\n%s", DELIMETER);
+        if (algorithm_argument || secondary_algorithm_argument ||
+            two_staged || level != 0 || align || volume_size > 0)
+        {
+          printf("Предупреждение: при дозаписи используются алгоритмы и "
+                 "модели архива, параметры сжатия игнорируются\n");
+        }
+        result =
+          compressed_archive_append(input_path, output_path, dedup,
+                                    solid_block_size, dictionary_path, stats);
+        break;
 
-    default:
-      program_arguments_destroy(args);
-      return EXIT_FAILURE;
+      case MODE_DECODE:
+        printf("Извлечение из сжатого архива\n%s", DELIMETER);
+        result = compressed_archive_decode(input_path, output_path,
+                                           dictionary_path, stats);
+        break;
+
+      case MODE_LIST:
+        printf("Содержимое сжатого архива\n%s", DELIMETER);
+        result = compressed_archive_list(input_path, stats);
+        break;
+
+      case MODE_TEST:
+        printf("Проверка сжатого архива\n%s", DELIMETER);
+        result = compressed_archive_test(
+          input_path, dictionary_path,
+          (Size)program_arguments_get_threads(args), stats);
+        break;
+
+      case MODE_TRAIN:
+        printf("Обучение словаря\n%s", DELIMETER);
+        result = compressed_archive_train(input_path, output_path, stats);
+        break;
+
+      default:
+        stats_destroy(stats);
+        program_arguments_destroy(args);
+        return EXIT_FAILURE;
+    }
   }
 
+  write_stats_reports(stats, stats_format, trace_path);
+  stats_destroy(stats);
   program_arguments_destroy(args);
 
   if (result != RESULT_OK)
   {
-    printf("Операция завершилась с ошибкой!\n");
+    fprintf(console, "Операция завершилась с ошибкой!\n");
     return EXIT_FAILURE;
   }
 
-  printf("Операция завершена успешно!\n");
+  fprintf(console, "Операция завершена успешно!\n");
   return EXIT_SUCCESS;
 }
 
+// Отчеты печатаются в stderr, чтобы не смешиваться с журналом и данными
+// потокового режима в stdout
+static void write_stats_reports(const Stats* stats, const char* stats_format,
+                                const char* trace_path)
+{
+  if (stats == NULL)
+  {
+    return;
+  }
+
+  if (stats_format != NULL)
+  {
+    stats_write_json(stats, stderr);
+  }
+
+  if (trace_path != NULL)
+  {
+    FILE* trace_file = fopen(trace_path, "w");
+    if (trace_file == NULL)
+    {
+      fprintf(stderr, "Не удалось открыть файл трассировки: %s\n",
+              trace_path);
+      return;
+    }
+
+    if (stats_write_trace(stats, trace_file) != RESULT_OK)
+    {
+      fprintf(stderr, "Ошибка записи файла трассировки: %s\n", trace_path);
+    }
+    fclose(trace_file);
+  }
+}
+
 static OperationMode parse_operation_mode(const char* mode_str)
 {
   if (strcmp(mode_str, "encode") == 0 || strcmp(mode_str, "e") == 0)
@@ -218,6 +403,26 @@ static OperationMode parse_operation_mode(const char* mode_str)
     return MODE_DECODE;
   }
 
+  if (strcmp(mode_str, "train") == 0 || strcmp(mode_str, "t") == 0)
+  {
+    return MODE_TRAIN;
+  }
+
+  if (strcmp(mode_str, "append") == 0 || strcmp(mode_str, "u") == 0)
+  {
+    return MODE_APPEND;
+  }
+
+  if (strcmp(mode_str, "list") == 0 || strcmp(mode_str, "l") == 0)
+  {
+    return MODE_LIST;
+  }
+
+  if (strcmp(mode_str, "test") == 0 || strcmp(mode_str, "v") == 0)
+  {
+    return MODE_TEST;
+  }
+
   return MODE_UNKNOWN;
 }
 
@@ -255,6 +460,11 @@ static CompressionAlgorithmChoice parse_algorithm(const char* algorithm)
     return ALGORITHM_RLE;
   }
 
+  if (strcmp(algorithm, "rle-varint") == 0 || strcmp(algorithm, "rlev") == 0)
+  {
+    return ALGORITHM_RLE_VARINT;
+  }
+
   if (strcmp(algorithm, "lz78") == 0)
   {
     return ALGORITHM_LZ78;
@@ -265,6 +475,11 @@ static CompressionAlgorithmChoice parse_algorithm(const char* algorithm)
     return ALGORITHM_LZ77;
   }
 
+  if (strcmp(algorithm, "lzh") == 0)
+  {
+    return ALGORITHM_LZH;
+  }
+
   if (strcmp(algorithm, "none") == 0 || strcmp(algorithm, "n") == 0)
   {
     return ALGORITHM_NONE;
@@ -285,10 +500,14 @@ static const char* algorithm_to_string(CompressionAlgorithmChoice algorithm)
       return "SHANNON";
     case ALGORITHM_RLE:
       return "RLE";
+    case ALGORITHM_RLE_VARINT:
+      return "RLE (varint)";
     case ALGORITHM_LZ78:
       return "LZ78";
     case ALGORITHM_LZ77:
       return "LZ77";
+    case ALGORITHM_LZH:
+      return "LZH";
     case ALGORITHM_NONE:
       return "NONE (без сжатия)";
     case ALGORITHM_AUTO:
@@ -300,20 +519,32 @@ static const char* algorithm_to_string(CompressionAlgorithmChoice algorithm)
 static void print_usage()
 {
   printf(
-    "Использование: compressed_archive_codec --mode <encode/decode> --input "
-    "<path> --output <path> [--algorithm <algorithm>] [--secondary-algorithm "
-    "<algorithm>] [--two-staged]\n");
+    "Использование: compressed_archive_codec --mode "
+    "<encode/decode/train/append/list/test> "
+    "--input <path> [--output <path>] [--algorithm <algorithm>] "
+    "[--secondary-algorithm <algorithm>] [--two-staged] [--level <1-9>] "
+    "[--dict <path>] [--dedup] [--solid <KiB>] [--align] "
+    "[--volume-size <KiB>] [--threads <N>]\n");
   printf("Режимы работы:\n");
   printf("  encode, e - создание сжатого архива из файла/папки\n");
   printf("  decode, d - извлечение файлов из сжатого архива\n");
+  printf("  train, t  - обучение словаря на файле/папке\n");
+  printf("  append, u - дозапись новых и измененных файлов в архив --output "
+         "(сжатие моделями архива)\n");
+  printf("  list, l   - содержимое архива (читается только таблица файлов)\n");
+  printf("  test, v   - проверка CRC всех записей без записи на диск, "
+         "параллельно\n");
   printf("\nОсновные алгоритмы сжатия (только для encode):\n");
   printf("  auto, a     - автоматический выбор (по умолчанию)\n");
   printf("  huffman, huff, h  - алгоритм Хаффмана\n");
   printf("  arithmetic, arith - арифметическое кодирование\n");
   printf("  shannon, shan, s  - алгоритм Шеннона\n");
   printf("  rle, r      - метод RLE\n");
+  printf("  rle-varint, rlev  - RLE с varint-длинами серий и литералов\n");
   printf("  lz78        - метод LZ78 (вариант LZW)\n");
   printf("  lz77        - метод LZ77\n");
+  printf("  lzh         - LZ77 с кодами Хаффмана для литералов/длин и "
+         "смещений\n");
   printf("  none, n     - без сжатия\n");
   printf("\nВторичные алгоритмы сжатия (для двухэтапного сжатия):\n");
   printf("  auto, a     - автоматический выбор\n");
@@ -321,11 +552,48 @@ static void print_usage()
   printf("  arithmetic, arith - арифметическое кодирование\n");
   printf("  shannon, shan, s  - алгоритм Шеннона\n");
   printf("  rle, r      - метод RLE\n");
+  printf("  rle-varint, rlev  - RLE с varint-длинами серий и литералов\n");
   printf("  lz78        - метод LZ78 (вариант LZW)\n");
   printf("  lz77        - метод LZ77\n");
+  printf("  lzh         - LZ77 с кодами Хаффмана для литералов/длин и "
+         "смещений\n");
   printf("  none, n     - без сжатия\n");
   printf("\nДополнительные параметры:\n");
   printf("  --two-staged - включить двухэтапное сжатие\n");
+  printf(
+    "  --level <1-9> - уровень сжатия LZH (по умолчанию %d, 9 - оптимальный "
+    "разбор)\n",
+    COMPRESSED_ARCHIVE_LEVEL_DEFAULT);
+  printf(
+    "  --log-level <trace/debug/info/warn/error/off> - подробность "
+    "журнала (по умолчанию info)\n");
+  printf(
+    "  --dict <path> - словарь из режима train: модели huffman/arithmetic/"
+    "shannon и окно lzh берутся из него, архив хранит только его хэш\n");
+  printf(
+    "  --dedup - дедупликация: повторяющиеся участки файлов (чанки по "
+    "содержимому) хранятся и сжимаются один раз\n");
+  printf(
+    "  --solid <KiB> - сплошные блоки: подряд идущие файлы меньше блока "
+    "сжимаются вместе, блоками до заданного размера (до %d КиБ)\n",
+    ARGUMENTS_SOLID_BLOCK_MAX);
+  printf(
+    "  --align - несжатые записи не меньше блока файловой системы "
+    "начинаются с его границы, извлечение на той же ФС клонирует их без "
+    "копирования\n");
+  printf(
+    "  --volume-size <KiB> - архив пишется томами заданного размера "
+    "(архив.001, архив.002, ...), по пути архива остается манифест; "
+    "тома читаются параллельно\n");
+  printf(
+    "  --threads <N> - число потоков проверки (по умолчанию по числу "
+    "процессоров, до %d)\n",
+    TESTER_MAX_THREADS);
+  printf("  --stats=json - сводка времени и объемов по этапам в stderr\n");
+  printf("  --trace <path> - трассировка этапов (Trace Event JSON)\n");
+  printf(
+    "  --input - / --output - - потоковый режим: один файл без таблицы "
+    "файлов через stdin/stdout\n");
   printf("\nПримеры:\n");
   printf(
     "  compressed_archive_codec --mode encode --algorithm huffman --input "
@@ -344,6 +612,18 @@ static void print_usage()
   printf(
     "  compressed_archive_codec --mode decode --input archive.compressed "
     "--output extracted\n");
+  printf(
+    "  compressed_archive_codec --mode train --input samples --output "
+    "samples.dict\n");
+  printf(
+    "  compressed_archive_codec --mode encode --algorithm lzh --dict "
+    "samples.dict --input record.json --output record.compressed\n");
+  printf(
+    "  compressed_archive_codec --mode append --input dir --output "
+    "dir.compressed\n");
+  printf(
+    "  tar cf - dir | compressed_archive_codec --mode encode --algorithm "
+    "lz77 --input - --output - > dir.tar.stream\n");
   printf("\nПримечания:\n");
   printf(
     "  1. При использовании --two-staged без --secondary-algorithm "
@@ -351,4 +631,8 @@ static void print_usage()
   printf(
     "  2. Для лучшего сжатия рекомендуется использовать комбинации: "
     "huffman+rle, arithmetic+lz77, shannon+lz78\n");
+  printf(
+    "  3. В потоковом режиме данные сжимаются блоками по %d КиБ, "
+    "двухэтапное сжатие недоступно, автовыбор означает %s\n",
+    CODEC_STREAM_DEFAULT_BLOCK_SIZE / 1024, PIPE_DEFAULT_CODEC);
 }
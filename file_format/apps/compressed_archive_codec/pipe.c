@@ -0,0 +1,285 @@
+#include "pipe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codec.h"
+#include "types.h"
+
+#define PIPE_BUFFER_SIZE (64 * 1024)
+#define PIPE_CODEC_NAME_LIMIT 32
+
+bool pipe_is_stdio_path(const char* path)
+{
+  return path != NULL && strcmp(path, PIPE_STDIO_PATH) == 0;
+}
+
+static FILE* pipe_open(const char* path, bool for_write)
+{
+  if (pipe_is_stdio_path(path))
+  {
+    return for_write ? stdout : stdin;
+  }
+
+  return fopen(path, for_write ? "wb" : "rb");
+}
+
+static void pipe_close(FILE* file)
+{
+  if (file != NULL && file != stdin && file != stdout)
+  {
+    fclose(file);
+  }
+}
+
+static Result pipe_write_header(FILE* output, const Codec* codec)
+{
+  Size name_length = strlen(codec->name);
+  Byte header[2] = {PIPE_VERSION, (Byte)name_length};
+
+  if (fwrite(PIPE_SIGNATURE, 1, PIPE_SIGNATURE_SIZE, output) !=
+        PIPE_SIGNATURE_SIZE ||
+      fwrite(header, 1, sizeof(header), output) != sizeof(header) ||
+      fwrite(codec->name, 1, name_length, output) != name_length)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  return RESULT_OK;
+}
+
+static const Codec* pipe_read_header(FILE* input)
+{
+  char signature[PIPE_SIGNATURE_SIZE];
+  Byte header[2];
+  char name[PIPE_CODEC_NAME_LIMIT];
+
+  if (fread(signature, 1, PIPE_SIGNATURE_SIZE, input) != PIPE_SIGNATURE_SIZE ||
+      memcmp(signature, PIPE_SIGNATURE, PIPE_SIGNATURE_SIZE) != 0)
+  {
+    fprintf(stderr, "Входные данные не являются сжатым потоком!\n");
+    return NULL;
+  }
+
+  if (fread(header, 1, sizeof(header), input) != sizeof(header) ||
+      header[0] != PIPE_VERSION || header[1] >= PIPE_CODEC_NAME_LIMIT ||
+      fread(name, 1, header[1], input) != header[1])
+  {
+    fprintf(stderr, "Поврежден или не поддерживается заголовок потока!\n");
+    return NULL;
+  }
+
+  name[header[1]] = '\0';
+  const Codec* codec = codec_find(name);
+  if (codec == NULL)
+  {
+    fprintf(stderr, "Неизвестный кодек потока: %s\n", name);
+  }
+
+  return codec;
+}
+
+static Result pipe_write(FILE* output, const Byte* data, Size size,
+                         QWord* bytes_out)
+{
+  if (size > 0 && fwrite(data, 1, size, output) != size)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  *bytes_out += size;
+  return RESULT_OK;
+}
+
+// Прокачивает input через поток кодека. В памяти одновременно находятся
+// только два буфера обмена и текущий блок кодека
+static Result pipe_pump(CodecStream* stream, FILE* input, FILE* output,
+                        QWord* bytes_in, QWord* bytes_out)
+{
+  Byte* input_buffer = (Byte*)malloc(PIPE_BUFFER_SIZE);
+  Byte* output_buffer = (Byte*)malloc(PIPE_BUFFER_SIZE);
+  if (input_buffer == NULL || output_buffer == NULL)
+  {
+    free(input_buffer);
+    free(output_buffer);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = codec_stream_begin(stream);
+
+  while (result == RESULT_OK)
+  {
+    Size read_size = fread(input_buffer, 1, PIPE_BUFFER_SIZE, input);
+    if (read_size == 0)
+    {
+      if (ferror(input))
+      {
+        result = RESULT_IO_ERROR;
+      }
+      break;
+    }
+
+    *bytes_in += read_size;
+
+    Size position = 0;
+    while (result == RESULT_OK && position < read_size)
+    {
+      Size consumed = 0;
+      Size produced = 0;
+      result = codec_stream_process(
+        stream, input_buffer + position, read_size - position, &consumed,
+        output_buffer, PIPE_BUFFER_SIZE, &produced);
+      if (result == RESULT_OK)
+      {
+        result = pipe_write(output, output_buffer, produced, bytes_out);
+      }
+      position += consumed;
+    }
+  }
+
+  bool finished = false;
+  while (result == RESULT_OK && !finished)
+  {
+    Size produced = 0;
+    result = codec_stream_end(stream, output_buffer, PIPE_BUFFER_SIZE,
+                              &produced, &finished);
+    if (result == RESULT_OK)
+    {
+      result = pipe_write(output, output_buffer, produced, bytes_out);
+    }
+  }
+
+  if (result == RESULT_OK && fflush(output) != 0)
+  {
+    result = RESULT_IO_ERROR;
+  }
+
+  free(input_buffer);
+  free(output_buffer);
+  return result;
+}
+
+Result compressed_stream_encode(const char* input_path,
+                                const char* output_path, const char* algorithm,
+                                Stats* stats)
+{
+  if (input_path == NULL || output_path == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  const Codec* codec = codec_find(algorithm ? algorithm : PIPE_DEFAULT_CODEC);
+  if (codec == NULL)
+  {
+    fprintf(stderr, "Алгоритм %s не поддерживает потоковый режим!\n",
+            algorithm);
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  FILE* input = pipe_open(input_path, false);
+  if (input == NULL)
+  {
+    fprintf(stderr, "Не удалось открыть входной файл: %s\n", input_path);
+    return RESULT_IO_ERROR;
+  }
+
+  FILE* output = pipe_open(output_path, true);
+  if (output == NULL)
+  {
+    fprintf(stderr, "Не удалось открыть выходной файл: %s\n", output_path);
+    pipe_close(input);
+    return RESULT_IO_ERROR;
+  }
+
+  CodecStream* stream = codec_stream_create(codec, CODEC_DIRECTION_ENCODE, 0);
+  Result result = stream ? pipe_write_header(output, codec)
+                         : RESULT_MEMORY_ERROR;
+
+  QWord bytes_in = 0;
+  QWord bytes_out = PIPE_SIGNATURE_SIZE + 2 + strlen(codec->name);
+  StatsSpan span;
+  stats_span_begin(stats, &span, STATS_STAGE_COMPRESS, codec->name);
+  if (result == RESULT_OK)
+  {
+    result = pipe_pump(stream, input, output, &bytes_in, &bytes_out);
+  }
+  stats_span_end(stats, &span, bytes_in, bytes_out);
+
+  codec_stream_destroy(stream);
+  pipe_close(input);
+  pipe_close(output);
+
+  if (result == RESULT_OK)
+  {
+    fprintf(stderr, "Поток сжат (%s): %llu -> %llu байт\n", codec->name,
+            (unsigned long long)bytes_in, (unsigned long long)bytes_out);
+  }
+  else
+  {
+    fprintf(stderr, "Произошла ошибка при сжатии потока!\n");
+  }
+
+  return result;
+}
+
+Result compressed_stream_decode(const char* input_path,
+                                const char* output_path, Stats* stats)
+{
+  if (input_path == NULL || output_path == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  FILE* input = pipe_open(input_path, false);
+  if (input == NULL)
+  {
+    fprintf(stderr, "Не удалось открыть входной файл: %s\n", input_path);
+    return RESULT_IO_ERROR;
+  }
+
+  const Codec* codec = pipe_read_header(input);
+  if (codec == NULL)
+  {
+    pipe_close(input);
+    return RESULT_ERROR;
+  }
+
+  FILE* output = pipe_open(output_path, true);
+  if (output == NULL)
+  {
+    fprintf(stderr, "Не удалось открыть выходной файл: %s\n", output_path);
+    pipe_close(input);
+    return RESULT_IO_ERROR;
+  }
+
+  CodecStream* stream = codec_stream_create(codec, CODEC_DIRECTION_DECODE, 0);
+  Result result = stream ? RESULT_OK : RESULT_MEMORY_ERROR;
+
+  QWord bytes_in = PIPE_SIGNATURE_SIZE + 2 + strlen(codec->name);
+  QWord bytes_out = 0;
+  StatsSpan span;
+  stats_span_begin(stats, &span, STATS_STAGE_DECOMPRESS, codec->name);
+  if (result == RESULT_OK)
+  {
+    result = pipe_pump(stream, input, output, &bytes_in, &bytes_out);
+  }
+  stats_span_end(stats, &span, bytes_in, bytes_out);
+
+  codec_stream_destroy(stream);
+  pipe_close(input);
+  pipe_close(output);
+
+  if (result == RESULT_OK)
+  {
+    fprintf(stderr, "Поток распакован (%s): %llu -> %llu байт\n",
+            codec->name, (unsigned long long)bytes_in,
+            (unsigned long long)bytes_out);
+  }
+  else
+  {
+    fprintf(stderr, "Произошла ошибка при распаковке потока!\n");
+  }
+
+  return result;
+}
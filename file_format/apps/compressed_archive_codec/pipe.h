@@ -0,0 +1,28 @@
+#ifndef COMPRESSED_ARCHIVE_CODEC_PIPE_H
+#define COMPRESSED_ARCHIVE_CODEC_PIPE_H
+
+#include <stdbool.h>
+
+#include "stats.h"
+#include "types.h"
+
+// Путь "-" означает stdin для --input и stdout для --output
+#define PIPE_STDIO_PATH "-"
+
+// Потоковый формат без таблицы файлов: короткий заголовок с именем
+// кодека, за которым идут кадры codec_stream до кадра CODEC_FRAME_END
+#define PIPE_SIGNATURE "lolstr"
+#define PIPE_SIGNATURE_SIZE 6
+#define PIPE_VERSION 1
+#define PIPE_DEFAULT_CODEC "lz77"
+
+bool pipe_is_stdio_path(const char* path);
+
+// algorithm == NULL выбирает PIPE_DEFAULT_CODEC
+Result compressed_stream_encode(const char* input_path,
+                                const char* output_path, const char* algorithm,
+                                Stats* stats);
+Result compressed_stream_decode(const char* input_path,
+                                const char* output_path, Stats* stats);
+
+#endif  // COMPRESSED_ARCHIVE_CODEC_PIPE_H
@@ -0,0 +1,264 @@
+#include "tester.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "compressed_archive_reader.h"
+#include "dictionary.h"
+#include "types.h"
+
+// Записи выдаются единицами распаковки: сплошной блок целиком или одна
+// запись вне блоков, поэтому каждый блок распаковывается одним потоком
+typedef struct
+{
+  pthread_mutex_t lock;
+  DWord next;  // Первая еще не выданная запись
+  DWord count;
+} TestQueue;
+
+typedef struct
+{
+  pthread_t thread;
+  TestQueue* queue;
+  CompressedArchiveReader* reader;
+  QWord tested_bytes;
+  DWord tested;
+  DWord failed;
+} TestWorker;
+
+static double elapsed_seconds(const struct timespec* start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Ошибка записи не останавливает проверку: в отчет попадают все
+// поврежденные записи
+static void* test_worker_run(void* argument)
+{
+  TestWorker* worker = (TestWorker*)argument;
+  TestQueue* queue = worker->queue;
+
+  while (true)
+  {
+    pthread_mutex_lock(&queue->lock);
+    DWord first = queue->next;
+    DWord last =
+      compressed_archive_reader_get_unit_end(worker->reader, first);
+    queue->next = last;
+    pthread_mutex_unlock(&queue->lock);
+
+    if (first >= last)
+    {
+      break;
+    }
+
+    for (DWord i = first; i < last; i++)
+    {
+      QWord size = 0;
+      if (compressed_archive_reader_test_file(worker->reader, i, &size) ==
+          RESULT_OK)
+      {
+        worker->tested_bytes += size;
+      }
+      else
+      {
+        printf("ОШИБКА: %s\n",
+               compressed_archive_reader_get_filename(worker->reader, i));
+        worker->failed++;
+      }
+      worker->tested++;
+    }
+  }
+
+  return NULL;
+}
+
+// Потоков не больше, чем единиц распаковки
+static Size select_thread_count(Size thread_count,
+                                const CompressedArchiveReader* reader,
+                                DWord entry_count)
+{
+  if (thread_count == 0)
+  {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = processors > 0 ? (Size)processors : 1;
+  }
+  if (thread_count > TESTER_MAX_THREADS)
+  {
+    thread_count = TESTER_MAX_THREADS;
+  }
+
+  Size units = 0;
+  for (DWord i = 0; i < entry_count && units < thread_count;
+       i = compressed_archive_reader_get_unit_end(reader, i))
+  {
+    units++;
+  }
+  if (thread_count > units)
+  {
+    thread_count = units > 0 ? units : 1;
+  }
+  return thread_count;
+}
+
+static CompressedArchiveReader* open_reader(const char* input_filename,
+                                            const Dictionary* dictionary)
+{
+  CompressedArchiveReader* reader =
+    compressed_archive_reader_create(input_filename);
+  if (reader != NULL && dictionary != NULL &&
+      compressed_archive_reader_set_dictionary(reader, dictionary) !=
+        RESULT_OK)
+  {
+    compressed_archive_reader_destroy(reader);
+    reader = NULL;
+  }
+  return reader;
+}
+
+// Потоки проверяют записи своими читателями, поэтому статистика
+// собирается одним интервалом на всю проверку
+static Result run_workers(const char* input_filename,
+                          const Dictionary* dictionary,
+                          CompressedArchiveReader* reader, DWord entry_count,
+                          Size thread_count, Stats* stats)
+{
+  thread_count = select_thread_count(thread_count, reader, entry_count);
+  TestWorker* workers = (TestWorker*)calloc(thread_count, sizeof(TestWorker));
+  if (workers == NULL)
+  {
+    printf("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  TestQueue queue;
+  pthread_mutex_init(&queue.lock, NULL);
+  queue.next = 0;
+  queue.count = entry_count;
+
+  // Первый поток - вызывающий, он работает с уже открытым читателем
+  Result result = RESULT_OK;
+  workers[0].reader = reader;
+  for (Size i = 0; i < thread_count; i++)
+  {
+    workers[i].queue = &queue;
+    if (i > 0 && result == RESULT_OK)
+    {
+      workers[i].reader = open_reader(input_filename, dictionary);
+      result = workers[i].reader != NULL ? RESULT_OK : RESULT_ERROR;
+    }
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  StatsSpan span;
+  stats_span_begin(stats, &span, STATS_STAGE_CRC, "test");
+
+  Size started = 1;
+  for (; result == RESULT_OK && started < thread_count; started++)
+  {
+    if (pthread_create(&workers[started].thread, NULL, test_worker_run,
+                       &workers[started]) != 0)
+    {
+      break;
+    }
+  }
+
+  if (result == RESULT_OK)
+  {
+    test_worker_run(&workers[0]);
+  }
+
+  QWord tested_bytes = 0;
+  DWord tested = 0;
+  DWord failed = 0;
+  for (Size i = 0; i < thread_count; i++)
+  {
+    if (i > 0 && i < started)
+    {
+      pthread_join(workers[i].thread, NULL);
+    }
+    tested_bytes += workers[i].tested_bytes;
+    tested += workers[i].tested;
+    failed += workers[i].failed;
+  }
+
+  stats_span_end(stats, &span, tested_bytes, 0);
+  double seconds = elapsed_seconds(&start);
+
+  for (Size i = 1; i < thread_count; i++)
+  {
+    compressed_archive_reader_destroy(workers[i].reader);
+  }
+  pthread_mutex_destroy(&queue.lock);
+  free(workers);
+
+  if (result != RESULT_OK)
+  {
+    printf("Произошла ошибка при открытии архива для проверки!\n");
+    return result;
+  }
+
+  printf("Проверено записей: %u, с ошибками: %u\n", tested, failed);
+  printf("Распаковано %llu байт за %.3f с (%.1f МиБ/с, потоков: %zu)\n",
+         (unsigned long long)tested_bytes, seconds,
+         seconds > 0 ? (double)tested_bytes / (1024.0 * 1024.0) / seconds
+                     : 0.0,
+         started);
+  return failed == 0 ? RESULT_OK : RESULT_ERROR;
+}
+
+Result compressed_archive_test(const char* input_filename,
+                               const char* dictionary_path, Size thread_count,
+                               Stats* stats)
+{
+  if (input_filename == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  printf("Проверка сжатого архива: %s\n", input_filename);
+
+  Dictionary* dictionary = NULL;
+  if (dictionary_path != NULL)
+  {
+    dictionary = dictionary_load(dictionary_path);
+    if (dictionary == NULL)
+    {
+      printf("Произошла ошибка при загрузке словаря: %s\n", dictionary_path);
+      return RESULT_IO_ERROR;
+    }
+  }
+
+  CompressedArchiveReader* reader = open_reader(input_filename, dictionary);
+  Result result = reader != NULL
+                    ? compressed_archive_reader_verify_header(reader)
+                    : RESULT_ERROR;
+  if (result == RESULT_OK)
+  {
+    result = run_workers(input_filename, dictionary, reader,
+                         compressed_archive_reader_get_file_count(reader),
+                         thread_count, stats);
+  }
+
+  compressed_archive_reader_destroy(reader);
+  dictionary_destroy(dictionary);
+
+  if (result == RESULT_OK)
+  {
+    printf("Архив не поврежден: %s\n", input_filename);
+  }
+  else
+  {
+    printf("Проверка архива не пройдена!\n");
+  }
+
+  return result;
+}
@@ -0,0 +1,18 @@
+#ifndef COMPRESSED_ARCHIVE_CODEC_TESTER_H
+#define COMPRESSED_ARCHIVE_CODEC_TESTER_H
+
+#include "stats.h"
+#include "types.h"
+
+#define TESTER_MAX_THREADS 16
+
+// Проверяет архив без записи на диск: каждая запись распаковывается в
+// рабочие буферы и сверяется с CRC. Записи проверяются параллельно, каждый
+// поток со своим читателем; сплошной блок целиком достается одному потоку.
+// thread_count == 0 выбирает число процессоров (не больше
+// TESTER_MAX_THREADS)
+Result compressed_archive_test(const char* input_filename,
+                               const char* dictionary_path, Size thread_count,
+                               Stats* stats);
+
+#endif  // COMPRESSED_ARCHIVE_CODEC_TESTER_H
@@ -0,0 +1,61 @@
+#include "trainer.h"
+
+#include <stdio.h>
+
+#include "dictionary.h"
+#include "file_list.h"
+#include "path_utils.h"
+#include "types.h"
+
+Result compressed_archive_train(const char* input_path,
+                                const char* output_filename, Stats* stats)
+{
+  if (input_path == NULL || output_filename == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  printf("Обучение словаря: %s -> %s\n", input_path, output_filename);
+
+  FileList* files = file_list_create();
+  Dictionary* dictionary = dictionary_create();
+  if (files == NULL || dictionary == NULL)
+  {
+    printf("Произошла ошибка при выделении памяти!\n");
+    file_list_destroy(files);
+    dictionary_destroy(dictionary);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = path_utils_is_directory(input_path)
+                    ? file_list_add_directory(files, input_path, true)
+                    : file_list_add_file(files, input_path);
+
+  StatsSpan span;
+  stats_span_begin(stats, &span, STATS_STAGE_TRAIN, "dictionary");
+  if (result == RESULT_OK)
+  {
+    result = dictionary_train(dictionary, files);
+  }
+  stats_span_end(stats, &span, 0, 0);
+
+  if (result == RESULT_OK)
+  {
+    result = dictionary_save(dictionary, output_filename);
+  }
+
+  if (result == RESULT_OK)
+  {
+    printf("Словарь %08X сохранен: %s (окно %zu байт)\n",
+           dictionary_get_hash(dictionary), output_filename,
+           dictionary_get_window_size(dictionary));
+  }
+  else
+  {
+    printf("Произошла ошибка при обучении словаря!\n");
+  }
+
+  dictionary_destroy(dictionary);
+  file_list_destroy(files);
+  return result;
+}
@@ -0,0 +1,12 @@
+#ifndef COMPRESSED_ARCHIVE_CODEC_TRAINER_H
+#define COMPRESSED_ARCHIVE_CODEC_TRAINER_H
+
+#include "stats.h"
+#include "types.h"
+
+// Обучает словарь на файле или папке (рекурсивно) и сохраняет его в
+// output_filename для --dict
+Result compressed_archive_train(const char* input_path,
+                                const char* output_filename, Stats* stats);
+
+#endif  // COMPRESSED_ARCHIVE_CODEC_TRAINER_H
@@ -1,12 +1,14 @@
 #include "coder.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 
 #include "path_utils.h"
 #include "raw_archive_builder.h"
 #include "types.h"
 
-Result raw_archive_encode(const char* input_path, const char* output_filename)
+Result raw_archive_encode(const char* input_path, const char* output_filename,
+                          bool align, QWord volume_size)
 {
   if (input_path == NULL || output_filename == NULL)
   {
@@ -22,7 +24,17 @@ Result raw_archive_encode(const char* input_path, const char* output_filename)
     return RESULT_MEMORY_ERROR;
   }
 
-  Result result;
+  Result result = raw_archive_builder_set_alignment(builder, align);
+  if (result == RESULT_OK && volume_size > 0)
+  {
+    result = raw_archive_builder_set_volume_size(builder, volume_size);
+  }
+  if (result != RESULT_OK)
+  {
+    raw_archive_builder_destroy(builder);
+    return result;
+  }
+
   if (path_utils_is_directory(input_path))
   {
     printf("Добавление директории: %s\n", input_path);
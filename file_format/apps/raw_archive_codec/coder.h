@@ -1,8 +1,13 @@
 #ifndef RAW_ARCHIVE_CODEC_CODER_H
 #define RAW_ARCHIVE_CODEC_CODER_H
 
+#include <stdbool.h>
+
 #include "types.h"
 
-Result raw_archive_encode(const char* input_path, const char* output_filename);
+// align - начинать данные крупных файлов с границы блока файловой системы,
+// volume_size - размер тома, 0 - архив пишется одним файлом
+Result raw_archive_encode(const char* input_path, const char* output_filename,
+                          bool align, QWord volume_size);
 
 #endif  // RAW_ARCHIVE_CODEC_CODER_H
@@ -5,6 +5,7 @@
 #include "arguments.h"
 #include "coder.h"
 #include "decoder.h"
+#include "log.h"
 #include "types.h"
 
 #define DELIMETER "---------------\n"
@@ -35,6 +36,12 @@ int main(int argc, char** argv)
     return EXIT_FAILURE;
   }
 
+  const char* log_level_argument = program_arguments_get_log_level(args);
+  if (log_level_argument != NULL)
+  {
+    log_set_level(log_level_from_name(log_level_argument));
+  }
+
   const char* mode_argument = program_arguments_get_mode(args);
   const char* input_path = program_arguments_get_input(args);
   const char* output_path = program_arguments_get_output(args);
@@ -54,7 +61,9 @@ int main(int argc, char** argv)
   {
     case MODE_ENCODE:
       printf("Создание несжатого архива\n%s", DELIMETER);
-      result = raw_archive_encode(input_path, output_path);
+      result = raw_archive_encode(
+        input_path, output_path, program_arguments_get_align(args),
+        (QWord)program_arguments_get_volume_size(args) * 1024);
       break;
 
     case MODE_DECODE:
@@ -98,10 +107,20 @@ static void print_usage()
 {
   printf(
     "Использование: raw_archive_codec --mode <encode/decode> --input "
-    "<path> --output <path>\n");
+    "<path> --output <path> [--align] [--volume-size <KiB>]\n");
   printf("Режимы работы:\n");
   printf("  encode, e - создание несжатого архива из файла/папки\n");
   printf("  decode, d - извлечение файлов из несжатого архива\n");
+  printf("\nДополнительные параметры:\n");
+  printf(
+    "  --log-level <trace/debug/info/warn/error/off> - подробность "
+    "журнала (по умолчанию info)\n");
+  printf(
+    "  --align - данные файлов не меньше блока файловой системы начинаются "
+    "с его границы, извлечение на той же ФС клонирует их без копирования\n");
+  printf(
+    "  --volume-size <KiB> - архив пишется томами заданного размера "
+    "(архив.001, архив.002, ...), по пути архива остается манифест\n");
   printf("\nПримеры:\n");
   printf(
     "  raw_archive_codec --mode encode --input document.txt --output "
@@ -0,0 +1,592 @@
+#include "bench.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arithmetic.h"
+#include "crc32.h"
+#include "huffman.h"
+#include "lz77.h"
+#include "lz78.h"
+#include "lzh.h"
+#include "rle.h"
+#include "shannon.h"
+#include "types.h"
+
+typedef struct
+{
+  Byte* data;
+  Size size;
+  Byte* model;  // Сериализованная модель, которую пишет архиватор
+  Size model_size;
+} BenchPayload;
+
+typedef Result (*BenchEncodeFunction)(const Byte* input, Size size,
+                                      BenchPayload* payload);
+typedef Result (*BenchDecodeFunction)(const BenchPayload* payload,
+                                      Byte** output, Size* output_size);
+
+typedef struct
+{
+  const char* name;
+  BenchEncodeFunction encode;
+  BenchDecodeFunction decode;
+  bool checksum;
+} BenchCodec;
+
+static Result bench_huffman_encode(const Byte* input, Size size,
+                                   BenchPayload* payload)
+{
+  HuffmanTree* tree = huffman_tree_create();
+  if (!tree)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = huffman_tree_build(tree, input, size);
+  if (result == RESULT_OK)
+  {
+    result =
+      huffman_compress(input, size, &payload->data, &payload->size, tree);
+  }
+  if (result == RESULT_OK)
+  {
+    result =
+      huffman_serialize_tree(tree, &payload->model, &payload->model_size);
+  }
+
+  huffman_tree_destroy(tree);
+  return result;
+}
+
+static Result bench_huffman_decode(const BenchPayload* payload, Byte** output,
+                                   Size* output_size)
+{
+  HuffmanTree* tree = huffman_tree_create();
+  if (!tree)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result =
+    huffman_deserialize_tree(tree, payload->model, payload->model_size);
+  if (result == RESULT_OK)
+  {
+    result = huffman_decompress(payload->data, payload->size, output,
+                                output_size, tree);
+  }
+
+  huffman_tree_destroy(tree);
+  return result;
+}
+
+static Result bench_arithmetic_encode(const Byte* input, Size size,
+                                      BenchPayload* payload)
+{
+  ArithmeticModel* model = arithmetic_model_create();
+  if (!model)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = arithmetic_model_build(model, input, size);
+  if (result == RESULT_OK)
+  {
+    result =
+      arithmetic_compress(input, size, &payload->data, &payload->size, model);
+  }
+  if (result == RESULT_OK)
+  {
+    result = arithmetic_serialize_model(model, &payload->model,
+                                        &payload->model_size);
+  }
+
+  arithmetic_model_destroy(model);
+  return result;
+}
+
+static Result bench_arithmetic_decode(const BenchPayload* payload,
+                                      Byte** output, Size* output_size)
+{
+  ArithmeticModel* model = arithmetic_model_create();
+  if (!model)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result =
+    arithmetic_deserialize_model(model, payload->model, payload->model_size);
+  if (result == RESULT_OK)
+  {
+    result = arithmetic_decompress(payload->data, payload->size, output,
+                                   output_size, model);
+  }
+
+  arithmetic_model_destroy(model);
+  return result;
+}
+
+static Result bench_shannon_encode(const Byte* input, Size size,
+                                   BenchPayload* payload)
+{
+  ShannonTree* tree = shannon_tree_create();
+  if (!tree)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = shannon_tree_build(tree, input, size);
+  if (result == RESULT_OK)
+  {
+    result =
+      shannon_compress(input, size, &payload->data, &payload->size, tree);
+  }
+  if (result == RESULT_OK)
+  {
+    result =
+      shannon_serialize_tree(tree, &payload->model, &payload->model_size);
+  }
+
+  shannon_tree_destroy(tree);
+  return result;
+}
+
+static Result bench_shannon_decode(const BenchPayload* payload, Byte** output,
+                                   Size* output_size)
+{
+  ShannonTree* tree = shannon_tree_create();
+  if (!tree)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result =
+    shannon_deserialize_tree(tree, payload->model, payload->model_size);
+  if (result == RESULT_OK)
+  {
+    result = shannon_decompress(payload->data, payload->size, output,
+                                output_size, tree);
+  }
+
+  shannon_tree_destroy(tree);
+  return result;
+}
+
+static Result bench_rle_encode_format(const Byte* input, Size size,
+                                      BenchPayload* payload, RLEFormat format)
+{
+  RLEContext* context = rle_create(rle_analyze_prefix(input, size));
+  if (!context)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = rle_set_format(context, format);
+  if (result == RESULT_OK)
+  {
+    result =
+      rle_compress(input, size, &payload->data, &payload->size, context);
+  }
+  if (result == RESULT_OK)
+  {
+    result =
+      rle_serialize_context(context, &payload->model, &payload->model_size);
+  }
+
+  rle_destroy(context);
+  return result;
+}
+
+static Result bench_rle_encode(const Byte* input, Size size,
+                               BenchPayload* payload)
+{
+  return bench_rle_encode_format(input, size, payload, RLE_FORMAT_CLASSIC);
+}
+
+static Result bench_rle_varint_encode(const Byte* input, Size size,
+                                      BenchPayload* payload)
+{
+  return bench_rle_encode_format(input, size, payload, RLE_FORMAT_VARINT);
+}
+
+static Result bench_rle_decode(const BenchPayload* payload, Byte** output,
+                               Size* output_size)
+{
+  RLEContext* context = rle_create(0);
+  if (!context)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result =
+    rle_deserialize_context(context, payload->model, payload->model_size);
+  if (result == RESULT_OK)
+  {
+    result = rle_decompress(payload->data, payload->size, output, output_size,
+                            context);
+  }
+
+  rle_destroy(context);
+  return result;
+}
+
+static Result bench_lz77_encode(const Byte* input, Size size,
+                                BenchPayload* payload)
+{
+  payload->model = malloc(1);
+  if (!payload->model)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  payload->model[0] = lz77_analyze_prefix(input, size);
+  payload->model_size = 1;
+
+  return lz77_compress(input, size, &payload->data, &payload->size,
+                       payload->model[0]);
+}
+
+static Result bench_lz77_decode(const BenchPayload* payload, Byte** output,
+                                Size* output_size)
+{
+  return lz77_decompress(payload->data, payload->size, output, output_size,
+                         payload->model[0]);
+}
+
+static Result bench_lz78_encode(const Byte* input, Size size,
+                                BenchPayload* payload)
+{
+  return lz78_compress(input, size, &payload->data, &payload->size);
+}
+
+static Result bench_lz78_decode(const BenchPayload* payload, Byte** output,
+                                Size* output_size)
+{
+  return lz78_decompress(payload->data, payload->size, output, output_size);
+}
+
+static Result bench_lzh_encode(const Byte* input, Size size,
+                               BenchPayload* payload)
+{
+  return lzh_compress(input, size, &payload->data, &payload->size,
+                      LZH_LEVEL_DEFAULT);
+}
+
+static Result bench_lzh_optimal_encode(const Byte* input, Size size,
+                                       BenchPayload* payload)
+{
+  return lzh_compress(input, size, &payload->data, &payload->size,
+                      LZH_LEVEL_MAX);
+}
+
+static Result bench_lzh_decode(const BenchPayload* payload, Byte** output,
+                               Size* output_size)
+{
+  return lzh_decompress(payload->data, payload->size, output, output_size);
+}
+
+static Result bench_crc32_encode(const Byte* input, Size size,
+                                 BenchPayload* payload)
+{
+  CRC32Table* table = crc32_table_create();
+  if (!table)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = crc32_table_calculate(table, input, size);
+  if (result == RESULT_OK)
+  {
+    payload->data = malloc(sizeof(DWord));
+    if (payload->data)
+    {
+      DWord crc32 = crc32_table_get_crc32(table);
+      memcpy(payload->data, &crc32, sizeof(crc32));
+      payload->size = sizeof(crc32);
+    }
+    else
+    {
+      result = RESULT_MEMORY_ERROR;
+    }
+  }
+
+  crc32_table_destroy(table);
+  return result;
+}
+
+static const BenchCodec bench_codecs[] = {
+  {"huffman", bench_huffman_encode, bench_huffman_decode, false},
+  {"arithmetic", bench_arithmetic_encode, bench_arithmetic_decode, false},
+  {"shannon", bench_shannon_encode, bench_shannon_decode, false},
+  {"rle", bench_rle_encode, bench_rle_decode, false},
+  {"rle_varint", bench_rle_varint_encode, bench_rle_decode, false},
+  {"lz77", bench_lz77_encode, bench_lz77_decode, false},
+  {"lz78", bench_lz78_encode, bench_lz78_decode, false},
+  {"lzh", bench_lzh_encode, bench_lzh_decode, false},
+  {"lzh_optimal", bench_lzh_optimal_encode, bench_lzh_decode, false},
+  {"crc32", bench_crc32_encode, NULL, true},
+};
+
+static const char* bench_status_names[] = {"ok", "failed", "crashed",
+                                           "timeout"};
+
+Size bench_codec_count(void)
+{
+  return sizeof(bench_codecs) / sizeof(bench_codecs[0]);
+}
+
+const char* bench_codec_name(Size index)
+{
+  if (index >= bench_codec_count())
+  {
+    return NULL;
+  }
+
+  return bench_codecs[index].name;
+}
+
+static double bench_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void bench_payload_free(BenchPayload* payload)
+{
+  free(payload->data);
+  free(payload->model);
+  memset(payload, 0, sizeof(*payload));
+}
+
+static void bench_measure(const BenchCodec* codec, const Byte* data,
+                          Size size, int iterations, BenchResult* result)
+{
+  BenchPayload payload = {0};
+
+  for (int iteration = 0; iteration < iterations; iteration++)
+  {
+    bench_payload_free(&payload);
+
+    double start = bench_now();
+    if (codec->encode(data, size, &payload) != RESULT_OK)
+    {
+      result->status = BENCH_STATUS_FAILED;
+      goto cleanup;
+    }
+    double elapsed = bench_now() - start;
+
+    if (iteration == 0 || elapsed < result->encode_seconds)
+    {
+      result->encode_seconds = elapsed;
+    }
+    result->output_size = payload.size + payload.model_size;
+
+    if (codec->checksum)
+    {
+      continue;
+    }
+
+    Byte* output = NULL;
+    Size output_size = size;
+
+    start = bench_now();
+    if (codec->decode(&payload, &output, &output_size) != RESULT_OK)
+    {
+      result->status = BENCH_STATUS_FAILED;
+      goto cleanup;
+    }
+    elapsed = bench_now() - start;
+
+    if (iteration == 0 || elapsed < result->decode_seconds)
+    {
+      result->decode_seconds = elapsed;
+    }
+
+    result->roundtrip =
+      output_size == size && memcmp(output, data, size) == 0;
+    free(output);
+  }
+
+  result->status = BENCH_STATUS_OK;
+
+cleanup:
+  bench_payload_free(&payload);
+}
+
+static Result bench_read_result(int descriptor, BenchResult* result)
+{
+  Byte* buffer = (Byte*)result;
+  Size received = 0;
+
+  while (received < sizeof(*result))
+  {
+    ssize_t count =
+      read(descriptor, buffer + received, sizeof(*result) - received);
+    if (count <= 0)
+    {
+      return RESULT_IO_ERROR;
+    }
+    received += (Size)count;
+  }
+
+  return RESULT_OK;
+}
+
+Result bench_run_case(Size codec_index, const char* corpus_name,
+                      const Byte* data, Size size, int iterations,
+                      unsigned timeout_seconds, BenchResult* result)
+{
+  if (codec_index >= bench_codec_count() || !data || size == 0 ||
+      iterations <= 0 || !result)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  const BenchCodec* codec = &bench_codecs[codec_index];
+
+  memset(result, 0, sizeof(*result));
+  result->codec = codec->name;
+  result->corpus = corpus_name;
+  result->input_size = size;
+  result->checksum = codec->checksum;
+
+  int descriptors[2];
+  if (pipe(descriptors) != 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t child = fork();
+  if (child < 0)
+  {
+    close(descriptors[0]);
+    close(descriptors[1]);
+    return RESULT_ERROR;
+  }
+
+  if (child == 0)
+  {
+    // Кодеки подробно логируют в stdout, это не должно попадать в JSON
+    close(descriptors[0]);
+    if (!freopen("/dev/null", "w", stdout))
+    {
+      _exit(EXIT_FAILURE);
+    }
+
+    alarm(timeout_seconds);
+    bench_measure(codec, data, size, iterations, result);
+
+    ssize_t written = write(descriptors[1], result, sizeof(*result));
+    _exit(written == (ssize_t)sizeof(*result) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  close(descriptors[1]);
+  Result read_result = bench_read_result(descriptors[0], result);
+  close(descriptors[0]);
+
+  int status = 0;
+  struct rusage usage;
+  memset(&usage, 0, sizeof(usage));
+  if (wait4(child, &status, 0, &usage) < 0)
+  {
+    return RESULT_ERROR;
+  }
+
+  // Указатели из дочернего процесса совпадают, но восстанавливаем явно
+  result->codec = codec->name;
+  result->corpus = corpus_name;
+  result->peak_rss_kb = usage.ru_maxrss;
+
+  if (WIFSIGNALED(status))
+  {
+    result->status = WTERMSIG(status) == SIGALRM ? BENCH_STATUS_TIMEOUT
+                                                 : BENCH_STATUS_CRASHED;
+  }
+  else if (read_result != RESULT_OK || WEXITSTATUS(status) != EXIT_SUCCESS)
+  {
+    result->status = BENCH_STATUS_CRASHED;
+  }
+
+  return RESULT_OK;
+}
+
+static void bench_write_rate(FILE* stream, const char* key, Size size,
+                             double seconds, bool valid)
+{
+  if (!valid)
+  {
+    fprintf(stream, "\"%s\": null", key);
+    return;
+  }
+
+  if (seconds <= 0.0)
+  {
+    seconds = 1e-9;
+  }
+
+  fprintf(stream, "\"%s\": %.3f", key, (double)size / 1e6 / seconds);
+}
+
+void bench_write_json(FILE* stream, const BenchResult* results, Size count,
+                      Size corpus_size, int iterations)
+{
+  fprintf(stream, "{\n");
+  fprintf(stream, "  \"corpus_size\": %zu,\n", corpus_size);
+  fprintf(stream, "  \"iterations\": %d,\n", iterations);
+  fprintf(stream, "  \"results\": [\n");
+
+  for (Size i = 0; i < count; i++)
+  {
+    const BenchResult* result = &results[i];
+    bool measured = result->status == BENCH_STATUS_OK;
+    bool decoded = measured && !result->checksum;
+
+    fprintf(stream, "    {\"codec\": \"%s\", \"corpus\": \"%s\", ",
+            result->codec, result->corpus);
+    fprintf(stream, "\"status\": \"%s\", ",
+            bench_status_names[result->status]);
+
+    if (decoded)
+    {
+      fprintf(stream, "\"roundtrip\": %s, ",
+              result->roundtrip ? "true" : "false");
+    }
+    else
+    {
+      fprintf(stream, "\"roundtrip\": null, ");
+    }
+
+    fprintf(stream, "\"input_bytes\": %zu, ", result->input_size);
+    if (decoded)
+    {
+      fprintf(stream, "\"output_bytes\": %zu, \"ratio\": %.4f, ",
+              result->output_size,
+              (double)result->output_size / (double)result->input_size);
+    }
+    else
+    {
+      fprintf(stream, "\"output_bytes\": null, \"ratio\": null, ");
+    }
+
+    bench_write_rate(stream, "encode_mbps", result->input_size,
+                     result->encode_seconds, measured);
+    fprintf(stream, ", ");
+    bench_write_rate(stream, "decode_mbps", result->input_size,
+                     result->decode_seconds, decoded);
+    fprintf(stream, ", \"peak_rss_kb\": %ld}%s\n", result->peak_rss_kb,
+            i + 1 < count ? "," : "");
+  }
+
+  fprintf(stream, "  ]\n");
+  fprintf(stream, "}\n");
+}
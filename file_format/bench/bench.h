@@ -0,0 +1,44 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "types.h"
+
+typedef enum
+{
+  BENCH_STATUS_OK,
+  BENCH_STATUS_FAILED,   // Кодек вернул ошибку
+  BENCH_STATUS_CRASHED,  // Процесс замера завершился сигналом
+  BENCH_STATUS_TIMEOUT   // Замер не уложился в отведенное время
+} BenchStatus;
+
+typedef struct
+{
+  const char* codec;
+  const char* corpus;
+  Size input_size;
+  Size output_size;  // Сжатые данные вместе с сериализованной моделью
+  double encode_seconds;
+  double decode_seconds;
+  long peak_rss_kb;
+  bool checksum;  // Кодек только вычисляет контрольную сумму
+  bool roundtrip;
+  BenchStatus status;
+} BenchResult;
+
+Size bench_codec_count(void);
+const char* bench_codec_name(Size index);
+
+// Замеряет кодек на одном корпусе в отдельном процессе: падение или
+// зависание кодека не прерывает весь прогон, а пиковый RSS относится
+// только к этому замеру. Время - лучшее из iterations повторов.
+Result bench_run_case(Size codec_index, const char* corpus_name,
+                      const Byte* data, Size size, int iterations,
+                      unsigned timeout_seconds, BenchResult* result);
+
+void bench_write_json(FILE* stream, const BenchResult* results, Size count,
+                      Size corpus_size, int iterations);
+
+#endif  // BENCH_BENCH_H
@@ -0,0 +1,183 @@
+#include "corpus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+#define CORPUS_SEED 0x9E3779B97F4A7C15ULL
+#define CORPUS_RECORD_SIZE 32
+#define CORPUS_SPARSE_BLOCK 4096
+#define CORPUS_SPARSE_ISLAND 256
+
+static const char* corpus_words[] = {
+  "the",     "of",       "and",    "archive", "file",  "data",    "block",
+  "to",      "in",       "is",     "header",  "size",  "offset",  "table",
+  "a",       "for",      "with",   "stream",  "code",  "symbol",  "tree",
+  "файл",    "архив",    "данные", "размер",  "блок",  "сжатие",  "и",
+  "в",       "на",       "не",     "для",     "что",   "таблица", "код",
+  "return",  "result",   "byte",   "error",   "while", "if",      "else",
+  "decoder", "encoder",  "bits",   "model",   "entry", "path",    "buffer",
+  "length",  "position", "value",  "prefix",  "match", "window",  "output"};
+
+static const char* corpus_kind_names[CORPUS_COUNT] = {
+  "text", "binary", "random", "zeros", "sparse"};
+
+static QWord corpus_next_random(QWord* state)
+{
+  QWord x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+static void corpus_fill_random(Byte* data, Size size, QWord* state)
+{
+  Size position = 0;
+  while (position < size)
+  {
+    QWord value = corpus_next_random(state);
+    Size chunk = size - position < sizeof(value) ? size - position
+                                                 : sizeof(value);
+    memcpy(data + position, &value, chunk);
+    position += chunk;
+  }
+}
+
+// Текст из словаря с убывающей частотой слов, как в естественном языке
+static void corpus_fill_text(Byte* data, Size size, QWord* state)
+{
+  const Size word_count = sizeof(corpus_words) / sizeof(corpus_words[0]);
+  Size position = 0;
+  Size words_in_line = 0;
+
+  while (position < size)
+  {
+    QWord random = corpus_next_random(state);
+    Size limit = (Size)(random % word_count) + 1;
+    const char* word = corpus_words[(random >> 32) % limit];
+
+    for (Size i = 0; word[i] != '\0' && position < size; i++)
+    {
+      data[position++] = (Byte)word[i];
+    }
+
+    if (position < size)
+    {
+      words_in_line++;
+      if (words_in_line >= 12 + (random >> 60))
+      {
+        data[position++] = '\n';
+        words_in_line = 0;
+      }
+      else
+      {
+        data[position++] = (random >> 24) % 16 == 0 ? ',' : ' ';
+      }
+    }
+  }
+}
+
+// Массив записей фиксированного размера: счетчики, малые приращения,
+// флаги и выравнивающие нули, как в типичных бинарных форматах
+static void corpus_fill_binary(Byte* data, Size size, QWord* state)
+{
+  Byte record[CORPUS_RECORD_SIZE];
+  DWord identifier = 0;
+  QWord timestamp = 1700000000ULL;
+  Size position = 0;
+
+  while (position < size)
+  {
+    QWord random = corpus_next_random(state);
+    memset(record, 0, sizeof(record));
+
+    identifier++;
+    timestamp += random % 1000;
+    DWord value = (DWord)((random >> 16) % 4096);
+    Word flags = (Word)((random >> 40) % 4 == 0 ? 0x0001 : 0x0000);
+
+    memcpy(record, &identifier, sizeof(identifier));
+    memcpy(record + 4, &timestamp, sizeof(timestamp));
+    memcpy(record + 12, &value, sizeof(value));
+    memcpy(record + 16, &flags, sizeof(flags));
+
+    Size chunk = size - position < sizeof(record) ? size - position
+                                                  : sizeof(record);
+    memcpy(data + position, record, chunk);
+    position += chunk;
+  }
+}
+
+// Нули с редкими островками случайных данных
+static void corpus_fill_sparse(Byte* data, Size size, QWord* state)
+{
+  memset(data, 0, size);
+
+  for (Size block = 0; block < size; block += CORPUS_SPARSE_BLOCK)
+  {
+    if (corpus_next_random(state) % 16 != 0)
+    {
+      continue;
+    }
+
+    Size island = size - block < CORPUS_SPARSE_ISLAND ? size - block
+                                                      : CORPUS_SPARSE_ISLAND;
+    corpus_fill_random(data + block, island, state);
+  }
+}
+
+const char* corpus_kind_name(CorpusKind kind)
+{
+  if (kind < 0 || kind >= CORPUS_COUNT)
+  {
+    return "unknown";
+  }
+
+  return corpus_kind_names[kind];
+}
+
+Result corpus_generate(CorpusKind kind, Size size, Byte** data)
+{
+  if (!data || size == 0 || kind < 0 || kind >= CORPUS_COUNT)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Byte* buffer = malloc(size);
+  if (!buffer)
+  {
+    printf("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  QWord state = CORPUS_SEED ^ ((QWord)kind << 32);
+
+  switch (kind)
+  {
+    case CORPUS_TEXT:
+      corpus_fill_text(buffer, size, &state);
+      break;
+    case CORPUS_BINARY:
+      corpus_fill_binary(buffer, size, &state);
+      break;
+    case CORPUS_RANDOM:
+      corpus_fill_random(buffer, size, &state);
+      break;
+    case CORPUS_ZEROS:
+      memset(buffer, 0, size);
+      break;
+    case CORPUS_SPARSE:
+      corpus_fill_sparse(buffer, size, &state);
+      break;
+    default:
+      free(buffer);
+      return RESULT_INVALID_ARGUMENT;
+  }
+
+  *data = buffer;
+  return RESULT_OK;
+}
@@ -0,0 +1,22 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include "types.h"
+
+typedef enum
+{
+  CORPUS_TEXT,
+  CORPUS_BINARY,
+  CORPUS_RANDOM,
+  CORPUS_ZEROS,
+  CORPUS_SPARSE,
+  CORPUS_COUNT
+} CorpusKind;
+
+const char* corpus_kind_name(CorpusKind kind);
+
+// Генерирует детерминированный синтетический корпус заданного размера.
+// Буфер освобождается вызывающей стороной через free().
+Result corpus_generate(CorpusKind kind, Size size, Byte** data);
+
+#endif  // BENCH_CORPUS_H
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "corpus.h"
+
+#define BENCH_DEFAULT_SIZE ((Size)1 << 20)
+#define BENCH_DEFAULT_ITERATIONS 3
+#define BENCH_DEFAULT_TIMEOUT 120
+
+typedef struct
+{
+  Size size;
+  int iterations;
+  unsigned timeout_seconds;
+  const char* codec;
+  const char* corpus;
+  const char* output;
+} BenchOptions;
+
+static void print_usage()
+{
+  printf("Использование:\n");
+  printf("  bench [--size <байт>] [--iterations <n>] [--timeout <секунд>]\n");
+  printf("        [--codec <имя>] [--corpus <имя>] [--output <файл.json>]\n");
+  printf("\nКодеки:");
+  for (Size i = 0; i < bench_codec_count(); i++)
+  {
+    printf(" %s", bench_codec_name(i));
+  }
+  printf("\nКорпуса:");
+  for (int kind = 0; kind < CORPUS_COUNT; kind++)
+  {
+    printf(" %s", corpus_kind_name((CorpusKind)kind));
+  }
+  printf("\n\nРезультат - JSON: encode_mbps/decode_mbps в МБ/с (10^6 байт),\n");
+  printf("ratio = сжатый размер с моделью / исходный, peak_rss_kb - пиковый\n");
+  printf("RSS процесса замера. Время - лучшее из --iterations повторов.\n");
+}
+
+static bool parse_options(BenchOptions* options, int argc, char** argv)
+{
+  options->size = BENCH_DEFAULT_SIZE;
+  options->iterations = BENCH_DEFAULT_ITERATIONS;
+  options->timeout_seconds = BENCH_DEFAULT_TIMEOUT;
+  options->codec = NULL;
+  options->corpus = NULL;
+  options->output = NULL;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (i + 1 >= argc)
+    {
+      return false;
+    }
+
+    const char* value = argv[++i];
+    if (strcmp(argv[i - 1], "--size") == 0)
+    {
+      options->size = (Size)strtoull(value, NULL, 10);
+    }
+    else if (strcmp(argv[i - 1], "--iterations") == 0)
+    {
+      options->iterations = atoi(value);
+    }
+    else if (strcmp(argv[i - 1], "--timeout") == 0)
+    {
+      options->timeout_seconds = (unsigned)strtoul(value, NULL, 10);
+    }
+    else if (strcmp(argv[i - 1], "--codec") == 0)
+    {
+      options->codec = value;
+    }
+    else if (strcmp(argv[i - 1], "--corpus") == 0)
+    {
+      options->corpus = value;
+    }
+    else if (strcmp(argv[i - 1], "--output") == 0)
+    {
+      options->output = value;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return options->size > 0 && options->iterations > 0;
+}
+
+int main(int argc, char** argv)
+{
+  BenchOptions options;
+  if (!parse_options(&options, argc, argv))
+  {
+    print_usage();
+    return EXIT_FAILURE;
+  }
+
+  Size case_count = bench_codec_count() * CORPUS_COUNT;
+  BenchResult* results = calloc(case_count, sizeof(BenchResult));
+  if (!results)
+  {
+    printf("Произошла ошибка при выделении памяти!\n");
+    return EXIT_FAILURE;
+  }
+
+  int exit_code = EXIT_FAILURE;
+  FILE* stream = stdout;
+  Size result_count = 0;
+
+  for (int kind = 0; kind < CORPUS_COUNT; kind++)
+  {
+    const char* corpus_name = corpus_kind_name((CorpusKind)kind);
+    if (options.corpus && strcmp(options.corpus, corpus_name) != 0)
+    {
+      continue;
+    }
+
+    Byte* data = NULL;
+    if (corpus_generate((CorpusKind)kind, options.size, &data) != RESULT_OK)
+    {
+      goto cleanup;
+    }
+
+    for (Size codec = 0; codec < bench_codec_count(); codec++)
+    {
+      const char* codec_name = bench_codec_name(codec);
+      if (options.codec && strcmp(options.codec, codec_name) != 0)
+      {
+        continue;
+      }
+
+      fprintf(stderr, "[BENCH] %s / %s...\n", codec_name, corpus_name);
+      if (bench_run_case(codec, corpus_name, data, options.size,
+                         options.iterations, options.timeout_seconds,
+                         &results[result_count]) != RESULT_OK)
+      {
+        fprintf(stderr, "[BENCH] Ошибка запуска замера %s / %s\n",
+                codec_name, corpus_name);
+        free(data);
+        goto cleanup;
+      }
+      result_count++;
+    }
+
+    free(data);
+  }
+
+  if (result_count == 0)
+  {
+    print_usage();
+    goto cleanup;
+  }
+
+  if (options.output)
+  {
+    stream = fopen(options.output, "w");
+    if (!stream)
+    {
+      fprintf(stderr, "[BENCH] Не удалось открыть %s\n", options.output);
+      goto cleanup;
+    }
+  }
+
+  bench_write_json(stream, results, result_count, options.size,
+                   options.iterations);
+  exit_code = EXIT_SUCCESS;
+
+  if (stream != stdout)
+  {
+    fclose(stream);
+  }
+
+cleanup:
+  free(results);
+  return exit_code;
+}
@@ -1,6 +1,5 @@
 #include "compressed_archive_builder.h"
 
-#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,15 +7,23 @@
 
 #include "arithmetic.h"
 #include "compressed_archive_header.h"
+#include "compressed_archive_layout.h"
+#include "crc32.h"
+#include "dedup_index.h"
+#include "dictionary.h"
+#include "directory_walker.h"
 #include "entropy.h"
 #include "file_table.h"
 #include "huffman.h"
+#include "log.h"
 #include "lz77.h"
 #include "lz78.h"
+#include "lzh.h"
 #include "markov_model.h"
-#include "path_utils.h"
 #include "rle.h"
+#include "scratch.h"
 #include "shannon.h"
+#include "stats.h"
 
 #define DEFAULT_COMPRESSION_ALGORITHM COMPRESSION_ARITHMETIC
 
@@ -37,6 +44,36 @@ typedef struct
   CompressionAlgorithm algorithm;
 } CompressedFileData;
 
+// Контекст этапа LZH: уровень сжатия и окно словаря (может быть пустым)
+typedef struct
+{
+  Byte level;
+  const Byte* window;
+  Size window_size;
+} LZHStageContext;
+
+// Дозапись в существующий архив: новые записи сжимаются моделями архива и
+// пишутся в конец архива, за прежние таблицу и трейлер, затем заново
+// пишутся таблица и трейлер. При ошибке архив обрезается до data_end, и
+// прежняя таблица остается целой
+typedef struct
+{
+  CompressedArchiveHeader header;
+  DWord existing_count;  // Записей в архиве до дозаписи
+  QWord model_offset;    // Модели архива
+  QWord data_end;        // Размер архива до дозаписи
+  FileNameIndex* names;  // Имена записей архива для поиска неизмененных
+} AppendState;
+
+// Модели архива, восстановленные для дозаписи
+typedef struct
+{
+  void* primary;  // Дерево/модель/контекст RLE первичного алгоритма
+  Byte lz77_prefix;
+  LZHStageContext lzh;
+  RLEContext* secondary_rle;
+} AppendModels;
+
 struct CompressedArchiveBuilder
 {
   File* archive_file;
@@ -48,25 +85,31 @@ struct CompressedArchiveBuilder
   CompressionAlgorithm selected_secondary_algorithm;
   bool force_algorithm;
   bool use_two_stage_compression;
+  RLEFormat rle_format;
+  Byte level;  // Уровень сжатия, для LZH совпадает с LZH_LEVEL_*
+  const Dictionary* dictionary;  // Не принадлежит построителю
+  Stats* stats;
+  ScratchBuffer scratch[2];  // Результаты этапов двухэтапного сжатия
+  DirectoryWalker* walker;   // Обход добавляемых директорий
+  DedupIndex* dedup_index;   // NULL - дедупликация выключена
+  AppendState* append;       // NULL - создается новый архив
+  Size solid_block_size;     // 0 - сплошные блоки выключены
+  bool align_stored;         // Несжатые данные с границы блока ФС
+  CRC32Table* crc32_table;   // Контрольные суммы записей
 };
 
-CompressedArchiveBuilder* compressed_archive_builder_create(
-  const char* output_filename)
+// Построитель с еще не открытым файлом архива
+static CompressedArchiveBuilder* builder_create(const char* filename)
 {
-  if (output_filename == NULL)
-  {
-    return NULL;
-  }
-
   CompressedArchiveBuilder* builder =
     (CompressedArchiveBuilder*)malloc(sizeof(CompressedArchiveBuilder));
   if (builder == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
-  builder->archive_file = file_create(output_filename);
+  builder->archive_file = file_create(filename);
   if (builder->archive_file == NULL)
   {
     free(builder);
@@ -81,6 +124,18 @@ CompressedArchiveBuilder* compressed_archive_builder_create(
     return NULL;
   }
 
+  builder->walker = directory_walker_create(0);
+  builder->crc32_table = crc32_table_create();
+  if (builder->walker == NULL || builder->crc32_table == NULL)
+  {
+    directory_walker_destroy(builder->walker);
+    crc32_table_destroy(builder->crc32_table);
+    file_table_destroy(builder->file_table);
+    file_destroy(builder->archive_file);
+    free(builder);
+    return NULL;
+  }
+
   builder->all_data = NULL;
   builder->all_data_size = 0;
   builder->all_data_capacity = 0;
@@ -88,13 +143,117 @@ CompressedArchiveBuilder* compressed_archive_builder_create(
   builder->selected_secondary_algorithm = COMPRESSION_NONE;
   builder->force_algorithm = false;
   builder->use_two_stage_compression = false;
+  builder->rle_format = RLE_FORMAT_CLASSIC;
+  builder->level = COMPRESSED_ARCHIVE_LEVEL_DEFAULT;
+  builder->dictionary = NULL;
+  builder->stats = NULL;
+  builder->dedup_index = NULL;
+  builder->append = NULL;
+  builder->solid_block_size = 0;
+  builder->align_stored = false;
+  scratch_init(&builder->scratch[0]);
+  scratch_init(&builder->scratch[1]);
+
+  return builder;
+}
+
+CompressedArchiveBuilder* compressed_archive_builder_create(
+  const char* output_filename)
+{
+  if (output_filename == NULL)
+  {
+    return NULL;
+  }
+
+  CompressedArchiveBuilder* builder = builder_create(output_filename);
+  if (builder == NULL)
+  {
+    return NULL;
+  }
 
   Result result = file_open_for_write(builder->archive_file);
   if (result != RESULT_OK)
   {
-    file_table_destroy(builder->file_table);
-    file_destroy(builder->archive_file);
-    free(builder);
+    compressed_archive_builder_destroy(builder);
+    return NULL;
+  }
+
+  return builder;
+}
+
+static Result read_append_state(CompressedArchiveBuilder* self)
+{
+  AppendState* append = (AppendState*)calloc(1, sizeof(AppendState));
+  if (append == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+  self->append = append;
+
+  Result result =
+    compressed_archive_header_read(&append->header, self->archive_file);
+  if (result != RESULT_OK ||
+      !compressed_archive_header_is_valid(&append->header))
+  {
+    LOG_ERROR("Неверный заголовок архива!\n");
+    return RESULT_ERROR;
+  }
+
+  result = compressed_archive_read_table(&append->header, self->archive_file,
+                                         self->file_table,
+                                         &append->model_offset);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  result = file_seek(self->archive_file, 0, SEEK_END);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+  append->data_end = (QWord)file_tell(self->archive_file);
+
+  append->existing_count = file_table_get_count(self->file_table);
+  append->names = file_name_index_create(self->file_table);
+  if (append->names == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  LOG_INFO("Дозапись в архив: записей %u, алгоритм %s\n",
+           append->existing_count,
+           compressed_archive_algorithm_name(
+             append->header.primary_compression));
+  return RESULT_OK;
+}
+
+CompressedArchiveBuilder* compressed_archive_builder_open_append(
+  const char* archive_filename)
+{
+  if (archive_filename == NULL)
+  {
+    return NULL;
+  }
+
+  CompressedArchiveBuilder* builder = builder_create(archive_filename);
+  if (builder == NULL)
+  {
+    return NULL;
+  }
+
+  Result result = file_open_for_update(builder->archive_file);
+  if (result == RESULT_OK)
+  {
+    result = read_append_state(builder);
+  }
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Не удалось открыть архив для дозаписи: %s\n",
+              archive_filename);
+    compressed_archive_builder_destroy(builder);
     return NULL;
   }
 
@@ -114,57 +273,71 @@ Result compressed_archive_builder_set_algorithm(CompressedArchiveBuilder* self,
   {
     self->selected_algorithm = COMPRESSION_HUFFMAN;
     self->force_algorithm = true;
-    printf("Принудительно установлен основной алгоритм: HUFFMAN\n");
+    LOG_INFO("Принудительно установлен основной алгоритм: HUFFMAN\n");
   }
   else if (strcmp(algorithm, "arithmetic") == 0 ||
            strcmp(algorithm, "arith") == 0)
   {
     self->selected_algorithm = COMPRESSION_ARITHMETIC;
     self->force_algorithm = true;
-    printf("Принудительно установлен основной алгоритм: ARITHMETIC\n");
+    LOG_INFO("Принудительно установлен основной алгоритм: ARITHMETIC\n");
   }
   else if (strcmp(algorithm, "shannon") == 0 ||
            strcmp(algorithm, "shan") == 0 || strcmp(algorithm, "s") == 0)
   {
     self->selected_algorithm = COMPRESSION_SHANNON;
     self->force_algorithm = true;
-    printf("Принудительно установлен основной алгоритм: SHANNON\n");
+    LOG_INFO("Принудительно установлен основной алгоритм: SHANNON\n");
   }
   else if (strcmp(algorithm, "rle") == 0 || strcmp(algorithm, "r") == 0)
   {
     self->selected_algorithm = COMPRESSION_RLE;
+    self->rle_format = RLE_FORMAT_CLASSIC;
+    self->force_algorithm = true;
+    LOG_INFO("Принудительно установлен основной алгоритм: RLE\n");
+  }
+  else if (strcmp(algorithm, "rle-varint") == 0 ||
+           strcmp(algorithm, "rlev") == 0)
+  {
+    self->selected_algorithm = COMPRESSION_RLE;
+    self->rle_format = RLE_FORMAT_VARINT;
     self->force_algorithm = true;
-    printf("Принудительно установлен основной алгоритм: RLE\n");
+    LOG_INFO("Принудительно установлен основной алгоритм: RLE (varint)\n");
   }
   else if (strcmp(algorithm, "lz78") == 0)
   {
     self->selected_algorithm = COMPRESSION_LZ78;
     self->force_algorithm = true;
-    printf("Принудительно установлен основной алгоритм: LZ78\n");
+    LOG_INFO("Принудительно установлен основной алгоритм: LZ78\n");
   }
   else if (strcmp(algorithm, "lz77") == 0)
   {
     self->selected_algorithm = COMPRESSION_LZ77;
     self->force_algorithm = true;
-    printf("Принудительно установлен основной алгоритм: LZ77\n");
+    LOG_INFO("Принудительно установлен основной алгоритм: LZ77\n");
+  }
+  else if (strcmp(algorithm, "lzh") == 0)
+  {
+    self->selected_algorithm = COMPRESSION_LZH;
+    self->force_algorithm = true;
+    LOG_INFO("Принудительно установлен основной алгоритм: LZH\n");
   }
   else if (strcmp(algorithm, "none") == 0 || strcmp(algorithm, "n") == 0)
   {
     self->selected_algorithm = COMPRESSION_NONE;
     self->force_algorithm = true;
-    printf("Принудительно установлен основной алгоритм: NONE (без сжатия)\n");
+    LOG_INFO("Принудительно установлен основной алгоритм: NONE (без сжатия)\n");
   }
   else if (strcmp(algorithm, "auto") == 0 || strcmp(algorithm, "a") == 0)
   {
     self->selected_algorithm = COMPRESSION_NONE;
     self->force_algorithm = false;
-    printf("Установлен автоматический выбор основного алгоритма\n");
+    LOG_INFO("Установлен автоматический выбор основного алгоритма\n");
   }
   else
   {
-    printf(
-      "Неизвестный основной алгоритм: %s. Используется автоматический выбор.\n",
-      algorithm);
+    LOG_WARN("Неизвестный основной алгоритм: %s. Используется автоматический "
+             "выбор.\n", algorithm);
     self->force_algorithm = false;
   }
 
@@ -183,51 +356,62 @@ Result compressed_archive_builder_set_secondary_algorithm(
       strcmp(algorithm, "h") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_HUFFMAN;
-    printf("Установлен вторичный алгоритм: HUFFMAN\n");
+    LOG_INFO("Установлен вторичный алгоритм: HUFFMAN\n");
   }
   else if (strcmp(algorithm, "arithmetic") == 0 ||
            strcmp(algorithm, "arith") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_ARITHMETIC;
-    printf("Установлен вторичный алгоритм: ARITHMETIC\n");
+    LOG_INFO("Установлен вторичный алгоритм: ARITHMETIC\n");
   }
   else if (strcmp(algorithm, "shannon") == 0 ||
            strcmp(algorithm, "shan") == 0 || strcmp(algorithm, "s") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_SHANNON;
-    printf("Установлен вторичный алгоритм: SHANNON\n");
+    LOG_INFO("Установлен вторичный алгоритм: SHANNON\n");
   }
   else if (strcmp(algorithm, "rle") == 0 || strcmp(algorithm, "r") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_RLE;
-    printf("Установлен вторичный алгоритм: RLE\n");
+    self->rle_format = RLE_FORMAT_CLASSIC;
+    LOG_INFO("Установлен вторичный алгоритм: RLE\n");
+  }
+  else if (strcmp(algorithm, "rle-varint") == 0 ||
+           strcmp(algorithm, "rlev") == 0)
+  {
+    self->selected_secondary_algorithm = COMPRESSION_RLE;
+    self->rle_format = RLE_FORMAT_VARINT;
+    LOG_INFO("Установлен вторичный алгоритм: RLE (varint)\n");
   }
   else if (strcmp(algorithm, "lz78") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_LZ78;
-    printf("Установлен вторичный алгоритм: LZ78\n");
+    LOG_INFO("Установлен вторичный алгоритм: LZ78\n");
   }
   else if (strcmp(algorithm, "lz77") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_LZ77;
-    printf("Установлен вторичный алгоритм: LZ77\n");
+    LOG_INFO("Установлен вторичный алгоритм: LZ77\n");
+  }
+  else if (strcmp(algorithm, "lzh") == 0)
+  {
+    self->selected_secondary_algorithm = COMPRESSION_LZH;
+    LOG_INFO("Установлен вторичный алгоритм: LZH\n");
   }
   else if (strcmp(algorithm, "none") == 0 || strcmp(algorithm, "n") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_NONE;
-    printf("Установлен вторичный алгоритм: NONE\n");
+    LOG_INFO("Установлен вторичный алгоритм: NONE\n");
   }
   else if (strcmp(algorithm, "auto") == 0 || strcmp(algorithm, "a") == 0)
   {
     self->selected_secondary_algorithm = COMPRESSION_NONE;
-    printf("Установлен автоматический выбор вторичного алгоритма\n");
+    LOG_INFO("Установлен автоматический выбор вторичного алгоритма\n");
   }
   else
   {
-    printf(
-      "Неизвестный вторичный алгоритм: %s. Используется автоматический "
-      "выбор.\n",
-      algorithm);
+    LOG_WARN("Неизвестный вторичный алгоритм: %s. Используется автоматический "
+             "выбор.\n", algorithm);
     self->selected_secondary_algorithm = COMPRESSION_NONE;
   }
 
@@ -243,8 +427,130 @@ Result compressed_archive_builder_set_two_staged(CompressedArchiveBuilder* self,
   }
 
   self->use_two_stage_compression = enabled;
-  printf("Двухэтапное сжатие: %s\n", enabled ? "ВКЛЮЧЕНО" : "ВЫКЛЮЧЕНО");
+  LOG_INFO("Двухэтапное сжатие: %s\n", enabled ? "ВКЛЮЧЕНО" : "ВЫКЛЮЧЕНО");
+
+  return RESULT_OK;
+}
+
+Result compressed_archive_builder_set_level(CompressedArchiveBuilder* self,
+                                            int level)
+{
+  if (self == NULL || level < COMPRESSED_ARCHIVE_LEVEL_MIN ||
+      level > COMPRESSED_ARCHIVE_LEVEL_MAX)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->level = (Byte)level;
+  LOG_INFO("Уровень сжатия: %d\n", level);
+
+  return RESULT_OK;
+}
+
+Result compressed_archive_builder_set_dictionary(
+  CompressedArchiveBuilder* self, const Dictionary* dictionary)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->dictionary = dictionary;
+  if (dictionary != NULL)
+  {
+    LOG_INFO("Словарь: %08X, окно %zu байт\n", dictionary_get_hash(dictionary),
+             dictionary_get_window_size(dictionary));
+  }
+
+  return RESULT_OK;
+}
+
+Result compressed_archive_builder_set_dedup(CompressedArchiveBuilder* self,
+                                            bool enabled)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  DWord existing_count =
+    self->append != NULL ? self->append->existing_count : 0;
+  if (file_table_get_count(self->file_table) > existing_count)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (enabled && self->dedup_index == NULL)
+  {
+    self->dedup_index = dedup_index_create();
+    if (self->dedup_index == NULL)
+    {
+      return RESULT_MEMORY_ERROR;
+    }
+  }
+  else if (!enabled)
+  {
+    dedup_index_destroy(self->dedup_index);
+    self->dedup_index = NULL;
+  }
+
+  LOG_INFO("Дедупликация: %s\n", enabled ? "ВКЛЮЧЕНА" : "ВЫКЛЮЧЕНА");
+  return RESULT_OK;
+}
+
+Result compressed_archive_builder_set_solid_block_size(
+  CompressedArchiveBuilder* self, Size block_size)
+{
+  if (self == NULL || block_size > COMPRESSED_ARCHIVE_SOLID_BLOCK_MAX)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->solid_block_size = block_size;
+  if (block_size > 0)
+  {
+    LOG_INFO("Сплошные блоки: до %zu байт\n", block_size);
+  }
+  return RESULT_OK;
+}
+
+Result compressed_archive_builder_set_alignment(CompressedArchiveBuilder* self,
+                                               bool align_stored)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
 
+  self->align_stored = align_stored;
+  return RESULT_OK;
+}
+
+Result compressed_archive_builder_set_volume_size(
+  CompressedArchiveBuilder* self, QWord volume_size)
+{
+  if (self == NULL || self->append != NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Result result = file_split_volumes(self->archive_file, volume_size);
+  if (result == RESULT_OK)
+  {
+    LOG_INFO("Тома: по %llu байт\n", (unsigned long long)volume_size);
+  }
+  return result;
+}
+
+Result compressed_archive_builder_set_stats(CompressedArchiveBuilder* self,
+                                            Stats* stats)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->stats = stats;
   return RESULT_OK;
 }
 
@@ -255,6 +561,17 @@ void compressed_archive_builder_destroy(CompressedArchiveBuilder* self)
     return;
   }
 
+  scratch_free(&self->scratch[0]);
+  scratch_free(&self->scratch[1]);
+  directory_walker_destroy(self->walker);
+  crc32_table_destroy(self->crc32_table);
+  dedup_index_destroy(self->dedup_index);
+  if (self->append != NULL)
+  {
+    file_name_index_destroy(self->append->names);
+    free(self->append);
+  }
+
   file_table_destroy(self->file_table);
   file_close(self->archive_file);
   file_destroy(self->archive_file);
@@ -264,9 +581,9 @@ void compressed_archive_builder_destroy(CompressedArchiveBuilder* self)
 static Result append_to_buffer(CompressedArchiveBuilder* self, const Byte* data,
                                Size size)
 {
-  printf("Добавление %zu байт в буфер для построения модели\n", size);
-  printf("Текущий размер буфера: %zu, capacity: %zu\n", self->all_data_size,
-         self->all_data_capacity);
+  LOG_DEBUG("Добавление %zu байт в буфер для построения модели\n", size);
+  LOG_DEBUG("Текущий размер буфера: %zu, capacity: %zu\n", self->all_data_size,
+            self->all_data_capacity);
 
   if (self->all_data_size + size > self->all_data_capacity)
   {
@@ -282,12 +599,12 @@ static Result append_to_buffer(CompressedArchiveBuilder* self, const Byte* data,
       new_capacity = self->all_data_size + size;
     }
 
-    printf("Увеличиваем capacity до %zu\n", new_capacity);
+    LOG_DEBUG("Увеличиваем capacity до %zu\n", new_capacity);
 
     Byte* new_data = realloc(self->all_data, new_capacity);
     if (!new_data)
     {
-      printf("Ошибка перевыделения памяти для буфера данных!\n");
+      LOG_ERROR("Ошибка перевыделения памяти для буфера данных!\n");
       return RESULT_MEMORY_ERROR;
     }
 
@@ -298,22 +615,171 @@ static Result append_to_buffer(CompressedArchiveBuilder* self, const Byte* data,
   memcpy(self->all_data + self->all_data_size, data, size);
   self->all_data_size += size;
 
-  printf("Новый размер буфера: %zu байт\n", self->all_data_size);
+  LOG_DEBUG("Новый размер буфера: %zu байт\n", self->all_data_size);
   return RESULT_OK;
 }
 
-Result compressed_archive_builder_add_file(CompressedArchiveBuilder* self,
-                                           const char* filename)
+static Result append_chunk_run(FileChunkRun** runs, DWord* count,
+                               DWord* capacity, const FileChunkRun* run)
 {
-  if (self == NULL || filename == NULL)
+  if (*count >= *capacity)
   {
-    return RESULT_INVALID_ARGUMENT;
+    DWord new_capacity = *capacity == 0 ? 16 : *capacity * 2;
+    FileChunkRun* new_runs =
+      (FileChunkRun*)realloc(*runs, sizeof(FileChunkRun) * new_capacity);
+    if (new_runs == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при перевыделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    *runs = new_runs;
+    *capacity = new_capacity;
   }
 
-  struct stat stats;
-  if (stat(filename, &stats) != 0)
+  (*runs)[(*count)++] = *run;
+  return RESULT_OK;
+}
+
+// Буфер данных для построения модели служит и хранилищем чанков: в него
+// дописываются только новые чанки, поэтому совпадения сверяются прямо по
+// нему, а модель строится по данным, которые действительно будут сжаты.
+// Соседние участки одного вида склеиваются, новые и повторные - нет: иначе
+// при чтении карты новые данные не отличить от ссылок
+static Result append_deduplicated(CompressedArchiveBuilder* self,
+                                  DWord entry_index, const Byte* data,
+                                  Size size)
+{
+  Size stored_start = self->all_data_size;
+  FileChunkRun* runs = NULL;
+  DWord run_count = 0;
+  DWord run_capacity = 0;
+  bool last_novel = false;
+  Result result = RESULT_OK;
+
+  for (Size position = 0; position < size && result == RESULT_OK;)
+  {
+    const Byte* chunk = data + position;
+    Size length =
+      dedup_index_next_chunk(self->dedup_index, chunk, size - position);
+    QWord hash = dedup_index_hash(chunk, length);
+    const DedupChunk* found = dedup_index_find(self->dedup_index, hash, chunk,
+                                               length, self->all_data);
+
+    FileChunkRun run;
+    bool novel = found == NULL;
+    if (novel)
+    {
+      DedupChunk stored = {entry_index, self->all_data_size - stored_start,
+                           self->all_data_size};
+      run.source_index = entry_index;
+      run.offset = stored.offset;
+      result = dedup_index_add(self->dedup_index, hash, length, &stored);
+      if (result == RESULT_OK)
+      {
+        result = append_to_buffer(self, chunk, length);
+      }
+    }
+    else
+    {
+      run.source_index = found->entry_index;
+      run.offset = found->offset;
+    }
+    run.length = length;
+
+    FileChunkRun* last = run_count > 0 ? &runs[run_count - 1] : NULL;
+    if (result == RESULT_OK && last != NULL && novel == last_novel &&
+        last->source_index == run.source_index &&
+        last->offset + last->length == run.offset)
+    {
+      last->length += length;
+    }
+    else if (result == RESULT_OK)
+    {
+      result = append_chunk_run(&runs, &run_count, &run_capacity, &run);
+    }
+
+    last_novel = novel;
+    position += length;
+  }
+
+  // Карта нужна, только если нашлись повторы
+  if (result == RESULT_OK && self->all_data_size - stored_start < size)
+  {
+    result = file_table_set_dedup_map(self->file_table, entry_index, size,
+                                      runs, run_count);
+    runs = result == RESULT_OK ? NULL : runs;
+  }
+
+  free(runs);
+  return result;
+}
+
+// CRC считается по данным файла без дыр, до дедупликации: это то, что
+// читатель собирает перед записью файла
+static Result update_entry_crc(CompressedArchiveBuilder* self,
+                               FileEntry* entry, const Byte* data, Size size)
+{
+  entry->crc = 0;
+  if (size == 0)
+  {
+    return RESULT_OK;
+  }
+
+  Result result = crc32_table_calculate(self->crc32_table, data, size);
+  if (result == RESULT_OK)
+  {
+    entry->crc = crc32_table_get_crc32(self->crc32_table);
+  }
+  return result;
+}
+
+// При дозаписи файл с тем же именем, размером и временем изменения, что и
+// у последней его записи в архиве, не добавляется
+static bool is_unchanged(const CompressedArchiveBuilder* self,
+                         const char* filename, QWord file_size, QWord mtime)
+{
+  DWord index = file_name_index_find(self->append->names, filename);
+  if (index == FILE_TABLE_NO_ENTRY)
+  {
+    return false;
+  }
+
+  QWord stored_mtime = file_table_get_mtime(self->file_table, index);
+  return stored_mtime != 0 && stored_mtime == mtime &&
+         file_table_get_file_size(self->file_table, index) == file_size;
+}
+
+// Размер и время изменения уже известны вызывающему коду (stat или обход
+// директории)
+static Result add_file_data(CompressedArchiveBuilder* self,
+                            const char* filename, QWord file_size, QWord mtime)
+{
+  if (self->append != NULL && is_unchanged(self, filename, file_size, mtime))
+  {
+    LOG_DEBUG("  Не изменился: %s\n", filename);
+    return RESULT_OK;
+  }
+
+  Result result = file_table_add_file(self->file_table, filename, file_size);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  DWord entry_index = file_table_get_count(self->file_table) - 1;
+  result = file_table_set_mtime(self->file_table, entry_index, mtime);
+  if (result != RESULT_OK)
   {
-    return RESULT_IO_ERROR;
+    return result;
+  }
+
+  // При дозаписи модели архива уже построены, данные заранее нужны только
+  // дедупликации
+  if (self->append != NULL && self->dedup_index == NULL)
+  {
+    LOG_INFO("  Добавлен: %s\n", filename);
+    return RESULT_OK;
   }
 
   File* file = file_create(filename);
@@ -323,23 +789,31 @@ Result compressed_archive_builder_add_file(CompressedArchiveBuilder* self,
     return RESULT_MEMORY_ERROR;
   }
 
-  Result result = file_open_for_read(file);
+  result = file_open_for_read(file);
   if (result != RESULT_OK)
   {
     file_destroy(file);
     return result;
   }
 
-  result = file_read_bytes(file);
+  result = file_table_read_entry_data(self->file_table, entry_index, file);
   if (result == RESULT_OK)
   {
     const Byte* data = file_get_buffer(file);
     Size size = file_get_size(file);
 
-    result = append_to_buffer(self, data, size);
+    result = update_entry_crc(
+      self, (FileEntry*)file_table_get_entry(self->file_table, entry_index),
+      data, size);
+    if (result == RESULT_OK)
+    {
+      result = self->dedup_index != NULL
+                 ? append_deduplicated(self, entry_index, data, size)
+                 : append_to_buffer(self, data, size);
+    }
     if (result != RESULT_OK)
     {
-      printf("Ошибка добавления данных в буфер для построения модели!\n");
+      LOG_ERROR("Ошибка добавления данных в буфер для построения модели!\n");
       file_close(file);
       file_destroy(file);
       return result;
@@ -349,12 +823,32 @@ Result compressed_archive_builder_add_file(CompressedArchiveBuilder* self,
   file_close(file);
   file_destroy(file);
 
-  if (result != RESULT_OK)
+  return result;
+}
+
+Result compressed_archive_builder_add_file(CompressedArchiveBuilder* self,
+                                           const char* filename)
+{
+  if (self == NULL || filename == NULL)
   {
-    return result;
+    return RESULT_INVALID_ARGUMENT;
   }
 
-  return file_table_add_file(self->file_table, filename, stats.st_size);
+  StatsSpan span;
+  Size size_before = self->all_data_size;
+  stats_span_begin(self->stats, &span, STATS_STAGE_WALK, NULL);
+
+  struct stat stats;
+  Result result = RESULT_IO_ERROR;
+  if (stat(filename, &stats) == 0)
+  {
+    QWord mtime = (QWord)stats.st_mtim.tv_sec * 1000000000ULL +
+                  (QWord)stats.st_mtim.tv_nsec;
+    result = add_file_data(self, filename, stats.st_size, mtime);
+  }
+
+  stats_span_end(self->stats, &span, self->all_data_size - size_before, 0);
+  return result;
 }
 
 static Result process_directory(CompressedArchiveBuilder* self,
@@ -368,125 +862,54 @@ Result compressed_archive_builder_add_directory(CompressedArchiveBuilder* self,
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("Добавление директории: %s (рекурсивно с сбором данных)\n", dirname);
+  LOG_INFO("Добавление директории: %s (рекурсивно с сбором данных)\n", dirname);
 
-  return process_directory(self, dirname);
+  StatsSpan span;
+  Size size_before = self->all_data_size;
+  stats_span_begin(self->stats, &span, STATS_STAGE_WALK, NULL);
+
+  Result result = process_directory(self, dirname);
+
+  stats_span_end(self->stats, &span, self->all_data_size - size_before, 0);
+  return result;
 }
 
+// Обход собирает список заранее, данные читаются по нему в порядке
+// обхода, поэтому содержимое архива не зависит от числа потоков
 static Result process_directory(CompressedArchiveBuilder* self,
                                 const char* dirname)
 {
-  DIR* directory = opendir(dirname);
-
-  if (directory == NULL)
+  Result result = directory_walker_walk(self->walker, dirname, true);
+  if (result != RESULT_OK)
   {
-    printf("Ошибка открытия директории: %s\n", dirname);
-    return RESULT_IO_ERROR;
+    LOG_ERROR("Ошибка обхода директории: %s\n", dirname);
+    return result;
   }
 
-  struct dirent* entry;
-  while ((entry = readdir(directory)) != NULL)
+  for (Size i = 0; i < directory_walker_get_count(self->walker); i++)
   {
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+    const DirectoryWalkEntry* entry =
+      directory_walker_get_entry(self->walker, i);
+    if (entry->is_directory)
     {
       continue;
     }
 
-    char* full_path = path_utils_join(dirname, entry->d_name);
-    if (full_path == NULL)
-    {
-      closedir(directory);
-      return RESULT_MEMORY_ERROR;
-    }
-
-    printf("  Обработка: %s\n", full_path);
-
-    if (entry->d_type == DT_DIR)
-    {
-      Result result = process_directory(self, full_path);
-      if (result != RESULT_OK)
-      {
-        free(full_path);
-        closedir(directory);
-        return result;
-      }
-    }
-    else
+    LOG_DEBUG("  Обработка: %s (%llu байт)\n", entry->path,
+              (unsigned long long)entry->size);
+    result = add_file_data(self, entry->path, entry->size, entry->mtime);
+    if (result != RESULT_OK)
     {
-      struct stat stats;
-      if (stat(full_path, &stats) != 0)
-      {
-        printf("    Ошибка получения информации о файле: %s\n", full_path);
-        free(full_path);
-        closedir(directory);
-        return RESULT_IO_ERROR;
-      }
-
-      Result result =
-        file_table_add_file(self->file_table, full_path, stats.st_size);
-      if (result != RESULT_OK)
-      {
-        printf("    Ошибка добавления файла в таблицу: %s\n", full_path);
-        free(full_path);
-        closedir(directory);
-        return result;
-      }
-
-      File* file = file_create(full_path);
-      if (!file)
-      {
-        printf("    Ошибка создания объекта файла: %s\n", full_path);
-        free(full_path);
-        closedir(directory);
-        return RESULT_MEMORY_ERROR;
-      }
-
-      result = file_open_for_read(file);
-      if (result != RESULT_OK)
-      {
-        printf("    Ошибка открытия файла: %s\n", full_path);
-        file_destroy(file);
-        free(full_path);
-        closedir(directory);
-        return result;
-      }
-
-      result = file_read_bytes(file);
-      if (result == RESULT_OK)
-      {
-        const Byte* data = file_get_buffer(file);
-        Size size = file_get_size(file);
-
-        printf("    Чтение %zu байт из файла\n", size);
-        result = append_to_buffer(self, data, size);
-        if (result != RESULT_OK)
-        {
-          printf("    Ошибка добавления данных в буфер модели\n");
-          file_close(file);
-          file_destroy(file);
-          free(full_path);
-          closedir(directory);
-          return result;
-        }
-      }
-      else
-      {
-        printf("    Ошибка чтения файла: %s\n", full_path);
-      }
-
-      file_close(file);
-      file_destroy(file);
-      printf("    Файл успешно обработан: %s\n", full_path);
+      LOG_ERROR("    Ошибка добавления файла: %s\n", entry->path);
+      return result;
     }
-
-    free(full_path);
   }
 
-  closedir(directory);
   return RESULT_OK;
 }
 
-static Result write_file_data(File* archive_file, const char* filename)
+static Result write_file_data(File* archive_file, const FileTable* file_table,
+                              DWord index, const char* filename)
 {
   File* input_file = file_create(filename);
   if (input_file == NULL)
@@ -501,7 +924,7 @@ static Result write_file_data(File* archive_file, const char* filename)
     return result;
   }
 
-  result = file_read_bytes(input_file);
+  result = file_table_read_entry_data(file_table, index, input_file);
   if (result != RESULT_OK)
   {
     file_close(input_file);
@@ -516,8 +939,58 @@ static Result write_file_data(File* archive_file, const char* filename)
   return result;
 }
 
-static Result compress_file_data(const char* filename,
-                                 CompressionAlgorithm algorithm,
+// Несжатая запись не меньше блока начинается с его границы, чтобы читатель
+// на той же файловой системе мог клонировать ее в файл. alignment == 0
+// оставляет смещение как есть
+static QWord align_stored_offset(QWord offset, QWord size, Size alignment)
+{
+  if (alignment == 0 || size < alignment)
+  {
+    return offset;
+  }
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Частоты модели архива для Хаффмана и Шеннона приводятся к общему итогу
+// словаря, и у каждого символа частота не меньше 1, как у словаря: иначе
+// дозапись не сожмет байт, которого не было в исходных данных
+static void count_model_frequencies(const Byte* data, Size size,
+                                    DWord* frequencies)
+{
+  QWord counts[DICTIONARY_SYMBOLS] = {0};
+  for (Size i = 0; i < size; i++)
+  {
+    counts[data[i]]++;
+  }
+
+  for (Size i = 0; i < DICTIONARY_SYMBOLS; i++)
+  {
+    QWord frequency =
+      size > 0 ? counts[i] * DICTIONARY_FREQUENCY_TOTAL / size : 0;
+    frequencies[i] = frequency > 0 ? (DWord)frequency : 1;
+  }
+}
+
+static Result build_huffman_model(HuffmanTree* tree, const Byte* data,
+                                  Size size)
+{
+  DWord frequencies[DICTIONARY_SYMBOLS];
+  count_model_frequencies(data, size, frequencies);
+  return huffman_tree_build_from_frequencies(tree, frequencies);
+}
+
+static Result build_shannon_model(ShannonTree* tree, const Byte* data,
+                                  Size size)
+{
+  DWord frequencies[DICTIONARY_SYMBOLS];
+  count_model_frequencies(data, size, frequencies);
+  return shannon_tree_build_from_frequencies(tree, frequencies);
+}
+
+static Result compress_file_data(const FileTable* file_table, DWord index,
+                                 const char* filename,
+                                 CompressionAlgorithm algorithm, Byte level,
+                                 const Dictionary* dictionary,
                                  const Byte* all_data, Size all_data_size,
                                  CompressedFileData* compressed_data)
 {
@@ -534,7 +1007,7 @@ static Result compress_file_data(const char* filename,
     return result;
   }
 
-  result = file_read_bytes(input_file);
+  result = file_table_read_entry_data(file_table, index, input_file);
   if (result != RESULT_OK)
   {
     file_close(input_file);
@@ -551,7 +1024,19 @@ static Result compress_file_data(const char* filename,
   {
     HuffmanTree* tree = NULL;
 
-    if (all_data && all_data_size > 0)
+    if (dictionary)
+    {
+      tree = huffman_tree_create();
+      if (tree == NULL)
+      {
+        file_close(input_file);
+        file_destroy(input_file);
+        return RESULT_MEMORY_ERROR;
+      }
+      result = huffman_tree_build_from_frequencies(
+        tree, dictionary_get_frequencies(dictionary));
+    }
+    else if (all_data && all_data_size > 0)
     {
       tree = huffman_tree_create();
       if (tree == NULL)
@@ -560,7 +1045,7 @@ static Result compress_file_data(const char* filename,
         file_destroy(input_file);
         return RESULT_MEMORY_ERROR;
       }
-      result = huffman_tree_build(tree, all_data, all_data_size);
+      result = build_huffman_model(tree, all_data, all_data_size);
     }
     else
     {
@@ -571,7 +1056,7 @@ static Result compress_file_data(const char* filename,
         file_destroy(input_file);
         return RESULT_MEMORY_ERROR;
       }
-      result = huffman_tree_build(tree, original_data, original_size);
+      result = build_huffman_model(tree, original_data, original_size);
     }
 
     if (result != RESULT_OK)
@@ -609,7 +1094,12 @@ static Result compress_file_data(const char* filename,
       return RESULT_MEMORY_ERROR;
     }
 
-    if (all_data && all_data_size > 0)
+    if (dictionary)
+    {
+      result = arithmetic_model_build_from_frequencies(
+        model, dictionary_get_frequencies(dictionary));
+    }
+    else if (all_data && all_data_size > 0)
     {
       result = arithmetic_model_build(model, all_data, all_data_size);
     }
@@ -649,13 +1139,18 @@ static Result compress_file_data(const char* filename,
       return RESULT_MEMORY_ERROR;
     }
 
-    if (all_data && all_data_size > 0)
+    if (dictionary)
     {
-      result = shannon_tree_build(tree, all_data, all_data_size);
+      result = shannon_tree_build_from_frequencies(
+        tree, dictionary_get_frequencies(dictionary));
+    }
+    else if (all_data && all_data_size > 0)
+    {
+      result = build_shannon_model(tree, all_data, all_data_size);
     }
     else
     {
-      result = shannon_tree_build(tree, original_data, original_size);
+      result = build_shannon_model(tree, original_data, original_size);
     }
 
     if (result != RESULT_OK)
@@ -741,6 +1236,16 @@ static Result compress_file_data(const char* filename,
       compressed_data->tree_model_size = 0;
     }
   }
+  else if (algorithm == COMPRESSION_LZH)
+  {
+    // Коды LZH хранятся в заголовках блоков сжатых данных, окно словаря
+    // (если есть) считается предшествующими данными
+    result = lzh_compress_with_dictionary(
+      original_data, original_size, dictionary_get_window(dictionary),
+      dictionary_get_window_size(dictionary),
+      &compressed_data->compressed_data, &compressed_data->compressed_size,
+      level);
+  }
   else if (algorithm == COMPRESSION_LZ77)
   {
     // LZ77 использует префикс p
@@ -757,7 +1262,7 @@ static Result compress_file_data(const char* filename,
       prefix = lz77_analyze_prefix(original_data, original_size);
     }
 
-    printf("[LZ77] Используется префикс: 0x%02X\n", prefix);
+    LOG_DEBUG("[LZ77] Используется префикс: 0x%02X\n", prefix);
 
     // Сжимаем данные с LZ77
     result = lz77_compress(original_data, original_size,
@@ -782,7 +1287,7 @@ static Result compress_file_data(const char* filename,
 
     if (compressed_data->compressed_data == NULL)
     {
-      printf("Произошла ошибка при выделении памяти!\n");
+      LOG_ERROR("Произошла ошибка при выделении памяти!\n");
       file_close(input_file);
       file_destroy(input_file);
       return RESULT_MEMORY_ERROR;
@@ -850,425 +1355,787 @@ static void free_compressed_file_data(CompressedFileData* data,
   }
 }
 
-// Функция для двухэтапного сжатия
-static Result apply_two_stage_compression(
-  const Byte* input, Size input_size, Byte** output, Size* output_size,
-  CompressionAlgorithm primary_algo, CompressionAlgorithm secondary_algo,
-  const Byte* context_data, Size context_size, CompressedFileData* primary_data,
-  CompressedFileData* secondary_data, bool* primary_failed)
+static Size compress_bound(CompressionAlgorithm algorithm, Size input_size)
 {
-  printf("[TWO-STAGE] Начало двухэтапного сжатия\n");
-  printf("[TWO-STAGE] Исходный размер: %zu байт\n", input_size);
-  printf("[TWO-STAGE] Первичный алгоритм: %s\n",
-         primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-         : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-         : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-         : primary_algo == COMPRESSION_RLE        ? "RLE"
-         : primary_algo == COMPRESSION_LZ78       ? "LZ78"
-         : primary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                  : "NONE");
-  printf("[TWO-STAGE] Вторичный алгоритм: %s\n",
-         secondary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-         : secondary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-         : secondary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-         : secondary_algo == COMPRESSION_RLE        ? "RLE"
-         : secondary_algo == COMPRESSION_LZ78       ? "LZ78"
-         : secondary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                    : "NONE");
+  switch (algorithm)
+  {
+    case COMPRESSION_HUFFMAN:
+      return huffman_compress_bound(input_size);
+    case COMPRESSION_ARITHMETIC:
+      return arithmetic_compress_bound(input_size);
+    case COMPRESSION_SHANNON:
+      return shannon_compress_bound(input_size);
+    case COMPRESSION_RLE:
+      return rle_compress_bound(input_size);
+    case COMPRESSION_LZ78:
+      return lz78_compress_bound(input_size);
+    case COMPRESSION_LZ77:
+      return lz77_compress_bound(input_size);
+    case COMPRESSION_LZH:
+      return lzh_compress_bound(input_size);
+    default:
+      return input_size;
+  }
+}
 
-  Result result = RESULT_OK;
-  Byte* stage1_output = NULL;
-  Size stage1_size = 0;
+// Сжатие одного этапа в буфер вызывающего кода. context - дерево/модель
+// алгоритма, для LZ77 - указатель на префикс, для LZH - LZHStageContext,
+// для LZ78 не нужен
+static Result compress_stage(CompressionAlgorithm algorithm,
+                             const void* context, const Byte* input,
+                             Size input_size, Byte* output,
+                             Size output_capacity, Size* output_size)
+{
+  switch (algorithm)
+  {
+    case COMPRESSION_HUFFMAN:
+      return huffman_compress_into(input, input_size, output, output_capacity,
+                                   output_size, (const HuffmanTree*)context);
+    case COMPRESSION_ARITHMETIC:
+      return arithmetic_compress_into(input, input_size, output,
+                                      output_capacity, output_size,
+                                      (const ArithmeticModel*)context);
+    case COMPRESSION_SHANNON:
+      return shannon_compress_into(input, input_size, output, output_capacity,
+                                   output_size, (const ShannonTree*)context);
+    case COMPRESSION_RLE:
+      return rle_compress_into(input, input_size, output, output_capacity,
+                               output_size, (const RLEContext*)context);
+    case COMPRESSION_LZ78:
+      return lz78_compress_into(input, input_size, output, output_capacity,
+                                output_size);
+    case COMPRESSION_LZ77:
+      return lz77_compress_into(input, input_size, output, output_capacity,
+                                output_size, *(const Byte*)context);
+    case COMPRESSION_LZH:
+    {
+      const LZHStageContext* lzh = (const LZHStageContext*)context;
+      return lzh_compress_into_with_dictionary(
+        input, input_size, lzh->window, lzh->window_size, output,
+        output_capacity, output_size, lzh->level);
+    }
+    default:
+      return RESULT_INVALID_ARGUMENT;
+  }
+}
+
+static void write_frame_dword(Byte* buffer, DWord value)
+{
+  memcpy(buffer, &value, sizeof(DWord));
+}
 
-  if (primary_failed)
+// Двухэтапное сжатие блоками: каждый блок проходит оба этапа подряд, поэтому
+// промежуточные буферы сборщика имеют размер блока, а не файла. Формат
+// кадров описан у TWO_STAGE_CHUNK_SIZE. secondary_rle_context нужен только
+// для вторичного RLE: префикс в нем подбирается заново для каждого блока
+static Result apply_two_stage_compression(
+  CompressedArchiveBuilder* self, const Byte* input, Size input_size,
+  Byte** output, Size* output_size, CompressionAlgorithm primary_algo,
+  const void* primary_context, CompressionAlgorithm secondary_algo,
+  RLEContext* secondary_rle_context)
+{
+  LOG_DEBUG("[TWO-STAGE] Начало двухэтапного сжатия\n");
+  LOG_DEBUG("[TWO-STAGE] Исходный размер: %zu байт\n", input_size);
+  LOG_DEBUG("[TWO-STAGE] Этапы: %s -> %s\n",
+            compressed_archive_algorithm_name(primary_algo),
+            compressed_archive_algorithm_name(secondary_algo));
+
+  bool use_primary = primary_algo != COMPRESSION_NONE &&
+                     (primary_context != NULL ||
+                      primary_algo == COMPRESSION_LZ78);
+  // Вторичный LZH сжимает выход первичного этапа, окно словаря ему не
+  // подходит
+  LZHStageContext secondary_lzh = {self->level, NULL, 0};
+  bool use_secondary = secondary_algo == COMPRESSION_LZ78 ||
+                       secondary_algo == COMPRESSION_LZ77 ||
+                       secondary_algo == COMPRESSION_LZH ||
+                       (secondary_algo == COMPRESSION_RLE &&
+                        secondary_rle_context != NULL);
+
+  // Этап, не уменьшивший блок, пропускается, поэтому данные кадра не
+  // длиннее исходного блока
+  Size frame_count = (input_size + TWO_STAGE_CHUNK_SIZE - 1) /
+                     TWO_STAGE_CHUNK_SIZE;
+  Size capacity = input_size + frame_count * TWO_STAGE_FRAME_HEADER_SIZE;
+  Byte* compressed = (Byte*)malloc(capacity > 0 ? capacity : 1);
+  if (compressed == NULL)
   {
-    *primary_failed = false;
+    return RESULT_MEMORY_ERROR;
   }
 
-  // Этап 1: Первичное сжатие (с контекстом)
-  if (primary_algo != COMPRESSION_NONE)
+  Size position = 0;
+  Size compressed_size = 0;
+  Size total_stage_size = 0;
+
+  while (position < input_size)
   {
-    // ИСПРАВЛЕНИЕ: Прямое сжатие входных данных, а не чтение из файла
-    if (primary_algo == COMPRESSION_HUFFMAN)
+    Size raw_size = input_size - position;
+    if (raw_size > TWO_STAGE_CHUNK_SIZE)
     {
-      HuffmanTree* tree = huffman_tree_create();
-      if (tree == NULL)
+      raw_size = TWO_STAGE_CHUNK_SIZE;
+    }
+
+    const Byte* raw = input + position;
+    const Byte* stage = raw;
+    Size stage_size = raw_size;
+    Byte flags = 0;
+    Byte parameter = 0;
+
+    // Этап 1: результат блока сразу идет на вход этапа 2
+    if (use_primary)
+    {
+      Size stage_capacity = compress_bound(primary_algo, raw_size);
+      Byte* buffer = scratch_reserve(&self->scratch[0], stage_capacity);
+      if (buffer == NULL)
       {
+        free(compressed);
         return RESULT_MEMORY_ERROR;
       }
 
-      // Строим дерево на основе глобальных данных (контекста)
-      if (context_data && context_size > 0)
-      {
-        result = huffman_tree_build(tree, context_data, context_size);
-      }
-      else
+      Size size = 0;
+      if (compress_stage(primary_algo, primary_context, raw, raw_size, buffer,
+                         stage_capacity, &size) == RESULT_OK &&
+          size < raw_size)
       {
-        // Если нет глобальных данных, используем входные данные
-        result = huffman_tree_build(tree, input, input_size);
+        stage = buffer;
+        stage_size = size;
+        flags |= TWO_STAGE_FRAME_PRIMARY;
       }
+    }
 
-      if (result == RESULT_OK)
-      {
-        // Сжимаем входные данные
-        result = huffman_compress(input, input_size, &stage1_output,
-                                  &stage1_size, tree);
-
-        if (result == RESULT_OK && primary_data)
-        {
-          primary_data->algorithm = COMPRESSION_HUFFMAN;
-          primary_data->huffman_tree = tree;
+    const Byte* stored = stage;
+    Size stored_size = stage_size;
 
-          // Сериализуем дерево для сохранения в архив
-          result = huffman_serialize_tree(tree, &primary_data->tree_model_data,
-                                          &primary_data->tree_model_size);
-        }
-        else
-        {
-          huffman_tree_destroy(tree);
-        }
+    // Этап 2
+    if (use_secondary)
+    {
+      const void* context = NULL;
+      if (secondary_algo == COMPRESSION_RLE)
+      {
+        parameter = rle_analyze_prefix(stage, stage_size);
+        rle_set_prefix(secondary_rle_context, parameter);
+        context = secondary_rle_context;
       }
-      else
+      else if (secondary_algo == COMPRESSION_LZ77)
       {
-        huffman_tree_destroy(tree);
+        parameter = lz77_analyze_prefix(stage, stage_size);
+        context = &parameter;
       }
-    }
-    else if (primary_algo == COMPRESSION_ARITHMETIC)
-    {
-      ArithmeticModel* model = arithmetic_model_create();
-      if (model == NULL)
+      else if (secondary_algo == COMPRESSION_LZH)
       {
-        return RESULT_MEMORY_ERROR;
+        context = &secondary_lzh;
       }
 
-      // Строим модель на основе глобальных данных (контекста)
-      if (context_data && context_size > 0)
+      Size stage_capacity = compress_bound(secondary_algo, stage_size);
+      Byte* buffer = scratch_reserve(&self->scratch[1], stage_capacity);
+      if (buffer == NULL)
       {
-        result = arithmetic_model_build(model, context_data, context_size);
+        free(compressed);
+        return RESULT_MEMORY_ERROR;
       }
-      else
+
+      Size size = 0;
+      if (compress_stage(secondary_algo, context, stage, stage_size, buffer,
+                         stage_capacity, &size) == RESULT_OK &&
+          size < stage_size)
       {
-        // Если нет глобальных данных, используем входные данные
-        result = arithmetic_model_build(model, input, input_size);
+        stored = buffer;
+        stored_size = size;
+        flags |= TWO_STAGE_FRAME_SECONDARY;
       }
+    }
 
-      if (result == RESULT_OK)
-      {
-        // Сжимаем входные данные
-        result = arithmetic_compress(input, input_size, &stage1_output,
-                                     &stage1_size, model);
+    Byte* frame = compressed + compressed_size;
+    write_frame_dword(frame, (DWord)raw_size);
+    write_frame_dword(frame + 4, (DWord)stage_size);
+    write_frame_dword(frame + 8, (DWord)stored_size);
+    frame[12] = flags;
+    frame[13] = parameter;
+    memcpy(frame + TWO_STAGE_FRAME_HEADER_SIZE, stored, stored_size);
 
-        if (result == RESULT_OK && primary_data)
-        {
-          primary_data->algorithm = COMPRESSION_ARITHMETIC;
-          primary_data->arithmetic_model = model;
+    compressed_size += TWO_STAGE_FRAME_HEADER_SIZE + stored_size;
+    total_stage_size += stage_size;
+    position += raw_size;
+  }
 
-          // Сериализуем модель для сохранения в архив
-          result =
-            arithmetic_serialize_model(model, &primary_data->tree_model_data,
-                                       &primary_data->tree_model_size);
-        }
-        else
-        {
-          arithmetic_model_destroy(model);
-        }
-      }
-      else
+  LOG_DEBUG("[TWO-STAGE] Блоков: %zu, после этапа 1: %zu байт, итог: %zu "
+            "байт\n", frame_count, total_stage_size, compressed_size);
+
+  // Буфер рассчитан на худший случай, лишний хвост возвращается системе
+  Byte* shrunk = (Byte*)realloc(compressed, compressed_size);
+  *output = shrunk ? shrunk : compressed;
+  *output_size = compressed_size;
+  return RESULT_OK;
+}
+
+// Подряд идущие записи меньше размера блока объединяются в сплошные блоки
+// до этого размера. Пустая запись блок не начинает, а блок из одной записи
+// не создается: сжимать ее отдельно не хуже
+static Result group_solid_blocks(CompressedArchiveBuilder* self,
+                                 DWord first_index)
+{
+  DWord count = file_table_get_count(self->file_table);
+  DWord block_first = 0;
+  DWord member_count = 0;
+  QWord block_size = 0;
+  Result result = RESULT_OK;
+
+  for (DWord i = first_index; i <= count && result == RESULT_OK; i++)
+  {
+    QWord size = i < count
+                   ? file_table_get_entry(self->file_table, i)->original_size
+                   : self->solid_block_size;
+    bool small = size < self->solid_block_size;
+
+    if (member_count > 0 &&
+        (!small || block_size + size > self->solid_block_size))
+    {
+      if (member_count > 1)
       {
-        arithmetic_model_destroy(model);
+        result = file_table_add_solid_block(self->file_table, block_first,
+                                            member_count, block_size);
       }
+      member_count = 0;
     }
-    else if (primary_algo == COMPRESSION_SHANNON)
+
+    if (small && (member_count > 0 || size > 0))
     {
-      ShannonTree* tree = shannon_tree_create();
-      if (tree == NULL)
+      if (member_count == 0)
       {
-        return RESULT_MEMORY_ERROR;
+        block_first = i;
+        block_size = 0;
       }
+      member_count++;
+      block_size += size;
+    }
+  }
+
+  LOG_INFO("Сплошных блоков: %u\n",
+           file_table_get_solid_block_count(self->file_table));
+  return result;
+}
+
+// Данные участников блока склеиваются и сжимаются одним потоком так же,
+// как данные отдельного файла. Участники получают смещения в блоке
+static Result compress_solid_block(CompressedArchiveBuilder* self,
+                                   DWord block_index,
+                                   CompressionAlgorithm primary_algo,
+                                   const void* primary_context,
+                                   bool use_two_stage,
+                                   CompressionAlgorithm secondary_algo,
+                                   RLEContext* secondary_rle_context,
+                                   Byte** output, Size* output_size)
+{
+  const FileSolidBlock* block =
+    file_table_get_solid_block(self->file_table, block_index);
+  LOG_INFO("Сплошной блок %u: записи %u-%u, %llu байт\n", block_index + 1,
+           block->first_entry + 1, block->first_entry + block->entry_count,
+           (unsigned long long)block->data_size);
+
+  Byte* data = (Byte*)malloc(block->data_size);
+  if (data == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = RESULT_OK;
+  QWord position = 0;
+  for (DWord i = 0; i < block->entry_count && result == RESULT_OK; i++)
+  {
+    FileEntry* entry = (FileEntry*)file_table_get_entry(
+      self->file_table, block->first_entry + i);
+    entry->offset = position;
+    entry->compressed_size = 0;
+    if (entry->original_size == 0)
+    {
+      continue;
+    }
 
-      // Строим дерево на основе глобальных данных (контекста)
-      if (context_data && context_size > 0)
+    File* input_file = file_create(entry->filename);
+    if (input_file == NULL)
+    {
+      result = RESULT_MEMORY_ERROR;
+      break;
+    }
+
+    result = file_open_for_read(input_file);
+    if (result == RESULT_OK)
+    {
+      result = file_table_read_entry_data(
+        self->file_table, block->first_entry + i, input_file);
+      if (result == RESULT_OK &&
+          file_get_size(input_file) != entry->original_size)
       {
-        result = shannon_tree_build(tree, context_data, context_size);
+        LOG_ERROR("Файл изменился после добавления в архив: %s\n",
+                  entry->filename);
+        result = RESULT_ERROR;
       }
-      else
+      if (result == RESULT_OK && self->append != NULL &&
+          self->dedup_index == NULL)
       {
-        // Если нет глобальных данных, используем входные данные
-        result = shannon_tree_build(tree, input, input_size);
+        result = update_entry_crc(self, entry, file_get_buffer(input_file),
+                                  entry->original_size);
       }
-
       if (result == RESULT_OK)
       {
-        // Сжимаем входные данные
-        result = shannon_compress(input, input_size, &stage1_output,
-                                  &stage1_size, tree);
+        memcpy(data + position, file_get_buffer(input_file),
+               entry->original_size);
+        position += entry->original_size;
+      }
+      file_close(input_file);
+    }
+    file_destroy(input_file);
+  }
 
-        if (result == RESULT_OK && primary_data)
-        {
-          primary_data->algorithm = COMPRESSION_SHANNON;
-          primary_data->shannon_tree = tree;
+  if (result == RESULT_OK && use_two_stage)
+  {
+    result = apply_two_stage_compression(
+      self, data, block->data_size, output, output_size, primary_algo,
+      primary_context, secondary_algo, secondary_rle_context);
+  }
+  else if (result == RESULT_OK)
+  {
+    Size capacity = compress_bound(primary_algo, block->data_size);
+    *output = (Byte*)malloc(capacity);
+    result = *output == NULL
+               ? RESULT_MEMORY_ERROR
+               : compress_stage(primary_algo, primary_context, data,
+                                block->data_size, *output, capacity,
+                                output_size);
+    if (result != RESULT_OK)
+    {
+      free(*output);
+      *output = NULL;
+    }
+  }
 
-          // Сериализуем дерево для сохранения в архив
-          result = shannon_serialize_tree(tree, &primary_data->tree_model_data,
-                                          &primary_data->tree_model_size);
-        }
-        else
-        {
-          shannon_tree_destroy(tree);
-        }
-      }
-      else
-      {
-        shannon_tree_destroy(tree);
-      }
+  free(data);
+  return result;
+}
+
+static void destroy_append_models(AppendModels* models,
+                                  CompressionAlgorithm primary_algo)
+{
+  if (models->primary != NULL)
+  {
+    if (primary_algo == COMPRESSION_HUFFMAN)
+    {
+      huffman_tree_destroy((HuffmanTree*)models->primary);
+    }
+    else if (primary_algo == COMPRESSION_ARITHMETIC)
+    {
+      arithmetic_model_destroy((ArithmeticModel*)models->primary);
+    }
+    else if (primary_algo == COMPRESSION_SHANNON)
+    {
+      shannon_tree_destroy((ShannonTree*)models->primary);
     }
     else if (primary_algo == COMPRESSION_RLE)
     {
-      Byte prefix = 0;
-      if (context_data && context_size > 0)
-      {
-        // Используем префикс из глобальных данных
-        prefix = rle_analyze_prefix(context_data, context_size);
-      }
-      else
-      {
-        // Используем префикс из входных данных
-        prefix = rle_analyze_prefix(input, input_size);
-      }
+      rle_destroy((RLEContext*)models->primary);
+    }
+  }
 
-      RLEContext* rle_context = rle_create(prefix);
-      if (rle_context == NULL)
-      {
-        return RESULT_MEMORY_ERROR;
-      }
+  if (models->secondary_rle != NULL)
+  {
+    rle_destroy(models->secondary_rle);
+  }
+}
 
-      // Сжимаем входные данные
-      result = rle_compress(input, input_size, &stage1_output, &stage1_size,
-                            rle_context);
+// Модели читаются из архива так же, как их читает читатель: новые записи
+// должны распаковываться теми же моделями, что и прежние
+static Result load_append_models(CompressedArchiveBuilder* self,
+                                 AppendModels* models)
+{
+  const CompressedArchiveHeader* header = &self->append->header;
+  memset(models, 0, sizeof(AppendModels));
+  models->lzh.level = self->level;
+
+  Size primary_size = compressed_archive_primary_model_size(header);
+  Size secondary_size =
+    header->version_minor > 0 && (header->flags & FLAG_TWO_STAGE_COMPRESSION)
+      ? header->secondary_context_size
+      : 0;
+  Size model_size = primary_size + secondary_size;
+  Byte* model_data = (Byte*)malloc(model_size > 0 ? model_size : 1);
+  if (model_data == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
 
-      if (result == RESULT_OK && primary_data)
-      {
-        primary_data->algorithm = COMPRESSION_RLE;
-        primary_data->rle_context = rle_context;
+  Result result = RESULT_OK;
+  if (model_size > 0)
+  {
+    result = file_read_at(self->archive_file, model_data, model_size,
+                          self->append->model_offset);
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("Ошибка чтения моделей архива!\n");
+    }
+  }
 
-        // Сериализуем контекст для сохранения в архив
-        result =
-          rle_serialize_context(rle_context, &primary_data->tree_model_data,
-                                &primary_data->tree_model_size);
-      }
-      else
-      {
-        rle_destroy(rle_context);
-      }
+  // Вместо модели в архиве ссылка на словарь: нужен тот же словарь
+  const Dictionary* dictionary = NULL;
+  if (result == RESULT_OK && (header->flags & FLAG_DICTIONARY))
+  {
+    DWord hash = 0;
+    if (primary_size == COMPRESSED_ARCHIVE_DICTIONARY_REFERENCE_SIZE)
+    {
+      memcpy(&hash, model_data, sizeof(hash));
     }
-    else if (primary_algo == COMPRESSION_LZ77)
+
+    if (self->dictionary == NULL ||
+        dictionary_get_hash(self->dictionary) != hash)
     {
-      Byte prefix = 0;
-      if (context_data && context_size > 0)
-      {
-        // Используем префикс из глобальных данных
-        prefix = lz77_analyze_prefix(context_data, context_size);
-      }
-      else
-      {
-        // Используем префикс из входных данных
-        prefix = lz77_analyze_prefix(input, input_size);
-      }
+      LOG_ERROR("Архив сжат со словарем %08X, для дозаписи нужен он же!\n",
+                hash);
+      result = RESULT_INVALID_ARGUMENT;
+    }
+    else
+    {
+      dictionary = self->dictionary;
+      models->lzh.window = dictionary_get_window(dictionary);
+      models->lzh.window_size = dictionary_get_window_size(dictionary);
+    }
+  }
 
-      // Сжимаем входные данные
-      result =
-        lz77_compress(input, input_size, &stage1_output, &stage1_size, prefix);
+  CompressionAlgorithm primary_algo = header->primary_compression;
+  if (result == RESULT_OK && primary_algo == COMPRESSION_HUFFMAN)
+  {
+    HuffmanTree* tree = huffman_tree_create();
+    models->primary = tree;
+    result = tree == NULL ? RESULT_MEMORY_ERROR
+             : dictionary ? huffman_tree_build_from_frequencies(
+                              tree, dictionary_get_frequencies(dictionary))
+                          : huffman_deserialize_tree(tree, model_data,
+                                                     primary_size);
+  }
+  else if (result == RESULT_OK && primary_algo == COMPRESSION_ARITHMETIC)
+  {
+    ArithmeticModel* model = arithmetic_model_create();
+    models->primary = model;
+    result = model == NULL ? RESULT_MEMORY_ERROR
+             : dictionary  ? arithmetic_model_build_from_frequencies(
+                               model, dictionary_get_frequencies(dictionary))
+                           : arithmetic_deserialize_model(model, model_data,
+                                                          primary_size);
+  }
+  else if (result == RESULT_OK && primary_algo == COMPRESSION_SHANNON)
+  {
+    ShannonTree* tree = shannon_tree_create();
+    models->primary = tree;
+    result = tree == NULL ? RESULT_MEMORY_ERROR
+             : dictionary ? shannon_tree_build_from_frequencies(
+                              tree, dictionary_get_frequencies(dictionary))
+                          : shannon_deserialize_tree(tree, model_data,
+                                                     primary_size);
+  }
+  else if (result == RESULT_OK && primary_algo == COMPRESSION_RLE)
+  {
+    RLEContext* context = rle_create(0);
+    models->primary = context;
+    result = context == NULL ? RESULT_MEMORY_ERROR
+                             : rle_deserialize_context(context, model_data,
+                                                       primary_size);
+  }
+  else if (result == RESULT_OK && primary_algo == COMPRESSION_LZ77)
+  {
+    models->lz77_prefix = primary_size >= 1 ? model_data[0] : 0;
+  }
 
-      if (result == RESULT_OK && primary_data)
-      {
-        primary_data->algorithm = COMPRESSION_LZ77;
-        primary_data->tree_model_data = malloc(1);
-        if (primary_data->tree_model_data)
-        {
-          primary_data->tree_model_data[0] = prefix;
-          primary_data->tree_model_size = 1;
-        }
-      }
+  // Префикс вторичного RLE подбирается для каждого блока, из архива
+  // берется только формат
+  if (result == RESULT_OK &&
+      (header->flags & FLAG_TWO_STAGE_COMPRESSION) &&
+      header->secondary_compression == COMPRESSION_RLE)
+  {
+    models->secondary_rle = rle_create(0);
+    if (models->secondary_rle == NULL)
+    {
+      result = RESULT_MEMORY_ERROR;
     }
-    else if (primary_algo == COMPRESSION_LZ78)
+    else if (secondary_size > 0)
+    {
+      result = rle_deserialize_context(models->secondary_rle,
+                                       model_data + primary_size,
+                                       secondary_size);
+    }
+  }
+
+  free(model_data);
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Не удалось восстановить модели архива!\n");
+    destroy_append_models(models, primary_algo);
+  }
+
+  return result;
+}
+
+static const void* append_primary_context(const AppendModels* models,
+                                          CompressionAlgorithm algorithm)
+{
+  return algorithm == COMPRESSION_LZ77  ? (const void*)&models->lz77_prefix
+         : algorithm == COMPRESSION_LZH ? (const void*)&models->lzh
+                                        : models->primary;
+}
+
+// Сжимает новую запись моделями архива и пишет ее с текущей позиции
+static Result write_appended_entry(CompressedArchiveBuilder* self,
+                                   DWord index, const AppendModels* models,
+                                   QWord* data_offset)
+{
+  const CompressedArchiveHeader* header = &self->append->header;
+  CompressionAlgorithm primary_algo = header->primary_compression;
+  CompressionAlgorithm secondary_algo = header->secondary_compression;
+  FileEntry* entry = (FileEntry*)file_table_get_entry(self->file_table, index);
+  entry->offset = *data_offset;
+  LOG_INFO("Файл %u/%u: %s\n", index + 1,
+           file_table_get_count(self->file_table), entry->filename);
+
+  if (entry->original_size == 0)
+  {
+    // Пустой (или полностью разреженный) файл - сжимать нечего
+    entry->compressed_size = 0;
+    return RESULT_OK;
+  }
+
+  File* input_file = file_create(entry->filename);
+  if (input_file == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = file_open_for_read(input_file);
+  if (result != RESULT_OK)
+  {
+    file_destroy(input_file);
+    return result;
+  }
+
+  result = file_table_read_entry_data(self->file_table, index, input_file);
+  if (result != RESULT_OK)
+  {
+    file_close(input_file);
+    file_destroy(input_file);
+    return result;
+  }
+
+  const Byte* original_data = file_get_buffer(input_file);
+  Size original_size = file_get_size(input_file);
+  const void* primary_context = append_primary_context(models, primary_algo);
+
+  // Без дедупликации данные новой записи при добавлении не читались
+  if (self->dedup_index == NULL)
+  {
+    result = update_entry_crc(self, entry, original_data, original_size);
+    if (result != RESULT_OK)
     {
-      // LZ78 не требует контекста
-      result = lz78_compress(input, input_size, &stage1_output, &stage1_size);
+      file_close(input_file);
+      file_destroy(input_file);
+      return result;
+    }
+  }
+
+  StatsSpan span;
+  stats_span_begin(self->stats, &span, STATS_STAGE_COMPRESS,
+                   compressed_archive_algorithm_name(primary_algo));
+
+  const Byte* stored = original_data;
+  Size stored_size = original_size;
+  Byte* two_stage_data = NULL;
+  if (header->flags & FLAG_TWO_STAGE_COMPRESSION)
+  {
+    result = apply_two_stage_compression(
+      self, original_data, original_size, &two_stage_data, &stored_size,
+      primary_algo, primary_context, secondary_algo, models->secondary_rle);
+    stored = two_stage_data;
+  }
+  else if (header->flags & FLAG_COMPRESSED)
+  {
+    Size capacity = compress_bound(primary_algo, original_size);
+    Byte* buffer = scratch_reserve(&self->scratch[0], capacity);
+    result = buffer == NULL
+               ? RESULT_MEMORY_ERROR
+               : compress_stage(primary_algo, primary_context, original_data,
+                                original_size, buffer, capacity,
+                                &stored_size);
+    stored = buffer;
+  }
+
+  if (result == RESULT_OK)
+  {
+    result = file_write_bytes(self->archive_file, stored, stored_size);
+  }
+
+  if (result == RESULT_OK)
+  {
+    entry->compressed_size = stored_size;
+    *data_offset += stored_size;
+    LOG_DEBUG("  Сжатый размер: %zu байт, смещение: %llu\n", stored_size,
+              (unsigned long long)entry->offset);
+  }
+  else
+  {
+    LOG_ERROR("  Ошибка сжатия файла!\n");
+  }
+
+  stats_span_end(self->stats, &span, original_size, stored_size);
+  free(two_stage_data);
+  file_close(input_file);
+  file_destroy(input_file);
+  return result;
+}
+
+static Result write_appended_block(CompressedArchiveBuilder* self,
+                                   DWord block_index,
+                                   const AppendModels* models,
+                                   QWord* data_offset)
+{
+  const CompressedArchiveHeader* header = &self->append->header;
+  CompressionAlgorithm primary_algo = header->primary_compression;
+  FileSolidBlock* block =
+    (FileSolidBlock*)file_table_get_solid_block(self->file_table, block_index);
+
+  StatsSpan span;
+  stats_span_begin(self->stats, &span, STATS_STAGE_COMPRESS,
+                   compressed_archive_algorithm_name(primary_algo));
+  Byte* data = NULL;
+  Size size = 0;
+  Result result = compress_solid_block(
+    self, block_index, primary_algo,
+    append_primary_context(models, primary_algo),
+    (header->flags & FLAG_TWO_STAGE_COMPRESSION) != 0,
+    header->secondary_compression, models->secondary_rle, &data, &size);
+  if (result == RESULT_OK)
+  {
+    result = file_write_bytes(self->archive_file, data, size);
+  }
+  stats_span_end(self->stats, &span, block->data_size, size);
+  free(data);
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("  Ошибка сжатия сплошного блока!\n");
+    return result;
+  }
+
+  block->offset = *data_offset;
+  block->compressed_size = size;
+  *data_offset += size;
+  return RESULT_OK;
+}
+
+// Заголовок переписывается последним: до этого архив читается по прежней
+// таблице, а после ошибки дописанное отрезается
+static Result finalize_append(CompressedArchiveBuilder* self)
+{
+  AppendState* append = self->append;
+  DWord count = file_table_get_count(self->file_table);
 
-      if (result == RESULT_OK && primary_data)
-      {
-        primary_data->algorithm = COMPRESSION_LZ78;
-        // LZ78 не требует сериализации модели
-      }
-    }
+  LOG_INFO("\n=== Дозапись в архив ===\n");
+  if (count == append->existing_count)
+  {
+    LOG_INFO("Новых и измененных файлов нет, архив не изменен\n");
+    return RESULT_OK;
+  }
 
-    if (result == RESULT_OK && stage1_output)
-    {
-      printf("[TWO-STAGE] Этап 1 завершен: %zu -> %zu байт (%.2f%%)\n",
-             input_size, stage1_size,
-             (1.0 - (double)stage1_size / (double)input_size) * 100);
-    }
-    else
-    {
-      printf(
-        "[TWO-STAGE] Ошибка первичного сжатия, используем исходные данные\n");
+  LOG_INFO("Новых записей: %u\n", count - append->existing_count);
 
-      if (primary_failed)
-      {
-        *primary_failed = true;
-      }
+  AppendModels models;
+  Result result = load_append_models(self, &models);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
 
-      // Используем исходные данные
-      stage1_output = (Byte*)malloc(input_size);
-      if (stage1_output)
-      {
-        memcpy(stage1_output, input, input_size);
-        stage1_size = input_size;
-      }
-      else
-      {
-        return RESULT_MEMORY_ERROR;
-      }
-    }
+  // В несжатом архиве блоки ничего не дают
+  if (self->solid_block_size > 0 &&
+      (append->header.flags & FLAG_COMPRESSED) &&
+      group_solid_blocks(self, append->existing_count) != RESULT_OK)
+  {
+    LOG_ERROR("Не удалось собрать сплошные блоки!\n");
+    destroy_append_models(&models, append->header.primary_compression);
+    return RESULT_ERROR;
   }
-  else
+
+  QWord data_offset = append->data_end;
+  result = file_seek(self->archive_file, (long)data_offset, SEEK_SET);
+  for (DWord i = append->existing_count; i < count && result == RESULT_OK;
+       i++)
   {
-    // Без первичного сжатия
-    stage1_output = (Byte*)malloc(input_size);
-    if (stage1_output)
+    DWord block_index = file_table_find_solid_block(self->file_table, i);
+    if (block_index == FILE_TABLE_NO_ENTRY)
     {
-      memcpy(stage1_output, input, input_size);
-      stage1_size = input_size;
+      result = write_appended_entry(self, i, &models, &data_offset);
     }
-    else
+    else if (file_table_get_solid_block(self->file_table, block_index)
+               ->first_entry == i)
     {
-      return RESULT_MEMORY_ERROR;
+      result = write_appended_block(self, block_index, &models, &data_offset);
     }
-    printf("[TWO-STAGE] Первичное сжатие отключено\n");
   }
+  destroy_append_models(&models, append->header.primary_compression);
 
-  // Этап 2: Вторичное сжатие
-  if (stage1_output && secondary_algo != COMPRESSION_NONE)
+  StatsSpan span;
+  stats_span_begin(self->stats, &span, STATS_STAGE_WRITE, "table");
+  if (result == RESULT_OK)
   {
-    CompressedFileData stage2_data;
-    memset(&stage2_data, 0, sizeof(stage2_data));
-    stage2_data.algorithm = secondary_algo;
-
-    // Для вторичного сжатия используем данные после первичного сжатия (или
-    // исходные)
-    if (secondary_algo == COMPRESSION_RLE)
-    {
-      // Анализируем данные для выбора оптимального префикса
-      Byte prefix = rle_analyze_prefix(stage1_output, stage1_size);
-      RLEContext* rle_context = rle_create(prefix);
-      if (rle_context)
-      {
-        stage2_data.rle_context = rle_context;
-        result =
-          rle_compress(stage1_output, stage1_size, &stage2_data.compressed_data,
-                       &stage2_data.compressed_size, rle_context);
-
-        if (result == RESULT_OK && secondary_data)
-        {
-          // Сохраняем контекст RLE
-          secondary_data->algorithm = COMPRESSION_RLE;
-          secondary_data->rle_context = rle_context;
+    result = compressed_archive_write_table(self->file_table,
+                                            self->archive_file);
+  }
 
-          // Сериализуем контекст
-          rle_serialize_context(rle_context, &secondary_data->tree_model_data,
-                                &secondary_data->tree_model_size);
-        }
-        else
-        {
-          rle_destroy(rle_context);
-        }
-      }
-      else
-      {
-        result = RESULT_MEMORY_ERROR;
-      }
-    }
-    else if (secondary_algo == COMPRESSION_LZ78)
-    {
-      result =
-        lz78_compress(stage1_output, stage1_size, &stage2_data.compressed_data,
-                      &stage2_data.compressed_size);
+  if (result == RESULT_OK)
+  {
+    CompressedArchiveTrailer trailer;
+    compressed_archive_trailer_init(&trailer, data_offset,
+                                    append->model_offset);
+    result = compressed_archive_trailer_write(&trailer, self->archive_file);
+  }
 
-      if (result == RESULT_OK && secondary_data)
-      {
-        secondary_data->algorithm = COMPRESSION_LZ78;
-        // LZ78 не требует сериализации контекста
-      }
-    }
-    else if (secondary_algo == COMPRESSION_LZ77)
-    {
-      Byte prefix = lz77_analyze_prefix(stage1_output, stage1_size);
-      result =
-        lz77_compress(stage1_output, stage1_size, &stage2_data.compressed_data,
-                      &stage2_data.compressed_size, prefix);
+  CompressedArchiveHeader header = append->header;
+  header.flags |=
+    FLAG_APPENDED | compressed_archive_table_flags(self->file_table);
+  header.flags |= count > 1 ? FLAG_DIRECTORY : FLAG_NONE;
+  header.original_size = file_table_get_total_size(self->file_table);
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_header_update_crc(&header);
+  }
 
-      if (result == RESULT_OK && secondary_data)
-      {
-        secondary_data->algorithm = COMPRESSION_LZ77;
-        secondary_data->tree_model_data = malloc(1);
-        if (secondary_data->tree_model_data)
-        {
-          secondary_data->tree_model_data[0] = prefix;
-          secondary_data->tree_model_size = 1;
-        }
-      }
-    }
-    else
-    {
-      // Для других алгоритмов (Huffman, Arithmetic, Shannon)
-      // они не должны использоваться как вторичные в двухэтапном сжатии
-      printf(
-        "[TWO-STAGE] ВНИМАНИЕ: алгоритм %d не поддерживается как вторичный\n",
-        secondary_algo);
-      result = RESULT_ERROR;
-    }
+  if (result == RESULT_OK)
+  {
+    result = file_seek(self->archive_file, 0, SEEK_SET);
+  }
 
-    if (result == RESULT_OK && stage2_data.compressed_data)
-    {
-      printf("[TWO-STAGE] Этап 2 завершен: %zu -> %zu байт (%.2f%%)\n",
-             stage1_size, stage2_data.compressed_size,
-             (1.0 - (double)stage2_data.compressed_size / (double)stage1_size) *
-               100);
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_header_write(&header, self->archive_file);
+  }
+  stats_span_end(self->stats, &span, 0,
+                 compressed_archive_table_size(self->file_table));
 
-      free(stage1_output);
-      *output = stage2_data.compressed_data;
-      *output_size = stage2_data.compressed_size;
+  free(self->all_data);
+  self->all_data = NULL;
+  self->all_data_size = 0;
+  self->all_data_capacity = 0;
 
-      // Освобождаем ресурсы stage2_data, но оставляем compressed_data
-      if (secondary_algo != COMPRESSION_RLE)
-      {
-        free_compressed_file_data(&stage2_data, true);
-      }
-    }
-    else
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("\nОшибка при дозаписи в архив!\n");
+    if (file_truncate(self->archive_file, append->data_end) != RESULT_OK)
     {
-      // Если вторичное сжатие не удалось, используем результат первичного
-      printf(
-        "[TWO-STAGE] Вторичное сжатие не удалось, используем первичный "
-        "результат\n");
-      *output = stage1_output;
-      *output_size = stage1_size;
-      result = RESULT_OK;
+      LOG_ERROR("Не удалось отрезать дописанные данные!\n");
     }
+    return result;
   }
-  else
-  {
-    // Без вторичного сжатия
-    *output = stage1_output;
-    *output_size = stage1_size;
-    printf("[TWO-STAGE] Вторичное сжатие отключено\n");
-  }
-
-  printf("[TWO-STAGE] Итоговый размер: %zu байт\n", *output_size);
-  printf("[TWO-STAGE] Общий коэффициент сжатия: %.2f%%\n",
-         (1.0 - (double)*output_size / (double)input_size) * 100);
 
-  return result;
+  file_seek(self->archive_file, 0, SEEK_END);
+  LOG_INFO("\nДозапись завершена, записей в архиве: %u\n", count);
+  LOG_INFO("Размер архива: %ld байт\n", file_tell(self->archive_file));
+  return RESULT_OK;
 }
 
 Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
@@ -1278,22 +2145,21 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("\n=== Начало создания сжатого архива ===\n");
-  printf("Файлов в архиве: %u\n", file_table_get_count(self->file_table));
-  printf("Общий размер файлов: %llu байт\n",
-         file_table_get_total_size(self->file_table));
+  if (self->append != NULL)
+  {
+    return finalize_append(self);
+  }
+
+  LOG_INFO("\n=== Начало создания сжатого архива ===\n");
+  LOG_INFO("Файлов в архиве: %u\n", file_table_get_count(self->file_table));
+  LOG_INFO("Общий размер файлов: %llu байт\n",
+           file_table_get_total_size(self->file_table));
 
   // Определяем режим сжатия
   bool use_two_stage = self->use_two_stage_compression;
   CompressionAlgorithm primary_algo = COMPRESSION_NONE;
   CompressionAlgorithm secondary_algo = COMPRESSION_NONE;
 
-  // Данные моделей для алгоритмов
-  CompressedFileData primary_model_data;
-  CompressedFileData secondary_model_data;
-  memset(&primary_model_data, 0, sizeof(primary_model_data));
-  memset(&secondary_model_data, 0, sizeof(secondary_model_data));
-
   Byte* primary_tree_model_data = NULL;
   Size primary_tree_model_size = 0;
   Byte* secondary_context_data = NULL;
@@ -1302,13 +2168,19 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
   void* primary_compression_model = NULL;
   void* secondary_compression_model = NULL;
 
+  // Этапы идут последовательно, поэтому интервал статистики один на все
+  StatsSpan span;
+  memset(&span, 0, sizeof(span));
+
   if (self->all_data_size > 0)
   {
-    printf("\n=== Анализ данных для выбора алгоритма сжатия ===\n");
-    printf("Объем данных для анализа: %zu байт\n", self->all_data_size);
+    stats_span_begin(self->stats, &span, STATS_STAGE_TRAIN, NULL);
+
+    LOG_INFO("\n=== Анализ данных для выбора алгоритма сжатия ===\n");
+    LOG_INFO("Объем данных для анализа: %zu байт\n", self->all_data_size);
 
     double entropy = calculate_entropy(self->all_data, self->all_data_size);
-    printf("Энтропия данных: %.4f бит/символ\n", entropy);
+    LOG_INFO("Энтропия данных: %.4f бит/символ\n", entropy);
 
     // Выбор алгоритмов
     // В compressed_archive_builder_finalize() обновите логику выбора
@@ -1317,20 +2189,22 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
     // После анализа энтропии, когда use_two_stage = true:
     if (use_two_stage)
     {
-      printf("\n=== РЕЖИМ ДВУХЭТАПНОГО СЖАТИЯ ===\n");
+      LOG_INFO("\n=== РЕЖИМ ДВУХЭТАПНОГО СЖАТИЯ ===\n");
 
       // Определяем первичный алгоритм (контекстно-зависимый)
       if (self->force_algorithm && self->selected_algorithm != COMPRESSION_NONE)
       {
         primary_algo = self->selected_algorithm;
-        printf("Используется принудительно выбранный первичный алгоритм: %s\n",
-               primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-               : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-               : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-               : primary_algo == COMPRESSION_RLE        ? "RLE"
-               : primary_algo == COMPRESSION_LZ78       ? "LZ78"
-               : primary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                        : "NONE");
+        LOG_INFO(
+          "Используется принудительно выбранный первичный алгоритм: %s\n",
+          primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
+          : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
+          : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
+          : primary_algo == COMPRESSION_RLE        ? "RLE"
+          : primary_algo == COMPRESSION_LZ78       ? "LZ78"
+          : primary_algo == COMPRESSION_LZ77       ? "LZ77"
+          : primary_algo == COMPRESSION_LZH        ? "LZH"
+                                                   : "NONE");
       }
       else
       {
@@ -1339,23 +2213,20 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         if (entropy < 4.0)
         {
           primary_algo = COMPRESSION_HUFFMAN;
-          printf(
-            "Низкая энтропия, выбираем алгоритм Хаффмана в качестве "
-            "первичного\n");
+          LOG_INFO("Низкая энтропия, выбираем алгоритм Хаффмана в качестве "
+                   "первичного\n");
         }
         else if (entropy < 6.0)
         {
           primary_algo = COMPRESSION_ARITHMETIC;
-          printf(
-            "Средняя энтропия, выбираем арифметическое кодирование в качестве "
-            "первичного\n");
+          LOG_INFO("Средняя энтропия, выбираем арифметическое кодирование в "
+                   "качестве " "первичного\n");
         }
         else
         {
           primary_algo = COMPRESSION_SHANNON;
-          printf(
-            "Высокая энтропия, выбираем алгоритм Шеннона в качестве "
-            "первичного\n");
+          LOG_INFO("Высокая энтропия, выбираем алгоритм Шеннона в качестве "
+                   "первичного\n");
         }
       }
 
@@ -1363,14 +2234,16 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
       if (self->selected_secondary_algorithm != COMPRESSION_NONE)
       {
         secondary_algo = self->selected_secondary_algorithm;
-        printf("Используется принудительно выбранный вторичный алгоритм: %s\n",
-               secondary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-               : secondary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-               : secondary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-               : secondary_algo == COMPRESSION_RLE        ? "RLE"
-               : secondary_algo == COMPRESSION_LZ78       ? "LZ78"
-               : secondary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                          : "NONE");
+        LOG_INFO(
+          "Используется принудительно выбранный вторичный алгоритм: %s\n",
+          secondary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
+          : secondary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
+          : secondary_algo == COMPRESSION_SHANNON    ? "SHANNON"
+          : secondary_algo == COMPRESSION_RLE        ? "RLE"
+          : secondary_algo == COMPRESSION_LZ78       ? "LZ78"
+          : secondary_algo == COMPRESSION_LZ77       ? "LZ77"
+          : secondary_algo == COMPRESSION_LZH        ? "LZH"
+                                                     : "NONE");
       }
       else
       {
@@ -1378,9 +2251,8 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         if (entropy < 3.0)
         {
           secondary_algo = COMPRESSION_RLE;
-          printf(
-            "Очень низкая энтропия, выбираем RLE в качестве вторичного "
-            "алгоритма\n");
+          LOG_INFO("Очень низкая энтропия, выбираем RLE в качестве вторичного "
+                   "алгоритма\n");
 
           // Дополнительный анализ через Маркова
           MarkovModel* markov = markov_model_create();
@@ -1398,15 +2270,15 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
               if (prob > 0.8)
               {
                 has_long_repetitions = true;
-                printf("  Символ 0x%02X имеет P(x|x)=%.3f - хорош для RLE\n", i,
-                       prob);
+                LOG_TRACE("  Символ 0x%02X имеет P(x|x)=%.3f - хорош для RLE\n",
+                          i, prob);
               }
             }
 
             if (!has_long_repetitions)
             {
-              printf("  ВНИМАНИЕ: RLE может быть неэффективен\n");
-              printf("  Рассмотрите другие алгоритмы (LZ77/LZ78)\n");
+              LOG_WARN("  ВНИМАНИЕ: RLE может быть неэффективен\n");
+              LOG_DEBUG("  Рассмотрите другие алгоритмы (LZ77/LZ78)\n");
             }
 
             markov_model_destroy(markov);
@@ -1415,49 +2287,42 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         else if (entropy < 5.0)
         {
           secondary_algo = COMPRESSION_LZ77;
-          printf(
-            "Низкая энтропия, выбираем LZ77 в качестве вторичного алгоритма\n");
+          LOG_INFO("Низкая энтропия, выбираем LZ77 в качестве вторичного "
+                   "алгоритма\n");
         }
         else
         {
           secondary_algo = COMPRESSION_LZ78;
-          printf(
-            "Средне-высокая энтропия, выбираем LZ78 в качестве вторичного "
-            "алгоритма\n");
+          LOG_INFO("Средне-высокая энтропия, выбираем LZ78 в качестве "
+                   "вторичного " "алгоритма\n");
         }
       }
 
-      // ВАЖНО: Для двухэтапного сжатия МЕНЯЕМ ПОРЯДОК
-      // Вторичный (контекстно-независимый) применяется ПЕРВЫМ
-      // Первичный (контекстно-зависимый) применяется ВТОРЫМ
-      printf("\n=== ПОРЯДОК СЖАТИЯ ===\n");
-      printf("1. %s (контекстно-независимый)\n",
-             secondary_algo == COMPRESSION_RLE    ? "RLE"
-             : secondary_algo == COMPRESSION_LZ78 ? "LZ78"
-             : secondary_algo == COMPRESSION_LZ77 ? "LZ77"
-                                                  : "N/A");
-      printf("2. %s (контекстно-зависимый)\n",
-             primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-             : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-             : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-                                                      : "N/A");
+      // Блоки проходят сначала первичный (контекстно-зависимый) этап с общей
+      // моделью архива, затем вторичный (контекстно-независимый)
+      LOG_INFO("\n=== ПОРЯДОК СЖАТИЯ ===\n");
+      LOG_INFO("1. %s (контекстно-зависимый)\n",
+               compressed_archive_algorithm_name(primary_algo));
+      LOG_INFO("2. %s (контекстно-независимый)\n",
+               compressed_archive_algorithm_name(secondary_algo));
     }
     else
     {
       // Обычное одноэтапное сжатие
-      printf("\n=== РЕЖИМ ОДНОЭТАПНОГО СЖАТИЯ ===\n");
+      LOG_INFO("\n=== РЕЖИМ ОДНОЭТАПНОГО СЖАТИЯ ===\n");
 
       if (self->force_algorithm)
       {
         primary_algo = self->selected_algorithm;
-        printf("Используется принудительно выбранный алгоритм: %s\n",
-               primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-               : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-               : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-               : primary_algo == COMPRESSION_RLE        ? "RLE"
-               : primary_algo == COMPRESSION_LZ78       ? "LZ78"
-               : primary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                        : "NONE");
+        LOG_INFO("Используется принудительно выбранный алгоритм: %s\n",
+                 primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
+                 : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
+                 : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
+                 : primary_algo == COMPRESSION_RLE        ? "RLE"
+                 : primary_algo == COMPRESSION_LZ78       ? "LZ78"
+                 : primary_algo == COMPRESSION_LZ77       ? "LZ77"
+                 : primary_algo == COMPRESSION_LZH        ? "LZH"
+                                                          : "NONE");
       }
       else
       {
@@ -1465,7 +2330,7 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         if (entropy < 3.0)
         {
           primary_algo = COMPRESSION_RLE;
-          printf("Очень низкая энтропия, выбираем алгоритм RLE\n");
+          LOG_INFO("Очень низкая энтропия, выбираем алгоритм RLE\n");
 
           // Дополнительный анализ через Маркова
           MarkovModel* markov = markov_model_create();
@@ -1483,15 +2348,16 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
               if (prob > 0.8)
               {
                 has_long_repetitions = true;
-                printf("  Символ 0x%02X имеет P(x|x)=%.3f - хорош для RLE\n", i,
-                       prob);
+                LOG_TRACE("  Символ 0x%02X имеет P(x|x)=%.3f - хорош для RLE\n",
+                          i, prob);
               }
             }
 
             if (!has_long_repetitions)
             {
-              printf("  ВНИМАНИЕ: RLE может быть неэффективен\n");
-              printf("  Рассмотрите другие алгоритмы (Huffman/Arithmetic)\n");
+              LOG_WARN("  ВНИМАНИЕ: RLE может быть неэффективен\n");
+              LOG_DEBUG("  Рассмотрите другие алгоритмы "
+                        "(Huffman/Arithmetic)\n");
             }
 
             markov_model_destroy(markov);
@@ -1500,121 +2366,201 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         else if (entropy < 4.0)
         {
           primary_algo = COMPRESSION_HUFFMAN;
-          printf("Низкая энтропия, выбираем алгоритм Хаффмана\n");
+          LOG_INFO("Низкая энтропия, выбираем алгоритм Хаффмана\n");
         }
         else if (entropy < 5.0)
         {
           primary_algo = COMPRESSION_LZ77;
-          printf("Средняя энтропия, выбираем алгоритм LZ77\n");
+          LOG_INFO("Средняя энтропия, выбираем алгоритм LZ77\n");
         }
         else if (entropy < 6.0)
         {
           primary_algo = COMPRESSION_ARITHMETIC;
-          printf(
-            "Средне-высокая энтропия, выбираем арифметическое кодирование\n");
+          LOG_INFO("Средне-высокая энтропия, выбираем арифметическое "
+                   "кодирование\n");
         }
         else if (entropy < 7.0)
         {
           primary_algo = COMPRESSION_LZ78;
-          printf("Средне-высокая энтропия, выбираем алгоритм LZ78\n");
+          LOG_INFO("Средне-высокая энтропия, выбираем алгоритм LZ78\n");
         }
         else if (entropy < 7.5)
         {
           primary_algo = COMPRESSION_SHANNON;
-          printf("Средне-высокая энтропия, выбираем алгоритм Шеннона\n");
+          LOG_INFO("Средне-высокая энтропия, выбираем алгоритм Шеннона\n");
         }
         else
         {
           primary_algo = COMPRESSION_NONE;
-          printf("Высокая энтропия, сжатие неэффективно\n");
+          LOG_INFO("Высокая энтропия, сжатие неэффективно\n");
         }
       }
+    }
 
-      // Создаем модель для выбранного алгоритма
-      if (primary_algo == COMPRESSION_HUFFMAN)
+    // Словарь заменяет модель только тем алгоритмам, которые умеют его
+    // использовать; остальные строят контекст как обычно
+    const Dictionary* dictionary =
+      self->dictionary != NULL && (primary_algo == COMPRESSION_HUFFMAN ||
+                                   primary_algo == COMPRESSION_ARITHMETIC ||
+                                   primary_algo == COMPRESSION_SHANNON ||
+                                   primary_algo == COMPRESSION_LZH)
+        ? self->dictionary
+        : NULL;
+    if (self->dictionary != NULL && dictionary == NULL)
+    {
+      LOG_WARN("Словарь не используется алгоритмом %s\n",
+               compressed_archive_algorithm_name(primary_algo));
+    }
+
+    // Создаем модель для выбранного алгоритма (общая для обоих режимов).
+    // Модель по частотам словаря не сериализуется: ее восстановит читатель
+    if (primary_algo == COMPRESSION_HUFFMAN)
+    {
+      HuffmanTree* tree = huffman_tree_create();
+      if (tree)
       {
-        HuffmanTree* tree = huffman_tree_create();
-        if (tree)
+        Result result =
+          dictionary ? huffman_tree_build_from_frequencies(
+                         tree, dictionary_get_frequencies(dictionary))
+                     : build_huffman_model(tree, self->all_data,
+                                           self->all_data_size);
+        if (result == RESULT_OK && dictionary == NULL)
         {
-          Result result =
-            huffman_tree_build(tree, self->all_data, self->all_data_size);
-          if (result == RESULT_OK)
-          {
-            result = huffman_serialize_tree(tree, &primary_tree_model_data,
-                                            &primary_tree_model_size);
-            if (result == RESULT_OK)
-            {
-              primary_compression_model = tree;
-            }
-          }
+          result = huffman_serialize_tree(tree, &primary_tree_model_data,
+                                          &primary_tree_model_size);
+        }
+        if (result == RESULT_OK)
+        {
+          primary_compression_model = tree;
         }
       }
-      else if (primary_algo == COMPRESSION_ARITHMETIC)
-      {
-        ArithmeticModel* model = arithmetic_model_create();
-        if (model)
+    }
+    else if (primary_algo == COMPRESSION_ARITHMETIC)
+    {
+      ArithmeticModel* model = arithmetic_model_create();
+      if (model)
+      {
+        Result result =
+          dictionary ? arithmetic_model_build_from_frequencies(
+                         model, dictionary_get_frequencies(dictionary))
+                     : arithmetic_model_build(model, self->all_data,
+                                              self->all_data_size);
+        if (result == RESULT_OK && dictionary == NULL)
         {
-          Result result =
-            arithmetic_model_build(model, self->all_data, self->all_data_size);
-          if (result == RESULT_OK)
-          {
-            result = arithmetic_serialize_model(model, &primary_tree_model_data,
-                                                &primary_tree_model_size);
-            if (result == RESULT_OK)
-            {
-              primary_compression_model = model;
-            }
-          }
+          result = arithmetic_serialize_model(model, &primary_tree_model_data,
+                                              &primary_tree_model_size);
+        }
+        if (result == RESULT_OK)
+        {
+          primary_compression_model = model;
         }
       }
-      else if (primary_algo == COMPRESSION_SHANNON)
+    }
+    else if (primary_algo == COMPRESSION_SHANNON)
+    {
+      ShannonTree* tree = shannon_tree_create();
+      if (tree)
       {
-        ShannonTree* tree = shannon_tree_create();
-        if (tree)
+        Result result =
+          dictionary ? shannon_tree_build_from_frequencies(
+                         tree, dictionary_get_frequencies(dictionary))
+                     : build_shannon_model(tree, self->all_data,
+                                           self->all_data_size);
+        if (result == RESULT_OK && dictionary == NULL)
         {
-          Result result =
-            shannon_tree_build(tree, self->all_data, self->all_data_size);
-          if (result == RESULT_OK)
-          {
-            result = shannon_serialize_tree(tree, &primary_tree_model_data,
-                                            &primary_tree_model_size);
-            if (result == RESULT_OK)
-            {
-              primary_compression_model = tree;
-            }
-          }
+          result = shannon_serialize_tree(tree, &primary_tree_model_data,
+                                          &primary_tree_model_size);
+        }
+        if (result == RESULT_OK)
+        {
+          primary_compression_model = tree;
         }
       }
-      else if (primary_algo == COMPRESSION_RLE)
+    }
+    else if (primary_algo == COMPRESSION_RLE)
+    {
+      Byte prefix = rle_analyze_prefix(self->all_data, self->all_data_size);
+      RLEContext* rle_context = rle_create(prefix);
+      if (rle_context)
       {
-        Byte prefix = rle_analyze_prefix(self->all_data, self->all_data_size);
-        RLEContext* rle_context = rle_create(prefix);
-        if (rle_context)
-        {
-          primary_compression_model = rle_context;
+        rle_set_format(rle_context, self->rle_format);
+        primary_compression_model = rle_context;
 
-          // Сериализуем контекст
-          Result result = rle_serialize_context(
-            rle_context, &primary_tree_model_data, &primary_tree_model_size);
-          if (result != RESULT_OK)
-          {
-            printf("[RLE] Ошибка сериализации контекста!\n");
-            primary_tree_model_data = NULL;
-            primary_tree_model_size = 0;
-          }
+        // Сериализуем контекст
+        Result result = rle_serialize_context(
+          rle_context, &primary_tree_model_data, &primary_tree_model_size);
+        if (result != RESULT_OK)
+        {
+          LOG_ERROR("[RLE] Ошибка сериализации контекста!\n");
+          primary_tree_model_data = NULL;
+          primary_tree_model_size = 0;
         }
       }
-      else if (primary_algo == COMPRESSION_LZ77)
+    }
+    else if (primary_algo == COMPRESSION_LZ77)
+    {
+      Byte prefix = lz77_analyze_prefix(self->all_data, self->all_data_size);
+      primary_tree_model_size = 1;
+      primary_tree_model_data = malloc(primary_tree_model_size);
+      if (primary_tree_model_data)
+      {
+        primary_tree_model_data[0] = prefix;
+      }
+    }
+
+    // Вместо модели в архив пишется ссылка на словарь
+    if (dictionary)
+    {
+      DWord hash = dictionary_get_hash(dictionary);
+      primary_tree_model_data =
+        (Byte*)malloc(COMPRESSED_ARCHIVE_DICTIONARY_REFERENCE_SIZE);
+      if (primary_tree_model_data)
+      {
+        memcpy(primary_tree_model_data, &hash, sizeof(hash));
+        primary_tree_model_size = COMPRESSED_ARCHIVE_DICTIONARY_REFERENCE_SIZE;
+      }
+      LOG_INFO("Модель заменена ссылкой на словарь %08X\n", hash);
+    }
+
+    // Контекст вторичного этапа: префикс RLE/LZ77 подбирается для каждого
+    // блока и пишется в его кадр, в архиве хранится только формат RLE
+    if (use_two_stage && secondary_algo == COMPRESSION_RLE)
+    {
+      RLEContext* rle_context = rle_create(0);
+      if (rle_context)
       {
-        Byte prefix = lz77_analyze_prefix(self->all_data, self->all_data_size);
-        primary_tree_model_size = 1;
-        primary_tree_model_data = malloc(primary_tree_model_size);
-        if (primary_tree_model_data)
+        rle_set_format(rle_context, self->rle_format);
+        secondary_compression_model = rle_context;
+        if (rle_serialize_context(rle_context, &secondary_context_data,
+                                  &secondary_context_size) != RESULT_OK)
         {
-          primary_tree_model_data[0] = prefix;
+          secondary_context_data = NULL;
+          secondary_context_size = 0;
         }
       }
     }
+    else if (use_two_stage && secondary_algo == COMPRESSION_LZ77)
+    {
+      secondary_context_data = malloc(1);
+      if (secondary_context_data)
+      {
+        secondary_context_data[0] = 0;
+        secondary_context_size = 1;
+      }
+    }
+
+    stats_span_end(self->stats, &span, self->all_data_size,
+                   primary_tree_model_size);
+
+    if (self->solid_block_size > 0 &&
+        (primary_algo != COMPRESSION_NONE ||
+         secondary_algo != COMPRESSION_NONE) &&
+        group_solid_blocks(self, 0) != RESULT_OK)
+    {
+      LOG_WARN("Не удалось собрать сплошные блоки, файлы сжимаются "
+               "по отдельности\n");
+      file_table_clear_solid_blocks(self->file_table);
+    }
 
     // Шаг 2: Создаем заголовок
     DWord flags =
@@ -1630,8 +2576,14 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
       flags |= FLAG_TWO_STAGE_COMPRESSION;
     }
 
+    flags |= FLAG_CHECKSUMS | compressed_archive_table_flags(self->file_table);
+
     // Устанавливаем флаги для конкретных алгоритмов
-    if (primary_algo == COMPRESSION_HUFFMAN)
+    if (dictionary)
+    {
+      flags |= FLAG_DICTIONARY;
+    }
+    else if (primary_algo == COMPRESSION_HUFFMAN)
     {
       flags |= FLAG_HUFFMAN_TREE;
     }
@@ -1657,18 +2609,21 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
     }
 
     CompressedArchiveHeader header;
+    stats_span_begin(self->stats, &span, STATS_STAGE_CRC, "header");
     Result result = compressed_archive_header_init(
       &header, file_table_get_total_size(self->file_table), primary_algo,
       secondary_algo, ERROR_CORRECTION_NONE, flags);
+    stats_span_end(self->stats, &span, COMPRESSED_ARCHIVE_HEADER_SIZE, 0);
 
     if (result != RESULT_OK)
     {
-      printf("Ошибка инициализации заголовка архива!\n");
+      LOG_ERROR("Ошибка инициализации заголовка архива!\n");
       goto cleanup;
     }
 
-    // Устанавливаем размеры моделей
-    if (use_two_stage)
+    // Устанавливаем размеры моделей. Ссылка на словарь появилась вместе с
+    // общим полем, поэтому поля конкретных алгоритмов для нее не нужны
+    if (use_two_stage || dictionary)
     {
       header.primary_tree_model_size = (DWord)primary_tree_model_size;
       header.secondary_context_size = (DWord)secondary_context_size;
@@ -1702,45 +2657,53 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
       }
     }
 
-    printf("\n=== Создание заголовка ===\n");
-    printf("Алгоритм сжатия: %s\n",
-           primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-           : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-           : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-           : primary_algo == COMPRESSION_RLE        ? "RLE"
-           : primary_algo == COMPRESSION_LZ78       ? "LZ78"
-           : primary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                    : "NONE");
+    LOG_DEBUG("\n=== Создание заголовка ===\n");
+    LOG_DEBUG("Алгоритм сжатия: %s\n",
+              primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
+              : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
+              : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
+              : primary_algo == COMPRESSION_RLE        ? "RLE"
+              : primary_algo == COMPRESSION_LZ78       ? "LZ78"
+              : primary_algo == COMPRESSION_LZ77       ? "LZ77"
+              : primary_algo == COMPRESSION_LZH        ? "LZH"
+                                                       : "NONE");
     if (use_two_stage)
     {
-      printf("Вторичный алгоритм: %s\n",
-             secondary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-             : secondary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-             : secondary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-             : secondary_algo == COMPRESSION_RLE        ? "RLE"
-             : secondary_algo == COMPRESSION_LZ78       ? "LZ78"
-             : secondary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                        : "NONE");
+      LOG_INFO("Вторичный алгоритм: %s\n",
+               secondary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
+               : secondary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
+               : secondary_algo == COMPRESSION_SHANNON    ? "SHANNON"
+               : secondary_algo == COMPRESSION_RLE        ? "RLE"
+               : secondary_algo == COMPRESSION_LZ78       ? "LZ78"
+               : secondary_algo == COMPRESSION_LZ77       ? "LZ77"
+               : secondary_algo == COMPRESSION_LZH        ? "LZH"
+                                                          : "NONE");
     }
-    printf("Флаги: 0x%08X\n", flags);
-    printf("Размер модели/дерева: %u байт\n", header.primary_tree_model_size);
+    LOG_DEBUG("Флаги: 0x%08X\n", flags);
+    LOG_DEBUG("Размер модели/дерева: %u байт\n",
+              header.primary_tree_model_size);
     if (use_two_stage)
     {
-      printf("Размер вторичного контекста: %u байт\n",
-             header.secondary_context_size);
+      LOG_DEBUG("Размер вторичного контекста: %u байт\n",
+                header.secondary_context_size);
     }
 
-    result = compressed_archive_header_write(&header, self->archive_file);
+    stats_span_begin(self->stats, &span, STATS_STAGE_WRITE, "header");
+    result = compressed_archive_header_update_crc(&header);
+    if (result == RESULT_OK)
+    {
+      result = compressed_archive_header_write(&header, self->archive_file);
+    }
+    stats_span_end(self->stats, &span, 0, COMPRESSED_ARCHIVE_HEADER_SIZE);
     if (result != RESULT_OK)
     {
-      printf("Ошибка записи заголовка архива!\n");
+      LOG_ERROR("Ошибка записи заголовка архива!\n");
       goto cleanup;
     }
 
     // Шаг 3: Рассчитываем смещения
-    QWord data_offset = COMPRESSED_ARCHIVE_HEADER_SIZE;
-    data_offset += sizeof(DWord);  // file_count
-    data_offset += file_table_get_count(self->file_table) * sizeof(FileEntry);
+    QWord data_offset = COMPRESSED_ARCHIVE_HEADER_SIZE +
+                        compressed_archive_table_size(self->file_table);
 
     // Добавляем место для моделей/деревьев
     if (primary_tree_model_data && primary_tree_model_size > 0)
@@ -1752,8 +2715,11 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
       data_offset += secondary_context_size;
     }
 
-    printf("\n=== Расчет смещений ===\n");
-    printf("Смещение после заголовка: %llu байт\n", data_offset);
+    LOG_DEBUG("\n=== Расчет смещений ===\n");
+    LOG_DEBUG("Смещение после заголовка: %llu байт\n", data_offset);
+
+    Size alignment =
+      self->align_stored ? file_get_block_size(self->archive_file) : 0;
 
     // Массив для хранения сжатых данных каждого файла
     Byte** compressed_files_data = NULL;
@@ -1770,7 +2736,7 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
 
       if (compressed_files_data == NULL || compressed_files_sizes == NULL)
       {
-        printf("Произошла ошибка при выделении памяти для сжатых данных!\n");
+        LOG_ERROR("Произошла ошибка при выделении памяти для сжатых данных!\n");
         result = RESULT_MEMORY_ERROR;
         goto cleanup;
       }
@@ -1781,14 +2747,90 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
              sizeof(Size) * file_table_get_count(self->file_table));
     }
 
-    printf("\n=== Сжатие файлов ===\n");
+    LOG_INFO("\n=== Сжатие файлов ===\n");
     bool compression_successful = true;
 
+    char codec_label[STATS_LABEL_LIMIT];
+    if (use_two_stage)
+    {
+      snprintf(codec_label, sizeof(codec_label), "%s+%s",
+               compressed_archive_algorithm_name(secondary_algo),
+               compressed_archive_algorithm_name(primary_algo));
+    }
+    else
+    {
+      snprintf(codec_label, sizeof(codec_label), "%s",
+               compressed_archive_algorithm_name(primary_algo));
+    }
+
+    // Контекст первичного этапа двухэтапного сжатия: для LZ77 это префикс,
+    // для LZH - уровень сжатия и окно словаря
+    LZHStageContext primary_lzh = {self->level,
+                                   dictionary_get_window(dictionary),
+                                   dictionary_get_window_size(dictionary)};
+    const void* primary_context =
+      primary_algo == COMPRESSION_LZ77  ? (const void*)primary_tree_model_data
+      : primary_algo == COMPRESSION_LZH ? (const void*)&primary_lzh
+                                        : primary_compression_model;
+
     for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
     {
       FileEntry* entry = (FileEntry*)file_table_get_entry(self->file_table, i);
-      printf("Файл %u/%u: %s\n", i + 1, file_table_get_count(self->file_table),
-             entry->filename);
+      LOG_INFO("Файл %u/%u: %s\n", i + 1,
+               file_table_get_count(self->file_table), entry->filename);
+
+      // Блок сжимается целиком при встрече первого участника, остальные
+      // уже получили смещения внутри блока
+      DWord block_index = file_table_find_solid_block(self->file_table, i);
+      if (block_index != FILE_TABLE_NO_ENTRY)
+      {
+        FileSolidBlock* block = (FileSolidBlock*)file_table_get_solid_block(
+          self->file_table, block_index);
+        if (block->first_entry != i)
+        {
+          continue;
+        }
+
+        stats_span_begin(self->stats, &span, STATS_STAGE_COMPRESS,
+                         codec_label);
+        result = compress_solid_block(
+          self, block_index, primary_algo, primary_context, use_two_stage,
+          secondary_algo, (RLEContext*)secondary_compression_model,
+          &compressed_files_data[i], &compressed_files_sizes[i]);
+        stats_span_end(self->stats, &span, block->data_size,
+                       compressed_files_sizes[i]);
+        if (result != RESULT_OK)
+        {
+          LOG_ERROR("  Ошибка сжатия сплошного блока!\n");
+          compression_successful = false;
+          break;
+        }
+
+        block->offset = data_offset;
+        block->compressed_size = compressed_files_sizes[i];
+        data_offset += compressed_files_sizes[i];
+        continue;
+      }
+
+      if (entry->original_size == 0)
+      {
+        // Пустой (или полностью разреженный) файл - сжимать нечего
+        entry->compressed_size = 0;
+        entry->offset = data_offset;
+        continue;
+      }
+
+      if (compressed_files_data == NULL)
+      {
+        // Без сжатия данные копируются из исходного файла на шаге 7
+        entry->compressed_size = entry->original_size;
+        entry->offset =
+          align_stored_offset(data_offset, entry->original_size, alignment);
+        data_offset = entry->offset + entry->original_size;
+        continue;
+      }
+
+      stats_span_begin(self->stats, &span, STATS_STAGE_COMPRESS, codec_label);
 
       if (use_two_stage)
       {
@@ -1799,7 +2841,7 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         File* input_file = file_create(entry->filename);
         if (input_file == NULL)
         {
-          printf("  Ошибка открытия файла для сжатия!\n");
+          LOG_ERROR("  Ошибка открытия файла для сжатия!\n");
           compression_successful = false;
           break;
         }
@@ -1808,17 +2850,18 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         if (open_result != RESULT_OK)
         {
           file_destroy(input_file);
-          printf("  Ошибка открытия файла для чтения!\n");
+          LOG_ERROR("  Ошибка открытия файла для чтения!\n");
           compression_successful = false;
           break;
         }
 
-        Result read_result = file_read_bytes(input_file);
+        Result read_result =
+          file_table_read_entry_data(self->file_table, i, input_file);
         if (read_result != RESULT_OK)
         {
           file_close(input_file);
           file_destroy(input_file);
-          printf("  Ошибка чтения файла!\n");
+          LOG_ERROR("  Ошибка чтения файла!\n");
           compression_successful = false;
           break;
         }
@@ -1826,20 +2869,19 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         const Byte* original_data = file_get_buffer(input_file);
         Size original_size = file_get_size(input_file);
 
-        bool primary_failed = false;
         result = apply_two_stage_compression(
-          original_data, original_size, &compressed_data, &compressed_size,
-          primary_algo, secondary_algo, self->all_data, self->all_data_size,
-          &primary_model_data, &secondary_model_data, &primary_failed);
+          self, original_data, original_size, &compressed_data,
+          &compressed_size, primary_algo, primary_context, secondary_algo,
+          (RLEContext*)secondary_compression_model);
 
         file_close(input_file);
         file_destroy(input_file);
 
         if (result == RESULT_OK && compressed_data)
         {
-          printf("  Исходный размер: %llu байт\n", entry->original_size);
-          printf("  Сжатый размер: %zu байт\n", compressed_size);
-          printf(
+          LOG_DEBUG("  Исходный размер: %llu байт\n", entry->original_size);
+          LOG_DEBUG("  Сжатый размер: %zu байт\n", compressed_size);
+          LOG_DEBUG(
             "  Коэффициент сжатия: %.1f%%\n",
             (1.0 - (double)compressed_size / (double)entry->original_size) *
               100);
@@ -1851,11 +2893,11 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
           entry->offset = data_offset;
           data_offset += compressed_size;
 
-          printf("  Смещение в архиве: %llu байт\n", entry->offset);
+          LOG_DEBUG("  Смещение в архиве: %llu байт\n", entry->offset);
         }
         else
         {
-          printf("  Ошибка двухэтапного сжатия файла!\n");
+          LOG_ERROR("  Ошибка двухэтапного сжатия файла!\n");
           free(compressed_data);
           compression_successful = false;
           break;
@@ -1869,15 +2911,15 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
 
         if (primary_algo == COMPRESSION_RLE)
         {
-          // Используем общий контекст RLE
-          compressed_file_data.rle_context =
-            (RLEContext*)primary_compression_model;
+          // Используем общий контекст RLE. Он принадлежит finalize и
+          // освобождается в конце, поэтому в compressed_file_data не
+          // сохраняется
           compressed_file_data.algorithm = COMPRESSION_RLE;
 
           File* input_file = file_create(entry->filename);
           if (input_file == NULL)
           {
-            printf("  Ошибка открытия файла для сжатия RLE!\n");
+            LOG_ERROR("  Ошибка открытия файла для сжатия RLE!\n");
             compression_successful = false;
             break;
           }
@@ -1886,17 +2928,18 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
           if (open_result != RESULT_OK)
           {
             file_destroy(input_file);
-            printf("  Ошибка открытия файла для чтения!\n");
+            LOG_ERROR("  Ошибка открытия файла для чтения!\n");
             compression_successful = false;
             break;
           }
 
-          Result read_result = file_read_bytes(input_file);
+          Result read_result =
+            file_table_read_entry_data(self->file_table, i, input_file);
           if (read_result != RESULT_OK)
           {
             file_close(input_file);
             file_destroy(input_file);
-            printf("  Ошибка чтения файла!\n");
+            LOG_ERROR("  Ошибка чтения файла!\n");
             compression_successful = false;
             break;
           }
@@ -1913,12 +2956,14 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
           file_close(input_file);
           file_destroy(input_file);
         }
-        else if (primary_algo == COMPRESSION_LZ78)
+        else if (primary_algo == COMPRESSION_LZ78 ||
+                 primary_algo == COMPRESSION_LZH)
         {
-          result =
-            compress_file_data(entry->filename, primary_algo, NULL,
-                               0,  // LZ78 не использует глобальные данные
-                               &compressed_file_data);
+          // LZ78 и LZH не используют глобальные данные, LZH - только
+          // окно словаря
+          result = compress_file_data(self->file_table, i, entry->filename,
+                                      primary_algo, self->level, dictionary,
+                                      NULL, 0, &compressed_file_data);
         }
         else if (primary_algo == COMPRESSION_LZ77)
         {
@@ -1934,7 +2979,7 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
             File* input_file = file_create(entry->filename);
             if (input_file == NULL)
             {
-              printf("  Ошибка открытия файла для анализа LZ77!\n");
+              LOG_ERROR("  Ошибка открытия файла для анализа LZ77!\n");
               compression_successful = false;
               break;
             }
@@ -1943,17 +2988,18 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
             if (open_result != RESULT_OK)
             {
               file_destroy(input_file);
-              printf("  Ошибка открытия файла для чтения!\n");
+              LOG_ERROR("  Ошибка открытия файла для чтения!\n");
               compression_successful = false;
               break;
             }
 
-            Result read_result = file_read_bytes(input_file);
+            Result read_result =
+              file_table_read_entry_data(self->file_table, i, input_file);
             if (read_result != RESULT_OK)
             {
               file_close(input_file);
               file_destroy(input_file);
-              printf("  Ошибка чтения файла!\n");
+              LOG_ERROR("  Ошибка чтения файла!\n");
               compression_successful = false;
               break;
             }
@@ -1967,13 +3013,13 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
             file_destroy(input_file);
           }
 
-          printf("  Используется префикс LZ77: 0x%02X\n", prefix);
+          LOG_DEBUG("  Используется префикс LZ77: 0x%02X\n", prefix);
 
           // Сжимаем с LZ77
           File* input_file = file_create(entry->filename);
           if (input_file == NULL)
           {
-            printf("  Ошибка открытия файла для сжатия LZ77!\n");
+            LOG_ERROR("  Ошибка открытия файла для сжатия LZ77!\n");
             compression_successful = false;
             break;
           }
@@ -1982,17 +3028,18 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
           if (open_result != RESULT_OK)
           {
             file_destroy(input_file);
-            printf("  Ошибка открытия файла для чтения!\n");
+            LOG_ERROR("  Ошибка открытия файла для чтения!\n");
             compression_successful = false;
             break;
           }
 
-          Result read_result = file_read_bytes(input_file);
+          Result read_result =
+            file_table_read_entry_data(self->file_table, i, input_file);
           if (read_result != RESULT_OK)
           {
             file_close(input_file);
             file_destroy(input_file);
-            printf("  Ошибка чтения файла!\n");
+            LOG_ERROR("  Ошибка чтения файла!\n");
             compression_successful = false;
             break;
           }
@@ -2010,9 +3057,10 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
         }
         else if (primary_algo != COMPRESSION_NONE)
         {
-          result =
-            compress_file_data(entry->filename, primary_algo, self->all_data,
-                               self->all_data_size, &compressed_file_data);
+          result = compress_file_data(self->file_table, i, entry->filename,
+                                      primary_algo, self->level, dictionary,
+                                      self->all_data, self->all_data_size,
+                                      &compressed_file_data);
         }
         else
         {
@@ -2021,7 +3069,7 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
 
           if (compressed_file_data.compressed_data == NULL)
           {
-            printf("Произошла ошибка при выделении памяти!\n");
+            LOG_ERROR("Произошла ошибка при выделении памяти!\n");
             compression_successful = false;
             break;
           }
@@ -2043,7 +3091,8 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
             break;
           }
 
-          Result read_result = file_read_bytes(input_file);
+          Result read_result =
+            file_table_read_entry_data(self->file_table, i, input_file);
           if (read_result != RESULT_OK)
           {
             file_close(input_file);
@@ -2065,13 +3114,13 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
 
         if (result == RESULT_OK && compressed_file_data.compressed_data)
         {
-          printf("  Исходный размер: %llu байт\n", entry->original_size);
-          printf("  Сжатый размер: %zu байт\n",
-                 compressed_file_data.compressed_size);
-          printf("  Коэффициент сжатия: %.1f%%\n",
-                 (1.0 - (double)compressed_file_data.compressed_size /
-                          (double)entry->original_size) *
-                   100);
+          LOG_DEBUG("  Исходный размер: %llu байт\n", entry->original_size);
+          LOG_DEBUG("  Сжатый размер: %zu байт\n",
+                    compressed_file_data.compressed_size);
+          LOG_DEBUG("  Коэффициент сжатия: %.1f%%\n",
+                    (1.0 - (double)compressed_file_data.compressed_size /
+                             (double)entry->original_size) *
+                      100);
 
           compressed_files_data[i] = compressed_file_data.compressed_data;
           compressed_files_sizes[i] = compressed_file_data.compressed_size;
@@ -2080,24 +3129,37 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
           entry->offset = data_offset;
           data_offset += compressed_file_data.compressed_size;
 
-          printf("  Смещение в архиве: %llu байт\n", entry->offset);
+          LOG_DEBUG("  Смещение в архиве: %llu байт\n", entry->offset);
 
           free_compressed_file_data(&compressed_file_data, true);
         }
         else
         {
-          printf("  Ошибка сжатия файла!\n");
+          LOG_ERROR("  Ошибка сжатия файла!\n");
           free_compressed_file_data(&compressed_file_data, false);
           compression_successful = false;
           break;
         }
       }
+
+      stats_span_end(self->stats, &span, entry->original_size,
+                     entry->compressed_size);
+    }
+
+    // Интервал файла, на котором сжатие прервалось
+    stats_span_end(self->stats, &span, 0, 0);
+
+    // Контекст вторичного RLE нужен только на время сжатия блоков
+    if (secondary_compression_model && secondary_algo == COMPRESSION_RLE)
+    {
+      rle_destroy((RLEContext*)secondary_compression_model);
+      secondary_compression_model = NULL;
     }
 
     if (!compression_successful && (primary_algo != COMPRESSION_NONE ||
                                     secondary_algo != COMPRESSION_NONE))
     {
-      printf("\n=== Переход на несжатый режим ===\n");
+      LOG_INFO("\n=== Переход на несжатый режим ===\n");
 
       if (compressed_files_data)
       {
@@ -2118,118 +3180,147 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
       secondary_algo = COMPRESSION_NONE;
       use_two_stage = false;
 
+      // Модель не записывается: смещения ниже считаются без нее
+      free(primary_tree_model_data);
+      primary_tree_model_data = NULL;
+      primary_tree_model_size = 0;
+
       flags &= ~(FLAG_COMPRESSED | FLAG_HUFFMAN_TREE | FLAG_ARITHMETIC_MODEL |
                  FLAG_SHANNON_TREE | FLAG_RLE_CONTEXT | FLAG_LZ78_CONTEXT |
-                 FLAG_LZ77_CONTEXT | FLAG_TWO_STAGE_COMPRESSION);
+                 FLAG_LZ77_CONTEXT | FLAG_TWO_STAGE_COMPRESSION |
+                 FLAG_DICTIONARY | FLAG_SOLID_BLOCKS);
       flags |=
         file_table_get_count(self->file_table) > 1 ? FLAG_DIRECTORY : FLAG_NONE;
 
+      stats_span_begin(self->stats, &span, STATS_STAGE_CRC, "header");
       compressed_archive_header_init(
         &header, file_table_get_total_size(self->file_table), COMPRESSION_NONE,
         COMPRESSION_NONE, ERROR_CORRECTION_NONE, flags);
+      stats_span_end(self->stats, &span, COMPRESSED_ARCHIVE_HEADER_SIZE, 0);
 
       header.primary_tree_model_size = 0;
       header.secondary_context_size = 0;
+      file_table_clear_solid_blocks(self->file_table);
 
       file_seek(self->archive_file, 0, SEEK_SET);
       result = compressed_archive_header_write(&header, self->archive_file);
       if (result != RESULT_OK)
       {
-        printf("Ошибка перезаписи заголовка!\n");
+        LOG_ERROR("Ошибка перезаписи заголовка!\n");
         goto cleanup;
       }
 
-      data_offset = COMPRESSED_ARCHIVE_HEADER_SIZE;
-      data_offset += sizeof(DWord);
-      data_offset += file_table_get_count(self->file_table) * sizeof(FileEntry);
+      data_offset = COMPRESSED_ARCHIVE_HEADER_SIZE +
+                    compressed_archive_table_size(self->file_table);
 
       for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
       {
         FileEntry* entry =
           (FileEntry*)file_table_get_entry(self->file_table, i);
         entry->compressed_size = entry->original_size;
-        entry->offset = data_offset;
-        data_offset += entry->original_size;
+        entry->offset =
+          align_stored_offset(data_offset, entry->original_size, alignment);
+        data_offset = entry->offset + entry->original_size;
       }
     }
 
     // Шаг 4: Записываем таблицу файлов
-    printf("\n=== Запись таблицы файлов ===\n");
+    stats_span_begin(self->stats, &span, STATS_STAGE_WRITE, "data");
+    LOG_DEBUG("\n=== Запись таблицы файлов ===\n");
     file_seek(self->archive_file, COMPRESSED_ARCHIVE_HEADER_SIZE, SEEK_SET);
-    result = file_table_write(self->file_table, self->archive_file);
+    result =
+      compressed_archive_write_table(self->file_table, self->archive_file);
     if (result != RESULT_OK)
     {
-      printf("Ошибка записи таблицы файлов!\n");
       goto cleanup_compressed_files;
     }
 
-    printf("Таблица файлов записана успешно\n");
+    LOG_DEBUG("Таблица файлов записана успешно\n");
 
     // Шаг 5: Записываем модель/дерево сжатия (если есть)
     if (primary_tree_model_data && primary_tree_model_size > 0)
     {
-      printf("\n=== Запись модели/дерева первичного алгоритма ===\n");
-      printf("Размер модели/дерева: %zu байт\n", primary_tree_model_size);
+      LOG_DEBUG("\n=== Запись модели/дерева первичного алгоритма ===\n");
+      LOG_DEBUG("Размер модели/дерева: %zu байт\n", primary_tree_model_size);
 
       result = file_write_bytes(self->archive_file, primary_tree_model_data,
                                 primary_tree_model_size);
       if (result != RESULT_OK)
       {
-        printf("Ошибка записи модели/дерева первичного алгоритма!\n");
+        LOG_ERROR("Ошибка записи модели/дерева первичного алгоритма!\n");
         goto cleanup_compressed_files;
       }
 
-      printf("Модель/дерево первичного алгоритма записано успешно\n");
+      LOG_DEBUG("Модель/дерево первичного алгоритма записано успешно\n");
     }
 
     // Шаг 6: Записываем контекст вторичного алгоритма (если есть)
     if (use_two_stage && secondary_context_data && secondary_context_size > 0)
     {
-      printf("\n=== Запись контекста вторичного алгоритма ===\n");
-      printf("Размер контекста: %zu байт\n", secondary_context_size);
+      LOG_DEBUG("\n=== Запись контекста вторичного алгоритма ===\n");
+      LOG_DEBUG("Размер контекста: %zu байт\n", secondary_context_size);
 
       result = file_write_bytes(self->archive_file, secondary_context_data,
                                 secondary_context_size);
       if (result != RESULT_OK)
       {
-        printf("Ошибка записи контекста вторичного алгоритма!\n");
+        LOG_ERROR("Ошибка записи контекста вторичного алгоритма!\n");
         goto cleanup_compressed_files;
       }
 
-      printf("Контекст вторичного алгоритма записан успешно\n");
+      LOG_DEBUG("Контекст вторичного алгоритма записан успешно\n");
     }
 
     // Шаг 7: Записываем данные файлов
-    printf("\n=== Запись данных файлов ===\n");
+    LOG_DEBUG("\n=== Запись данных файлов ===\n");
     for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
     {
       const FileEntry* entry = file_table_get_entry(self->file_table, i);
-      printf("Файл %u/%u: %s ", i + 1, file_table_get_count(self->file_table),
-             entry->filename);
+      LOG_DEBUG("Файл %u/%u: %s ", i + 1,
+                file_table_get_count(self->file_table), entry->filename);
+
+      // Данные участников сплошного блока записаны вместе с первым из них
+      DWord block_index = file_table_find_solid_block(self->file_table, i);
+      if (block_index != FILE_TABLE_NO_ENTRY &&
+          file_table_get_solid_block(self->file_table, block_index)
+              ->first_entry != i)
+      {
+        LOG_DEBUG("(в сплошном блоке)\n");
+        continue;
+      }
 
       if ((primary_algo != COMPRESSION_NONE ||
            secondary_algo != COMPRESSION_NONE) &&
           compressed_files_data && compressed_files_data[i])
       {
-        printf("(сжатый, %zu -> %llu байт)\n", compressed_files_sizes[i],
-               entry->original_size);
+        LOG_DEBUG("(сжатый, %zu -> %llu байт)\n", compressed_files_sizes[i],
+                  entry->original_size);
 
         result = file_write_bytes(self->archive_file, compressed_files_data[i],
                                   compressed_files_sizes[i]);
         if (result != RESULT_OK)
         {
-          printf("Ошибка записи сжатых данных файла!\n");
+          LOG_ERROR("Ошибка записи сжатых данных файла!\n");
           break;
         }
       }
       else
       {
-        printf("(несжатый, %llu байт)\n", entry->original_size);
+        LOG_DEBUG("(несжатый, %llu байт)\n", entry->original_size);
 
-        result = write_file_data(self->archive_file, entry->filename);
+        // Промежуток перед выровненной записью остается дырой
+        if (alignment > 0)
+        {
+          result = file_seek(self->archive_file, (long)entry->offset, SEEK_SET);
+        }
+        if (result == RESULT_OK)
+        {
+          result = write_file_data(self->archive_file, self->file_table, i,
+                                   entry->filename);
+        }
         if (result != RESULT_OK)
         {
-          printf("Ошибка записи данных файла!\n");
+          LOG_ERROR("Ошибка записи данных файла!\n");
           break;
         }
       }
@@ -2241,6 +3332,10 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
     }
 
   cleanup_compressed_files:
+    stats_span_end(self->stats, &span, 0,
+                   (QWord)file_tell(self->archive_file) -
+                     COMPRESSED_ARCHIVE_HEADER_SIZE);
+
     if (compressed_files_data)
     {
       for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
@@ -2256,52 +3351,54 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
 
     if (result != RESULT_OK)
     {
-      printf("\nОшибка при создании архива!\n");
+      LOG_ERROR("\nОшибка при создании архива!\n");
       goto cleanup;
     }
 
-    printf("\nАрхив успешно создан!\n");
+    LOG_INFO("\nАрхив успешно создан!\n");
     if (use_two_stage)
     {
-      printf("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
-      printf("Первичный алгоритм: %s\n",
-             primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-             : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-             : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-                                                      : "NONE");
-      printf("Вторичный алгоритм: %s\n",
-             secondary_algo == COMPRESSION_RLE    ? "RLE"
-             : secondary_algo == COMPRESSION_LZ78 ? "LZ78"
-             : secondary_algo == COMPRESSION_LZ77 ? "LZ77"
-                                                  : "NONE");
+      LOG_INFO("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
+      LOG_INFO("Первичный алгоритм: %s\n",
+               primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
+               : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
+               : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
+                                                        : "NONE");
+      LOG_INFO("Вторичный алгоритм: %s\n",
+               secondary_algo == COMPRESSION_RLE    ? "RLE"
+               : secondary_algo == COMPRESSION_LZ78 ? "LZ78"
+               : secondary_algo == COMPRESSION_LZ77 ? "LZ77"
+               : secondary_algo == COMPRESSION_LZH  ? "LZH"
+                                                    : "NONE");
     }
     else
     {
-      printf("Режим: %s\n",
-             primary_algo == COMPRESSION_HUFFMAN      ? "СЖАТЫЙ (Huffman)"
-             : primary_algo == COMPRESSION_ARITHMETIC ? "СЖАТЫЙ (Arithmetic)"
-             : primary_algo == COMPRESSION_SHANNON    ? "СЖАТЫЙ (Shannon)"
-             : primary_algo == COMPRESSION_RLE        ? "СЖАТЫЙ (RLE)"
-             : primary_algo == COMPRESSION_LZ78       ? "СЖАТЫЙ (LZ78)"
-             : primary_algo == COMPRESSION_LZ77       ? "СЖАТЫЙ (LZ77)"
-                                                      : "НЕСЖАТЫЙ");
+      LOG_INFO("Режим: %s\n",
+               primary_algo == COMPRESSION_HUFFMAN      ? "СЖАТЫЙ (Huffman)"
+               : primary_algo == COMPRESSION_ARITHMETIC ? "СЖАТЫЙ (Arithmetic)"
+               : primary_algo == COMPRESSION_SHANNON    ? "СЖАТЫЙ (Shannon)"
+               : primary_algo == COMPRESSION_RLE        ? "СЖАТЫЙ (RLE)"
+               : primary_algo == COMPRESSION_LZ78       ? "СЖАТЫЙ (LZ78)"
+               : primary_algo == COMPRESSION_LZ77       ? "СЖАТЫЙ (LZ77)"
+               : primary_algo == COMPRESSION_LZH        ? "СЖАТЫЙ (LZH)"
+                                                        : "НЕСЖАТЫЙ");
     }
-    printf("Файлов в архиве: %u\n", file_table_get_count(self->file_table));
+    LOG_INFO("Файлов в архиве: %u\n", file_table_get_count(self->file_table));
 
     file_seek(self->archive_file, 0, SEEK_END);
     long archive_size = file_tell(self->archive_file);
-    printf("Размер архива: %ld байт\n", archive_size);
+    LOG_INFO("Размер архива: %ld байт\n", archive_size);
 
     if (primary_algo != COMPRESSION_NONE || secondary_algo != COMPRESSION_NONE)
     {
-      printf("\n=== Общий анализ архива ===\n");
-      printf("Общий исходный размер: %llu байт\n",
-             file_table_get_total_size(self->file_table));
-      printf("Общий сжатый размер: %ld байт\n", archive_size);
-      printf("Общий коэффициент сжатия: %.2f%%\n",
-             (1.0 - (double)archive_size /
-                      (double)file_table_get_total_size(self->file_table)) *
-               100);
+      LOG_INFO("\n=== Общий анализ архива ===\n");
+      LOG_INFO("Общий исходный размер: %llu байт\n",
+               file_table_get_total_size(self->file_table));
+      LOG_INFO("Общий сжатый размер: %ld байт\n", archive_size);
+      LOG_INFO("Общий коэффициент сжатия: %.2f%%\n",
+               (1.0 - (double)archive_size /
+                        (double)file_table_get_total_size(self->file_table)) *
+                 100);
     }
 
   cleanup:
@@ -2350,11 +3447,12 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
   }
   else
   {
-    printf("Нет данных для анализа. Создание несжатого архива.\n");
+    LOG_INFO("Нет данных для анализа. Создание несжатого архива.\n");
 
     // Создаем заголовок для несжатого архива
     DWord flags =
       file_table_get_count(self->file_table) > 1 ? FLAG_DIRECTORY : FLAG_NONE;
+    flags |= FLAG_CHECKSUMS | compressed_archive_table_flags(self->file_table);
 
     CompressedArchiveHeader header;
     compressed_archive_header_init(
@@ -2365,16 +3463,16 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
       compressed_archive_header_write(&header, self->archive_file);
     if (result != RESULT_OK)
     {
-      printf("Ошибка записи заголовка архива!\n");
+      LOG_ERROR("Ошибка записи заголовка архива!\n");
       return result;
     }
 
     // Записываем таблицу файлов
     file_seek(self->archive_file, COMPRESSED_ARCHIVE_HEADER_SIZE, SEEK_SET);
-    result = file_table_write(self->file_table, self->archive_file);
+    result =
+      compressed_archive_write_table(self->file_table, self->archive_file);
     if (result != RESULT_OK)
     {
-      printf("Ошибка записи таблицы файлов!\n");
       return result;
     }
 
@@ -2382,20 +3480,21 @@ Result compressed_archive_builder_finalize(CompressedArchiveBuilder* self)
     for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
     {
       const FileEntry* entry = file_table_get_entry(self->file_table, i);
-      result = write_file_data(self->archive_file, entry->filename);
+      result = write_file_data(self->archive_file, self->file_table, i,
+                               entry->filename);
       if (result != RESULT_OK)
       {
-        printf("Ошибка записи данных файла: %s\n", entry->filename);
+        LOG_ERROR("Ошибка записи данных файла: %s\n", entry->filename);
         return result;
       }
     }
 
-    printf("\nНесжатый архив успешно создан!\n");
-    printf("Файлов в архиве: %u\n", file_table_get_count(self->file_table));
+    LOG_INFO("\nНесжатый архив успешно создан!\n");
+    LOG_INFO("Файлов в архиве: %u\n", file_table_get_count(self->file_table));
 
     file_seek(self->archive_file, 0, SEEK_END);
     long archive_size = file_tell(self->archive_file);
-    printf("Размер архива: %ld байт\n", archive_size);
+    LOG_INFO("Размер архива: %ld байт\n", archive_size);
 
     return RESULT_OK;
   }
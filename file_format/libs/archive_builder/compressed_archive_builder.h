@@ -1,12 +1,28 @@
 #ifndef ARCHIVE_BUILDER_COMPRESSED_ARCHIVE_BUILDER_H
 #define ARCHIVE_BUILDER_COMPRESSED_ARCHIVE_BUILDER_H
 
+#include "dictionary.h"
+#include "stats.h"
 #include "types.h"
 
+// Уровни сжатия: больше - медленнее и плотнее. Сейчас уровень влияет на
+// LZH, на максимальном уровне включается оптимальный разбор
+#define COMPRESSED_ARCHIVE_LEVEL_MIN 1
+#define COMPRESSED_ARCHIVE_LEVEL_DEFAULT 6
+#define COMPRESSED_ARCHIVE_LEVEL_MAX 9
+
+#define COMPRESSED_ARCHIVE_SOLID_BLOCK_MAX (64 * 1024 * 1024)
+
 typedef struct CompressedArchiveBuilder CompressedArchiveBuilder;
 
 CompressedArchiveBuilder* compressed_archive_builder_create(
   const char* output_filename);
+// Дозапись в существующий архив: добавляются только новые файлы и файлы,
+// у которых изменились размер или время изменения; их новые записи при
+// извлечении заменяют прежние. Сжатие идет моделями архива, поэтому
+// настройки алгоритма не действуют, а архив со словарем требует его же
+CompressedArchiveBuilder* compressed_archive_builder_open_append(
+  const char* archive_filename);
 
 Result compressed_archive_builder_set_algorithm(CompressedArchiveBuilder* self,
                                                 const char* algorithm);
@@ -14,6 +30,35 @@ Result compressed_archive_builder_set_secondary_algorithm(
   CompressedArchiveBuilder* self, const char* algorithm);
 Result compressed_archive_builder_set_two_staged(CompressedArchiveBuilder* self,
                                                  bool enabled);
+Result compressed_archive_builder_set_level(CompressedArchiveBuilder* self,
+                                            int level);
+// Словарь заменяет модель первичного алгоритма (huffman, arithmetic,
+// shannon, lzh); в архив пишется только ссылка на него. Словарь не
+// принадлежит построителю и должен пережить finalize
+Result compressed_archive_builder_set_dictionary(
+  CompressedArchiveBuilder* self, const Dictionary* dictionary);
+// Дедупликация по содержимому: повторяющиеся чанки добавляемых файлов
+// хранятся и сжимаются один раз. Включается до добавления файлов
+Result compressed_archive_builder_set_dedup(CompressedArchiveBuilder* self,
+                                            bool enabled);
+// Сплошные блоки: подряд идущие файлы меньше block_size сжимаются одним
+// потоком до block_size байт, извлечение файла распаковывает весь блок.
+// 0 выключает блоки
+Result compressed_archive_builder_set_solid_block_size(
+  CompressedArchiveBuilder* self, Size block_size);
+// Несжатые записи не меньше блока файловой системы архива начинаются с
+// границы блока: извлечение на той же файловой системе клонирует их без
+// копирования. Действует при создании архива, дозапись не выравнивает
+Result compressed_archive_builder_set_alignment(CompressedArchiveBuilder* self,
+                                               bool align_stored);
+// Архив пишется томами по volume_size байт (путь.001, путь.002, ...), а по
+// пути архива остается манифест томов. Задается до finalize, при дозаписи
+// недоступно
+Result compressed_archive_builder_set_volume_size(
+  CompressedArchiveBuilder* self, QWord volume_size);
+// Статистика не принадлежит построителю и должна пережить finalize
+Result compressed_archive_builder_set_stats(CompressedArchiveBuilder* self,
+                                            Stats* stats);
 
 void compressed_archive_builder_destroy(CompressedArchiveBuilder* self);
 
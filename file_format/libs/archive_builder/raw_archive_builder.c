@@ -1,18 +1,19 @@
 #include "raw_archive_builder.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
 #include "file.h"
 #include "file_table.h"
+#include "log.h"
 #include "raw_archive_header.h"
 
 struct RawArchiveBuilder
 {
   File* archive_file;
   FileTable* file_table;
+  bool align_data;
 };
 
 RawArchiveBuilder* raw_archive_builder_create(const char* output_filename)
@@ -26,7 +27,7 @@ RawArchiveBuilder* raw_archive_builder_create(const char* output_filename)
     (RawArchiveBuilder*)malloc(sizeof(RawArchiveBuilder));
   if (builder == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
@@ -45,6 +46,8 @@ RawArchiveBuilder* raw_archive_builder_create(const char* output_filename)
     return NULL;
   }
 
+  builder->align_data = false;
+
   Result result = file_open_for_write(builder->archive_file);
   if (result != RESULT_OK)
   {
@@ -70,6 +73,29 @@ void raw_archive_builder_destroy(RawArchiveBuilder* self)
   free(self);
 }
 
+Result raw_archive_builder_set_alignment(RawArchiveBuilder* self,
+                                        bool align_data)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->align_data = align_data;
+  return RESULT_OK;
+}
+
+Result raw_archive_builder_set_volume_size(RawArchiveBuilder* self,
+                                          QWord volume_size)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  return file_split_volumes(self->archive_file, volume_size);
+}
+
 Result raw_archive_builder_add_file(RawArchiveBuilder* self,
                                     const char* filename)
 {
@@ -98,9 +124,13 @@ Result raw_archive_builder_add_directory(RawArchiveBuilder* self,
   return file_table_add_directory(self->file_table, dirname);
 }
 
-static Result write_file_data(File* archive_file, const char* filename)
+// Данные файла копируются в архив внутри ядра и не читаются в память. У
+// разреженного файла копируются только области с данными
+static Result write_file_data(File* archive_file, const FileTable* file_table,
+                              DWord index)
 {
-  File* input_file = file_create(filename);
+  const FileEntry* entry = file_table_get_entry(file_table, index);
+  File* input_file = file_create(entry->filename);
   if (input_file == NULL)
   {
     return RESULT_MEMORY_ERROR;
@@ -113,15 +143,28 @@ static Result write_file_data(File* archive_file, const char* filename)
     return result;
   }
 
-  result = file_read_bytes(input_file);
-  if (result != RESULT_OK)
+  const FileSparseMap* sparse_map =
+    file_table_get_sparse_map(file_table, index);
+  if (sparse_map != NULL)
   {
-    file_close(input_file);
-    file_destroy(input_file);
-    return result;
+    for (DWord i = 0; i < sparse_map->extent_count && result == RESULT_OK; i++)
+    {
+      result = file_copy_range(archive_file, input_file,
+                               sparse_map->extents[i].offset,
+                               sparse_map->extents[i].length);
+    }
+  }
+  else
+  {
+    result =
+      file_copy_range(archive_file, input_file, 0, entry->original_size);
   }
 
-  result = file_write_from_file(archive_file, input_file);
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при копировании файла в архив: %s\n",
+              entry->filename);
+  }
 
   file_close(input_file);
   file_destroy(input_file);
@@ -137,6 +180,10 @@ Result raw_archive_builder_finalize(RawArchiveBuilder* self)
 
   RawArchiveHeader header;
   raw_archive_header_init(&header, file_table_get_total_size(self->file_table));
+  if (file_table_has_sparse_files(self->file_table))
+  {
+    header.version = RAW_ARCHIVE_VERSION_SPARSE;
+  }
 
   Result result = raw_archive_header_write(&header, self->archive_file);
   if (result != RESULT_OK)
@@ -144,13 +191,27 @@ Result raw_archive_builder_finalize(RawArchiveBuilder* self)
     return result;
   }
 
+  // Смещения записей отсчитываются от начала данных, а выравнивается
+  // положение данных в файле архива. Записи меньше блока не выравниваются:
+  // клонировать в них нечего
+  QWord data_start =
+    RAW_ARCHIVE_HEADER_SIZE + sizeof(DWord) +
+    (file_table_get_count(self->file_table) * sizeof(FileEntry)) +
+    file_table_get_sparse_maps_size(self->file_table);
+  Size alignment =
+    self->align_data ? file_get_block_size(self->archive_file) : 0;
   QWord current_offset = 0;
 
   for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
   {
     FileEntry* entry = (FileEntry*)file_table_get_entry(self->file_table, i);
-    entry->offset = current_offset;
-    current_offset += entry->original_size;
+    QWord position = data_start + current_offset;
+    if (alignment > 0 && entry->original_size >= alignment)
+    {
+      position = (position + alignment - 1) / alignment * alignment;
+    }
+    entry->offset = position - data_start;
+    current_offset = entry->offset + entry->original_size;
   }
 
   result = file_table_write(self->file_table, self->archive_file);
@@ -159,10 +220,30 @@ Result raw_archive_builder_finalize(RawArchiveBuilder* self)
     return result;
   }
 
+  if (header.version == RAW_ARCHIVE_VERSION_SPARSE)
+  {
+    result = file_table_write_sparse_maps(self->file_table, self->archive_file);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+  }
+
   for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
   {
+    // Промежуток перед выровненной записью остается дырой
     const FileEntry* entry = file_table_get_entry(self->file_table, i);
-    result = write_file_data(self->archive_file, entry->filename);
+    if (alignment > 0)
+    {
+      result = file_seek(self->archive_file, (long)(data_start + entry->offset),
+                         SEEK_SET);
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+    }
+
+    result = write_file_data(self->archive_file, self->file_table, i);
     if (result != RESULT_OK)
     {
       return result;
@@ -1,6 +1,8 @@
 #ifndef ARCHIVE_BUILDER_RAW_ARCHIVE_BUILDER_H
 #define ARCHIVE_BUILDER_RAW_ARCHIVE_BUILDER_H
 
+#include <stdbool.h>
+
 #include "types.h"
 
 typedef struct RawArchiveBuilder RawArchiveBuilder;
@@ -8,6 +10,15 @@ typedef struct RawArchiveBuilder RawArchiveBuilder;
 RawArchiveBuilder* raw_archive_builder_create(const char* output_filename);
 void raw_archive_builder_destroy(RawArchiveBuilder* self);
 
+// Данные записей не меньше блока файловой системы архива начинаются с
+// границы блока, чтобы извлечение на той же файловой системе могло их
+// клонировать. Формат не меняется: выравнивание видно только в смещениях
+Result raw_archive_builder_set_alignment(RawArchiveBuilder* self,
+                                        bool align_data);
+// Архив пишется томами по volume_size байт (путь.001, путь.002, ...), а по
+// пути архива остается манифест томов. Задается до finalize
+Result raw_archive_builder_set_volume_size(RawArchiveBuilder* self,
+                                          QWord volume_size);
 Result raw_archive_builder_add_file(RawArchiveBuilder* self,
                                     const char* filename);
 Result raw_archive_builder_add_directory(RawArchiveBuilder* self,
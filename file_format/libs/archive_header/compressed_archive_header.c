@@ -1,6 +1,7 @@
 #include "compressed_archive_header.h"
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "crc32.h"
@@ -39,6 +40,9 @@ Result compressed_archive_header_init(CompressedArchiveHeader* header,
     return RESULT_INVALID_ARGUMENT;
   }
 
+  // Заголовок пишется в файл как есть: выравнивание тоже обнуляется, иначе
+  // архив зависит от мусора в памяти
+  memset(header, 0, sizeof(CompressedArchiveHeader));
   memcpy(header->signature, COMPRESSED_ARCHIVE_SIGNATURE,
          COMPRESSED_ARCHIVE_SIGNATURE_SIZE);
   header->version_major = COMPRESSED_ARCHIVE_VERSION_MAJOR;
@@ -72,6 +76,18 @@ Result compressed_archive_header_init(CompressedArchiveHeader* header,
     header->lz77_context_size = 0;
   }
 
+  return compressed_archive_header_update_crc(header);
+}
+
+// CRC считается по заголовку с нулевым полем header_crc
+Result compressed_archive_header_update_crc(CompressedArchiveHeader* header)
+{
+  if (header == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  header->header_crc = 0;
   CRC32Table* crc32_table = crc32_table_create();
   if (crc32_table == NULL)
   {
@@ -115,3 +131,76 @@ Result compressed_archive_header_read(CompressedArchiveHeader* header,
   return file_read_bytes_size(file, (Byte*)header,
                               COMPRESSED_ARCHIVE_HEADER_SIZE);
 }
+
+void compressed_archive_trailer_init(CompressedArchiveTrailer* trailer,
+                                     QWord table_offset, QWord model_offset)
+{
+  memset(trailer, 0, sizeof(CompressedArchiveTrailer));
+  memcpy(trailer->signature, COMPRESSED_ARCHIVE_SIGNATURE,
+         COMPRESSED_ARCHIVE_SIGNATURE_SIZE);
+  trailer->table_offset = table_offset;
+  trailer->model_offset = model_offset;
+}
+
+Result compressed_archive_trailer_write(const CompressedArchiveTrailer* trailer,
+                                        File* file)
+{
+  if (trailer == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  return file_write_bytes(file, (const Byte*)trailer,
+                          COMPRESSED_ARCHIVE_TRAILER_SIZE);
+}
+
+Result compressed_archive_trailer_read(CompressedArchiveTrailer* trailer,
+                                       File* file)
+{
+  if (trailer == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Result result =
+    file_seek(file, -(long)COMPRESSED_ARCHIVE_TRAILER_SIZE, SEEK_END);
+  if (result == RESULT_OK)
+  {
+    result = file_read_bytes_size(file, (Byte*)trailer,
+                                  COMPRESSED_ARCHIVE_TRAILER_SIZE);
+  }
+
+  if (result == RESULT_OK &&
+      memcmp(trailer->signature, COMPRESSED_ARCHIVE_SIGNATURE,
+             COMPRESSED_ARCHIVE_SIGNATURE_SIZE) != 0)
+  {
+    result = RESULT_ERROR;
+  }
+
+  return result;
+}
+
+const char* compressed_archive_algorithm_name(Byte algorithm)
+{
+  switch (algorithm)
+  {
+    case COMPRESSION_NONE:
+      return "none";
+    case COMPRESSION_HUFFMAN:
+      return "huffman";
+    case COMPRESSION_ARITHMETIC:
+      return "arithmetic";
+    case COMPRESSION_SHANNON:
+      return "shannon";
+    case COMPRESSION_RLE:
+      return "rle";
+    case COMPRESSION_LZ78:
+      return "lz78";
+    case COMPRESSION_LZ77:
+      return "lz77";
+    case COMPRESSION_LZH:
+      return "lzh";
+    default:
+      return "unknown";
+  }
+}
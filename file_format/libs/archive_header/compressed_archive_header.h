@@ -21,6 +21,7 @@ typedef enum
   COMPRESSION_RLE = 4,
   COMPRESSION_LZ78 = 5,
   COMPRESSION_LZ77 = 6,
+  COMPRESSION_LZH = 7,
 } CompressionAlgorithm;
 
 typedef enum
@@ -43,8 +44,33 @@ typedef enum
   FLAG_LZ78_CONTEXT = 1 << 8,            // Содержит контекст LZ78
   FLAG_LZ77_CONTEXT = 1 << 9,            // Содержит контекст LZ77
   FLAG_TWO_STAGE_COMPRESSION = 1 << 10,  // Используется двухэтапное сжатие
+  FLAG_SPARSE_FILES = 1 << 11,          // После таблицы файлов идут карты дыр
+  FLAG_DICTIONARY = 1 << 12,            // Модель во внешнем словаре
+  FLAG_DEDUP = 1 << 13,                 // Есть карты дедупликации
+  FLAG_APPENDED = 1 << 14,              // Таблица файлов в конце архива
+  FLAG_MTIMES = 1 << 15,                // Есть времена изменения файлов
+  FLAG_SOLID_BLOCKS = 1 << 16,          // Есть сплошные блоки
+  FLAG_CHECKSUMS = 1 << 17,  // CRC заголовка и записей можно проверять
 } CompressedArchiveFlags;
 
+// При FLAG_DICTIONARY вместо модели первичного алгоритма хранится ссылка на
+// внешний словарь - его CRC32 (primary_tree_model_size равен ее размеру
+// и в одноэтапном режиме). Huffman/arithmetic/shannon строят модель по
+// частотам словаря, LZH использует его окно как предшествующие данные
+#define COMPRESSED_ARCHIVE_DICTIONARY_REFERENCE_SIZE sizeof(DWord)
+
+// Данные файла при двухэтапном сжатии - последовательность кадров, каждый
+// кадр описывает блок до TWO_STAGE_CHUNK_SIZE исходных байт:
+//   [DWord raw_size][DWord stage_size][DWord stored_size][Byte flags]
+//   [Byte parameter][stored_size байт]
+// stage_size - размер блока между этапами, parameter - префикс вторичного
+// RLE/LZ77, подобранный для этого блока. Этап, не уменьшивший блок,
+// пропускается, и его флаг не ставится
+#define TWO_STAGE_CHUNK_SIZE (64 * 1024)
+#define TWO_STAGE_FRAME_HEADER_SIZE 14
+#define TWO_STAGE_FRAME_PRIMARY 0x01    // Блок прошел первичный этап
+#define TWO_STAGE_FRAME_SECONDARY 0x02  // Блок прошел вторичный этап
+
 typedef struct
 {
   // Базовый заголовок
@@ -84,15 +110,41 @@ typedef struct
 
 #define COMPRESSED_ARCHIVE_HEADER_SIZE (sizeof(CompressedArchiveHeader))
 
+// После дозаписи таблица файлов и карты переписываются за данными новых
+// записей, а архив заканчивается трейлером со смещениями. Модели остаются
+// на прежнем месте, сразу за исходной таблицей
+typedef struct
+{
+  char signature[COMPRESSED_ARCHIVE_SIGNATURE_SIZE];
+  Word reserved;
+  QWord table_offset;
+  QWord model_offset;
+} CompressedArchiveTrailer;
+
+#define COMPRESSED_ARCHIVE_TRAILER_SIZE (sizeof(CompressedArchiveTrailer))
+
 bool compressed_archive_header_is_valid(const CompressedArchiveHeader* header);
 Result compressed_archive_header_init(CompressedArchiveHeader* header,
                                       QWord original_size,
                                       Byte primary_compression,
                                       Byte secondary_compression,
                                       Byte error_correction, DWord flags);
+// Пересчет header_crc после изменения полей
+Result compressed_archive_header_update_crc(CompressedArchiveHeader* header);
 Result compressed_archive_header_write(const CompressedArchiveHeader* header,
                                        File* file);
 Result compressed_archive_header_read(CompressedArchiveHeader* header,
                                       File* file);
 
+void compressed_archive_trailer_init(CompressedArchiveTrailer* trailer,
+                                     QWord table_offset, QWord model_offset);
+Result compressed_archive_trailer_write(const CompressedArchiveTrailer* trailer,
+                                        File* file);
+// Читает трейлер с конца файла и проверяет его сигнатуру
+Result compressed_archive_trailer_read(CompressedArchiveTrailer* trailer,
+                                       File* file);
+
+// Короткое имя алгоритма (huffman, lz77, ...) для журналов и статистики
+const char* compressed_archive_algorithm_name(Byte algorithm);
+
 #endif  // ARCHIVE_HEADER_COMPRESSED_ARCHIVE_HEADER_H
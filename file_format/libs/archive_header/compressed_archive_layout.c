@@ -0,0 +1,180 @@
+#include "compressed_archive_layout.h"
+
+#include <stdio.h>
+
+#include "compressed_archive_header.h"
+#include "file.h"
+#include "file_table.h"
+#include "log.h"
+#include "types.h"
+
+Size compressed_archive_primary_model_size(
+  const CompressedArchiveHeader* header)
+{
+  Size legacy_model_size =
+    header->huffman_tree_size > 0      ? header->huffman_tree_size
+    : header->arithmetic_model_size > 0 ? header->arithmetic_model_size
+    : header->shannon_tree_size > 0     ? header->shannon_tree_size
+    : header->rle_context_size > 0      ? header->rle_context_size
+    : header->lz78_context_size > 0     ? header->lz78_context_size
+    : header->lz77_context_size > 0     ? header->lz77_context_size
+                                        : 0;
+
+  if (header->version_minor == 0 ||
+      (header->primary_tree_model_size == 0 &&
+       !(header->flags & FLAG_TWO_STAGE_COMPRESSION)))
+  {
+    return legacy_model_size;
+  }
+
+  return header->primary_tree_model_size;
+}
+
+DWord compressed_archive_table_flags(const FileTable* table)
+{
+  DWord flags = FLAG_NONE;
+  if (file_table_has_sparse_files(table))
+  {
+    flags |= FLAG_SPARSE_FILES;
+  }
+  if (file_table_has_dedup_files(table))
+  {
+    flags |= FLAG_DEDUP;
+  }
+  if (file_table_has_mtimes(table))
+  {
+    flags |= FLAG_MTIMES;
+  }
+  if (file_table_has_solid_blocks(table))
+  {
+    flags |= FLAG_SOLID_BLOCKS;
+  }
+
+  return flags;
+}
+
+QWord compressed_archive_table_size(const FileTable* table)
+{
+  QWord size = sizeof(DWord);  // file_count
+  size += file_table_get_count(table) * sizeof(FileEntry);
+  size += file_table_get_sparse_maps_size(table);
+  size += file_table_get_dedup_maps_size(table);
+  size += file_table_get_mtimes_size(table);
+  size += file_table_get_solid_blocks_size(table);
+  return size;
+}
+
+Result compressed_archive_write_table(const FileTable* table, File* file)
+{
+  Result result = file_table_write(table, file);
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Ошибка записи таблицы файлов!\n");
+    return result;
+  }
+
+  if (file_table_has_sparse_files(table))
+  {
+    result = file_table_write_sparse_maps(table, file);
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("Ошибка записи карт разреженных файлов!\n");
+      return result;
+    }
+  }
+
+  if (file_table_has_dedup_files(table))
+  {
+    result = file_table_write_dedup_maps(table, file);
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("Ошибка записи карт дедупликации!\n");
+      return result;
+    }
+  }
+
+  if (file_table_has_mtimes(table))
+  {
+    result = file_table_write_mtimes(table, file);
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("Ошибка записи времен изменения файлов!\n");
+      return result;
+    }
+  }
+
+  if (file_table_has_solid_blocks(table))
+  {
+    result = file_table_write_solid_blocks(table, file);
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("Ошибка записи сплошных блоков!\n");
+      return result;
+    }
+  }
+
+  return RESULT_OK;
+}
+
+Result compressed_archive_read_table(const CompressedArchiveHeader* header,
+                                     File* file, FileTable* table,
+                                     QWord* model_offset)
+{
+  if (header == NULL || file == NULL || table == NULL || model_offset == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  QWord table_offset = COMPRESSED_ARCHIVE_HEADER_SIZE;
+  CompressedArchiveTrailer trailer;
+  if (header->flags & FLAG_APPENDED)
+  {
+    if (compressed_archive_trailer_read(&trailer, file) != RESULT_OK)
+    {
+      LOG_ERROR("Трейлер архива поврежден!\n");
+      return RESULT_ERROR;
+    }
+    table_offset = trailer.table_offset;
+  }
+
+  Result result = file_seek(file, (long)table_offset, SEEK_SET);
+  if (result == RESULT_OK)
+  {
+    result = file_table_read(table, file);
+  }
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при чтении таблицы файлов!\n");
+    return result;
+  }
+
+  if (header->flags & FLAG_SPARSE_FILES)
+  {
+    result = file_table_read_sparse_maps(table, file);
+  }
+  if (result == RESULT_OK && (header->flags & FLAG_DEDUP))
+  {
+    result = file_table_read_dedup_maps(table, file);
+  }
+  if (result == RESULT_OK && (header->flags & FLAG_SPARSE_FILES))
+  {
+    result = file_table_check_sparse_sizes(table);
+  }
+  if (result == RESULT_OK && (header->flags & FLAG_MTIMES))
+  {
+    result = file_table_read_mtimes(table, file);
+  }
+  if (result == RESULT_OK && (header->flags & FLAG_SOLID_BLOCKS))
+  {
+    result = file_table_read_solid_blocks(table, file);
+  }
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  *model_offset = (header->flags & FLAG_APPENDED)
+                    ? trailer.model_offset
+                    : table_offset + compressed_archive_table_size(table);
+  return RESULT_OK;
+}
@@ -0,0 +1,30 @@
+#ifndef ARCHIVE_HEADER_COMPRESSED_ARCHIVE_LAYOUT_H
+#define ARCHIVE_HEADER_COMPRESSED_ARCHIVE_LAYOUT_H
+
+#include "compressed_archive_header.h"
+#include "file.h"
+#include "file_table.h"
+#include "types.h"
+
+// Метаданные архива за заголовком: таблица файлов и карты (дыр,
+// дедупликации, времен изменения, сплошных блоков), наличие которых
+// отмечено флагами заголовка. В новом архиве за ними идут модели, после
+// дозаписи они переносятся в конец архива перед трейлером
+
+// Размер модели первичного алгоритма: в версии 2.0 и при одноэтапном сжатии
+// 2.1 построитель заполняет только поле конкретного алгоритма
+Size compressed_archive_primary_model_size(
+  const CompressedArchiveHeader* header);
+
+// Флаги карт, которые есть в таблице
+DWord compressed_archive_table_flags(const FileTable* table);
+QWord compressed_archive_table_size(const FileTable* table);
+Result compressed_archive_write_table(const FileTable* table, File* file);
+
+// Читает таблицу с картами с ее места (с учетом трейлера); model_offset -
+// начало моделей
+Result compressed_archive_read_table(const CompressedArchiveHeader* header,
+                                     File* file, FileTable* table,
+                                     QWord* model_offset);
+
+#endif  // ARCHIVE_HEADER_COMPRESSED_ARCHIVE_LAYOUT_H
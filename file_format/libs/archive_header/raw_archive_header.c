@@ -2,10 +2,10 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <string.h>
 
 #include "file.h"
+#include "log.h"
 #include "types.h"
 
 bool raw_archive_header_is_valid(const RawArchiveHeader* header)
@@ -21,7 +21,8 @@ bool raw_archive_header_is_valid(const RawArchiveHeader* header)
     return false;
   }
 
-  if (header->version != RAW_ARCHIVE_VERSION)
+  if (header->version != RAW_ARCHIVE_VERSION &&
+      header->version != RAW_ARCHIVE_VERSION_SPARSE)
   {
     return false;
   }
@@ -48,9 +49,9 @@ Result raw_archive_header_write(const RawArchiveHeader* header, File* file)
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("Сигнатура: %s\n", header->signature);
-  printf("Версия: %d\n", header->version);
-  printf("Исходный размер: %" PRIu64 "\n", header->original_size);
+  LOG_DEBUG("Сигнатура: %s\n", header->signature);
+  LOG_DEBUG("Версия: %d\n", header->version);
+  LOG_DEBUG("Исходный размер: %" PRIu64 "\n", header->original_size);
 
   return file_write_bytes(file, (const Byte*)header, sizeof(RawArchiveHeader));
 }
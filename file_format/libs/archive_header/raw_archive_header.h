@@ -9,6 +9,7 @@
 #define RAW_ARCHIVE_SIGNATURE "lolkek"
 #define RAW_ARCHIVE_SIGNATURE_SIZE 6
 #define RAW_ARCHIVE_VERSION 0
+#define RAW_ARCHIVE_VERSION_SPARSE 1  // После таблицы файлов идут карты дыр
 
 typedef struct
 {
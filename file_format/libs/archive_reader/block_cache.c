@@ -0,0 +1,271 @@
+#include "block_cache.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+#define BLOCK_CACHE_INITIAL_BUCKETS 64
+
+typedef struct CachedBlock
+{
+  DWord entry;
+  DWord block;
+  Byte* data;
+  Size size;
+  struct CachedBlock* newer;  // Список от самого старого к самому свежему
+  struct CachedBlock* older;
+  struct CachedBlock* next;  // Следующий блок той же корзины
+} CachedBlock;
+
+struct BlockCache
+{
+  pthread_mutex_t lock;
+  CachedBlock** buckets;
+  DWord bucket_count;  // Степень двойки, не меньше числа блоков
+  DWord block_count;
+  Size used;
+  Size limit;
+  CachedBlock* oldest;
+  CachedBlock* newest;
+};
+
+static DWord hash_key(DWord entry, DWord block)
+{
+  QWord key = ((QWord)entry << 32) | block;
+  key ^= key >> 33;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33;
+  return (DWord)key;
+}
+
+static CachedBlock** find_slot(const BlockCache* self, DWord entry,
+                               DWord block)
+{
+  CachedBlock** slot =
+    &self->buckets[hash_key(entry, block) & (self->bucket_count - 1)];
+  while (*slot != NULL &&
+         ((*slot)->entry != entry || (*slot)->block != block))
+  {
+    slot = &(*slot)->next;
+  }
+
+  return slot;
+}
+
+static void unlink_block(BlockCache* self, CachedBlock* node)
+{
+  if (node->older != NULL)
+  {
+    node->older->newer = node->newer;
+  }
+  else
+  {
+    self->oldest = node->newer;
+  }
+
+  if (node->newer != NULL)
+  {
+    node->newer->older = node->older;
+  }
+  else
+  {
+    self->newest = node->older;
+  }
+}
+
+static void push_newest(BlockCache* self, CachedBlock* node)
+{
+  node->older = self->newest;
+  node->newer = NULL;
+  if (self->newest != NULL)
+  {
+    self->newest->newer = node;
+  }
+  else
+  {
+    self->oldest = node;
+  }
+  self->newest = node;
+}
+
+static void evict_oldest(BlockCache* self)
+{
+  CachedBlock* node = self->oldest;
+  CachedBlock** slot = find_slot(self, node->entry, node->block);
+  *slot = node->next;
+  unlink_block(self, node);
+  self->used -= node->size;
+  self->block_count--;
+  free(node->data);
+  free(node);
+}
+
+// Рост таблицы не обязателен: при нехватке памяти цепочки просто длиннее
+static void grow_buckets(BlockCache* self)
+{
+  DWord bucket_count = self->bucket_count * 2;
+  CachedBlock** buckets =
+    (CachedBlock**)calloc(bucket_count, sizeof(CachedBlock*));
+  if (buckets == NULL)
+  {
+    return;
+  }
+
+  for (DWord i = 0; i < self->bucket_count; i++)
+  {
+    CachedBlock* node = self->buckets[i];
+    while (node != NULL)
+    {
+      CachedBlock* next = node->next;
+      DWord bucket = hash_key(node->entry, node->block) & (bucket_count - 1);
+      node->next = buckets[bucket];
+      buckets[bucket] = node;
+      node = next;
+    }
+  }
+
+  free(self->buckets);
+  self->buckets = buckets;
+  self->bucket_count = bucket_count;
+}
+
+BlockCache* block_cache_create(Size memory_limit)
+{
+  BlockCache* cache = (BlockCache*)malloc(sizeof(BlockCache));
+  CachedBlock** buckets = (CachedBlock**)calloc(BLOCK_CACHE_INITIAL_BUCKETS,
+                                                sizeof(CachedBlock*));
+  if (cache == NULL || buckets == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(cache);
+    free(buckets);
+    return NULL;
+  }
+
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->buckets = buckets;
+  cache->bucket_count = BLOCK_CACHE_INITIAL_BUCKETS;
+  cache->block_count = 0;
+  cache->used = 0;
+  cache->limit = memory_limit > 0 ? memory_limit : BLOCK_CACHE_DEFAULT_LIMIT;
+  cache->oldest = NULL;
+  cache->newest = NULL;
+  return cache;
+}
+
+void block_cache_destroy(BlockCache* self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  while (self->oldest != NULL)
+  {
+    evict_oldest(self);
+  }
+
+  pthread_mutex_destroy(&self->lock);
+  free(self->buckets);
+  free(self);
+}
+
+bool block_cache_read(BlockCache* self, DWord entry, DWord block, Size offset,
+                      Size length, Byte* buffer)
+{
+  if (self == NULL || (buffer == NULL && length > 0))
+  {
+    return false;
+  }
+
+  pthread_mutex_lock(&self->lock);
+
+  CachedBlock* node = *find_slot(self, entry, block);
+  bool found = node != NULL && offset <= node->size &&
+               length <= node->size - offset;
+  if (found)
+  {
+    memcpy(buffer, node->data + offset, length);
+    unlink_block(self, node);
+    push_newest(self, node);
+  }
+
+  pthread_mutex_unlock(&self->lock);
+  return found;
+}
+
+Result block_cache_insert(BlockCache* self, DWord entry, DWord block,
+                          const Byte* data, Size size, DWord* evicted)
+{
+  if (evicted != NULL)
+  {
+    *evicted = 0;
+  }
+
+  if (self == NULL || (data == NULL && size > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (size > self->limit)
+  {
+    return RESULT_OK;
+  }
+
+  // Копия делается до захвата мьютекса, чтобы не держать его во время
+  // выделения памяти
+  CachedBlock* node = (CachedBlock*)malloc(sizeof(CachedBlock));
+  Byte* copy = (Byte*)malloc(size > 0 ? size : 1);
+  if (node == NULL || copy == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(node);
+    free(copy);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  memcpy(copy, data, size);
+  node->entry = entry;
+  node->block = block;
+  node->data = copy;
+  node->size = size;
+
+  pthread_mutex_lock(&self->lock);
+
+  // Другой поток мог успеть распаковать тот же блок
+  CachedBlock** slot = find_slot(self, entry, block);
+  if (*slot != NULL)
+  {
+    pthread_mutex_unlock(&self->lock);
+    free(copy);
+    free(node);
+    return RESULT_OK;
+  }
+
+  DWord evicted_count = 0;
+  while (self->used + size > self->limit)
+  {
+    evict_oldest(self);
+    evicted_count++;
+  }
+
+  node->next = NULL;
+  *find_slot(self, entry, block) = node;
+  push_newest(self, node);
+  self->used += size;
+  self->block_count++;
+  if (self->block_count > self->bucket_count)
+  {
+    grow_buckets(self);
+  }
+
+  pthread_mutex_unlock(&self->lock);
+
+  if (evicted != NULL)
+  {
+    *evicted = evicted_count;
+  }
+  return RESULT_OK;
+}
@@ -0,0 +1,30 @@
+#ifndef ARCHIVE_READER_BLOCK_CACHE_H
+#define ARCHIVE_READER_BLOCK_CACHE_H
+
+#include <stdbool.h>
+
+#include "types.h"
+
+#define BLOCK_CACHE_DEFAULT_LIMIT (64 * 1024 * 1024)
+
+// Кэш распакованных блоков архива с вытеснением давно не использованных
+// (LRU) и пределом суммарного объема данных. Ключ - (запись, блок), поэтому
+// один кэш обслуживает только один архив, зато его можно отдать нескольким
+// читателям этого архива, по читателю на поток: все вызовы защищены
+// мьютексом, данные копируются внутрь кэша и наружу под ним же
+typedef struct BlockCache BlockCache;
+
+// memory_limit == 0 выбирает BLOCK_CACHE_DEFAULT_LIMIT
+BlockCache* block_cache_create(Size memory_limit);
+void block_cache_destroy(BlockCache* self);
+
+// Копирует length байт блока начиная с offset и делает блок самым свежим.
+// false - блока нет в кэше
+bool block_cache_read(BlockCache* self, DWord entry, DWord block, Size offset,
+                      Size length, Byte* buffer);
+// Копирует блок в кэш, вытесняя самые старые блоки сверх предела; их
+// число возвращается в *evicted. Блок больше предела не кэшируется
+Result block_cache_insert(BlockCache* self, DWord entry, DWord block,
+                          const Byte* data, Size size, DWord* evicted);
+
+#endif  // ARCHIVE_READER_BLOCK_CACHE_H
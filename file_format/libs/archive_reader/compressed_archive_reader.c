@@ -5,17 +5,32 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "arithmetic.h"
 #include "compressed_archive_header.h"
+#include "compressed_archive_layout.h"
+#include "crc32.h"
+#include "dictionary.h"
 #include "file_table.h"
 #include "huffman.h"
+#include "log.h"
 #include "lz77.h"
 #include "lz78.h"
+#include "lzh.h"
 #include "path_utils.h"
 #include "rle.h"
+#include "scratch.h"
 #include "shannon.h"
+#include "stats.h"
 
-#define PATH_LIMIT 4096
+// Кадр двухэтапной записи в индексе для чтения диапазонов
+typedef struct
+{
+  QWord raw_offset;   // Смещение блока в сохраненных данных записи
+  QWord file_offset;  // Смещение заголовка кадра в архиве
+  Size frame_size;    // Длина кадра вместе с заголовком
+  Size raw_size;
+} FrameIndexEntry;
 
 struct CompressedArchiveReader
 {
@@ -43,6 +58,42 @@ struct CompressedArchiveReader
                                       // алгоритма
   Size secondary_lz77_context_size;   // Размер контекста LZ77 для вторичного
                                       // алгоритма
+  const Dictionary* dictionary;       // Словарь архива (не принадлежит)
+  DWord dictionary_hash;              // Ссылка на словарь из архива
+  Stats* stats;                       // Статистика этапов (не принадлежит)
+
+  // Сжатые данные читаются в scratch[0], распаковываются в scratch[1];
+  // scratch[2] - промежуточный блок двухэтапной распаковки
+  ScratchBuffer scratch[3];
+  // Сборка дедуплицированного файла и последний распакованный источник
+  // его участков
+  ScratchBuffer assembled;
+  ScratchBuffer source_cache;
+  Size source_cache_size;
+  DWord cached_source;
+  bool source_cached;
+  // Последний распакованный сплошной блок: его участники обычно
+  // извлекаются подряд
+  ScratchBuffer solid_block;
+  DWord cached_block;
+  bool block_cached;
+  // Чтение диапазонов: индекс кадров последней двухэтапной записи,
+  // последний распакованный блок - кадр или одноэтапная запись целиком - и
+  // необязательный общий кэш блоков (не принадлежит)
+  FrameIndexEntry* frame_index;
+  DWord frame_count;
+  DWord frame_capacity;
+  DWord indexed_entry;
+  bool frames_indexed;
+  ScratchBuffer range_block;
+  QWord range_block_offset;  // Смещение блока в сохраненных данных записи
+  Size range_block_size;
+  DWord range_entry;
+  DWord range_block_number;  // Номер кадра, для одноэтапной записи 0
+  bool range_cached;
+  BlockCache* block_cache;
+  CRC32Table* crc32_table;  // Проверка контрольных сумм записей
+  Arena* arena;  // Пути извлекаемых файлов, освобождаются после каждого файла
 };
 
 CompressedArchiveReader* compressed_archive_reader_create(
@@ -92,116 +143,141 @@ CompressedArchiveReader* compressed_archive_reader_create(
   reader->secondary_rle_context = NULL;
   reader->secondary_lz77_context_data = NULL;
   reader->secondary_lz77_context_size = 0;
+  reader->dictionary = NULL;
+  reader->dictionary_hash = 0;
+  reader->stats = NULL;
+  scratch_init(&reader->scratch[0]);
+  scratch_init(&reader->scratch[1]);
+  scratch_init(&reader->scratch[2]);
+  scratch_init(&reader->assembled);
+  scratch_init(&reader->source_cache);
+  reader->source_cache_size = 0;
+  reader->cached_source = 0;
+  reader->source_cached = false;
+  scratch_init(&reader->solid_block);
+  reader->cached_block = 0;
+  reader->block_cached = false;
+  reader->frame_index = NULL;
+  reader->frame_count = 0;
+  reader->frame_capacity = 0;
+  reader->indexed_entry = 0;
+  reader->frames_indexed = false;
+  scratch_init(&reader->range_block);
+  reader->range_block_offset = 0;
+  reader->range_block_size = 0;
+  reader->range_entry = 0;
+  reader->range_block_number = 0;
+  reader->range_cached = false;
+  reader->block_cache = NULL;
+  reader->arena = arena_create(0);
+  reader->crc32_table = crc32_table_create();
+
+  LOG_INFO("\n=== Открытие архива для чтения ===\n");
+  LOG_INFO("Файл: %s\n", input_filename);
+
+  if (reader->arena == NULL || reader->crc32_table == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    goto error;
+  }
 
-  printf("\n=== Открытие архива для чтения ===\n");
-  printf("Файл: %s\n", input_filename);
-
-  Result result = file_open_for_read(reader->archive_file);
+  Result result = file_open_for_read_volumes(reader->archive_file);
   if (result != RESULT_OK)
   {
-    printf("Произошла ошибка при открытии файла архива!\n");
+    LOG_ERROR("Произошла ошибка при открытии файла архива!\n");
     goto error;
   }
 
-  result = file_read_bytes(reader->archive_file);
+  // Данные записей читаются по смещениям по мере извлечения
+  result =
+    compressed_archive_header_read(&reader->header, reader->archive_file);
   if (result != RESULT_OK)
   {
-    printf("Произошла ошибка при чтении данных архива!\n");
+    LOG_ERROR("Произошла ошибка при чтении заголовка архива!\n");
     goto error;
   }
 
-  const Byte* data = file_get_buffer(reader->archive_file);
-  memcpy(&reader->header, data, COMPRESSED_ARCHIVE_HEADER_SIZE);
-
-  printf("Сигнатура: %.6s\n", reader->header.signature);
-  printf("Версия: %u.%u\n", reader->header.version_major,
-         reader->header.version_minor);
-  printf("Флаги: 0x%08X\n", reader->header.flags);
-  printf("Основной алгоритм сжатия: %u\n", reader->header.primary_compression);
-  printf("Вторичный алгоритм сжатия: %u\n",
-         reader->header.secondary_compression);
-  printf("Размер модели первичного алгоритма: %u байт\n",
-         reader->header.primary_tree_model_size);
-  printf("Размер контекста вторичного алгоритма: %u байт\n",
-         reader->header.secondary_context_size);
+  LOG_DEBUG("Сигнатура: %.6s\n", reader->header.signature);
+  LOG_DEBUG("Версия: %u.%u\n", reader->header.version_major,
+            reader->header.version_minor);
+  LOG_DEBUG("Флаги: 0x%08X\n", reader->header.flags);
+  LOG_DEBUG("Основной алгоритм сжатия: %u\n",
+            reader->header.primary_compression);
+  LOG_DEBUG("Вторичный алгоритм сжатия: %u\n",
+            reader->header.secondary_compression);
+  LOG_DEBUG("Размер модели первичного алгоритма: %u байт\n",
+            reader->header.primary_tree_model_size);
+  LOG_DEBUG("Размер контекста вторичного алгоритма: %u байт\n",
+            reader->header.secondary_context_size);
 
   // Для обратной совместимости
-  printf("Размер дерева Хаффмана: %u байт\n", reader->header.huffman_tree_size);
-  printf("Размер арифметической модели: %u байт\n",
-         reader->header.arithmetic_model_size);
-  printf("Размер дерева Шеннона: %u байт\n", reader->header.shannon_tree_size);
-  printf("Размер контекста RLE: %u байт\n", reader->header.rle_context_size);
-  printf("Размер контекста LZ78: %u байт\n", reader->header.lz78_context_size);
-  printf("Размер контекста LZ77: %u байт\n", reader->header.lz77_context_size);
+  LOG_DEBUG("Размер дерева Хаффмана: %u байт\n",
+            reader->header.huffman_tree_size);
+  LOG_DEBUG("Размер арифметической модели: %u байт\n",
+            reader->header.arithmetic_model_size);
+  LOG_DEBUG("Размер дерева Шеннона: %u байт\n",
+            reader->header.shannon_tree_size);
+  LOG_DEBUG("Размер контекста RLE: %u байт\n", reader->header.rle_context_size);
+  LOG_DEBUG("Размер контекста LZ78: %u байт\n",
+            reader->header.lz78_context_size);
+  LOG_DEBUG("Размер контекста LZ77: %u байт\n",
+            reader->header.lz77_context_size);
 
   if (!compressed_archive_header_is_valid(&reader->header))
   {
-    printf("Неверный заголовок архива!\n");
+    LOG_ERROR("Неверный заголовок архива!\n");
     result = RESULT_ERROR;
     goto error;
   }
 
-  printf("\n=== Чтение таблицы файлов ===\n");
-  file_seek(reader->archive_file, COMPRESSED_ARCHIVE_HEADER_SIZE, SEEK_SET);
-  result = file_table_read(reader->file_table, reader->archive_file);
+  LOG_DEBUG("\n=== Чтение таблицы файлов ===\n");
+  QWord model_offset = 0;
+  result = compressed_archive_read_table(&reader->header, reader->archive_file,
+                                         reader->file_table, &model_offset);
   if (result != RESULT_OK)
   {
-    printf("Произошла ошибка при чтении таблицы файлов!\n");
     goto error;
   }
 
-  printf("Файлов в архиве: %u\n", file_table_get_count(reader->file_table));
+  LOG_INFO("Файлов в архиве: %u\n", file_table_get_count(reader->file_table));
   for (DWord i = 0; i < file_table_get_count(reader->file_table); i++)
   {
     const FileEntry* entry = file_table_get_entry(reader->file_table, i);
-    printf("  Файл %u: %s (исходный: %llu, сжатый: %llu, смещение: %llu)\n",
-           i + 1, entry->filename, entry->original_size, entry->compressed_size,
-           entry->offset);
+    LOG_DEBUG("  Файл %u: %s (исходный: %llu, сжатый: %llu, смещение: %llu)\n",
+              i + 1, entry->filename, entry->original_size,
+              entry->compressed_size, entry->offset);
   }
 
   // Чтение моделей/деревьев сжатия
-  QWord model_offset = COMPRESSED_ARCHIVE_HEADER_SIZE;
-  model_offset += sizeof(DWord);  // file_count
-  model_offset += file_table_get_count(reader->file_table) * sizeof(FileEntry);
-
-  Size primary_model_size = 0;
+  Size primary_model_size =
+    compressed_archive_primary_model_size(&reader->header);
   Byte* primary_model_data = NULL;
 
-  Size secondary_context_size = 0;
+  // Для обратной совместимости с версией 2.0
+  Size secondary_context_size = reader->header.version_minor > 0
+                                  ? reader->header.secondary_context_size
+                                  : 0;
   Byte* secondary_context_data = NULL;
 
-  // Для обратной совместимости с версией 2.0
-  if (reader->header.version_minor == 0)
-  {
-    // Используем старый формат
-    primary_model_size =
-      reader->header.huffman_tree_size > 0 ? reader->header.huffman_tree_size
-      : reader->header.arithmetic_model_size > 0
-        ? reader->header.arithmetic_model_size
-      : reader->header.shannon_tree_size > 0 ? reader->header.shannon_tree_size
-      : reader->header.rle_context_size > 0  ? reader->header.rle_context_size
-      : reader->header.lz78_context_size > 0 ? reader->header.lz78_context_size
-      : reader->header.lz77_context_size > 0 ? reader->header.lz77_context_size
-                                             : 0;
-  }
-  else
+  if ((reader->header.flags & FLAG_DICTIONARY) &&
+      primary_model_size != COMPRESSED_ARCHIVE_DICTIONARY_REFERENCE_SIZE)
   {
-    // Используем новый формат для версии 2.1+
-    primary_model_size = reader->header.primary_tree_model_size;
-    secondary_context_size = reader->header.secondary_context_size;
+    LOG_ERROR("Некорректная ссылка на словарь в архиве!\n");
+    result = RESULT_ERROR;
+    goto error;
   }
 
   // Чтение модели первичного алгоритма
   if (primary_model_size > 0)
   {
-    printf("\n=== Чтение модели первичного алгоритма ===\n");
-    printf("Смещение модели: %llu байт\n", model_offset);
-    printf("Размер модели: %zu байт\n", primary_model_size);
+    LOG_DEBUG("\n=== Чтение модели первичного алгоритма ===\n");
+    LOG_DEBUG("Смещение модели: %llu байт\n", model_offset);
+    LOG_DEBUG("Размер модели: %zu байт\n", primary_model_size);
 
     primary_model_data = (Byte*)malloc(primary_model_size * sizeof(Byte));
     if (primary_model_data == NULL)
     {
-      printf("Произошла ошибка выделения памяти!\n");
+      LOG_ERROR("Произошла ошибка выделения памяти!\n");
       goto error;
     }
 
@@ -209,20 +285,26 @@ CompressedArchiveReader* compressed_archive_reader_create(
                           primary_model_size, model_offset);
     if (result != RESULT_OK)
     {
-      printf("Произошла ошибка при чтении модели первичного алгоритма!\n");
+      LOG_ERROR("Произошла ошибка при чтении модели первичного алгоритма!\n");
       free(primary_model_data);
       goto error;
     }
 
-    printf("Модель прочитана успешно\n");
+    LOG_DEBUG("Модель прочитана успешно\n");
 
-    // Десериализация в зависимости от алгоритма
-    if (reader->header.primary_compression == COMPRESSION_HUFFMAN)
+    // Десериализация в зависимости от алгоритма. Модели по словарю
+    // строятся в compressed_archive_reader_set_dictionary
+    if (reader->header.flags & FLAG_DICTIONARY)
+    {
+      memcpy(&reader->dictionary_hash, primary_model_data, sizeof(DWord));
+      LOG_INFO("Архив сжат со словарем %08X\n", reader->dictionary_hash);
+    }
+    else if (reader->header.primary_compression == COMPRESSION_HUFFMAN)
     {
       reader->huffman_tree = huffman_tree_create();
       if (reader->huffman_tree == NULL)
       {
-        printf("Произошла ошибка при создании дерева Хаффмана!\n");
+        LOG_ERROR("Произошла ошибка при создании дерева Хаффмана!\n");
         free(primary_model_data);
         goto error;
       }
@@ -231,19 +313,19 @@ CompressedArchiveReader* compressed_archive_reader_create(
                                         primary_model_data, primary_model_size);
       if (result != RESULT_OK)
       {
-        printf("Произошла ошибка при десериализации дерева Хаффмана!\n");
+        LOG_ERROR("Произошла ошибка при десериализации дерева Хаффмана!\n");
         free(primary_model_data);
         goto error;
       }
 
-      printf("Дерево Хаффмана десериализовано успешно\n");
+      LOG_DEBUG("Дерево Хаффмана десериализовано успешно\n");
     }
     else if (reader->header.primary_compression == COMPRESSION_ARITHMETIC)
     {
       reader->arithmetic_model = arithmetic_model_create();
       if (reader->arithmetic_model == NULL)
       {
-        printf("Произошла ошибка при создании арифметической модели!\n");
+        LOG_ERROR("Произошла ошибка при создании арифметической модели!\n");
         free(primary_model_data);
         goto error;
       }
@@ -252,19 +334,20 @@ CompressedArchiveReader* compressed_archive_reader_create(
         reader->arithmetic_model, primary_model_data, primary_model_size);
       if (result != RESULT_OK)
       {
-        printf("Произошла ошибка при десериализации арифметической модели!\n");
+        LOG_ERROR("Произошла ошибка при десериализации арифметической "
+                  "модели!\n");
         free(primary_model_data);
         goto error;
       }
 
-      printf("Арифметическая модель десериализована успешно\n");
+      LOG_DEBUG("Арифметическая модель десериализована успешно\n");
     }
     else if (reader->header.primary_compression == COMPRESSION_SHANNON)
     {
       reader->shannon_tree = shannon_tree_create();
       if (reader->shannon_tree == NULL)
       {
-        printf("Произошла ошибка при создании дерева Шеннона!\n");
+        LOG_ERROR("Произошла ошибка при создании дерева Шеннона!\n");
         free(primary_model_data);
         goto error;
       }
@@ -273,19 +356,19 @@ CompressedArchiveReader* compressed_archive_reader_create(
                                         primary_model_data, primary_model_size);
       if (result != RESULT_OK)
       {
-        printf("Произошла ошибка при десериализации дерева Шеннона!\n");
+        LOG_ERROR("Произошла ошибка при десериализации дерева Шеннона!\n");
         free(primary_model_data);
         goto error;
       }
 
-      printf("Дерево Шеннона десериализовано успешно\n");
+      LOG_DEBUG("Дерево Шеннона десериализовано успешно\n");
     }
     else if (reader->header.primary_compression == COMPRESSION_RLE)
     {
       reader->rle_context = rle_create(0);
       if (reader->rle_context == NULL)
       {
-        printf("Произошла ошибка при создании контекста RLE!\n");
+        LOG_ERROR("Произошла ошибка при создании контекста RLE!\n");
         free(primary_model_data);
         goto error;
       }
@@ -294,23 +377,25 @@ CompressedArchiveReader* compressed_archive_reader_create(
                                        primary_model_size);
       if (result != RESULT_OK)
       {
-        printf("Произошла ошибка при десериализации контекста RLE!\n");
+        LOG_ERROR("Произошла ошибка при десериализации контекста RLE!\n");
         free(primary_model_data);
         goto error;
       }
 
-      printf("Контекст RLE десериализован успешно\n");
-      printf("Префикс RLE: 0x%02X\n", rle_get_prefix(reader->rle_context));
+      LOG_DEBUG("Контекст RLE десериализован успешно\n");
+      LOG_DEBUG("Префикс RLE: 0x%02X\n", rle_get_prefix(reader->rle_context));
     }
     else if (reader->header.primary_compression == COMPRESSION_LZ77)
     {
       reader->lz77_context_data = primary_model_data;
       reader->lz77_context_size = primary_model_size;
-      printf("Контекст LZ77 прочитан успешно\n");
+      LOG_DEBUG("Контекст LZ77 прочитан успешно\n");
       if (primary_model_size >= 1)
       {
-        printf("Префикс LZ77: 0x%02X\n", primary_model_data[0]);
+        LOG_DEBUG("Префикс LZ77: 0x%02X\n", primary_model_data[0]);
       }
+      // Буфер теперь принадлежит читателю
+      primary_model_data = NULL;
     }
 
     free(primary_model_data);
@@ -321,15 +406,15 @@ CompressedArchiveReader* compressed_archive_reader_create(
   if (secondary_context_size > 0 &&
       (reader->header.flags & FLAG_TWO_STAGE_COMPRESSION))
   {
-    printf("\n=== Чтение контекста вторичного алгоритма ===\n");
-    printf("Смещение контекста: %llu байт\n", model_offset);
-    printf("Размер контекста: %zu байт\n", secondary_context_size);
+    LOG_DEBUG("\n=== Чтение контекста вторичного алгоритма ===\n");
+    LOG_DEBUG("Смещение контекста: %llu байт\n", model_offset);
+    LOG_DEBUG("Размер контекста: %zu байт\n", secondary_context_size);
 
     secondary_context_data =
       (Byte*)malloc(secondary_context_size * sizeof(Byte));
     if (secondary_context_data == NULL)
     {
-      printf("Произошла ошибка выделения памяти!\n");
+      LOG_ERROR("Произошла ошибка выделения памяти!\n");
       goto error;
     }
 
@@ -337,12 +422,13 @@ CompressedArchiveReader* compressed_archive_reader_create(
                           secondary_context_size, model_offset);
     if (result != RESULT_OK)
     {
-      printf("Произошла ошибка при чтении контекста вторичного алгоритма!\n");
+      LOG_ERROR("Произошла ошибка при чтении контекста вторичного "
+                "алгоритма!\n");
       free(secondary_context_data);
       goto error;
     }
 
-    printf("Контекст прочитан успешно\n");
+    LOG_DEBUG("Контекст прочитан успешно\n");
 
     // Десериализация в зависимости от вторичного алгоритма
     if (reader->header.secondary_compression == COMPRESSION_HUFFMAN)
@@ -350,9 +436,8 @@ CompressedArchiveReader* compressed_archive_reader_create(
       reader->secondary_huffman_tree = huffman_tree_create();
       if (reader->secondary_huffman_tree == NULL)
       {
-        printf(
-          "Произошла ошибка при создании дерева Хаффмана для вторичного "
-          "алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при создании дерева Хаффмана для "
+                  "вторичного " "алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
@@ -362,24 +447,22 @@ CompressedArchiveReader* compressed_archive_reader_create(
                                         secondary_context_size);
       if (result != RESULT_OK)
       {
-        printf(
-          "Произошла ошибка при десериализации дерева Хаффмана для вторичного "
-          "алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при десериализации дерева Хаффмана для "
+                  "вторичного " "алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
 
-      printf(
-        "Дерево Хаффмана для вторичного алгоритма десериализовано успешно\n");
+      LOG_DEBUG("Дерево Хаффмана для вторичного алгоритма десериализовано "
+                "успешно\n");
     }
     else if (reader->header.secondary_compression == COMPRESSION_ARITHMETIC)
     {
       reader->secondary_arithmetic_model = arithmetic_model_create();
       if (reader->secondary_arithmetic_model == NULL)
       {
-        printf(
-          "Произошла ошибка при создании арифметической модели для вторичного "
-          "алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при создании арифметической модели для "
+                  "вторичного " "алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
@@ -389,25 +472,22 @@ CompressedArchiveReader* compressed_archive_reader_create(
                                             secondary_context_size);
       if (result != RESULT_OK)
       {
-        printf(
-          "Произошла ошибка при десериализации арифметической модели для "
-          "вторичного алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при десериализации арифметической модели "
+                  "для " "вторичного алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
 
-      printf(
-        "Арифметическая модель для вторичного алгоритма десериализована "
-        "успешно\n");
+      LOG_DEBUG("Арифметическая модель для вторичного алгоритма "
+                "десериализована " "успешно\n");
     }
     else if (reader->header.secondary_compression == COMPRESSION_SHANNON)
     {
       reader->secondary_shannon_tree = shannon_tree_create();
       if (reader->secondary_shannon_tree == NULL)
       {
-        printf(
-          "Произошла ошибка при создании дерева Шеннона для вторичного "
-          "алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при создании дерева Шеннона для вторичного "
+                  "алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
@@ -417,24 +497,22 @@ CompressedArchiveReader* compressed_archive_reader_create(
                                         secondary_context_size);
       if (result != RESULT_OK)
       {
-        printf(
-          "Произошла ошибка при десериализации дерева Шеннона для вторичного "
-          "алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при десериализации дерева Шеннона для "
+                  "вторичного " "алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
 
-      printf(
-        "Дерево Шеннона для вторичного алгоритма десериализовано успешно\n");
+      LOG_DEBUG("Дерево Шеннона для вторичного алгоритма десериализовано "
+                "успешно\n");
     }
     else if (reader->header.secondary_compression == COMPRESSION_RLE)
     {
       reader->secondary_rle_context = rle_create(0);
       if (reader->secondary_rle_context == NULL)
       {
-        printf(
-          "Произошла ошибка при создании контекста RLE для вторичного "
-          "алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при создании контекста RLE для вторичного "
+                  "алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
@@ -444,46 +522,49 @@ CompressedArchiveReader* compressed_archive_reader_create(
                                 secondary_context_data, secondary_context_size);
       if (result != RESULT_OK)
       {
-        printf(
-          "Произошла ошибка при десериализации контекста RLE для вторичного "
-          "алгоритма!\n");
+        LOG_ERROR("Произошла ошибка при десериализации контекста RLE для "
+                  "вторичного " "алгоритма!\n");
         free(secondary_context_data);
         goto error;
       }
 
-      printf("Контекст RLE для вторичного алгоритма десериализован успешно\n");
-      printf("Префикс RLE: 0x%02X\n",
-             rle_get_prefix(reader->secondary_rle_context));
+      LOG_DEBUG("Контекст RLE для вторичного алгоритма десериализован "
+                "успешно\n");
+      LOG_DEBUG("Префикс RLE: 0x%02X\n",
+                rle_get_prefix(reader->secondary_rle_context));
     }
     else if (reader->header.secondary_compression == COMPRESSION_LZ77)
     {
       reader->secondary_lz77_context_data = secondary_context_data;
       reader->secondary_lz77_context_size = secondary_context_size;
-      printf("Контекст LZ77 для вторичного алгоритма прочитан успешно\n");
+      LOG_DEBUG("Контекст LZ77 для вторичного алгоритма прочитан успешно\n");
       if (secondary_context_size >= 1)
       {
-        printf("Префикс LZ77: 0x%02X\n", secondary_context_data[0]);
+        LOG_DEBUG("Префикс LZ77: 0x%02X\n", secondary_context_data[0]);
       }
+      // Буфер теперь принадлежит читателю
+      secondary_context_data = NULL;
     }
 
     free(secondary_context_data);
   }
 
-  printf("\n=== Архив успешно открыт ===\n");
+  LOG_INFO("\n=== Архив успешно открыт ===\n");
   if (reader->header.flags & FLAG_TWO_STAGE_COMPRESSION)
   {
-    printf("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
-    printf("Первичный алгоритм: %s\n",
-           reader->header.primary_compression == COMPRESSION_HUFFMAN ? "HUFFMAN"
-           : reader->header.primary_compression == COMPRESSION_ARITHMETIC
-             ? "ARITHMETIC"
-           : reader->header.primary_compression == COMPRESSION_SHANNON
-             ? "SHANNON"
-           : reader->header.primary_compression == COMPRESSION_RLE  ? "RLE"
-           : reader->header.primary_compression == COMPRESSION_LZ78 ? "LZ78"
-           : reader->header.primary_compression == COMPRESSION_LZ77 ? "LZ77"
-                                                                    : "NONE");
-    printf(
+    LOG_INFO("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
+    LOG_INFO(
+      "Первичный алгоритм: %s\n",
+      reader->header.primary_compression == COMPRESSION_HUFFMAN ? "HUFFMAN"
+      : reader->header.primary_compression == COMPRESSION_ARITHMETIC
+        ? "ARITHMETIC"
+      : reader->header.primary_compression == COMPRESSION_SHANNON ? "SHANNON"
+      : reader->header.primary_compression == COMPRESSION_RLE     ? "RLE"
+      : reader->header.primary_compression == COMPRESSION_LZ78    ? "LZ78"
+      : reader->header.primary_compression == COMPRESSION_LZ77    ? "LZ77"
+      : reader->header.primary_compression == COMPRESSION_LZH     ? "LZH"
+                                                                  : "NONE");
+    LOG_INFO(
       "Вторичный алгоритм: %s\n",
       reader->header.secondary_compression == COMPRESSION_HUFFMAN ? "HUFFMAN"
       : reader->header.secondary_compression == COMPRESSION_ARITHMETIC
@@ -492,11 +573,12 @@ CompressedArchiveReader* compressed_archive_reader_create(
       : reader->header.secondary_compression == COMPRESSION_RLE     ? "RLE"
       : reader->header.secondary_compression == COMPRESSION_LZ78    ? "LZ78"
       : reader->header.secondary_compression == COMPRESSION_LZ77    ? "LZ77"
+      : reader->header.secondary_compression == COMPRESSION_LZH     ? "LZH"
                                                                     : "NONE");
   }
   else
   {
-    printf("Режим: ОДНОЭТАПНОЕ СЖАТИЕ\n");
+    LOG_INFO("Режим: ОДНОЭТАПНОЕ СЖАТИЕ\n");
   }
 
   return reader;
@@ -506,6 +588,99 @@ error:
   return NULL;
 }
 
+Result compressed_archive_reader_set_dictionary(CompressedArchiveReader* self,
+                                                const Dictionary* dictionary)
+{
+  if (self == NULL || dictionary == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (!(self->header.flags & FLAG_DICTIONARY))
+  {
+    LOG_WARN("Архив сжат без словаря, словарь не используется\n");
+    return RESULT_OK;
+  }
+
+  if (dictionary_get_hash(dictionary) != self->dictionary_hash)
+  {
+    LOG_ERROR("Словарь %08X не совпадает со словарем архива %08X!\n",
+              dictionary_get_hash(dictionary), self->dictionary_hash);
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  // Окно LZH берется из словаря при распаковке, моделям нужны частоты
+  const DWord* frequencies = dictionary_get_frequencies(dictionary);
+  Result result = RESULT_OK;
+
+  if (self->header.primary_compression == COMPRESSION_HUFFMAN)
+  {
+    if (self->huffman_tree == NULL)
+    {
+      self->huffman_tree = huffman_tree_create();
+    }
+    result = self->huffman_tree
+               ? huffman_tree_build_from_frequencies(self->huffman_tree,
+                                                     frequencies)
+               : RESULT_MEMORY_ERROR;
+  }
+  else if (self->header.primary_compression == COMPRESSION_ARITHMETIC)
+  {
+    if (self->arithmetic_model == NULL)
+    {
+      self->arithmetic_model = arithmetic_model_create();
+    }
+    result = self->arithmetic_model
+               ? arithmetic_model_build_from_frequencies(
+                   self->arithmetic_model, frequencies)
+               : RESULT_MEMORY_ERROR;
+  }
+  else if (self->header.primary_compression == COMPRESSION_SHANNON)
+  {
+    if (self->shannon_tree == NULL)
+    {
+      self->shannon_tree = shannon_tree_create();
+    }
+    result = self->shannon_tree
+               ? shannon_tree_build_from_frequencies(self->shannon_tree,
+                                                     frequencies)
+               : RESULT_MEMORY_ERROR;
+  }
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при построении модели по словарю!\n");
+    return result;
+  }
+
+  self->dictionary = dictionary;
+  return RESULT_OK;
+}
+
+Result compressed_archive_reader_set_block_cache(CompressedArchiveReader* self,
+                                                BlockCache* cache)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->block_cache = cache;
+  return RESULT_OK;
+}
+
+Result compressed_archive_reader_set_stats(CompressedArchiveReader* self,
+                                           Stats* stats)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->stats = stats;
+  return RESULT_OK;
+}
+
 void compressed_archive_reader_destroy(CompressedArchiveReader* self)
 {
   if (self == NULL)
@@ -568,253 +743,363 @@ void compressed_archive_reader_destroy(CompressedArchiveReader* self)
     free(self->secondary_lz77_context_data);
   }
 
+  scratch_free(&self->scratch[0]);
+  scratch_free(&self->scratch[1]);
+  scratch_free(&self->scratch[2]);
+  scratch_free(&self->assembled);
+  scratch_free(&self->source_cache);
+  scratch_free(&self->solid_block);
+  free(self->frame_index);
+  scratch_free(&self->range_block);
+  arena_destroy(self->arena);
+  crc32_table_destroy(self->crc32_table);
+
   file_table_destroy(self->file_table);
   file_close(self->archive_file);
   file_destroy(self->archive_file);
   free(self);
 }
 
-// Функция для двухэтапной декомпрессии
-// Функция для двухэтапной декомпрессии
-static Result apply_two_stage_decompression(
-  const Byte* input, Size input_size, Byte** output, Size* output_size,
-  CompressionAlgorithm primary_algo, CompressionAlgorithm secondary_algo,
-  void* primary_context, void* secondary_context, bool primary_failed)
+// Есть ли декодер для алгоритма с данным контекстом (LZ78 и LZH работают
+// без контекста, контекст LZH - необязательный словарь)
+static bool has_stage_decoder(CompressionAlgorithm algorithm,
+                              const void* context)
 {
-  printf("[TWO-STAGE] Начало двухэтапной декомпрессии\n");
-  printf("[TWO-STAGE] Входной размер: %zu байт\n", input_size);
-  printf("[TWO-STAGE] Ожидаемый выход: %zu байт\n", *output_size);
+  switch (algorithm)
+  {
+    case COMPRESSION_HUFFMAN:
+    case COMPRESSION_ARITHMETIC:
+    case COMPRESSION_SHANNON:
+    case COMPRESSION_RLE:
+    case COMPRESSION_LZ77:
+      return context != NULL;
+    case COMPRESSION_LZ78:
+    case COMPRESSION_LZH:
+      return true;
+    default:
+      return false;
+  }
+}
 
-  // ИСПРАВЛЕНИЕ: Если первичное сжатие не применялось при кодировании,
-  // не применяем его и при декодировании
-  if (primary_failed)
+// Распаковка одного этапа в буфер вызывающего кода. *output_size на входе -
+// размер буфера, на выходе - записано байт
+static Result decompress_stage(CompressionAlgorithm algorithm,
+                               const void* context, const Byte* input,
+                               Size input_size, Byte* output,
+                               Size* output_size)
+{
+  switch (algorithm)
   {
-    printf("[TWO-STAGE] Первичное сжатие не применялось, пропускаем этап 2\n");
-    // Пропускаем этап первичной декомпрессии
-    primary_algo = COMPRESSION_NONE;
+    case COMPRESSION_HUFFMAN:
+      return huffman_decompress_into(input, input_size, output, output_size,
+                                     (const HuffmanTree*)context);
+    case COMPRESSION_ARITHMETIC:
+      return arithmetic_decompress_into(input, input_size, output, output_size,
+                                        (const ArithmeticModel*)context);
+    case COMPRESSION_SHANNON:
+      return shannon_decompress_into(input, input_size, output, output_size,
+                                     (const ShannonTree*)context);
+    case COMPRESSION_RLE:
+      return rle_decompress_into(input, input_size, output, output_size,
+                                 (const RLEContext*)context);
+    case COMPRESSION_LZ78:
+      return lz78_decompress_into(input, input_size, output, output_size);
+    case COMPRESSION_LZ77:
+      return lz77_decompress_into(input, input_size, output, output_size,
+                                  *(const Byte*)context);
+    case COMPRESSION_LZH:
+    {
+      const Dictionary* dictionary = (const Dictionary*)context;
+      return lzh_decompress_into_with_dictionary(
+        input, input_size, dictionary_get_window(dictionary),
+        dictionary_get_window_size(dictionary), output, output_size);
+    }
+    default:
+      return RESULT_INVALID_ARGUMENT;
   }
+}
 
-  Result result = RESULT_OK;
-  Byte* stage1_output = NULL;
-  Size stage1_size = *output_size;
+static DWord read_frame_dword(const Byte* buffer)
+{
+  DWord value;
+  memcpy(&value, buffer, sizeof(DWord));
+  return value;
+}
 
-  // Этап 1: Декомпрессия вторичного алгоритма
-  if (secondary_algo != COMPRESSION_NONE)
+// Двухэтапная декомпрессия по кадрам (формат описан у TWO_STAGE_CHUNK_SIZE).
+// Распаковывает один кадр в target. available - байт от начала кадра до
+// конца данных записи, capacity - свободное место в target. *frame_size -
+// длина кадра вместе с заголовком, *decoded_size - распакованный размер
+static Result decode_two_stage_frame(
+  CompressedArchiveReader* self, const Byte* frame, Size available,
+  Byte* target, Size capacity, CompressionAlgorithm primary_algo,
+  CompressionAlgorithm secondary_algo, const void* primary_context,
+  Size* frame_size, Size* decoded_size)
+{
+  if (available < TWO_STAGE_FRAME_HEADER_SIZE)
   {
-    printf("[TWO-STAGE] Этап 1: Декомпрессия вторичного алгоритма (%s)\n",
-           secondary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-           : secondary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-           : secondary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-           : secondary_algo == COMPRESSION_RLE        ? "RLE"
-           : secondary_algo == COMPRESSION_LZ78       ? "LZ78"
-           : secondary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                      : "NONE");
+    LOG_ERROR("[TWO-STAGE] Заголовок кадра обрезан\n");
+    return RESULT_ERROR;
+  }
 
-    if (secondary_algo == COMPRESSION_HUFFMAN && secondary_context)
-    {
-      result =
-        huffman_decompress(input, input_size, &stage1_output, &stage1_size,
-                           (HuffmanTree*)secondary_context);
-    }
-    else if (secondary_algo == COMPRESSION_ARITHMETIC && secondary_context)
-    {
-      result =
-        arithmetic_decompress(input, input_size, &stage1_output, &stage1_size,
-                              (ArithmeticModel*)secondary_context);
-    }
-    else if (secondary_algo == COMPRESSION_SHANNON && secondary_context)
-    {
-      result =
-        shannon_decompress(input, input_size, &stage1_output, &stage1_size,
-                           (ShannonTree*)secondary_context);
-    }
-    else if (secondary_algo == COMPRESSION_RLE && secondary_context)
+  Size raw_size = read_frame_dword(frame);
+  Size stage_size = read_frame_dword(frame + 4);
+  Size stored_size = read_frame_dword(frame + 8);
+  Byte flags = frame[12];
+  Byte parameter = frame[13];
+  const Byte* payload = frame + TWO_STAGE_FRAME_HEADER_SIZE;
+  available -= TWO_STAGE_FRAME_HEADER_SIZE;
+
+  if (stored_size > available || raw_size > capacity)
+  {
+    LOG_ERROR("[TWO-STAGE] Размеры кадра выходят за границы данных\n");
+    return RESULT_ERROR;
+  }
+
+  const Byte* stage = payload;
+
+  // Этап 1: вторичный алгоритм. Если первичный этап пропущен, блок
+  // распаковывается сразу на место в выходном буфере
+  if (flags & TWO_STAGE_FRAME_SECONDARY)
+  {
+    const void* context = NULL;
+    if (secondary_algo == COMPRESSION_RLE && self->secondary_rle_context)
     {
-      result = rle_decompress(input, input_size, &stage1_output, &stage1_size,
-                              (RLEContext*)secondary_context);
+      rle_set_prefix(self->secondary_rle_context, parameter);
+      context = self->secondary_rle_context;
     }
-    else if (secondary_algo == COMPRESSION_LZ78)
+    else if (secondary_algo == COMPRESSION_LZ77)
     {
-      result = lz78_decompress(input, input_size, &stage1_output, &stage1_size);
+      context = &parameter;
     }
-    else if (secondary_algo == COMPRESSION_LZ77 && secondary_context)
+
+    if (!has_stage_decoder(secondary_algo, context))
     {
-      Byte prefix = *(Byte*)secondary_context;
-      result = lz77_decompress(input, input_size, &stage1_output, &stage1_size,
-                               prefix);
+      LOG_ERROR("[TWO-STAGE] Нет декодера вторичного алгоритма (%s)\n",
+                compressed_archive_algorithm_name(secondary_algo));
+      return RESULT_ERROR;
     }
-    else
+
+    Byte* buffer = target;
+    if (flags & TWO_STAGE_FRAME_PRIMARY)
     {
-      // Без вторичной декомпрессии
-      stage1_output = (Byte*)malloc(input_size);
-      if (stage1_output)
-      {
-        memcpy(stage1_output, input, input_size);
-        stage1_size = input_size;
-      }
-      else
+      buffer = scratch_reserve(&self->scratch[2], stage_size);
+      if (buffer == NULL)
       {
-        result = RESULT_MEMORY_ERROR;
+        return RESULT_MEMORY_ERROR;
       }
     }
+    else if (stage_size != raw_size)
+    {
+      LOG_ERROR("[TWO-STAGE] Несогласованные размеры кадра\n");
+      return RESULT_ERROR;
+    }
 
-    if (result != RESULT_OK || stage1_output == NULL)
+    Size size = stage_size;
+    Result result = decompress_stage(secondary_algo, context, payload,
+                                     stored_size, buffer, &size);
+    if (result != RESULT_OK || size != stage_size)
     {
-      printf("[TWO-STAGE] Ошибка на этапе 1 декомпрессии\n");
+      LOG_ERROR("[TWO-STAGE] Ошибка на этапе 1 декомпрессии\n");
       return result != RESULT_OK ? result : RESULT_ERROR;
     }
 
-    printf("[TWO-STAGE] Этап 1 завершен: %zu -> %zu байт\n", input_size,
-           stage1_size);
+    stage = buffer;
   }
-  else
+  else if (stored_size != stage_size)
   {
-    // Без вторичной декомпрессии
-    stage1_output = (Byte*)malloc(input_size);
-    if (stage1_output)
-    {
-      memcpy(stage1_output, input, input_size);
-      stage1_size = input_size;
-    }
-    else
-    {
-      return RESULT_MEMORY_ERROR;
-    }
-    printf("[TWO-STAGE] Вторичная декомпрессия отключена\n");
+    LOG_ERROR("[TWO-STAGE] Несогласованные размеры кадра\n");
+    return RESULT_ERROR;
   }
 
-  // Этап 2: Декомпрессия первичного алгоритма
-  if (primary_algo != COMPRESSION_NONE && !primary_failed)
+  // Этап 2: первичный алгоритм
+  if (flags & TWO_STAGE_FRAME_PRIMARY)
   {
-    printf("[TWO-STAGE] Этап 2: Декомпрессия первичного алгоритма (%s)\n",
-           primary_algo == COMPRESSION_HUFFMAN      ? "HUFFMAN"
-           : primary_algo == COMPRESSION_ARITHMETIC ? "ARITHMETIC"
-           : primary_algo == COMPRESSION_SHANNON    ? "SHANNON"
-           : primary_algo == COMPRESSION_RLE        ? "RLE"
-           : primary_algo == COMPRESSION_LZ78       ? "LZ78"
-           : primary_algo == COMPRESSION_LZ77       ? "LZ77"
-                                                    : "NONE");
-
-    if (primary_algo == COMPRESSION_HUFFMAN && primary_context)
-    {
-      result = huffman_decompress(stage1_output, stage1_size, output,
-                                  output_size, (HuffmanTree*)primary_context);
-    }
-    else if (primary_algo == COMPRESSION_ARITHMETIC && primary_context)
+    if (!has_stage_decoder(primary_algo, primary_context))
     {
-      result =
-        arithmetic_decompress(stage1_output, stage1_size, output, output_size,
-                              (ArithmeticModel*)primary_context);
-    }
-    else if (primary_algo == COMPRESSION_SHANNON && primary_context)
-    {
-      result = shannon_decompress(stage1_output, stage1_size, output,
-                                  output_size, (ShannonTree*)primary_context);
-    }
-    else if (primary_algo == COMPRESSION_RLE && primary_context)
-    {
-      result = rle_decompress(stage1_output, stage1_size, output, output_size,
-                              (RLEContext*)primary_context);
-    }
-    else if (primary_algo == COMPRESSION_LZ78)
-    {
-      result = lz78_decompress(stage1_output, stage1_size, output, output_size);
+      LOG_ERROR("[TWO-STAGE] Нет декодера первичного алгоритма (%s)\n",
+                compressed_archive_algorithm_name(primary_algo));
+      return RESULT_ERROR;
     }
-    else if (primary_algo == COMPRESSION_LZ77 && primary_context)
+
+    Size size = raw_size;
+    Result result = decompress_stage(primary_algo, primary_context, stage,
+                                     stage_size, target, &size);
+    if (result != RESULT_OK || size != raw_size)
     {
-      Byte prefix = *(Byte*)primary_context;
-      result = lz77_decompress(stage1_output, stage1_size, output, output_size,
-                               prefix);
+      LOG_ERROR("[TWO-STAGE] Ошибка на этапе 2 декомпрессии\n");
+      return result != RESULT_OK ? result : RESULT_ERROR;
     }
-    else
+  }
+  else if (stage != target)
+  {
+    if (stage_size != raw_size)
     {
-      // Без первичной декомпрессии
-      *output = stage1_output;
-      *output_size = stage1_size;
-      printf("[TWO-STAGE] Первичная декомпрессия не требуется\n");
-      return RESULT_OK;
+      LOG_ERROR("[TWO-STAGE] Несогласованные размеры кадра\n");
+      return RESULT_ERROR;
     }
+    memcpy(target, stage, raw_size);
+  }
+
+  *frame_size = TWO_STAGE_FRAME_HEADER_SIZE + stored_size;
+  *decoded_size = raw_size;
+  return RESULT_OK;
+}
 
-    free(stage1_output);
+// Каждый блок распаковывается обоими этапами подряд: промежуточный буфер
+// scratch[2] имеет размер блока, а этап, пропущенный при сжатии, не требует
+// копирования. Результат пишется в scratch[1]; *output_size на входе -
+// ожидаемый размер файла
+static Result apply_two_stage_decompression(
+  CompressedArchiveReader* self, const Byte* input, Size input_size,
+  const Byte** output, Size* output_size, CompressionAlgorithm primary_algo,
+  CompressionAlgorithm secondary_algo, const void* primary_context)
+{
+  LOG_DEBUG("[TWO-STAGE] Начало двухэтапной декомпрессии\n");
+  LOG_DEBUG("[TWO-STAGE] Входной размер: %zu байт\n", input_size);
+  LOG_DEBUG("[TWO-STAGE] Ожидаемый выход: %zu байт\n", *output_size);
+
+  Size capacity = *output_size;
+  Byte* decompressed = scratch_reserve(&self->scratch[1], capacity);
+  if (decompressed == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
 
+  Size position = 0;
+  Size produced = 0;
+
+  while (position < input_size)
+  {
+    Size frame_size = 0;
+    Size raw_size = 0;
+    Result result = decode_two_stage_frame(
+      self, input + position, input_size - position, decompressed + produced,
+      capacity - produced, primary_algo, secondary_algo, primary_context,
+      &frame_size, &raw_size);
     if (result != RESULT_OK)
     {
-      printf("[TWO-STAGE] Ошибка на этапе 2 декомпрессии\n");
       return result;
     }
 
-    printf("[TWO-STAGE] Этап 2 завершен: %zu -> %zu байт\n", stage1_size,
-           *output_size);
+    position += frame_size;
+    produced += raw_size;
   }
-  else
+
+  if (produced != capacity)
   {
-    // Без первичной декомпрессии
-    *output = stage1_output;
-    *output_size = stage1_size;
-    printf("[TWO-STAGE] Первичная декомпрессия отключена\n");
+    LOG_ERROR("[TWO-STAGE] Распаковано %zu байт вместо %zu\n", produced,
+              capacity);
+    return RESULT_ERROR;
   }
 
-  printf("[TWO-STAGE] Декомпрессия завершена успешно\n");
+  *output = decompressed;
+  *output_size = produced;
+
+  LOG_DEBUG("[TWO-STAGE] Декомпрессия завершена успешно\n");
   return RESULT_OK;
 }
 
-static Result extract_single_file(CompressedArchiveReader* self,
-                                  DWord file_index, const char* output_path)
+// Контекст первичного алгоритма двухэтапного сжатия; префикс вторичного
+// хранится в каждом кадре
+static const void* two_stage_primary_context(
+  const CompressedArchiveReader* self)
 {
-  const FileEntry* entry = file_table_get_entry(self->file_table, file_index);
-  if (entry == NULL)
+  switch (self->header.primary_compression)
   {
-    return RESULT_INVALID_ARGUMENT;
+    case COMPRESSION_HUFFMAN:
+      return self->huffman_tree;
+    case COMPRESSION_ARITHMETIC:
+      return self->arithmetic_model;
+    case COMPRESSION_SHANNON:
+      return self->shannon_tree;
+    case COMPRESSION_RLE:
+      return self->rle_context;
+    case COMPRESSION_LZ77:
+      return self->lz77_context_data;
+    case COMPRESSION_LZH:
+      return self->dictionary;
+    default:
+      return NULL;
   }
+}
 
-  printf("\n=== Извлечение файла ===\n");
-  printf("Файл: %s\n", entry->filename);
-  printf("Исходный размер: %llu байт\n", entry->original_size);
-  printf("Сжатый размер: %llu байт\n", entry->compressed_size);
-  printf("Смещение в архиве: %llu байт\n", entry->offset);
-
-  Byte* file_data = (Byte*)malloc(entry->compressed_size * sizeof(Byte));
+// Данные записи в том виде, в каком их сохранил построитель (для
+// дедуплицированных файлов - только новые участки). Результат лежит в
+// scratch[0] или scratch[1] и живет до следующего чтения
+static Result read_entry_data(CompressedArchiveReader* self,
+                              const FileEntry* entry, const Byte** data,
+                              Size* size)
+{
+  Byte* file_data = scratch_reserve(&self->scratch[0], entry->compressed_size);
 
   if (file_data == NULL)
   {
-    printf("Произошла ошибка при выделении памяти для данных файла!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти для данных файла!\n");
     return RESULT_MEMORY_ERROR;
   }
 
+  StatsSpan span;
+  stats_span_begin(self->stats, &span, STATS_STAGE_READ, NULL);
   Result result = file_read_at(self->archive_file, file_data,
                                entry->compressed_size, entry->offset);
+  stats_span_end(self->stats, &span, entry->compressed_size, 0);
   if (result != RESULT_OK)
   {
-    printf("Произошла ошибка при чтении данных файла из архива!\n");
-    free(file_data);
+    LOG_ERROR("Произошла ошибка при чтении данных файла из архива!\n");
     return result;
   }
 
-  printf("Данные прочитаны успешно (%llu байт)\n", entry->compressed_size);
+  LOG_DEBUG("Данные прочитаны успешно (%llu байт)\n", entry->compressed_size);
 
-  Byte* final_data = NULL;
+  const Byte* final_data = NULL;
   Size final_size = entry->original_size;
 
-  bool needs_decompression = (self->header.flags & FLAG_COMPRESSED);
+  bool needs_decompression =
+    (self->header.flags & FLAG_COMPRESSED) && entry->original_size > 0;
 
   if (needs_decompression)
   {
-    printf("Требуется декомпрессия...\n");
+    LOG_DEBUG("Требуется декомпрессия...\n");
 
+    if ((self->header.flags & FLAG_DICTIONARY) && self->dictionary == NULL)
+    {
+      LOG_ERROR("Для распаковки нужен словарь %08X!\n",
+                self->dictionary_hash);
+      return RESULT_ERROR;
+    }
+
+    char codec_label[STATS_LABEL_LIMIT];
     if (self->header.flags & FLAG_TWO_STAGE_COMPRESSION)
     {
-      printf("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
-      printf("Первичный алгоритм: %s\n",
-             self->header.primary_compression == COMPRESSION_HUFFMAN ? "HUFFMAN"
-             : self->header.primary_compression == COMPRESSION_ARITHMETIC
-               ? "ARITHMETIC"
-             : self->header.primary_compression == COMPRESSION_SHANNON
-               ? "SHANNON"
-             : self->header.primary_compression == COMPRESSION_RLE  ? "RLE"
-             : self->header.primary_compression == COMPRESSION_LZ78 ? "LZ78"
-             : self->header.primary_compression == COMPRESSION_LZ77 ? "LZ77"
-                                                                    : "NONE");
-      printf(
+      snprintf(
+        codec_label, sizeof(codec_label), "%s+%s",
+        compressed_archive_algorithm_name(self->header.secondary_compression),
+        compressed_archive_algorithm_name(self->header.primary_compression));
+    }
+    else
+    {
+      snprintf(
+        codec_label, sizeof(codec_label), "%s",
+        compressed_archive_algorithm_name(self->header.primary_compression));
+    }
+    stats_span_begin(self->stats, &span, STATS_STAGE_DECOMPRESS, codec_label);
+
+    if (self->header.flags & FLAG_TWO_STAGE_COMPRESSION)
+    {
+      LOG_DEBUG("Режим: ДВУХЭТАПНОЕ СЖАТИЕ\n");
+      LOG_DEBUG(
+        "Первичный алгоритм: %s\n",
+        self->header.primary_compression == COMPRESSION_HUFFMAN ? "HUFFMAN"
+        : self->header.primary_compression == COMPRESSION_ARITHMETIC
+          ? "ARITHMETIC"
+        : self->header.primary_compression == COMPRESSION_SHANNON ? "SHANNON"
+        : self->header.primary_compression == COMPRESSION_RLE     ? "RLE"
+        : self->header.primary_compression == COMPRESSION_LZ78    ? "LZ78"
+        : self->header.primary_compression == COMPRESSION_LZ77    ? "LZ77"
+        : self->header.primary_compression == COMPRESSION_LZH     ? "LZH"
+                                                                  : "NONE");
+      LOG_DEBUG(
         "Вторичный алгоритм: %s\n",
         self->header.secondary_compression == COMPRESSION_HUFFMAN ? "HUFFMAN"
         : self->header.secondary_compression == COMPRESSION_ARITHMETIC
@@ -823,68 +1108,28 @@ static Result extract_single_file(CompressedArchiveReader* self,
         : self->header.secondary_compression == COMPRESSION_RLE     ? "RLE"
         : self->header.secondary_compression == COMPRESSION_LZ78    ? "LZ78"
         : self->header.secondary_compression == COMPRESSION_LZ77    ? "LZ77"
+        : self->header.secondary_compression == COMPRESSION_LZH     ? "LZH"
                                                                     : "NONE");
 
-      // Получаем контексты для алгоритмов
-      void* primary_context = NULL;
-      void* secondary_context = NULL;
-
-      // Определяем контекст для первичного алгоритма
-      if (self->header.primary_compression == COMPRESSION_HUFFMAN)
-      {
-        primary_context = self->huffman_tree;
-      }
-      else if (self->header.primary_compression == COMPRESSION_ARITHMETIC)
-      {
-        primary_context = self->arithmetic_model;
-      }
-      else if (self->header.primary_compression == COMPRESSION_SHANNON)
-      {
-        primary_context = self->shannon_tree;
-      }
-      else if (self->header.primary_compression == COMPRESSION_RLE)
-      {
-        primary_context = self->rle_context;
-      }
-      else if (self->header.primary_compression == COMPRESSION_LZ77)
-      {
-        primary_context = self->lz77_context_data;
-      }
-
-      // Определяем контекст для вторичного алгоритма
-      if (self->header.secondary_compression == COMPRESSION_HUFFMAN)
-      {
-        secondary_context = self->secondary_huffman_tree;
-      }
-      else if (self->header.secondary_compression == COMPRESSION_ARITHMETIC)
-      {
-        secondary_context = self->secondary_arithmetic_model;
-      }
-      else if (self->header.secondary_compression == COMPRESSION_SHANNON)
-      {
-        secondary_context = self->secondary_shannon_tree;
-      }
-      else if (self->header.secondary_compression == COMPRESSION_RLE)
-      {
-        secondary_context = self->secondary_rle_context;
-      }
-      else if (self->header.secondary_compression == COMPRESSION_LZ77)
-      {
-        secondary_context = self->secondary_lz77_context_data;
-      }
-
-      bool primary_failed = (entry->compressed_size == entry->original_size);
+      const void* primary_context = two_stage_primary_context(self);
 
       result = apply_two_stage_decompression(
-        file_data, entry->compressed_size, &final_data, &final_size,
+        self, file_data, entry->compressed_size, &final_data, &final_size,
         self->header.primary_compression, self->header.secondary_compression,
-        primary_context, secondary_context, primary_failed);
+        primary_context);
+      if (result != RESULT_OK)
+      {
+        LOG_ERROR("Ошибка двухэтапной декомпрессии! Код ошибки: %d\n",
+                  result);
+        stats_span_end(self->stats, &span, entry->compressed_size, 0);
+        return result;
+      }
     }
     else
     {
       // Одноэтапное сжатие
-      printf("Режим: ОДНОЭТАПНОЕ СЖАТИЕ\n");
-      printf(
+      LOG_DEBUG("Режим: ОДНОЭТАПНОЕ СЖАТИЕ\n");
+      LOG_DEBUG(
         "Алгоритм сжатия: %s\n",
         self->header.primary_compression == COMPRESSION_HUFFMAN ? "HUFFMAN"
         : self->header.primary_compression == COMPRESSION_ARITHMETIC
@@ -893,161 +1138,878 @@ static Result extract_single_file(CompressedArchiveReader* self,
         : self->header.primary_compression == COMPRESSION_RLE     ? "RLE"
         : self->header.primary_compression == COMPRESSION_LZ78    ? "LZ78"
         : self->header.primary_compression == COMPRESSION_LZ77    ? "LZ77"
+        : self->header.primary_compression == COMPRESSION_LZH     ? "LZH"
                                                                   : "UNKNOWN");
 
-      final_data = malloc(entry->original_size);
-      if (final_data == NULL)
+      Byte* output = scratch_reserve(&self->scratch[1], entry->original_size);
+      if (output == NULL)
       {
-        printf("Произошла ошибка при выделении памяти!\n");
-        free(file_data);
+        LOG_ERROR("Произошла ошибка при выделении памяти!\n");
         return RESULT_MEMORY_ERROR;
       }
 
       Size expected_size = entry->original_size;
+      const void* context = NULL;
 
-      if (self->header.primary_compression == COMPRESSION_HUFFMAN &&
-          self->huffman_tree != NULL)
-      {
-        printf("Декомпрессия методом Хаффмана...\n");
-        printf("  Входные данные: %llu байт\n", entry->compressed_size);
-        printf("  Ожидаемый размер: %llu байт\n", entry->original_size);
-
-        result =
-          huffman_decompress(file_data, entry->compressed_size, &final_data,
-                             &expected_size, self->huffman_tree);
-      }
-      else if (self->header.primary_compression == COMPRESSION_ARITHMETIC &&
-               self->arithmetic_model != NULL)
+      if (self->header.primary_compression == COMPRESSION_HUFFMAN)
       {
-        printf("Декомпрессия арифметическим методом...\n");
-        printf("  Входные данные: %llu байт\n", entry->compressed_size);
-        printf("  Ожидаемый размер: %llu байт\n", entry->original_size);
-
-        result =
-          arithmetic_decompress(file_data, entry->compressed_size, &final_data,
-                                &expected_size, self->arithmetic_model);
+        context = self->huffman_tree;
       }
-      else if (self->header.primary_compression == COMPRESSION_SHANNON &&
-               self->shannon_tree != NULL)
+      else if (self->header.primary_compression == COMPRESSION_ARITHMETIC)
       {
-        printf("Декомпрессия методом Шеннона...\n");
-        printf("  Входные данные: %llu байт\n", entry->compressed_size);
-        printf("  Ожидаемый размер: %llu байт\n", entry->original_size);
-
-        result =
-          shannon_decompress(file_data, entry->compressed_size, &final_data,
-                             &expected_size, self->shannon_tree);
+        context = self->arithmetic_model;
       }
-      else if (self->header.primary_compression == COMPRESSION_RLE &&
-               self->rle_context != NULL)
+      else if (self->header.primary_compression == COMPRESSION_SHANNON)
       {
-        printf("Декомпрессия методом RLE...\n");
-        printf("  Входные данные: %llu байт\n", entry->compressed_size);
-        printf("  Ожидаемый размер: %llu байт\n", entry->original_size);
-        printf("  Префикс RLE: 0x%02X\n", rle_get_prefix(self->rle_context));
-
-        result = rle_decompress(file_data, entry->compressed_size, &final_data,
-                                &expected_size, self->rle_context);
+        context = self->shannon_tree;
       }
-      else if (self->header.primary_compression == COMPRESSION_LZ78)
+      else if (self->header.primary_compression == COMPRESSION_RLE)
       {
-        printf("Декомпрессия методом LZ78...\n");
-        printf("  Входные данные: %llu байт\n", entry->compressed_size);
-        printf("  Ожидаемый размер: %llu байт\n", entry->original_size);
-
-        result = lz78_decompress(file_data, entry->compressed_size, &final_data,
-                                 &expected_size);
+        context = self->rle_context;
+        if (self->rle_context != NULL)
+        {
+          LOG_DEBUG("  Префикс RLE: 0x%02X\n",
+                    rle_get_prefix(self->rle_context));
+        }
       }
       else if (self->header.primary_compression == COMPRESSION_LZ77)
       {
-        printf("Декомпрессия методом LZ77...\n");
-        printf("  Входные данные: %llu байт\n", entry->compressed_size);
-        printf("  Ожидаемый размер: %llu байт\n", entry->original_size);
-
         // LZ77 использует только префикс из контекста
-        Byte prefix = 0;
+        static const Byte default_prefix = 0;
         if (self->lz77_context_data && self->lz77_context_size >= 1)
         {
-          prefix = self->lz77_context_data[0];
+          context = self->lz77_context_data;
         }
         else
         {
-          printf("  ВНИМАНИЕ: префикс LZ77 не найден, используется 0x00\n");
+          LOG_WARN("  ВНИМАНИЕ: префикс LZ77 не найден, используется 0x00\n");
+          context = &default_prefix;
         }
 
-        printf("  Префикс LZ77: 0x%02X\n", prefix);
+        LOG_DEBUG("  Префикс LZ77: 0x%02X\n", *(const Byte*)context);
+      }
+      else if (self->header.primary_compression == COMPRESSION_LZH)
+      {
+        context = self->dictionary;
+      }
+
+      if (has_stage_decoder(self->header.primary_compression, context))
+      {
+        LOG_DEBUG("  Входные данные: %llu байт\n", entry->compressed_size);
+        LOG_DEBUG("  Ожидаемый размер: %llu байт\n", entry->original_size);
 
-        result = lz77_decompress(file_data, entry->compressed_size, &final_data,
-                                 &expected_size, prefix);
+        result = decompress_stage(self->header.primary_compression, context,
+                                  file_data, entry->compressed_size, output,
+                                  &expected_size);
       }
       else
       {
-        printf(
-          "Произошла ошибка: алгоритм сжатия не поддерживается или модель "
-          "отсутствует!\n");
+        LOG_ERROR("Произошла ошибка: алгоритм сжатия не поддерживается или "
+                  "модель " "отсутствует!\n");
         result = RESULT_ERROR;
       }
 
       if (result == RESULT_OK)
       {
-        printf("Декомпрессия успешна!\n");
-        printf("  Фактический размер после декомпрессии: %zu байт\n",
-               expected_size);
+        LOG_DEBUG("Декомпрессия успешна!\n");
+        LOG_DEBUG("  Фактический размер после декомпрессии: %zu байт\n",
+                  expected_size);
 
+        final_data = output;
         final_size = expected_size;
-        free(file_data);
       }
       else
       {
-        printf("Ошибка декомпрессии! Код ошибки: %d\n", result);
-        free(final_data);
+        LOG_ERROR("Ошибка декомпрессии! Код ошибки: %d\n", result);
         final_data = file_data;
         final_size = entry->compressed_size;
       }
     }
+
+    stats_span_end(self->stats, &span, entry->compressed_size, final_size);
   }
   else
   {
-    printf("Декомпрессия не требуется\n");
+    LOG_DEBUG("Декомпрессия не требуется\n");
     final_data = file_data;
     final_size = entry->compressed_size;
   }
 
-  printf("Запись файла: %s\n", output_path);
-  File* output_file = file_create(output_path);
-  if (output_file == NULL)
+  *data = final_data;
+  *size = final_size;
+  return RESULT_OK;
+}
+
+// Сохраненные данные записи по индексу. Участник сплошного блока получает
+// свой отрезок распакованного блока, который живет до распаковки другого
+// блока; остальные записи читаются как в read_entry_data
+static Result read_stored_data(CompressedArchiveReader* self, DWord index,
+                               const Byte** data, Size* size)
+{
+  const FileEntry* entry = file_table_get_entry(self->file_table, index);
+  if (entry == NULL)
   {
-    printf("Произошла ошибка при создании выходного файла!\n");
-    free(final_data);
-    return RESULT_MEMORY_ERROR;
+    return RESULT_INVALID_ARGUMENT;
   }
 
-  result = file_open_for_write(output_file);
-  if (result != RESULT_OK)
+  DWord block_index = file_table_find_solid_block(self->file_table, index);
+  if (block_index == FILE_TABLE_NO_ENTRY)
   {
-    printf("Произошла ошибка при открытии выходного файла для записи!\n");
-    file_destroy(output_file);
-    free(final_data);
-    return result;
+    return read_entry_data(self, entry, data, size);
   }
 
-  printf("Записываем %zu байт...\n", final_size);
-  result = file_write_bytes(output_file, final_data, final_size);
+  if (!self->block_cached || self->cached_block != block_index)
+  {
+    const FileSolidBlock* block =
+      file_table_get_solid_block(self->file_table, block_index);
+    LOG_DEBUG("Распаковка сплошного блока %u (%llu байт)\n", block_index + 1,
+              (unsigned long long)block->data_size);
+
+    // Блок распаковывается как запись со своими смещением и размерами
+    FileEntry block_entry = *entry;
+    block_entry.offset = block->offset;
+    block_entry.compressed_size = block->compressed_size;
+    block_entry.original_size = block->data_size;
+
+    const Byte* block_data = NULL;
+    Size block_size = 0;
+    self->block_cached = false;
+    Result result =
+      read_entry_data(self, &block_entry, &block_data, &block_size);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
 
-  free(final_data);
-  file_close(output_file);
-  file_destroy(output_file);
+    Byte* cache = scratch_reserve(&self->solid_block, block_size);
+    if (cache == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
 
-  if (result != RESULT_OK)
-  {
-    printf("Произошла ошибка при записи файла!\n");
-  }
-  else
-  {
-    printf("Файл успешно записан\n");
+    memcpy(cache, block_data, block_size);
+    self->cached_block = block_index;
+    self->block_cached = true;
   }
 
-  return result;
+  *data = self->solid_block.data + entry->offset;
+  *size = entry->original_size;
+  return RESULT_OK;
+}
+
+typedef struct
+{
+  DWord source_index;
+  QWord position;  // Смещение участка в собранном файле
+  const FileChunkRun* run;
+} PendingRun;
+
+static int compare_pending_runs(const void* a, const void* b)
+{
+  const PendingRun* left = (const PendingRun*)a;
+  const PendingRun* right = (const PendingRun*)b;
+  if (left->source_index != right->source_index)
+  {
+    return left->source_index < right->source_index ? -1 : 1;
+  }
+
+  return left->position < right->position   ? -1
+         : left->position > right->position ? 1
+                                             : 0;
+}
+
+// Последний распакованный источник остается в source_cache: соседние
+// файлы обычно ссылаются на одни и те же записи
+static Result load_source_data(CompressedArchiveReader* self,
+                               DWord source_index, const Byte** data,
+                               Size* size)
+{
+  if (!self->source_cached || self->cached_source != source_index)
+  {
+    const Byte* source_data = NULL;
+    Size source_size = 0;
+    Result result =
+      read_stored_data(self, source_index, &source_data, &source_size);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+
+    Byte* cache = scratch_reserve(&self->source_cache, source_size);
+    if (cache == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+      self->source_cached = false;
+      return RESULT_MEMORY_ERROR;
+    }
+
+    memcpy(cache, source_data, source_size);
+    self->source_cache_size = source_size;
+    self->cached_source = source_index;
+    self->source_cached = true;
+  }
+
+  *data = self->source_cache.data;
+  *size = self->source_cache_size;
+  return RESULT_OK;
+}
+
+static Result copy_run(Byte* output, QWord position, const FileChunkRun* run,
+                       const Byte* data, Size size)
+{
+  if (run->offset > size || run->length > size - run->offset)
+  {
+    LOG_ERROR("Участок дедуплицированного файла выходит за данные "
+              "записи %u!\n", run->source_index);
+    return RESULT_ERROR;
+  }
+
+  memcpy(output + position, data + run->offset, run->length);
+  return RESULT_OK;
+}
+
+// Сборка файла по карте дедупликации. Сначала копируются участки из
+// собственных данных записи, пока они лежат в рабочем буфере: распаковка
+// других записей его затирает. Участки других записей группируются по
+// источнику, чтобы каждый источник распаковывался один раз
+static Result assemble_dedup_file(CompressedArchiveReader* self,
+                                  const FileDedupMap* map, const Byte* data,
+                                  Size size, const Byte** output)
+{
+  Byte* assembled = scratch_reserve(&self->assembled, map->data_size);
+  PendingRun* pending =
+    (PendingRun*)malloc(sizeof(PendingRun) * map->run_count);
+  if (assembled == NULL || pending == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(pending);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = RESULT_OK;
+  DWord pending_count = 0;
+  QWord position = 0;
+  for (DWord i = 0; i < map->run_count && result == RESULT_OK; i++)
+  {
+    const FileChunkRun* run = &map->runs[i];
+    if (run->source_index == map->entry_index)
+    {
+      result = copy_run(assembled, position, run, data, size);
+    }
+    else
+    {
+      pending[pending_count].source_index = run->source_index;
+      pending[pending_count].position = position;
+      pending[pending_count].run = run;
+      pending_count++;
+    }
+    position += run->length;
+  }
+
+  qsort(pending, pending_count, sizeof(PendingRun), compare_pending_runs);
+
+  const Byte* source_data = NULL;
+  Size source_size = 0;
+  for (DWord i = 0; i < pending_count && result == RESULT_OK; i++)
+  {
+    if (i == 0 || pending[i].source_index != pending[i - 1].source_index)
+    {
+      result = load_source_data(self, pending[i].source_index, &source_data,
+                                &source_size);
+    }
+    if (result == RESULT_OK)
+    {
+      result = copy_run(assembled, pending[i].position, pending[i].run,
+                        source_data, source_size);
+    }
+  }
+
+  free(pending);
+  *output = assembled;
+  return result;
+}
+
+// Данные файла без дыр: так их видел построитель при расчете CRC
+static Result load_file_data(CompressedArchiveReader* self, DWord file_index,
+                             const Byte** data, Size* size)
+{
+  Result result = read_stored_data(self, file_index, data, size);
+  const FileDedupMap* dedup_map =
+    file_table_get_dedup_map(self->file_table, file_index);
+  if (result == RESULT_OK && dedup_map != NULL)
+  {
+    result = assemble_dedup_file(self, dedup_map, *data, *size, data);
+    *size = dedup_map->data_size;
+  }
+
+  return result;
+}
+
+// Индекс кадров строится по их заголовкам без распаковки и остается до
+// индексации другой записи
+static Result index_two_stage_frames(CompressedArchiveReader* self,
+                                     DWord index, const FileEntry* entry)
+{
+  if (self->frames_indexed && self->indexed_entry == index)
+  {
+    return RESULT_OK;
+  }
+
+  self->frames_indexed = false;
+  self->frame_count = 0;
+
+  StatsSpan span;
+  stats_span_begin(self->stats, &span, STATS_STAGE_READ, "frames");
+  Result result = RESULT_OK;
+  QWord position = 0;
+  QWord raw_offset = 0;
+  while (result == RESULT_OK && position < entry->compressed_size)
+  {
+    Byte header[TWO_STAGE_FRAME_HEADER_SIZE];
+    QWord available = entry->compressed_size - position;
+    if (available < sizeof(header))
+    {
+      LOG_ERROR("[TWO-STAGE] Заголовок кадра обрезан\n");
+      result = RESULT_ERROR;
+      break;
+    }
+
+    result = file_read_at(self->archive_file, header, sizeof(header),
+                          entry->offset + position);
+    if (result != RESULT_OK)
+    {
+      break;
+    }
+
+    Size raw_size = read_frame_dword(header);
+    Size stored_size = read_frame_dword(header + 8);
+    if (stored_size > available - sizeof(header) ||
+        raw_size > entry->original_size - raw_offset)
+    {
+      LOG_ERROR("[TWO-STAGE] Размеры кадра выходят за границы данных\n");
+      result = RESULT_ERROR;
+      break;
+    }
+
+    if (self->frame_count == self->frame_capacity)
+    {
+      DWord capacity =
+        self->frame_capacity > 0 ? self->frame_capacity * 2 : 16;
+      FrameIndexEntry* frames = (FrameIndexEntry*)realloc(
+        self->frame_index, sizeof(FrameIndexEntry) * capacity);
+      if (frames == NULL)
+      {
+        LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+        result = RESULT_MEMORY_ERROR;
+        break;
+      }
+      self->frame_index = frames;
+      self->frame_capacity = capacity;
+    }
+
+    FrameIndexEntry* frame = &self->frame_index[self->frame_count++];
+    frame->raw_offset = raw_offset;
+    frame->file_offset = entry->offset + position;
+    frame->frame_size = sizeof(header) + stored_size;
+    frame->raw_size = raw_size;
+    position += frame->frame_size;
+    raw_offset += raw_size;
+  }
+  stats_span_end(self->stats, &span,
+                 (QWord)self->frame_count * TWO_STAGE_FRAME_HEADER_SIZE, 0);
+
+  if (result == RESULT_OK && raw_offset != entry->original_size)
+  {
+    LOG_ERROR("[TWO-STAGE] Кадры описывают %llu байт вместо %llu\n",
+              (unsigned long long)raw_offset,
+              (unsigned long long)entry->original_size);
+    result = RESULT_ERROR;
+  }
+
+  if (result == RESULT_OK)
+  {
+    self->indexed_entry = index;
+    self->frames_indexed = true;
+  }
+  return result;
+}
+
+// Кадр, содержащий смещение position сохраненных данных записи
+static const FrameIndexEntry* find_frame(const CompressedArchiveReader* self,
+                                         QWord position)
+{
+  DWord low = 0;
+  DWord high = self->frame_count;
+  while (low < high)
+  {
+    DWord middle = low + (high - low) / 2;
+    const FrameIndexEntry* frame = &self->frame_index[middle];
+    if (position < frame->raw_offset)
+    {
+      high = middle;
+    }
+    else if (position - frame->raw_offset >= frame->raw_size)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      return frame;
+    }
+  }
+
+  return NULL;
+}
+
+static Result decode_frame(CompressedArchiveReader* self,
+                           const FrameIndexEntry* frame, Byte* target)
+{
+  if ((self->header.flags & FLAG_DICTIONARY) && self->dictionary == NULL)
+  {
+    LOG_ERROR("Для распаковки нужен словарь %08X!\n", self->dictionary_hash);
+    return RESULT_ERROR;
+  }
+
+  Byte* input = scratch_reserve(&self->scratch[0], frame->frame_size);
+  if (input == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  StatsSpan span;
+  stats_span_begin(self->stats, &span, STATS_STAGE_READ, NULL);
+  Result result = file_read_at(self->archive_file, input, frame->frame_size,
+                               frame->file_offset);
+  stats_span_end(self->stats, &span, frame->frame_size, 0);
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при чтении данных файла из архива!\n");
+    return result;
+  }
+
+  Size frame_size = 0;
+  Size decoded_size = 0;
+  stats_span_begin(self->stats, &span, STATS_STAGE_DECOMPRESS, "frame");
+  result = decode_two_stage_frame(
+    self, input, frame->frame_size, target, frame->raw_size,
+    self->header.primary_compression, self->header.secondary_compression,
+    two_stage_primary_context(self), &frame_size, &decoded_size);
+  stats_span_end(self->stats, &span, frame->frame_size, decoded_size);
+  if (result == RESULT_OK && decoded_size != frame->raw_size)
+  {
+    LOG_ERROR("[TWO-STAGE] Распаковано %zu байт вместо %zu\n", decoded_size,
+              frame->raw_size);
+    result = RESULT_ERROR;
+  }
+
+  return result;
+}
+
+// Блок сохраненных данных записи, содержащий смещение position: кадр
+// двухэтапной записи или одноэтапная запись целиком, потому что
+// одноэтапный поток не делится на блоки
+static Result locate_range_block(CompressedArchiveReader* self, DWord index,
+                                 const FileEntry* entry, QWord position,
+                                 DWord* number, QWord* offset, Size* size)
+{
+  if (!(self->header.flags & FLAG_TWO_STAGE_COMPRESSION))
+  {
+    *number = 0;
+    *offset = 0;
+    *size = entry->original_size;
+    return RESULT_OK;
+  }
+
+  Result result = index_two_stage_frames(self, index, entry);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  const FrameIndexEntry* frame = find_frame(self, position);
+  if (frame == NULL)
+  {
+    return RESULT_ERROR;
+  }
+
+  *number = (DWord)(frame - self->frame_index);
+  *offset = frame->raw_offset;
+  *size = frame->raw_size;
+  return RESULT_OK;
+}
+
+// Распаковывает блок в range_block. Последний блок остается там, поэтому
+// соседние диапазоны не распаковывают его заново даже без кэша блоков
+static Result load_range_block(CompressedArchiveReader* self, DWord index,
+                               const FileEntry* entry, DWord number,
+                               QWord offset, Size size)
+{
+  self->range_cached = false;
+  Byte* target = scratch_reserve(&self->range_block, size);
+  if (target == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = RESULT_OK;
+  if (self->header.flags & FLAG_TWO_STAGE_COMPRESSION)
+  {
+    result = decode_frame(self, &self->frame_index[number], target);
+  }
+  else
+  {
+    const Byte* data = NULL;
+    Size data_size = 0;
+    result = read_entry_data(self, entry, &data, &data_size);
+    if (result == RESULT_OK && data_size != size)
+    {
+      LOG_ERROR("Распаковано %zu байт вместо %zu\n", data_size, size);
+      result = RESULT_ERROR;
+    }
+
+    if (result == RESULT_OK)
+    {
+      memcpy(target, data, size);
+    }
+  }
+
+  if (result == RESULT_OK)
+  {
+    self->range_entry = index;
+    self->range_block_number = number;
+    self->range_block_offset = offset;
+    self->range_block_size = size;
+    self->range_cached = true;
+  }
+  return result;
+}
+
+// Попадания считаются и для последнего блока читателя, и для общего кэша:
+// промах означает распаковку блока
+static void count_block_lookup(CompressedArchiveReader* self, bool hit)
+{
+  stats_count(self->stats, hit ? "block_cache_hits" : "block_cache_misses",
+              1);
+}
+
+// Ошибка вставки не мешает чтению: блок уже распакован в буфер читателя
+static void cache_block(CompressedArchiveReader* self, DWord entry,
+                        DWord block, const Byte* data, Size size)
+{
+  DWord evicted = 0;
+  if (self->block_cache != NULL &&
+      block_cache_insert(self->block_cache, entry, block, data, size,
+                         &evicted) == RESULT_OK &&
+      evicted > 0)
+  {
+    stats_count(self->stats, "block_cache_evictions", evicted);
+  }
+}
+
+// Участник сплошного блока берет отрезок распакованного блока. В общем
+// кэше блок лежит под ключом (первый участник, 0): у участников нет своих
+// данных, поэтому ключ не пересекается с блоками обычных записей
+static Result read_solid_range(CompressedArchiveReader* self, DWord index,
+                               const FileEntry* entry, DWord block_index,
+                               QWord position, Size length, Byte* buffer)
+{
+  const FileSolidBlock* block =
+    file_table_get_solid_block(self->file_table, block_index);
+  if (block_cache_read(self->block_cache, block->first_entry, 0,
+                       (Size)(entry->offset + position), length, buffer))
+  {
+    count_block_lookup(self, true);
+    return RESULT_OK;
+  }
+
+  bool decoded = !self->block_cached || self->cached_block != block_index;
+  count_block_lookup(self, !decoded);
+
+  const Byte* data = NULL;
+  Size size = 0;
+  Result result = read_stored_data(self, index, &data, &size);
+  if (result == RESULT_OK)
+  {
+    memcpy(buffer, data + position, length);
+    if (decoded)
+    {
+      cache_block(self, block->first_entry, 0, self->solid_block.data,
+                  block->data_size);
+    }
+  }
+  return result;
+}
+
+// Диапазон сохраненных данных записи. Несжатые данные читаются прямо из
+// архива, остальные - поблочно: из последнего блока читателя, из общего
+// кэша блоков или распаковкой
+static Result read_stored_range(CompressedArchiveReader* self, DWord index,
+                                QWord position, Size length, Byte* buffer)
+{
+  const FileEntry* entry = file_table_get_entry(self->file_table, index);
+  if (entry == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (position > entry->original_size ||
+      length > entry->original_size - position)
+  {
+    LOG_ERROR("Диапазон выходит за данные записи %u!\n", index);
+    return RESULT_ERROR;
+  }
+
+  if (length == 0)
+  {
+    return RESULT_OK;
+  }
+
+  DWord block_index = file_table_find_solid_block(self->file_table, index);
+  if (block_index != FILE_TABLE_NO_ENTRY)
+  {
+    return read_solid_range(self, index, entry, block_index, position, length,
+                            buffer);
+  }
+
+  if (!(self->header.flags & FLAG_COMPRESSED))
+  {
+    StatsSpan span;
+    stats_span_begin(self->stats, &span, STATS_STAGE_READ, NULL);
+    Result result = file_read_at(self->archive_file, buffer, length,
+                                 entry->offset + position);
+    stats_span_end(self->stats, &span, length, 0);
+    return result;
+  }
+
+  while (length > 0)
+  {
+    DWord number = 0;
+    QWord block_offset = 0;
+    Size block_size = 0;
+    Result result = locate_range_block(self, index, entry, position, &number,
+                                       &block_offset, &block_size);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+
+    Size skip = (Size)(position - block_offset);
+    Size part = block_size - skip < length ? block_size - skip : length;
+    bool in_reader = self->range_cached && self->range_entry == index &&
+                     self->range_block_number == number;
+    if (in_reader || block_cache_read(self->block_cache, index, number, skip,
+                                      part, buffer))
+    {
+      count_block_lookup(self, true);
+    }
+    else
+    {
+      count_block_lookup(self, false);
+      result = load_range_block(self, index, entry, number, block_offset,
+                                block_size);
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+
+      cache_block(self, index, number, self->range_block.data, block_size);
+      in_reader = true;
+    }
+
+    if (in_reader)
+    {
+      memcpy(buffer, self->range_block.data + skip, part);
+    }
+    buffer += part;
+    position += part;
+    length -= part;
+  }
+
+  return RESULT_OK;
+}
+
+// Диапазон данных файла без дыр. Участки дедуплицированного файла
+// читаются из своих записей-источников
+static Result read_data_range(CompressedArchiveReader* self, DWord index,
+                              QWord position, Size length, Byte* buffer)
+{
+  const FileDedupMap* map = file_table_get_dedup_map(self->file_table, index);
+  if (map == NULL)
+  {
+    return read_stored_range(self, index, position, length, buffer);
+  }
+
+  QWord run_start = 0;
+  for (DWord i = 0; i < map->run_count && length > 0; i++)
+  {
+    const FileChunkRun* run = &map->runs[i];
+    if (position < run_start + run->length)
+    {
+      QWord skip = position - run_start;
+      Size part = run->length - skip < length ? (Size)(run->length - skip)
+                                                : length;
+      Result result = read_stored_range(self, run->source_index,
+                                        run->offset + skip, part, buffer);
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+
+      buffer += part;
+      position += part;
+      length -= part;
+    }
+    run_start += run->length;
+  }
+
+  if (length > 0)
+  {
+    LOG_ERROR("Карта дедупликации записи %u короче файла!\n", index);
+    return RESULT_ERROR;
+  }
+  return RESULT_OK;
+}
+
+// Несжатая запись без дедупликации и вне сплошного блока лежит в архиве
+// целиком: она копируется в файл внутри ядра, а выровненная построителем
+// на файловой системе с клонированием разделяет с архивом блоки
+static bool is_stored_copy(const CompressedArchiveReader* self,
+                           DWord file_index, const FileEntry* entry)
+{
+  return !(self->header.flags & FLAG_COMPRESSED) &&
+         entry->original_size > 0 &&
+         file_table_get_dedup_map(self->file_table, file_index) == NULL &&
+         file_table_find_solid_block(self->file_table, file_index) ==
+           FILE_TABLE_NO_ENTRY;
+}
+
+static Result copy_stored_file(CompressedArchiveReader* self,
+                               DWord file_index, const FileEntry* entry,
+                               const char* output_path)
+{
+  StatsSpan span;
+  LOG_DEBUG("Копирование несжатых данных в файл: %s\n", output_path);
+  stats_span_begin(self->stats, &span, STATS_STAGE_WRITE, "copy");
+  File* output_file = file_create(output_path);
+  if (output_file == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при создании выходного файла!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = file_open_for_write(output_file);
+  if (result == RESULT_OK)
+  {
+    const FileSparseMap* sparse_map =
+      file_table_get_sparse_map(self->file_table, file_index);
+    if (sparse_map != NULL)
+    {
+      result = file_copy_extents(output_file, self->archive_file,
+                                 entry->offset, sparse_map->extents,
+                                 sparse_map->extent_count,
+                                 sparse_map->logical_size);
+    }
+    else
+    {
+      result = file_copy_range(output_file, self->archive_file, entry->offset,
+                               entry->original_size);
+    }
+  }
+
+  file_close(output_file);
+  file_destroy(output_file);
+  stats_span_end(self->stats, &span, entry->original_size,
+                 entry->original_size);
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при записи файла!\n");
+  }
+  return result;
+}
+
+static Result extract_single_file(CompressedArchiveReader* self,
+                                  DWord file_index, const char* output_path)
+{
+  const FileEntry* entry = file_table_get_entry(self->file_table, file_index);
+  if (entry == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  LOG_DEBUG("\n=== Извлечение файла ===\n");
+  LOG_INFO("Файл: %s\n", entry->filename);
+  LOG_DEBUG("Исходный размер: %llu байт\n", entry->original_size);
+  LOG_DEBUG("Сжатый размер: %llu байт\n", entry->compressed_size);
+  LOG_DEBUG("Смещение в архиве: %llu байт\n", entry->offset);
+
+  if (is_stored_copy(self, file_index, entry))
+  {
+    return copy_stored_file(self, file_index, entry, output_path);
+  }
+
+  const Byte* final_data = NULL;
+  Size final_size = 0;
+  Result result = load_file_data(self, file_index, &final_data, &final_size);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  StatsSpan span;
+  LOG_DEBUG("Запись файла: %s\n", output_path);
+  stats_span_begin(self->stats, &span, STATS_STAGE_WRITE, NULL);
+  File* output_file = file_create(output_path);
+  if (output_file == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при создании выходного файла!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  result = file_open_for_write(output_file);
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при открытии выходного файла для записи!\n");
+    file_destroy(output_file);
+    return result;
+  }
+
+  const FileSparseMap* sparse_map =
+    file_table_get_sparse_map(self->file_table, file_index);
+  if (sparse_map != NULL)
+  {
+    // Разреженный файл: пишем только области с данными, дыры создаются
+    // установкой размера файла
+    LOG_DEBUG("Записываем %zu байт в %u областей (полный размер: %llu "
+              "байт)...\n", final_size, sparse_map->extent_count,
+              (unsigned long long)sparse_map->logical_size);
+    result =
+      file_write_extents(output_file, final_data, sparse_map->extents,
+                         sparse_map->extent_count, sparse_map->logical_size);
+  }
+  else
+  {
+    LOG_DEBUG("Записываем %zu байт...\n", final_size);
+    result = file_write_bytes(output_file, final_data, final_size);
+  }
+
+  file_close(output_file);
+  file_destroy(output_file);
+  stats_span_end(self->stats, &span, final_size, entry->original_size);
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при записи файла!\n");
+  }
+  else
+  {
+    LOG_DEBUG("Файл успешно записан\n");
+  }
+
+  return result;
 }
 
 Result compressed_archive_reader_extract_all(CompressedArchiveReader* self,
@@ -1058,55 +2020,74 @@ Result compressed_archive_reader_extract_all(CompressedArchiveReader* self,
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("\n=== Начало извлечения архива ===\n");
-  printf("Целевая директория: %s\n", output_path);
+  LOG_INFO("\n=== Начало извлечения архива ===\n");
+  LOG_INFO("Целевая директория: %s\n", output_path);
 
   if (self->header.flags & FLAG_DIRECTORY)
   {
     if (!path_utils_exists(output_path))
     {
-      printf("Создание директории: %s\n", output_path);
+      LOG_DEBUG("Создание директории: %s\n", output_path);
       path_utils_create_directory(output_path);
     }
   }
 
+  // После дозаписи у одного имени может быть несколько записей, извлекается
+  // только последняя
+  FileNameIndex* names = NULL;
+  if (self->header.flags & FLAG_APPENDED)
+  {
+    names = file_name_index_create(self->file_table);
+    if (names == NULL)
+    {
+      return RESULT_MEMORY_ERROR;
+    }
+  }
+
   for (DWord i = 0; i < file_table_get_count(self->file_table); i++)
   {
     const FileEntry* entry = file_table_get_entry(self->file_table, i);
+    if (names != NULL && file_name_index_find(names, entry->filename) != i)
+    {
+      LOG_DEBUG("Пропуск замененной записи %u: %s\n", i + 1, entry->filename);
+      continue;
+    }
 
-    char output_file_path[PATH_LIMIT];
+    ArenaMark mark = arena_mark(self->arena);
+    const char* output_file_path = output_path;
     if (self->header.flags & FLAG_DIRECTORY)
     {
-      snprintf(output_file_path, sizeof(output_file_path), "%s/%s", output_path,
-               entry->filename);
+      char* joined_path =
+        path_utils_arena_join(self->arena, output_path, entry->filename);
+      if (joined_path == NULL)
+      {
+        file_name_index_destroy(names);
+        return RESULT_MEMORY_ERROR;
+      }
+      output_file_path = joined_path;
 
-      char* parent = path_utils_get_parent(output_file_path);
-      if (parent)
+      char* parent = path_utils_arena_get_parent(self->arena, joined_path);
+      if (parent && !path_utils_exists(parent))
       {
-        if (!path_utils_exists(parent))
-        {
-          printf("Создание поддиректории: %s\n", parent);
-          path_utils_create_directory_recursive(parent);
-        }
-        free(parent);
+        LOG_DEBUG("Создание поддиректории: %s\n", parent);
+        path_utils_create_directory_recursive(parent);
       }
     }
-    else
-    {
-      strncpy(output_file_path, output_path, sizeof(output_file_path));
-    }
 
-    printf("\n--- Файл %u/%u ---\n", i + 1,
-           file_table_get_count(self->file_table));
+    LOG_INFO("\n--- Файл %u/%u ---\n", i + 1,
+             file_table_get_count(self->file_table));
     Result result = extract_single_file(self, i, output_file_path);
+    arena_rewind(self->arena, mark);
     if (result != RESULT_OK)
     {
-      printf("Ошибка извлечения файла: %s\n", entry->filename);
+      LOG_ERROR("Ошибка извлечения файла: %s\n", entry->filename);
+      file_name_index_destroy(names);
       return result;
     }
   }
 
-  printf("\nАрхив успешно извлечен!\n");
+  file_name_index_destroy(names);
+  LOG_INFO("\nАрхив успешно извлечен!\n");
   return RESULT_OK;
 }
 
@@ -1123,6 +2104,118 @@ Result compressed_archive_reader_extract_file(CompressedArchiveReader* self,
   return extract_single_file(self, file_index, output_path);
 }
 
+Result compressed_archive_reader_read_range(CompressedArchiveReader* self,
+                                            DWord file_index, QWord offset,
+                                            Size length, Byte* buffer)
+{
+  if (self == NULL || file_index >= file_table_get_count(self->file_table) ||
+      (buffer == NULL && length > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  QWord file_size = file_table_get_file_size(self->file_table, file_index);
+  if (offset > file_size || length > file_size - offset)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  const FileSparseMap* sparse_map =
+    file_table_get_sparse_map(self->file_table, file_index);
+  if (sparse_map == NULL)
+  {
+    return read_data_range(self, file_index, offset, length, buffer);
+  }
+
+  // Дыры читаются нулями, области с данными лежат в данных записи подряд
+  memset(buffer, 0, length);
+  QWord end = offset + length;
+  QWord data_position = 0;
+  for (DWord i = 0; i < sparse_map->extent_count; i++)
+  {
+    const FileExtent* extent = &sparse_map->extents[i];
+    QWord first = extent->offset > offset ? extent->offset : offset;
+    QWord last = extent->offset + extent->length < end
+                   ? extent->offset + extent->length
+                   : end;
+    if (first < last)
+    {
+      Result result = read_data_range(
+        self, file_index, data_position + (first - extent->offset),
+        (Size)(last - first), buffer + (first - offset));
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+    }
+    data_position += extent->length;
+  }
+
+  return RESULT_OK;
+}
+
+Result compressed_archive_reader_verify_header(
+  const CompressedArchiveReader* self)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (!(self->header.flags & FLAG_CHECKSUMS))
+  {
+    LOG_WARN("Архив записан без контрольных сумм, проверяется только "
+             "распаковка\n");
+    return RESULT_OK;
+  }
+
+  CompressedArchiveHeader header = self->header;
+  Result result = compressed_archive_header_update_crc(&header);
+  if (result == RESULT_OK && header.header_crc != self->header.header_crc)
+  {
+    LOG_ERROR("Контрольная сумма заголовка не совпадает!\n");
+    result = RESULT_ERROR;
+  }
+
+  return result;
+}
+
+Result compressed_archive_reader_test_file(CompressedArchiveReader* self,
+                                           DWord file_index,
+                                           QWord* tested_size)
+{
+  if (self == NULL || file_index >= file_table_get_count(self->file_table))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  const FileEntry* entry = file_table_get_entry(self->file_table, file_index);
+  const Byte* data = NULL;
+  Size size = 0;
+  Result result = load_file_data(self, file_index, &data, &size);
+
+  if (result == RESULT_OK && (self->header.flags & FLAG_CHECKSUMS) &&
+      size > 0)
+  {
+    StatsSpan span;
+    stats_span_begin(self->stats, &span, STATS_STAGE_CRC, NULL);
+    result = crc32_table_calculate(self->crc32_table, data, size);
+    stats_span_end(self->stats, &span, size, 0);
+    if (result == RESULT_OK &&
+        crc32_table_get_crc32(self->crc32_table) != entry->crc)
+    {
+      LOG_ERROR("Контрольная сумма не совпадает: %s\n", entry->filename);
+      result = RESULT_ERROR;
+    }
+  }
+
+  if (tested_size != NULL)
+  {
+    *tested_size = result == RESULT_OK ? size : 0;
+  }
+  return result;
+}
+
 DWord compressed_archive_reader_get_file_count(
   const CompressedArchiveReader* self)
 {
@@ -1140,3 +2233,34 @@ const char* compressed_archive_reader_get_filename(
   const FileEntry* entry = file_table_get_entry(self->file_table, index);
   return entry ? entry->filename : NULL;
 }
+
+QWord compressed_archive_reader_get_file_size(
+  const CompressedArchiveReader* self, DWord index)
+{
+  if (self == NULL || index >= file_table_get_count(self->file_table))
+  {
+    return 0;
+  }
+
+  return file_table_get_file_size(self->file_table, index);
+}
+
+DWord compressed_archive_reader_get_unit_end(
+  const CompressedArchiveReader* self, DWord index)
+{
+  DWord count = compressed_archive_reader_get_file_count(self);
+  if (index >= count)
+  {
+    return count;
+  }
+
+  DWord block_index = file_table_find_solid_block(self->file_table, index);
+  if (block_index == FILE_TABLE_NO_ENTRY)
+  {
+    return index + 1;
+  }
+
+  const FileSolidBlock* block =
+    file_table_get_solid_block(self->file_table, block_index);
+  return block->first_entry + block->entry_count;
+}
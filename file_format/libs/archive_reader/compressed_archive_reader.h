@@ -1,6 +1,9 @@
 #ifndef ARCHIVE_READER_COMPRESSED_ARCHIVE_READER_H
 #define ARCHIVE_READER_COMPRESSED_ARCHIVE_READER_H
 
+#include "block_cache.h"
+#include "dictionary.h"
+#include "stats.h"
 #include "types.h"
 
 typedef struct CompressedArchiveReader CompressedArchiveReader;
@@ -9,15 +12,58 @@ CompressedArchiveReader* compressed_archive_reader_create(
   const char* input_filename);
 void compressed_archive_reader_destroy(CompressedArchiveReader* self);
 
+// Нужен архивам, сжатым со словарем: проверяет, что это тот же словарь, и
+// строит по нему модели. Словарь не принадлежит читателю и должен
+// пережить извлечение
+Result compressed_archive_reader_set_dictionary(CompressedArchiveReader* self,
+                                                const Dictionary* dictionary);
+// Общий кэш распакованных блоков для чтения диапазонов (NULL - только
+// последний блок читателя). Кэш не принадлежит читателю; его можно отдать
+// нескольким читателям одного архива, работающим в разных потоках.
+// Попадания, промахи и вытеснения попадают в счетчики статистики
+// block_cache_hits, block_cache_misses и block_cache_evictions
+Result compressed_archive_reader_set_block_cache(CompressedArchiveReader* self,
+                                                BlockCache* cache);
+// Статистика не принадлежит читателю и должна пережить извлечение
+Result compressed_archive_reader_set_stats(CompressedArchiveReader* self,
+                                           Stats* stats);
+
 Result compressed_archive_reader_extract_all(CompressedArchiveReader* self,
                                              const char* output_path);
 Result compressed_archive_reader_extract_file(CompressedArchiveReader* self,
                                               DWord file_index,
                                               const char* output_path);
 
+// Читает length байт файла начиная с offset (дыры разреженного файла -
+// нули). Распаковываются только блоки, покрывающие диапазон: кадры
+// двухэтапной записи, сплошной блок или одноэтапная запись целиком.
+// Последний распакованный блок остается у читателя для следующих чтений,
+// остальные можно держать в общем кэше блоков.
+// Диапазон должен лежать внутри файла
+Result compressed_archive_reader_read_range(CompressedArchiveReader* self,
+                                            DWord file_index, QWord offset,
+                                            Size length, Byte* buffer);
+
+// Проверка без записи на диск. Заголовок сверяется со своей CRC, запись
+// распаковывается в рабочие буферы читателя и сверяется с CRC из таблицы.
+// В архивах без FLAG_CHECKSUMS проверяется только распаковка.
+// tested_size - объем данных записи без дыр
+Result compressed_archive_reader_verify_header(
+  const CompressedArchiveReader* self);
+Result compressed_archive_reader_test_file(CompressedArchiveReader* self,
+                                           DWord file_index,
+                                           QWord* tested_size);
+
 DWord compressed_archive_reader_get_file_count(
   const CompressedArchiveReader* self);
 const char* compressed_archive_reader_get_filename(
   const CompressedArchiveReader* self, DWord index);
+// Размер файла вместе с дырами и повторами
+QWord compressed_archive_reader_get_file_size(
+  const CompressedArchiveReader* self, DWord index);
+// Конец единицы распаковки, в которую входит запись index: для участника
+// сплошного блока - первая запись после блока, для остальных - index + 1
+DWord compressed_archive_reader_get_unit_end(
+  const CompressedArchiveReader* self, DWord index);
 
 #endif  // ARCHIVE_READER_COMPRESSED_ARCHIVE_READER_H
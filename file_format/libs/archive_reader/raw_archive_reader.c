@@ -6,6 +6,7 @@
 
 #include "file.h"
 #include "file_table.h"
+#include "log.h"
 #include "path_utils.h"
 #include "raw_archive_header.h"
 
@@ -29,7 +30,7 @@ RawArchiveReader* raw_archive_reader_create(const char* input_filename)
     (RawArchiveReader*)malloc(sizeof(RawArchiveReader));
   if (reader == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
@@ -48,24 +49,22 @@ RawArchiveReader* raw_archive_reader_create(const char* input_filename)
     return NULL;
   }
 
-  Result result = file_open_for_read(reader->archive_file);
+  Result result = file_open_for_read_volumes(reader->archive_file);
   if (result != RESULT_OK)
   {
     goto error;
   }
 
-  result = file_read_bytes(reader->archive_file);
+  // Читается только заголовок: данные записей копируются при извлечении
+  result = raw_archive_header_read(&reader->header, reader->archive_file);
   if (result != RESULT_OK)
   {
     goto error;
   }
 
-  const Byte* data = file_get_buffer(reader->archive_file);
-  memcpy(&reader->header, data, RAW_ARCHIVE_HEADER_SIZE);
-
   if (!raw_archive_header_is_valid(&reader->header))
   {
-    printf("Неверная сигнатура или версия raw архива!\n");
+    LOG_ERROR("Неверная сигнатура или версия raw архива!\n");
     result = RESULT_ERROR;
     goto error;
   }
@@ -73,7 +72,7 @@ RawArchiveReader* raw_archive_reader_create(const char* input_filename)
   result = file_seek(reader->archive_file, RAW_ARCHIVE_HEADER_SIZE, SEEK_SET);
   if (result != RESULT_OK)
   {
-    printf("Произошла ошибка при переходе к таблице файлов!\n");
+    LOG_ERROR("Произошла ошибка при переходе к таблице файлов!\n");
     goto error;
   }
 
@@ -83,6 +82,20 @@ RawArchiveReader* raw_archive_reader_create(const char* input_filename)
     goto error;
   }
 
+  if (reader->header.version == RAW_ARCHIVE_VERSION_SPARSE)
+  {
+    result =
+      file_table_read_sparse_maps(reader->file_table, reader->archive_file);
+    if (result == RESULT_OK)
+    {
+      result = file_table_check_sparse_sizes(reader->file_table);
+    }
+    if (result != RESULT_OK)
+    {
+      goto error;
+    }
+  }
+
   return reader;
 
 error:
@@ -114,43 +127,36 @@ static Result extract_single_file(RawArchiveReader* self, DWord file_index,
     return RESULT_INVALID_ARGUMENT;
   }
 
-  // Используем методы File для чтения данных
-  Byte* file_data = (Byte*)malloc(entry->original_size);
-  if (file_data == NULL)
-  {
-    printf("Произошла ошибка при выделении памяти!\n");
-    return RESULT_MEMORY_ERROR;
-  }
-
-  // Читаем данные файла из архива
   Size data_offset =
     RAW_ARCHIVE_HEADER_SIZE + sizeof(DWord) +
     (file_table_get_count(self->file_table) * sizeof(FileEntry)) +
-    entry->offset;
-
-  Result result = file_read_at(self->archive_file, file_data,
-                               entry->original_size, entry->offset);
-
-  if (result != RESULT_OK)
-  {
-    free(file_data);
-    return result;
-  }
+    file_table_get_sparse_maps_size(self->file_table) + entry->offset;
 
   File* output_file = file_create(output_path);
   if (output_file == NULL)
   {
-    free(file_data);
     return RESULT_MEMORY_ERROR;
   }
 
-  result = file_open_for_write(output_file);
+  // Данные копируются из архива в файл внутри ядра, не через память
+  Result result = file_open_for_write(output_file);
   if (result == RESULT_OK)
   {
-    result = file_write_bytes(output_file, file_data, entry->original_size);
+    const FileSparseMap* sparse_map =
+      file_table_get_sparse_map(self->file_table, file_index);
+    if (sparse_map != NULL)
+    {
+      result = file_copy_extents(output_file, self->archive_file, data_offset,
+                                 sparse_map->extents, sparse_map->extent_count,
+                                 sparse_map->logical_size);
+    }
+    else
+    {
+      result = file_copy_range(output_file, self->archive_file, data_offset,
+                               entry->original_size);
+    }
   }
 
-  free(file_data);
   file_close(output_file);
   file_destroy(output_file);
   return result;
@@ -2,10 +2,10 @@
 
 #include <getopt.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
 #include "types.h"
 
 struct ProgramArguments
@@ -15,7 +15,17 @@ struct ProgramArguments
   char* output;
   char* algorithm;
   char* secondary_algorithm;
+  char* log_level;
+  char* stats_format;
+  char* trace_path;
+  char* dictionary_path;
   bool two_staged;
+  bool dedup;
+  bool align;
+  int level;  // -1 - значение --level не является положительным числом
+  long solid_block;  // КиБ, -1 - недопустимое значение --solid
+  long volume_size;  // КиБ, -1 - недопустимое значение --volume-size
+  int threads;  // 0 - по числу процессоров, -1 - недопустимое значение
 };
 
 ProgramArguments* program_arguments_create(void)
@@ -23,7 +33,7 @@ ProgramArguments* program_arguments_create(void)
   ProgramArguments* args = (ProgramArguments*)malloc(sizeof(ProgramArguments));
   if (args == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
@@ -32,7 +42,17 @@ ProgramArguments* program_arguments_create(void)
   args->output = NULL;
   args->algorithm = NULL;
   args->secondary_algorithm = NULL;
+  args->log_level = NULL;
+  args->stats_format = NULL;
+  args->trace_path = NULL;
+  args->dictionary_path = NULL;
   args->two_staged = false;
+  args->dedup = false;
+  args->align = false;
+  args->level = 0;
+  args->solid_block = 0;
+  args->volume_size = 0;
+  args->threads = 0;
 
   return args;
 }
@@ -49,6 +69,10 @@ void program_arguments_destroy(ProgramArguments* self)
   free(self->output);
   free(self->algorithm);
   free(self->secondary_algorithm);
+  free(self->log_level);
+  free(self->stats_format);
+  free(self->trace_path);
+  free(self->dictionary_path);
   free(self);
 }
 
@@ -67,6 +91,16 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
     {"algorithm", required_argument, 0, 0},
     {"secondary-algorithm", required_argument, 0, 0},
     {"two-staged", no_argument, 0, 0},
+    {"log-level", required_argument, 0, 0},
+    {"stats", required_argument, 0, 0},
+    {"trace", required_argument, 0, 0},
+    {"level", required_argument, 0, 0},
+    {"dict", required_argument, 0, 0},
+    {"dedup", no_argument, 0, 0},
+    {"solid", required_argument, 0, 0},
+    {"threads", required_argument, 0, 0},
+    {"align", no_argument, 0, 0},
+    {"volume-size", required_argument, 0, 0},
     {0, 0, 0, 0}};
 
   optind = 1;  // Reset getopt
@@ -89,7 +123,8 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
           self->mode = (char*)malloc(strlen(optarg) + 1);
           if (self->mode == NULL)
           {
-            printf("Произошла ошибка выделения памяти для аргумента mode!\n");
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "mode!\n");
             return false;
           }
           strcpy(self->mode, optarg);
@@ -100,7 +135,8 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
           self->input = (char*)malloc(strlen(optarg) + 1);
           if (self->input == NULL)
           {
-            printf("Произошла ошибка выделения памяти для аргумента input!\n");
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "input!\n");
             return false;
           }
           strcpy(self->input, optarg);
@@ -111,7 +147,8 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
           self->output = (char*)malloc(strlen(optarg) + 1);
           if (self->output == NULL)
           {
-            printf("Произошла ошибка выделения памяти для аргумента output!\n");
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "output!\n");
             return false;
           }
           strcpy(self->output, optarg);
@@ -122,8 +159,8 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
           self->algorithm = (char*)malloc(strlen(optarg) + 1);
           if (self->algorithm == NULL)
           {
-            printf(
-              "Произошла ошибка выделения памяти для аргумента algorithm!\n");
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "algorithm!\n");
             return false;
           }
           strcpy(self->algorithm, optarg);
@@ -134,9 +171,8 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
           self->secondary_algorithm = (char*)malloc(strlen(optarg) + 1);
           if (self->secondary_algorithm == NULL)
           {
-            printf(
-              "Произошла ошибка выделения памяти для аргумента "
-              "secondary-algorithm!\n");
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "secondary-algorithm!\n");
             return false;
           }
           strcpy(self->secondary_algorithm, optarg);
@@ -146,14 +182,114 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
           self->two_staged = true;
           break;
 
+        case 6:  // --log-level
+          free(self->log_level);
+          self->log_level = (char*)malloc(strlen(optarg) + 1);
+          if (self->log_level == NULL)
+          {
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "log-level!\n");
+            return false;
+          }
+          strcpy(self->log_level, optarg);
+          break;
+
+        case 7:  // --stats
+          free(self->stats_format);
+          self->stats_format = (char*)malloc(strlen(optarg) + 1);
+          if (self->stats_format == NULL)
+          {
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "stats!\n");
+            return false;
+          }
+          strcpy(self->stats_format, optarg);
+          break;
+
+        case 8:  // --trace
+          free(self->trace_path);
+          self->trace_path = (char*)malloc(strlen(optarg) + 1);
+          if (self->trace_path == NULL)
+          {
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "trace!\n");
+            return false;
+          }
+          strcpy(self->trace_path, optarg);
+          break;
+
+        case 9:  // --level
+        {
+          char* end = NULL;
+          long level = strtol(optarg, &end, 10);
+          self->level = (*optarg != '\0' && *end == '\0' && level > 0 &&
+                         level <= 255)
+                          ? (int)level
+                          : -1;
+          break;
+        }
+
+        case 10:  // --dict
+          free(self->dictionary_path);
+          self->dictionary_path = (char*)malloc(strlen(optarg) + 1);
+          if (self->dictionary_path == NULL)
+          {
+            LOG_ERROR("Произошла ошибка выделения памяти для аргумента "
+                      "dict!\n");
+            return false;
+          }
+          strcpy(self->dictionary_path, optarg);
+          break;
+
+        case 11:  // --dedup
+          self->dedup = true;
+          break;
+
+        case 12:  // --solid
+        {
+          char* end = NULL;
+          long size = strtol(optarg, &end, 10);
+          self->solid_block = (*optarg != '\0' && *end == '\0' && size > 0 &&
+                               size <= ARGUMENTS_SOLID_BLOCK_MAX)
+                                ? size
+                                : -1;
+          break;
+        }
+
+        case 13:  // --threads
+        {
+          char* end = NULL;
+          long threads = strtol(optarg, &end, 10);
+          self->threads = (*optarg != '\0' && *end == '\0' && threads > 0 &&
+                           threads <= 1024)
+                            ? (int)threads
+                            : -1;
+          break;
+        }
+
+        case 14:  // --align
+          self->align = true;
+          break;
+
+        case 15:  // --volume-size
+        {
+          char* end = NULL;
+          long size = strtol(optarg, &end, 10);
+          self->volume_size = (*optarg != '\0' && *end == '\0' && size > 0 &&
+                               size <= ARGUMENTS_VOLUME_SIZE_MAX)
+                                ? size
+                                : -1;
+          break;
+        }
+
         default:
-          printf("Обнаружен неизвестный аргумент командной строки!\n");
+          LOG_ERROR("Обнаружен неизвестный аргумент командной строки!\n");
           return false;
       }
     }
     else
     {
-      printf("Введены некорректные аргументы командной строки!\n");
+      LOG_ERROR("Введены некорректные аргументы командной строки!\n");
       return false;
     }
   }
@@ -162,27 +298,77 @@ bool program_arguments_parse(ProgramArguments* self, int argc, char** argv)
 
   if (!self->mode || strlen(self->mode) == 0)
   {
-    printf("Ошибка: не указан обязательный аргумент --mode\n");
+    LOG_ERROR("Ошибка: не указан обязательный аргумент --mode\n");
     is_arguments_correct = false;
   }
 
   if (!self->input || strlen(self->input) == 0)
   {
-    printf("Ошибка: не указан обязательный аргумент --input\n");
+    LOG_ERROR("Ошибка: не указан обязательный аргумент --input\n");
     is_arguments_correct = false;
   }
 
-  if (!self->output || strlen(self->output) == 0)
+  // Просмотр и проверка архива ничего не пишут
+  bool needs_output =
+    self->mode == NULL ||
+    (strcmp(self->mode, "list") != 0 && strcmp(self->mode, "l") != 0 &&
+     strcmp(self->mode, "test") != 0 && strcmp(self->mode, "v") != 0);
+  if (needs_output && (!self->output || strlen(self->output) == 0))
   {
-    printf("Ошибка: не указан обязательный аргумент --output\n");
+    LOG_ERROR("Ошибка: не указан обязательный аргумент --output\n");
     is_arguments_correct = false;
   }
 
   if (self->mode != NULL && strcmp(self->mode, "encode") != 0 &&
-      strcmp(self->mode, "decode") != 0 && strcmp(self->mode, "e") != 0 &&
-      strcmp(self->mode, "d") != 0)
+      strcmp(self->mode, "decode") != 0 && strcmp(self->mode, "train") != 0 &&
+      strcmp(self->mode, "append") != 0 && strcmp(self->mode, "list") != 0 &&
+      strcmp(self->mode, "test") != 0 && strcmp(self->mode, "e") != 0 &&
+      strcmp(self->mode, "d") != 0 && strcmp(self->mode, "t") != 0 &&
+      strcmp(self->mode, "u") != 0 && strcmp(self->mode, "l") != 0 &&
+      strcmp(self->mode, "v") != 0)
+  {
+    LOG_ERROR("Ошибка: недопустимое значение для --mode: %s\n", self->mode);
+    is_arguments_correct = false;
+  }
+
+  if (self->log_level != NULL && log_level_from_name(self->log_level) < 0)
+  {
+    LOG_ERROR("Ошибка: недопустимое значение для --log-level: %s\n",
+              self->log_level);
+    is_arguments_correct = false;
+  }
+
+  if (self->level < 0)
+  {
+    LOG_ERROR("Ошибка: недопустимое значение для --level\n");
+    is_arguments_correct = false;
+  }
+
+  if (self->solid_block < 0)
+  {
+    LOG_ERROR("Ошибка: недопустимое значение для --solid (1-%d КиБ)\n",
+              ARGUMENTS_SOLID_BLOCK_MAX);
+    is_arguments_correct = false;
+  }
+
+  if (self->volume_size < 0)
+  {
+    LOG_ERROR("Ошибка: недопустимое значение для --volume-size (1-%ld "
+              "КиБ)\n",
+              ARGUMENTS_VOLUME_SIZE_MAX);
+    is_arguments_correct = false;
+  }
+
+  if (self->threads < 0)
+  {
+    LOG_ERROR("Ошибка: недопустимое значение для --threads\n");
+    is_arguments_correct = false;
+  }
+
+  if (self->stats_format != NULL && strcmp(self->stats_format, "json") != 0)
   {
-    printf("Ошибка: недопустимое значение для --mode: %s\n", self->mode);
+    LOG_ERROR("Ошибка: недопустимое значение для --stats: %s\n",
+              self->stats_format);
     is_arguments_correct = false;
   }
 
@@ -219,3 +405,53 @@ bool program_arguments_get_two_staged(const ProgramArguments* self)
 {
   return self ? self->two_staged : false;
 }
+
+bool program_arguments_get_dedup(const ProgramArguments* self)
+{
+  return self ? self->dedup : false;
+}
+
+bool program_arguments_get_align(const ProgramArguments* self)
+{
+  return self ? self->align : false;
+}
+
+int program_arguments_get_level(const ProgramArguments* self)
+{
+  return self ? self->level : 0;
+}
+
+long program_arguments_get_solid_block(const ProgramArguments* self)
+{
+  return self ? self->solid_block : 0;
+}
+
+long program_arguments_get_volume_size(const ProgramArguments* self)
+{
+  return self ? self->volume_size : 0;
+}
+
+int program_arguments_get_threads(const ProgramArguments* self)
+{
+  return self ? self->threads : 0;
+}
+
+const char* program_arguments_get_dictionary(const ProgramArguments* self)
+{
+  return self ? self->dictionary_path : NULL;
+}
+
+const char* program_arguments_get_log_level(const ProgramArguments* self)
+{
+  return self ? self->log_level : NULL;
+}
+
+const char* program_arguments_get_stats_format(const ProgramArguments* self)
+{
+  return self ? self->stats_format : NULL;
+}
+
+const char* program_arguments_get_trace(const ProgramArguments* self)
+{
+  return self ? self->trace_path : NULL;
+}
@@ -3,6 +3,11 @@
 
 #include <stdbool.h>
 
+// Наибольший размер сплошного блока для --solid, КиБ
+#define ARGUMENTS_SOLID_BLOCK_MAX 65536
+// Наибольший размер тома для --volume-size, КиБ (4 ТиБ)
+#define ARGUMENTS_VOLUME_SIZE_MAX (4L * 1024 * 1024 * 1024)
+
 typedef struct ProgramArguments ProgramArguments;
 
 ProgramArguments* program_arguments_create(void);
@@ -16,5 +21,21 @@ const char* program_arguments_get_algorithm(const ProgramArguments* self);
 const char* program_arguments_get_secondary_algorithm(
   const ProgramArguments* self);
 bool program_arguments_get_two_staged(const ProgramArguments* self);
+bool program_arguments_get_dedup(const ProgramArguments* self);
+// Выравнивать хранимые данные по блокам файловой системы (--align)
+bool program_arguments_get_align(const ProgramArguments* self);
+// 0 - уровень сжатия не задан
+int program_arguments_get_level(const ProgramArguments* self);
+// Размер сплошного блока в КиБ (--solid), 0 - блоки не заданы
+long program_arguments_get_solid_block(const ProgramArguments* self);
+// Размер тома в КиБ (--volume-size), 0 - архив пишется одним файлом
+long program_arguments_get_volume_size(const ProgramArguments* self);
+// Число потоков (--threads), 0 - по числу процессоров
+int program_arguments_get_threads(const ProgramArguments* self);
+// Путь к файлу словаря (--dict) или NULL
+const char* program_arguments_get_dictionary(const ProgramArguments* self);
+const char* program_arguments_get_log_level(const ProgramArguments* self);
+const char* program_arguments_get_stats_format(const ProgramArguments* self);
+const char* program_arguments_get_trace(const ProgramArguments* self);
 
 #endif  // ARGUMENTS_ARGUMENTS_H
@@ -2,10 +2,10 @@
 
 #include <ctype.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
 #include "types.h"
 
 #define ARITHMETIC_FULL_RANGE 0x100000000ULL    // 2^32
@@ -51,10 +51,18 @@ Result arithmetic_model_build(ArithmeticModel* model, const Byte* data,
 
   for (Size i = 0; i < size; i++)
   {
-    if (data[i] < (Byte)ARITHMETIC_MAX_SYMBOLS)
-    {
-      frequencies[data[i]]++;
-    }
+    frequencies[data[i]]++;
+  }
+
+  return arithmetic_model_build_from_frequencies(model, frequencies);
+}
+
+Result arithmetic_model_build_from_frequencies(ArithmeticModel* model,
+                                               const DWord* frequencies)
+{
+  if (!model || !frequencies)
+  {
+    return RESULT_INVALID_ARGUMENT;
   }
 
   model->cumulative[0] = 0;
@@ -79,8 +87,8 @@ Result arithmetic_model_build(ArithmeticModel* model, const Byte* data,
     model->total = model->cumulative[ARITHMETIC_MAX_SYMBOLS];
   }
 
-  printf("[ARITHMETIC] Модель построена: total=%u (масштаб 1:%u)\n",
-         model->total, model->total / ARITHMETIC_MAX_SYMBOLS);
+  LOG_DEBUG("[ARITHMETIC] Модель построена: total=%u (масштаб 1:%u)\n",
+            model->total, model->total / ARITHMETIC_MAX_SYMBOLS);
 
   return RESULT_OK;
 }
@@ -100,71 +108,64 @@ static void arithmetic_encoder_init(ArithmeticEncoder* encoder)
   encoder->underflow_bits = 0;
 }
 
-static void arithmetic_encoder_write_bit(ArithmeticEncoder* encoder, int bit,
-                                         Byte** output, Size* output_size,
-                                         Size* buffer_position,
-                                         Size* buffer_capacity)
+// Битовый вывод в буфер вызывающего кода. При нехватке места биты
+// отбрасываются, а overflow сообщает об ошибке после кодирования
+typedef struct
 {
-  if (*buffer_position >= *buffer_capacity * 8)
-  {
-    *buffer_capacity = (*buffer_capacity == 0) ? 1024 : *buffer_capacity * 2;
-    Byte* new_buffer = (Byte*)realloc(*output, *buffer_capacity);
-
-    if (new_buffer == NULL)
-    {
-      return;
-    }
+  Byte* data;
+  Size capacity;
+  Size position;  // В битах
+  bool overflow;
+} ArithmeticBitWriter;
 
-    *output = new_buffer;
-    if (*buffer_capacity > 0)
-    {
-      memset(*output + (*buffer_capacity / 2), 0, *buffer_capacity / 2);
-    }
+static void arithmetic_encoder_write_bit(ArithmeticBitWriter* writer, int bit)
+{
+  if (writer->position >= writer->capacity * 8)
+  {
+    writer->overflow = true;
+    return;
   }
 
-  Size byte_index = *buffer_position / 8;
-  Size bit_index = 7 - (*buffer_position % 8);
+  Size byte_index = writer->position / 8;
+  Size bit_index = 7 - (writer->position % 8);
 
   if (bit)
   {
-    (*output)[byte_index] |= (1 << bit_index);
+    writer->data[byte_index] |= (1 << bit_index);
+  }
+  else
+  {
+    writer->data[byte_index] &= ~(1 << bit_index);
   }
 
-  (*buffer_position)++;
+  writer->position++;
+}
+
+// Бит и следующие за ним отложенные противоположные биты
+static void arithmetic_encoder_emit(ArithmeticEncoder* encoder,
+                                    ArithmeticBitWriter* writer, int bit)
+{
+  arithmetic_encoder_write_bit(writer, bit);
 
-  *output_size = (*buffer_position + 7) / 8;
+  while (encoder->underflow_bits > 0)
+  {
+    arithmetic_encoder_write_bit(writer, !bit);
+    encoder->underflow_bits--;
+  }
 }
 
 static void arithmetic_encoder_normalize(ArithmeticEncoder* encoder,
-                                         Byte** output, Size* output_size,
-                                         Size* buffer_position,
-                                         Size* buffer_capacity)
+                                         ArithmeticBitWriter* writer)
 {
   while ((encoder->high - encoder->low) < ARITHMETIC_QUARTER_RANGE)
   {
     if (encoder->high < ARITHMETIC_HALF_RANGE)
     {
-      arithmetic_encoder_write_bit(encoder, 0, output, output_size,
-                                   buffer_position, buffer_capacity);
-
-      while (encoder->underflow_bits > 0)
-      {
-        arithmetic_encoder_write_bit(encoder, 1, output, output_size,
-                                     buffer_position, buffer_capacity);
-        encoder->underflow_bits--;
-      }
+      arithmetic_encoder_emit(encoder, writer, 0);
     }
     else if (encoder->low >= ARITHMETIC_HALF_RANGE)
     {
-      arithmetic_encoder_write_bit(encoder, 1, output, output_size,
-                                   buffer_position, buffer_capacity);
-
-      while (encoder->underflow_bits > 0)
-      {
-        arithmetic_encoder_write_bit(encoder, 0, output, output_size,
-                                     buffer_position, buffer_capacity);
-        encoder->underflow_bits--;
-      }
+      arithmetic_encoder_emit(encoder, writer, 1);
 
       encoder->low -= ARITHMETIC_HALF_RANGE;
       encoder->high -= ARITHMETIC_HALF_RANGE;
@@ -187,44 +188,38 @@ static void arithmetic_encoder_normalize(ArithmeticEncoder* encoder,
   }
 }
 
-static void arithmetic_encoder_finish(ArithmeticEncoder* encoder, Byte** output,
-                                      Size* output_size, Size* buffer_position,
-                                      Size* buffer_capacity)
+// Нормализация оставляет интервал не уже четверти, но он может лежать
+// целиком в одной половине. Поэтому пишутся два старших бита наименьшей
+// кратной четверти точки интервала: декодер дополняет поток нулями и
+// получает именно ее
+static void arithmetic_encoder_finish(ArithmeticEncoder* encoder,
+                                      ArithmeticBitWriter* writer)
 {
-  encoder->underflow_bits++;
+  QWord point = ((QWord)encoder->low + ARITHMETIC_QUARTER_RANGE - 1) &
+                ~(ARITHMETIC_QUARTER_RANGE - 1);
 
-  if (encoder->low < ARITHMETIC_QUARTER_RANGE)
-  {
-    arithmetic_encoder_write_bit(encoder, 0, output, output_size,
-                                 buffer_position, buffer_capacity);
-    while (encoder->underflow_bits > 0)
-    {
-      arithmetic_encoder_write_bit(encoder, 1, output, output_size,
-                                   buffer_position, buffer_capacity);
-      encoder->underflow_bits--;
-    }
-  }
-  else
-  {
-    arithmetic_encoder_write_bit(encoder, 1, output, output_size,
-                                 buffer_position, buffer_capacity);
-    while (encoder->underflow_bits > 0)
-    {
-      arithmetic_encoder_write_bit(encoder, 0, output, output_size,
-                                   buffer_position, buffer_capacity);
-      encoder->underflow_bits--;
-    }
-  }
+  arithmetic_encoder_emit(encoder, writer,
+                          (point & ARITHMETIC_HALF_RANGE) != 0);
+  arithmetic_encoder_write_bit(writer,
+                               (point & ARITHMETIC_QUARTER_RANGE) != 0);
 
-  while (*buffer_position % 8 != 0)
+  while (writer->position % 8 != 0 && !writer->overflow)
   {
-    arithmetic_encoder_write_bit(encoder, 0, output, output_size,
-                                 buffer_position, buffer_capacity);
+    arithmetic_encoder_write_bit(writer, 0);
   }
 }
 
-Result arithmetic_compress(const Byte* input, Size input_size, Byte** output,
-                           Size* output_size, const ArithmeticModel* model)
+Size arithmetic_compress_bound(Size input_size)
+{
+  // Символ с минимальной частотой стоит не более log2(ARITHMETIC_MAX_TOTAL)
+  // бит, запас - на завершающие биты кодировщика
+  return input_size * 4 + 16;
+}
+
+Result arithmetic_compress_into(const Byte* input, Size input_size,
+                                Byte* output, Size output_capacity,
+                                Size* output_size,
+                                const ArithmeticModel* model)
 {
   if (!input || !output || !output_size || !model || input_size == 0)
   {
@@ -233,41 +228,23 @@ Result arithmetic_compress(const Byte* input, Size input_size, Byte** output,
 
   if (model->total == 0)
   {
-    printf("[ARITHMETIC] Ошибка: модель имеет нулевую сумму частот\n");
+    LOG_ERROR("[ARITHMETIC] Ошибка: модель имеет нулевую сумму частот\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[ARITHMETIC] Начало арифметического кодирования\n");
-  printf("[ARITHMETIC] Размер входных данных: %zu байт\n", input_size);
-  printf("[ARITHMETIC] Общее количество символов в модели: %u\n", model->total);
+  LOG_DEBUG("[ARITHMETIC] Начало арифметического кодирования\n");
+  LOG_DEBUG("[ARITHMETIC] Размер входных данных: %zu байт\n", input_size);
+  LOG_DEBUG("[ARITHMETIC] Общее количество символов в модели: %u\n",
+            model->total);
 
   ArithmeticEncoder encoder;
   arithmetic_encoder_init(&encoder);
 
-  Size buffer_capacity = 1024;
-  *output = malloc(buffer_capacity);
-  if (*output == NULL)
-  {
-    printf("[ARITHMETIC] Ошибка: не удалось выделить память\n");
-    return RESULT_MEMORY_ERROR;
-  }
+  ArithmeticBitWriter writer = {output, output_capacity, 0, false};
 
-  memset(*output, 0, buffer_capacity);
-  Size buffer_position = 0;
-  *output_size = 0;
-
-  for (Size i = 0; i < input_size; i++)
+  for (Size i = 0; i < input_size && !writer.overflow; i++)
   {
     Byte symbol = input[i];
-
-    if (symbol >= (Byte)ARITHMETIC_MAX_SYMBOLS)
-    {
-      printf("[ARITHMETIC] Ошибка: некорректный символ %u\n", symbol);
-      free(*output);
-      *output = NULL;
-      return RESULT_INVALID_ARGUMENT;
-    }
-
     DWord symbol_low = model->cumulative[symbol];
     DWord symbol_high = model->cumulative[symbol + 1];
 
@@ -279,30 +256,63 @@ Result arithmetic_compress(const Byte* input, Size input_size, Byte** output,
     encoder.low = (DWord)new_low;
     encoder.high = (DWord)new_high;
 
-    arithmetic_encoder_normalize(&encoder, output, output_size,
-                                 &buffer_position, &buffer_capacity);
+    arithmetic_encoder_normalize(&encoder, &writer);
   }
 
-  arithmetic_encoder_finish(&encoder, output, output_size, &buffer_position,
-                            &buffer_capacity);
+  arithmetic_encoder_finish(&encoder, &writer);
 
-  if (*output_size > 0)
+  if (writer.overflow)
   {
-    Byte* trimmed_output = (Byte*)realloc(*output, *output_size);
-    if (trimmed_output != NULL)
-    {
-      *output = trimmed_output;
-    }
+    LOG_ERROR("[ARITHMETIC] Ошибка: выходной буфер (%zu байт) переполнен\n",
+              output_capacity);
+    return RESULT_ERROR;
   }
 
-  printf("[ARITHMETIC] Кодирование завершено\n");
-  printf("[ARITHMETIC] Размер выходных данных: %zu байт\n", *output_size);
+  *output_size = (writer.position + 7) / 8;
+
+  LOG_DEBUG("[ARITHMETIC] Кодирование завершено\n");
+  LOG_DEBUG("[ARITHMETIC] Размер выходных данных: %zu байт\n", *output_size);
   if (input_size > 0)
   {
     double ratio = (1.0 - (double)*output_size / (double)input_size) * 100;
-    printf("[ARITHMETIC] Коэффициент сжатия: %.2f%%\n", ratio);
+    LOG_DEBUG("[ARITHMETIC] Коэффициент сжатия: %.2f%%\n", ratio);
+  }
+
+  return RESULT_OK;
+}
+
+Result arithmetic_compress(const Byte* input, Size input_size, Byte** output,
+                           Size* output_size, const ArithmeticModel* model)
+{
+  if (!input || !output || !output_size || !model || input_size == 0)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size capacity = arithmetic_compress_bound(input_size);
+  Byte* compressed = malloc(capacity);
+  if (compressed == NULL)
+  {
+    LOG_ERROR("[ARITHMETIC] Ошибка: не удалось выделить память\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = arithmetic_compress_into(input, input_size, compressed,
+                                           capacity, output_size, model);
+  if (result != RESULT_OK)
+  {
+    free(compressed);
+    *output = NULL;
+    return result;
+  }
+
+  Byte* trimmed_output = (Byte*)realloc(compressed, *output_size);
+  if (trimmed_output != NULL)
+  {
+    compressed = trimmed_output;
   }
 
+  *output = compressed;
   return RESULT_OK;
 }
 
@@ -386,39 +396,32 @@ static void arithmetic_decoder_normalize(ArithmeticDecoder* decoder)
   }
 }
 
-Result arithmetic_decompress(const Byte* input, Size input_size, Byte** output,
-                             Size* output_size, const ArithmeticModel* model)
+Result arithmetic_decompress_into(const Byte* input, Size input_size,
+                                  Byte* output, Size* output_size,
+                                  const ArithmeticModel* model)
 {
   if (!input || !output || !output_size || !model || input_size == 0)
   {
-    printf("[ARITHMETIC] Ошибка: неверные параметры в arithmetic_decompress\n");
+    LOG_ERROR("[ARITHMETIC] Ошибка: неверные параметры в "
+              "arithmetic_decompress\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
   if (model->total == 0)
   {
-    printf("[ARITHMETIC] Ошибка: модель имеет нулевую сумму частот\n");
+    LOG_ERROR("[ARITHMETIC] Ошибка: модель имеет нулевую сумму частот\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[ARITHMETIC] Начало арифметического декодирования\n");
-  printf("[ARITHMETIC] Размер входных данных: %zu байт\n", input_size);
-  printf("[ARITHMETIC] Ожидаемый выходной размер: %zu байт\n", *output_size);
-  printf("[ARITHMETIC] Общее количество символов в модели: %u\n", model->total);
+  LOG_DEBUG("[ARITHMETIC] Начало арифметического декодирования\n");
+  LOG_DEBUG("[ARITHMETIC] Размер входных данных: %zu байт\n", input_size);
+  LOG_DEBUG("[ARITHMETIC] Ожидаемый выходной размер: %zu байт\n", *output_size);
+  LOG_DEBUG("[ARITHMETIC] Общее количество символов в модели: %u\n",
+            model->total);
 
   ArithmeticDecoder decoder;
   arithmetic_decoder_init(&decoder, input, input_size);
 
-  *output = malloc(*output_size);
-  if (*output == NULL)
-  {
-    printf(
-      "[ARITHMETIC] Ошибка: не удалось выделить память для выходных данных\n");
-    return RESULT_MEMORY_ERROR;
-  }
-
-  memset(*output, 0, *output_size);
-
   for (Size i = 0; i < *output_size; i++)
   {
     QWord range = (QWord)(decoder.high - decoder.low) + 1;
@@ -437,7 +440,7 @@ Result arithmetic_decompress(const Byte* input, Size input_size, Byte** output,
       }
     }
 
-    (*output)[i] = symbol;
+    output[i] = symbol;
 
     DWord symbol_low = model->cumulative[symbol];
     DWord symbol_high = model->cumulative[symbol + 1];
@@ -451,8 +454,38 @@ Result arithmetic_decompress(const Byte* input, Size input_size, Byte** output,
     arithmetic_decoder_normalize(&decoder);
   }
 
-  printf("[ARITHMETIC] Декодирование завершено\n");
+  LOG_DEBUG("[ARITHMETIC] Декодирование завершено\n");
+
+  return RESULT_OK;
+}
+
+Result arithmetic_decompress(const Byte* input, Size input_size, Byte** output,
+                             Size* output_size, const ArithmeticModel* model)
+{
+  if (!input || !output || !output_size || !model || input_size == 0)
+  {
+    LOG_ERROR("[ARITHMETIC] Ошибка: неверные параметры в "
+              "arithmetic_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Byte* decompressed = malloc(*output_size > 0 ? *output_size : 1);
+  if (decompressed == NULL)
+  {
+    LOG_ERROR("[ARITHMETIC] Ошибка: не удалось выделить память для выходных "
+              "данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = arithmetic_decompress_into(input, input_size, decompressed,
+                                             output_size, model);
+  if (result != RESULT_OK)
+  {
+    free(decompressed);
+    return result;
+  }
 
+  *output = decompressed;
   return RESULT_OK;
 }
 
@@ -469,9 +502,8 @@ Result arithmetic_serialize_model(const ArithmeticModel* model, Byte** data,
   *data = malloc(*size);
   if (*data == NULL)
   {
-    printf(
-      "[ARITHMETIC] Ошибка: не удалось выделить память для сериализации "
-      "модели\n");
+    LOG_ERROR("[ARITHMETIC] Ошибка: не удалось выделить память для "
+              "сериализации " "модели\n");
     return RESULT_MEMORY_ERROR;
   }
 
@@ -494,7 +526,7 @@ Result arithmetic_deserialize_model(ArithmeticModel* model, const Byte* data,
 {
   if (!model || !data || size != (256 * sizeof(DWord) + sizeof(DWord)))
   {
-    printf("[ARITHMETIC] Ошибка: неверный размер данных модели\n");
+    LOG_ERROR("[ARITHMETIC] Ошибка: неверный размер данных модели\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
@@ -38,6 +38,9 @@ ArithmeticModel* arithmetic_model_create(void);
 void arithmetic_model_destroy(ArithmeticModel* model);
 Result arithmetic_model_build(ArithmeticModel* model, const Byte* data,
                               Size size);
+// Построение по готовой таблице частот ARITHMETIC_MAX_SYMBOLS символов
+Result arithmetic_model_build_from_frequencies(ArithmeticModel* model,
+                                               const DWord* frequencies);
 void arithmetic_model_update(ArithmeticModel* model, Byte symbol);
 
 // Арифметическое кодирование
@@ -48,6 +51,16 @@ Result arithmetic_compress(const Byte* input, Size input_size, Byte** output,
 Result arithmetic_decompress(const Byte* input, Size input_size, Byte** output,
                              Size* output_size, const ArithmeticModel* model);
 
+// Варианты с буфером вызывающего кода, семантика как у lz77_*_into
+Size arithmetic_compress_bound(Size input_size);
+Result arithmetic_compress_into(const Byte* input, Size input_size,
+                                Byte* output, Size output_capacity,
+                                Size* output_size,
+                                const ArithmeticModel* model);
+Result arithmetic_decompress_into(const Byte* input, Size input_size,
+                                  Byte* output, Size* output_size,
+                                  const ArithmeticModel* model);
+
 // Сериализация/десериализация модели
 Result arithmetic_serialize_model(const ArithmeticModel* model, Byte** data,
                                   Size* size);
@@ -0,0 +1,683 @@
+#include "codec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arithmetic.h"
+#include "huffman.h"
+#include "log.h"
+#include "lz77.h"
+#include "lz78.h"
+#include "lzh.h"
+#include "rle.h"
+#include "shannon.h"
+
+#define CODEC_MODEL_SIZE_BYTES 4
+// Общий итог частот модели истории
+#define CODEC_HISTORY_TOTAL (1U << 16)
+
+static void codec_write_dword(Byte* data, DWord value)
+{
+  data[0] = (Byte)value;
+  data[1] = (Byte)(value >> 8);
+  data[2] = (Byte)(value >> 16);
+  data[3] = (Byte)(value >> 24);
+}
+
+static DWord codec_read_dword(const Byte* data)
+{
+  return (DWord)data[0] | (DWord)data[1] << 8 | (DWord)data[2] << 16 |
+         (DWord)data[3] << 24;
+}
+
+// Склеивает [model_size][model][data] в один буфер и освобождает части
+static Result codec_pack(Byte* model, Size model_size, Byte* data,
+                         Size data_size, Byte** output, Size* output_size)
+{
+  Size packed_size = CODEC_MODEL_SIZE_BYTES + model_size + data_size;
+  Byte* packed = (Byte*)malloc(packed_size);
+  if (packed == NULL)
+  {
+    free(model);
+    free(data);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  codec_write_dword(packed, (DWord)model_size);
+  if (model_size > 0)
+  {
+    memcpy(packed + CODEC_MODEL_SIZE_BYTES, model, model_size);
+  }
+  memcpy(packed + CODEC_MODEL_SIZE_BYTES + model_size, data, data_size);
+
+  free(model);
+  free(data);
+
+  *output = packed;
+  *output_size = packed_size;
+  return RESULT_OK;
+}
+
+static Result codec_unpack(const Byte* input, Size input_size,
+                           const Byte** model, Size* model_size,
+                           const Byte** data, Size* data_size)
+{
+  if (input_size < CODEC_MODEL_SIZE_BYTES)
+  {
+    return RESULT_ERROR;
+  }
+
+  Size size = codec_read_dword(input);
+  if (size > input_size - CODEC_MODEL_SIZE_BYTES)
+  {
+    return RESULT_ERROR;
+  }
+
+  *model = input + CODEC_MODEL_SIZE_BYTES;
+  *model_size = size;
+  *data = *model + size;
+  *data_size = input_size - CODEC_MODEL_SIZE_BYTES - size;
+  return RESULT_OK;
+}
+
+// Модель истории: частоты приводятся к общему итогу, и у каждого байта
+// частота не меньше 1, чтобы блок с новыми байтами все равно сжимался
+static void codec_history_model(const CodecHistory* history,
+                                DWord* frequencies)
+{
+  QWord total = 0;
+  for (Size i = 0; i < CODEC_HISTORY_SYMBOLS; i++)
+  {
+    total += history->frequencies[i];
+  }
+
+  for (Size i = 0; i < CODEC_HISTORY_SYMBOLS; i++)
+  {
+    QWord frequency =
+      total > 0 ? (QWord)history->frequencies[i] * CODEC_HISTORY_TOTAL / total
+                : 0;
+    frequencies[i] = frequency > 0 ? (DWord)frequency : 1;
+  }
+}
+
+// Сжатие энтропийным кодеком. frequencies == NULL - модель строится по
+// самому блоку и сериализуется в *model, иначе берется готовая
+typedef Result (*CodecEncodeModel)(const Byte* input, Size input_size,
+                                   const DWord* frequencies, Byte** model,
+                                   Size* model_size, Byte** data,
+                                   Size* data_size);
+// frequencies == NULL - модель читается из model
+typedef Result (*CodecDecodeModel)(const Byte* model, Size model_size,
+                                   const DWord* frequencies, const Byte* data,
+                                   Size data_size, Byte** output,
+                                   Size* output_size);
+
+// Блок сжимается своей моделью и, если есть история, моделью истории;
+// упаковывается меньший вариант, у варианта с историей model_size == 0
+static Result codec_compress_entropy(const Byte* input, Size input_size,
+                                     const CodecHistory* history,
+                                     CodecEncodeModel encode, Byte** output,
+                                     Size* output_size)
+{
+  Byte* model = NULL;
+  Size model_size = 0;
+  Byte* data = NULL;
+  Size data_size = 0;
+
+  Result result = encode(input, input_size, NULL, &model, &model_size, &data,
+                         &data_size);
+  if (result != RESULT_OK)
+  {
+    free(model);
+    free(data);
+    return result;
+  }
+
+  if (history->frequencies != NULL)
+  {
+    DWord frequencies[CODEC_HISTORY_SYMBOLS];
+    Byte* carried = NULL;
+    Size carried_size = 0;
+    codec_history_model(history, frequencies);
+    if (encode(input, input_size, frequencies, NULL, NULL, &carried,
+               &carried_size) == RESULT_OK &&
+        carried_size <= model_size + data_size)
+    {
+      free(model);
+      free(data);
+      return codec_pack(NULL, 0, carried, carried_size, output, output_size);
+    }
+    free(carried);
+  }
+
+  return codec_pack(model, model_size, data, data_size, output, output_size);
+}
+
+static Result codec_decompress_entropy(const Byte* input, Size input_size,
+                                       const CodecHistory* history,
+                                       CodecDecodeModel decode, Byte** output,
+                                       Size* output_size)
+{
+  const Byte* model;
+  const Byte* data;
+  Size model_size;
+  Size data_size;
+  Result result =
+    codec_unpack(input, input_size, &model, &model_size, &data, &data_size);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  DWord frequencies[CODEC_HISTORY_SYMBOLS];
+  const DWord* carried = NULL;
+  if (model_size == 0)
+  {
+    if (history->frequencies == NULL)
+    {
+      LOG_ERROR("[CODEC] Модель истории в первом кадре потока!\n");
+      return RESULT_ERROR;
+    }
+    codec_history_model(history, frequencies);
+    carried = frequencies;
+  }
+
+  return decode(model, model_size, carried, data, data_size, output,
+                output_size);
+}
+
+static Result codec_huffman_encode(const Byte* input, Size input_size,
+                                   const DWord* frequencies, Byte** model,
+                                   Size* model_size, Byte** data,
+                                   Size* data_size)
+{
+  HuffmanTree* tree = huffman_tree_create();
+  if (tree == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = frequencies != NULL
+                    ? huffman_tree_build_from_frequencies(tree, frequencies)
+                    : huffman_tree_build(tree, input, input_size);
+  if (result == RESULT_OK && frequencies == NULL)
+  {
+    result = huffman_serialize_tree(tree, model, model_size);
+  }
+  if (result == RESULT_OK)
+  {
+    result = huffman_compress(input, input_size, data, data_size, tree);
+  }
+
+  huffman_tree_destroy(tree);
+  return result;
+}
+
+static Result codec_huffman_decode(const Byte* model, Size model_size,
+                                   const DWord* frequencies, const Byte* data,
+                                   Size data_size, Byte** output,
+                                   Size* output_size)
+{
+  HuffmanTree* tree = huffman_tree_create();
+  if (tree == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = frequencies != NULL
+                    ? huffman_tree_build_from_frequencies(tree, frequencies)
+                    : huffman_deserialize_tree(tree, model, model_size);
+  if (result == RESULT_OK)
+  {
+    result = huffman_decompress(data, data_size, output, output_size, tree);
+  }
+
+  huffman_tree_destroy(tree);
+  return result;
+}
+
+static Result codec_huffman_compress(const Byte* input, Size input_size,
+                                     const CodecHistory* history,
+                                     Byte** output, Size* output_size)
+{
+  return codec_compress_entropy(input, input_size, history,
+                                codec_huffman_encode, output, output_size);
+}
+
+static Result codec_huffman_decompress(const Byte* input, Size input_size,
+                                       const CodecHistory* history,
+                                       Byte** output, Size* output_size)
+{
+  return codec_decompress_entropy(input, input_size, history,
+                                  codec_huffman_decode, output, output_size);
+}
+
+static Result codec_arithmetic_encode(const Byte* input, Size input_size,
+                                      const DWord* frequencies, Byte** model,
+                                      Size* model_size, Byte** data,
+                                      Size* data_size)
+{
+  ArithmeticModel* arithmetic_model = arithmetic_model_create();
+  if (arithmetic_model == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result =
+    frequencies != NULL
+      ? arithmetic_model_build_from_frequencies(arithmetic_model, frequencies)
+      : arithmetic_model_build(arithmetic_model, input, input_size);
+  if (result == RESULT_OK && frequencies == NULL)
+  {
+    result = arithmetic_serialize_model(arithmetic_model, model, model_size);
+  }
+  if (result == RESULT_OK)
+  {
+    result =
+      arithmetic_compress(input, input_size, data, data_size, arithmetic_model);
+  }
+
+  arithmetic_model_destroy(arithmetic_model);
+  return result;
+}
+
+static Result codec_arithmetic_decode(const Byte* model, Size model_size,
+                                      const DWord* frequencies,
+                                      const Byte* data, Size data_size,
+                                      Byte** output, Size* output_size)
+{
+  ArithmeticModel* arithmetic_model = arithmetic_model_create();
+  if (arithmetic_model == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result =
+    frequencies != NULL
+      ? arithmetic_model_build_from_frequencies(arithmetic_model, frequencies)
+      : arithmetic_deserialize_model(arithmetic_model, model, model_size);
+  if (result == RESULT_OK)
+  {
+    result = arithmetic_decompress(data, data_size, output, output_size,
+                                   arithmetic_model);
+  }
+
+  arithmetic_model_destroy(arithmetic_model);
+  return result;
+}
+
+static Result codec_arithmetic_compress(const Byte* input, Size input_size,
+                                        const CodecHistory* history,
+                                        Byte** output, Size* output_size)
+{
+  return codec_compress_entropy(input, input_size, history,
+                                codec_arithmetic_encode, output, output_size);
+}
+
+static Result codec_arithmetic_decompress(const Byte* input, Size input_size,
+                                          const CodecHistory* history,
+                                          Byte** output, Size* output_size)
+{
+  return codec_decompress_entropy(input, input_size, history,
+                                  codec_arithmetic_decode, output,
+                                  output_size);
+}
+
+static Result codec_shannon_encode(const Byte* input, Size input_size,
+                                   const DWord* frequencies, Byte** model,
+                                   Size* model_size, Byte** data,
+                                   Size* data_size)
+{
+  ShannonTree* tree = shannon_tree_create();
+  if (tree == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = frequencies != NULL
+                    ? shannon_tree_build_from_frequencies(tree, frequencies)
+                    : shannon_tree_build(tree, input, input_size);
+  if (result == RESULT_OK && frequencies == NULL)
+  {
+    result = shannon_serialize_tree(tree, model, model_size);
+  }
+  if (result == RESULT_OK)
+  {
+    result = shannon_compress(input, input_size, data, data_size, tree);
+  }
+
+  shannon_tree_destroy(tree);
+  return result;
+}
+
+static Result codec_shannon_decode(const Byte* model, Size model_size,
+                                   const DWord* frequencies, const Byte* data,
+                                   Size data_size, Byte** output,
+                                   Size* output_size)
+{
+  ShannonTree* tree = shannon_tree_create();
+  if (tree == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = frequencies != NULL
+                    ? shannon_tree_build_from_frequencies(tree, frequencies)
+                    : shannon_deserialize_tree(tree, model, model_size);
+  if (result == RESULT_OK)
+  {
+    result = shannon_decompress(data, data_size, output, output_size, tree);
+  }
+
+  shannon_tree_destroy(tree);
+  return result;
+}
+
+static Result codec_shannon_compress(const Byte* input, Size input_size,
+                                     const CodecHistory* history,
+                                     Byte** output, Size* output_size)
+{
+  return codec_compress_entropy(input, input_size, history,
+                                codec_shannon_encode, output, output_size);
+}
+
+static Result codec_shannon_decompress(const Byte* input, Size input_size,
+                                       const CodecHistory* history,
+                                       Byte** output, Size* output_size)
+{
+  return codec_decompress_entropy(input, input_size, history,
+                                  codec_shannon_decode, output, output_size);
+}
+
+static Result codec_rle_compress_format(const Byte* input, Size input_size,
+                                        Byte** output, Size* output_size,
+                                        RLEFormat format)
+{
+  RLEContext* context = rle_create(rle_analyze_prefix(input, input_size));
+  if (context == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Byte* model = NULL;
+  Size model_size = 0;
+  Byte* data = NULL;
+  Size data_size = 0;
+
+  Result result = rle_set_format(context, format);
+  if (result == RESULT_OK)
+  {
+    result = rle_serialize_context(context, &model, &model_size);
+  }
+  if (result == RESULT_OK)
+  {
+    result = rle_compress(input, input_size, &data, &data_size, context);
+  }
+  rle_destroy(context);
+
+  if (result != RESULT_OK)
+  {
+    free(model);
+    free(data);
+    return result;
+  }
+
+  return codec_pack(model, model_size, data, data_size, output, output_size);
+}
+
+static Result codec_rle_compress(const Byte* input, Size input_size,
+                                 const CodecHistory* history, Byte** output,
+                                 Size* output_size)
+{
+  (void)history;
+  return codec_rle_compress_format(input, input_size, output, output_size,
+                                   RLE_FORMAT_CLASSIC);
+}
+
+static Result codec_rle_varint_compress(const Byte* input, Size input_size,
+                                        const CodecHistory* history,
+                                        Byte** output, Size* output_size)
+{
+  (void)history;
+  return codec_rle_compress_format(input, input_size, output, output_size,
+                                   RLE_FORMAT_VARINT);
+}
+
+static Result codec_rle_decompress(const Byte* input, Size input_size,
+                                   const CodecHistory* history, Byte** output,
+                                   Size* output_size)
+{
+  (void)history;
+  const Byte* model;
+  const Byte* data;
+  Size model_size;
+  Size data_size;
+  Result result =
+    codec_unpack(input, input_size, &model, &model_size, &data, &data_size);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  RLEContext* context = rle_create(0);
+  if (context == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  result = rle_deserialize_context(context, model, model_size);
+  if (result == RESULT_OK)
+  {
+    result = rle_decompress(data, data_size, output, output_size, context);
+  }
+
+  rle_destroy(context);
+  return result;
+}
+
+// Окно LZ77 продолжается из предыдущих блоков потока
+static Result codec_lz77_compress(const Byte* input, Size input_size,
+                                  const CodecHistory* history, Byte** output,
+                                  Size* output_size)
+{
+  Byte* model = (Byte*)malloc(1);
+  Size capacity = lz77_compress_bound(input_size);
+  Byte* data = (Byte*)malloc(capacity);
+  if (model == NULL || data == NULL)
+  {
+    free(model);
+    free(data);
+    return RESULT_MEMORY_ERROR;
+  }
+  model[0] = lz77_analyze_prefix(input, input_size);
+
+  Size data_size = 0;
+  Result result = lz77_compress_into_with_dictionary(
+    input, input_size, history->window, history->window_size, data, capacity,
+    &data_size, model[0]);
+  if (result != RESULT_OK)
+  {
+    free(model);
+    free(data);
+    return result;
+  }
+
+  return codec_pack(model, 1, data, data_size, output, output_size);
+}
+
+static Result codec_lz77_decompress(const Byte* input, Size input_size,
+                                    const CodecHistory* history, Byte** output,
+                                    Size* output_size)
+{
+  const Byte* model;
+  const Byte* data;
+  Size model_size;
+  Size data_size;
+  Result result =
+    codec_unpack(input, input_size, &model, &model_size, &data, &data_size);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  if (model_size != 1)
+  {
+    return RESULT_ERROR;
+  }
+
+  Byte* decompressed = (Byte*)malloc(*output_size);
+  if (decompressed == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  result = lz77_decompress_into_with_dictionary(
+    data, data_size, history->window, history->window_size, decompressed,
+    output_size, model[0]);
+  if (result != RESULT_OK)
+  {
+    free(decompressed);
+    return result;
+  }
+
+  *output = decompressed;
+  return RESULT_OK;
+}
+
+static Result codec_lz78_compress(const Byte* input, Size input_size,
+                                  const CodecHistory* history, Byte** output,
+                                  Size* output_size)
+{
+  (void)history;
+  Byte* data = NULL;
+  Size data_size = 0;
+  Result result = lz78_compress(input, input_size, &data, &data_size);
+  if (result != RESULT_OK)
+  {
+    free(data);
+    return result;
+  }
+
+  return codec_pack(NULL, 0, data, data_size, output, output_size);
+}
+
+static Result codec_lz78_decompress(const Byte* input, Size input_size,
+                                    const CodecHistory* history, Byte** output,
+                                    Size* output_size)
+{
+  (void)history;
+  const Byte* model;
+  const Byte* data;
+  Size model_size;
+  Size data_size;
+  Result result =
+    codec_unpack(input, input_size, &model, &model_size, &data, &data_size);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  return lz78_decompress(data, data_size, output, output_size);
+}
+
+// Окно LZH продолжается из предыдущих блоков потока
+static Result codec_lzh_compress(const Byte* input, Size input_size,
+                                 const CodecHistory* history, Byte** output,
+                                 Size* output_size)
+{
+  Byte* data = NULL;
+  Size data_size = 0;
+  Result result = lzh_compress_with_dictionary(
+    input, input_size, history->window, history->window_size, &data,
+    &data_size, LZH_LEVEL_DEFAULT);
+  if (result != RESULT_OK)
+  {
+    free(data);
+    return result;
+  }
+
+  return codec_pack(NULL, 0, data, data_size, output, output_size);
+}
+
+static Result codec_lzh_decompress(const Byte* input, Size input_size,
+                                   const CodecHistory* history, Byte** output,
+                                   Size* output_size)
+{
+  const Byte* model;
+  const Byte* data;
+  Size model_size;
+  Size data_size;
+  Result result =
+    codec_unpack(input, input_size, &model, &model_size, &data, &data_size);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  Byte* decompressed = (Byte*)malloc(*output_size);
+  if (decompressed == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  result = lzh_decompress_into_with_dictionary(
+    data, data_size, history->window, history->window_size, decompressed,
+    output_size);
+  if (result != RESULT_OK)
+  {
+    free(decompressed);
+    return result;
+  }
+
+  *output = decompressed;
+  return RESULT_OK;
+}
+
+static const Codec codecs[] = {
+  {"none", &codec_framed_encoder, &codec_framed_decoder, NULL, NULL},
+  {"huffman", &codec_framed_encoder, &codec_framed_decoder,
+   codec_huffman_compress, codec_huffman_decompress},
+  {"arithmetic", &codec_framed_encoder, &codec_framed_decoder,
+   codec_arithmetic_compress, codec_arithmetic_decompress},
+  {"shannon", &codec_framed_encoder, &codec_framed_decoder,
+   codec_shannon_compress, codec_shannon_decompress},
+  {"rle", &codec_framed_encoder, &codec_framed_decoder, codec_rle_compress,
+   codec_rle_decompress},
+  {"rle-varint", &codec_framed_encoder, &codec_framed_decoder,
+   codec_rle_varint_compress, codec_rle_decompress},
+  {"lz77", &codec_framed_encoder, &codec_framed_decoder, codec_lz77_compress,
+   codec_lz77_decompress},
+  {"lz78", &codec_framed_encoder, &codec_framed_decoder, codec_lz78_compress,
+   codec_lz78_decompress},
+  {"lzh", &codec_framed_encoder, &codec_framed_decoder, codec_lzh_compress,
+   codec_lzh_decompress},
+};
+
+Size codec_count(void)
+{
+  return sizeof(codecs) / sizeof(codecs[0]);
+}
+
+const Codec* codec_get(Size index)
+{
+  return index < codec_count() ? &codecs[index] : NULL;
+}
+
+const Codec* codec_find(const char* name)
+{
+  if (name == NULL)
+  {
+    return NULL;
+  }
+
+  for (Size i = 0; i < codec_count(); i++)
+  {
+    if (strcmp(codecs[i].name, name) == 0)
+    {
+      return &codecs[i];
+    }
+  }
+
+  LOG_DEBUG("[CODEC] Неизвестный кодек: %s\n", name);
+  return NULL;
+}
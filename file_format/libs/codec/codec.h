@@ -0,0 +1,102 @@
+#ifndef CODEC_CODEC_H
+#define CODEC_CODEC_H
+
+#include <stdbool.h>
+
+#include "types.h"
+
+// Потоковый интерфейс поверх блочных кодеков. Вход режется на блоки
+// фиксированного размера, каждый блок пишется кадром:
+//   [DWord raw_size][DWord packed_size][DWord crc32][Byte flags][payload]
+// Полезная нагрузка сжатого кадра - [DWord model_size][модель][данные].
+// Кадры не самодостаточны: кодер и декодер ведут одинаковую историю
+// потока (CodecHistory), и блок сжимается с ее учетом. Поэтому кадры
+// декодируются только по порядку, начиная с первого.
+// Поток завершается пустым кадром с флагом CODEC_FRAME_END.
+#define CODEC_FRAME_HEADER_SIZE 13
+#define CODEC_FRAME_STORED 0x01  // Блок сохранен без сжатия
+#define CODEC_FRAME_END 0x02     // Последний кадр потока
+
+#define CODEC_STREAM_DEFAULT_BLOCK_SIZE (256 * 1024)
+#define CODEC_STREAM_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+// Окно истории покрывает окна LZ77 и LZH
+#define CODEC_HISTORY_WINDOW_SIZE (32 * 1024)
+#define CODEC_HISTORY_SYMBOLS 256
+
+typedef struct CodecStream CodecStream;
+
+typedef enum
+{
+  CODEC_DIRECTION_ENCODE,
+  CODEC_DIRECTION_DECODE
+} CodecDirection;
+
+// Буферы принадлежат вызывающему коду. process забирает из input сколько
+// может (*consumed) и пишет в output не больше output_capacity байт
+// (*produced); если выход заполнен, вызов повторяется с тем же остатком.
+// end дописывает хвост потока и вызывается, пока *finished не станет true
+typedef struct
+{
+  Result (*begin)(CodecStream* stream);
+  Result (*process)(CodecStream* stream, const Byte* input, Size input_size,
+                    Size* consumed, Byte* output, Size output_capacity,
+                    Size* produced);
+  Result (*end)(CodecStream* stream, Byte* output, Size output_capacity,
+                Size* produced, bool* finished);
+} CodecStreamOps;
+
+// Состояние, которое кодер и декодер получают из уже пройденных блоков
+// (сжатых и сохраненных как есть): хвост данных для окон LZ77 и LZH и
+// частоты байтов, у которых вклад старых блоков убывает вдвое с каждым
+// новым. Энтропийные кодеки (huffman, arithmetic, shannon) сжимают блок
+// моделью по этим частотам, если это не хуже собственной модели блока, и
+// тогда модель в кадр не пишется (model_size == 0). LZ78 и RLE начинают
+// каждый блок заново
+typedef struct
+{
+  const Byte* window;
+  Size window_size;
+  const DWord* frequencies;  // NULL до первого блока
+} CodecHistory;
+
+// Сжатие целого блока с учетом истории потока. *output выделяется через
+// malloc
+typedef Result (*CodecCompressBlock)(const Byte* input, Size input_size,
+                                     const CodecHistory* history,
+                                     Byte** output, Size* output_size);
+// *output_size на входе - точный размер исходного блока
+typedef Result (*CodecDecompressBlock)(const Byte* input, Size input_size,
+                                       const CodecHistory* history,
+                                       Byte** output, Size* output_size);
+
+typedef struct
+{
+  const char* name;
+  const CodecStreamOps* encoder;
+  const CodecStreamOps* decoder;
+  CodecCompressBlock compress_block;  // NULL - блоки всегда хранятся как есть
+  CodecDecompressBlock decompress_block;
+} Codec;
+
+Size codec_count(void);
+const Codec* codec_get(Size index);
+const Codec* codec_find(const char* name);
+
+// block_size == 0 выбирает CODEC_STREAM_DEFAULT_BLOCK_SIZE
+CodecStream* codec_stream_create(const Codec* codec, CodecDirection direction,
+                                 Size block_size);
+void codec_stream_destroy(CodecStream* stream);
+
+Result codec_stream_begin(CodecStream* stream);
+Result codec_stream_process(CodecStream* stream, const Byte* input,
+                            Size input_size, Size* consumed, Byte* output,
+                            Size output_capacity, Size* produced);
+Result codec_stream_end(CodecStream* stream, Byte* output,
+                        Size output_capacity, Size* produced, bool* finished);
+
+// Реализация кадрирования, общая для всех кодеков таблицы
+extern const CodecStreamOps codec_framed_encoder;
+extern const CodecStreamOps codec_framed_decoder;
+
+#endif  // CODEC_CODEC_H
@@ -0,0 +1,622 @@
+#include "codec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "log.h"
+
+typedef enum
+{
+  CODEC_DECODE_HEADER,
+  CODEC_DECODE_PAYLOAD,
+  CODEC_DECODE_DONE
+} CodecDecodeState;
+
+struct CodecStream
+{
+  const Codec* codec;
+  const CodecStreamOps* ops;
+  Size block_size;
+  CRC32Table* crc32_table;
+  bool started;
+
+  // Кодер: накапливаемый блок. Декодер: полезная нагрузка кадра
+  Byte* block;
+  Size block_fill;
+  Size block_capacity;
+
+  // Готовые байты, которые еще не поместились в выход вызывающего кода
+  Byte* pending;
+  Size pending_size;
+  Size pending_position;
+
+  // Декодер: заголовок текущего кадра
+  Byte header[CODEC_FRAME_HEADER_SIZE];
+  Size header_fill;
+  DWord frame_raw_size;
+  DWord frame_packed_size;
+  DWord frame_crc32;
+  Byte frame_flags;
+  CodecDecodeState decode_state;
+
+  bool end_written;
+
+  // История потока, одинаковая у кодера и декодера
+  Byte* history_window;
+  Size history_size;
+  DWord history_frequencies[CODEC_HISTORY_SYMBOLS];
+  bool history_known;
+};
+
+static void codec_stream_write_dword(Byte* data, DWord value)
+{
+  data[0] = (Byte)value;
+  data[1] = (Byte)(value >> 8);
+  data[2] = (Byte)(value >> 16);
+  data[3] = (Byte)(value >> 24);
+}
+
+static DWord codec_stream_read_dword(const Byte* data)
+{
+  return (DWord)data[0] | (DWord)data[1] << 8 | (DWord)data[2] << 16 |
+         (DWord)data[3] << 24;
+}
+
+static DWord codec_stream_crc32(CodecStream* stream, const Byte* data,
+                                Size size)
+{
+  if (size == 0 ||
+      crc32_table_calculate(stream->crc32_table, data, size) != RESULT_OK)
+  {
+    return 0;
+  }
+
+  return crc32_table_get_crc32(stream->crc32_table);
+}
+
+static Result codec_stream_reset_history(CodecStream* stream)
+{
+  if (stream->history_window == NULL)
+  {
+    stream->history_window = (Byte*)malloc(CODEC_HISTORY_WINDOW_SIZE);
+    if (stream->history_window == NULL)
+    {
+      LOG_ERROR("[CODEC] Ошибка выделения памяти для истории!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+  }
+
+  stream->history_size = 0;
+  memset(stream->history_frequencies, 0,
+         sizeof(stream->history_frequencies));
+  stream->history_known = false;
+  return RESULT_OK;
+}
+
+// Добавляет пройденный блок в историю: кодер - после сжатия, декодер -
+// после проверки CRC, поэтому обе стороны видят одни и те же данные
+static void codec_stream_remember(CodecStream* stream, const Byte* data,
+                                  Size size)
+{
+  if (size == 0)
+  {
+    return;
+  }
+
+  DWord counts[CODEC_HISTORY_SYMBOLS] = {0};
+  for (Size i = 0; i < size; i++)
+  {
+    counts[data[i]]++;
+  }
+  for (Size i = 0; i < CODEC_HISTORY_SYMBOLS; i++)
+  {
+    stream->history_frequencies[i] =
+      stream->history_frequencies[i] / 2 + counts[i];
+  }
+  stream->history_known = true;
+
+  if (size >= CODEC_HISTORY_WINDOW_SIZE)
+  {
+    memcpy(stream->history_window, data + size - CODEC_HISTORY_WINDOW_SIZE,
+           CODEC_HISTORY_WINDOW_SIZE);
+    stream->history_size = CODEC_HISTORY_WINDOW_SIZE;
+    return;
+  }
+
+  Size keep = CODEC_HISTORY_WINDOW_SIZE - size;
+  if (keep > stream->history_size)
+  {
+    keep = stream->history_size;
+  }
+  memmove(stream->history_window,
+          stream->history_window + stream->history_size - keep, keep);
+  memcpy(stream->history_window + keep, data, size);
+  stream->history_size = keep + size;
+}
+
+static CodecHistory codec_stream_history(const CodecStream* stream)
+{
+  CodecHistory history = {
+    stream->history_window, stream->history_size,
+    stream->history_known ? stream->history_frequencies : NULL};
+  return history;
+}
+
+// Переносит готовые байты в выход; true, если очередь опустела
+static bool codec_stream_drain(CodecStream* stream, Byte* output,
+                               Size output_capacity, Size* produced)
+{
+  Size available = stream->pending_size - stream->pending_position;
+  Size space = output_capacity - *produced;
+  Size count = available < space ? available : space;
+
+  if (count > 0)
+  {
+    memcpy(output + *produced, stream->pending + stream->pending_position,
+           count);
+    stream->pending_position += count;
+    *produced += count;
+  }
+
+  if (stream->pending_position == stream->pending_size)
+  {
+    free(stream->pending);
+    stream->pending = NULL;
+    stream->pending_size = 0;
+    stream->pending_position = 0;
+    return true;
+  }
+
+  return false;
+}
+
+CodecStream* codec_stream_create(const Codec* codec, CodecDirection direction,
+                                 Size block_size)
+{
+  if (codec == NULL || block_size > CODEC_STREAM_MAX_BLOCK_SIZE)
+  {
+    return NULL;
+  }
+
+  CodecStream* stream = (CodecStream*)malloc(sizeof(CodecStream));
+  if (stream == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  memset(stream, 0, sizeof(CodecStream));
+  stream->codec = codec;
+  stream->ops =
+    direction == CODEC_DIRECTION_ENCODE ? codec->encoder : codec->decoder;
+  stream->block_size =
+    block_size ? block_size : CODEC_STREAM_DEFAULT_BLOCK_SIZE;
+
+  stream->crc32_table = crc32_table_create();
+  if (stream->crc32_table == NULL)
+  {
+    free(stream);
+    return NULL;
+  }
+
+  return stream;
+}
+
+void codec_stream_destroy(CodecStream* stream)
+{
+  if (stream == NULL)
+  {
+    return;
+  }
+
+  crc32_table_destroy(stream->crc32_table);
+  free(stream->history_window);
+  free(stream->block);
+  free(stream->pending);
+  free(stream);
+}
+
+Result codec_stream_begin(CodecStream* stream)
+{
+  if (stream == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  stream->started = true;
+  return stream->ops->begin(stream);
+}
+
+Result codec_stream_process(CodecStream* stream, const Byte* input,
+                            Size input_size, Size* consumed, Byte* output,
+                            Size output_capacity, Size* produced)
+{
+  if (stream == NULL || !stream->started || (input == NULL && input_size) ||
+      consumed == NULL || (output == NULL && output_capacity) ||
+      produced == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  *consumed = 0;
+  *produced = 0;
+  return stream->ops->process(stream, input, input_size, consumed, output,
+                              output_capacity, produced);
+}
+
+Result codec_stream_end(CodecStream* stream, Byte* output,
+                        Size output_capacity, Size* produced, bool* finished)
+{
+  if (stream == NULL || !stream->started ||
+      (output == NULL && output_capacity) || produced == NULL ||
+      finished == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  *produced = 0;
+  *finished = false;
+  return stream->ops->end(stream, output, output_capacity, produced, finished);
+}
+
+static Result codec_framed_encode_begin(CodecStream* stream)
+{
+  free(stream->block);
+  free(stream->pending);
+
+  stream->block = (Byte*)malloc(stream->block_size);
+  if (stream->block == NULL)
+  {
+    LOG_ERROR("[CODEC] Ошибка выделения памяти для блока!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  stream->block_fill = 0;
+  stream->block_capacity = stream->block_size;
+  stream->pending = NULL;
+  stream->pending_size = 0;
+  stream->pending_position = 0;
+  stream->end_written = false;
+  return codec_stream_reset_history(stream);
+}
+
+// Сжимает накопленный блок в кадр и ставит его в очередь вывода. Если
+// кодек не справился или не выиграл в размере, блок хранится как есть
+static Result codec_framed_encode_block(CodecStream* stream, Byte flags)
+{
+  Size raw_size = stream->block_fill;
+  Byte* packed = NULL;
+  Size packed_size = 0;
+
+  if (raw_size > 0 && stream->codec->compress_block != NULL)
+  {
+    CodecHistory history = codec_stream_history(stream);
+    Result result = stream->codec->compress_block(
+      stream->block, raw_size, &history, &packed, &packed_size);
+    if (result != RESULT_OK || packed_size >= raw_size)
+    {
+      LOG_DEBUG("[CODEC] %s: блок %zu байт сохранен без сжатия\n",
+                stream->codec->name, raw_size);
+      free(packed);
+      packed = NULL;
+    }
+  }
+
+  const Byte* payload = packed;
+  if (packed == NULL)
+  {
+    payload = stream->block;
+    packed_size = raw_size;
+    if (raw_size > 0)
+    {
+      flags |= CODEC_FRAME_STORED;
+    }
+  }
+
+  stream->pending = (Byte*)malloc(CODEC_FRAME_HEADER_SIZE + packed_size);
+  if (stream->pending == NULL)
+  {
+    free(packed);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  codec_stream_write_dword(stream->pending, (DWord)raw_size);
+  codec_stream_write_dword(stream->pending + 4, (DWord)packed_size);
+  codec_stream_write_dword(stream->pending + 8,
+                           codec_stream_crc32(stream, stream->block, raw_size));
+  stream->pending[12] = flags;
+  if (packed_size > 0)
+  {
+    memcpy(stream->pending + CODEC_FRAME_HEADER_SIZE, payload, packed_size);
+  }
+
+  stream->pending_size = CODEC_FRAME_HEADER_SIZE + packed_size;
+  stream->pending_position = 0;
+  codec_stream_remember(stream, stream->block, raw_size);
+  stream->block_fill = 0;
+
+  LOG_TRACE("[CODEC] %s: кадр %zu -> %zu байт\n", stream->codec->name,
+            raw_size, packed_size);
+
+  free(packed);
+  return RESULT_OK;
+}
+
+static Result codec_framed_encode_process(CodecStream* stream,
+                                          const Byte* input, Size input_size,
+                                          Size* consumed, Byte* output,
+                                          Size output_capacity, Size* produced)
+{
+  if (stream->end_written)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  while (true)
+  {
+    if (!codec_stream_drain(stream, output, output_capacity, produced))
+    {
+      return RESULT_OK;
+    }
+
+    if (*consumed == input_size)
+    {
+      return RESULT_OK;
+    }
+
+    Size space = stream->block_capacity - stream->block_fill;
+    Size count = input_size - *consumed;
+    if (count > space)
+    {
+      count = space;
+    }
+
+    memcpy(stream->block + stream->block_fill, input + *consumed, count);
+    stream->block_fill += count;
+    *consumed += count;
+
+    if (stream->block_fill == stream->block_capacity)
+    {
+      Result result = codec_framed_encode_block(stream, 0);
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+    }
+  }
+}
+
+static Result codec_framed_encode_end(CodecStream* stream, Byte* output,
+                                      Size output_capacity, Size* produced,
+                                      bool* finished)
+{
+  while (true)
+  {
+    if (!codec_stream_drain(stream, output, output_capacity, produced))
+    {
+      return RESULT_OK;
+    }
+
+    if (stream->end_written)
+    {
+      *finished = true;
+      return RESULT_OK;
+    }
+
+    // Хвостовой блок уходит отдельным кадром, за ним - пустой кадр конца
+    Byte flags = stream->block_fill > 0 ? 0 : CODEC_FRAME_END;
+    Result result = codec_framed_encode_block(stream, flags);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+
+    stream->end_written = flags == CODEC_FRAME_END;
+  }
+}
+
+static Result codec_framed_decode_begin(CodecStream* stream)
+{
+  free(stream->block);
+  free(stream->pending);
+
+  stream->block = NULL;
+  stream->block_fill = 0;
+  stream->block_capacity = 0;
+  stream->pending = NULL;
+  stream->pending_size = 0;
+  stream->pending_position = 0;
+  stream->header_fill = 0;
+  stream->decode_state = CODEC_DECODE_HEADER;
+  return codec_stream_reset_history(stream);
+}
+
+static Result codec_framed_parse_header(CodecStream* stream)
+{
+  stream->frame_raw_size = codec_stream_read_dword(stream->header);
+  stream->frame_packed_size = codec_stream_read_dword(stream->header + 4);
+  stream->frame_crc32 = codec_stream_read_dword(stream->header + 8);
+  stream->frame_flags = stream->header[12];
+  stream->header_fill = 0;
+
+  bool stored = stream->frame_flags & CODEC_FRAME_STORED;
+  if (stream->frame_raw_size > CODEC_STREAM_MAX_BLOCK_SIZE ||
+      (stored && stream->frame_packed_size != stream->frame_raw_size) ||
+      (!stored && stream->frame_packed_size > CODEC_STREAM_MAX_BLOCK_SIZE) ||
+      (stream->frame_flags & ~(CODEC_FRAME_STORED | CODEC_FRAME_END)))
+  {
+    LOG_ERROR("[CODEC] Поврежденный заголовок кадра!\n");
+    return RESULT_ERROR;
+  }
+
+  if (stream->frame_packed_size > stream->block_capacity)
+  {
+    Byte* block = (Byte*)realloc(stream->block, stream->frame_packed_size);
+    if (block == NULL)
+    {
+      return RESULT_MEMORY_ERROR;
+    }
+
+    stream->block = block;
+    stream->block_capacity = stream->frame_packed_size;
+  }
+
+  stream->block_fill = 0;
+  stream->decode_state = CODEC_DECODE_PAYLOAD;
+  return RESULT_OK;
+}
+
+// Восстанавливает блок полностью полученного кадра в очередь вывода
+static Result codec_framed_decode_block(CodecStream* stream)
+{
+  Size raw_size = stream->frame_raw_size;
+  Byte* raw = NULL;
+
+  if (raw_size > 0 && (stream->frame_flags & CODEC_FRAME_STORED))
+  {
+    raw = (Byte*)malloc(raw_size);
+    if (raw == NULL)
+    {
+      return RESULT_MEMORY_ERROR;
+    }
+    memcpy(raw, stream->block, raw_size);
+  }
+  else if (raw_size > 0)
+  {
+    if (stream->codec->decompress_block == NULL)
+    {
+      LOG_ERROR("[CODEC] %s: сжатый кадр не поддерживается кодеком!\n",
+                stream->codec->name);
+      return RESULT_ERROR;
+    }
+
+    Size output_size = raw_size;
+    CodecHistory history = codec_stream_history(stream);
+    Result result = stream->codec->decompress_block(
+      stream->block, stream->block_fill, &history, &raw, &output_size);
+    if (result != RESULT_OK || raw == NULL || output_size != raw_size)
+    {
+      LOG_ERROR("[CODEC] %s: ошибка распаковки кадра!\n", stream->codec->name);
+      free(raw);
+      return RESULT_ERROR;
+    }
+  }
+
+  if (codec_stream_crc32(stream, raw, raw_size) != stream->frame_crc32)
+  {
+    LOG_ERROR("[CODEC] %s: контрольная сумма кадра не совпадает!\n",
+              stream->codec->name);
+    free(raw);
+    return RESULT_ERROR;
+  }
+
+  codec_stream_remember(stream, raw, raw_size);
+  stream->pending = raw;
+  stream->pending_size = raw_size;
+  stream->pending_position = 0;
+  stream->decode_state = (stream->frame_flags & CODEC_FRAME_END)
+                           ? CODEC_DECODE_DONE
+                           : CODEC_DECODE_HEADER;
+  return RESULT_OK;
+}
+
+static Result codec_framed_decode_process(CodecStream* stream,
+                                          const Byte* input, Size input_size,
+                                          Size* consumed, Byte* output,
+                                          Size output_capacity, Size* produced)
+{
+  while (true)
+  {
+    if (!codec_stream_drain(stream, output, output_capacity, produced))
+    {
+      return RESULT_OK;
+    }
+
+    if (*consumed == input_size)
+    {
+      return RESULT_OK;
+    }
+
+    Size available = input_size - *consumed;
+
+    if (stream->decode_state == CODEC_DECODE_DONE)
+    {
+      LOG_ERROR("[CODEC] Данные после последнего кадра потока!\n");
+      return RESULT_ERROR;
+    }
+
+    if (stream->decode_state == CODEC_DECODE_HEADER)
+    {
+      Size count = CODEC_FRAME_HEADER_SIZE - stream->header_fill;
+      if (count > available)
+      {
+        count = available;
+      }
+
+      memcpy(stream->header + stream->header_fill, input + *consumed, count);
+      stream->header_fill += count;
+      *consumed += count;
+
+      if (stream->header_fill < CODEC_FRAME_HEADER_SIZE)
+      {
+        continue;
+      }
+
+      Result result = codec_framed_parse_header(stream);
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+    }
+    else
+    {
+      Size count = stream->frame_packed_size - stream->block_fill;
+      if (count > available)
+      {
+        count = available;
+      }
+
+      memcpy(stream->block + stream->block_fill, input + *consumed, count);
+      stream->block_fill += count;
+      *consumed += count;
+    }
+
+    if (stream->decode_state == CODEC_DECODE_PAYLOAD &&
+        stream->block_fill == stream->frame_packed_size)
+    {
+      Result result = codec_framed_decode_block(stream);
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+    }
+  }
+}
+
+static Result codec_framed_decode_end(CodecStream* stream, Byte* output,
+                                      Size output_capacity, Size* produced,
+                                      bool* finished)
+{
+  if (!codec_stream_drain(stream, output, output_capacity, produced))
+  {
+    return RESULT_OK;
+  }
+
+  if (stream->decode_state != CODEC_DECODE_DONE)
+  {
+    LOG_ERROR("[CODEC] Поток оборван до последнего кадра!\n");
+    return RESULT_ERROR;
+  }
+
+  *finished = true;
+  return RESULT_OK;
+}
+
+const CodecStreamOps codec_framed_encoder = {
+  codec_framed_encode_begin, codec_framed_encode_process,
+  codec_framed_encode_end};
+
+const CodecStreamOps codec_framed_decoder = {
+  codec_framed_decode_begin, codec_framed_decode_process,
+  codec_framed_decode_end};
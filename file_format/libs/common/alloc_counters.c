@@ -0,0 +1,16 @@
+#include "alloc_counters.h"
+
+#include "types.h"
+
+static __thread AllocCounters alloc_counters;
+
+AllocCounters alloc_counters_get(void)
+{
+  return alloc_counters;
+}
+
+void alloc_counters_record(Size size)
+{
+  alloc_counters.allocations++;
+  alloc_counters.bytes += size;
+}
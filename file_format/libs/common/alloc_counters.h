@@ -0,0 +1,18 @@
+#ifndef COMMON_ALLOC_COUNTERS_H
+#define COMMON_ALLOC_COUNTERS_H
+
+#include "types.h"
+
+// Обращения к куче из арены (новый блок) и рабочего буфера (рост).
+// Счетчики у каждого потока свои и только растут: интервал статистики
+// берет их разность. Прямые вызовы malloc в кодеках не учитываются
+typedef struct
+{
+  QWord allocations;
+  QWord bytes;
+} AllocCounters;
+
+AllocCounters alloc_counters_get(void);
+void alloc_counters_record(Size size);
+
+#endif  // COMMON_ALLOC_COUNTERS_H
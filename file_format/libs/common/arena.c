@@ -0,0 +1,166 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc_counters.h"
+#include "types.h"
+
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock
+{
+  struct ArenaBlock* previous;
+  Size capacity;
+  Size used;
+} ArenaBlock;
+
+// Заголовок блока занимает целое число шагов выравнивания, поэтому данные
+// за ним выровнены так же, как результат malloc
+#define ARENA_BLOCK_HEADER_SIZE \
+  ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(Size)(ARENA_ALIGNMENT - 1))
+
+struct Arena
+{
+  ArenaBlock* current;  // Последний блок, цепочка идет к более старым
+  Size block_size;
+};
+
+static Byte* arena_block_data(ArenaBlock* block)
+{
+  return (Byte*)block + ARENA_BLOCK_HEADER_SIZE;
+}
+
+static ArenaBlock* arena_block_create(Size capacity, ArenaBlock* previous)
+{
+  ArenaBlock* block = (ArenaBlock*)malloc(ARENA_BLOCK_HEADER_SIZE + capacity);
+  if (block == NULL)
+  {
+    return NULL;
+  }
+  alloc_counters_record(ARENA_BLOCK_HEADER_SIZE + capacity);
+
+  block->previous = previous;
+  block->capacity = capacity;
+  block->used = 0;
+  return block;
+}
+
+Arena* arena_create(Size block_size)
+{
+  Arena* arena = (Arena*)malloc(sizeof(Arena));
+  if (arena == NULL)
+  {
+    return NULL;
+  }
+
+  arena->current = NULL;
+  arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+  return arena;
+}
+
+void arena_destroy(Arena* arena)
+{
+  if (arena == NULL)
+  {
+    return;
+  }
+
+  while (arena->current != NULL)
+  {
+    ArenaBlock* previous = arena->current->previous;
+    free(arena->current);
+    arena->current = previous;
+  }
+
+  free(arena);
+}
+
+void* arena_alloc(Arena* arena, Size size)
+{
+  if (arena == NULL)
+  {
+    return NULL;
+  }
+
+  Size aligned = (size + ARENA_ALIGNMENT - 1) & ~(Size)(ARENA_ALIGNMENT - 1);
+  if (aligned < size)
+  {
+    return NULL;
+  }
+
+  ArenaBlock* block = arena->current;
+  if (block == NULL || block->capacity - block->used < aligned)
+  {
+    Size capacity = aligned > arena->block_size ? aligned : arena->block_size;
+    block = arena_block_create(capacity, arena->current);
+    if (block == NULL)
+    {
+      return NULL;
+    }
+    arena->current = block;
+  }
+
+  void* pointer = arena_block_data(block) + block->used;
+  block->used += aligned;
+  return pointer;
+}
+
+char* arena_strdup(Arena* arena, const char* string)
+{
+  if (string == NULL)
+  {
+    return NULL;
+  }
+
+  Size length = strlen(string) + 1;
+  char* copy = (char*)arena_alloc(arena, length);
+  if (copy != NULL)
+  {
+    memcpy(copy, string, length);
+  }
+
+  return copy;
+}
+
+ArenaMark arena_mark(const Arena* arena)
+{
+  ArenaMark mark = {NULL, 0};
+  if (arena != NULL && arena->current != NULL)
+  {
+    mark.block = arena->current;
+    mark.used = arena->current->used;
+  }
+
+  return mark;
+}
+
+void arena_rewind(Arena* arena, ArenaMark mark)
+{
+  if (arena == NULL)
+  {
+    return;
+  }
+
+  // Самый старый блок не освобождается даже при откате к пустой отметке,
+  // чтобы циклы "отметка - выделение - откат" не вызывали malloc на каждом
+  // шаге
+  while (arena->current != NULL && arena->current != mark.block &&
+         arena->current->previous != NULL)
+  {
+    ArenaBlock* previous = arena->current->previous;
+    free(arena->current);
+    arena->current = previous;
+  }
+
+  if (arena->current != NULL)
+  {
+    arena->current->used = arena->current == mark.block ? mark.used : 0;
+  }
+}
+
+void arena_reset(Arena* arena)
+{
+  ArenaMark empty = {NULL, 0};
+  arena_rewind(arena, empty);
+}
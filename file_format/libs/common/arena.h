@@ -0,0 +1,37 @@
+#ifndef COMMON_ARENA_H
+#define COMMON_ARENA_H
+
+#include "types.h"
+
+// Арена (bump-аллокатор): память выделяется сдвигом указателя внутри
+// крупных блоков и освобождается только целиком - откатом к отметке,
+// сбросом или уничтожением арены. Подходит для множества мелких объектов
+// с общим временем жизни (пути при обходе дерева, узлы деревьев кодов,
+// фразы словаря LZ78)
+typedef struct Arena Arena;
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+// Отметка для отката: все выделенное после нее освобождается разом
+typedef struct
+{
+  void* block;
+  Size used;
+} ArenaMark;
+
+// block_size == 0 выбирает ARENA_DEFAULT_BLOCK_SIZE
+Arena* arena_create(Size block_size);
+void arena_destroy(Arena* arena);
+
+// Память выровнена для любого скалярного типа и не обнуляется.
+// Запросы больше размера блока получают собственный блок
+void* arena_alloc(Arena* arena, Size size);
+char* arena_strdup(Arena* arena, const char* string);
+
+ArenaMark arena_mark(const Arena* arena);
+void arena_rewind(Arena* arena, ArenaMark mark);
+
+// Освобождает все выделения, оставляя один блок для повторного использования
+void arena_reset(Arena* arena);
+
+#endif  // COMMON_ARENA_H
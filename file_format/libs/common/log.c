@@ -0,0 +1,88 @@
+#include "log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+
+int log_runtime_level = LOG_DEFAULT_LEVEL;
+
+static FILE* log_stream = NULL;
+
+static const char* log_level_names[] = {"trace", "debug", "info",
+                                        "warn",  "error", "off"};
+
+void log_set_level(int level)
+{
+  if (level < LOG_LEVEL_TRACE)
+  {
+    level = LOG_LEVEL_TRACE;
+  }
+  if (level > LOG_LEVEL_OFF)
+  {
+    level = LOG_LEVEL_OFF;
+  }
+
+  log_runtime_level = level;
+}
+
+int log_get_level(void)
+{
+  return log_runtime_level;
+}
+
+int log_level_from_name(const char* name)
+{
+  if (!name)
+  {
+    return -1;
+  }
+
+  for (int level = LOG_LEVEL_TRACE; level <= LOG_LEVEL_OFF; level++)
+  {
+    if (strcmp(name, log_level_names[level]) == 0)
+    {
+      return level;
+    }
+  }
+
+  return -1;
+}
+
+void log_set_stream(FILE* stream)
+{
+  log_stream = stream;
+}
+
+FILE* log_get_stream(void)
+{
+  return log_stream ? log_stream : stdout;
+}
+
+void log_write(const char* format, ...)
+{
+  va_list arguments;
+  va_start(arguments, format);
+  vfprintf(log_get_stream(), format, arguments);
+  va_end(arguments);
+}
+
+void log_dump(const char* title, const Byte* data, Size size, Size limit)
+{
+  FILE* stream = log_get_stream();
+  Size count = size < limit ? size : limit;
+
+  fprintf(stream, "%s: ", title);
+  for (Size i = 0; i < count; i++)
+  {
+    fprintf(stream, "%02X ", data[i]);
+  }
+
+  fprintf(stream, "(");
+  for (Size i = 0; i < count; i++)
+  {
+    fputc(data[i] >= 32 && data[i] <= 126 ? data[i] : '.', stream);
+  }
+  fprintf(stream, ")\n");
+}
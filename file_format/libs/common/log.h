@@ -0,0 +1,77 @@
+#ifndef COMMON_LOG_H
+#define COMMON_LOG_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "types.h"
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// Минимальный уровень, попадающий в сборку (задается из CMake через
+// FILE_FORMAT_LOG_LEVEL). Вызовы ниже порога превращаются в if (0) и
+// удаляются компилятором вместе с вычислением аргументов, но аргументы
+// по-прежнему проверяются на соответствие формату.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+
+// Текущий уровень времени выполнения. Читается напрямую в макросах, чтобы
+// отключенный вызов стоил одно сравнение без вызова функции.
+extern int log_runtime_level;
+
+void log_set_level(int level);
+int log_get_level(void);
+
+// Возвращает уровень по имени (trace, debug, info, warn, error, off)
+// или -1, если имя неизвестно
+int log_level_from_name(const char* name);
+
+// Поток вывода журнала, по умолчанию stdout
+void log_set_stream(FILE* stream);
+FILE* log_get_stream(void);
+
+void log_write(const char* format, ...)
+  __attribute__((format(printf, 1, 2)));
+
+// Выводит "title: XX XX ... (текст)" для первых limit байт data
+void log_dump(const char* title, const Byte* data, Size size, Size limit);
+
+#define LOG_IS_ENABLED(level) \
+  ((level) >= LOG_COMPILE_LEVEL && (level) >= log_runtime_level)
+
+#define LOG_AT(level, ...)     \
+  do                           \
+  {                            \
+    if (LOG_IS_ENABLED(level)) \
+    {                          \
+      log_write(__VA_ARGS__);  \
+    }                          \
+  } while (0)
+
+#define LOG_DUMP_AT(level, ...) \
+  do                            \
+  {                             \
+    if (LOG_IS_ENABLED(level))  \
+    {                           \
+      log_dump(__VA_ARGS__);    \
+    }                           \
+  } while (0)
+
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#define LOG_TRACE_DUMP(...) LOG_DUMP_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG_DUMP(...) LOG_DUMP_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif  // COMMON_LOG_H
@@ -0,0 +1,43 @@
+#include "scratch.h"
+
+#include <stdlib.h>
+
+#include "alloc_counters.h"
+#include "types.h"
+
+void scratch_init(ScratchBuffer* scratch)
+{
+  scratch->data = NULL;
+  scratch->capacity = 0;
+}
+
+void scratch_free(ScratchBuffer* scratch)
+{
+  free(scratch->data);
+  scratch_init(scratch);
+}
+
+Byte* scratch_reserve(ScratchBuffer* scratch, Size size)
+{
+  if (size == 0)
+  {
+    size = 1;
+  }
+
+  if (scratch->capacity < size)
+  {
+    // realloc копировал бы старое содержимое, которое все равно не нужно
+    Byte* grown = (Byte*)malloc(size);
+    if (grown == NULL)
+    {
+      return NULL;
+    }
+    alloc_counters_record(size);
+
+    free(scratch->data);
+    scratch->data = grown;
+    scratch->capacity = size;
+  }
+
+  return scratch->data;
+}
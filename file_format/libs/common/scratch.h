@@ -0,0 +1,21 @@
+#ifndef COMMON_SCRATCH_H
+#define COMMON_SCRATCH_H
+
+#include "types.h"
+
+// Переиспользуемый рабочий буфер. Растет только при нехватке места, поэтому
+// в установившемся режиме повторные вызовы не обращаются к куче
+typedef struct
+{
+  Byte* data;
+  Size capacity;
+} ScratchBuffer;
+
+void scratch_init(ScratchBuffer* scratch);
+void scratch_free(ScratchBuffer* scratch);
+
+// Возвращает буфер не меньше size байт или NULL при нехватке памяти.
+// Содержимое при росте не сохраняется
+Byte* scratch_reserve(ScratchBuffer* scratch, Size size);
+
+#endif  // COMMON_SCRATCH_H
@@ -0,0 +1,215 @@
+#include "dedup_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "types.h"
+
+#define GEAR_SYMBOLS 256
+// Маски нормализованного разбиения FastCDC для среднего чанка 8 КиБ:
+// до среднего размера граница ставится реже (15 бит), после - чаще (11 бит)
+#define GEAR_MASK_SMALL 0x0003590703530000ULL
+#define GEAR_MASK_LARGE 0x0000d90003530000ULL
+
+#define INITIAL_CAPACITY 1024
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+typedef struct
+{
+  QWord hash;
+  DWord size;  // 0 - пустой слот
+  DedupChunk chunk;
+} Slot;
+
+struct DedupIndex
+{
+  QWord gear[GEAR_SYMBOLS];
+  Slot* slots;
+  Size capacity;  // Степень двойки
+  Size count;
+};
+
+// splitmix64: таблица Gear одинакова во всех сборках
+static QWord next_random(QWord* state)
+{
+  QWord value = (*state += HASH_MULTIPLIER);
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+DedupIndex* dedup_index_create(void)
+{
+  DedupIndex* index = (DedupIndex*)malloc(sizeof(DedupIndex));
+  Slot* slots = (Slot*)calloc(INITIAL_CAPACITY, sizeof(Slot));
+  if (index == NULL || slots == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(index);
+    free(slots);
+    return NULL;
+  }
+
+  QWord state = 0;
+  for (Size i = 0; i < GEAR_SYMBOLS; i++)
+  {
+    index->gear[i] = next_random(&state);
+  }
+  index->slots = slots;
+  index->capacity = INITIAL_CAPACITY;
+  index->count = 0;
+
+  return index;
+}
+
+void dedup_index_destroy(DedupIndex* self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  free(self->slots);
+  free(self);
+}
+
+Size dedup_index_next_chunk(const DedupIndex* self, const Byte* data,
+                            Size size)
+{
+  if (size <= DEDUP_CHUNK_MIN_SIZE)
+  {
+    return size;
+  }
+
+  Size limit = size < DEDUP_CHUNK_MAX_SIZE ? size : DEDUP_CHUNK_MAX_SIZE;
+  Size normal = limit < DEDUP_CHUNK_AVG_SIZE ? limit : DEDUP_CHUNK_AVG_SIZE;
+  QWord fingerprint = 0;
+  Size i = DEDUP_CHUNK_MIN_SIZE;
+
+  for (; i < normal; i++)
+  {
+    fingerprint = (fingerprint << 1) + self->gear[data[i]];
+    if ((fingerprint & GEAR_MASK_SMALL) == 0)
+    {
+      return i + 1;
+    }
+  }
+
+  for (; i < limit; i++)
+  {
+    fingerprint = (fingerprint << 1) + self->gear[data[i]];
+    if ((fingerprint & GEAR_MASK_LARGE) == 0)
+    {
+      return i + 1;
+    }
+  }
+
+  return limit;
+}
+
+// Перемешивание по 8 байт: хеш только выбирает кандидата, совпадение
+// подтверждается сравнением байт
+QWord dedup_index_hash(const Byte* data, Size size)
+{
+  QWord hash = (QWord)size * HASH_MULTIPLIER;
+  Size i = 0;
+
+  for (; i + sizeof(QWord) <= size; i += sizeof(QWord))
+  {
+    QWord word;
+    memcpy(&word, data + i, sizeof(QWord));
+    hash = (hash ^ word) * HASH_MULTIPLIER;
+    hash ^= hash >> 29;
+  }
+
+  for (; i < size; i++)
+  {
+    hash = (hash ^ data[i]) * HASH_MULTIPLIER;
+  }
+
+  return hash ^ (hash >> 32);
+}
+
+const DedupChunk* dedup_index_find(const DedupIndex* self, QWord hash,
+                                   const Byte* data, Size size,
+                                   const Byte* store)
+{
+  if (self == NULL || size == 0)
+  {
+    return NULL;
+  }
+
+  Size mask = self->capacity - 1;
+  for (Size i = hash & mask; self->slots[i].size != 0; i = (i + 1) & mask)
+  {
+    const Slot* slot = &self->slots[i];
+    if (slot->hash == hash && slot->size == size &&
+        memcmp(store + slot->chunk.store_offset, data, size) == 0)
+    {
+      return &slot->chunk;
+    }
+  }
+
+  return NULL;
+}
+
+static void insert_slot(Slot* slots, Size capacity, const Slot* slot)
+{
+  Size mask = capacity - 1;
+  Size i = slot->hash & mask;
+  while (slots[i].size != 0)
+  {
+    i = (i + 1) & mask;
+  }
+  slots[i] = *slot;
+}
+
+// Заполнение держится не выше половины, чтобы цепочки проб были короткими
+static Result grow(DedupIndex* self)
+{
+  Size capacity = self->capacity * 2;
+  Slot* slots = (Slot*)calloc(capacity, sizeof(Slot));
+  if (slots == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  for (Size i = 0; i < self->capacity; i++)
+  {
+    if (self->slots[i].size != 0)
+    {
+      insert_slot(slots, capacity, &self->slots[i]);
+    }
+  }
+
+  free(self->slots);
+  self->slots = slots;
+  self->capacity = capacity;
+  return RESULT_OK;
+}
+
+Result dedup_index_add(DedupIndex* self, QWord hash, Size size,
+                       const DedupChunk* chunk)
+{
+  if (self == NULL || chunk == NULL || size == 0 ||
+      size > DEDUP_CHUNK_MAX_SIZE)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if ((self->count + 1) * 2 > self->capacity)
+  {
+    Result result = grow(self);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+  }
+
+  Slot slot = {hash, (DWord)size, *chunk};
+  insert_slot(self->slots, self->capacity, &slot);
+  self->count++;
+  return RESULT_OK;
+}
@@ -0,0 +1,44 @@
+#ifndef DEDUP_DEDUP_INDEX_H
+#define DEDUP_DEDUP_INDEX_H
+
+#include <stdbool.h>
+
+#include "types.h"
+
+// Дедупликация по содержимому: данные режутся на чанки скользящим хешем
+// Gear (FastCDC с нормализацией размера), поэтому границы чанков
+// сдвигаются вместе со вставками, а повторяющиеся участки разных файлов
+// режутся одинаково. Индекс находит уже встречавшийся чанк по хешу и
+// сверяет байты с хранилищем, так что коллизии хеша не портят данные
+#define DEDUP_CHUNK_MIN_SIZE (2 * 1024)
+#define DEDUP_CHUNK_AVG_SIZE (8 * 1024)
+#define DEDUP_CHUNK_MAX_SIZE (64 * 1024)
+
+typedef struct DedupIndex DedupIndex;
+
+typedef struct
+{
+  DWord entry_index;  // Запись архива, в данных которой лежит чанк
+  QWord offset;  // Смещение в данных записи
+  QWord store_offset;  // Смещение в хранилище, по которому сверяются байты
+} DedupChunk;
+
+DedupIndex* dedup_index_create(void);
+void dedup_index_destroy(DedupIndex* self);
+
+// Длина чанка, начинающегося с data; последний чанк может быть короче
+// DEDUP_CHUNK_MIN_SIZE
+Size dedup_index_next_chunk(const DedupIndex* self, const Byte* data,
+                            Size size);
+
+QWord dedup_index_hash(const Byte* data, Size size);
+
+// NULL, если такого чанка еще не было. Указатель живет до следующего
+// добавления
+const DedupChunk* dedup_index_find(const DedupIndex* self, QWord hash,
+                                   const Byte* data, Size size,
+                                   const Byte* store);
+Result dedup_index_add(DedupIndex* self, QWord hash, Size size,
+                       const DedupChunk* chunk);
+
+#endif  // DEDUP_DEDUP_INDEX_H
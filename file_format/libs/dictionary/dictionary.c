@@ -0,0 +1,328 @@
+#include "dictionary.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "file.h"
+#include "file_list.h"
+#include "log.h"
+#include "types.h"
+
+struct Dictionary
+{
+  DWord frequencies[DICTIONARY_SYMBOLS];
+  Byte window[DICTIONARY_WINDOW_SIZE];
+  Size window_size;
+  DWord hash;  // Заполняется при сохранении и загрузке
+};
+
+Dictionary* dictionary_create(void)
+{
+  Dictionary* dictionary = (Dictionary*)malloc(sizeof(Dictionary));
+  if (dictionary == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  for (Size i = 0; i < DICTIONARY_SYMBOLS; i++)
+  {
+    dictionary->frequencies[i] = 1;
+  }
+  dictionary->window_size = 0;
+  dictionary->hash = 0;
+
+  return dictionary;
+}
+
+void dictionary_destroy(Dictionary* self)
+{
+  free(self);
+}
+
+// Частоты приводятся к сумме около DICTIONARY_FREQUENCY_TOTAL, отсутствующие
+// в образцах байты получают частоту 1
+static void normalize_frequencies(Dictionary* self, const QWord* counts)
+{
+  QWord total = 0;
+  for (Size i = 0; i < DICTIONARY_SYMBOLS; i++)
+  {
+    total += counts[i];
+  }
+
+  for (Size i = 0; i < DICTIONARY_SYMBOLS; i++)
+  {
+    QWord frequency =
+      total > 0 ? counts[i] * DICTIONARY_FREQUENCY_TOTAL / total : 0;
+    self->frequencies[i] = frequency > 0 ? (DWord)frequency : 1;
+  }
+}
+
+Result dictionary_train(Dictionary* self, const FileList* files)
+{
+  if (self == NULL || files == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size file_count = 0;
+  for (Size i = 0; i < file_list_get_count(files); i++)
+  {
+    if (!file_list_is_directory(files, i))
+    {
+      file_count++;
+    }
+  }
+
+  if (file_count == 0)
+  {
+    LOG_ERROR("[DICT] Нет файлов для обучения словаря\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size slice = DICTIONARY_WINDOW_SIZE / file_count;
+  if (slice < DICTIONARY_SLICE_MIN)
+  {
+    slice = DICTIONARY_SLICE_MIN;
+  }
+
+  QWord counts[DICTIONARY_SYMBOLS] = {0};
+  QWord total_size = 0;
+  self->window_size = 0;
+
+  for (Size i = 0; i < file_list_get_count(files); i++)
+  {
+    if (file_list_is_directory(files, i))
+    {
+      continue;
+    }
+
+    const char* path = file_list_get_path(files, i);
+    File* file = file_create(path);
+    if (file == NULL)
+    {
+      return RESULT_MEMORY_ERROR;
+    }
+
+    Result result = file_open_for_read(file);
+    if (result == RESULT_OK)
+    {
+      result = file_read_bytes(file);
+    }
+
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("[DICT] Не удалось прочитать файл: %s\n", path);
+      file_close(file);
+      file_destroy(file);
+      return result;
+    }
+
+    const Byte* data = file_get_buffer(file);
+    Size size = file_get_size(file);
+
+    for (Size j = 0; j < size; j++)
+    {
+      counts[data[j]]++;
+    }
+
+    Size take = size < slice ? size : slice;
+    if (take > DICTIONARY_WINDOW_SIZE - self->window_size)
+    {
+      take = DICTIONARY_WINDOW_SIZE - self->window_size;
+    }
+    memcpy(self->window + self->window_size, data, take);
+    self->window_size += take;
+    total_size += size;
+
+    file_close(file);
+    file_destroy(file);
+  }
+
+  normalize_frequencies(self, counts);
+
+  LOG_INFO("[DICT] Обучено на %zu файлах (%llu байт), окно %zu байт\n",
+           file_count, (unsigned long long)total_size, self->window_size);
+  return RESULT_OK;
+}
+
+static Size serialized_size(const Dictionary* self)
+{
+  return DICTIONARY_HEADER_SIZE + self->window_size;
+}
+
+static void serialize(const Dictionary* self, Byte* data)
+{
+  Byte* cursor = data;
+  memcpy(cursor, DICTIONARY_SIGNATURE, DICTIONARY_SIGNATURE_SIZE);
+  cursor += DICTIONARY_SIGNATURE_SIZE;
+  *cursor++ = DICTIONARY_VERSION;
+  *cursor++ = 0;
+
+  memcpy(cursor, self->frequencies, sizeof(self->frequencies));
+  cursor += sizeof(self->frequencies);
+
+  DWord window_size = (DWord)self->window_size;
+  memcpy(cursor, &window_size, sizeof(DWord));
+  cursor += sizeof(DWord);
+  memcpy(cursor, self->window, self->window_size);
+}
+
+static Result calculate_hash(const Byte* data, Size size, DWord* hash)
+{
+  CRC32Table* crc32_table = crc32_table_create();
+  if (crc32_table == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = crc32_table_calculate(crc32_table, data, size);
+  *hash = crc32_table_get_crc32(crc32_table);
+  crc32_table_destroy(crc32_table);
+  return result;
+}
+
+Result dictionary_save(Dictionary* self, const char* path)
+{
+  if (self == NULL || path == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size size = serialized_size(self);
+  Byte* data = (Byte*)malloc(size);
+  if (data == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  serialize(self, data);
+  Result result = calculate_hash(data, size, &self->hash);
+
+  File* file = result == RESULT_OK ? file_create(path) : NULL;
+  if (file == NULL)
+  {
+    free(data);
+    return result != RESULT_OK ? result : RESULT_MEMORY_ERROR;
+  }
+
+  result = file_open_for_write(file);
+  if (result == RESULT_OK)
+  {
+    result = file_write_bytes(file, data, size);
+  }
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("[DICT] Не удалось записать словарь: %s\n", path);
+  }
+
+  file_close(file);
+  file_destroy(file);
+  free(data);
+  return result;
+}
+
+Dictionary* dictionary_load(const char* path)
+{
+  if (path == NULL)
+  {
+    return NULL;
+  }
+
+  File* file = file_create(path);
+  if (file == NULL)
+  {
+    return NULL;
+  }
+
+  Result result = file_open_for_read(file);
+  if (result == RESULT_OK)
+  {
+    result = file_read_bytes(file);
+  }
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("[DICT] Не удалось прочитать словарь: %s\n", path);
+    file_close(file);
+    file_destroy(file);
+    return NULL;
+  }
+
+  const Byte* data = file_get_buffer(file);
+  Size size = file_get_size(file);
+  Dictionary* dictionary = NULL;
+
+  DWord window_size = 0;
+  if (size >= DICTIONARY_HEADER_SIZE)
+  {
+    memcpy(&window_size, data + DICTIONARY_HEADER_SIZE - sizeof(DWord),
+           sizeof(DWord));
+  }
+
+  if (size < DICTIONARY_HEADER_SIZE ||
+      memcmp(data, DICTIONARY_SIGNATURE, DICTIONARY_SIGNATURE_SIZE) != 0 ||
+      data[DICTIONARY_SIGNATURE_SIZE] != DICTIONARY_VERSION ||
+      window_size > DICTIONARY_WINDOW_SIZE ||
+      size != DICTIONARY_HEADER_SIZE + window_size)
+  {
+    LOG_ERROR("[DICT] Файл не является словарем или поврежден: %s\n", path);
+  }
+  else
+  {
+    dictionary = dictionary_create();
+  }
+
+  if (dictionary != NULL)
+  {
+    memcpy(dictionary->frequencies, data + DICTIONARY_SIGNATURE_SIZE + 2,
+           sizeof(dictionary->frequencies));
+    memcpy(dictionary->window, data + DICTIONARY_HEADER_SIZE, window_size);
+    dictionary->window_size = window_size;
+
+    for (Size i = 0; i < DICTIONARY_SYMBOLS && dictionary != NULL; i++)
+    {
+      if (dictionary->frequencies[i] == 0 ||
+          dictionary->frequencies[i] > DICTIONARY_FREQUENCY_TOTAL)
+      {
+        LOG_ERROR("[DICT] Недопустимая частота в словаре: %s\n", path);
+        dictionary_destroy(dictionary);
+        dictionary = NULL;
+      }
+    }
+  }
+
+  if (dictionary != NULL &&
+      calculate_hash(data, size, &dictionary->hash) != RESULT_OK)
+  {
+    dictionary_destroy(dictionary);
+    dictionary = NULL;
+  }
+
+  file_close(file);
+  file_destroy(file);
+  return dictionary;
+}
+
+DWord dictionary_get_hash(const Dictionary* self)
+{
+  return self ? self->hash : 0;
+}
+
+const DWord* dictionary_get_frequencies(const Dictionary* self)
+{
+  return self ? self->frequencies : NULL;
+}
+
+const Byte* dictionary_get_window(const Dictionary* self)
+{
+  return self ? self->window : NULL;
+}
+
+Size dictionary_get_window_size(const Dictionary* self)
+{
+  return self ? self->window_size : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef DICTIONARY_DICTIONARY_H
+#define DICTIONARY_DICTIONARY_H
+
+#include "file_list.h"
+#include "types.h"
+
+// Словарь, обученный на похожих данных заранее: частоты байт для моделей
+// Хаффмана/арифметического кодирования/Шеннона и окно-затравка для LZH.
+// Архив хранит вместо моделей CRC32 файла словаря, поэтому при распаковке
+// нужен тот же самый файл
+#define DICTIONARY_SIGNATURE "loldic"
+#define DICTIONARY_SIGNATURE_SIZE 6
+#define DICTIONARY_VERSION 1
+#define DICTIONARY_SYMBOLS 256
+#define DICTIONARY_WINDOW_SIZE (32 * 1024)  // Совпадает с окном LZH
+#define DICTIONARY_SLICE_MIN 1024  // Минимальный вклад файла в окно
+// Сумма нормированных частот: коды моделей не длиннее ~24 бит
+#define DICTIONARY_FREQUENCY_TOTAL (1 << 16)
+
+// Формат файла: сигнатура, Byte версии, Byte резерва,
+// DWord частот[DICTIONARY_SYMBOLS], DWord размера окна и само окно
+#define DICTIONARY_HEADER_SIZE                      \
+  (DICTIONARY_SIGNATURE_SIZE + 2 +                  \
+   DICTIONARY_SYMBOLS * sizeof(DWord) + sizeof(DWord))
+
+typedef struct Dictionary Dictionary;
+
+Dictionary* dictionary_create(void);
+void dictionary_destroy(Dictionary* self);
+
+// Частоты считаются по всем файлам списка, окно набирается из начальных
+// участков файлов поровну (не меньше DICTIONARY_SLICE_MIN байт на файл)
+Result dictionary_train(Dictionary* self, const FileList* files);
+
+Result dictionary_save(Dictionary* self, const char* path);
+Dictionary* dictionary_load(const char* path);
+
+// CRC32 сериализованного словаря, по нему архив ссылается на словарь
+DWord dictionary_get_hash(const Dictionary* self);
+// Все частоты ненулевые, поэтому модель кодирует любые данные
+const DWord* dictionary_get_frequencies(const Dictionary* self);
+const Byte* dictionary_get_window(const Dictionary* self);
+Size dictionary_get_window_size(const Dictionary* self);
+
+#endif  // DICTIONARY_DICTIONARY_H
@@ -1,8 +1,8 @@
 #include "crc32.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 
+#include "log.h"
 #include "types.h"
 
 #define ALL_POSSIBLE_BYTES 256
@@ -18,7 +18,7 @@ CRC32Table* crc32_table_create()
   CRC32Table* table = (CRC32Table*)malloc(sizeof(CRC32Table));
   if (table == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
@@ -0,0 +1,638 @@
+#include "directory_walker.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "log.h"
+#include "path_utils.h"
+
+#define INITIAL_CAPACITY 16
+
+typedef struct WalkNode WalkNode;
+
+typedef struct
+{
+  const char* name;
+  bool is_directory;
+  QWord size;
+  QWord mtime;
+  WalkNode* node;  // Узел обходимой поддиректории или NULL
+} WalkChild;
+
+// Директория, найденная при обходе. Дети собираются в порядке readdir и
+// сортируются только при сборке результата
+struct WalkNode
+{
+  const char* path;
+  int fd;  // Открыт через openat родителя или -1 (откроется по пути)
+  WalkChild* children;
+  Size child_count;
+  Size child_capacity;
+};
+
+// Очередь потока: владелец берет с хвоста (обход в глубину, горячий кэш
+// dentry), остальные перехватывают с головы - крупные верхние поддеревья
+typedef struct
+{
+  DirectoryWalker* walker;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  WalkNode** tasks;
+  Size head;
+  Size tail;
+  Size capacity;
+  Arena* arena;  // Узлы, имена и пути, найденные этим потоком
+} WalkWorker;
+
+struct DirectoryWalker
+{
+  WalkWorker* workers;
+  Size thread_count;
+  bool recursive;
+
+  pthread_mutex_t lock;  // Счетчики ниже и result
+  pthread_cond_t wake;
+  Size queued;      // Узлы в очередях
+  Size pending;     // Узлы в очередях и в обработке
+  Size open_count;  // Заранее открытые дескрипторы в очередях
+  Result result;    // Первая ошибка обхода
+
+  DirectoryWalkEntry* entries;
+  Size count;
+  Size capacity;
+  Arena* paths;  // Пути файлов результата
+};
+
+DirectoryWalker* directory_walker_create(Size thread_count)
+{
+  if (thread_count == 0)
+  {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = processors > 0 ? (Size)processors : 1;
+  }
+  if (thread_count > DIRECTORY_WALKER_MAX_THREADS)
+  {
+    thread_count = DIRECTORY_WALKER_MAX_THREADS;
+  }
+
+  DirectoryWalker* walker = (DirectoryWalker*)malloc(sizeof(DirectoryWalker));
+  if (walker == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  walker->workers = (WalkWorker*)calloc(thread_count, sizeof(WalkWorker));
+  walker->thread_count = thread_count;
+  walker->entries = NULL;
+  walker->count = 0;
+  walker->capacity = 0;
+  walker->paths = arena_create(0);
+  pthread_mutex_init(&walker->lock, NULL);
+  pthread_cond_init(&walker->wake, NULL);
+
+  bool allocated = walker->workers != NULL && walker->paths != NULL;
+  for (Size i = 0; allocated && i < thread_count; i++)
+  {
+    WalkWorker* worker = &walker->workers[i];
+    worker->walker = walker;
+    pthread_mutex_init(&worker->lock, NULL);
+    worker->arena = arena_create(0);
+    allocated = worker->arena != NULL;
+  }
+
+  if (!allocated)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    directory_walker_destroy(walker);
+    return NULL;
+  }
+
+  return walker;
+}
+
+void directory_walker_destroy(DirectoryWalker* self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  for (Size i = 0; self->workers != NULL && i < self->thread_count; i++)
+  {
+    WalkWorker* worker = &self->workers[i];
+    if (worker->walker == NULL)
+    {
+      break;  // Создание прервалось на этом потоке
+    }
+
+    pthread_mutex_destroy(&worker->lock);
+    free(worker->tasks);
+    arena_destroy(worker->arena);
+  }
+
+  pthread_cond_destroy(&self->wake);
+  pthread_mutex_destroy(&self->lock);
+  free(self->workers);
+  free(self->entries);
+  arena_destroy(self->paths);
+  free(self);
+}
+
+static void walker_set_result(DirectoryWalker* self, Result result)
+{
+  pthread_mutex_lock(&self->lock);
+  if (self->result == RESULT_OK)
+  {
+    self->result = result;
+  }
+  pthread_mutex_unlock(&self->lock);
+}
+
+// Счетчики увеличиваются до вставки: иначе перехвативший узел поток мог бы
+// обнулить pending раньше, чем он учтен, и остальные завершились бы
+static Result worker_push(WalkWorker* worker, WalkNode* node)
+{
+  DirectoryWalker* walker = worker->walker;
+  pthread_mutex_lock(&walker->lock);
+  walker->queued++;
+  walker->pending++;
+  pthread_mutex_unlock(&walker->lock);
+
+  pthread_mutex_lock(&worker->lock);
+  Result result = RESULT_OK;
+  if (worker->tail == worker->capacity && worker->head > 0)
+  {
+    Size count = worker->tail - worker->head;
+    memmove(worker->tasks, worker->tasks + worker->head,
+            count * sizeof(WalkNode*));
+    worker->head = 0;
+    worker->tail = count;
+  }
+
+  if (worker->tail == worker->capacity)
+  {
+    Size new_capacity =
+      worker->capacity > 0 ? worker->capacity * 2 : INITIAL_CAPACITY;
+    WalkNode** new_tasks =
+      (WalkNode**)realloc(worker->tasks, new_capacity * sizeof(WalkNode*));
+    if (new_tasks == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при расширении памяти!\n");
+      result = RESULT_MEMORY_ERROR;
+    }
+    else
+    {
+      worker->tasks = new_tasks;
+      worker->capacity = new_capacity;
+    }
+  }
+
+  if (result == RESULT_OK)
+  {
+    worker->tasks[worker->tail++] = node;
+  }
+  pthread_mutex_unlock(&worker->lock);
+
+  pthread_mutex_lock(&walker->lock);
+  if (result != RESULT_OK)
+  {
+    walker->queued--;
+    walker->pending--;
+  }
+  pthread_cond_signal(&walker->wake);
+  pthread_mutex_unlock(&walker->lock);
+  return result;
+}
+
+static WalkNode* worker_take(WalkWorker* worker, bool steal)
+{
+  WalkNode* node = NULL;
+  pthread_mutex_lock(&worker->lock);
+  if (worker->head < worker->tail)
+  {
+    node = steal ? worker->tasks[worker->head++]
+                 : worker->tasks[--worker->tail];
+  }
+  pthread_mutex_unlock(&worker->lock);
+  return node;
+}
+
+static WalkNode* worker_find_task(WalkWorker* worker)
+{
+  DirectoryWalker* walker = worker->walker;
+  Size index = (Size)(worker - walker->workers);
+
+  WalkNode* node = worker_take(worker, false);
+  for (Size i = 1; node == NULL && i < walker->thread_count; i++)
+  {
+    node =
+      worker_take(&walker->workers[(index + i) % walker->thread_count], true);
+  }
+
+  if (node != NULL)
+  {
+    pthread_mutex_lock(&walker->lock);
+    walker->queued--;
+    pthread_mutex_unlock(&walker->lock);
+  }
+  return node;
+}
+
+static Result node_add_child(WalkWorker* worker, WalkNode* node,
+                             const char* name, WalkChild** child)
+{
+  if (node->child_count == node->child_capacity)
+  {
+    Size new_capacity =
+      node->child_capacity > 0 ? node->child_capacity * 2 : INITIAL_CAPACITY;
+    WalkChild* new_children = (WalkChild*)realloc(
+      node->children, new_capacity * sizeof(WalkChild));
+    if (new_children == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при расширении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    node->children = new_children;
+    node->child_capacity = new_capacity;
+  }
+
+  char* copy = arena_strdup(worker->arena, name);
+  if (copy == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  WalkChild* added = &node->children[node->child_count++];
+  added->name = copy;
+  added->is_directory = false;
+  added->size = 0;
+  added->mtime = 0;
+  added->node = NULL;
+  *child = added;
+  return RESULT_OK;
+}
+
+// Пока дескрипторов немного, поддиректория открывается относительно
+// родителя, пока тот открыт: без разбора полного пути ядром
+static Result enqueue_subdirectory(WalkWorker* worker, const WalkNode* parent,
+                                   int parent_fd, WalkChild* child)
+{
+  DirectoryWalker* walker = worker->walker;
+  WalkNode* node = (WalkNode*)arena_alloc(worker->arena, sizeof(WalkNode));
+  if (node == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  node->path = path_utils_arena_join(worker->arena, parent->path, child->name);
+  if (node->path == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  node->fd = -1;
+  node->children = NULL;
+  node->child_count = 0;
+  node->child_capacity = 0;
+
+  pthread_mutex_lock(&walker->lock);
+  bool open_ahead = walker->open_count < DIRECTORY_WALKER_OPEN_LIMIT;
+  if (open_ahead)
+  {
+    walker->open_count++;
+  }
+  pthread_mutex_unlock(&walker->lock);
+
+  if (open_ahead)
+  {
+    node->fd = openat(parent_fd, child->name,
+                      O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+  }
+
+  if (open_ahead && node->fd < 0)
+  {
+    // Повторная попытка по пути сообщит об ошибке при обработке узла
+    pthread_mutex_lock(&walker->lock);
+    walker->open_count--;
+    pthread_mutex_unlock(&walker->lock);
+  }
+
+  child->node = node;
+  Result result = worker_push(worker, node);
+  if (result != RESULT_OK && node->fd >= 0)
+  {
+    close(node->fd);
+    pthread_mutex_lock(&walker->lock);
+    walker->open_count--;
+    pthread_mutex_unlock(&walker->lock);
+  }
+
+  return result;
+}
+
+static Result scan_entry(WalkWorker* worker, WalkNode* node, int fd,
+                         const struct dirent* entry)
+{
+  WalkChild* child;
+  Result result = node_add_child(worker, node, entry->d_name, &child);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  // Директориям размер не нужен, поэтому d_type принимается без stat.
+  // DT_UNKNOWN (часть сетевых и старых ФС) проверяется без раскрытия
+  // ссылки, чтобы обходить только настоящие директории
+  bool descend = entry->d_type == DT_DIR;
+  if (descend)
+  {
+    child->is_directory = true;
+  }
+  else
+  {
+    struct stat stats;
+    int flags = entry->d_type == DT_UNKNOWN ? AT_SYMLINK_NOFOLLOW : 0;
+    bool found = fstatat(fd, entry->d_name, &stats, flags) == 0;
+    if (found && flags != 0)
+    {
+      descend = S_ISDIR(stats.st_mode);
+      if (S_ISLNK(stats.st_mode))
+      {
+        found = fstatat(fd, entry->d_name, &stats, 0) == 0;
+      }
+    }
+
+    if (!found)
+    {
+      LOG_ERROR("Ошибка получения информации о файле: %s/%s\n", node->path,
+                entry->d_name);
+      return RESULT_IO_ERROR;
+    }
+
+    child->is_directory = S_ISDIR(stats.st_mode);
+    if (!child->is_directory)
+    {
+      child->size = (QWord)stats.st_size;
+      child->mtime = (QWord)stats.st_mtim.tv_sec * 1000000000ULL +
+                     (QWord)stats.st_mtim.tv_nsec;
+    }
+  }
+
+  if (!descend || !worker->walker->recursive)
+  {
+    return RESULT_OK;
+  }
+
+  return enqueue_subdirectory(worker, node, fd, child);
+}
+
+static void scan_directory(WalkWorker* worker, WalkNode* node)
+{
+  DirectoryWalker* walker = worker->walker;
+  int fd = node->fd;
+  if (fd >= 0)
+  {
+    pthread_mutex_lock(&walker->lock);
+    walker->open_count--;
+    pthread_mutex_unlock(&walker->lock);
+  }
+  else
+  {
+    fd = open(node->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+
+  // Поток каталога владеет дескриптором и закрывает его в closedir
+  DIR* directory = fd >= 0 ? fdopendir(fd) : NULL;
+  if (directory == NULL)
+  {
+    LOG_ERROR("Не удалось открыть директорию '%s'!\n", node->path);
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    walker_set_result(walker, RESULT_IO_ERROR);
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(directory)) != NULL)
+  {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+    {
+      continue;
+    }
+
+    Result result = scan_entry(worker, node, fd, entry);
+    if (result != RESULT_OK)
+    {
+      walker_set_result(walker, result);
+    }
+  }
+
+  closedir(directory);
+}
+
+static void* worker_run(void* argument)
+{
+  WalkWorker* worker = (WalkWorker*)argument;
+  DirectoryWalker* walker = worker->walker;
+
+  for (;;)
+  {
+    WalkNode* node = worker_find_task(worker);
+    if (node != NULL)
+    {
+      scan_directory(worker, node);
+
+      pthread_mutex_lock(&walker->lock);
+      walker->pending--;
+      if (walker->pending == 0)
+      {
+        pthread_cond_broadcast(&walker->wake);
+      }
+      pthread_mutex_unlock(&walker->lock);
+      continue;
+    }
+
+    // Очереди пусты, но обрабатываемые директории еще могут добавить узлы
+    pthread_mutex_lock(&walker->lock);
+    while (walker->queued == 0 && walker->pending > 0)
+    {
+      pthread_cond_wait(&walker->wake, &walker->lock);
+    }
+    bool done = walker->pending == 0;
+    pthread_mutex_unlock(&walker->lock);
+
+    if (done)
+    {
+      return NULL;
+    }
+  }
+}
+
+static int compare_children(const void* left, const void* right)
+{
+  return strcmp(((const WalkChild*)left)->name,
+                ((const WalkChild*)right)->name);
+}
+
+static Result walker_append(DirectoryWalker* self, const char* path,
+                            const WalkChild* child)
+{
+  if (self->count == self->capacity)
+  {
+    Size new_capacity =
+      self->capacity > 0 ? self->capacity * 2 : INITIAL_CAPACITY;
+    DirectoryWalkEntry* new_entries = (DirectoryWalkEntry*)realloc(
+      self->entries, new_capacity * sizeof(DirectoryWalkEntry));
+    if (new_entries == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при расширении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    self->entries = new_entries;
+    self->capacity = new_capacity;
+  }
+
+  DirectoryWalkEntry* entry = &self->entries[self->count++];
+  entry->path = path;
+  entry->is_directory = child->is_directory;
+  entry->size = child->size;
+  entry->mtime = child->mtime;
+  return RESULT_OK;
+}
+
+// Прямой порядок с сортировкой детей по имени. Массивы детей освобождаются
+// по ходу, поэтому дерево проходится целиком и после ошибки
+static Result collect_node(DirectoryWalker* self, WalkNode* node,
+                           Result result)
+{
+  if (result == RESULT_OK && node->child_count > 1)
+  {
+    qsort(node->children, node->child_count, sizeof(WalkChild),
+          compare_children);
+  }
+
+  for (Size i = 0; i < node->child_count; i++)
+  {
+    WalkChild* child = &node->children[i];
+    if (result == RESULT_OK)
+    {
+      const char* path =
+        child->node != NULL
+          ? child->node->path
+          : path_utils_arena_join(self->paths, node->path, child->name);
+      result = path != NULL ? walker_append(self, path, child)
+                            : RESULT_MEMORY_ERROR;
+    }
+
+    if (child->node != NULL)
+    {
+      result = collect_node(self, child->node, result);
+    }
+  }
+
+  free(node->children);
+  node->children = NULL;
+  node->child_count = 0;
+  node->child_capacity = 0;
+  return result;
+}
+
+Result directory_walker_walk(DirectoryWalker* self, const char* root,
+                             bool recursive)
+{
+  if (self == NULL || root == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->count = 0;
+  self->recursive = recursive;
+  self->queued = 0;
+  self->pending = 0;
+  self->open_count = 0;
+  self->result = RESULT_OK;
+  arena_reset(self->paths);
+  for (Size i = 0; i < self->thread_count; i++)
+  {
+    arena_reset(self->workers[i].arena);
+    self->workers[i].head = 0;
+    self->workers[i].tail = 0;
+  }
+
+  WalkWorker* first = &self->workers[0];
+  WalkNode* root_node = (WalkNode*)arena_alloc(first->arena, sizeof(WalkNode));
+  char* path = root_node != NULL ? arena_strdup(first->arena, root) : NULL;
+  if (path == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  root_node->path = path;
+  root_node->fd = -1;
+  root_node->children = NULL;
+  root_node->child_count = 0;
+  root_node->child_capacity = 0;
+
+  Result result = worker_push(first, root_node);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  // Вызывающий поток работает первым исполнителем; если потоки не
+  // создаются, обход просто идет меньшим их числом
+  Size started = 1;
+  while (started < self->thread_count &&
+         pthread_create(&self->workers[started].thread, NULL, worker_run,
+                        &self->workers[started]) == 0)
+  {
+    started++;
+  }
+
+  worker_run(first);
+  for (Size i = 1; i < started; i++)
+  {
+    pthread_join(self->workers[i].thread, NULL);
+  }
+
+  result = collect_node(self, root_node, self->result);
+  if (result != RESULT_OK)
+  {
+    self->count = 0;
+    return result;
+  }
+
+  LOG_DEBUG("Обход %s: %zu записей, потоков %zu\n", root, self->count,
+            started);
+  return RESULT_OK;
+}
+
+Size directory_walker_get_count(const DirectoryWalker* self)
+{
+  return self ? self->count : 0;
+}
+
+const DirectoryWalkEntry* directory_walker_get_entry(
+  const DirectoryWalker* self, Size index)
+{
+  if (self == NULL || index >= self->count)
+  {
+    return NULL;
+  }
+
+  return &self->entries[index];
+}
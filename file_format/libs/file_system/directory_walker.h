@@ -0,0 +1,43 @@
+#ifndef FILE_SYSTEM_DIRECTORY_WALKER_H
+#define FILE_SYSTEM_DIRECTORY_WALKER_H
+
+#include <stdbool.h>
+
+#include "types.h"
+
+// Общий обход дерева директорий. Директории читаются через дескрипторы
+// (openat/fstatat без склейки строковых путей), тип из d_type принимается
+// без stat, поддиректории обходятся параллельно потоками с очередями с
+// перехватом работы. Результат не зависит от числа потоков: прямой порядок
+// обхода, записи одной директории отсортированы по имени
+typedef struct DirectoryWalker DirectoryWalker;
+
+#define DIRECTORY_WALKER_MAX_THREADS 16
+// Поддиректорий, открытых заранее по дескриптору родителя; остальные
+// ждут в очереди с путем, чтобы не упереться в лимит дескрипторов
+#define DIRECTORY_WALKER_OPEN_LIMIT 64
+
+typedef struct
+{
+  const char* path;  // Путь корня и имена через '/', живет до следующего обхода
+  bool is_directory;
+  QWord size;  // 0 для директорий
+  QWord mtime;  // Время изменения в наносекундах Unix, 0 для директорий
+} DirectoryWalkEntry;
+
+// thread_count == 0 выбирает число процессоров (не больше
+// DIRECTORY_WALKER_MAX_THREADS)
+DirectoryWalker* directory_walker_create(Size thread_count);
+void directory_walker_destroy(DirectoryWalker* self);
+
+// Сам корень в результат не входит. Символические ссылки не раскрываются
+// при обходе, но описываются по цели, как stat. Ошибка открытия или stat
+// любой записи возвращается после завершения обхода
+Result directory_walker_walk(DirectoryWalker* self, const char* root,
+                             bool recursive);
+
+Size directory_walker_get_count(const DirectoryWalker* self);
+const DirectoryWalkEntry* directory_walker_get_entry(
+  const DirectoryWalker* self, Size index);
+
+#endif  // FILE_SYSTEM_DIRECTORY_WALKER_H
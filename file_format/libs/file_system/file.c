@@ -1,12 +1,24 @@
 #include "file.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "log.h"
 #include "types.h"
+#include "volume_set.h"
 
 #define BYTES_AMOUNT 1
+// Буфер запасного копирования и предел одного вызова sendfile
+#define FILE_COPY_CHUNK (1024 * 1024)
 
 struct File
 {
@@ -14,6 +26,8 @@ struct File
   Byte* buffer;
   Size size;
   char* path;
+  VolumeSet* volumes;  // NULL - обычный файл, иначе descriptor - манифест
+  QWord position;      // Логическая позиция в томах
 };
 
 File* file_create(const char* path)
@@ -27,7 +41,7 @@ File* file_create(const char* path)
   file->path = (char*)malloc(strlen(path) + 1);
   if (file->path == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     free(file);
     return NULL;
   }
@@ -36,6 +50,8 @@ File* file_create(const char* path)
   file->descriptor = NULL;
   file->buffer = NULL;
   file->size = 0;
+  file->volumes = NULL;
+  file->position = 0;
 
   return file;
 }
@@ -52,6 +68,7 @@ void file_destroy(File* self)
     int close_status = fclose(self->descriptor);
   }
 
+  volume_set_destroy(self->volumes);
   free(self->buffer);
   free(self->path);
   free(self);
@@ -73,6 +90,42 @@ Result file_open_for_read(File* self)
   return RESULT_OK;
 }
 
+Result file_open_for_read_volumes(File* self)
+{
+  Result result = file_open_for_read(self);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  self->position = 0;
+  result = volume_set_open(self->path, self->descriptor, &self->volumes);
+  if (result != RESULT_OK)
+  {
+    fclose(self->descriptor);
+    self->descriptor = NULL;
+  }
+  return result;
+}
+
+Result file_split_volumes(File* self, QWord volume_size)
+{
+  if (self == NULL || self->descriptor == NULL || self->volumes != NULL ||
+      volume_size == 0 || ftello(self->descriptor) != 0)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->volumes = volume_set_create(self->path, volume_size);
+  if (self->volumes == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  self->position = 0;
+  return RESULT_OK;
+}
+
 Result file_close(File* self)
 {
   if (self == NULL || self->descriptor == NULL)
@@ -80,14 +133,23 @@ Result file_close(File* self)
     return RESULT_INVALID_ARGUMENT;
   }
 
+  // Манифест пишется последним: до него набор томов не читается
+  Result result = RESULT_OK;
+  if (self->volumes != NULL)
+  {
+    result = volume_set_finish(self->volumes, self->descriptor);
+    volume_set_destroy(self->volumes);
+    self->volumes = NULL;
+  }
+
   int close_status = fclose(self->descriptor);
+  self->descriptor = NULL;
   if (close_status != 0)
   {
-    printf("Произошла ошибка при закрытии файла!\n");
+    LOG_ERROR("Произошла ошибка при закрытии файла!\n");
     return RESULT_ERROR;
   }
-  self->descriptor = NULL;
-  return RESULT_OK;
+  return result;
 }
 
 Result file_read_bytes(File* self)
@@ -97,17 +159,39 @@ Result file_read_bytes(File* self)
     return RESULT_INVALID_ARGUMENT;
   }
 
+  if (self->volumes != NULL)
+  {
+    Size size = (Size)volume_set_get_size(self->volumes);
+    Byte* buffer = (Byte*)malloc(size > 0 ? size : 1);
+    if (buffer == NULL)
+    {
+      return RESULT_MEMORY_ERROR;
+    }
+
+    Result result = volume_set_read_at(self->volumes, buffer, size, 0);
+    if (result != RESULT_OK)
+    {
+      free(buffer);
+      return result;
+    }
+
+    free(self->buffer);
+    self->buffer = buffer;
+    self->size = size;
+    return RESULT_OK;
+  }
+
   int seek_status = fseek(self->descriptor, 0, SEEK_END);
   if (seek_status != 0)
   {
-    printf("Произошла ошибка при перемещении указателя файла в конец!\n");
+    LOG_ERROR("Произошла ошибка при перемещении указателя файла в конец!\n");
     return RESULT_ERROR;
   }
   self->size = ftell(self->descriptor);
   int rewind_status = fseek(self->descriptor, 0L, SEEK_SET);
   if (rewind_status != 0)
   {
-    printf("Произошла ошибка при возвращении указателя файла в начало!\n");
+    LOG_ERROR("Произошла ошибка при возвращении указателя файла в начало!\n");
     return RESULT_ERROR;
   }
 
@@ -136,6 +220,17 @@ Result file_read_bytes_size(File* self, Byte* buffer, Size size_to_read)
     return RESULT_INVALID_ARGUMENT;
   }
 
+  if (self->volumes != NULL)
+  {
+    Result result = volume_set_read_at(self->volumes, buffer, size_to_read,
+                                       self->position);
+    if (result == RESULT_OK)
+    {
+      self->position += size_to_read;
+    }
+    return result;
+  }
+
   Size bytes_read = fread(buffer, 1, size_to_read, self->descriptor);
   if (bytes_read != size_to_read)
   {
@@ -161,6 +256,36 @@ Result file_open_for_write(File* self)
   return RESULT_OK;
 }
 
+Result file_open_for_update(File* self)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  self->descriptor = fopen(self->path, "r+b");
+  if (self->descriptor == NULL)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  // Тома пишутся только целиком, дописать в набор нельзя
+  VolumeSet* volumes = NULL;
+  Result result = volume_set_open(self->path, self->descriptor, &volumes);
+  if (result == RESULT_OK && volumes != NULL)
+  {
+    LOG_ERROR("Многотомный файл нельзя изменить: %s\n", self->path);
+    volume_set_destroy(volumes);
+    result = RESULT_INVALID_ARGUMENT;
+  }
+  if (result != RESULT_OK)
+  {
+    fclose(self->descriptor);
+    self->descriptor = NULL;
+  }
+  return result;
+}
+
 Result file_write_bytes(File* self, const Byte* data, Size data_size)
 {
   if (self == NULL || self->descriptor == NULL || data == NULL)
@@ -168,6 +293,17 @@ Result file_write_bytes(File* self, const Byte* data, Size data_size)
     return RESULT_INVALID_ARGUMENT;
   }
 
+  if (self->volumes != NULL)
+  {
+    Result result =
+      volume_set_write_at(self->volumes, data, data_size, self->position);
+    if (result == RESULT_OK)
+    {
+      self->position += data_size;
+    }
+    return result;
+  }
+
   Size bytes_written = fwrite(data, 1, data_size, self->descriptor);
   if (bytes_written != data_size)
   {
@@ -185,6 +321,11 @@ Result file_write_from_file(File* self, const File* source)
     return RESULT_INVALID_ARGUMENT;
   }
 
+  if (self->volumes != NULL)
+  {
+    return file_write_bytes(self, source->buffer, source->size);
+  }
+
   Size bytes_written =
     fwrite(source->buffer, 1, source->size, self->descriptor);
   if (bytes_written != source->size)
@@ -202,6 +343,19 @@ Result file_seek(File* self, long offset, int whence)
     return RESULT_INVALID_ARGUMENT;
   }
 
+  if (self->volumes != NULL)
+  {
+    QWord base = whence == SEEK_END ? volume_set_get_size(self->volumes)
+                 : whence == SEEK_CUR ? self->position
+                                      : 0;
+    if (offset < 0 && (QWord)(-offset) > base)
+    {
+      return RESULT_IO_ERROR;
+    }
+    self->position = base + (QWord)offset;
+    return RESULT_OK;
+  }
+
   if (fseek(self->descriptor, offset, whence) != 0)
   {
     return RESULT_IO_ERROR;
@@ -210,6 +364,23 @@ Result file_seek(File* self, long offset, int whence)
   return RESULT_OK;
 }
 
+Result file_truncate(File* self, QWord size)
+{
+  if (self == NULL || self->descriptor == NULL || self->volumes != NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (fflush(self->descriptor) != 0 ||
+      ftruncate(fileno(self->descriptor), (off_t)size) != 0 ||
+      fseeko(self->descriptor, (off_t)size, SEEK_SET) != 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  return RESULT_OK;
+}
+
 long file_tell(File* self)
 {
   if (self == NULL || self->descriptor == NULL)
@@ -217,6 +388,11 @@ long file_tell(File* self)
     return -1;
   }
 
+  if (self->volumes != NULL)
+  {
+    return (long)self->position;
+  }
+
   return ftell(self->descriptor);
 }
 
@@ -227,6 +403,11 @@ Result file_read_at(File* self, Byte* buffer, Size size, QWord offset)
     return RESULT_INVALID_ARGUMENT;
   }
 
+  if (self->volumes != NULL)
+  {
+    return volume_set_read_at(self->volumes, buffer, size, offset);
+  }
+
   long current_pos = ftell(self->descriptor);
   if (current_pos == -1)
   {
@@ -253,6 +434,516 @@ Result file_read_at(File* self, Byte* buffer, Size size, QWord offset)
   return RESULT_OK;
 }
 
+// Копирование через буфер постоянного размера, если ядро не умеет копировать
+// между этими дескрипторами
+static Result copy_buffered(int input, QWord input_offset, int output,
+                            QWord output_offset, QWord size)
+{
+  Byte* buffer =
+    (Byte*)malloc(size < FILE_COPY_CHUNK ? (Size)size : FILE_COPY_CHUNK);
+  if (buffer == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = RESULT_OK;
+  while (size > 0 && result == RESULT_OK)
+  {
+    Size chunk = size < FILE_COPY_CHUNK ? (Size)size : FILE_COPY_CHUNK;
+    ssize_t bytes_read = pread(input, buffer, chunk, (off_t)input_offset);
+    if (bytes_read < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytes_read <= 0)
+    {
+      result = RESULT_IO_ERROR;
+      break;
+    }
+
+    Size position = 0;
+    while (position < (Size)bytes_read)
+    {
+      ssize_t bytes_written =
+        pwrite(output, buffer + position, (Size)bytes_read - position,
+               (off_t)(output_offset + position));
+      if (bytes_written < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      if (bytes_written <= 0)
+      {
+        result = RESULT_IO_ERROR;
+        break;
+      }
+      position += (Size)bytes_written;
+    }
+
+    input_offset += (QWord)bytes_read;
+    output_offset += (QWord)bytes_read;
+    size -= (QWord)bytes_read;
+  }
+
+  free(buffer);
+  return result;
+}
+
+// Ошибки, после которых стоит попробовать следующий способ копирования
+static bool copy_unsupported(int error)
+{
+  return error == EXDEV || error == ENOSYS || error == EINVAL ||
+         error == EOPNOTSUPP || error == EBADF;
+}
+
+// Клонирование общих блоков (btrfs, XFS): работает, только если оба
+// смещения выровнены по блоку файловой системы, поэтому клонируется
+// выровненное начало участка, а хвост короче блока копируется дальше.
+// Возвращает число склонированных байт, 0 - клонирование невозможно
+static QWord clone_aligned_prefix(int input, QWord input_offset, int output,
+                                  QWord output_offset, QWord size)
+{
+  struct stat info;
+  if (fstat(output, &info) != 0 || info.st_blksize <= 0)
+  {
+    return 0;
+  }
+
+  QWord block_size = (QWord)info.st_blksize;
+  QWord length = size - size % block_size;
+  if (length == 0 || input_offset % block_size != 0 ||
+      output_offset % block_size != 0)
+  {
+    return 0;
+  }
+
+  struct file_clone_range range;
+  range.src_fd = input;
+  range.src_offset = input_offset;
+  range.src_length = length;
+  range.dest_offset = output_offset;
+  return ioctl(output, FICLONERANGE, &range) == 0 ? length : 0;
+}
+
+// Данные идут из дескриптора в дескриптор внутри ядра: сначала
+// клонирование выровненных блоков, затем copy_file_range, sendfile и
+// буфер. Позиции дескрипторов copy_file_range не меняет, sendfile сдвигает
+// только позицию output, поэтому вызывающий код восстанавливает ее сам
+static Result copy_descriptor_range(int input, QWord input_offset,
+                                    int output, QWord output_offset,
+                                    QWord size)
+{
+  QWord cloned =
+    clone_aligned_prefix(input, input_offset, output, output_offset, size);
+  loff_t input_position = (loff_t)(input_offset + cloned);
+  loff_t output_position = (loff_t)(output_offset + cloned);
+  size -= cloned;
+  while (size > 0)
+  {
+    ssize_t copied = copy_file_range(input, &input_position, output,
+                                     &output_position, (Size)size, 0);
+    if (copied > 0)
+    {
+      size -= (QWord)copied;
+      continue;
+    }
+    if (copied == 0)
+    {
+      // Источник короче ожидаемого
+      return RESULT_IO_ERROR;
+    }
+    if (errno == EINTR)
+    {
+      continue;
+    }
+    if (!copy_unsupported(errno))
+    {
+      return RESULT_IO_ERROR;
+    }
+    break;
+  }
+
+  if (size > 0 && lseek(output, output_position, SEEK_SET) == output_position)
+  {
+    off_t sendfile_position = (off_t)input_position;
+    while (size > 0)
+    {
+      Size chunk = size < FILE_COPY_CHUNK ? (Size)size : FILE_COPY_CHUNK;
+      ssize_t copied = sendfile(output, input, &sendfile_position, chunk);
+      if (copied > 0)
+      {
+        output_position += copied;
+        size -= (QWord)copied;
+        continue;
+      }
+      if (copied == 0)
+      {
+        return RESULT_IO_ERROR;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (!copy_unsupported(errno))
+      {
+        return RESULT_IO_ERROR;
+      }
+      break;
+    }
+    input_position = (loff_t)sendfile_position;
+  }
+
+  if (size > 0)
+  {
+    return copy_buffered(input, (QWord)input_position, output,
+                         (QWord)output_position, size);
+  }
+
+  return RESULT_OK;
+}
+
+// Дескриптор, в котором лежит байт offset файла, смещение в нем и сколько
+// байт идет подряд: у обычного файла граница одна - конец данных
+static Result locate_range(File* self, QWord offset, int* descriptor,
+                           QWord* local_offset, QWord* available)
+{
+  if (self->volumes != NULL)
+  {
+    return volume_set_locate(self->volumes, offset, descriptor, local_offset,
+                             available);
+  }
+
+  *descriptor = fileno(self->descriptor);
+  *local_offset = offset;
+  *available = ~(QWord)0;
+  return RESULT_OK;
+}
+
+// Копирование с разбиением по границам томов источника и приемника
+static Result copy_file_range_between(File* self, QWord output_offset,
+                                      File* source, QWord source_offset,
+                                      QWord size)
+{
+  while (size > 0)
+  {
+    int input = -1;
+    int output = -1;
+    QWord input_local = 0;
+    QWord output_local = 0;
+    QWord input_available = 0;
+    QWord output_available = 0;
+    Result result = locate_range(source, source_offset, &input, &input_local,
+                                 &input_available);
+    if (result == RESULT_OK)
+    {
+      result = locate_range(self, output_offset, &output, &output_local,
+                            &output_available);
+    }
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+
+    QWord part = size < input_available ? size : input_available;
+    part = part < output_available ? part : output_available;
+    result =
+      copy_descriptor_range(input, input_local, output, output_local, part);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+
+    source_offset += part;
+    output_offset += part;
+    size -= part;
+    volume_set_extend(self->volumes, output_offset);
+  }
+
+  return RESULT_OK;
+}
+
+Result file_copy_range(File* self, File* source, QWord source_offset,
+                       QWord size)
+{
+  if (self == NULL || self->descriptor == NULL || source == NULL ||
+      source->descriptor == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (self->volumes != NULL)
+  {
+    Result result = copy_file_range_between(self, self->position, source,
+                                            source_offset, size);
+    if (result == RESULT_OK)
+    {
+      self->position += size;
+    }
+    return result;
+  }
+
+  // Данные, уже записанные через FILE, должны лечь раньше копируемых
+  if (fflush(self->descriptor) != 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  off_t position = ftello(self->descriptor);
+  if (position < 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  Result result = copy_file_range_between(self, (QWord)position, source,
+                                          source_offset, size);
+
+  // Позиция FILE ставится за скопированными данными
+  if (fseeko(self->descriptor, position + (off_t)size, SEEK_SET) != 0 &&
+      result == RESULT_OK)
+  {
+    result = RESULT_IO_ERROR;
+  }
+
+  return result;
+}
+
+// Приемник - извлекаемый файл, тома бывают только у источника
+Result file_copy_extents(File* self, File* source, QWord source_offset,
+                         const FileExtent* extents, DWord count,
+                         QWord total_size)
+{
+  if (self == NULL || self->descriptor == NULL || self->volumes != NULL ||
+      source == NULL || source->descriptor == NULL ||
+      (extents == NULL && count > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (fflush(self->descriptor) != 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  Result result = RESULT_OK;
+  for (DWord i = 0; i < count && result == RESULT_OK; i++)
+  {
+    result = copy_file_range_between(self, extents[i].offset, source,
+                                     source_offset, extents[i].length);
+    source_offset += extents[i].length;
+  }
+
+  if (result == RESULT_OK &&
+      ftruncate(fileno(self->descriptor), (off_t)total_size) != 0)
+  {
+    result = RESULT_IO_ERROR;
+  }
+
+  if (fseeko(self->descriptor, (off_t)total_size, SEEK_SET) != 0 &&
+      result == RESULT_OK)
+  {
+    result = RESULT_IO_ERROR;
+  }
+
+  return result;
+}
+
+// Поиск областей с данными через SEEK_DATA/SEEK_HOLE. Если файловая система
+// не поддерживает эти режимы, весь файл считается одной областью данных.
+Result file_find_data_extents(const char* path, QWord size,
+                              FileExtent** extents, DWord* count)
+{
+  if (path == NULL || extents == NULL || count == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  *extents = NULL;
+  *count = 0;
+
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  FileExtent* found = NULL;
+  DWord found_count = 0;
+  DWord capacity = 0;
+  QWord position = 0;
+
+  while (position < size)
+  {
+    QWord data_start = position;
+    QWord hole_start = size;
+
+    off_t seek_result = lseek(descriptor, (off_t)position, SEEK_DATA);
+    if (seek_result < 0)
+    {
+      if (errno == ENXIO)
+      {
+        // До конца файла только дыра
+        break;
+      }
+      // SEEK_DATA не поддерживается - остаток считаем данными
+    }
+    else
+    {
+      data_start = (QWord)seek_result;
+      seek_result = lseek(descriptor, seek_result, SEEK_HOLE);
+      if (seek_result >= 0 && (QWord)seek_result < size)
+      {
+        hole_start = (QWord)seek_result;
+      }
+    }
+
+    if (data_start >= size)
+    {
+      break;
+    }
+
+    if (found_count >= capacity)
+    {
+      DWord new_capacity = capacity == 0 ? 8 : capacity * 2;
+      FileExtent* new_found =
+        (FileExtent*)realloc(found, sizeof(FileExtent) * new_capacity);
+      if (new_found == NULL)
+      {
+        LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+        free(found);
+        close(descriptor);
+        return RESULT_MEMORY_ERROR;
+      }
+      found = new_found;
+      capacity = new_capacity;
+    }
+
+    found[found_count].offset = data_start;
+    found[found_count].length = hole_start - data_start;
+    found_count++;
+
+    position = hole_start;
+  }
+
+  close(descriptor);
+
+  *extents = found;
+  *count = found_count;
+  return RESULT_OK;
+}
+
+// Чтение только областей с данными; буфер файла содержит их подряд
+Result file_read_extents(File* self, const FileExtent* extents, DWord count)
+{
+  if (self == NULL || self->descriptor == NULL || self->volumes != NULL ||
+      (extents == NULL && count > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size total = 0;
+  for (DWord i = 0; i < count; i++)
+  {
+    total += extents[i].length;
+  }
+
+  Byte* buffer = (Byte*)malloc(total > 0 ? total : 1);
+  if (buffer == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Size position = 0;
+  for (DWord i = 0; i < count; i++)
+  {
+    if (fseeko(self->descriptor, (off_t)extents[i].offset, SEEK_SET) != 0)
+    {
+      free(buffer);
+      return RESULT_IO_ERROR;
+    }
+
+    Size bytes_read =
+      fread(buffer + position, BYTES_AMOUNT, extents[i].length,
+            self->descriptor);
+    if (bytes_read != extents[i].length)
+    {
+      free(buffer);
+      return RESULT_IO_ERROR;
+    }
+    position += bytes_read;
+  }
+
+  free(self->buffer);
+  self->buffer = buffer;
+  self->size = total;
+  return RESULT_OK;
+}
+
+Result file_keep_extents(File* self, const FileExtent* extents, DWord count)
+{
+  if (self == NULL || (extents == NULL && count > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size position = 0;
+  for (DWord i = 0; i < count; i++)
+  {
+    if (extents[i].offset < position ||
+        extents[i].offset + extents[i].length > self->size)
+    {
+      return RESULT_INVALID_ARGUMENT;
+    }
+
+    memmove(self->buffer + position, self->buffer + extents[i].offset,
+            extents[i].length);
+    position += extents[i].length;
+  }
+
+  self->size = position;
+  return RESULT_OK;
+}
+
+// Запись областей с данными по их смещениям. Промежутки между ними не
+// записываются и остаются дырами, размер файла выставляется через ftruncate.
+Result file_write_extents(File* self, const Byte* data,
+                          const FileExtent* extents, DWord count,
+                          QWord total_size)
+{
+  if (self == NULL || self->descriptor == NULL || self->volumes != NULL ||
+      ((data == NULL || extents == NULL) && count > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size position = 0;
+  for (DWord i = 0; i < count; i++)
+  {
+    if (fseeko(self->descriptor, (off_t)extents[i].offset, SEEK_SET) != 0)
+    {
+      return RESULT_IO_ERROR;
+    }
+
+    Size bytes_written =
+      fwrite(data + position, 1, extents[i].length, self->descriptor);
+    if (bytes_written != extents[i].length)
+    {
+      return RESULT_IO_ERROR;
+    }
+    position += bytes_written;
+  }
+
+  if (fflush(self->descriptor) != 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  if (ftruncate(fileno(self->descriptor), (off_t)total_size) != 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  return RESULT_OK;
+}
+
 const Byte* file_get_buffer(const File* self)
 {
   return self ? self->buffer : NULL;
@@ -263,6 +954,23 @@ Size file_get_size(const File* self)
   return self ? self->size : 0;
 }
 
+Size file_get_block_size(const File* self)
+{
+  struct stat info;
+  if (self == NULL || self->descriptor == NULL ||
+      fstat(fileno(self->descriptor), &info) != 0 || info.st_blksize <= 0)
+  {
+    return 0;
+  }
+
+  return (Size)info.st_blksize;
+}
+
+DWord file_get_volume_count(const File* self)
+{
+  return self ? volume_set_get_count(self->volumes) : 0;
+}
+
 const char* file_get_path(const File* self)
 {
   return self ? self->path : NULL;
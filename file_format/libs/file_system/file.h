@@ -5,24 +5,71 @@
 
 typedef struct File File;
 
+// Область файла, содержащая данные (не дыру разреженного файла)
+typedef struct
+{
+  QWord offset;
+  QWord length;
+} FileExtent;
+
 File* file_create(const char* path);
 void file_destroy(File* self);
 
 Result file_open_for_read(File* self);
+// Как file_open_for_read, но если по пути лежит манифест томов, файл
+// читается из томов path.001, path.002, ..., которые открываются при первом
+// обращении. Для архивов: обычные входные файлы так не открываются, чтобы
+// манифест среди них архивировался как есть
+Result file_open_for_read_volumes(File* self);
 Result file_close(File* self);
 Result file_read_bytes(File* self);
 Result file_read_bytes_size(File* self, Byte* buffer, Size size_to_read);
 
 Result file_open_for_write(File* self);
+// Чтение и запись существующего файла без усечения. Манифест томов так не
+// открывается
+Result file_open_for_update(File* self);
 Result file_write_bytes(File* self, const Byte* data, Size data_size);
 Result file_write_from_file(File* self, const File* source);
+// Переводит только что открытый для записи файл в многотомный режим: данные
+// ложатся в тома по volume_size байт, манифест пишется при file_close
+Result file_split_volumes(File* self, QWord volume_size);
 
 Result file_seek(File* self, long offset, int whence);
 long file_tell(File* self);
+// Обрезает открытый на запись файл до size байт и переходит в его конец
+Result file_truncate(File* self, QWord size);
 Result file_read_at(File* self, Byte* buffer, Size size, QWord offset);
 
+// Копирование без прохода данных через пользовательскую память:
+// клонирование блоков (FICLONERANGE), если оба смещения выровнены по блоку
+// файловой системы, затем copy_file_range, sendfile и буфер постоянного
+// размера.
+// file_copy_range дописывает size байт source с source_offset в текущую
+// позицию self; file_copy_extents раскладывает идущие подряд данные source
+// по участкам, как file_write_extents. Позиция source не меняется
+Result file_copy_range(File* self, File* source, QWord source_offset,
+                       QWord size);
+Result file_copy_extents(File* self, File* source, QWord source_offset,
+                         const FileExtent* extents, DWord count,
+                         QWord total_size);
+
+Result file_find_data_extents(const char* path, QWord size,
+                              FileExtent** extents, DWord* count);
+Result file_read_extents(File* self, const FileExtent* extents, DWord count);
+// Оставляет в буфере только указанные участки уже прочитанных данных,
+// подряд; участки идут по возрастанию смещений и не пересекаются
+Result file_keep_extents(File* self, const FileExtent* extents, DWord count);
+Result file_write_extents(File* self, const Byte* data,
+                          const FileExtent* extents, DWord count,
+                          QWord total_size);
+
 const Byte* file_get_buffer(const File* self);
 Size file_get_size(const File* self);
+// Размер блока файловой системы открытого файла, 0 - неизвестен
+Size file_get_block_size(const File* self);
+// Число томов многотомного файла, 0 - обычный файл
+DWord file_get_volume_count(const File* self);
 const char* file_get_path(const File* self);
 
 #endif  // FILE_FILE_H
@@ -1,12 +1,11 @@
 #include "file_list.h"
 
-#include <dirent.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <sys/stat.h>
 
+#include "arena.h"
+#include "directory_walker.h"
+#include "log.h"
 #include "path_utils.h"
 
 #define INITIAL_CAPACITY 16
@@ -23,6 +22,7 @@ struct FileList
   FileEntry* entries;
   Size count;
   Size capacity;
+  Arena* paths;  // Строки путей всех записей
 };
 
 FileList* file_list_create(void)
@@ -30,17 +30,20 @@ FileList* file_list_create(void)
   FileList* list = (FileList*)malloc(sizeof(FileList));
   if (list == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
   list->capacity = INITIAL_CAPACITY;
   list->count = 0;
   list->entries = (FileEntry*)malloc(sizeof(FileEntry) * list->capacity);
+  list->paths = arena_create(0);
 
-  if (list->entries == NULL)
+  if (list->entries == NULL || list->paths == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(list->entries);
+    arena_destroy(list->paths);
     free(list);
     return NULL;
   }
@@ -55,11 +58,7 @@ void file_list_destroy(FileList* self)
     return;
   }
 
-  for (Size i = 0; i < self->count; i++)
-  {
-    free(self->entries[i].path);
-  }
-
+  arena_destroy(self->paths);
   free(self->entries);
   free(self);
 }
@@ -70,7 +69,7 @@ static Result file_list_resize(FileList* self, Size new_capacity)
     (FileEntry*)realloc(self->entries, sizeof(FileEntry) * new_capacity);
   if (new_entries == NULL)
   {
-    printf("Произошла ошибка при расширении памяти!\n");
+    LOG_ERROR("Произошла ошибка при расширении памяти!\n");
     return RESULT_MEMORY_ERROR;
   }
 
@@ -79,13 +78,10 @@ static Result file_list_resize(FileList* self, Size new_capacity)
   return RESULT_OK;
 }
 
-Result file_list_add_file(FileList* self, const char* filename)
+// Путь уже должен находиться в арене списка
+static Result file_list_append(FileList* self, char* path, bool is_directory,
+                               QWord size)
 {
-  if (self == NULL || filename == NULL)
-  {
-    return RESULT_INVALID_ARGUMENT;
-  }
-
   if (self->count >= self->capacity)
   {
     Result result = file_list_resize(self, self->capacity * 2);
@@ -96,21 +92,31 @@ Result file_list_add_file(FileList* self, const char* filename)
   }
 
   FileEntry* entry = &self->entries[self->count];
+  entry->path = path;
+  entry->is_directory = is_directory;
+  entry->size = size;
 
-  entry->path = (char*)malloc(strlen(filename) + 1);
-  if (entry->path == NULL)
+  self->count++;
+  return RESULT_OK;
+}
+
+Result file_list_add_file(FileList* self, const char* filename)
+{
+  if (self == NULL || filename == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
-    return RESULT_MEMORY_ERROR;
+    return RESULT_INVALID_ARGUMENT;
   }
 
-  strcpy(entry->path, filename);
-
-  entry->is_directory = path_utils_is_directory(filename);
-  entry->size = entry->is_directory ? 0 : path_utils_get_file_size(filename);
+  char* path = arena_strdup(self->paths, filename);
+  if (path == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
 
-  self->count++;
-  return RESULT_OK;
+  bool is_directory = path_utils_is_directory(path);
+  return file_list_append(self, path, is_directory,
+                          is_directory ? 0 : path_utils_get_file_size(path));
 }
 
 Result file_list_add_directory(FileList* self, const char* dirname,
@@ -127,42 +133,26 @@ Result file_list_add_directory(FileList* self, const char* dirname,
     return result;
   }
 
-  DIR* dir = opendir(dirname);
-  if (!dir)
+  // Тип и размер записей уже известны обходу, повторный stat не нужен
+  DirectoryWalker* walker = directory_walker_create(0);
+  if (walker == NULL)
   {
-    printf("Не удалось открыть директорию '%s'!\n", dirname);
-    return RESULT_IO_ERROR;
+    return RESULT_MEMORY_ERROR;
   }
 
-  struct dirent* entry;
-  while ((entry = readdir(dir)) != NULL)
+  result = directory_walker_walk(walker, dirname, recursive);
+  for (Size i = 0;
+       result == RESULT_OK && i < directory_walker_get_count(walker); i++)
   {
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-    {
-      continue;
-    }
-
-    char* full_path = path_utils_join(dirname, entry->d_name);
-    if (full_path == NULL)
-    {
-      closedir(dir);
-      return RESULT_IO_ERROR;
-    }
-
-    if (entry->d_type == DT_DIR && recursive)
-    {
-      file_list_add_directory(self, full_path, recursive);
-    }
-    else
-    {
-      file_list_add_file(self, full_path);
-    }
-
-    free(full_path);
+    const DirectoryWalkEntry* entry = directory_walker_get_entry(walker, i);
+    char* path = arena_strdup(self->paths, entry->path);
+    result = path != NULL ? file_list_append(self, path, entry->is_directory,
+                                             entry->size)
+                          : RESULT_MEMORY_ERROR;
   }
 
-  closedir(dir);
-  return RESULT_OK;
+  directory_walker_destroy(walker);
+  return result;
 }
 
 Size file_list_get_count(const FileList* self)
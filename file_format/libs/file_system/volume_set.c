@@ -0,0 +1,606 @@
+#include "volume_set.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "types.h"
+
+#define INITIAL_CAPACITY 4
+#define VOLUME_NOT_OPENED (-1)
+// Том закрыт при вытеснении; при записи он открывается снова без обрезки
+#define VOLUME_CLOSED (-2)
+
+struct VolumeSet
+{
+  char* path;  // Путь манифеста, тома - path.001, path.002, ...
+  QWord volume_size;
+  QWord size;  // Логический размер данных
+  DWord count;  // Томов, в которые уже попали данные
+  DWord capacity;
+  int* descriptors;  // Дескриптор или VOLUME_NOT_OPENED / VOLUME_CLOSED
+  // Открытые тома от давно не использованного к последнему
+  DWord open[VOLUME_SET_OPEN_LIMIT];
+  DWord open_count;
+  bool writable;
+};
+
+// Участок чтения внутри одного тома
+typedef struct
+{
+  int descriptor;
+  QWord local_offset;
+  Byte* buffer;
+  Size size;
+} VolumeRead;
+
+typedef struct
+{
+  pthread_t thread;
+  const VolumeRead* reads;
+  DWord count;
+  DWord first;  // Поток читает участки first, first + step, ...
+  DWord step;
+  Result result;
+} VolumeReadWorker;
+
+static VolumeSet* volume_set_alloc(const char* path, QWord volume_size,
+                                   bool writable)
+{
+  VolumeSet* set = (VolumeSet*)calloc(1, sizeof(VolumeSet));
+  if (set == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  set->path = (char*)malloc(strlen(path) + 1);
+  if (set->path == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(set);
+    return NULL;
+  }
+  strcpy(set->path, path);
+
+  set->volume_size = volume_size;
+  set->writable = writable;
+  return set;
+}
+
+VolumeSet* volume_set_create(const char* path, QWord volume_size)
+{
+  if (path == NULL || volume_size == 0)
+  {
+    return NULL;
+  }
+
+  return volume_set_alloc(path, volume_size, true);
+}
+
+static DWord volume_count_for(QWord size, QWord volume_size)
+{
+  return (DWord)((size + volume_size - 1) / volume_size);
+}
+
+static Result reserve_volumes(VolumeSet* self, DWord count)
+{
+  if (count <= self->capacity)
+  {
+    return RESULT_OK;
+  }
+
+  DWord capacity = self->capacity > 0 ? self->capacity : INITIAL_CAPACITY;
+  while (capacity < count)
+  {
+    capacity *= 2;
+  }
+
+  int* descriptors =
+    (int*)realloc(self->descriptors, sizeof(int) * capacity);
+  if (descriptors == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  for (DWord i = self->capacity; i < capacity; i++)
+  {
+    descriptors[i] = VOLUME_NOT_OPENED;
+  }
+  self->descriptors = descriptors;
+  self->capacity = capacity;
+  return RESULT_OK;
+}
+
+Result volume_set_open(const char* path, FILE* manifest, VolumeSet** volumes)
+{
+  if (path == NULL || manifest == NULL || volumes == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  *volumes = NULL;
+  VolumeManifest header;
+  Size bytes_read = fread(&header, 1, sizeof(header), manifest);
+  if (fseek(manifest, 0, SEEK_SET) != 0)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  if (bytes_read != sizeof(header) ||
+      memcmp(header.signature, VOLUME_SET_SIGNATURE,
+             VOLUME_SET_SIGNATURE_SIZE) != 0)
+  {
+    return RESULT_OK;
+  }
+
+  if (header.version != VOLUME_SET_VERSION || header.volume_size == 0 ||
+      header.volume_count !=
+        volume_count_for(header.total_size, header.volume_size))
+  {
+    LOG_ERROR("Поврежден манифест томов: %s\n", path);
+    return RESULT_ERROR;
+  }
+
+  VolumeSet* set = volume_set_alloc(path, header.volume_size, false);
+  if (set == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  set->size = header.total_size;
+  set->count = header.volume_count;
+  if (reserve_volumes(set, set->count) != RESULT_OK)
+  {
+    volume_set_destroy(set);
+    return RESULT_MEMORY_ERROR;
+  }
+
+  LOG_DEBUG("Многотомный файл %s: томов %u по %llu байт\n", path, set->count,
+            (unsigned long long)set->volume_size);
+  *volumes = set;
+  return RESULT_OK;
+}
+
+void volume_set_destroy(VolumeSet* self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  for (DWord i = 0; i < self->open_count; i++)
+  {
+    close(self->descriptors[self->open[i]]);
+  }
+
+  free(self->descriptors);
+  free(self->path);
+  free(self);
+}
+
+static char* volume_path(const VolumeSet* self, DWord index)
+{
+  Size length = strlen(self->path) + 16;
+  char* path = (char*)malloc(length);
+  if (path == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  snprintf(path, length, "%s.%03u", self->path, index + 1);
+  return path;
+}
+
+// Последний том короче остальных на остаток данных
+static QWord volume_length(const VolumeSet* self, DWord index)
+{
+  QWord start = (QWord)index * self->volume_size;
+  QWord rest = self->size > start ? self->size - start : 0;
+  return rest < self->volume_size ? rest : self->volume_size;
+}
+
+static DWord find_open(const VolumeSet* self, DWord index)
+{
+  for (DWord i = 0; i < self->open_count; i++)
+  {
+    if (self->open[i] == index)
+    {
+      return i;
+    }
+  }
+  return self->open_count;
+}
+
+static void close_volume(VolumeSet* self, DWord index)
+{
+  DWord position = find_open(self, index);
+  if (position == self->open_count)
+  {
+    return;
+  }
+
+  close(self->descriptors[index]);
+  self->descriptors[index] = VOLUME_CLOSED;
+  self->open_count--;
+  memmove(&self->open[position], &self->open[position + 1],
+          sizeof(DWord) * (self->open_count - position));
+}
+
+// Открытых томов не больше VOLUME_SET_OPEN_LIMIT: перед открытием нового
+// закрывается давно не использованный. Дескриптор действителен до
+// следующего открытия VOLUME_SET_OPEN_LIMIT других томов
+static Result open_volume(VolumeSet* self, DWord index, int* descriptor)
+{
+  if (self->descriptors[index] >= 0)
+  {
+    DWord position = find_open(self, index);
+    memmove(&self->open[position], &self->open[position + 1],
+            sizeof(DWord) * (self->open_count - position - 1));
+    self->open[self->open_count - 1] = index;
+    *descriptor = self->descriptors[index];
+    return RESULT_OK;
+  }
+
+  char* path = volume_path(self, index);
+  if (path == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  if (self->open_count == VOLUME_SET_OPEN_LIMIT)
+  {
+    close_volume(self, self->open[0]);
+  }
+
+  int flags = O_RDONLY;
+  if (self->writable)
+  {
+    flags = self->descriptors[index] == VOLUME_CLOSED
+              ? O_RDWR
+              : O_RDWR | O_CREAT | O_TRUNC;
+  }
+  int opened = open(path, flags, 0644);
+  if (opened < 0)
+  {
+    LOG_ERROR("Не удалось открыть том: %s\n", path);
+    free(path);
+    return RESULT_IO_ERROR;
+  }
+
+  // Том другой длины - от другого набора или обрезан при переносе
+  struct stat info;
+  if (!self->writable &&
+      (fstat(opened, &info) != 0 ||
+       (QWord)info.st_size != volume_length(self, index)))
+  {
+    LOG_ERROR("Размер тома не совпадает с манифестом: %s\n", path);
+    close(opened);
+    free(path);
+    return RESULT_IO_ERROR;
+  }
+
+  LOG_DEBUG("Открыт том %s\n", path);
+  free(path);
+  self->descriptors[index] = opened;
+  self->open[self->open_count++] = index;
+  *descriptor = opened;
+  return RESULT_OK;
+}
+
+Result volume_set_locate(VolumeSet* self, QWord offset, int* descriptor,
+                         QWord* local_offset, QWord* available)
+{
+  if (self == NULL || descriptor == NULL || local_offset == NULL ||
+      available == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (!self->writable && offset >= self->size)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  DWord index = (DWord)(offset / self->volume_size);
+  if (self->writable && index >= self->count)
+  {
+    Result result = reserve_volumes(self, index + 1);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+    self->count = index + 1;
+  }
+
+  *local_offset = offset % self->volume_size;
+  *available = self->volume_size - *local_offset;
+  if (!self->writable && *available > self->size - offset)
+  {
+    *available = self->size - offset;
+  }
+
+  return open_volume(self, index, descriptor);
+}
+
+static Result read_fully(int descriptor, Byte* buffer, Size size,
+                         QWord offset)
+{
+  while (size > 0)
+  {
+    ssize_t bytes_read = pread(descriptor, buffer, size, (off_t)offset);
+    if (bytes_read < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytes_read <= 0)
+    {
+      return RESULT_IO_ERROR;
+    }
+
+    buffer += bytes_read;
+    offset += (QWord)bytes_read;
+    size -= (Size)bytes_read;
+  }
+
+  return RESULT_OK;
+}
+
+static void* read_worker_run(void* argument)
+{
+  VolumeReadWorker* worker = (VolumeReadWorker*)argument;
+  worker->result = RESULT_OK;
+  for (DWord i = worker->first;
+       i < worker->count && worker->result == RESULT_OK; i += worker->step)
+  {
+    const VolumeRead* read = &worker->reads[i];
+    worker->result = read_fully(read->descriptor, read->buffer, read->size,
+                                read->local_offset);
+  }
+  return NULL;
+}
+
+// Тома открываются заранее в вызывающем потоке, потоки только читают
+static Result read_parallel(const VolumeRead* reads, DWord count)
+{
+  DWord thread_count =
+    count < VOLUME_SET_READ_THREADS ? count : VOLUME_SET_READ_THREADS;
+  VolumeReadWorker workers[VOLUME_SET_READ_THREADS];
+  DWord started = 1;
+  for (DWord i = 0; i < thread_count; i++)
+  {
+    workers[i].reads = reads;
+    workers[i].count = count;
+    workers[i].first = i;
+    workers[i].step = thread_count;
+    workers[i].result = RESULT_OK;
+  }
+
+  for (; started < thread_count; started++)
+  {
+    if (pthread_create(&workers[started].thread, NULL, read_worker_run,
+                       &workers[started]) != 0)
+    {
+      break;
+    }
+  }
+
+  // Участки не запустившихся потоков дочитывает вызывающий
+  read_worker_run(&workers[0]);
+  for (DWord i = started; i < thread_count; i++)
+  {
+    read_worker_run(&workers[i]);
+  }
+
+  Result result = RESULT_OK;
+  for (DWord i = 0; i < thread_count; i++)
+  {
+    if (i > 0 && i < started)
+    {
+      pthread_join(workers[i].thread, NULL);
+    }
+    if (result == RESULT_OK)
+    {
+      result = workers[i].result;
+    }
+  }
+  return result;
+}
+
+Result volume_set_read_at(VolumeSet* self, Byte* buffer, Size size,
+                          QWord offset)
+{
+  if (self == NULL || (buffer == NULL && size > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (offset > self->size || size > self->size - offset)
+  {
+    return RESULT_IO_ERROR;
+  }
+
+  // Участок читается порциями не больше VOLUME_SET_OPEN_LIMIT томов: все
+  // тома порции открыты одновременно
+  Result result = RESULT_OK;
+  while (size > 0 && result == RESULT_OK)
+  {
+    VolumeRead reads[VOLUME_SET_OPEN_LIMIT];
+    DWord count = 0;
+    Size total = 0;
+    for (; count < VOLUME_SET_OPEN_LIMIT && size > 0 && result == RESULT_OK;
+         count++)
+    {
+      QWord available = 0;
+      result = volume_set_locate(self, offset, &reads[count].descriptor,
+                                 &reads[count].local_offset, &available);
+      reads[count].buffer = buffer;
+      reads[count].size = available < size ? (Size)available : size;
+      buffer += reads[count].size;
+      offset += reads[count].size;
+      size -= reads[count].size;
+      total += reads[count].size;
+    }
+
+    if (result != RESULT_OK)
+    {
+      break;
+    }
+
+    if (count > 1 && total >= VOLUME_SET_PARALLEL_MIN)
+    {
+      result = read_parallel(reads, count);
+    }
+    else
+    {
+      for (DWord i = 0; i < count && result == RESULT_OK; i++)
+      {
+        result = read_fully(reads[i].descriptor, reads[i].buffer,
+                            reads[i].size, reads[i].local_offset);
+      }
+    }
+  }
+
+  return result;
+}
+
+Result volume_set_write_at(VolumeSet* self, const Byte* data, Size size,
+                           QWord offset)
+{
+  if (self == NULL || !self->writable || (data == NULL && size > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  while (size > 0)
+  {
+    int descriptor = -1;
+    QWord local_offset = 0;
+    QWord available = 0;
+    Result result = volume_set_locate(self, offset, &descriptor,
+                                      &local_offset, &available);
+    if (result != RESULT_OK)
+    {
+      return result;
+    }
+
+    Size part = available < size ? (Size)available : size;
+    ssize_t bytes_written =
+      pwrite(descriptor, data, part, (off_t)local_offset);
+    if (bytes_written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytes_written <= 0)
+    {
+      return RESULT_IO_ERROR;
+    }
+
+    data += bytes_written;
+    offset += (QWord)bytes_written;
+    size -= (Size)bytes_written;
+    volume_set_extend(self, offset);
+
+    // Заполненный том больше не нужен последовательной записи; заголовок
+    // в начале откроет свой том заново
+    if ((QWord)bytes_written == available)
+    {
+      close_volume(self, (DWord)((offset - 1) / self->volume_size));
+    }
+  }
+
+  return RESULT_OK;
+}
+
+void volume_set_extend(VolumeSet* self, QWord end)
+{
+  if (self != NULL && end > self->size)
+  {
+    self->size = end;
+  }
+}
+
+Result volume_set_finish(VolumeSet* self, FILE* manifest)
+{
+  if (self == NULL || manifest == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (!self->writable)
+  {
+    return RESULT_OK;
+  }
+
+  // Тома, в которые не попало ни байта, тоже создаются: набор не должен
+  // иметь пропусков
+  DWord count = volume_count_for(self->size, self->volume_size);
+  Result result = reserve_volumes(self, count);
+  for (DWord i = 0; i < count && result == RESULT_OK; i++)
+  {
+    int descriptor = -1;
+    result = open_volume(self, i, &descriptor);
+    if (result == RESULT_OK &&
+        ftruncate(descriptor, (off_t)volume_length(self, i)) != 0)
+    {
+      result = RESULT_IO_ERROR;
+    }
+  }
+  self->count = count;
+
+  for (DWord i = count; result == RESULT_OK; i++)
+  {
+    char* path = volume_path(self, i);
+    if (path == NULL)
+    {
+      result = RESULT_MEMORY_ERROR;
+      break;
+    }
+    bool removed = unlink(path) == 0;
+    free(path);
+    if (!removed)
+    {
+      break;
+    }
+  }
+
+  VolumeManifest header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.signature, VOLUME_SET_SIGNATURE, VOLUME_SET_SIGNATURE_SIZE);
+  header.version = VOLUME_SET_VERSION;
+  header.volume_count = count;
+  header.volume_size = self->volume_size;
+  header.total_size = self->size;
+
+  if (result == RESULT_OK &&
+      (fseek(manifest, 0, SEEK_SET) != 0 ||
+       fwrite(&header, 1, sizeof(header), manifest) != sizeof(header) ||
+       fflush(manifest) != 0))
+  {
+    result = RESULT_IO_ERROR;
+  }
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при завершении томов: %s\n", self->path);
+  }
+  return result;
+}
+
+QWord volume_set_get_size(const VolumeSet* self)
+{
+  return self ? self->size : 0;
+}
+
+DWord volume_set_get_count(const VolumeSet* self)
+{
+  return self ? self->count : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef FILE_SYSTEM_VOLUME_SET_H
+#define FILE_SYSTEM_VOLUME_SET_H
+
+#include <stdio.h>
+
+#include "types.h"
+
+// Многотомный файл: логические байты лежат подряд в томах path.001,
+// path.002, ... одинакового размера (последний короче), а по самому пути
+// лежит манифест с размером тома и общим размером. Тома открываются при
+// первом обращении к их байтам
+typedef struct VolumeSet VolumeSet;
+
+#define VOLUME_SET_SIGNATURE "lkvolset"
+#define VOLUME_SET_SIGNATURE_SIZE 8
+#define VOLUME_SET_VERSION 1
+// Потоков чтения участка, захватывающего несколько томов
+#define VOLUME_SET_READ_THREADS 8
+// Участки короче читаются из томов по очереди: потоки дороже чтения
+#define VOLUME_SET_PARALLEL_MIN (256 * 1024)
+// Открытых томов одного набора (не меньше VOLUME_SET_READ_THREADS);
+// остальные закрываются по давности использования, чтобы число
+// дескрипторов не росло с числом томов
+#define VOLUME_SET_OPEN_LIMIT VOLUME_SET_READ_THREADS
+
+typedef struct
+{
+  char signature[VOLUME_SET_SIGNATURE_SIZE];  // 8 Байт
+  DWord version;                              // 4 Байта
+  DWord volume_count;                         // 4 Байта
+  QWord volume_size;                          // 8 Байт
+  QWord total_size;                           // 8 Байт
+} VolumeManifest;
+
+// Набор для записи, тома создаются по мере записи
+VolumeSet* volume_set_create(const char* path, QWord volume_size);
+// Читает манифест из открытого manifest. Если это не манифест, *volumes
+// остается NULL, а позиция manifest возвращается в начало
+Result volume_set_open(const char* path, FILE* manifest, VolumeSet** volumes);
+// Закрывает тома; манифест не пишется
+void volume_set_destroy(VolumeSet* self);
+
+// Завершает запись: доводит тома до их размеров (дыры в конце тома
+// остаются дырами), удаляет лишние тома прежнего набора и пишет манифест.
+// Для набора, открытого на чтение, ничего не делает
+Result volume_set_finish(VolumeSet* self, FILE* manifest);
+
+// Дескриптор тома с байтом offset, смещение в томе и число байт до конца
+// тома (при чтении - и до конца данных). Дескриптор принадлежит набору и
+// может быть закрыт при открытии VOLUME_SET_OPEN_LIMIT других томов
+Result volume_set_locate(VolumeSet* self, QWord offset, int* descriptor,
+                         QWord* local_offset, QWord* available);
+// Участок из нескольких томов читается потоками, по тому на поток
+Result volume_set_read_at(VolumeSet* self, Byte* buffer, Size size,
+                          QWord offset);
+Result volume_set_write_at(VolumeSet* self, const Byte* data, Size size,
+                           QWord offset);
+// Учитывает байты, записанные в дескрипторы из volume_set_locate мимо
+// volume_set_write_at
+void volume_set_extend(VolumeSet* self, QWord end);
+
+QWord volume_set_get_size(const VolumeSet* self);
+DWord volume_set_get_count(const VolumeSet* self);
+
+#endif  // FILE_SYSTEM_VOLUME_SET_H
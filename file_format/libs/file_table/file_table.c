@@ -1,14 +1,15 @@
 #include "file_table.h"
 
-#include <dirent.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
 
-#include "path_utils.h"
+#include "directory_walker.h"
+#include "log.h"
 
 #define INITIAL_CAPACITY 16
+// Предел числа областей разреженного файла: карта с большим числом
+// областей не строится, а при чтении считается поврежденной
+#define SPARSE_EXTENT_LIMIT (1U << 20)
 
 struct FileTable
 {
@@ -17,6 +18,16 @@ struct FileTable
   DWord capacity;
   QWord total_original_size;
   QWord total_compressed_size;
+  FileSparseMap* sparse_maps;
+  DWord sparse_count;
+  DWord sparse_capacity;
+  FileDedupMap* dedup_maps;
+  DWord dedup_count;
+  DWord dedup_capacity;
+  QWord* mtimes;  // По записи на элемент entries или NULL
+  FileSolidBlock* solid_blocks;
+  DWord solid_count;
+  DWord solid_capacity;
 };
 
 FileTable* file_table_create(void)
@@ -24,14 +35,14 @@ FileTable* file_table_create(void)
   FileTable* table = (FileTable*)malloc(sizeof(FileTable));
   if (table == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
   table->entries = (FileEntry*)malloc(sizeof(FileEntry) * INITIAL_CAPACITY);
   if (table->entries == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     free(table);
     return NULL;
   }
@@ -40,6 +51,16 @@ FileTable* file_table_create(void)
   table->capacity = INITIAL_CAPACITY;
   table->total_original_size = 0;
   table->total_compressed_size = 0;
+  table->sparse_maps = NULL;
+  table->sparse_count = 0;
+  table->sparse_capacity = 0;
+  table->dedup_maps = NULL;
+  table->dedup_count = 0;
+  table->dedup_capacity = 0;
+  table->mtimes = NULL;
+  table->solid_blocks = NULL;
+  table->solid_count = 0;
+  table->solid_capacity = 0;
   return table;
 }
 
@@ -50,21 +71,80 @@ void file_table_destroy(FileTable* self)
     return;
   }
 
+  for (DWord i = 0; i < self->sparse_count; i++)
+  {
+    free(self->sparse_maps[i].extents);
+  }
+  free(self->sparse_maps);
+  for (DWord i = 0; i < self->dedup_count; i++)
+  {
+    free(self->dedup_maps[i].runs);
+  }
+  free(self->dedup_maps);
+  free(self->mtimes);
+  free(self->solid_blocks);
   free(self->entries);
   free(self);
 }
 
+static Result file_table_add_sparse_map(FileTable* self, DWord entry_index,
+                                        QWord logical_size,
+                                        FileExtent* extents,
+                                        DWord extent_count)
+{
+  if (self->sparse_count >= self->sparse_capacity)
+  {
+    DWord new_capacity =
+      self->sparse_capacity == 0 ? INITIAL_CAPACITY : self->sparse_capacity * 2;
+    FileSparseMap* new_maps = (FileSparseMap*)realloc(
+      self->sparse_maps, sizeof(FileSparseMap) * new_capacity);
+    if (new_maps == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при перевыделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    self->sparse_maps = new_maps;
+    self->sparse_capacity = new_capacity;
+  }
+
+  FileSparseMap* map = &self->sparse_maps[self->sparse_count++];
+  map->entry_index = entry_index;
+  map->logical_size = logical_size;
+  map->extent_count = extent_count;
+  map->extents = extents;
+  return RESULT_OK;
+}
+
 static Result file_table_resize(FileTable* self, DWord new_capacity)
 {
   FileEntry* new_entries =
     (FileEntry*)realloc(self->entries, sizeof(FileEntry) * new_capacity);
   if (new_entries == NULL)
   {
-    printf("Произошла ошибка при перевыделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при перевыделении памяти!\n");
     return RESULT_MEMORY_ERROR;
   }
 
   self->entries = new_entries;
+
+  if (self->mtimes != NULL)
+  {
+    QWord* new_mtimes =
+      (QWord*)realloc(self->mtimes, sizeof(QWord) * new_capacity);
+    if (new_mtimes == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при перевыделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    self->mtimes = new_mtimes;
+    for (DWord i = self->capacity; i < new_capacity; i++)
+    {
+      self->mtimes[i] = 0;
+    }
+  }
+
   self->capacity = new_capacity;
   return RESULT_OK;
 }
@@ -85,99 +165,483 @@ Result file_table_add_file(FileTable* self, const char* filename, QWord size)
     }
   }
 
+  // Дыры разреженного файла в архив не попадают: запоминаем области с
+  // данными, а размер записи уменьшаем до их суммарной длины
+  QWord data_size = size;
+  FileExtent* extents = NULL;
+  DWord extent_count = 0;
+  if (size > 0 && file_find_data_extents(filename, size, &extents,
+                                         &extent_count) == RESULT_OK)
+  {
+    data_size = 0;
+    for (DWord i = 0; i < extent_count; i++)
+    {
+      data_size += extents[i].length;
+    }
+
+    if (data_size < size && extent_count <= SPARSE_EXTENT_LIMIT)
+    {
+      Result result = file_table_add_sparse_map(self, self->count, size,
+                                                extents, extent_count);
+      if (result != RESULT_OK)
+      {
+        free(extents);
+        return result;
+      }
+
+      LOG_DEBUG("Разреженный файл: %s (данные: %llu из %llu байт, областей: "
+                "%u)\n", filename, (unsigned long long)data_size,
+                (unsigned long long)size, extent_count);
+    }
+    else
+    {
+      data_size = size;
+      free(extents);
+    }
+  }
+
   FileEntry* entry = &self->entries[self->count];
   strncpy(entry->filename, filename, FILENAME_LIMIT - 1);
   entry->filename[FILENAME_LIMIT - 1] = '\0';
-  entry->original_size = size;
-  entry->compressed_size = size;
+  entry->original_size = data_size;
+  entry->compressed_size = data_size;
   entry->offset = 0;
   entry->crc = 0;
 
   self->count++;
-  self->total_original_size += size;
-  self->total_compressed_size += size;
+  self->total_original_size += data_size;
+  self->total_compressed_size += data_size;
 
   return RESULT_OK;
 }
 
-static Result file_table_add_directory_recursive(FileTable* self,
-                                                 const char* dirname)
+Result file_table_add_directory(FileTable* self, const char* dirname)
 {
-  DIR* dir = opendir(dirname);
-  if (dir == NULL)
+  if (self == NULL || dirname == NULL)
   {
-    return RESULT_IO_ERROR;
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  DirectoryWalker* walker = directory_walker_create(0);
+  if (walker == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
   }
 
-  struct dirent* entry;
-  while ((entry = readdir(dir)) != NULL)
+  Result result = directory_walker_walk(walker, dirname, true);
+  for (Size i = 0;
+       result == RESULT_OK && i < directory_walker_get_count(walker); i++)
   {
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+    const DirectoryWalkEntry* entry = directory_walker_get_entry(walker, i);
+    if (!entry->is_directory)
     {
-      continue;
+      result = file_table_add_file(self, entry->path, entry->size);
     }
+  }
+
+  directory_walker_destroy(walker);
+  return result;
+}
+
+DWord file_table_get_count(const FileTable* self)
+{
+  return self ? self->count : 0;
+}
+
+const FileEntry* file_table_get_entry(const FileTable* self, DWord index)
+{
+  if (self == NULL || index >= self->count)
+  {
+    return NULL;
+  }
 
-    char* full_path = path_utils_join(dirname, entry->d_name);
-    if (full_path == NULL)
+  return &self->entries[index];
+}
+
+QWord file_table_get_total_size(const FileTable* self)
+{
+  return self ? self->total_original_size : 0;
+}
+
+QWord file_table_get_file_size(const FileTable* self, DWord index)
+{
+  const FileEntry* entry = file_table_get_entry(self, index);
+  if (entry == NULL)
+  {
+    return 0;
+  }
+
+  const FileSparseMap* sparse_map = file_table_get_sparse_map(self, index);
+  if (sparse_map != NULL)
+  {
+    return sparse_map->logical_size;
+  }
+
+  const FileDedupMap* dedup_map = file_table_get_dedup_map(self, index);
+  return dedup_map != NULL ? dedup_map->data_size : entry->original_size;
+}
+
+Result file_table_set_mtime(FileTable* self, DWord index, QWord mtime)
+{
+  if (self == NULL || index >= self->count)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (self->mtimes == NULL)
+  {
+    self->mtimes = (QWord*)calloc(self->capacity, sizeof(QWord));
+    if (self->mtimes == NULL)
     {
-      closedir(dir);
+      LOG_ERROR("Произошла ошибка при выделении памяти!\n");
       return RESULT_MEMORY_ERROR;
     }
+  }
+
+  self->mtimes[index] = mtime;
+  return RESULT_OK;
+}
+
+QWord file_table_get_mtime(const FileTable* self, DWord index)
+{
+  if (self == NULL || self->mtimes == NULL || index >= self->count)
+  {
+    return 0;
+  }
 
-    if (entry->d_type == DT_DIR)
+  return self->mtimes[index];
+}
+
+bool file_table_has_mtimes(const FileTable* self)
+{
+  return self != NULL && self->mtimes != NULL && self->count > 0;
+}
+
+bool file_table_has_sparse_files(const FileTable* self)
+{
+  return self != NULL && self->sparse_count > 0;
+}
+
+// Карты упорядочены по записям, поэтому поиск двоичный
+const FileSparseMap* file_table_get_sparse_map(const FileTable* self,
+                                               DWord index)
+{
+  if (self == NULL)
+  {
+    return NULL;
+  }
+
+  DWord low = 0;
+  DWord high = self->sparse_count;
+  while (low < high)
+  {
+    DWord middle = low + (high - low) / 2;
+    DWord entry_index = self->sparse_maps[middle].entry_index;
+    if (index < entry_index)
     {
-      Result result = file_table_add_directory_recursive(self, full_path);
-      if (result != RESULT_OK)
-      {
-        free(full_path);
-        closedir(dir);
-        return result;
-      }
+      high = middle;
+    }
+    else if (index > entry_index)
+    {
+      low = middle + 1;
     }
     else
     {
-      struct stat stats;
-      if (stat(full_path, &stats) == 0)
-      {
-        file_table_add_file(self, full_path, stats.st_size);
-      }
+      return &self->sparse_maps[middle];
+    }
+  }
+
+  return NULL;
+}
+
+static bool is_novel_run(const FileDedupMap* map, const FileChunkRun* run,
+                         QWord stored_size)
+{
+  return run->source_index == map->entry_index && run->offset == stored_size;
+}
+
+static QWord dedup_stored_size(const FileDedupMap* map)
+{
+  QWord stored_size = 0;
+  for (DWord i = 0; i < map->run_count; i++)
+  {
+    if (is_novel_run(map, &map->runs[i], stored_size))
+    {
+      stored_size += map->runs[i].length;
+    }
+  }
+
+  return stored_size;
+}
+
+// Первая карта с записью не меньше index
+static DWord dedup_map_lower_bound(const FileTable* self, DWord index)
+{
+  DWord low = 0;
+  DWord high = self->dedup_count;
+  while (low < high)
+  {
+    DWord middle = low + (high - low) / 2;
+    if (self->dedup_maps[middle].entry_index < index)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+// Карты хранятся по возрастанию записей: построитель добавляет их по
+// порядку, и вставка в середину почти не встречается
+static Result file_table_add_dedup_map(FileTable* self, DWord entry_index,
+                                       QWord data_size, FileChunkRun* runs,
+                                       DWord run_count)
+{
+  if (self->dedup_count >= self->dedup_capacity)
+  {
+    DWord new_capacity =
+      self->dedup_capacity == 0 ? INITIAL_CAPACITY : self->dedup_capacity * 2;
+    FileDedupMap* new_maps = (FileDedupMap*)realloc(
+      self->dedup_maps, sizeof(FileDedupMap) * new_capacity);
+    if (new_maps == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при перевыделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
     }
 
-    free(full_path);
+    self->dedup_maps = new_maps;
+    self->dedup_capacity = new_capacity;
   }
 
-  closedir(dir);
+  DWord position = dedup_map_lower_bound(self, entry_index);
+  FileDedupMap* map = &self->dedup_maps[position];
+  memmove(map + 1, map, sizeof(FileDedupMap) * (self->dedup_count - position));
+  self->dedup_count++;
+  map->entry_index = entry_index;
+  map->data_size = data_size;
+  map->run_count = run_count;
+  map->runs = runs;
   return RESULT_OK;
 }
 
-Result file_table_add_directory(FileTable* self, const char* dirname)
+Result file_table_set_dedup_map(FileTable* self, DWord index, QWord data_size,
+                                FileChunkRun* runs, DWord run_count)
 {
-  if (self == NULL || dirname == NULL)
+  if (self == NULL || index >= self->count || runs == NULL ||
+      run_count == 0 || file_table_get_dedup_map(self, index) != NULL)
   {
     return RESULT_INVALID_ARGUMENT;
   }
 
-  return file_table_add_directory_recursive(self, dirname);
+  Result result =
+    file_table_add_dedup_map(self, index, data_size, runs, run_count);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  FileEntry* entry = &self->entries[index];
+  QWord stored_size = dedup_stored_size(file_table_get_dedup_map(self, index));
+  self->total_original_size -= entry->original_size - stored_size;
+  self->total_compressed_size -= entry->compressed_size - stored_size;
+  entry->original_size = stored_size;
+  entry->compressed_size = stored_size;
+
+  LOG_DEBUG("Дедупликация: %s (хранится %llu из %llu байт, участков: %u)\n",
+            entry->filename, (unsigned long long)stored_size,
+            (unsigned long long)data_size, run_count);
+  return RESULT_OK;
 }
 
-DWord file_table_get_count(const FileTable* self)
+bool file_table_has_dedup_files(const FileTable* self)
 {
-  return self ? self->count : 0;
+  return self != NULL && self->dedup_count > 0;
 }
 
-const FileEntry* file_table_get_entry(const FileTable* self, DWord index)
+const FileDedupMap* file_table_get_dedup_map(const FileTable* self,
+                                             DWord index)
 {
-  if (self == NULL || index >= self->count)
+  if (self == NULL)
   {
     return NULL;
   }
 
-  return &self->entries[index];
+  DWord position = dedup_map_lower_bound(self, index);
+  return position < self->dedup_count &&
+             self->dedup_maps[position].entry_index == index
+           ? &self->dedup_maps[position]
+           : NULL;
 }
 
-QWord file_table_get_total_size(const FileTable* self)
+Result file_table_add_solid_block(FileTable* self, DWord first_entry,
+                                  DWord entry_count, QWord data_size)
 {
-  return self ? self->total_original_size : 0;
+  if (self == NULL || entry_count == 0 || first_entry >= self->count ||
+      entry_count > self->count - first_entry)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (self->solid_count > 0)
+  {
+    const FileSolidBlock* last = &self->solid_blocks[self->solid_count - 1];
+    if (first_entry < last->first_entry + last->entry_count)
+    {
+      return RESULT_INVALID_ARGUMENT;
+    }
+  }
+
+  if (self->solid_count >= self->solid_capacity)
+  {
+    DWord new_capacity =
+      self->solid_capacity == 0 ? INITIAL_CAPACITY : self->solid_capacity * 2;
+    FileSolidBlock* new_blocks = (FileSolidBlock*)realloc(
+      self->solid_blocks, sizeof(FileSolidBlock) * new_capacity);
+    if (new_blocks == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при перевыделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    self->solid_blocks = new_blocks;
+    self->solid_capacity = new_capacity;
+  }
+
+  FileSolidBlock* block = &self->solid_blocks[self->solid_count++];
+  block->first_entry = first_entry;
+  block->entry_count = entry_count;
+  block->offset = 0;
+  block->compressed_size = 0;
+  block->data_size = data_size;
+  return RESULT_OK;
+}
+
+void file_table_clear_solid_blocks(FileTable* self)
+{
+  if (self != NULL)
+  {
+    self->solid_count = 0;
+  }
+}
+
+bool file_table_has_solid_blocks(const FileTable* self)
+{
+  return self != NULL && self->solid_count > 0;
+}
+
+DWord file_table_get_solid_block_count(const FileTable* self)
+{
+  return self != NULL ? self->solid_count : 0;
+}
+
+const FileSolidBlock* file_table_get_solid_block(const FileTable* self,
+                                                 DWord block)
+{
+  if (self == NULL || block >= self->solid_count)
+  {
+    return NULL;
+  }
+
+  return &self->solid_blocks[block];
+}
+
+// Блоки упорядочены по записям, поэтому поиск двоичный
+DWord file_table_find_solid_block(const FileTable* self, DWord index)
+{
+  if (self == NULL)
+  {
+    return FILE_TABLE_NO_ENTRY;
+  }
+
+  DWord low = 0;
+  DWord high = self->solid_count;
+  while (low < high)
+  {
+    DWord middle = low + (high - low) / 2;
+    const FileSolidBlock* block = &self->solid_blocks[middle];
+    if (index < block->first_entry)
+    {
+      high = middle;
+    }
+    else if (index - block->first_entry >= block->entry_count)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      return middle;
+    }
+  }
+
+  return FILE_TABLE_NO_ENTRY;
+}
+
+// Из прочитанных данных дедуплицированного файла остаются только новые
+// участки, в том порядке, в каком они хранятся в архиве
+static Result keep_novel_runs(const FileDedupMap* map, File* file)
+{
+  if (file_get_size(file) != map->data_size)
+  {
+    LOG_ERROR("Файл изменился после добавления в архив: %s\n",
+              file_get_path(file));
+    return RESULT_IO_ERROR;
+  }
+
+  FileExtent* extents =
+    (FileExtent*)malloc(sizeof(FileExtent) * map->run_count);
+  if (extents == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  DWord count = 0;
+  QWord position = 0;
+  QWord stored_size = 0;
+  for (DWord i = 0; i < map->run_count; i++)
+  {
+    if (is_novel_run(map, &map->runs[i], stored_size))
+    {
+      extents[count].offset = position;
+      extents[count].length = map->runs[i].length;
+      stored_size += map->runs[i].length;
+      count++;
+    }
+    position += map->runs[i].length;
+  }
+
+  Result result = file_keep_extents(file, extents, count);
+  free(extents);
+  return result;
+}
+
+// Чтение содержимого записи index из файла: для разреженных файлов
+// читаются только области с данными, для дедуплицированных остаются только
+// новые участки
+Result file_table_read_entry_data(const FileTable* self, DWord index,
+                                  File* file)
+{
+  if (self == NULL || file == NULL || index >= self->count)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  const FileSparseMap* map = file_table_get_sparse_map(self, index);
+  Result result = map != NULL
+                    ? file_read_extents(file, map->extents, map->extent_count)
+                    : file_read_bytes(file);
+
+  const FileDedupMap* dedup_map = file_table_get_dedup_map(self, index);
+  if (result == RESULT_OK && dedup_map != NULL)
+  {
+    result = keep_novel_runs(dedup_map, file);
+  }
+
+  return result;
 }
 
 Result file_table_write(const FileTable* self, File* file)
@@ -214,33 +678,726 @@ Result file_table_read(FileTable* self, File* file)
     return RESULT_INVALID_ARGUMENT;
   }
 
-  Result result =
-    file_read_bytes_size(file, (Byte*)&self->count, sizeof(self->count));
+  DWord count = 0;
+  Result result = file_read_bytes_size(file, (Byte*)&count, sizeof(count));
   if (result != RESULT_OK)
   {
-    printf("Произошла ошибка при чтении количества файлов в таблице файлов!\n");
+    LOG_ERROR("Произошла ошибка при чтении количества файлов в таблице "
+              "файлов!\n");
     return result;
   }
 
-  self->entries = (FileEntry*)malloc(sizeof(FileEntry) * self->count);
-  if (self->entries == NULL)
+  // Емкость не меньше числа записей: таблицу можно дополнять (дозапись)
+  DWord capacity = count > INITIAL_CAPACITY ? count : INITIAL_CAPACITY;
+  FileEntry* entries = (FileEntry*)malloc(sizeof(FileEntry) * capacity);
+  if (entries == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return RESULT_MEMORY_ERROR;
   }
 
-  for (DWord i = 0; i < self->count; i++)
+  QWord total_original_size = 0;
+  QWord total_compressed_size = 0;
+  for (DWord i = 0; i < count; i++)
   {
-    result =
-      file_read_bytes_size(file, (Byte*)&self->entries[i], sizeof(FileEntry));
+    result = file_read_bytes_size(file, (Byte*)&entries[i], sizeof(FileEntry));
     if (result != RESULT_OK)
     {
-      printf(
-        "Произошла ошибка при чтении конкретного файла из таблицы файлов!\n");
-      free(self->entries);
+      LOG_ERROR("Произошла ошибка при чтении конкретного файла из таблицы "
+                "файлов!\n");
+      free(entries);
       return result;
     }
+
+    entries[i].filename[FILENAME_LIMIT - 1] = '\0';
+    total_original_size += entries[i].original_size;
+    total_compressed_size += entries[i].compressed_size;
+  }
+
+  free(self->entries);
+  free(self->mtimes);
+  self->entries = entries;
+  self->mtimes = NULL;
+  self->count = count;
+  self->capacity = capacity;
+  self->total_original_size = total_original_size;
+  self->total_compressed_size = total_compressed_size;
+  return RESULT_OK;
+}
+
+Size file_table_get_sparse_maps_size(const FileTable* self)
+{
+  if (self == NULL || self->sparse_count == 0)
+  {
+    return 0;
+  }
+
+  Size size = sizeof(DWord);
+  for (DWord i = 0; i < self->sparse_count; i++)
+  {
+    size += sizeof(DWord) + sizeof(QWord) + sizeof(DWord);
+    size += self->sparse_maps[i].extent_count * 2 * sizeof(QWord);
+  }
+
+  return size;
+}
+
+// Формат: DWord количество карт, затем для каждой карты
+// DWord индекс записи, QWord полный размер, DWord количество областей и
+// пары QWord (смещение, длина)
+Result file_table_write_sparse_maps(const FileTable* self, File* file)
+{
+  if (self == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Result result = file_write_bytes(file, (const Byte*)&self->sparse_count,
+                                   sizeof(self->sparse_count));
+
+  for (DWord i = 0; i < self->sparse_count && result == RESULT_OK; i++)
+  {
+    const FileSparseMap* map = &self->sparse_maps[i];
+
+    result = file_write_bytes(file, (const Byte*)&map->entry_index,
+                              sizeof(map->entry_index));
+    if (result == RESULT_OK)
+    {
+      result = file_write_bytes(file, (const Byte*)&map->logical_size,
+                                sizeof(map->logical_size));
+    }
+    if (result == RESULT_OK)
+    {
+      result = file_write_bytes(file, (const Byte*)&map->extent_count,
+                                sizeof(map->extent_count));
+    }
+
+    for (DWord j = 0; j < map->extent_count && result == RESULT_OK; j++)
+    {
+      result = file_write_bytes(file, (const Byte*)&map->extents[j].offset,
+                                sizeof(QWord));
+      if (result == RESULT_OK)
+      {
+        result = file_write_bytes(file, (const Byte*)&map->extents[j].length,
+                                  sizeof(QWord));
+      }
+    }
+  }
+
+  return result;
+}
+
+// Карты идут по возрастанию записей, области - по возрастанию смещений,
+// не пересекаются, не пусты и лежат внутри полного размера файла
+static bool validate_sparse_map(const FileTable* self, const FileSparseMap* map)
+{
+  if (map != self->sparse_maps && map[-1].entry_index >= map->entry_index)
+  {
+    return false;
+  }
+
+  QWord end = 0;
+  for (DWord i = 0; i < map->extent_count; i++)
+  {
+    const FileExtent* extent = &map->extents[i];
+    if (extent->length == 0 || extent->offset < end ||
+        extent->offset > map->logical_size ||
+        extent->length > map->logical_size - extent->offset)
+    {
+      return false;
+    }
+    end = extent->offset + extent->length;
+  }
+
+  return true;
+}
+
+Result file_table_read_sparse_maps(FileTable* self, File* file)
+{
+  if (self == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  DWord map_count = 0;
+  Result result =
+    file_read_bytes_size(file, (Byte*)&map_count, sizeof(map_count));
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при чтении карт разреженных файлов!\n");
+    return result;
+  }
+
+  for (DWord i = 0; i < map_count; i++)
+  {
+    DWord entry_index = 0;
+    QWord logical_size = 0;
+    DWord extent_count = 0;
+
+    result =
+      file_read_bytes_size(file, (Byte*)&entry_index, sizeof(entry_index));
+    if (result == RESULT_OK)
+    {
+      result =
+        file_read_bytes_size(file, (Byte*)&logical_size, sizeof(logical_size));
+    }
+    if (result == RESULT_OK)
+    {
+      result =
+        file_read_bytes_size(file, (Byte*)&extent_count, sizeof(extent_count));
+    }
+    if (result != RESULT_OK || entry_index >= self->count ||
+        extent_count > SPARSE_EXTENT_LIMIT)
+    {
+      LOG_ERROR("Произошла ошибка при чтении карт разреженных файлов!\n");
+      return result != RESULT_OK ? result : RESULT_ERROR;
+    }
+
+    FileExtent* extents = (FileExtent*)malloc(
+      sizeof(FileExtent) * (extent_count > 0 ? extent_count : 1));
+    if (extents == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    for (DWord j = 0; j < extent_count && result == RESULT_OK; j++)
+    {
+      result = file_read_bytes_size(file, (Byte*)&extents[j].offset,
+                                    sizeof(QWord));
+      if (result == RESULT_OK)
+      {
+        result = file_read_bytes_size(file, (Byte*)&extents[j].length,
+                                      sizeof(QWord));
+      }
+    }
+
+    if (result == RESULT_OK)
+    {
+      result = file_table_add_sparse_map(self, entry_index, logical_size,
+                                         extents, extent_count);
+    }
+    if (result == RESULT_OK &&
+        !validate_sparse_map(self, &self->sparse_maps[self->sparse_count - 1]))
+    {
+      self->sparse_count--;
+      result = RESULT_ERROR;
+    }
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("Произошла ошибка при чтении карт разреженных файлов!\n");
+      free(extents);
+      return result;
+    }
+  }
+
+  return RESULT_OK;
+}
+
+Result file_table_check_sparse_sizes(const FileTable* self)
+{
+  if (self == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  for (DWord i = 0; i < self->sparse_count; i++)
+  {
+    const FileSparseMap* map = &self->sparse_maps[i];
+    QWord total = 0;
+    for (DWord j = 0; j < map->extent_count; j++)
+    {
+      total += map->extents[j].length;
+    }
+
+    const FileDedupMap* dedup_map =
+      file_table_get_dedup_map(self, map->entry_index);
+    QWord data_size = dedup_map != NULL
+                        ? dedup_map->data_size
+                        : self->entries[map->entry_index].original_size;
+    if (total != data_size)
+    {
+      LOG_ERROR("Карта разреженного файла не совпадает с его данными: %s\n",
+                self->entries[map->entry_index].filename);
+      return RESULT_ERROR;
+    }
+  }
+
+  return RESULT_OK;
+}
+
+Size file_table_get_dedup_maps_size(const FileTable* self)
+{
+  if (self == NULL || self->dedup_count == 0)
+  {
+    return 0;
+  }
+
+  Size size = sizeof(DWord);
+  for (DWord i = 0; i < self->dedup_count; i++)
+  {
+    size += sizeof(DWord) + sizeof(QWord) + sizeof(DWord);
+    size += self->dedup_maps[i].run_count *
+            (sizeof(DWord) + 2 * sizeof(QWord));
+  }
+
+  return size;
+}
+
+// Формат: DWord количество карт, затем для каждой карты DWord индекс
+// записи, QWord размер до дедупликации, DWord количество участков и тройки
+// (DWord запись-источник, QWord смещение, QWord длина)
+Result file_table_write_dedup_maps(const FileTable* self, File* file)
+{
+  if (self == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Result result = file_write_bytes(file, (const Byte*)&self->dedup_count,
+                                   sizeof(self->dedup_count));
+
+  for (DWord i = 0; i < self->dedup_count && result == RESULT_OK; i++)
+  {
+    const FileDedupMap* map = &self->dedup_maps[i];
+
+    result = file_write_bytes(file, (const Byte*)&map->entry_index,
+                              sizeof(map->entry_index));
+    if (result == RESULT_OK)
+    {
+      result = file_write_bytes(file, (const Byte*)&map->data_size,
+                                sizeof(map->data_size));
+    }
+    if (result == RESULT_OK)
+    {
+      result = file_write_bytes(file, (const Byte*)&map->run_count,
+                                sizeof(map->run_count));
+    }
+
+    for (DWord j = 0; j < map->run_count && result == RESULT_OK; j++)
+    {
+      const FileChunkRun* run = &map->runs[j];
+      result = file_write_bytes(file, (const Byte*)&run->source_index,
+                                sizeof(run->source_index));
+      if (result == RESULT_OK)
+      {
+        result =
+          file_write_bytes(file, (const Byte*)&run->offset, sizeof(QWord));
+      }
+      if (result == RESULT_OK)
+      {
+        result =
+          file_write_bytes(file, (const Byte*)&run->length, sizeof(QWord));
+      }
+    }
+  }
+
+  return result;
+}
+
+// Участки должны покрывать data_size, а новые данные - совпадать с
+// original_size записи; ссылки на свою запись - только назад
+static bool validate_dedup_map(const FileTable* self, const FileDedupMap* map)
+{
+  QWord total = 0;
+  QWord stored_size = 0;
+  for (DWord i = 0; i < map->run_count; i++)
+  {
+    const FileChunkRun* run = &map->runs[i];
+    if (run->source_index >= self->count || run->length == 0)
+    {
+      return false;
+    }
+
+    if (is_novel_run(map, run, stored_size))
+    {
+      stored_size += run->length;
+    }
+    else if (run->source_index == map->entry_index &&
+             run->offset + run->length > stored_size)
+    {
+      return false;
+    }
+    total += run->length;
+  }
+
+  return total == map->data_size &&
+         stored_size == self->entries[map->entry_index].original_size;
+}
+
+Result file_table_read_dedup_maps(FileTable* self, File* file)
+{
+  if (self == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  DWord map_count = 0;
+  Result result =
+    file_read_bytes_size(file, (Byte*)&map_count, sizeof(map_count));
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при чтении карт дедупликации!\n");
+    return result;
+  }
+
+  for (DWord i = 0; i < map_count; i++)
+  {
+    DWord entry_index = 0;
+    QWord data_size = 0;
+    DWord run_count = 0;
+
+    result =
+      file_read_bytes_size(file, (Byte*)&entry_index, sizeof(entry_index));
+    if (result == RESULT_OK)
+    {
+      result = file_read_bytes_size(file, (Byte*)&data_size, sizeof(data_size));
+    }
+    if (result == RESULT_OK)
+    {
+      result = file_read_bytes_size(file, (Byte*)&run_count, sizeof(run_count));
+    }
+    if (result != RESULT_OK || entry_index >= self->count || run_count == 0 ||
+        (self->dedup_count > 0 &&
+         self->dedup_maps[self->dedup_count - 1].entry_index >= entry_index))
+    {
+      LOG_ERROR("Произошла ошибка при чтении карт дедупликации!\n");
+      return result != RESULT_OK ? result : RESULT_ERROR;
+    }
+
+    FileChunkRun* runs =
+      (FileChunkRun*)malloc(sizeof(FileChunkRun) * run_count);
+    if (runs == NULL)
+    {
+      LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    for (DWord j = 0; j < run_count && result == RESULT_OK; j++)
+    {
+      result = file_read_bytes_size(file, (Byte*)&runs[j].source_index,
+                                    sizeof(DWord));
+      if (result == RESULT_OK)
+      {
+        result =
+          file_read_bytes_size(file, (Byte*)&runs[j].offset, sizeof(QWord));
+      }
+      if (result == RESULT_OK)
+      {
+        result =
+          file_read_bytes_size(file, (Byte*)&runs[j].length, sizeof(QWord));
+      }
+    }
+
+    if (result == RESULT_OK)
+    {
+      result =
+        file_table_add_dedup_map(self, entry_index, data_size, runs, run_count);
+    }
+    if (result == RESULT_OK &&
+        !validate_dedup_map(self, &self->dedup_maps[self->dedup_count - 1]))
+    {
+      self->dedup_count--;
+      result = RESULT_ERROR;
+    }
+    if (result != RESULT_OK)
+    {
+      LOG_ERROR("Произошла ошибка при чтении карт дедупликации!\n");
+      free(runs);
+      return result;
+    }
+  }
+
+  return RESULT_OK;
+}
+
+Size file_table_get_solid_blocks_size(const FileTable* self)
+{
+  if (self == NULL || self->solid_count == 0)
+  {
+    return 0;
+  }
+
+  return sizeof(DWord) +
+         self->solid_count * (2 * sizeof(DWord) + 3 * sizeof(QWord));
+}
+
+// Формат: DWord количество блоков, затем для каждого DWord первая запись,
+// DWord число записей, QWord смещение, QWord сжатый размер и QWord размер
+// данных
+Result file_table_write_solid_blocks(const FileTable* self, File* file)
+{
+  if (self == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Result result = file_write_bytes(file, (const Byte*)&self->solid_count,
+                                   sizeof(self->solid_count));
+
+  for (DWord i = 0; i < self->solid_count && result == RESULT_OK; i++)
+  {
+    const FileSolidBlock* block = &self->solid_blocks[i];
+    result = file_write_bytes(file, (const Byte*)&block->first_entry,
+                              sizeof(DWord));
+    if (result == RESULT_OK)
+    {
+      result = file_write_bytes(file, (const Byte*)&block->entry_count,
+                                sizeof(DWord));
+    }
+    if (result == RESULT_OK)
+    {
+      result =
+        file_write_bytes(file, (const Byte*)&block->offset, sizeof(QWord));
+    }
+    if (result == RESULT_OK)
+    {
+      result = file_write_bytes(file, (const Byte*)&block->compressed_size,
+                                sizeof(QWord));
+    }
+    if (result == RESULT_OK)
+    {
+      result =
+        file_write_bytes(file, (const Byte*)&block->data_size, sizeof(QWord));
+    }
+  }
+
+  return result;
+}
+
+// Данные участников должны лежать внутри блока, а их сумма - совпадать с
+// размером блока
+static bool validate_solid_block(const FileTable* self,
+                                 const FileSolidBlock* block)
+{
+  QWord total = 0;
+  for (DWord i = 0; i < block->entry_count; i++)
+  {
+    const FileEntry* entry = &self->entries[block->first_entry + i];
+    if (entry->offset > block->data_size ||
+        entry->original_size > block->data_size - entry->offset)
+    {
+      return false;
+    }
+    total += entry->original_size;
+  }
+
+  return total == block->data_size;
+}
+
+Result file_table_read_solid_blocks(FileTable* self, File* file)
+{
+  if (self == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  DWord block_count = 0;
+  Result result =
+    file_read_bytes_size(file, (Byte*)&block_count, sizeof(block_count));
+
+  self->solid_count = 0;
+  for (DWord i = 0; i < block_count && result == RESULT_OK; i++)
+  {
+    FileSolidBlock block;
+    result =
+      file_read_bytes_size(file, (Byte*)&block.first_entry, sizeof(DWord));
+    if (result == RESULT_OK)
+    {
+      result =
+        file_read_bytes_size(file, (Byte*)&block.entry_count, sizeof(DWord));
+    }
+    if (result == RESULT_OK)
+    {
+      result = file_read_bytes_size(file, (Byte*)&block.offset, sizeof(QWord));
+    }
+    if (result == RESULT_OK)
+    {
+      result = file_read_bytes_size(file, (Byte*)&block.compressed_size,
+                                    sizeof(QWord));
+    }
+    if (result == RESULT_OK)
+    {
+      result =
+        file_read_bytes_size(file, (Byte*)&block.data_size, sizeof(QWord));
+    }
+    if (result == RESULT_OK)
+    {
+      result = file_table_add_solid_block(self, block.first_entry,
+                                          block.entry_count, block.data_size);
+    }
+    if (result == RESULT_OK)
+    {
+      FileSolidBlock* added = &self->solid_blocks[self->solid_count - 1];
+      added->offset = block.offset;
+      added->compressed_size = block.compressed_size;
+      result = validate_solid_block(self, added) ? RESULT_OK : RESULT_ERROR;
+    }
+  }
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при чтении сплошных блоков!\n");
+  }
+
+  return result;
+}
+
+struct FileNameIndex
+{
+  const FileTable* table;
+  DWord* slots;  // Номер записи + 1, 0 - свободно
+  DWord slot_count;  // Степень двойки, не меньше удвоенного числа записей
+};
+
+static DWord hash_filename(const char* filename)
+{
+  // FNV-1a
+  DWord hash = 2166136261u;
+  for (const char* c = filename; *c != '\0'; c++)
+  {
+    hash = (hash ^ (Byte)*c) * 16777619u;
+  }
+
+  return hash;
+}
+
+static DWord* find_name_slot(const FileNameIndex* self, const char* filename)
+{
+  DWord slot = hash_filename(filename) & (self->slot_count - 1);
+  while (self->slots[slot] != 0)
+  {
+    const FileEntry* entry = &self->table->entries[self->slots[slot] - 1];
+    if (strncmp(entry->filename, filename, FILENAME_LIMIT) == 0)
+    {
+      break;
+    }
+    slot = (slot + 1) & (self->slot_count - 1);
+  }
+
+  return &self->slots[slot];
+}
+
+FileNameIndex* file_name_index_create(const FileTable* table)
+{
+  if (table == NULL)
+  {
+    return NULL;
+  }
+
+  FileNameIndex* index = (FileNameIndex*)malloc(sizeof(FileNameIndex));
+  if (index == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  index->table = table;
+  index->slot_count = 16;
+  while (index->slot_count < (QWord)table->count * 2)
+  {
+    index->slot_count *= 2;
+  }
+
+  index->slots = (DWord*)calloc(index->slot_count, sizeof(DWord));
+  if (index->slots == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(index);
+    return NULL;
+  }
+
+  // Записи идут по порядку, поэтому более поздняя перезаписывает слот
+  for (DWord i = 0; i < table->count; i++)
+  {
+    *find_name_slot(index, table->entries[i].filename) = i + 1;
+  }
+
+  return index;
+}
+
+void file_name_index_destroy(FileNameIndex* self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  free(self->slots);
+  free(self);
+}
+
+DWord file_name_index_find(const FileNameIndex* self, const char* filename)
+{
+  if (self == NULL || filename == NULL)
+  {
+    return FILE_TABLE_NO_ENTRY;
+  }
+
+  DWord slot = *find_name_slot(self, filename);
+  return slot != 0 ? slot - 1 : FILE_TABLE_NO_ENTRY;
+}
+
+Size file_table_get_mtimes_size(const FileTable* self)
+{
+  if (!file_table_has_mtimes(self))
+  {
+    return 0;
+  }
+
+  return sizeof(DWord) + self->count * sizeof(QWord);
+}
+
+// Формат: DWord количество записей и QWord времени изменения на запись
+Result file_table_write_mtimes(const FileTable* self, File* file)
+{
+  if (!file_table_has_mtimes(self) || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Result result =
+    file_write_bytes(file, (const Byte*)&self->count, sizeof(self->count));
+  if (result == RESULT_OK)
+  {
+    result = file_write_bytes(file, (const Byte*)self->mtimes,
+                              self->count * sizeof(QWord));
+  }
+
+  return result;
+}
+
+Result file_table_read_mtimes(FileTable* self, File* file)
+{
+  if (self == NULL || file == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  DWord count = 0;
+  Result result = file_read_bytes_size(file, (Byte*)&count, sizeof(count));
+  if (result != RESULT_OK || count != self->count)
+  {
+    LOG_ERROR("Произошла ошибка при чтении времен изменения файлов!\n");
+    return result != RESULT_OK ? result : RESULT_ERROR;
+  }
+
+  QWord* mtimes = (QWord*)calloc(self->capacity, sizeof(QWord));
+  if (mtimes == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  result = file_read_bytes_size(file, (Byte*)mtimes, count * sizeof(QWord));
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("Произошла ошибка при чтении времен изменения файлов!\n");
+    free(mtimes);
+    return result;
   }
 
+  free(self->mtimes);
+  self->mtimes = mtimes;
   return RESULT_OK;
 }
@@ -7,6 +7,9 @@
 #define FILENAME_LIMIT 256
 
 typedef struct FileTable FileTable;
+typedef struct FileNameIndex FileNameIndex;
+
+#define FILE_TABLE_NO_ENTRY ((DWord)-1)
 
 typedef struct
 {
@@ -17,6 +20,48 @@ typedef struct
   DWord crc;
 } FileEntry;
 
+// Карта разреженного файла: в архиве хранятся только области с данными,
+// а original_size записи равен их суммарной длине
+typedef struct
+{
+  DWord entry_index;
+  QWord logical_size;  // Полный размер файла вместе с дырами
+  DWord extent_count;
+  FileExtent* extents;
+} FileSparseMap;
+
+// Участок данных файла с повторяющимися чанками. Участок своей записи со
+// смещением, равным уже набранному объему ее данных, - новые данные; все
+// остальные ссылаются на ранее сохраненные данные своей или другой записи
+typedef struct
+{
+  DWord source_index;  // Запись, в данных которой лежит участок
+  QWord offset;  // Смещение в данных записи-источника, как они хранятся
+  QWord length;
+} FileChunkRun;
+
+// Карта дедуплицированного файла: в архиве хранятся только новые участки,
+// original_size записи равен их суммарной длине
+typedef struct
+{
+  DWord entry_index;
+  QWord data_size;  // Размер до дедупликации (без дыр разреженного файла)
+  DWord run_count;
+  FileChunkRun* runs;
+} FileDedupMap;
+
+// Сплошной блок: подряд идущие маленькие записи сжимаются одним потоком.
+// У записи-участника offset - смещение ее данных в распакованном блоке,
+// compressed_size равен 0
+typedef struct
+{
+  DWord first_entry;
+  DWord entry_count;
+  QWord offset;  // Смещение сжатого блока в архиве
+  QWord compressed_size;
+  QWord data_size;  // Сумма original_size участников
+} FileSolidBlock;
+
 FileTable* file_table_create(void);
 void file_table_destroy(FileTable* self);
 
@@ -26,8 +71,68 @@ Result file_table_add_directory(FileTable* self, const char* dirname);
 DWord file_table_get_count(const FileTable* self);
 const FileEntry* file_table_get_entry(const FileTable* self, DWord index);
 QWord file_table_get_total_size(const FileTable* self);
+// Размер файла на диске: вместе с дырами и повторами, которых нет в архиве
+QWord file_table_get_file_size(const FileTable* self, DWord index);
+
+// Время изменения файла в наносекундах Unix, 0 - неизвестно
+Result file_table_set_mtime(FileTable* self, DWord index, QWord mtime);
+QWord file_table_get_mtime(const FileTable* self, DWord index);
+bool file_table_has_mtimes(const FileTable* self);
+
+bool file_table_has_sparse_files(const FileTable* self);
+const FileSparseMap* file_table_get_sparse_map(const FileTable* self,
+                                               DWord index);
+
+// Таблица забирает участки себе и уменьшает original_size записи до
+// суммарной длины новых участков
+Result file_table_set_dedup_map(FileTable* self, DWord index, QWord data_size,
+                                FileChunkRun* runs, DWord run_count);
+bool file_table_has_dedup_files(const FileTable* self);
+const FileDedupMap* file_table_get_dedup_map(const FileTable* self,
+                                             DWord index);
+
+// Блоки добавляются по порядку записей и не пересекаются
+Result file_table_add_solid_block(FileTable* self, DWord first_entry,
+                                  DWord entry_count, QWord data_size);
+void file_table_clear_solid_blocks(FileTable* self);
+bool file_table_has_solid_blocks(const FileTable* self);
+DWord file_table_get_solid_block_count(const FileTable* self);
+const FileSolidBlock* file_table_get_solid_block(const FileTable* self,
+                                                 DWord block);
+// FILE_TABLE_NO_ENTRY, если запись не входит в сплошной блок
+DWord file_table_find_solid_block(const FileTable* self, DWord index);
+
+Result file_table_read_entry_data(const FileTable* self, DWord index,
+                                  File* file);
 
 Result file_table_write(const FileTable* self, File* file);
 Result file_table_read(FileTable* self, File* file);
 
+Size file_table_get_sparse_maps_size(const FileTable* self);
+Result file_table_write_sparse_maps(const FileTable* self, File* file);
+Result file_table_read_sparse_maps(FileTable* self, File* file);
+// Сумма областей каждой карты должна совпадать с данными записи
+// (при дедупликации - с размером до нее); вызывается после чтения всех карт
+Result file_table_check_sparse_sizes(const FileTable* self);
+
+Size file_table_get_dedup_maps_size(const FileTable* self);
+Result file_table_write_dedup_maps(const FileTable* self, File* file);
+Result file_table_read_dedup_maps(FileTable* self, File* file);
+
+// Индекс имен записей таблицы: для каждого имени - последняя запись с ним
+// (после дозаписи в архив более поздняя запись заменяет прежнюю). Индекс
+// ссылается на таблицу и видит только записи, бывшие в ней при создании
+FileNameIndex* file_name_index_create(const FileTable* table);
+void file_name_index_destroy(FileNameIndex* self);
+// FILE_TABLE_NO_ENTRY, если записи с таким именем нет
+DWord file_name_index_find(const FileNameIndex* self, const char* filename);
+
+Size file_table_get_solid_blocks_size(const FileTable* self);
+Result file_table_write_solid_blocks(const FileTable* self, File* file);
+Result file_table_read_solid_blocks(FileTable* self, File* file);
+
+Size file_table_get_mtimes_size(const FileTable* self);
+Result file_table_write_mtimes(const FileTable* self, File* file);
+Result file_table_read_mtimes(FileTable* self, File* file);
+
 #endif  // FILE_TABLE_FILE_TABLE_H
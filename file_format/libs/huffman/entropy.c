@@ -2,11 +2,11 @@
 
 #include <ctype.h>
 #include <math.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "file.h"
+#include "log.h"
 #include "types.h"
 
 double calculate_entropy(const Byte* data, Size size)
@@ -93,11 +93,11 @@ void analyze_file_entropy(const char* filename, Size compressed_size)
   double info_bits = calculate_information_lower_bound(data, size);
   double info_bytes = info_bits / 8.0;
 
-  printf("\n=== Анализ энтропии ===\n");
-  printf("Размер файла: %zu байт\n", size);
-  printf("Энтропия: %.4f бит/символ\n", entropy);
-  printf("Оценка снизу количества информации: %.2f бит (%.2f байт)\n",
-         info_bits, info_bytes);
+  LOG_DEBUG("\n=== Анализ энтропии ===\n");
+  LOG_DEBUG("Размер файла: %zu байт\n", size);
+  LOG_DEBUG("Энтропия: %.4f бит/символ\n", entropy);
+  LOG_DEBUG("Оценка снизу количества информации: %.2f бит (%.2f байт)\n",
+            info_bits, info_bytes);
 
   if (compressed_size > 0)
   {
@@ -105,19 +105,19 @@ void analyze_file_entropy(const char* filename, Size compressed_size)
       calculate_compression_ratio(size, compressed_size);
     double actual_bits = (double)compressed_size * 8.0;
 
-    printf("Размер сжатых данных: %zu байт (%.2f бит)\n", compressed_size,
-           actual_bits);
-    printf("Коэффициент сжатия: %.2f%%\n", compression_ratio);
-    printf("Отношение L/H: %.4f (L=%.2f, H=%.2f)\n", actual_bits / info_bits,
-           actual_bits, info_bits);
+    LOG_DEBUG("Размер сжатых данных: %zu байт (%.2f бит)\n", compressed_size,
+              actual_bits);
+    LOG_DEBUG("Коэффициент сжатия: %.2f%%\n", compression_ratio);
+    LOG_DEBUG("Отношение L/H: %.4f (L=%.2f, H=%.2f)\n", actual_bits / info_bits,
+              actual_bits, info_bits);
 
     if (actual_bits >= info_bits)
     {
-      printf("Сжатие близко к оптимальному (L ≥ H)\n");
+      LOG_DEBUG("Сжатие близко к оптимальному (L ≥ H)\n");
     }
     else
     {
-      printf("Теоретически невозможно (L < H) - проверьте расчеты\n");
+      LOG_DEBUG("Теоретически невозможно (L < H) - проверьте расчеты\n");
     }
   }
 
@@ -134,8 +134,8 @@ void analyze_file_entropy(const char* filename, Size compressed_size)
     frequencies[data[i]]++;
   }
 
-  printf("Уникальных символов: %d\n", unique_symbols);
-  printf("5 наиболее частых символов:\n");
+  LOG_DEBUG("Уникальных символов: %d\n", unique_symbols);
+  LOG_DEBUG("5 наиболее частых символов:\n");
   for (int top = 0; top < 5 && top < unique_symbols; top++)
   {
     DWord max_frequency = 0;
@@ -153,9 +153,9 @@ void analyze_file_entropy(const char* filename, Size compressed_size)
     if (max_frequency > 0)
     {
       double prob = (double)max_frequency / (double)size;
-      printf("  '%c' (0x%02X): %u раз (%.4f)\n",
-             isprint(max_symbol) ? max_symbol : '.', max_symbol, max_frequency,
-             prob);
+      LOG_DEBUG("  '%c' (0x%02X): %u раз (%.4f)\n",
+                isprint(max_symbol) ? max_symbol : '.', max_symbol,
+                max_frequency, prob);
       frequencies[max_symbol] = 0;  // Убираем для поиска следующего
     }
   }
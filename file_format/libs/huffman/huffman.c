@@ -1,10 +1,16 @@
 #include "huffman.h"
 
 #include <ctype.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
+
+// Все узлы дерева (не более 2 * 256 - 1) помещаются в один блок арены,
+// запас на узел покрывает выравнивание
+#define HUFFMAN_ARENA_BLOCK_SIZE \
+  (2 * HUFFMAN_MAX_SYMBOLS * (sizeof(HuffmanNode) + 16))
+
 typedef struct
 {
   HuffmanNode** nodes;
@@ -102,33 +108,55 @@ HuffmanTree* huffman_tree_create(void)
     return NULL;
   }
 
+  tree->arena = arena_create(HUFFMAN_ARENA_BLOCK_SIZE);
+  if (!tree->arena)
+  {
+    free(tree);
+    return NULL;
+  }
+
   tree->root = NULL;
   memset(tree->code_lengths, 0, sizeof(tree->code_lengths));
   memset(tree->codes, 0, sizeof(tree->codes));
   return tree;
 }
 
-static void destroy_node(HuffmanNode* node)
+void huffman_tree_destroy(HuffmanTree* tree)
 {
-  if (!node)
+  if (!tree)
   {
     return;
   }
 
-  destroy_node(node->left);
-  destroy_node(node->right);
-  free(node);
+  arena_destroy(tree->arena);
+  free(tree);
 }
 
-void huffman_tree_destroy(HuffmanTree* tree)
+static HuffmanNode* create_node(HuffmanTree* tree, Byte symbol,
+                                DWord frequency, HuffmanNode* left,
+                                HuffmanNode* right)
 {
-  if (!tree)
+  HuffmanNode* node = arena_alloc(tree->arena, sizeof(HuffmanNode));
+  if (!node)
   {
-    return;
+    return NULL;
   }
 
-  destroy_node(tree->root);
-  free(tree);
+  node->symbol = symbol;
+  node->frequency = frequency;
+  node->left = left;
+  node->right = right;
+  return node;
+}
+
+// Повторное построение переиспользует арену: узлы прежнего дерева
+// освобождаются целиком
+static void reset_tree(HuffmanTree* tree)
+{
+  arena_reset(tree->arena);
+  tree->root = NULL;
+  memset(tree->code_lengths, 0, sizeof(tree->code_lengths));
+  memset(tree->codes, 0, sizeof(tree->codes));
 }
 
 static void generate_codes(HuffmanTree* tree, HuffmanNode* node, Byte* code,
@@ -176,46 +204,59 @@ Result huffman_tree_build(HuffmanTree* tree, const Byte* data, Size size)
     frequencies[data[i]]++;
   }
 
+  return huffman_tree_build_from_frequencies(tree, frequencies);
+}
+
+Result huffman_tree_build_from_frequencies(HuffmanTree* tree,
+                                           const DWord* frequencies)
+{
+  if (!tree || !frequencies)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
   PriorityQueue* priority_queue = priority_queue_create(HUFFMAN_MAX_SYMBOLS);
   if (!priority_queue)
   {
     return RESULT_MEMORY_ERROR;
   }
 
+  reset_tree(tree);
+
   int symbol_count = 0;
   for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
   {
     if (frequencies[i] > 0)
     {
-      HuffmanNode* node = malloc(sizeof(HuffmanNode));
+      HuffmanNode* node =
+        create_node(tree, (Byte)i, frequencies[i], NULL, NULL);
       if (!node)
       {
         priority_queue_destroy(priority_queue);
+        reset_tree(tree);
         return RESULT_MEMORY_ERROR;
       }
-      node->symbol = (Byte)i;
-      node->frequency = frequencies[i];
-      node->left = NULL;
-      node->right = NULL;
       priority_queue_push(priority_queue, node);
       symbol_count++;
     }
   }
 
+  if (symbol_count == 0)
+  {
+    priority_queue_destroy(priority_queue);
+    return RESULT_INVALID_ARGUMENT;
+  }
+
   if (symbol_count == 1)
   {
     HuffmanNode* node = priority_queue_pop(priority_queue);
-    HuffmanNode* parent = malloc(sizeof(HuffmanNode));
+    HuffmanNode* parent = create_node(tree, 0, node->frequency, node, NULL);
     if (!parent)
     {
-      free(node);
       priority_queue_destroy(priority_queue);
+      reset_tree(tree);
       return RESULT_MEMORY_ERROR;
     }
-    parent->symbol = 0;
-    parent->frequency = node->frequency;
-    parent->left = node;
-    parent->right = NULL;
     tree->root = parent;
   }
   else
@@ -225,27 +266,15 @@ Result huffman_tree_build(HuffmanTree* tree, const Byte* data, Size size)
       HuffmanNode* left = priority_queue_pop(priority_queue);
       HuffmanNode* right = priority_queue_pop(priority_queue);
 
-      HuffmanNode* parent = malloc(sizeof(HuffmanNode));
+      HuffmanNode* parent = create_node(
+        tree, 0, left->frequency + right->frequency, left, right);
       if (!parent)
       {
-        if (left)
-        {
-          destroy_node(left);
-        }
-        if (right)
-        {
-          destroy_node(right);
-        }
-
         priority_queue_destroy(priority_queue);
+        reset_tree(tree);
         return RESULT_MEMORY_ERROR;
       }
 
-      parent->symbol = 0;
-      parent->frequency = left->frequency + right->frequency;
-      parent->left = left;
-      parent->right = right;
-
       priority_queue_push(priority_queue, parent);
     }
 
@@ -291,8 +320,8 @@ static void serialize_node(HuffmanNode* node, Byte* buffer, Size* position,
   }
 }
 
-static HuffmanNode* deserialize_node(const Byte* buffer, Size* position,
-                                     Size max_position)
+static HuffmanNode* deserialize_node(HuffmanTree* tree, const Byte* buffer,
+                                     Size* position, Size max_position)
 {
   if (*position >= max_position)
   {
@@ -311,35 +340,27 @@ static HuffmanNode* deserialize_node(const Byte* buffer, Size* position,
 
     Byte symbol = buffer[(*position)++];
 
-    HuffmanNode* node = malloc(sizeof(HuffmanNode));
-    if (!node)
-    {
-      return NULL;
-    }
-
-    node->symbol = symbol;
-    node->frequency = 0;
-    node->left = NULL;
-    node->right = NULL;
-    return node;
+    return create_node(tree, symbol, 0, NULL, NULL);
   }
   else if (flag == 0)
   {
     // Внутренний узел
-    HuffmanNode* node = malloc(sizeof(HuffmanNode));
+    HuffmanNode* node = create_node(tree, 0, 0, NULL, NULL);
     if (!node)
     {
       return NULL;
     }
 
-    node->symbol = 0;
-    node->frequency = 0;
-    node->left = deserialize_node(buffer, position, max_position);
-    node->right = deserialize_node(buffer, position, max_position);
+    node->left = deserialize_node(tree, buffer, position, max_position);
+    node->right = deserialize_node(tree, buffer, position, max_position);
 
-    if (!node->left || !node->right)
+    // У дерева из одного символа корень имеет только левого потомка и
+    // правая ветка не сериализуется: данные в этом случае уже исчерпаны
+    bool single_leaf = node->left && !node->right &&
+                       *position >= max_position;
+
+    if (!node->left || (!node->right && !single_leaf))
     {
-      destroy_node(node);
       return NULL;
     }
 
@@ -395,36 +416,36 @@ Result huffman_deserialize_tree(HuffmanTree* tree, const Byte* data, Size size)
 {
   if (!tree || !data || size == 0)
   {
-    printf("[HUFFMAN] Ошибка: неверные параметры для десериализации дерева\n");
+    LOG_ERROR("[HUFFMAN] Ошибка: неверные параметры для десериализации "
+              "дерева\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[HUFFMAN] Десериализация дерева размером %zu байт\n", size);
-  printf("[HUFFMAN] Первые 16 байт данных дерева: ");
-  for (Size i = 0; i < 16 && i < size; i++)
-  {
-    printf("%02X ", data[i]);
-  }
-  printf("\n");
+  LOG_DEBUG("[HUFFMAN] Десериализация дерева размером %zu байт\n", size);
+  LOG_DEBUG_DUMP("[HUFFMAN] Первые 16 байт данных дерева", data, size, 16);
+
+  reset_tree(tree);
 
   Size position = 0;
-  tree->root = deserialize_node(data, &position, size);
+  tree->root = deserialize_node(tree, data, &position, size);
 
   if (!tree->root)
   {
-    printf("[HUFFMAN] Ошибка десериализации дерева! Позиция: %zu\n", position);
+    reset_tree(tree);
+    LOG_ERROR("[HUFFMAN] Ошибка десериализации дерева! Позиция: %zu\n",
+              position);
     return RESULT_ERROR;
   }
 
-  printf("[HUFFMAN] Дерево десериализовано, позиция после чтения: %zu/%zu\n",
-         position, size);
+  LOG_DEBUG("[HUFFMAN] Дерево десериализовано, позиция после чтения: %zu/%zu\n",
+            position, size);
 
   Byte code[32] = {0};
   generate_codes(tree, tree->root, code, 0);
 
   int leaf_count = 0;
   count_leaves(tree->root, &leaf_count);
-  printf("[HUFFMAN] Дерево содержит %d листьев\n", leaf_count);
+  LOG_DEBUG("[HUFFMAN] Дерево содержит %d листьев\n", leaf_count);
 
   return RESULT_OK;
 }
@@ -461,39 +482,46 @@ Size huffman_calculate_size(const HuffmanTree* tree, const Byte* data,
 
   Size bytes = (bit_count + 7) / 8;  // Байты
 
-  printf("[HUFFMAN] Расчет размера: %zu байт -> %zu бит -> %zu байт\n", size,
-         bit_count, bytes);
+  LOG_DEBUG("[HUFFMAN] Расчет размера: %zu байт -> %zu бит -> %zu байт\n", size,
+            bit_count, bytes);
 
   return bytes;
 }
 
-Result huffman_compress(const Byte* input, Size input_size, Byte** output,
-                        Size* output_size, const HuffmanTree* tree)
+Size huffman_compress_bound(Size input_size)
+{
+  // Коды не длиннее 32 бит
+  return input_size * 4;
+}
+
+Result huffman_compress_into(const Byte* input, Size input_size, Byte* output,
+                             Size output_capacity, Size* output_size,
+                             const HuffmanTree* tree)
 {
   if (!input || !output || !output_size || !tree || input_size == 0)
   {
-    printf("[HUFFMAN] Ошибка: неверные параметры в huffman_compress\n");
+    LOG_ERROR("[HUFFMAN] Ошибка: неверные параметры в huffman_compress\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[HUFFMAN] Начало сжатия, размер данных: %zu байт\n", input_size);
+  LOG_DEBUG("[HUFFMAN] Начало сжатия, размер данных: %zu байт\n", input_size);
 
   Size compressed_size = huffman_calculate_size(tree, input, input_size);
   if (compressed_size == 0)
   {
-    printf("[HUFFMAN] Ошибка: расчетный размер сжатия = 0\n");
+    LOG_ERROR("[HUFFMAN] Ошибка: расчетный размер сжатия = 0\n");
     return RESULT_ERROR;
   }
 
-  Byte* compressed = malloc(compressed_size);
-  if (!compressed)
+  if (compressed_size > output_capacity)
   {
-    printf("[HUFFMAN] Ошибка выделения памяти для сжатых данных\n");
-    return RESULT_MEMORY_ERROR;
+    LOG_ERROR("[HUFFMAN] Ошибка: выходной буфер (%zu байт) меньше сжатых "
+              "данных (%zu байт)\n", output_capacity, compressed_size);
+    return RESULT_ERROR;
   }
 
+  Byte* compressed = output;
   memset(compressed, 0, compressed_size);
-  printf("[HUFFMAN] Выделено %zu байт для сжатых данных\n", compressed_size);
 
   Size bit_position = 0;
   for (Size i = 0; i < input_size; i++)
@@ -504,8 +532,7 @@ Result huffman_compress(const Byte* input, Size input_size, Byte** output,
 
     if (length == 0)
     {
-      printf("[HUFFMAN] ВНИМАНИЕ: символ 0x%02X не имеет кода!\n", symbol);
-      free(compressed);
+      LOG_WARN("[HUFFMAN] ВНИМАНИЕ: символ 0x%02X не имеет кода!\n", symbol);
       return RESULT_ERROR;
     }
 
@@ -531,63 +558,79 @@ Result huffman_compress(const Byte* input, Size input_size, Byte** output,
     bit_position++;
   }
 
-  printf("[HUFFMAN] Сжатие завершено. Использовано бит: %zu\n", bit_position);
-  printf("[HUFFMAN] Первые 16 байт сжатых данных: ");
-  for (Size i = 0; i < 16 && i < compressed_size; i++)
+  LOG_DEBUG("[HUFFMAN] Сжатие завершено. Использовано бит: %zu\n",
+            bit_position);
+  LOG_DEBUG_DUMP("[HUFFMAN] Первые 16 байт сжатых данных", compressed,
+                 compressed_size, 16);
+
+  *output_size = compressed_size;
+  return RESULT_OK;
+}
+
+Result huffman_compress(const Byte* input, Size input_size, Byte** output,
+                        Size* output_size, const HuffmanTree* tree)
+{
+  if (!input || !output || !output_size || !tree || input_size == 0)
   {
-    printf("%02X ", compressed[i]);
+    LOG_ERROR("[HUFFMAN] Ошибка: неверные параметры в huffman_compress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  // Размер известен заранее, поэтому буфер выделяется точно по нему
+  Size capacity = huffman_calculate_size(tree, input, input_size);
+  Byte* compressed = malloc(capacity > 0 ? capacity : 1);
+  if (!compressed)
+  {
+    LOG_ERROR("[HUFFMAN] Ошибка выделения памяти для сжатых данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = huffman_compress_into(input, input_size, compressed,
+                                        capacity, output_size, tree);
+  if (result != RESULT_OK)
+  {
+    free(compressed);
+    return result;
   }
-  printf("\n");
 
   *output = compressed;
-  *output_size = compressed_size;
   return RESULT_OK;
 }
 
-Result huffman_decompress(const Byte* input, Size input_size, Byte** output,
-                          Size* output_size, const HuffmanTree* tree)
+Result huffman_decompress_into(const Byte* input, Size input_size,
+                               Byte* output, Size* output_size,
+                               const HuffmanTree* tree)
 {
   if (!input || !output || !output_size || !tree || !tree->root)
   {
-    printf("[HUFFMAN] Ошибка: неверные параметры в huffman_decompress\n");
+    LOG_ERROR("[HUFFMAN] Ошибка: неверные параметры в huffman_decompress\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[HUFFMAN] Начало декомпрессии\n");
-  printf("[HUFFMAN] Размер входных данных: %zu байт\n", input_size);
-  printf("[HUFFMAN] Ожидаемый выходной размер: %zu байт\n", *output_size);
+  LOG_DEBUG("[HUFFMAN] Начало декомпрессии\n");
+  LOG_DEBUG("[HUFFMAN] Размер входных данных: %zu байт\n", input_size);
+  LOG_DEBUG("[HUFFMAN] Ожидаемый выходной размер: %zu байт\n", *output_size);
 
   if (input_size == 0)
   {
-    printf("[HUFFMAN] Ошибка: входные данные пустые\n");
+    LOG_ERROR("[HUFFMAN] Ошибка: входные данные пустые\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[HUFFMAN] Первые 16 байт сжатых данных: ");
-  for (Size i = 0; i < 16 && i < input_size; i++)
-  {
-    printf("%02X ", input[i]);
-  }
-  printf("\n");
+  LOG_DEBUG_DUMP("[HUFFMAN] Первые 16 байт сжатых данных", input,
+                 input_size, 16);
 
   Size bit_position = 0;
   Size decompressed_position = 0;
   const HuffmanNode* current_node = tree->root;
-  Byte* decompressed_data = malloc(*output_size);
-
-  if (decompressed_data == NULL)
-  {
-    printf(
-      "[HUFFMAN] Ошибка выделения памяти для декомпрессированных данных\n");
-    return RESULT_MEMORY_ERROR;
-  }
+  Byte* decompressed_data = output;
 
-  printf("[HUFFMAN] Начало декодирования...\n");
-  printf("[HUFFMAN] Всего битов для чтения: %zu\n", input_size * 8);
+  LOG_DEBUG("[HUFFMAN] Начало декодирования...\n");
+  LOG_DEBUG("[HUFFMAN] Всего битов для чтения: %zu\n", input_size * 8);
 
   if (!tree->root->left && !tree->root->right)
   {
-    printf("[HUFFMAN] ВНИМАНИЕ: корень дерева является листом!\n");
+    LOG_WARN("[HUFFMAN] ВНИМАНИЕ: корень дерева является листом!\n");
     while (decompressed_position < *output_size &&
            bit_position < input_size * 8)
     {
@@ -609,7 +652,7 @@ Result huffman_decompress(const Byte* input, Size input_size, Byte** output,
 
       if (bit_position <= 32)
       {
-        printf("[HUFFMAN] Битов %zu: %d\n", bit_position, bit);
+        LOG_DEBUG("[HUFFMAN] Битов %zu: %d\n", bit_position, bit);
       }
 
       if (bit == 0)
@@ -623,11 +666,10 @@ Result huffman_decompress(const Byte* input, Size input_size, Byte** output,
 
       if (!current_node)
       {
-        printf("[HUFFMAN] Ошибка: достигнут NULL узел в дереве на бите %zu\n",
-               bit_position);
-        printf("[HUFFMAN] Уже декомпрессировано: %zu байт\n",
-               decompressed_position);
-        free(decompressed_data);
+        LOG_ERROR("[HUFFMAN] Ошибка: достигнут NULL узел в дереве на бите "
+                  "%zu\n", bit_position);
+        LOG_DEBUG("[HUFFMAN] Уже декомпрессировано: %zu байт\n",
+                  decompressed_position);
         return RESULT_ERROR;
       }
 
@@ -638,11 +680,10 @@ Result huffman_decompress(const Byte* input, Size input_size, Byte** output,
 
         if (decompressed_position < 10)
         {
-          printf(
-            "[HUFFMAN] Декодирован символ %u (0x%02X '%c') на позиции %zu (бит "
-            "%zu)\n",
-            symbol, symbol, isprint(symbol) ? symbol : '.',
-            decompressed_position, bit_position);
+          LOG_TRACE("[HUFFMAN] Декодирован символ %u (0x%02X '%c') на позиции "
+                    "%zu (бит " "%zu)\n", symbol, symbol,
+                    isprint(symbol) ? symbol : '.', decompressed_position,
+                    bit_position);
         }
 
         decompressed_position++;
@@ -651,41 +692,56 @@ Result huffman_decompress(const Byte* input, Size input_size, Byte** output,
     }
   }
 
-  printf("[HUFFMAN] Декомпрессия завершена\n");
-  printf("[HUFFMAN] Декомпрессировано байт: %zu из %zu ожидаемых\n",
-         decompressed_position, *output_size);
+  LOG_DEBUG("[HUFFMAN] Декомпрессия завершена\n");
+  LOG_DEBUG("[HUFFMAN] Декомпрессировано байт: %zu из %zu ожидаемых\n",
+            decompressed_position, *output_size);
 
-  printf("[HUFFMAN] Первые 16 байт декомпрессированных данных: ");
-  for (Size i = 0; i < 16 && i < decompressed_position; i++)
-  {
-    printf("%02X ", decompressed_data[i]);
-  }
-  printf(" (");
-  for (Size i = 0; i < 16 && i < decompressed_position; i++)
-  {
-    printf("%c", isprint(decompressed_data[i]) ? decompressed_data[i] : '.');
-  }
-  printf(")\n");
+  LOG_DEBUG_DUMP("[HUFFMAN] Первые 16 байт декомпрессированных данных",
+                 decompressed_data, decompressed_position, 16);
 
   if (decompressed_position != *output_size)
   {
-    printf(
-      "[HUFFMAN] ВНИМАНИЕ: Размер не совпадает! Ожидалось: %zu, получено: "
-      "%zu\n",
-      *output_size, decompressed_position);
+    LOG_WARN("[HUFFMAN] ВНИМАНИЕ: Размер не совпадает! Ожидалось: %zu, "
+             "получено: " "%zu\n", *output_size, decompressed_position);
 
     if (decompressed_position == 0)
     {
-      printf(
-        "[HUFFMAN] КРИТИЧЕСКАЯ ОШИБКА: не декомпрессировано ни одного "
-        "байта!\n");
-      free(decompressed_data);
+      LOG_ERROR("[HUFFMAN] КРИТИЧЕСКАЯ ОШИБКА: не декомпрессировано ни одного "
+                "байта!\n");
       return RESULT_ERROR;
     }
 
     *output_size = decompressed_position;
   }
 
+  return RESULT_OK;
+}
+
+Result huffman_decompress(const Byte* input, Size input_size, Byte** output,
+                          Size* output_size, const HuffmanTree* tree)
+{
+  if (!input || !output || !output_size || !tree || !tree->root)
+  {
+    LOG_ERROR("[HUFFMAN] Ошибка: неверные параметры в huffman_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Byte* decompressed_data = malloc(*output_size > 0 ? *output_size : 1);
+  if (decompressed_data == NULL)
+  {
+    LOG_ERROR("[HUFFMAN] Ошибка выделения памяти для декомпрессированных "
+              "данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = huffman_decompress_into(input, input_size, decompressed_data,
+                                          output_size, tree);
+  if (result != RESULT_OK)
+  {
+    free(decompressed_data);
+    return result;
+  }
+
   *output = decompressed_data;
   return RESULT_OK;
 }
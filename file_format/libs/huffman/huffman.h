@@ -1,6 +1,7 @@
 #ifndef HUFFMAN_HUFFMAN_H
 #define HUFFMAN_HUFFMAN_H
 
+#include "arena.h"
 #include "types.h"
 
 #define HUFFMAN_MAX_SYMBOLS 256
@@ -16,6 +17,7 @@ typedef struct HuffmanNode
 typedef struct
 {
   HuffmanNode* root;
+  Arena* arena;  // Узлы дерева, освобождаются одним вызовом
   Byte codes[HUFFMAN_MAX_SYMBOLS][32];  // Коды длиной до 32 бит
   Byte code_lengths[HUFFMAN_MAX_SYMBOLS];
 } HuffmanTree;
@@ -24,6 +26,9 @@ typedef struct
 HuffmanTree* huffman_tree_create(void);
 void huffman_tree_destroy(HuffmanTree* tree);
 Result huffman_tree_build(HuffmanTree* tree, const Byte* data, Size size);
+// Построение по готовой таблице частот HUFFMAN_MAX_SYMBOLS символов
+Result huffman_tree_build_from_frequencies(HuffmanTree* tree,
+                                           const DWord* frequencies);
 
 Result huffman_compress(const Byte* input, Size input_size, Byte** output,
                         Size* output_size, const HuffmanTree* tree);
@@ -31,6 +36,15 @@ Result huffman_compress(const Byte* input, Size input_size, Byte** output,
 Result huffman_decompress(const Byte* input, Size input_size, Byte** output,
                           Size* output_size, const HuffmanTree* tree);
 
+// Варианты с буфером вызывающего кода, семантика как у lz77_*_into
+Size huffman_compress_bound(Size input_size);
+Result huffman_compress_into(const Byte* input, Size input_size, Byte* output,
+                             Size output_capacity, Size* output_size,
+                             const HuffmanTree* tree);
+Result huffman_decompress_into(const Byte* input, Size input_size,
+                               Byte* output, Size* output_size,
+                               const HuffmanTree* tree);
+
 // Сериализация дерева
 Result huffman_serialize_tree(const HuffmanTree* tree, Byte** data, Size* size);
 Result huffman_deserialize_tree(HuffmanTree* tree, const Byte* data, Size size);
@@ -1,9 +1,9 @@
 #include "lz77.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
 #include "types.h"
 
 LZ77Context* lz77_create(Byte prefix)
@@ -74,45 +74,40 @@ static void find_best_match(const Byte* window, Size window_len,
   }
 }
 
-Result lz77_compress(const Byte* input, Size input_size, Byte** output,
-                     Size* output_size, Byte prefix)
+Size lz77_compress_bound(Size input_size)
 {
-  if (!input || !output || !output_size || input_size == 0)
-    return RESULT_INVALID_ARGUMENT;
-
-  printf("[LZ77] Сжатие: %zu байт, префикс=0x%02X\n", input_size, prefix);
-
-  Byte* window = (Byte*)malloc(LZ77_WINDOW_SIZE);
-  if (!window)
-    return RESULT_MEMORY_ERROR;
-
-  memset(window, 0, LZ77_WINDOW_SIZE);
-  Size window_len = 0;
+  // Худший случай - каждый байт равен префиксу и кодируется парой (p, 0)
+  return input_size * 2;
+}
 
-  Size max_out = input_size * 2 + 1024;
-  Byte* out_buf = (Byte*)malloc(max_out);
-  if (!out_buf)
-  {
-    free(window);
-    return RESULT_MEMORY_ERROR;
-  }
+// Окно - это последние LZ77_WINDOW_SIZE байт уже обработанного входа,
+// поэтому отдельный буфер окна не нужен: поиск идет прямо по input.
+// Первые start байт input - затравка окна, они не кодируются
+static Result lz77_compress_from(const Byte* input, Size start,
+                                 Size input_size, Byte* output,
+                                 Size output_capacity, Size* output_size,
+                                 Byte prefix)
+{
+  LOG_DEBUG("[LZ77] Сжатие: %zu байт, окно %zu, префикс=0x%02X\n",
+            input_size - start, start, prefix);
 
   Size out_pos = 0;
-  Size in_pos = 0;
+  Size in_pos = start;
 
   while (in_pos < input_size)
   {
     Size remaining = input_size - in_pos;
     Size lookahead =
       (remaining > LZ77_LOOKAHEAD_SIZE) ? LZ77_LOOKAHEAD_SIZE : remaining;
+    Size window_len = in_pos < LZ77_WINDOW_SIZE ? in_pos : LZ77_WINDOW_SIZE;
 
     Size match_offset = 0;
     Size match_len = 0;
 
     if (window_len >= LZ77_MIN_MATCH && lookahead >= LZ77_MIN_MATCH)
     {
-      find_best_match(window, window_len, input + in_pos, lookahead,
-                      &match_offset, &match_len);
+      find_best_match(input + in_pos - window_len, window_len, input + in_pos,
+                      lookahead, &match_offset, &match_len);
     }
 
     if (match_len >= LZ77_MIN_MATCH)
@@ -137,38 +132,12 @@ Result lz77_compress(const Byte* input, Size input_size, Byte** output,
       // Теперь combined никогда не будет 0 (т.к. L_enc >= 1)
       // Это решает конфликт с символом префикса (prefix, 0)
 
-      if (out_pos + 3 > max_out)
-      {
-        max_out *= 2;
-        Byte* tmp = (Byte*)realloc(out_buf, max_out);
-        if (!tmp)
-        {
-          free(window);
-          free(out_buf);
-          return RESULT_MEMORY_ERROR;
-        }
-        out_buf = tmp;
-      }
-
-      out_buf[out_pos++] = prefix;
-      out_buf[out_pos++] = combined;
-      out_buf[out_pos++] = S_low;
-
-      for (Size i = 0; i < L; i++)
-      {
-        Byte b = input[in_pos + i];
-
-        if (window_len < LZ77_WINDOW_SIZE)
-        {
-          window[window_len++] = b;
-        }
-        else
-        {
-          memmove(window, window + 1, LZ77_WINDOW_SIZE - 1);
-          window[LZ77_WINDOW_SIZE - 1] = b;
-        }
-      }
+      if (out_pos + 3 > output_capacity)
+        break;
 
+      output[out_pos++] = prefix;
+      output[out_pos++] = combined;
+      output[out_pos++] = S_low;
       in_pos += L;
     }
     else
@@ -177,104 +146,140 @@ Result lz77_compress(const Byte* input, Size input_size, Byte** output,
 
       if (b == prefix)
       {
-        if (out_pos + 2 > max_out)
-        {
-          max_out *= 2;
-          Byte* tmp = (Byte*)realloc(out_buf, max_out);
-          if (!tmp)
-          {
-            free(window);
-            free(out_buf);
-            return RESULT_MEMORY_ERROR;
-          }
-          out_buf = tmp;
-        }
+        if (out_pos + 2 > output_capacity)
+          break;
 
-        out_buf[out_pos++] = prefix;
-        out_buf[out_pos++] = 0;
+        output[out_pos++] = prefix;
+        output[out_pos++] = 0;
       }
       else
       {
-        if (out_pos + 1 > max_out)
-        {
-          max_out *= 2;
-          Byte* tmp = (Byte*)realloc(out_buf, max_out);
-          if (!tmp)
-          {
-            free(window);
-            free(out_buf);
-            return RESULT_MEMORY_ERROR;
-          }
-          out_buf = tmp;
-        }
+        if (out_pos + 1 > output_capacity)
+          break;
 
-        out_buf[out_pos++] = b;
-      }
-
-      if (window_len < LZ77_WINDOW_SIZE)
-      {
-        window[window_len++] = b;
-      }
-      else
-      {
-        memmove(window, window + 1, LZ77_WINDOW_SIZE - 1);
-        window[LZ77_WINDOW_SIZE - 1] = b;
+        output[out_pos++] = b;
       }
 
       in_pos++;
     }
   }
 
-  free(window);
-
-  if (out_pos == 0)
+  if (in_pos < input_size)
   {
-    free(out_buf);
-    *output = NULL;
-    *output_size = 0;
+    LOG_ERROR("[LZ77] Ошибка: выходной буфер (%zu байт) переполнен\n",
+              output_capacity);
+    return RESULT_ERROR;
   }
-  else
-  {
-    Byte* trimmed = (Byte*)realloc(out_buf, out_pos);
-    if (trimmed)
-      out_buf = trimmed;
 
-    *output = out_buf;
-    *output_size = out_pos;
-  }
+  *output_size = out_pos;
 
-  printf("[LZ77] Сжатие завершено: %zu -> %zu байт\n", input_size, out_pos);
+  LOG_DEBUG("[LZ77] Сжатие завершено: %zu -> %zu байт\n", input_size - start,
+            out_pos);
 
   return RESULT_OK;
 }
 
-Result lz77_decompress(const Byte* input, Size input_size, Byte** output,
-                       Size* output_size, Byte prefix)
+Result lz77_compress_into(const Byte* input, Size input_size, Byte* output,
+                          Size output_capacity, Size* output_size, Byte prefix)
 {
-  if (!input || !output || !output_size || input_size == 0)
+  return lz77_compress_into_with_dictionary(input, input_size, NULL, 0, output,
+                                            output_capacity, output_size,
+                                            prefix);
+}
+
+Result lz77_compress_into_with_dictionary(const Byte* input, Size input_size,
+                                          const Byte* dictionary,
+                                          Size dictionary_size, Byte* output,
+                                          Size output_capacity,
+                                          Size* output_size, Byte prefix)
+{
+  if (!input || !output || !output_size || input_size == 0 ||
+      (!dictionary && dictionary_size > 0))
     return RESULT_INVALID_ARGUMENT;
 
-  printf("[LZ77] Декомпрессия: вход=%zu, ожидаемый выход=%zu, префикс=0x%02X\n",
-         input_size, *output_size, prefix);
+  if (dictionary_size == 0)
+  {
+    return lz77_compress_from(input, 0, input_size, output, output_capacity,
+                              output_size, prefix);
+  }
+
+  if (dictionary_size > LZ77_WINDOW_SIZE)
+  {
+    dictionary += dictionary_size - LZ77_WINDOW_SIZE;
+    dictionary_size = LZ77_WINDOW_SIZE;
+  }
 
-  Byte* window = (Byte*)malloc(LZ77_WINDOW_SIZE);
-  if (!window)
+  // Поиск идет по непрерывной памяти, поэтому вход склеивается с окном
+  Byte* primed = (Byte*)malloc(dictionary_size + input_size);
+  if (!primed)
     return RESULT_MEMORY_ERROR;
 
-  memset(window, 0, LZ77_WINDOW_SIZE);
-  Size window_len = 0;
+  memcpy(primed, dictionary, dictionary_size);
+  memcpy(primed + dictionary_size, input, input_size);
+  Result result =
+    lz77_compress_from(primed, dictionary_size, dictionary_size + input_size,
+                       output, output_capacity, output_size, prefix);
+  free(primed);
+  return result;
+}
 
-  Byte* out_buf = (Byte*)malloc(*output_size);
+Result lz77_compress(const Byte* input, Size input_size, Byte** output,
+                     Size* output_size, Byte prefix)
+{
+  if (!input || !output || !output_size || input_size == 0)
+    return RESULT_INVALID_ARGUMENT;
+
+  Size capacity = lz77_compress_bound(input_size);
+  Byte* out_buf = (Byte*)malloc(capacity);
   if (!out_buf)
-  {
-    free(window);
     return RESULT_MEMORY_ERROR;
+
+  Size out_size = 0;
+  Result result =
+    lz77_compress_into(input, input_size, out_buf, capacity, &out_size, prefix);
+  if (result != RESULT_OK)
+  {
+    free(out_buf);
+    return result;
   }
 
+  Byte* trimmed = (Byte*)realloc(out_buf, out_size);
+  if (trimmed)
+    out_buf = trimmed;
+
+  *output = out_buf;
+  *output_size = out_size;
+  return RESULT_OK;
+}
+
+Result lz77_decompress_into(const Byte* input, Size input_size, Byte* output,
+                            Size* output_size, Byte prefix)
+{
+  return lz77_decompress_into_with_dictionary(input, input_size, NULL, 0,
+                                              output, output_size, prefix);
+}
+
+// Ссылки указывают на уже распакованные байты выходного буфера, поэтому
+// окно декодера тоже не хранится отдельно; до начала выхода они читают
+// затравку
+Result lz77_decompress_into_with_dictionary(const Byte* input, Size input_size,
+                                            const Byte* dictionary,
+                                            Size dictionary_size,
+                                            Byte* output, Size* output_size,
+                                            Byte prefix)
+{
+  if (!input || !output || !output_size || input_size == 0 ||
+      (!dictionary && dictionary_size > 0))
+    return RESULT_INVALID_ARGUMENT;
+
+  LOG_DEBUG("[LZ77] Декомпрессия: вход=%zu, ожидаемый выход=%zu, "
+            "префикс=0x%02X\n", input_size, *output_size, prefix);
+
+  Size capacity = *output_size;
   Size out_pos = 0;
   Size in_pos = 0;
 
-  while (in_pos < input_size && out_pos < *output_size)
+  while (in_pos < input_size && out_pos < capacity)
   {
     Byte b = input[in_pos];
 
@@ -282,9 +287,7 @@ Result lz77_decompress(const Byte* input, Size input_size, Byte** output,
     {
       if (in_pos + 1 >= input_size)
       {
-        printf("[LZ77] Ошибка: неполный префикс\n");
-        free(window);
-        free(out_buf);
+        LOG_ERROR("[LZ77] Ошибка: неполный префикс\n");
         return RESULT_ERROR;
       }
 
@@ -294,35 +297,14 @@ Result lz77_decompress(const Byte* input, Size input_size, Byte** output,
       {
         // Символ = префиксу: (p, 0)
         in_pos += 2;
-
-        if (out_pos >= *output_size)
-        {
-          printf("[LZ77] Ошибка: выход за пределы буфера\n");
-          free(window);
-          free(out_buf);
-          return RESULT_ERROR;
-        }
-
-        out_buf[out_pos++] = prefix;
-
-        if (window_len < LZ77_WINDOW_SIZE)
-        {
-          window[window_len++] = prefix;
-        }
-        else
-        {
-          memmove(window, window + 1, LZ77_WINDOW_SIZE - 1);
-          window[LZ77_WINDOW_SIZE - 1] = prefix;
-        }
+        output[out_pos++] = prefix;
       }
       else
       {
         // Ссылка: (p, combined, S_low)
         if (in_pos + 2 >= input_size)
         {
-          printf("[LZ77] Ошибка: неполная ссылка\n");
-          free(window);
-          free(out_buf);
+          LOG_ERROR("[LZ77] Ошибка: неполная ссылка\n");
           return RESULT_ERROR;
         }
 
@@ -341,62 +323,28 @@ Result lz77_decompress(const Byte* input, Size input_size, Byte** output,
         // Проверяем корректность
         if (L < LZ77_MIN_MATCH || L > LZ77_MAX_MATCH || S == 0 || S > 1024)
         {
-          printf("[LZ77] Ошибка: некорректная ссылка S=%zu, L=%zu\n", S, L);
-          free(window);
-          free(out_buf);
+          LOG_ERROR("[LZ77] Ошибка: некорректная ссылка S=%zu, L=%zu\n", S, L);
           return RESULT_ERROR;
         }
 
         // Проверяем, что есть место в выходном буфере
-        if (out_pos + L > *output_size)
+        if (out_pos + L > capacity)
         {
-          printf("[LZ77] Ошибка: ссылка выходит за пределы буфера\n");
-          free(window);
-          free(out_buf);
+          LOG_ERROR("[LZ77] Ошибка: ссылка выходит за пределы буфера\n");
           return RESULT_ERROR;
         }
 
-        // Копируем L символов из окна
-        // S отсчитывается от конца окна (1 = последний символ)
-        for (Size i = 0; i < L; i++)
-        {
-          Byte symbol = 0;
-
-          if (S <= window_len)
-          {
-            // Вычисляем позицию в окне
-            if (i < S)
-            {
-              // Берем из существующего окна
-              Size pos = window_len - S + i;
-              if (pos < window_len)
-                symbol = window[pos];
-            }
-            else
-            {
-              // Копируем из только что декодированных символов
-              // Это важно для случая, когда L > S
-              symbol = out_buf[out_pos + i - S];
-            }
-          }
-          // Если S > window_len, symbol остается 0
-
-          out_buf[out_pos + i] = symbol;
-        }
-
+        // S отсчитывается от конца распакованных данных (1 = последний
+        // байт). Побайтовое копирование нужно для случая L > S, ссылка
+        // дальше начала данных и затравки дает нули
         for (Size i = 0; i < L; i++)
         {
-          Byte symbol = out_buf[out_pos + i];
-
-          if (window_len < LZ77_WINDOW_SIZE)
-          {
-            window[window_len++] = symbol;
-          }
-          else
-          {
-            memmove(window, window + 1, LZ77_WINDOW_SIZE - 1);
-            window[LZ77_WINDOW_SIZE - 1] = symbol;
-          }
+          Size position = out_pos + i;
+          Size back = S - position;
+          output[position] = S <= position ? output[position - S]
+                             : back <= dictionary_size
+                               ? dictionary[dictionary_size - back]
+                               : 0;
         }
 
         out_pos += L;
@@ -405,57 +353,49 @@ Result lz77_decompress(const Byte* input, Size input_size, Byte** output,
     else
     {
       in_pos++;
+      output[out_pos++] = b;
+    }
+  }
 
-      if (out_pos >= *output_size)
-      {
-        printf("[LZ77] Ошибка: выход за пределы буфера\n");
-        free(window);
-        free(out_buf);
-        return RESULT_ERROR;
-      }
+  if (out_pos != capacity)
+  {
+    LOG_WARN("[LZ77] ВНИМАНИЕ: размер не совпадает! Ожидалось %zu, получено "
+             "%zu\n", capacity, out_pos);
+  }
 
-      out_buf[out_pos++] = b;
+  *output_size = out_pos;
 
-      if (window_len < LZ77_WINDOW_SIZE)
-      {
-        window[window_len++] = b;
-      }
-      else
-      {
-        memmove(window, window + 1, LZ77_WINDOW_SIZE - 1);
-        window[LZ77_WINDOW_SIZE - 1] = b;
-      }
-    }
-  }
+  LOG_DEBUG("[LZ77] Декомпрессия завершена: %zu байт\n", out_pos);
 
-  free(window);
+  return RESULT_OK;
+}
 
-  if (out_pos != *output_size)
-  {
-    printf(
-      "[LZ77] ВНИМАНИЕ: размер не совпадает! Ожидалось %zu, получено %zu\n",
-      *output_size, out_pos);
+Result lz77_decompress(const Byte* input, Size input_size, Byte** output,
+                       Size* output_size, Byte prefix)
+{
+  if (!input || !output || !output_size || input_size == 0)
+    return RESULT_INVALID_ARGUMENT;
 
-    *output_size = out_pos;
+  Byte* out_buf = (Byte*)malloc(*output_size);
+  if (!out_buf)
+    return RESULT_MEMORY_ERROR;
 
-    if (out_pos > 0)
-    {
-      Byte* trimmed = (Byte*)realloc(out_buf, out_pos);
-      if (trimmed)
-        out_buf = trimmed;
-    }
-    else
-    {
-      free(out_buf);
-      *output = NULL;
-      return RESULT_OK;
-    }
+  Result result =
+    lz77_decompress_into(input, input_size, out_buf, output_size, prefix);
+  if (result != RESULT_OK)
+  {
+    free(out_buf);
+    return result;
   }
 
-  *output = out_buf;
-
-  printf("[LZ77] Декомпрессия завершена: %zu байт\n", out_pos);
+  if (*output_size == 0)
+  {
+    free(out_buf);
+    *output = NULL;
+    return RESULT_OK;
+  }
 
+  *output = out_buf;
   return RESULT_OK;
 }
 
@@ -496,8 +436,8 @@ Byte lz77_analyze_prefix(const Byte* data, Size size)
     }
   }
 
-  printf("[LZ77] Выбран префикс: 0x%02X (встречается %u раз)\n", best,
-         freq[best]);
+  LOG_DEBUG("[LZ77] Выбран префикс: 0x%02X (встречается %u раз)\n", best,
+            freq[best]);
 
   return best;
 }
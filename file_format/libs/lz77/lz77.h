@@ -24,6 +24,28 @@ Result lz77_compress(const Byte* input, Size input_size, Byte** output,
 Result lz77_decompress(const Byte* input, Size input_size, Byte** output,
                        Size* output_size, Byte prefix);
 
+// Варианты с буфером вызывающего кода. Для сжатия достаточно
+// lz77_compress_bound(input_size) байт; при декомпрессии *output_size на
+// входе - размер буфера (ожидаемый размер данных), на выходе - записано
+Size lz77_compress_bound(Size input_size);
+Result lz77_compress_into(const Byte* input, Size input_size, Byte* output,
+                          Size output_capacity, Size* output_size, Byte prefix);
+Result lz77_decompress_into(const Byte* input, Size input_size, Byte* output,
+                            Size* output_size, Byte prefix);
+
+// Варианты с затравкой окна, как у lzh: dictionary считается данными,
+// предшествующими входу, используются последние LZ77_WINDOW_SIZE байт
+Result lz77_compress_into_with_dictionary(const Byte* input, Size input_size,
+                                          const Byte* dictionary,
+                                          Size dictionary_size, Byte* output,
+                                          Size output_capacity,
+                                          Size* output_size, Byte prefix);
+Result lz77_decompress_into_with_dictionary(const Byte* input, Size input_size,
+                                            const Byte* dictionary,
+                                            Size dictionary_size,
+                                            Byte* output, Size* output_size,
+                                            Byte prefix);
+
 Byte lz77_analyze_prefix(const Byte* data, Size size);
 
 #endif  // LZ77_LZ77_H
@@ -1,9 +1,9 @@
 #include "lz78.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
 #include "types.h"
 
 #define BYTES_IN_CODE \
@@ -19,30 +19,31 @@ LZ78Context* lz78_create(void)
   LZ78Context* context = (LZ78Context*)malloc(sizeof(LZ78Context));
   if (!context)
   {
-    printf("[LZ78] Ошибка выделения памяти для контекста\n");
+    LOG_ERROR("[LZ78] Ошибка выделения памяти для контекста\n");
     return NULL;
   }
 
   context->dict_capacity = LZ78_DICT_SIZE;
   context->dictionary =
     (LZ78DictEntry*)malloc(sizeof(LZ78DictEntry) * context->dict_capacity);
-  if (!context->dictionary)
+  context->phrases = arena_create(0);
+  if (!context->dictionary || !context->phrases)
   {
-    printf("[LZ78] Ошибка выделения памяти для словаря\n");
+    LOG_ERROR("[LZ78] Ошибка выделения памяти для словаря\n");
+    free(context->dictionary);
+    arena_destroy(context->phrases);
     free(context);
     return NULL;
   }
 
-  // Инициализация словаря
+  // Инициализация словаря: однобайтовые фразы ссылаются на таблицу
+  // символов внутри контекста
   for (Size i = 0; i < 256; i++)
   {
-    context->dictionary[i].data = (Byte*)malloc(1);
-    if (context->dictionary[i].data)
-    {
-      context->dictionary[i].data[0] = (Byte)i;
-      context->dictionary[i].length = 1;
-      context->dictionary[i].code = i;
-    }
+    context->symbols[i] = (Byte)i;
+    context->dictionary[i].data = &context->symbols[i];
+    context->dictionary[i].length = 1;
+    context->dictionary[i].code = i;
   }
 
   for (Size i = 256; i < context->dict_capacity; i++)
@@ -56,8 +57,8 @@ LZ78Context* lz78_create(void)
   context->next_code = 256;  // Следующий код для добавления
   context->current_length = 0;
 
-  printf("[LZ78] Создан контекст LZ78 с размером словаря %zu\n",
-         context->dict_capacity);
+  LOG_DEBUG("[LZ78] Создан контекст LZ78 с размером словаря %zu\n",
+            context->dict_capacity);
   return context;
 }
 
@@ -68,18 +69,8 @@ void lz78_destroy(LZ78Context* context)
     return;
   }
 
-  if (context->dictionary)
-  {
-    for (Size i = 0; i < context->dict_capacity; i++)
-    {
-      if (context->dictionary[i].data)
-      {
-        free(context->dictionary[i].data);
-      }
-    }
-    free(context->dictionary);
-  }
-
+  free(context->dictionary);
+  arena_destroy(context->phrases);
   free(context);
 }
 
@@ -92,13 +83,10 @@ void lz78_reset(LZ78Context* context)
 
   for (Size i = 256; i < context->dict_size; i++)
   {
-    if (context->dictionary[i].data)
-    {
-      free(context->dictionary[i].data);
-      context->dictionary[i].data = NULL;
-      context->dictionary[i].length = 0;
-    }
+    context->dictionary[i].data = NULL;
+    context->dictionary[i].length = 0;
   }
+  arena_reset(context->phrases);
 
   context->dict_size = 256;
   context->next_code = 256;
@@ -127,7 +115,7 @@ static Result add_to_dictionary(LZ78Context* context, const Byte* data,
 {
   if (context->next_code >= context->dict_capacity)
   {
-    printf("[LZ78] Словарь полон, сбрасываем\n");
+    LOG_DEBUG("[LZ78] Словарь полон, сбрасываем\n");
     lz78_reset(context);
   }
 
@@ -136,10 +124,10 @@ static Result add_to_dictionary(LZ78Context* context, const Byte* data,
     return RESULT_ERROR;
   }
 
-  Byte* phrase = (Byte*)malloc(length);
+  Byte* phrase = (Byte*)arena_alloc(context->phrases, length);
   if (!phrase)
   {
-    printf("[LZ78] Ошибка выделения памяти для новой фразы\n");
+    LOG_ERROR("[LZ78] Ошибка выделения памяти для новой фразы\n");
     return RESULT_MEMORY_ERROR;
   }
 
@@ -198,16 +186,22 @@ static Size bits_to_bytes(Size bits)
   return (bits + 7) / 8;
 }
 
-Result lz78_compress(const Byte* input, Size input_size, Byte** output,
-                     Size* output_size)
+Size lz78_compress_bound(Size input_size)
+{
+  // Каждый символ может стать парой: 12-битный код + 8-битный символ
+  return bits_to_bytes(input_size * (LZ78_MAX_CODE_LENGTH + 8));
+}
+
+Result lz78_compress_into(const Byte* input, Size input_size, Byte* output,
+                          Size output_capacity, Size* output_size)
 {
   if (!input || !output || !output_size || input_size == 0)
   {
-    printf("[LZ78] Ошибка: неверные параметры в lz78_compress\n");
+    LOG_ERROR("[LZ78] Ошибка: неверные параметры в lz78_compress\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[LZ78] Начало сжатия LZ78, размер данных: %zu байт\n", input_size);
+  LOG_DEBUG("[LZ78] Начало сжатия LZ78, размер данных: %zu байт\n", input_size);
 
   // Создаем контекст
   LZ78Context* context = lz78_create();
@@ -216,20 +210,6 @@ Result lz78_compress(const Byte* input, Size input_size, Byte** output,
     return RESULT_MEMORY_ERROR;
   }
 
-  // Максимальный размер выходных данных: каждый символ может стать парой (код +
-  // байт) Формат: 12-битный код + 8-битный символ
-  Size max_output_bits = input_size * (LZ78_MAX_CODE_LENGTH + 8);
-  Size max_output_bytes = bits_to_bytes(max_output_bits);
-
-  Byte* compressed = (Byte*)malloc(max_output_bytes);
-  if (!compressed)
-  {
-    printf("[LZ78] Ошибка выделения памяти для сжатых данных\n");
-    lz78_destroy(context);
-    return RESULT_MEMORY_ERROR;
-  }
-
-  memset(compressed, 0, max_output_bytes);
   Size bit_pos = 0;
 
   Byte current_phrase[LZ78_DICT_SIZE];
@@ -247,6 +227,14 @@ Result lz78_compress(const Byte* input, Size input_size, Byte** output,
       Size code_to_output;
       Byte next_char;
 
+      if (bits_to_bytes(bit_pos + LZ78_MAX_CODE_LENGTH + 8) > output_capacity)
+      {
+        LOG_ERROR("[LZ78] Ошибка: выходной буфер (%zu байт) переполнен\n",
+                  output_capacity);
+        lz78_destroy(context);
+        return RESULT_ERROR;
+      }
+
       if (current_len == 1)
       {
         // Одиночный символ, код 0
@@ -264,8 +252,8 @@ Result lz78_compress(const Byte* input, Size input_size, Byte** output,
       }
 
       // Записываем код (12 бит) и следующий символ (8 бит)
-      write_bits(compressed, &bit_pos, code_to_output, LZ78_MAX_CODE_LENGTH);
-      write_bits(compressed, &bit_pos, next_char, 8);
+      write_bits(output, &bit_pos, code_to_output, LZ78_MAX_CODE_LENGTH);
+      write_bits(output, &bit_pos, next_char, 8);
 
       // Начинаем новую фразу
       current_len = 0;
@@ -273,62 +261,92 @@ Result lz78_compress(const Byte* input, Size input_size, Byte** output,
     // Иначе продолжаем накапливать фразу
   }
 
-  Size compressed_bytes = bits_to_bytes(bit_pos);
-  Byte* trimmed = (Byte*)realloc(compressed, compressed_bytes);
-  if (trimmed)
+  // Буфер не обнуляется заранее, поэтому хвост последнего байта чистим явно
+  if (bit_pos % 8 != 0)
   {
-    compressed = trimmed;
+    output[bit_pos / 8] &= (Byte)(0xFF << (8 - bit_pos % 8));
   }
 
-  *output = compressed;
+  Size compressed_bytes = bits_to_bytes(bit_pos);
   *output_size = compressed_bytes;
 
-  printf("[LZ78] Сжатие завершено\n");
-  printf("[LZ78] Исходный размер: %zu байт\n", input_size);
-  printf("[LZ78] Сжатый размер: %zu байт\n", compressed_bytes);
+  LOG_DEBUG("[LZ78] Сжатие завершено\n");
+  LOG_DEBUG("[LZ78] Исходный размер: %zu байт\n", input_size);
+  LOG_DEBUG("[LZ78] Сжатый размер: %zu байт\n", compressed_bytes);
 
   if (input_size > 0)
   {
     double ratio = (1.0 - (double)compressed_bytes / (double)input_size) * 100;
-    printf("[LZ78] Коэффициент сжатия: %.2f%%\n", ratio);
+    LOG_DEBUG("[LZ78] Коэффициент сжатия: %.2f%%\n", ratio);
   }
 
   lz78_destroy(context);
   return RESULT_OK;
 }
 
-Result lz78_decompress(const Byte* input, Size input_size, Byte** output,
-                       Size* output_size)
+Result lz78_compress(const Byte* input, Size input_size, Byte** output,
+                     Size* output_size)
 {
   if (!input || !output || !output_size || input_size == 0)
   {
-    printf("[LZ78] Ошибка: неверные параметры в lz78_decompress\n");
+    LOG_ERROR("[LZ78] Ошибка: неверные параметры в lz78_compress\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[LZ78] Начало декомпрессии LZ78\n");
-  printf("[LZ78] Размер входных данных: %zu байт\n", input_size);
-  printf("[LZ78] Ожидаемый выходной размер: %zu байт\n", *output_size);
-
-  LZ78Context* context = lz78_create();
-  if (!context)
+  Size capacity = lz78_compress_bound(input_size);
+  Byte* compressed = (Byte*)malloc(capacity);
+  if (!compressed)
   {
+    LOG_ERROR("[LZ78] Ошибка выделения памяти для сжатых данных\n");
     return RESULT_MEMORY_ERROR;
   }
 
-  Byte* decompressed = (Byte*)malloc(*output_size);
-  if (!decompressed)
+  Size compressed_size = 0;
+  Result result = lz78_compress_into(input, input_size, compressed, capacity,
+                                     &compressed_size);
+  if (result != RESULT_OK)
+  {
+    free(compressed);
+    return result;
+  }
+
+  Byte* trimmed = (Byte*)realloc(compressed, compressed_size);
+  if (trimmed)
+  {
+    compressed = trimmed;
+  }
+
+  *output = compressed;
+  *output_size = compressed_size;
+  return RESULT_OK;
+}
+
+Result lz78_decompress_into(const Byte* input, Size input_size, Byte* output,
+                            Size* output_size)
+{
+  if (!input || !output || !output_size || input_size == 0)
+  {
+    LOG_ERROR("[LZ78] Ошибка: неверные параметры в lz78_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  LOG_DEBUG("[LZ78] Начало декомпрессии LZ78\n");
+  LOG_DEBUG("[LZ78] Размер входных данных: %zu байт\n", input_size);
+  LOG_DEBUG("[LZ78] Ожидаемый выходной размер: %zu байт\n", *output_size);
+
+  LZ78Context* context = lz78_create();
+  if (!context)
   {
-    printf("[LZ78] Ошибка выделения памяти для декомпрессированных данных\n");
-    lz78_destroy(context);
     return RESULT_MEMORY_ERROR;
   }
 
+  Byte* decompressed = output;
+  Size capacity = *output_size;
   Size out_pos = 0;
   Size bit_pos = 0;
   Size total_bits = input_size * 8;
 
-  while (bit_pos < total_bits && out_pos < *output_size)
+  while (bit_pos < total_bits && out_pos < capacity)
   {
     if (bit_pos + LZ78_MAX_CODE_LENGTH > total_bits)
     {
@@ -361,22 +379,22 @@ Result lz78_decompress(const Byte* input, Size input_size, Byte** output,
       }
       else
       {
-        printf("[LZ78] Ошибка: код %zu не найден в словаре\n", code);
-        free(decompressed);
+        LOG_ERROR("[LZ78] Ошибка: код %zu не найден в словаре\n", code);
         lz78_destroy(context);
         return RESULT_ERROR;
       }
 
-      Byte* new_phrase = (Byte*)malloc(phrase_len + 1);
-      if (new_phrase)
+      // Новая фраза собирается в буфере контекста: сброс полного словаря
+      // при добавлении освобождает арену фраз, поэтому для вывода тоже
+      // используется копия
+      if (phrase_len < LZ78_DICT_SIZE)
       {
-        memcpy(new_phrase, phrase, phrase_len);
-        new_phrase[phrase_len] = next_char;
+        memcpy(context->current_phrase, phrase, phrase_len);
+        context->current_phrase[phrase_len] = next_char;
+        phrase = context->current_phrase;
 
         // Добавляем в словарь
-        add_to_dictionary(context, new_phrase, phrase_len + 1);
-
-        free(new_phrase);
+        add_to_dictionary(context, context->current_phrase, phrase_len + 1);
       }
     }
 
@@ -384,50 +402,57 @@ Result lz78_decompress(const Byte* input, Size input_size, Byte** output,
     if (phrase)
     {
       // Добавляем старую фразу
-      if (out_pos + phrase_len <= *output_size)
+      if (out_pos + phrase_len <= capacity)
       {
         memcpy(decompressed + out_pos, phrase, phrase_len);
         out_pos += phrase_len;
       }
 
       // Добавляем следующий символ
-      if (out_pos < *output_size)
+      if (out_pos < capacity)
       {
         decompressed[out_pos++] = next_char;
       }
     }
   }
 
-  // Обрезаем буфер до фактического размера
-  if (out_pos != *output_size)
+  *output_size = out_pos;
+
+  LOG_DEBUG("[LZ78] Декомпрессия завершена\n");
+  LOG_DEBUG("[LZ78] Декомпрессировано байт: %zu\n", out_pos);
+
+  LOG_DEBUG_DUMP("[LZ78] Первые 32 байта декомпрессированных данных",
+                 decompressed, out_pos, 32);
+
+  lz78_destroy(context);
+  return RESULT_OK;
+}
+
+Result lz78_decompress(const Byte* input, Size input_size, Byte** output,
+                       Size* output_size)
+{
+  if (!input || !output || !output_size || input_size == 0)
   {
-    Byte* trimmed = (Byte*)realloc(decompressed, out_pos);
-    if (trimmed)
-    {
-      decompressed = trimmed;
-      *output_size = out_pos;
-    }
+    LOG_ERROR("[LZ78] Ошибка: неверные параметры в lz78_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[LZ78] Декомпрессия завершена\n");
-  printf("[LZ78] Декомпрессировано байт: %zu\n", out_pos);
-
-  printf("[LZ78] Первые 32 байта декомпрессированных данных: ");
-  for (Size i = 0; i < 32 && i < out_pos; i++)
+  Byte* decompressed = (Byte*)malloc(*output_size > 0 ? *output_size : 1);
+  if (!decompressed)
   {
-    printf("%02X ", decompressed[i]);
+    LOG_ERROR("[LZ78] Ошибка выделения памяти для декомпрессированных "
+              "данных\n");
+    return RESULT_MEMORY_ERROR;
   }
-  printf("\n");
 
-  printf("[LZ78] Первые 32 байта как текст: ");
-  for (Size i = 0; i < 32 && i < out_pos; i++)
+  Result result =
+    lz78_decompress_into(input, input_size, decompressed, output_size);
+  if (result != RESULT_OK)
   {
-    Byte b = decompressed[i];
-    printf("%c", (b >= 32 && b <= 126) ? b : '.');
+    free(decompressed);
+    return result;
   }
-  printf("\n");
 
   *output = decompressed;
-  lz78_destroy(context);
   return RESULT_OK;
 }
@@ -1,6 +1,7 @@
 #ifndef LZ78_LZ78_H
 #define LZ78_LZ78_H
 
+#include "arena.h"
 #include "types.h"
 
 #define LZ78_DICT_SIZE 4096  // 12-битные коды (как в LZW)
@@ -22,6 +23,8 @@ typedef struct LZ78Context
   Size next_code;
   Byte current_phrase[LZ78_DICT_SIZE];
   Size current_length;
+  Byte symbols[LZ78_DICT_START];  // Данные начальных однобайтовых фраз
+  Arena* phrases;  // Фразы с кодами от LZ78_DICT_START, сброс - одним вызовом
 } LZ78Context;
 
 LZ78Context* lz78_create(void);
@@ -31,6 +34,13 @@ Result lz78_compress(const Byte* input, Size input_size, Byte** output,
 Result lz78_decompress(const Byte* input, Size input_size, Byte** output,
                        Size* output_size);
 
+// Варианты с буфером вызывающего кода, семантика как у lz77_*_into
+Size lz78_compress_bound(Size input_size);
+Result lz78_compress_into(const Byte* input, Size input_size, Byte* output,
+                          Size output_capacity, Size* output_size);
+Result lz78_decompress_into(const Byte* input, Size input_size, Byte* output,
+                            Size* output_size);
+
 void lz78_reset(LZ78Context* context);
 
 #endif  // LZ78_LZ78_H
@@ -0,0 +1,1267 @@
+#include "lzh.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "types.h"
+
+#define LZH_HASH_BITS 15
+#define LZH_HASH_SIZE (1 << LZH_HASH_BITS)
+#define LZH_WINDOW_MASK (LZH_WINDOW_SIZE - 1)
+#define LZH_NO_POSITION ((Size)-1)
+#define LZH_NO_PRICE 0xFFFFFFFFu
+#define LZH_OPTIMAL_PASSES 2  // Первый проход оценивает цены для второго
+
+#define LZH_LENGTH_CODES 29
+#define LZH_CODE_LENGTHS (LZH_LITLEN_SYMBOLS + LZH_DISTANCE_SYMBOLS)
+#define LZH_ZERO_RUN 16  // Максимальная серия нулевых длин кодов
+#define LZH_TABLE_SIZE (1 << LZH_MAX_CODE_BITS)
+
+static const Word length_base[LZH_LENGTH_CODES] = {
+  3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const Byte length_extra[LZH_LENGTH_CODES] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+  5, 5, 5, 5, 0};
+static const Word distance_base[LZH_DISTANCE_SYMBOLS] = {
+  1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,
+  65,  97,  129, 193, 257, 385,  513,  769,  1025, 1537, 2049, 3073,
+  4097, 6145, 8193, 12289, 16385, 24577};
+static const Byte distance_extra[LZH_DISTANCE_SYMBOLS] = {
+  0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+typedef struct
+{
+  Word max_chain;   // Кандидатов цепочки хеша на одну позицию
+  Word nice_match;  // Найдя такое совпадение, поиск прекращается
+  Word lazy_match;  // Более длинное совпадение не откладывается
+  bool optimal;     // Оптимальный разбор вместо ленивого
+} LZHLevel;
+
+// Индекс - уровень сжатия, нулевой элемент не используется
+static const LZHLevel lzh_levels[LZH_LEVEL_MAX + 1] = {
+  {0, 0, 0, false},
+  {4, 16, 0, false},
+  {8, 32, 0, false},
+  {16, 64, 0, false},
+  {32, 64, 8, false},
+  {64, 128, 16, false},
+  {128, 128, 32, false},
+  {256, 258, 64, false},
+  {1024, 258, 258, false},
+  {1024, 258, 0, true},
+};
+
+typedef struct
+{
+  Word length;
+  Word distance;
+} LZHMatch;
+
+typedef struct
+{
+  Byte* data;
+  Size capacity;
+  Size position;
+  QWord buffer;
+  DWord count;  // Бит в buffer
+  bool overflow;
+} LZHBitWriter;
+
+typedef struct
+{
+  const Byte* data;
+  Size size;
+  Size position;  // Следующий байт для buffer, за концом данных - нули
+  QWord buffer;
+  DWord count;
+} LZHBitReader;
+
+// Состояние кодера: цепочки хеша по всему входу и токены текущего блока.
+// Алфавиты литералов/длин и смещений лежат в массивах подряд. Поля после
+// length_code нужны только оптимальному разбору и индексируются позицией
+// внутри блока
+typedef struct
+{
+  const LZHLevel* level;
+  Size head[LZH_HASH_SIZE];
+  Size prev[LZH_WINDOW_SIZE];
+  DWord tokens[LZH_BLOCK_SIZE];  // Литерал или (длина << 16) | (смещение-1)
+  DWord freq[LZH_CODE_LENGTHS];
+  Byte lengths[LZH_CODE_LENGTHS];
+  Word codes[LZH_CODE_LENGTHS];
+  Byte length_code[LZH_MAX_MATCH + 1];
+
+  LZHMatch* matches;  // Совпадения всех позиций блока подряд
+  Size match_capacity;
+  DWord match_start[LZH_BLOCK_SIZE + 1];  // Первое совпадение позиции
+  DWord price[LZH_BLOCK_SIZE + 1];        // Цена разбора до позиции
+  Word step_length[LZH_BLOCK_SIZE + 1];   // Последний токен этого разбора
+  Word step_distance[LZH_BLOCK_SIZE + 1];
+  Byte symbol_price[LZH_CODE_LENGTHS];
+  Word length_price[LZH_MAX_MATCH + 1];  // Код длины с доп. битами
+} LZHEncoder;
+
+static void write_bits(LZHBitWriter* writer, DWord value, DWord bits)
+{
+  writer->buffer |= (QWord)value << writer->count;
+  writer->count += bits;
+
+  while (writer->count >= 8)
+  {
+    if (writer->position < writer->capacity)
+    {
+      writer->data[writer->position++] = (Byte)writer->buffer;
+    }
+    else
+    {
+      writer->overflow = true;
+    }
+    writer->buffer >>= 8;
+    writer->count -= 8;
+  }
+}
+
+static void flush_bits(LZHBitWriter* writer)
+{
+  write_bits(writer, 0, (8 - writer->count) & 7);
+}
+
+static void refill_bits(LZHBitReader* reader)
+{
+  while (reader->count <= 56)
+  {
+    Byte value =
+      reader->position < reader->size ? reader->data[reader->position] : 0;
+    reader->buffer |= (QWord)value << reader->count;
+    reader->position++;
+    reader->count += 8;
+  }
+}
+
+static DWord read_bits(LZHBitReader* reader, DWord bits)
+{
+  DWord value = (DWord)(reader->buffer & (((QWord)1 << bits) - 1));
+  reader->buffer >>= bits;
+  reader->count -= bits;
+  return value;
+}
+
+static bool reader_overrun(const LZHBitReader* reader)
+{
+  return reader->position - reader->count / 8 > reader->size;
+}
+
+static Byte distance_code(Size distance)
+{
+  Size value = distance - 1;
+  if (value < 4)
+  {
+    return (Byte)value;
+  }
+
+  // Два кода на каждый старший бит value, младший из них - по следующему биту
+  DWord top = 0;
+  while ((value >> (top + 1)) != 0)
+  {
+    top++;
+  }
+
+  return (Byte)(2 * top + ((value >> (top - 1)) & 1));
+}
+
+// Длины кодов Хаффмана по частотам. Если дерево глубже LZH_MAX_CODE_BITS,
+// частоты огрубляются сдвигом и дерево строится заново
+static void build_lengths(const DWord* freq, Size count, Byte* lengths)
+{
+  Word symbols[LZH_LITLEN_SYMBOLS];
+  DWord weight[2 * LZH_LITLEN_SYMBOLS];
+  Word parent[2 * LZH_LITLEN_SYMBOLS];
+  Word depth[2 * LZH_LITLEN_SYMBOLS];
+  Size used = 0;
+
+  memset(lengths, 0, count);
+
+  // Символы по возрастанию частоты (вставками: символов не больше 286)
+  for (Size symbol = 0; symbol < count; symbol++)
+  {
+    if (freq[symbol] == 0)
+    {
+      continue;
+    }
+
+    Size i = used++;
+    while (i > 0 && freq[symbols[i - 1]] > freq[symbol])
+    {
+      symbols[i] = symbols[i - 1];
+      i--;
+    }
+    symbols[i] = (Word)symbol;
+  }
+
+  if (used == 0)
+  {
+    return;
+  }
+
+  if (used == 1)
+  {
+    lengths[symbols[0]] = 1;
+    return;
+  }
+
+  for (DWord shift = 0;; shift++)
+  {
+    for (Size i = 0; i < used; i++)
+    {
+      weight[i] = (freq[symbols[i]] >> shift) + 1;
+    }
+
+    // Две очереди: отсортированные листья и внутренние узлы, которые
+    // создаются в порядке неубывания веса
+    Size leaf = 0;
+    Size node = used;
+    Size next = used;
+    while (next < 2 * used - 1)
+    {
+      Size pick[2];
+      for (Size k = 0; k < 2; k++)
+      {
+        if (leaf < used && (node >= next || weight[leaf] <= weight[node]))
+        {
+          pick[k] = leaf++;
+        }
+        else
+        {
+          pick[k] = node++;
+        }
+      }
+
+      weight[next] = weight[pick[0]] + weight[pick[1]];
+      parent[pick[0]] = (Word)next;
+      parent[pick[1]] = (Word)next;
+      next++;
+    }
+
+    depth[next - 1] = 0;
+    Word max_depth = 0;
+    for (Size i = next - 1; i-- > 0;)
+    {
+      depth[i] = depth[parent[i]] + 1;
+      if (i < used && depth[i] > max_depth)
+      {
+        max_depth = depth[i];
+      }
+    }
+
+    if (max_depth <= LZH_MAX_CODE_BITS)
+    {
+      for (Size i = 0; i < used; i++)
+      {
+        lengths[symbols[i]] = (Byte)depth[i];
+      }
+      return;
+    }
+  }
+}
+
+// Канонические коды по длинам, развернутые для записи младшими битами
+// вперед. false - длины не образуют префиксный код
+static bool build_codes(const Byte* lengths, Size count, Word* codes)
+{
+  Word length_count[LZH_MAX_CODE_BITS + 1] = {0};
+  Word next_code[LZH_MAX_CODE_BITS + 1];
+
+  for (Size symbol = 0; symbol < count; symbol++)
+  {
+    length_count[lengths[symbol]]++;
+  }
+  length_count[0] = 0;
+
+  DWord left = 1;
+  DWord code = 0;
+  for (DWord bits = 1; bits <= LZH_MAX_CODE_BITS; bits++)
+  {
+    left <<= 1;
+    if (length_count[bits] > left)
+    {
+      return false;
+    }
+    left -= length_count[bits];
+
+    code = (code + length_count[bits - 1]) << 1;
+    next_code[bits] = (Word)code;
+  }
+
+  for (Size symbol = 0; symbol < count; symbol++)
+  {
+    Byte bits = lengths[symbol];
+    if (bits == 0)
+    {
+      continue;
+    }
+
+    Word value = next_code[bits]++;
+    Word reversed = 0;
+    for (Byte i = 0; i < bits; i++)
+    {
+      reversed = (Word)((reversed << 1) | ((value >> i) & 1));
+    }
+    codes[symbol] = reversed;
+  }
+
+  return true;
+}
+
+// Таблица декодирования по LZH_MAX_CODE_BITS младшим битам потока:
+// (символ << 4) | длина кода, 0 - недопустимый код
+static Result build_decode_table(const Byte* lengths, Size count, Word* table)
+{
+  Word codes[LZH_LITLEN_SYMBOLS];
+  if (!build_codes(lengths, count, codes))
+  {
+    return RESULT_ERROR;
+  }
+
+  memset(table, 0, LZH_TABLE_SIZE * sizeof(Word));
+  for (Size symbol = 0; symbol < count; symbol++)
+  {
+    Byte bits = lengths[symbol];
+    if (bits == 0)
+    {
+      continue;
+    }
+
+    for (Size slot = codes[symbol]; slot < LZH_TABLE_SIZE;
+         slot += (Size)1 << bits)
+    {
+      table[slot] = (Word)((symbol << 4) | bits);
+    }
+  }
+
+  return RESULT_OK;
+}
+
+// Длины кодов обоих алфавитов подряд: 4 бита на длину, нулевые длины -
+// сериями до LZH_ZERO_RUN. writer == NULL - только подсчет битов
+static Size write_code_lengths(LZHBitWriter* writer, const Byte* lengths)
+{
+  Size bits = 0;
+
+  for (Size i = 0; i < LZH_CODE_LENGTHS;)
+  {
+    if (lengths[i] != 0)
+    {
+      if (writer)
+      {
+        write_bits(writer, lengths[i], 4);
+      }
+      bits += 4;
+      i++;
+      continue;
+    }
+
+    Size run = 1;
+    while (i + run < LZH_CODE_LENGTHS && run < LZH_ZERO_RUN &&
+           lengths[i + run] == 0)
+    {
+      run++;
+    }
+
+    if (writer)
+    {
+      write_bits(writer, 0, 4);
+      write_bits(writer, (DWord)(run - 1), 4);
+    }
+    bits += 8;
+    i += run;
+  }
+
+  return bits;
+}
+
+static DWord hash_at(const Byte* data)
+{
+  DWord value = ((DWord)data[0] << 16) | ((DWord)data[1] << 8) | data[2];
+  return (value * 2654435761u) >> (32 - LZH_HASH_BITS);
+}
+
+// Добавляет позицию в цепочку ее хеша, возвращает прежнее начало цепочки
+static Size insert_position(LZHEncoder* encoder, const Byte* input,
+                            Size input_size, Size position)
+{
+  if (position + LZH_MIN_MATCH > input_size)
+  {
+    return LZH_NO_POSITION;
+  }
+
+  DWord hash = hash_at(input + position);
+  Size candidate = encoder->head[hash];
+  encoder->head[hash] = position;
+  encoder->prev[position & LZH_WINDOW_MASK] = candidate;
+  return candidate;
+}
+
+// Цепочка хеша идет от ближних позиций к дальним. Смещения ограничены
+// LZH_WINDOW_SIZE - 1, поэтому элементы prev на пути еще не перезаписаны.
+// Если matches != NULL, туда пишется каждое удлинение лучшего совпадения:
+// длины возрастают, и для каждой длины смещение минимально
+static Size find_match(const LZHEncoder* encoder, const Byte* input,
+                       Size position, Size candidate, Size max_length,
+                       Size* distance, LZHMatch* matches, Size* match_count)
+{
+  const Byte* current = input + position;
+  Size best_length = 0;
+
+  for (Size chain = 0; chain < encoder->level->max_chain; chain++)
+  {
+    if (candidate == LZH_NO_POSITION ||
+        position - candidate >= LZH_WINDOW_SIZE)
+    {
+      break;
+    }
+
+    const Byte* match = input + candidate;
+    if (match[best_length] == current[best_length])
+    {
+      Size length = 0;
+      while (length < max_length && match[length] == current[length])
+      {
+        length++;
+      }
+
+      if (length > best_length)
+      {
+        best_length = length;
+        *distance = position - candidate;
+        if (matches && length >= LZH_MIN_MATCH)
+        {
+          matches[*match_count].length = (Word)length;
+          matches[*match_count].distance = (Word)*distance;
+          (*match_count)++;
+        }
+        if (length >= max_length || length >= encoder->level->nice_match)
+        {
+          break;
+        }
+      }
+    }
+
+    candidate = encoder->prev[candidate & LZH_WINDOW_MASK];
+  }
+
+  return best_length >= LZH_MIN_MATCH ? best_length : 0;
+}
+
+static void add_literal(LZHEncoder* encoder, Size slot, Byte value)
+{
+  encoder->tokens[slot] = value;
+  encoder->freq[value]++;
+}
+
+static void add_match(LZHEncoder* encoder, Size slot, Size length,
+                      Size distance)
+{
+  encoder->tokens[slot] = (DWord)((length << 16) | (distance - 1));
+  encoder->freq[LZH_END_OF_BLOCK + 1 + encoder->length_code[length]]++;
+  encoder->freq[LZH_LITLEN_SYMBOLS + distance_code(distance)]++;
+}
+
+// Разбор [start, end) на токены с ленивым сопоставлением: совпадение
+// откладывается на байт, если со следующей позиции находится более длинное
+// (при lazy_match == 0 разбор жадный). Совпадения не выходят за конец
+// блока, но ссылаются и на прошлые блоки
+static Size parse_block(LZHEncoder* encoder, const Byte* input,
+                        Size input_size, Size start, Size end)
+{
+  Size token_count = 0;
+  Size pending_length = 0;
+  Size pending_distance = 0;
+  bool pending = false;  // Байт position - 1 еще не закодирован
+  Size position = start;
+
+  while (position < end)
+  {
+    Size candidate = insert_position(encoder, input, input_size, position);
+    Size max_length = end - position;
+    if (max_length > LZH_MAX_MATCH)
+    {
+      max_length = LZH_MAX_MATCH;
+    }
+
+    Size length = 0;
+    Size distance = 0;
+    if ((pending_length < LZH_MIN_MATCH ||
+         pending_length < encoder->level->lazy_match) &&
+        max_length >= LZH_MIN_MATCH)
+    {
+      length = find_match(encoder, input, position, candidate, max_length,
+                          &distance, NULL, NULL);
+    }
+
+    if (pending_length >= LZH_MIN_MATCH && length <= pending_length)
+    {
+      add_match(encoder, token_count++, pending_length, pending_distance);
+
+      Size match_end = position - 1 + pending_length;
+      for (position++; position < match_end; position++)
+      {
+        insert_position(encoder, input, input_size, position);
+      }
+
+      pending = false;
+      pending_length = 0;
+    }
+    else
+    {
+      if (pending)
+      {
+        add_literal(encoder, token_count++, input[position - 1]);
+      }
+
+      pending = true;
+      pending_length = length;
+      pending_distance = distance;
+      position++;
+    }
+  }
+
+  if (pending)
+  {
+    add_literal(encoder, token_count++, input[position - 1]);
+  }
+
+  return token_count;
+}
+
+static void build_block_lengths(LZHEncoder* encoder)
+{
+  build_lengths(encoder->freq, LZH_LITLEN_SYMBOLS, encoder->lengths);
+  build_lengths(encoder->freq + LZH_LITLEN_SYMBOLS, LZH_DISTANCE_SYMBOLS,
+                encoder->lengths + LZH_LITLEN_SYMBOLS);
+}
+
+// Совпадения для каждой позиции [start, end). После совпадения длиной не
+// меньше nice_match позиции внутри него только добавляются в хеш: для
+// разбора там остаются литералы, зато поиск по длинным сериям линеен
+static Result collect_matches(LZHEncoder* encoder, const Byte* input,
+                              Size input_size, Size start, Size end)
+{
+  Size count = 0;
+  Size skip_until = start;
+
+  for (Size position = start; position < end; position++)
+  {
+    encoder->match_start[position - start] = (DWord)count;
+
+    Size candidate = insert_position(encoder, input, input_size, position);
+    Size max_length = end - position;
+    if (max_length > LZH_MAX_MATCH)
+    {
+      max_length = LZH_MAX_MATCH;
+    }
+
+    if (position < skip_until || max_length < LZH_MIN_MATCH)
+    {
+      continue;
+    }
+
+    // Длины удлинений строго растут, поэтому их не больше LZH_MAX_MATCH
+    if (encoder->match_capacity - count < LZH_MAX_MATCH)
+    {
+      Size capacity = encoder->match_capacity * 2 + LZH_MAX_MATCH;
+      LZHMatch* matches = (LZHMatch*)realloc(
+        encoder->matches, capacity * sizeof(LZHMatch));
+      if (matches == NULL)
+      {
+        return RESULT_MEMORY_ERROR;
+      }
+      encoder->matches = matches;
+      encoder->match_capacity = capacity;
+    }
+
+    Size distance = 0;
+    Size length = find_match(encoder, input, position, candidate, max_length,
+                             &distance, encoder->matches, &count);
+    if (length >= encoder->level->nice_match)
+    {
+      skip_until = position + length;
+    }
+  }
+
+  encoder->match_start[end - start] = (DWord)count;
+  return RESULT_OK;
+}
+
+// Цены символов в битах. Без статистики берутся оценки: литерал 8 бит,
+// код длины 7, код смещения 5; символ, не встречавшийся в прошлом
+// проходе, оценивается самым длинным кодом
+static void set_prices(LZHEncoder* encoder, bool has_lengths)
+{
+  for (Size symbol = 0; symbol < LZH_CODE_LENGTHS; symbol++)
+  {
+    Byte price = symbol < LZH_END_OF_BLOCK      ? 8
+                 : symbol < LZH_LITLEN_SYMBOLS ? 7
+                                               : 5;
+    if (has_lengths)
+    {
+      price = encoder->lengths[symbol] != 0 ? encoder->lengths[symbol]
+                                            : LZH_MAX_CODE_BITS;
+    }
+    encoder->symbol_price[symbol] = price;
+  }
+
+  for (Size length = LZH_MIN_MATCH; length <= LZH_MAX_MATCH; length++)
+  {
+    Byte code = encoder->length_code[length];
+    encoder->length_price[length] =
+      (Word)(encoder->symbol_price[LZH_END_OF_BLOCK + 1 + code] +
+             length_extra[code]);
+  }
+}
+
+// Кратчайший по цене путь через граф блока: из позиции ведут литерал и
+// все совпадения, найденные collect_matches (каждое - для всех длин до
+// своей). Токены восстанавливаются от конца блока и пересчитываются частоты
+static Size optimal_parse(LZHEncoder* encoder, const Byte* input, Size start,
+                          Size end)
+{
+  Size count = end - start;
+  DWord* price = encoder->price;
+
+  price[0] = 0;
+  for (Size i = 1; i <= count; i++)
+  {
+    price[i] = LZH_NO_PRICE;
+  }
+
+  for (Size i = 0; i < count; i++)
+  {
+    DWord base = price[i];
+
+    DWord literal = base + encoder->symbol_price[input[start + i]];
+    if (literal < price[i + 1])
+    {
+      price[i + 1] = literal;
+      encoder->step_length[i + 1] = 1;
+    }
+
+    Size length = LZH_MIN_MATCH;
+    for (DWord m = encoder->match_start[i]; m < encoder->match_start[i + 1];
+         m++)
+    {
+      const LZHMatch* match = &encoder->matches[m];
+      Byte code = distance_code(match->distance);
+      DWord distance_price =
+        encoder->symbol_price[LZH_LITLEN_SYMBOLS + code] + distance_extra[code];
+
+      for (; length <= match->length; length++)
+      {
+        DWord cost = base + distance_price + encoder->length_price[length];
+        if (cost < price[i + length])
+        {
+          price[i + length] = cost;
+          encoder->step_length[i + length] = (Word)length;
+          encoder->step_distance[i + length] = match->distance;
+        }
+      }
+    }
+  }
+
+  Size token_count = 0;
+  for (Size i = count; i > 0; i -= encoder->step_length[i])
+  {
+    token_count++;
+  }
+
+  memset(encoder->freq, 0, sizeof(encoder->freq));
+  encoder->freq[LZH_END_OF_BLOCK] = 1;
+
+  Size slot = token_count;
+  for (Size i = count; i > 0; i -= encoder->step_length[i])
+  {
+    if (encoder->step_length[i] == 1)
+    {
+      add_literal(encoder, --slot, input[start + i - 1]);
+    }
+    else
+    {
+      add_match(encoder, --slot, encoder->step_length[i],
+                encoder->step_distance[i]);
+    }
+  }
+
+  return token_count;
+}
+
+static Size huffman_block_bits(const LZHEncoder* encoder)
+{
+  Size bits = write_code_lengths(NULL, encoder->lengths);
+
+  for (Size symbol = 0; symbol < LZH_LITLEN_SYMBOLS; symbol++)
+  {
+    Size extra = symbol > LZH_END_OF_BLOCK
+                   ? length_extra[symbol - LZH_END_OF_BLOCK - 1]
+                   : 0;
+    bits += (Size)encoder->freq[symbol] * (encoder->lengths[symbol] + extra);
+  }
+
+  for (Size code = 0; code < LZH_DISTANCE_SYMBOLS; code++)
+  {
+    Size symbol = LZH_LITLEN_SYMBOLS + code;
+    bits += (Size)encoder->freq[symbol] *
+            (encoder->lengths[symbol] + distance_extra[code]);
+  }
+
+  return bits;
+}
+
+static void write_tokens(const LZHEncoder* encoder, LZHBitWriter* writer,
+                         Size token_count)
+{
+  const Byte* lengths = encoder->lengths;
+  const Word* codes = encoder->codes;
+
+  for (Size i = 0; i < token_count; i++)
+  {
+    DWord token = encoder->tokens[i];
+    if (token <= 0xFF)
+    {
+      write_bits(writer, codes[token], lengths[token]);
+      continue;
+    }
+
+    Size length = token >> 16;
+    Size distance = (token & 0xFFFF) + 1;
+
+    Byte code = encoder->length_code[length];
+    Size symbol = LZH_END_OF_BLOCK + 1 + code;
+    write_bits(writer, codes[symbol], lengths[symbol]);
+    write_bits(writer, (DWord)(length - length_base[code]),
+               length_extra[code]);
+
+    code = distance_code(distance);
+    symbol = LZH_LITLEN_SYMBOLS + code;
+    write_bits(writer, codes[symbol], lengths[symbol]);
+    write_bits(writer, (DWord)(distance - distance_base[code]),
+               distance_extra[code]);
+  }
+
+  write_bits(writer, codes[LZH_END_OF_BLOCK], lengths[LZH_END_OF_BLOCK]);
+}
+
+// Блок пишется сжатым, только если это короче хранения как есть
+static void write_block(LZHEncoder* encoder, LZHBitWriter* writer,
+                        const Byte* input, Size start, Size end,
+                        Size token_count, bool final)
+{
+  build_block_lengths(encoder);
+
+  Size raw_size = end - start;
+  Size stored_bits =
+    ((8 - (writer->count + 2) % 8) % 8) + 32 + raw_size * 8;
+  DWord header = final ? LZH_BLOCK_FINAL : 0;
+
+  if (huffman_block_bits(encoder) < stored_bits)
+  {
+    build_codes(encoder->lengths, LZH_LITLEN_SYMBOLS, encoder->codes);
+    build_codes(encoder->lengths + LZH_LITLEN_SYMBOLS, LZH_DISTANCE_SYMBOLS,
+                encoder->codes + LZH_LITLEN_SYMBOLS);
+
+    write_bits(writer, header, 2);
+    write_code_lengths(writer, encoder->lengths);
+    write_tokens(encoder, writer, token_count);
+    return;
+  }
+
+  write_bits(writer, header | LZH_BLOCK_STORED, 2);
+  flush_bits(writer);
+  write_bits(writer, (DWord)raw_size, 32);
+
+  if (raw_size > writer->capacity - writer->position)
+  {
+    writer->overflow = true;
+    return;
+  }
+
+  memcpy(writer->data + writer->position, input + start, raw_size);
+  writer->position += raw_size;
+}
+
+Size lzh_compress_bound(Size input_size)
+{
+  // Худший случай - все блоки хранятся как есть: байт заголовка с
+  // выравниванием и DWord длины на блок
+  Size blocks = input_size / LZH_BLOCK_SIZE + 1;
+  return input_size + blocks * (1 + sizeof(DWord)) + 1;
+}
+
+// Блок оптимального разбора: первый проход идет по оценочным ценам, каждый
+// следующий - по длинам кодов, построенным из результата предыдущего
+static Result parse_block_optimal(LZHEncoder* encoder, const Byte* input,
+                                  Size input_size, Size start, Size end,
+                                  Size* token_count)
+{
+  Result result = collect_matches(encoder, input, input_size, start, end);
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  for (Size pass = 0; pass < LZH_OPTIMAL_PASSES; pass++)
+  {
+    if (pass > 0)
+    {
+      build_block_lengths(encoder);
+    }
+    set_prices(encoder, pass > 0);
+    *token_count = optimal_parse(encoder, input, start, end);
+  }
+
+  return RESULT_OK;
+}
+
+Result lzh_compress_into(const Byte* input, Size input_size, Byte* output,
+                         Size output_capacity, Size* output_size, Byte level)
+{
+  return lzh_compress_into_with_dictionary(input, input_size, NULL, 0, output,
+                                           output_capacity, output_size,
+                                           level);
+}
+
+// Словарь и вход разбираются как одни данные: позиции словаря только
+// попадают в цепочки хеша, блоки начинаются с первого байта входа
+Result lzh_compress_into_with_dictionary(const Byte* input, Size input_size,
+                                         const Byte* dictionary,
+                                         Size dictionary_size, Byte* output,
+                                         Size output_capacity,
+                                         Size* output_size, Byte level)
+{
+  if (!input || !output || !output_size || input_size == 0 ||
+      (!dictionary && dictionary_size > 0) || level < LZH_LEVEL_MIN ||
+      level > LZH_LEVEL_MAX)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  // Дальше окна ссылки не достают
+  if (dictionary_size > LZH_WINDOW_SIZE)
+  {
+    dictionary += dictionary_size - LZH_WINDOW_SIZE;
+    dictionary_size = LZH_WINDOW_SIZE;
+  }
+
+  LOG_DEBUG("[LZH] Сжатие: %zu байт, уровень %u, словарь %zu байт\n",
+            input_size, level, dictionary_size);
+
+  LZHEncoder* encoder = (LZHEncoder*)malloc(sizeof(LZHEncoder));
+  if (encoder == NULL)
+  {
+    LOG_ERROR("[LZH] Ошибка выделения памяти для кодера\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Byte* primed = NULL;
+  if (dictionary_size > 0)
+  {
+    primed = (Byte*)malloc(dictionary_size + input_size);
+    if (primed == NULL)
+    {
+      LOG_ERROR("[LZH] Ошибка выделения памяти для словаря\n");
+      free(encoder);
+      return RESULT_MEMORY_ERROR;
+    }
+    memcpy(primed, dictionary, dictionary_size);
+    memcpy(primed + dictionary_size, input, input_size);
+    input = primed;
+    input_size += dictionary_size;
+  }
+
+  encoder->level = &lzh_levels[level];
+  encoder->matches = NULL;
+  encoder->match_capacity = 0;
+  memset(encoder->head, 0xFF, sizeof(encoder->head));
+  for (Byte code = 0; code < LZH_LENGTH_CODES; code++)
+  {
+    Size last = length_base[code] + ((Size)1 << length_extra[code]) - 1;
+    for (Size length = length_base[code];
+         length <= last && length <= LZH_MAX_MATCH; length++)
+    {
+      encoder->length_code[length] = code;
+    }
+  }
+
+  for (Size position = 0; position < dictionary_size; position++)
+  {
+    insert_position(encoder, input, input_size, position);
+  }
+
+  LZHBitWriter writer = {output, output_capacity, 0, 0, 0, false};
+  Result result = RESULT_OK;
+
+  for (Size start = dictionary_size; start < input_size &&
+                                     result == RESULT_OK;)
+  {
+    Size end = input_size - start > LZH_BLOCK_SIZE ? start + LZH_BLOCK_SIZE
+                                                   : input_size;
+    Size token_count = 0;
+
+    if (encoder->level->optimal)
+    {
+      result = parse_block_optimal(encoder, input, input_size, start, end,
+                                   &token_count);
+    }
+    else
+    {
+      memset(encoder->freq, 0, sizeof(encoder->freq));
+      encoder->freq[LZH_END_OF_BLOCK] = 1;
+      token_count = parse_block(encoder, input, input_size, start, end);
+    }
+
+    if (result == RESULT_OK)
+    {
+      write_block(encoder, &writer, input, start, end, token_count,
+                  end == input_size);
+    }
+    start = end;
+  }
+
+  flush_bits(&writer);
+  free(encoder->matches);
+  free(encoder);
+  free(primed);
+
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("[LZH] Ошибка выделения памяти для совпадений\n");
+    return result;
+  }
+
+  if (writer.overflow)
+  {
+    LOG_ERROR("[LZH] Ошибка: выходной буфер (%zu байт) переполнен\n",
+              output_capacity);
+    return RESULT_ERROR;
+  }
+
+  *output_size = writer.position;
+
+  LOG_DEBUG("[LZH] Сжатие завершено: %zu -> %zu байт\n",
+            input_size - dictionary_size, writer.position);
+
+  return RESULT_OK;
+}
+
+Result lzh_compress(const Byte* input, Size input_size, Byte** output,
+                    Size* output_size, Byte level)
+{
+  return lzh_compress_with_dictionary(input, input_size, NULL, 0, output,
+                                      output_size, level);
+}
+
+Result lzh_compress_with_dictionary(const Byte* input, Size input_size,
+                                    const Byte* dictionary,
+                                    Size dictionary_size, Byte** output,
+                                    Size* output_size, Byte level)
+{
+  if (!input || !output || !output_size || input_size == 0)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Size capacity = lzh_compress_bound(input_size);
+  Byte* compressed = (Byte*)malloc(capacity);
+  if (compressed == NULL)
+  {
+    LOG_ERROR("[LZH] Ошибка выделения памяти для сжатых данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Size compressed_size = 0;
+  Result result = lzh_compress_into_with_dictionary(
+    input, input_size, dictionary, dictionary_size, compressed, capacity,
+    &compressed_size, level);
+  if (result != RESULT_OK)
+  {
+    free(compressed);
+    return result;
+  }
+
+  Byte* trimmed = (Byte*)realloc(compressed, compressed_size);
+  if (trimmed)
+  {
+    compressed = trimmed;
+  }
+
+  *output = compressed;
+  *output_size = compressed_size;
+  return RESULT_OK;
+}
+
+static Result read_stored_block(LZHBitReader* reader, Byte* output,
+                                Size capacity, Size* out_pos)
+{
+  read_bits(reader, reader->count & 7);
+  Size length = read_bits(reader, 32);
+
+  // Байты, уже загруженные в буфер, возвращаются во вход
+  Size position = reader->position - reader->count / 8;
+  reader->buffer = 0;
+  reader->count = 0;
+
+  if (position > reader->size || length > reader->size - position ||
+      length > capacity - *out_pos)
+  {
+    LOG_ERROR("[LZH] Ошибка: несжатый блок выходит за пределы данных\n");
+    return RESULT_ERROR;
+  }
+
+  memcpy(output + *out_pos, reader->data + position, length);
+  *out_pos += length;
+  reader->position = position + length;
+  return RESULT_OK;
+}
+
+static Result read_huffman_block(LZHBitReader* reader, Word* litlen_table,
+                                 Word* distance_table, const Byte* dictionary,
+                                 Size dictionary_size, Byte* output,
+                                 Size capacity, Size* out_pos)
+{
+  Byte lengths[LZH_CODE_LENGTHS];
+
+  for (Size i = 0; i < LZH_CODE_LENGTHS;)
+  {
+    refill_bits(reader);
+    Byte bits = (Byte)read_bits(reader, 4);
+    if (bits != 0)
+    {
+      if (bits > LZH_MAX_CODE_BITS)
+      {
+        LOG_ERROR("[LZH] Ошибка: недопустимая длина кода %u\n", bits);
+        return RESULT_ERROR;
+      }
+      lengths[i++] = bits;
+      continue;
+    }
+
+    Size run = read_bits(reader, 4) + 1;
+    if (run > LZH_CODE_LENGTHS - i)
+    {
+      LOG_ERROR("[LZH] Ошибка: серия нулевых длин за концом алфавита\n");
+      return RESULT_ERROR;
+    }
+    memset(lengths + i, 0, run);
+    i += run;
+  }
+
+  if (lengths[LZH_END_OF_BLOCK] == 0 ||
+      build_decode_table(lengths, LZH_LITLEN_SYMBOLS, litlen_table) !=
+        RESULT_OK ||
+      build_decode_table(lengths + LZH_LITLEN_SYMBOLS, LZH_DISTANCE_SYMBOLS,
+                         distance_table) != RESULT_OK)
+  {
+    LOG_ERROR("[LZH] Ошибка: некорректные длины кодов блока\n");
+    return RESULT_ERROR;
+  }
+
+  Size position = *out_pos;
+
+  for (;;)
+  {
+    // После пополнения в буфере не меньше 57 бит, а токен занимает не
+    // больше 2 * LZH_MAX_CODE_BITS + 5 + 13
+    refill_bits(reader);
+
+    Word entry = litlen_table[reader->buffer & (LZH_TABLE_SIZE - 1)];
+    if (entry == 0)
+    {
+      LOG_ERROR("[LZH] Ошибка: недопустимый код литерала/длины\n");
+      return RESULT_ERROR;
+    }
+    read_bits(reader, entry & 0x0F);
+
+    Size symbol = entry >> 4;
+    if (symbol < LZH_END_OF_BLOCK)
+    {
+      if (position >= capacity)
+      {
+        LOG_ERROR("[LZH] Ошибка: литерал за пределами буфера\n");
+        return RESULT_ERROR;
+      }
+      output[position++] = (Byte)symbol;
+      continue;
+    }
+
+    if (symbol == LZH_END_OF_BLOCK)
+    {
+      break;
+    }
+
+    Size code = symbol - LZH_END_OF_BLOCK - 1;
+    if (code >= LZH_LENGTH_CODES)
+    {
+      LOG_ERROR("[LZH] Ошибка: недопустимый код длины\n");
+      return RESULT_ERROR;
+    }
+    Size length = length_base[code] + read_bits(reader, length_extra[code]);
+
+    entry = distance_table[reader->buffer & (LZH_TABLE_SIZE - 1)];
+    if (entry == 0)
+    {
+      LOG_ERROR("[LZH] Ошибка: недопустимый код смещения\n");
+      return RESULT_ERROR;
+    }
+    read_bits(reader, entry & 0x0F);
+
+    code = entry >> 4;
+    Size distance =
+      distance_base[code] + read_bits(reader, distance_extra[code]);
+
+    if (distance > position + dictionary_size ||
+        length > capacity - position)
+    {
+      LOG_ERROR("[LZH] Ошибка: некорректная ссылка S=%zu, L=%zu\n",
+                distance, length);
+      return RESULT_ERROR;
+    }
+
+    // Ссылка, начинающаяся в словаре, продолжается с начала выхода
+    Byte* target = output + position;
+    if (distance > position)
+    {
+      for (Size i = 0; i < length; i++)
+      {
+        Size back = position + i;
+        target[i] = back >= distance
+                      ? output[back - distance]
+                      : dictionary[dictionary_size - (distance - back)];
+      }
+      position += length;
+      continue;
+    }
+
+    // При перекрытии (L > S) копирование только побайтовое
+    const Byte* source = target - distance;
+    if (distance >= length)
+    {
+      memcpy(target, source, length);
+    }
+    else
+    {
+      for (Size i = 0; i < length; i++)
+      {
+        target[i] = source[i];
+      }
+    }
+    position += length;
+  }
+
+  *out_pos = position;
+  return RESULT_OK;
+}
+
+Result lzh_decompress_into(const Byte* input, Size input_size, Byte* output,
+                           Size* output_size)
+{
+  return lzh_decompress_into_with_dictionary(input, input_size, NULL, 0,
+                                             output, output_size);
+}
+
+Result lzh_decompress_into_with_dictionary(const Byte* input, Size input_size,
+                                           const Byte* dictionary,
+                                           Size dictionary_size, Byte* output,
+                                           Size* output_size)
+{
+  if (!input || !output || !output_size || input_size == 0 ||
+      (!dictionary && dictionary_size > 0))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (dictionary_size > LZH_WINDOW_SIZE)
+  {
+    dictionary += dictionary_size - LZH_WINDOW_SIZE;
+    dictionary_size = LZH_WINDOW_SIZE;
+  }
+
+  LOG_DEBUG("[LZH] Декомпрессия: вход=%zu, ожидаемый выход=%zu\n",
+            input_size, *output_size);
+
+  Word litlen_table[LZH_TABLE_SIZE];
+  Word distance_table[LZH_TABLE_SIZE];
+  LZHBitReader reader = {input, input_size, 0, 0, 0};
+  Size capacity = *output_size;
+  Size out_pos = 0;
+  Result result = RESULT_OK;
+  bool final = false;
+
+  while (result == RESULT_OK && !final)
+  {
+    refill_bits(&reader);
+    DWord header = read_bits(&reader, 2);
+    final = (header & LZH_BLOCK_FINAL) != 0;
+
+    if (header & LZH_BLOCK_STORED)
+    {
+      result = read_stored_block(&reader, output, capacity, &out_pos);
+    }
+    else
+    {
+      result = read_huffman_block(&reader, litlen_table, distance_table,
+                                  dictionary, dictionary_size, output,
+                                  capacity, &out_pos);
+    }
+
+    if (result == RESULT_OK && reader_overrun(&reader))
+    {
+      LOG_ERROR("[LZH] Ошибка: неожиданный конец сжатых данных\n");
+      result = RESULT_ERROR;
+    }
+  }
+
+  if (result != RESULT_OK)
+  {
+    return result;
+  }
+
+  if (out_pos != capacity)
+  {
+    LOG_WARN("[LZH] ВНИМАНИЕ: размер не совпадает! Ожидалось %zu, получено "
+             "%zu\n", capacity, out_pos);
+  }
+
+  *output_size = out_pos;
+
+  LOG_DEBUG("[LZH] Декомпрессия завершена: %zu байт\n", out_pos);
+
+  return RESULT_OK;
+}
+
+Result lzh_decompress(const Byte* input, Size input_size, Byte** output,
+                      Size* output_size)
+{
+  if (!input || !output || !output_size || input_size == 0)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  Byte* decompressed = (Byte*)malloc(*output_size > 0 ? *output_size : 1);
+  if (decompressed == NULL)
+  {
+    LOG_ERROR("[LZH] Ошибка выделения памяти для распакованных данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result =
+    lzh_decompress_into(input, input_size, decompressed, output_size);
+  if (result != RESULT_OK)
+  {
+    free(decompressed);
+    return result;
+  }
+
+  *output = decompressed;
+  return RESULT_OK;
+}
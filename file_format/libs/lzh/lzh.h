@@ -0,0 +1,63 @@
+#ifndef LZH_LZH_H
+#define LZH_LZH_H
+
+#include "types.h"
+
+// LZ77 с энтропийным кодированием токенов в духе Deflate: литералы и длины
+// совпадений кодируются одним каноническим кодом Хаффмана, смещения -
+// другим. Коды строятся заново для каждого блока и хранятся в его
+// заголовке, поэтому глобальная модель в архиве не нужна
+#define LZH_WINDOW_SIZE 32768  // Окно поиска, смещения до 32767
+#define LZH_MIN_MATCH 3        // Минимальная длина совпадения
+#define LZH_MAX_MATCH 258      // Максимальная длина совпадения
+#define LZH_BLOCK_SIZE (128 * 1024)  // Исходных байт на один набор кодов
+#define LZH_MAX_CODE_BITS 12         // Ограничение длины кода (таблица 4 КБ)
+
+#define LZH_END_OF_BLOCK 256  // Символ конца блока в алфавите литералов
+#define LZH_LITLEN_SYMBOLS 286  // 256 литералов, конец блока, 29 кодов длины
+#define LZH_DISTANCE_SYMBOLS 30  // Коды смещений с дополнительными битами
+
+// Формат блока (биты от младшего к старшему): признак последнего блока,
+// признак хранения без сжатия. Несжатый блок выравнивается на байт и
+// содержит DWord длины и сами данные; сжатый - длины кодов обоих алфавитов
+// (4 бита, 0 и 4 бита серии для нулей), токены и LZH_END_OF_BLOCK
+#define LZH_BLOCK_FINAL 0x01
+#define LZH_BLOCK_STORED 0x02
+
+// Уровни сжатия: длина цепочек поиска и ленивое сопоставление растут с
+// уровнем, LZH_LEVEL_MAX включает оптимальный разбор по цене токенов в
+// битах. Формат данных от уровня не зависит
+#define LZH_LEVEL_MIN 1
+#define LZH_LEVEL_DEFAULT 6
+#define LZH_LEVEL_MAX 9
+
+Result lzh_compress(const Byte* input, Size input_size, Byte** output,
+                    Size* output_size, Byte level);
+Result lzh_decompress(const Byte* input, Size input_size, Byte** output,
+                      Size* output_size);
+
+// Варианты с буфером вызывающего кода, семантика как у lz77_*_into
+Size lzh_compress_bound(Size input_size);
+Result lzh_compress_into(const Byte* input, Size input_size, Byte* output,
+                         Size output_capacity, Size* output_size, Byte level);
+Result lzh_decompress_into(const Byte* input, Size input_size, Byte* output,
+                           Size* output_size);
+
+// Варианты с затравкой окна: dictionary считается данными, предшествующими
+// входу, и при распаковке должен совпадать байт в байт. Используются
+// последние LZH_WINDOW_SIZE байт словаря
+Result lzh_compress_with_dictionary(const Byte* input, Size input_size,
+                                    const Byte* dictionary,
+                                    Size dictionary_size, Byte** output,
+                                    Size* output_size, Byte level);
+Result lzh_compress_into_with_dictionary(const Byte* input, Size input_size,
+                                         const Byte* dictionary,
+                                         Size dictionary_size, Byte* output,
+                                         Size output_capacity,
+                                         Size* output_size, Byte level);
+Result lzh_decompress_into_with_dictionary(const Byte* input, Size input_size,
+                                           const Byte* dictionary,
+                                           Size dictionary_size, Byte* output,
+                                           Size* output_size);
+
+#endif  // LZH_LZH_H
@@ -2,10 +2,10 @@
 
 #include <inttypes.h>
 #include <math.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
 #include "types.h"
 
 struct MarkovModel
@@ -87,7 +87,7 @@ Result markov_model_process_data(MarkovModel* self, const Byte* data,
         const int amount = 10;
         if (data_size < amount)
         {  // выводим только для маленьких тестов
-          printf(
+          LOG_TRACE(
             "  Пара %c%c: count=%" PRIu64 ", p=%.3f, I=%.2f, сумма=%.2f\n",
             (first >= ascii_beginning && first < ascii_end) ? first : '.',
             (second >= ascii_beginning && second < ascii_end) ? second : '.',
@@ -182,12 +182,12 @@ bool markov_model_validate_test_cases(void)
 
   for (int i = 0; i < num_cases; i++)
   {
-    printf("\nТест %d: %s ('%s')\n", i + 1, descriptions[i], test_cases[i]);
+    LOG_DEBUG("\nТест %d: %s ('%s')\n", i + 1, descriptions[i], test_cases[i]);
 
     MarkovModel* model = markov_model_create();
     if (!model)
     {
-      printf("  ОШИБКА: Не удалось создать модель!\n");
+      LOG_ERROR("  ОШИБКА: Не удалось создать модель!\n");
       all_passed = false;
       continue;
     }
@@ -197,7 +197,7 @@ bool markov_model_validate_test_cases(void)
       markov_model_process_data(model, (const Byte*)test_cases[i], data_size);
     if (result != RESULT_OK)
     {
-      printf("  ОШИБКА: Не удалось обработать данные!\n");
+      LOG_ERROR("  ОШИБКА: Не удалось обработать данные!\n");
       markov_model_destroy(model);
       all_passed = false;
       continue;
@@ -207,20 +207,21 @@ bool markov_model_validate_test_cases(void)
     const double tolerance = 0.1;
 
     // Детальная информация о тесте
-    printf("  Ожидалось: %.1f бит\n", expected_bits[i]);
-    printf("  Получено:  %.1f бит\n", actual_bits);
-    printf("  Размер данных: %zu символов\n", data_size);
-    printf("  Всего пар: %" PRIu64 "\n", markov_model_get_total_pairs(model));
+    LOG_DEBUG("  Ожидалось: %.1f бит\n", expected_bits[i]);
+    LOG_DEBUG("  Получено:  %.1f бит\n", actual_bits);
+    LOG_DEBUG("  Размер данных: %zu символов\n", data_size);
+    LOG_DEBUG("  Всего пар: %" PRIu64 "\n",
+              markov_model_get_total_pairs(model));
 
     if (data_size > 0)
     {
-      printf("  Первый символ: '%c' (0x%02X)\n", test_cases[i][0],
-             test_cases[i][0]);
+      LOG_DEBUG("  Первый символ: '%c' (0x%02X)\n", test_cases[i][0],
+                test_cases[i][0]);
     }
 
     if (data_size > 1)
     {
-      printf("  Пары в данных:\n");
+      LOG_DEBUG("  Пары в данных:\n");
       for (Size j = 0; j < data_size - 1; j++)
       {
         Byte first = test_cases[i][j];
@@ -231,36 +232,37 @@ bool markov_model_validate_test_cases(void)
         double info = markov_model_get_information(model, first, second);
         const int ascii_beginning = 32;
         const int ascii_end = 127;
-        printf("    '%c%c': count=%" PRIu64 ", p=%.3f, I=%.2f бит\n",
-               (first >= ascii_beginning && first < ascii_end) ? first : '.',
-               (second >= ascii_beginning && second < ascii_end) ? second : '.',
-               count, prob, info);
+        LOG_TRACE(
+          "    '%c%c': count=%" PRIu64 ", p=%.3f, I=%.2f бит\n",
+          (first >= ascii_beginning && first < ascii_end) ? first : '.',
+          (second >= ascii_beginning && second < ascii_end) ? second : '.',
+          count, prob, info);
       }
     }
 
     if (fabs(actual_bits - expected_bits[i]) <= tolerance)
     {
-      printf("  ✅ ТЕСТ ПРОЙДЕН\n");
+      LOG_DEBUG("  ✅ ТЕСТ ПРОЙДЕН\n");
     }
     else
     {
-      printf("  ❌ ТЕСТ ПРОВАЛЕН (разница: %.2f)\n",
-             fabs(actual_bits - expected_bits[i]));
+      LOG_DEBUG("  ❌ ТЕСТ ПРОВАЛЕН (разница: %.2f)\n",
+                fabs(actual_bits - expected_bits[i]));
       all_passed = false;
     }
 
     markov_model_destroy(model);
-    printf("  ---\n");
+    LOG_DEBUG("  ---\n");
   }
 
-  printf("\nРезультат валидации:\n");
+  LOG_DEBUG("\nРезультат валидации:\n");
   if (all_passed)
   {
-    printf("✅ Все тестовые сценарии пройдены!\n");
+    LOG_DEBUG("✅ Все тестовые сценарии пройдены!\n");
   }
   else
   {
-    printf("❌ Есть провалившиеся тестовые сценарии!\n");
+    LOG_DEBUG("❌ Есть провалившиеся тестовые сценарии!\n");
   }
 
   return all_passed;
@@ -6,6 +6,9 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include "arena.h"
+#include "log.h"
+
 #define PATH_LENGTH_LIMIT 4096
 
 bool path_utils_is_directory(const char* path)
@@ -29,7 +32,7 @@ Result path_utils_create_directory(const char* path)
   const int chown = 0755;
   if (mkdir(path, chown) != 0)
   {
-    printf("Произошла ошибка при создании папки!\n");
+    LOG_ERROR("Произошла ошибка при создании папки!\n");
     return RESULT_IO_ERROR;
   }
 
@@ -51,7 +54,7 @@ Result path_utils_create_directory_recursive(const char* path)
   char* path_copy = (char*)malloc(strlen(path) + 1);
   if (path_copy == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return RESULT_MEMORY_ERROR;
   }
   strcpy(path_copy, path);
@@ -101,7 +104,7 @@ char* path_utils_join(const char* dir, const char* file)
   char* full_path = (char*)malloc(sizeof(char) * PATH_LENGTH_LIMIT);
   if (full_path == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
@@ -110,7 +113,7 @@ char* path_utils_join(const char* dir, const char* file)
 
   if (bytes_written != strlen(dir) + strlen(file) + 1)
   {
-    printf("Произошла ошибка при склеивании пути!");
+    LOG_ERROR("Произошла ошибка при склеивании пути!\n");
     return NULL;
   }
 
@@ -122,7 +125,7 @@ char* path_utils_get_parent(const char* path)
   char* last_slash = strrchr(path, '/');
   if (last_slash == NULL)
   {
-    printf("Родительская директория не обнаружена!\n");
+    LOG_DEBUG("Родительская директория не обнаружена!\n");
     return NULL;
   }
 
@@ -130,7 +133,7 @@ char* path_utils_get_parent(const char* path)
   char* parent = (char*)malloc(parent_len + 1);
   if (parent == NULL)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
@@ -139,6 +142,52 @@ char* path_utils_get_parent(const char* path)
   return parent;
 }
 
+char* path_utils_arena_join(Arena* arena, const char* dir, const char* file)
+{
+  Size dir_length = strlen(dir);
+  Size file_length = strlen(file);
+  Size total_length = dir_length + 1 + file_length;
+  if (total_length >= PATH_LENGTH_LIMIT)
+  {
+    LOG_ERROR("Произошла ошибка при склеивании пути!\n");
+    return NULL;
+  }
+
+  char* full_path = (char*)arena_alloc(arena, total_length + 1);
+  if (full_path == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  memcpy(full_path, dir, dir_length);
+  full_path[dir_length] = '/';
+  memcpy(full_path + dir_length + 1, file, file_length + 1);
+  return full_path;
+}
+
+char* path_utils_arena_get_parent(Arena* arena, const char* path)
+{
+  const char* last_slash = strrchr(path, '/');
+  if (last_slash == NULL)
+  {
+    LOG_DEBUG("Родительская директория не обнаружена!\n");
+    return NULL;
+  }
+
+  Size parent_len = last_slash - path;
+  char* parent = (char*)arena_alloc(arena, parent_len + 1);
+  if (parent == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  memcpy(parent, path, parent_len);
+  parent[parent_len] = '\0';
+  return parent;
+}
+
 const char* path_utils_get_filename(const char* path)
 {
   const char* last_slash = strrchr(path, '/');
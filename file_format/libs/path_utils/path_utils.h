@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 
+#include "arena.h"
 #include "types.h"
 
 bool path_utils_is_directory(const char* path);
@@ -11,6 +12,10 @@ Result path_utils_create_directory(const char* path);
 Result path_utils_create_directory_recursive(const char* path);
 char* path_utils_join(const char* dir, const char* file);
 char* path_utils_get_parent(const char* path);
+// Варианты с памятью из арены: строка точного размера, освобождается вместе
+// с ареной или откатом к отметке
+char* path_utils_arena_join(Arena* arena, const char* dir, const char* file);
+char* path_utils_arena_get_parent(Arena* arena, const char* path);
 const char* path_utils_get_filename(const char* path);
 QWord path_utils_get_file_size(const char* path);
 const char* path_utils_get_relative_path(const char* full_path,
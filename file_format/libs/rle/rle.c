@@ -1,15 +1,211 @@
 #include "rle.h"
 
-#include <stdio.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
 #include "types.h"
 
 #define MIN_REPEAT 4           // Минимальная длина для сжатия обычных символов
 #define MIN_PREFIX_REPEAT 2    // Минимальная длина для сжатия префикса
 #define MAX_REPEAT_LENGTH 255  // Максимальная длина, помещающаяся в 1 байт
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RLE_HAS_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define RLE_HAS_X86_SIMD 0
+#endif
+
+// Сканер серии: количество начальных байт data[0..size), равных value
+typedef Size (*RLERunScanner)(const Byte* data, Size size, Byte value);
+// Сканер литералов: позиция первого байта, с которого начинается серия
+// длиной не менее MIN_REPEAT или который совпадает с префиксом
+typedef Size (*RLELiteralScanner)(const Byte* data, Size size, Byte prefix);
+
+static Size rle_scan_run_scalar(const Byte* data, Size size, Byte value)
+{
+  Size length = 0;
+  while (length < size && data[length] == value)
+  {
+    length++;
+  }
+  return length;
+}
+
+static bool rle_is_literal_stop(const Byte* data, Size position, Size size,
+                                Byte prefix)
+{
+  if (data[position] == prefix)
+  {
+    return true;
+  }
+
+  return position + MIN_REPEAT <= size &&
+         data[position] == data[position + 1] &&
+         data[position + 1] == data[position + 2] &&
+         data[position + 2] == data[position + 3];
+}
+
+static Size rle_scan_literals_scalar(const Byte* data, Size size, Byte prefix)
+{
+  Size position = 0;
+  while (position < size && !rle_is_literal_stop(data, position, size, prefix))
+  {
+    position++;
+  }
+  return position;
+}
+
+#if RLE_HAS_X86_SIMD
+
+// Векторные сканеры литералов сравнивают ровно четыре смещенные загрузки
+_Static_assert(MIN_REPEAT == 4,
+               "векторные сканеры литералов рассчитаны на MIN_REPEAT == 4");
+
+__attribute__((target("sse2"))) static Size rle_scan_run_sse2(const Byte* data,
+                                                              Size size,
+                                                              Byte value)
+{
+  const __m128i pattern = _mm_set1_epi8((char)value);
+  Size length = 0;
+
+  while (length + 16 <= size)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + length));
+    unsigned mask =
+      (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)) ^ 0xFFFFU;
+    if (mask != 0)
+    {
+      return length + (Size)__builtin_ctz(mask);
+    }
+    length += 16;
+  }
+
+  return length + rle_scan_run_scalar(data + length, size - length, value);
+}
+
+__attribute__((target("sse2"))) static Size rle_scan_literals_sse2(
+  const Byte* data, Size size, Byte prefix)
+{
+  const __m128i pattern = _mm_set1_epi8((char)prefix);
+  Size position = 0;
+
+  // Четыре смещенные загрузки: серия начинается там, где совпадают
+  // data[i], data[i+1], data[i+2] и data[i+3]
+  while (position + 16 + MIN_REPEAT - 1 <= size)
+  {
+    const Byte* base = data + position;
+    __m128i v0 = _mm_loadu_si128((const __m128i*)base);
+    __m128i v1 = _mm_loadu_si128((const __m128i*)(base + 1));
+    __m128i v2 = _mm_loadu_si128((const __m128i*)(base + 2));
+    __m128i v3 = _mm_loadu_si128((const __m128i*)(base + 3));
+
+    __m128i run = _mm_and_si128(
+      _mm_and_si128(_mm_cmpeq_epi8(v0, v1), _mm_cmpeq_epi8(v1, v2)),
+      _mm_cmpeq_epi8(v2, v3));
+    __m128i stop = _mm_or_si128(run, _mm_cmpeq_epi8(v0, pattern));
+
+    unsigned mask = (unsigned)_mm_movemask_epi8(stop);
+    if (mask != 0)
+    {
+      return position + (Size)__builtin_ctz(mask);
+    }
+    position += 16;
+  }
+
+  return position + rle_scan_literals_scalar(data + position, size - position,
+                                             prefix);
+}
+
+__attribute__((target("avx2"))) static Size rle_scan_run_avx2(const Byte* data,
+                                                              Size size,
+                                                              Byte value)
+{
+  const __m256i pattern = _mm256_set1_epi8((char)value);
+  Size length = 0;
+
+  while (length + 32 <= size)
+  {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(data + length));
+    unsigned mask = ~(unsigned)_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(block, pattern));
+    if (mask != 0)
+    {
+      return length + (Size)__builtin_ctz(mask);
+    }
+    length += 32;
+  }
+
+  return length + rle_scan_run_scalar(data + length, size - length, value);
+}
+
+__attribute__((target("avx2"))) static Size rle_scan_literals_avx2(
+  const Byte* data, Size size, Byte prefix)
+{
+  const __m256i pattern = _mm256_set1_epi8((char)prefix);
+  Size position = 0;
+
+  while (position + 32 + MIN_REPEAT - 1 <= size)
+  {
+    const Byte* base = data + position;
+    __m256i v0 = _mm256_loadu_si256((const __m256i*)base);
+    __m256i v1 = _mm256_loadu_si256((const __m256i*)(base + 1));
+    __m256i v2 = _mm256_loadu_si256((const __m256i*)(base + 2));
+    __m256i v3 = _mm256_loadu_si256((const __m256i*)(base + 3));
+
+    __m256i run = _mm256_and_si256(
+      _mm256_and_si256(_mm256_cmpeq_epi8(v0, v1), _mm256_cmpeq_epi8(v1, v2)),
+      _mm256_cmpeq_epi8(v2, v3));
+    __m256i stop = _mm256_or_si256(run, _mm256_cmpeq_epi8(v0, pattern));
+
+    unsigned mask = (unsigned)_mm256_movemask_epi8(stop);
+    if (mask != 0)
+    {
+      return position + (Size)__builtin_ctz(mask);
+    }
+    position += 32;
+  }
+
+  return position + rle_scan_literals_scalar(data + position, size - position,
+                                             prefix);
+}
+
+#endif  // RLE_HAS_X86_SIMD
+
+static RLERunScanner rle_scan_run = rle_scan_run_scalar;
+static RLELiteralScanner rle_scan_literals = rle_scan_literals_scalar;
+static const char* rle_scanner_name = "SCALAR";
+static pthread_once_t rle_scanners_once = PTHREAD_ONCE_INIT;
+
+// Выбор реализации сканеров под возможности процессора
+static void rle_detect_scanners(void)
+{
+#if RLE_HAS_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    rle_scan_run = rle_scan_run_avx2;
+    rle_scan_literals = rle_scan_literals_avx2;
+    rle_scanner_name = "AVX2";
+  }
+  else if (__builtin_cpu_supports("sse2"))
+  {
+    rle_scan_run = rle_scan_run_sse2;
+    rle_scan_literals = rle_scan_literals_sse2;
+    rle_scanner_name = "SSE2";
+  }
+#endif
+}
+
+// Выбор выполняется один раз; pthread_once упорядочивает запись указателей
+// с их чтением в потоках, сжимающих одновременно
+static void rle_select_scanners(void)
+{
+  pthread_once(&rle_scanners_once, rle_detect_scanners);
+}
+
 RLEContext* rle_create(Byte prefix)
 {
   RLEContext* context = (RLEContext*)malloc(sizeof(RLEContext));
@@ -19,6 +215,7 @@ RLEContext* rle_create(Byte prefix)
   }
 
   context->prefix = prefix;
+  context->format = RLE_FORMAT_CLASSIC;
   return context;
 }
 
@@ -30,421 +227,615 @@ void rle_destroy(RLEContext* context)
   }
 }
 
-Result rle_compress(const Byte* input, Size input_size, Byte** output,
-                    Size* output_size, const RLEContext* context)
+// Формат RLE_FORMAT_VARINT: поток управляющих varint (LEB128).
+// Младший бит управляющего числа - тип блока, остальные биты - длина:
+//   (n << 1) | 0, затем n байт как есть    - литеральный участок
+//   (n << 1) | 1, затем один байт символа - серия из n символов
+// Длины не ограничены 255, поэтому длинные нулевые области разреженных
+// файлов кодируются несколькими байтами, а литералы копируются целиком.
+#define RLE_VARINT_MAX_BYTES 10
+
+static Size rle_write_varint(Byte* output, QWord value)
 {
-  if (!input || !output || !output_size || !context || input_size == 0)
+  Size written = 0;
+  while (value >= 0x80)
   {
-    printf("[RLE] Ошибка: неверные параметры в rle_compress\n");
-    return RESULT_INVALID_ARGUMENT;
+    output[written++] = (Byte)(value | 0x80);
+    value >>= 7;
   }
+  output[written++] = (Byte)value;
+  return written;
+}
 
-  printf("[RLE] Начало RLE сжатия с префиксом 0x%02X\n", context->prefix);
-  printf("[RLE] Размер входных данных: %zu байт\n", input_size);
+// Возвращает количество прочитанных байт или 0 при повреждённом varint
+static Size rle_read_varint(const Byte* input, Size input_size, QWord* value)
+{
+  QWord result = 0;
+  for (Size i = 0; i < input_size && i < RLE_VARINT_MAX_BYTES; i++)
+  {
+    result |= (QWord)(input[i] & 0x7F) << (7 * i);
+    if ((input[i] & 0x80) == 0)
+    {
+      *value = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
 
-  // Выделяем буфер размером до 2*input_size (худший случай - без сжатия)
-  Byte* compressed = (Byte*)malloc(input_size * 2);
-  if (!compressed)
+// Длина литерального участка для varint-формата: останавливаемся только на
+// сериях, префикс здесь обычный байт
+static Size rle_scan_varint_literals(const Byte* data, Size size, Byte prefix)
+{
+  Size position = 0;
+  while (position < size)
   {
-    printf("[RLE] Ошибка выделения памяти для сжатых данных\n");
-    return RESULT_MEMORY_ERROR;
+    position +=
+      rle_scan_literals(data + position, size - position, prefix);
+    if (position >= size)
+    {
+      break;
+    }
+
+    Size remaining = size - position;
+    Size probe = remaining < MIN_REPEAT ? remaining : MIN_REPEAT;
+    if (rle_scan_run(data + position, probe, data[position]) >= MIN_REPEAT)
+    {
+      break;
+    }
+    position++;
   }
+  return position;
+}
 
+static Result rle_compress_varint_into(const Byte* input, Size input_size,
+                                       Byte* output, Size output_capacity,
+                                       Size* output_size,
+                                       const RLEContext* context)
+{
   Size out_pos = 0;
   Size in_pos = 0;
+  Size literal_blocks = 0;
+  Size run_blocks = 0;
 
   while (in_pos < input_size)
   {
-    Byte current = input[in_pos];
-
-    // Определяем длину последовательности одинаковых символов
-    Size repeat_length = 1;
-    while (in_pos + repeat_length < input_size &&
-           input[in_pos + repeat_length] == current &&
-           repeat_length <
-             (MAX_REPEAT_LENGTH +
-              (current == context->prefix ? MIN_PREFIX_REPEAT : MIN_REPEAT)))
+    Size literal_length = rle_scan_varint_literals(
+      input + in_pos, input_size - in_pos, context->prefix);
+    if (literal_length > 0)
     {
-      repeat_length++;
+      if (output_capacity - out_pos < RLE_VARINT_MAX_BYTES + literal_length)
+      {
+        break;
+      }
+
+      out_pos += rle_write_varint(output + out_pos, (QWord)literal_length << 1);
+      memcpy(output + out_pos, input + in_pos, literal_length);
+      out_pos += literal_length;
+      in_pos += literal_length;
+      literal_blocks++;
+      continue;
     }
 
-    if (current == context->prefix)
+    if (output_capacity - out_pos < RLE_VARINT_MAX_BYTES + 1)
     {
-      // Символ - префикс
-      if (repeat_length >= MIN_PREFIX_REPEAT)
-      {
-        // Сжимаем последовательность префиксов
-        if (repeat_length > MAX_REPEAT_LENGTH + 1)
-        {
-          repeat_length = MAX_REPEAT_LENGTH + 1;
-        }
+      break;
+    }
 
-        Byte length = (Byte)(repeat_length - 1);
+    Byte current = input[in_pos];
+    Size repeat_length =
+      rle_scan_run(input + in_pos, input_size - in_pos, current);
+
+    out_pos +=
+      rle_write_varint(output + out_pos, ((QWord)repeat_length << 1) | 1);
+    output[out_pos++] = current;
+    in_pos += repeat_length;
+    run_blocks++;
+  }
 
-        if (out_pos + 3 > input_size * 2)
-        {
-          Byte* new_compressed = realloc(compressed, input_size * 2 + 256);
-          if (!new_compressed)
-          {
-            free(compressed);
-            return RESULT_MEMORY_ERROR;
-          }
-          compressed = new_compressed;
-        }
+  if (in_pos < input_size)
+  {
+    LOG_ERROR("[RLE] Ошибка: выходной буфер (%zu байт) переполнен\n",
+              output_capacity);
+    return RESULT_ERROR;
+  }
 
-        compressed[out_pos++] = context->prefix;
-        compressed[out_pos++] = length;
-        compressed[out_pos++] = context->prefix;
+  *output_size = out_pos;
 
-        in_pos += repeat_length;
+  LOG_DEBUG("[RLE] Сжатие (varint) завершено: %zu литеральных участков, %zu "
+            "серий\n", literal_blocks, run_blocks);
 
-        printf("[RLE] Сжато %zu символов префикса (0x%02X) в 3 байта\n",
-               repeat_length, context->prefix);
-      }
-      else if (repeat_length == 1)
-      {
-        // Одиночный префикс
-        if (out_pos + 2 > input_size * 2)
-        {
-          Byte* new_compressed = realloc(compressed, input_size * 2 + 256);
-          if (!new_compressed)
-          {
-            free(compressed);
-            return RESULT_MEMORY_ERROR;
-          }
-          compressed = new_compressed;
-        }
+  return RESULT_OK;
+}
 
-        compressed[out_pos++] = context->prefix;
-        compressed[out_pos++] = 0;
+// Размер распакованных varint-данных; заодно проверяет целостность потока
+static Result rle_measure_varint(const Byte* input, Size input_size,
+                                 Size* decompressed_size)
+{
+  Size estimated_size = 0;
+  Size in_pos = 0;
 
-        in_pos++;
+  while (in_pos < input_size)
+  {
+    QWord control = 0;
+    Size read = rle_read_varint(input + in_pos, input_size - in_pos, &control);
+    if (read == 0)
+    {
+      LOG_ERROR("[RLE] Ошибка: повреждённое управляющее число в позиции %zu\n",
+                in_pos);
+      return RESULT_ERROR;
+    }
+    in_pos += read;
 
-        printf("[RLE] Одиночный префикс (0x%02X) закодирован как 2 байта\n",
-               context->prefix);
-      }
-      else
-      {
-        // 2 префикса подряд (длина 2) - тоже нужно закодировать
-        Byte length = (Byte)(repeat_length - 1);
+    Size length = (Size)(control >> 1);
+    Size payload = (control & 1) ? 1 : length;
+    if (payload > input_size - in_pos)
+    {
+      LOG_ERROR("[RLE] Ошибка: блок выходит за границы входных данных\n");
+      return RESULT_ERROR;
+    }
 
-        if (out_pos + 3 > input_size * 2)
-        {
-          Byte* new_compressed = realloc(compressed, input_size * 2 + 256);
-          if (!new_compressed)
-          {
-            free(compressed);
-            return RESULT_MEMORY_ERROR;
-          }
-          compressed = new_compressed;
-        }
+    if (length > (Size)-1 - estimated_size)
+    {
+      LOG_ERROR("[RLE] Ошибка: размер данных после декомпрессии слишком "
+                "велик\n");
+      return RESULT_ERROR;
+    }
+
+    in_pos += payload;
+    estimated_size += length;
+  }
 
-        compressed[out_pos++] = context->prefix;
-        compressed[out_pos++] = length;
-        compressed[out_pos++] = context->prefix;
+  *decompressed_size = estimated_size;
+  return RESULT_OK;
+}
 
-        in_pos += repeat_length;
-      }
+// Один проход: границы входа и выхода проверяются по ходу разбора, блоки
+// за пределами буфера обрезаются, а поток короче буфера - ошибка
+static Result rle_decompress_varint_into(const Byte* input, Size input_size,
+                                         Byte* output, Size* output_size)
+{
+  Size capacity = *output_size;
+  Size in_pos = 0;
+  Size out_pos = 0;
+
+  while (in_pos < input_size && out_pos < capacity)
+  {
+    QWord control = 0;
+    Size read = rle_read_varint(input + in_pos, input_size - in_pos, &control);
+    if (read == 0)
+    {
+      LOG_ERROR("[RLE] Ошибка: повреждённое управляющее число в позиции %zu\n",
+                in_pos);
+      return RESULT_ERROR;
+    }
+    in_pos += read;
+
+    Size length = (Size)(control >> 1);
+    Size payload = (control & 1) ? 1 : length;
+    if (payload > input_size - in_pos)
+    {
+      LOG_ERROR("[RLE] Ошибка: блок выходит за границы входных данных\n");
+      return RESULT_ERROR;
+    }
+
+    Size count = length < capacity - out_pos ? length : capacity - out_pos;
+    if (control & 1)
+    {
+      memset(output + out_pos, input[in_pos], count);
     }
     else
     {
-      // Обычный символ
-      if (repeat_length >= MIN_REPEAT)
+      memcpy(output + out_pos, input + in_pos, count);
+    }
+    in_pos += payload;
+    out_pos += count;
+  }
+
+  if (out_pos != capacity)
+  {
+    LOG_ERROR("[RLE] Ошибка: декомпрессировано %zu байт из %zu ожидаемых\n",
+              out_pos, capacity);
+    return RESULT_ERROR;
+  }
+
+  LOG_DEBUG("[RLE] Декомпрессия (varint) завершена\n");
+
+  *output_size = out_pos;
+  return RESULT_OK;
+}
+
+static Result rle_compress_classic_into(const Byte* input, Size input_size,
+                                        Byte* output, Size output_capacity,
+                                        Size* output_size,
+                                        const RLEContext* context)
+{
+  Size out_pos = 0;
+  Size in_pos = 0;
+
+  while (in_pos < input_size)
+  {
+    // Литеральный участок копируем целиком
+    Size literal_length = rle_scan_literals(
+      input + in_pos, input_size - in_pos, context->prefix);
+    if (literal_length > 0)
+    {
+      if (output_capacity - out_pos < literal_length)
       {
-        // Сжимаем последовательность обычных символов
-        if (repeat_length > MAX_REPEAT_LENGTH + 3)
-        {
-          repeat_length = MAX_REPEAT_LENGTH + 3;
-        }
+        break;
+      }
 
-        Byte length = (Byte)(repeat_length - 3);
+      memcpy(output + out_pos, input + in_pos, literal_length);
+      out_pos += literal_length;
+      in_pos += literal_length;
+      continue;
+    }
 
-        if (out_pos + 3 > input_size * 2)
-        {
-          Byte* new_compressed = realloc(compressed, input_size * 2 + 256);
-          if (!new_compressed)
-          {
-            free(compressed);
-            return RESULT_MEMORY_ERROR;
-          }
-          compressed = new_compressed;
-        }
+    // Любая управляющая последовательность занимает не более 3 байт
+    if (output_capacity - out_pos < 3)
+    {
+      break;
+    }
 
-        compressed[out_pos++] = context->prefix;
-        compressed[out_pos++] = length;
-        compressed[out_pos++] = current;
+    Byte current = input[in_pos];
 
-        in_pos += repeat_length;
+    // Определяем длину последовательности одинаковых символов
+    Size max_length =
+      MAX_REPEAT_LENGTH +
+      (current == context->prefix ? MIN_PREFIX_REPEAT : MIN_REPEAT);
+    Size remaining = input_size - in_pos;
+    Size repeat_length = rle_scan_run(
+      input + in_pos, remaining < max_length ? remaining : max_length, current);
 
-        printf("[RLE] Сжато %zu символов 0x%02X ('%c') в 3 байта\n",
-               repeat_length, current,
-               (current >= 32 && current <= 126) ? current : '.');
+    if (current == context->prefix)
+    {
+      if (repeat_length == 1)
+      {
+        // Одиночный префикс
+        output[out_pos++] = context->prefix;
+        output[out_pos++] = 0;
+        in_pos++;
+        continue;
       }
-      else
+
+      // Сжимаем последовательность префиксов
+      if (repeat_length > MAX_REPEAT_LENGTH + 1)
       {
-        // Недостаточно для сжатия - копируем как есть
-        for (Size i = 0; i < repeat_length; i++)
-        {
-          if (out_pos + 1 > input_size * 2)
-          {
-            Byte* new_compressed = realloc(compressed, input_size * 2 + 256);
-            if (!new_compressed)
-            {
-              free(compressed);
-              return RESULT_MEMORY_ERROR;
-            }
-            compressed = new_compressed;
-          }
-          compressed[out_pos++] = current;
-        }
-        in_pos += repeat_length;
+        repeat_length = MAX_REPEAT_LENGTH + 1;
+      }
+
+      output[out_pos++] = context->prefix;
+      output[out_pos++] = (Byte)(repeat_length - 1);
+      output[out_pos++] = context->prefix;
+      in_pos += repeat_length;
+    }
+    else
+    {
+      // Сканер литералов останавливается только на сериях от MIN_REPEAT
+      if (repeat_length > MAX_REPEAT_LENGTH + 3)
+      {
+        repeat_length = MAX_REPEAT_LENGTH + 3;
       }
+
+      output[out_pos++] = context->prefix;
+      output[out_pos++] = (Byte)(repeat_length - 3);
+      output[out_pos++] = current;
+      in_pos += repeat_length;
     }
   }
 
-  // Обрезаем буфер до фактического размера
-  Byte* trimmed = (Byte*)realloc(compressed, out_pos);
-  if (trimmed)
+  if (in_pos < input_size)
   {
-    compressed = trimmed;
+    LOG_ERROR("[RLE] Ошибка: выходной буфер (%zu байт) переполнен\n",
+              output_capacity);
+    return RESULT_ERROR;
   }
-  else if (out_pos > 0)
+
+  *output_size = out_pos;
+
+  LOG_DEBUG("[RLE] Сжатие завершено\n");
+
+  return RESULT_OK;
+}
+
+Size rle_compress_bound(Size input_size)
+{
+  // Классический формат: каждый байт в худшем случае становится двумя
+  // (одиночный префикс). Varint: литеральный участок длины n занимает не
+  // более 2n байт, запас - на управляющее число единственного блока
+  return input_size * 2 + RLE_VARINT_MAX_BYTES + 1;
+}
+
+Result rle_compress_into(const Byte* input, Size input_size, Byte* output,
+                         Size output_capacity, Size* output_size,
+                         const RLEContext* context)
+{
+  if (!input || !output || !output_size || !context || input_size == 0)
   {
-    // Если realloc не удался, но данные есть - продолжаем с исходным буфером
-    printf("[RLE] Предупреждение: не удалось обрезать буфер\n");
+    LOG_ERROR("[RLE] Ошибка: неверные параметры в rle_compress\n");
+    return RESULT_INVALID_ARGUMENT;
   }
 
-  *output = compressed;
-  *output_size = out_pos;
+  rle_select_scanners();
 
-  printf("[RLE] Сжатие завершено\n");
-  printf("[RLE] Исходный размер: %zu байт\n", input_size);
-  printf("[RLE] Сжатый размер: %zu байт\n", out_pos);
+  LOG_DEBUG("[RLE] Начало RLE сжатия с префиксом 0x%02X\n", context->prefix);
+  LOG_DEBUG("[RLE] Размер входных данных: %zu байт\n", input_size);
+  LOG_DEBUG("[RLE] Сканер серий: %s\n", rle_scanner_name);
 
-  if (input_size > 0)
+  Result result;
+  if (context->format == RLE_FORMAT_VARINT)
+  {
+    result = rle_compress_varint_into(input, input_size, output,
+                                      output_capacity, output_size, context);
+  }
+  else
   {
-    double ratio = (1.0 - (double)out_pos / (double)input_size) * 100;
-    printf("[RLE] Коэффициент сжатия: %.2f%%\n", ratio);
+    result = rle_compress_classic_into(input, input_size, output,
+                                       output_capacity, output_size, context);
   }
 
-  return RESULT_OK;
+  if (result == RESULT_OK)
+  {
+    LOG_DEBUG("[RLE] Исходный размер: %zu байт\n", input_size);
+    LOG_DEBUG("[RLE] Сжатый размер: %zu байт\n", *output_size);
+
+    double ratio = (1.0 - (double)*output_size / (double)input_size) * 100;
+    LOG_DEBUG("[RLE] Коэффициент сжатия: %.2f%%\n", ratio);
+  }
+
+  return result;
 }
 
-Result rle_decompress(const Byte* input, Size input_size, Byte** output,
-                      Size* output_size, const RLEContext* context)
+Result rle_compress(const Byte* input, Size input_size, Byte** output,
+                    Size* output_size, const RLEContext* context)
 {
   if (!input || !output || !output_size || !context || input_size == 0)
   {
-    printf("[RLE] Ошибка: неверные параметры в rle_decompress\n");
+    LOG_ERROR("[RLE] Ошибка: неверные параметры в rle_compress\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[RLE] Начало RLE декомпрессии с префиксом 0x%02X\n", context->prefix);
-  printf("[RLE] Размер входных данных: %zu байт\n", input_size);
-  printf("[RLE] Ожидаемый выходной размер: %zu байт\n", *output_size);
+  Size capacity = rle_compress_bound(input_size);
+  Byte* compressed = (Byte*)malloc(capacity);
+  if (!compressed)
+  {
+    LOG_ERROR("[RLE] Ошибка выделения памяти для сжатых данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Size compressed_size = 0;
+  Result result = rle_compress_into(input, input_size, compressed, capacity,
+                                    &compressed_size, context);
+  if (result != RESULT_OK)
+  {
+    free(compressed);
+    return result;
+  }
+
+  // Обрезаем буфер до фактического размера
+  Byte* trimmed = (Byte*)realloc(compressed, compressed_size);
+  if (trimmed)
+  {
+    compressed = trimmed;
+  }
+
+  *output = compressed;
+  *output_size = compressed_size;
+  return RESULT_OK;
+}
+
+// Разбор одной управляющей последовательности, начинающейся с префикса.
+// Возвращает количество прочитанных байт; symbol/count описывают результат.
+static Size rle_parse_sequence(const Byte* input, Size in_pos, Size input_size,
+                               Byte prefix, Byte* symbol, Size* count)
+{
+  if (in_pos + 1 >= input_size)
+  {
+    // Префикс в конце потока - трактуем как обычный байт
+    *symbol = prefix;
+    *count = 1;
+    return 1;
+  }
+
+  Byte length = input[in_pos + 1];
+  if (length == 0)
+  {
+    // Одиночный префикс
+    *symbol = prefix;
+    *count = 1;
+    return 2;
+  }
 
-  // Первый проход: определяем размер выходного буфера
+  if (in_pos + 2 >= input_size)
+  {
+    // Некорректная последовательность - трактуем как обычный байт
+    *symbol = prefix;
+    *count = 1;
+    return 1;
+  }
+
+  *symbol = input[in_pos + 2];
+  // Последовательность префиксов: длина + 1, обычных символов: длина + 3
+  *count = (*symbol == prefix) ? (Size)length + 1 : (Size)length + 3;
+  return 3;
+}
+
+// Размер распакованных классических данных. Литеральные участки между
+// префиксами пропускаются через memchr
+static Size rle_measure_classic(const Byte* input, Size input_size,
+                                Byte prefix)
+{
   Size estimated_size = 0;
   Size in_pos = 0;
 
   while (in_pos < input_size)
   {
-    Byte current = input[in_pos];
-
-    if (current == context->prefix && in_pos + 1 < input_size)
-    {
-      // Возможная RLE-последовательность
-      Byte length = input[in_pos + 1];
+    const Byte* next_prefix =
+      (const Byte*)memchr(input + in_pos, prefix, input_size - in_pos);
+    Size literal_end =
+      next_prefix ? (Size)(next_prefix - input) : input_size;
 
-      if (length == 0)
-      {
-        // Одиночный префикс
-        estimated_size++;
-        in_pos += 2;
-      }
-      else if (in_pos + 2 < input_size)
-      {
-        // Полная RLE-последовательность
-        Byte symbol = input[in_pos + 2];
+    estimated_size += literal_end - in_pos;
+    in_pos = literal_end;
 
-        if (symbol == context->prefix)
-        {
-          // Последовательность префиксов: длина + 1
-          estimated_size += length + 1;
-        }
-        else
-        {
-          // Последовательность обычных символов: длина + 3
-          estimated_size += length + 3;
-        }
-        in_pos += 3;
-      }
-      else
-      {
-        // Некорректная последовательность - трактуем как обычный байт
-        estimated_size++;
-        in_pos++;
-      }
-    }
-    else
+    if (in_pos < input_size)
     {
-      // Обычный байт
-      estimated_size++;
-      in_pos++;
+      Byte symbol;
+      Size count;
+      in_pos += rle_parse_sequence(input, in_pos, input_size, prefix, &symbol,
+                                   &count);
+      estimated_size += count;
     }
   }
 
-  printf("[RLE] Расчетный размер после декомпрессии: %zu байт\n",
-         estimated_size);
+  return estimated_size;
+}
 
-  if (*output_size == 0)
-  {
-    *output_size = estimated_size;
-  }
-  else if (estimated_size != *output_size)
+// Литералы копируются memcpy, серии - memset
+static void rle_decompress_classic_into(const Byte* input, Size input_size,
+                                        Byte* output, Size* output_size,
+                                        Byte prefix)
+{
+  Size capacity = *output_size;
+  Size in_pos = 0;
+  Size out_pos = 0;
+
+  while (in_pos < input_size && out_pos < capacity)
   {
-    printf(
-      "[RLE] Предупреждение: расчетный размер (%zu) не совпадает с ожидаемым "
-      "(%zu)\n",
-      estimated_size, *output_size);
-    // Используем больший из размеров для безопасности
-    if (estimated_size > *output_size)
+    const Byte* next_prefix =
+      (const Byte*)memchr(input + in_pos, prefix, input_size - in_pos);
+    Size literal_end =
+      next_prefix ? (Size)(next_prefix - input) : input_size;
+
+    Size literal_length = literal_end - in_pos;
+    if (literal_length > capacity - out_pos)
     {
-      *output_size = estimated_size;
+      literal_length = capacity - out_pos;
+    }
+
+    memcpy(output + out_pos, input + in_pos, literal_length);
+    out_pos += literal_length;
+    in_pos = literal_end;
+
+    if (in_pos < input_size && out_pos < capacity)
+    {
+      Byte symbol;
+      Size count;
+      in_pos += rle_parse_sequence(input, in_pos, input_size, prefix, &symbol,
+                                   &count);
+
+      if (count > capacity - out_pos)
+      {
+        count = capacity - out_pos;
+      }
+
+      memset(output + out_pos, symbol, count);
+      out_pos += count;
     }
   }
 
-  // Выделяем буфер для выходных данных
-  Byte* decompressed = (Byte*)malloc(*output_size);
-  if (!decompressed)
+  if (out_pos != capacity)
   {
-    printf("[RLE] Ошибка выделения памяти для декомпрессированных данных\n");
-    return RESULT_MEMORY_ERROR;
+    LOG_WARN("[RLE] ВНИМАНИЕ: декомпрессировано %zu байт из %zu ожидаемых\n",
+             out_pos, capacity);
   }
 
-  // Второй проход: декомпрессия
-  in_pos = 0;
-  Size out_pos = 0;
+  *output_size = out_pos;
+}
 
-  while (in_pos < input_size && out_pos < *output_size)
+Result rle_decompress_into(const Byte* input, Size input_size, Byte* output,
+                           Size* output_size, const RLEContext* context)
+{
+  if (!input || !output || !output_size || !context || input_size == 0)
   {
-    Byte current = input[in_pos];
+    LOG_ERROR("[RLE] Ошибка: неверные параметры в rle_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
 
-    if (current == context->prefix && in_pos + 1 < input_size)
-    {
-      // Возможная RLE-последовательность
-      Byte length = input[in_pos + 1];
+  LOG_DEBUG("[RLE] Начало RLE декомпрессии с префиксом 0x%02X\n",
+            context->prefix);
+  LOG_DEBUG("[RLE] Размер входных данных: %zu байт\n", input_size);
+  LOG_DEBUG("[RLE] Размер выходного буфера: %zu байт\n", *output_size);
 
-      if (length == 0)
-      {
-        // Одиночный префикс
-        if (out_pos < *output_size)
-        {
-          decompressed[out_pos++] = context->prefix;
-        }
-        in_pos += 2;
+  if (context->format == RLE_FORMAT_VARINT)
+  {
+    return rle_decompress_varint_into(input, input_size, output, output_size);
+  }
 
-        printf("[RLE] Декомпрессирован одиночный префикс (0x%02X)\n",
-               context->prefix);
-      }
-      else if (in_pos + 2 < input_size)
-      {
-        // Полная RLE-последовательность
-        Byte symbol = input[in_pos + 2];
+  rle_decompress_classic_into(input, input_size, output, output_size,
+                              context->prefix);
 
-        Size repeat_count;
-        if (symbol == context->prefix)
-        {
-          // Последовательность префиксов
-          repeat_count = length + 1;
-        }
-        else
-        {
-          // Последовательность обычных символов
-          repeat_count = length + 3;
-        }
+  if (*output_size == 0)
+  {
+    LOG_ERROR("[RLE] КРИТИЧЕСКАЯ ОШИБКА: не декомпрессировано ни одного "
+              "байта!\n");
+    return RESULT_ERROR;
+  }
 
-        for (Size i = 0; i < repeat_count && out_pos < *output_size; i++)
-        {
-          decompressed[out_pos++] = symbol;
-        }
-        in_pos += 3;
+  LOG_DEBUG("[RLE] Декомпрессия завершена\n");
+  LOG_DEBUG_DUMP("[RLE] Первые 32 байт декомпрессированных данных", output,
+                 *output_size, 32);
 
-        if (symbol == context->prefix)
-        {
-          printf("[RLE] Декомпрессировано %zu символов префикса (0x%02X)\n",
-                 repeat_count, symbol);
-        }
-        else
-        {
-          printf("[RLE] Декомпрессировано %zu символов 0x%02X ('%c')\n",
-                 repeat_count, symbol,
-                 (symbol >= 32 && symbol <= 126) ? symbol : '.');
-        }
-      }
-      else
-      {
-        // Некорректная последовательность - трактуем как обычный байт
-        if (out_pos < *output_size)
-        {
-          decompressed[out_pos++] = current;
-        }
-        in_pos++;
-      }
-    }
-    else
-    {
-      // Обычный байт
-      if (out_pos < *output_size)
-      {
-        decompressed[out_pos++] = current;
-      }
-      in_pos++;
-    }
-  }
+  return RESULT_OK;
+}
 
-  // Проверяем, все ли декомпрессировано
-  if (out_pos != *output_size)
+Result rle_decompress(const Byte* input, Size input_size, Byte** output,
+                      Size* output_size, const RLEContext* context)
+{
+  if (!input || !output || !output_size || !context || input_size == 0)
   {
-    printf("[RLE] ВНИМАНИЕ: декомпрессировано %zu байт из %zu ожидаемых\n",
-           out_pos, *output_size);
+    LOG_ERROR("[RLE] Ошибка: неверные параметры в rle_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
 
-    if (out_pos == 0)
+  // Буфер выделяется по расчетному размеру потока, поэтому данные сверх
+  // ожидаемого размера не теряются
+  Size estimated_size = 0;
+  if (context->format == RLE_FORMAT_VARINT)
+  {
+    Result result = rle_measure_varint(input, input_size, &estimated_size);
+    if (result != RESULT_OK)
     {
-      printf(
-        "[RLE] КРИТИЧЕСКАЯ ОШИБКА: не декомпрессировано ни одного байта!\n");
-      free(decompressed);
-      return RESULT_ERROR;
+      return result;
     }
+  }
+  else
+  {
+    estimated_size = rle_measure_classic(input, input_size, context->prefix);
+  }
 
-    // Обрезаем буфер до фактического размера
-    Byte* trimmed = (Byte*)realloc(decompressed, out_pos);
-    if (trimmed)
-    {
-      decompressed = trimmed;
-      *output_size = out_pos;
-    }
-    else
+  LOG_DEBUG("[RLE] Расчетный размер после декомпрессии: %zu байт\n",
+            estimated_size);
+
+  if (*output_size == 0)
+  {
+    *output_size = estimated_size;
+  }
+  else if (estimated_size != *output_size)
+  {
+    LOG_WARN("[RLE] Предупреждение: расчетный размер (%zu) не совпадает с "
+             "ожидаемым " "(%zu)\n", estimated_size, *output_size);
+    // Используем больший из размеров для безопасности
+    if (estimated_size > *output_size)
     {
-      printf("[RLE] Предупреждение: не удалось обрезать буфер\n");
+      *output_size = estimated_size;
     }
   }
 
-  printf("[RLE] Декомпрессия завершена\n");
-  printf("[RLE] Первые 32 байт декомпрессированных данных: ");
-  for (Size i = 0; i < 32 && i < *output_size; i++)
+  Byte* decompressed = (Byte*)malloc(*output_size > 0 ? *output_size : 1);
+  if (!decompressed)
   {
-    Byte b = decompressed[i];
-    printf("%02X ", b);
+    LOG_ERROR("[RLE] Ошибка выделения памяти для декомпрессированных данных\n");
+    return RESULT_MEMORY_ERROR;
   }
-  printf("\n");
-  printf("[RLE] Первые 32 байт как текст: ");
-  for (Size i = 0; i < 32 && i < *output_size; i++)
+
+  Result result =
+    rle_decompress_into(input, input_size, decompressed, output_size, context);
+  if (result != RESULT_OK)
   {
-    Byte b = decompressed[i];
-    printf("%c", (b >= 32 && b <= 126) ? b : '.');
+    free(decompressed);
+    return result;
   }
-  printf("\n");
 
   *output = decompressed;
   return RESULT_OK;
@@ -457,7 +848,9 @@ Result rle_serialize_context(const RLEContext* context, Byte** data, Size* size)
     return RESULT_INVALID_ARGUMENT;
   }
 
-  *size = 1;  // Только префикс
+  // Классический формат - только префикс (совместимо со старыми архивами),
+  // для остальных форматов добавляется байт формата
+  *size = context->format == RLE_FORMAT_CLASSIC ? 1 : 2;
   *data = (Byte*)malloc(*size);
   if (!*data)
   {
@@ -465,17 +858,28 @@ Result rle_serialize_context(const RLEContext* context, Byte** data, Size* size)
   }
 
   (*data)[0] = context->prefix;
+  if (*size > 1)
+  {
+    (*data)[1] = context->format;
+  }
   return RESULT_OK;
 }
 
 Result rle_deserialize_context(RLEContext* context, const Byte* data, Size size)
 {
-  if (!context || !data || size != 1)
+  if (!context || !data || (size != 1 && size != 2))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  if (size == 2 && data[1] != RLE_FORMAT_CLASSIC &&
+      data[1] != RLE_FORMAT_VARINT)
   {
     return RESULT_INVALID_ARGUMENT;
   }
 
   context->prefix = data[0];
+  context->format = size == 2 ? data[1] : RLE_FORMAT_CLASSIC;
   return RESULT_OK;
 }
 
@@ -495,6 +899,23 @@ Result rle_set_prefix(RLEContext* context, Byte prefix)
   return RESULT_OK;
 }
 
+RLEFormat rle_get_format(const RLEContext* context)
+{
+  return context ? (RLEFormat)context->format : RLE_FORMAT_CLASSIC;
+}
+
+Result rle_set_format(RLEContext* context, RLEFormat format)
+{
+  if (!context ||
+      (format != RLE_FORMAT_CLASSIC && format != RLE_FORMAT_VARINT))
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  context->format = (Byte)format;
+  return RESULT_OK;
+}
+
 // Анализ данных для выбора оптимального префикса
 Byte rle_analyze_prefix(const Byte* data, Size size)
 {
@@ -534,9 +955,8 @@ Byte rle_analyze_prefix(const Byte* data, Size size)
       if (frequencies[i] == 0)
       {
         best_prefix = (Byte)i;
-        printf(
-          "[RLE] Найден неиспользуемый символ 0x%02X в качестве префикса\n",
-          best_prefix);
+        LOG_DEBUG("[RLE] Найден неиспользуемый символ 0x%02X в качестве "
+                  "префикса\n", best_prefix);
         break;
       }
     }
@@ -546,16 +966,16 @@ Byte rle_analyze_prefix(const Byte* data, Size size)
     if (best_prefix == 0)
     {
       best_prefix = 0xFF;
-      printf("[RLE] Все символы используются, выбран префикс 0xFF\n");
+      LOG_DEBUG("[RLE] Все символы используются, выбран префикс 0xFF\n");
     }
   }
 
-  printf("[RLE] Анализ данных: выбран префикс 0x%02X ", best_prefix);
+  LOG_DEBUG("[RLE] Анализ данных: выбран префикс 0x%02X ", best_prefix);
   if (best_prefix >= 32 && best_prefix <= 126)
   {
-    printf("('%c') ", best_prefix);
+    LOG_DEBUG("('%c') ", best_prefix);
   }
-  printf("(встречается %u раз)\n", frequencies[best_prefix]);
+  LOG_DEBUG("(встречается %u раз)\n", frequencies[best_prefix]);
 
   return best_prefix;
 }
@@ -568,19 +988,19 @@ void rle_test_compression(const Byte* data, Size size, Byte prefix)
     return;
   }
 
-  printf("\n=== Тестирование RLE сжатия ===\n");
-  printf("Размер данных: %zu байт\n", size);
-  printf("Используемый префикс: 0x%02X", prefix);
+  LOG_DEBUG("\n=== Тестирование RLE сжатия ===\n");
+  LOG_DEBUG("Размер данных: %zu байт\n", size);
+  LOG_DEBUG("Используемый префикс: 0x%02X", prefix);
   if (prefix >= 32 && prefix <= 126)
   {
-    printf(" ('%c')", prefix);
+    LOG_DEBUG(" ('%c')", prefix);
   }
-  printf("\n");
+  LOG_DEBUG("\n");
 
   RLEContext* context = rle_create(prefix);
   if (!context)
   {
-    printf("Ошибка создания контекста RLE\n");
+    LOG_ERROR("Ошибка создания контекста RLE\n");
     return;
   }
 
@@ -591,16 +1011,13 @@ void rle_test_compression(const Byte* data, Size size, Byte prefix)
     rle_compress(data, size, &compressed, &compressed_size, context);
   if (result == RESULT_OK && compressed)
   {
-    printf("Сжатие успешно: %zu -> %zu байт (%.2f%%)\n", size, compressed_size,
-           (1.0 - (double)compressed_size / (double)size) * 100);
+    LOG_DEBUG("Сжатие успешно: %zu -> %zu байт (%.2f%%)\n", size,
+              compressed_size,
+              (1.0 - (double)compressed_size / (double)size) * 100);
 
     // Анализ сжатых данных
-    printf("Первые 32 байт сжатых данных: ");
-    for (Size i = 0; i < 32 && i < compressed_size; i++)
-    {
-      printf("%02X ", compressed[i]);
-    }
-    printf("\n");
+    LOG_DEBUG_DUMP("Первые 32 байт сжатых данных", compressed,
+                   compressed_size, 32);
 
     // Тест декомпрессии
     Byte* decompressed = NULL;
@@ -615,8 +1032,8 @@ void rle_test_compression(const Byte* data, Size size, Byte prefix)
       bool correct = true;
       if (decompressed_size != size)
       {
-        printf("Ошибка: размер не совпадает (ожидалось %zu, получено %zu)\n",
-               size, decompressed_size);
+        LOG_ERROR("Ошибка: размер не совпадает (ожидалось %zu, получено %zu)\n",
+                  size, decompressed_size);
         correct = false;
       }
       else
@@ -625,8 +1042,8 @@ void rle_test_compression(const Byte* data, Size size, Byte prefix)
         {
           if (data[i] != decompressed[i])
           {
-            printf("Ошибка: несовпадение в позиции %zu: 0x%02X != 0x%02X\n", i,
-                   data[i], decompressed[i]);
+            LOG_ERROR("Ошибка: несовпадение в позиции %zu: 0x%02X != 0x%02X\n",
+                      i, data[i], decompressed[i]);
             correct = false;
             break;
           }
@@ -635,40 +1052,29 @@ void rle_test_compression(const Byte* data, Size size, Byte prefix)
 
       if (correct)
       {
-        printf("Декомпрессия успешна, данные корректны\n");
+        LOG_DEBUG("Декомпрессия успешна, данные корректны\n");
       }
       else
       {
-        printf("Ошибка: данные после декомпрессии не совпадают\n");
+        LOG_ERROR("Ошибка: данные после декомпрессии не совпадают\n");
 
-        printf("Первые 64 символа оригинала: ");
-        for (Size i = 0; i < 64 && i < size; i++)
-        {
-          Byte b = data[i];
-          printf("%c", (b >= 32 && b <= 126) ? b : '.');
-        }
-        printf("\n");
+        LOG_DEBUG_DUMP("Первые 64 символа оригинала", data, size, 64);
 
-        printf("Первые 64 символа результата: ");
-        for (Size i = 0; i < 64 && i < decompressed_size; i++)
-        {
-          Byte b = decompressed[i];
-          printf("%c", (b >= 32 && b <= 126) ? b : '.');
-        }
-        printf("\n");
+        LOG_DEBUG_DUMP("Первые 64 символа результата", decompressed,
+                       decompressed_size, 64);
       }
       free(decompressed);
     }
     else
     {
-      printf("Ошибка декомпрессии!\n");
+      LOG_ERROR("Ошибка декомпрессии!\n");
     }
 
     free(compressed);
   }
   else
   {
-    printf("Ошибка сжатия!\n");
+    LOG_ERROR("Ошибка сжатия!\n");
   }
 
   rle_destroy(context);
@@ -3,9 +3,16 @@
 
 #include "types.h"
 
+typedef enum
+{
+  RLE_FORMAT_CLASSIC = 0,  // Тройки (префикс, длина, символ), длина до 255
+  RLE_FORMAT_VARINT = 1,   // Управляющие varint: серии и литеральные участки
+} RLEFormat;
+
 typedef struct RLEContext
 {
   Byte prefix;
+  Byte format;  // RLEFormat
 } RLEContext;
 
 RLEContext* rle_create(Byte prefix);
@@ -16,6 +23,14 @@ Result rle_compress(const Byte* input, Size input_size, Byte** output,
 Result rle_decompress(const Byte* input, Size input_size, Byte** output,
                       Size* output_size, const RLEContext* context);
 
+// Варианты с буфером вызывающего кода, семантика как у lz77_*_into
+Size rle_compress_bound(Size input_size);
+Result rle_compress_into(const Byte* input, Size input_size, Byte* output,
+                         Size output_capacity, Size* output_size,
+                         const RLEContext* context);
+Result rle_decompress_into(const Byte* input, Size input_size, Byte* output,
+                           Size* output_size, const RLEContext* context);
+
 Result rle_serialize_context(const RLEContext* context, Byte** data,
                              Size* size);
 Result rle_deserialize_context(RLEContext* context, const Byte* data,
@@ -23,6 +38,8 @@ Result rle_deserialize_context(RLEContext* context, const Byte* data,
 
 Byte rle_get_prefix(const RLEContext* context);
 Result rle_set_prefix(RLEContext* context, Byte prefix);
+RLEFormat rle_get_format(const RLEContext* context);
+Result rle_set_format(RLEContext* context, RLEFormat format);
 Byte rle_analyze_prefix(const Byte* data, Size size);
 void rle_test_compression(const Byte* data, Size size, Byte prefix);
 
@@ -1,10 +1,10 @@
 #include "shannon.h"
 
 #include <ctype.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "log.h"
 #include "types.h"
 
 typedef struct
@@ -15,6 +15,36 @@ typedef struct
   DWord cumulative_high;
 } ShannonSymbol;
 
+#define SHANNON_TREE_FORMAT_LENGTHS 0x02
+#define SHANNON_PRIMARY_TABLE_BITS 10
+#define SHANNON_SUBTABLE_BITS 6
+
+// Листья и корень (не более 256 + 1 узлов) помещаются в один блок арены,
+// запас на узел покрывает выравнивание
+#define SHANNON_ARENA_BLOCK_SIZE \
+  ((SHANNON_MAX_SYMBOLS + 1) * (sizeof(ShannonNode) + 16))
+
+typedef enum
+{
+  SHANNON_ENTRY_INVALID = 0,
+  SHANNON_ENTRY_SYMBOL = 1,
+  SHANNON_ENTRY_LINK = 2
+} ShannonEntryKind;
+
+typedef struct
+{
+  DWord value;  // Символ или смещение подтаблицы
+  Byte length;  // Число бит, потребляемых на этом уровне
+  Byte kind;
+} ShannonDecodeEntry;
+
+typedef struct
+{
+  ShannonDecodeEntry* entries;
+  Size entry_count;
+  Size capacity;
+} ShannonDecodeTable;
+
 static int compare_symbols(const void* left_symbol, const void* right_symbol)
 {
   const ShannonSymbol* shannon_left_symbol = (const ShannonSymbol*)left_symbol;
@@ -104,12 +134,62 @@ static void generate_shannon_codes(ShannonTree* tree, ShannonSymbol* symbols,
                          depth + 1);
 }
 
+// Переназначает коды в каноническом порядке (длина, символ). Длины кодов
+// Шеннона-Фано сохраняются, поэтому степень сжатия не меняется, а для
+// восстановления кодов достаточно таблицы длин.
+static void assign_canonical_codes(ShannonTree* tree)
+{
+  DWord length_counts[SHANNON_MAX_CODE_LENGTH + 1] = {0};
+  for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
+  {
+    length_counts[tree->code_lengths[i]]++;
+  }
+  length_counts[0] = 0;
+
+  QWord next_code[SHANNON_MAX_CODE_LENGTH + 1] = {0};
+  QWord code = 0;
+  for (int length = 1; length <= SHANNON_MAX_CODE_LENGTH; length++)
+  {
+    code = (code + length_counts[length - 1]) << 1;
+    next_code[length] = code;
+  }
+
+  for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
+  {
+    Byte length = tree->code_lengths[i];
+    if (length == 0)
+    {
+      continue;
+    }
+
+    QWord symbol_code = next_code[length]++;
+    for (Byte j = 0; j < length; j++)
+    {
+      tree->codes[i][j] = (Byte)((symbol_code >> (length - 1 - j)) & 1);
+    }
+
+    if (tree->nodes[i])
+    {
+      tree->nodes[i]->code_length = length;
+      memcpy(tree->nodes[i]->code, tree->codes[i], length);
+    }
+  }
+}
+
 ShannonTree* shannon_tree_create(void)
 {
   ShannonTree* tree = malloc(sizeof(ShannonTree));
   if (!tree)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  tree->arena = arena_create(SHANNON_ARENA_BLOCK_SIZE);
+  if (!tree->arena)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    free(tree);
     return NULL;
   }
 
@@ -121,72 +201,98 @@ ShannonTree* shannon_tree_create(void)
   return tree;
 }
 
-static void destroy_node(ShannonNode* node)
+void shannon_tree_destroy(ShannonTree* tree)
 {
-  if (!node)
+  if (!tree)
   {
     return;
   }
 
-  destroy_node(node->left);
-  destroy_node(node->right);
-  free(node);
+  arena_destroy(tree->arena);
+  free(tree);
 }
 
-void shannon_tree_destroy(ShannonTree* tree)
+// Повторное построение переиспользует арену: узлы прежнего дерева
+// освобождаются целиком
+static void reset_tree(ShannonTree* tree)
 {
-  if (!tree)
+  arena_reset(tree->arena);
+  tree->root = NULL;
+  memset((void*)tree->nodes, 0, sizeof(tree->nodes));
+  memset(tree->code_lengths, 0, sizeof(tree->code_lengths));
+  memset(tree->codes, 0, sizeof(tree->codes));
+}
+
+static ShannonNode* create_node(ShannonTree* tree, Byte symbol,
+                                DWord frequency)
+{
+  ShannonNode* node = arena_alloc(tree->arena, sizeof(ShannonNode));
+  if (!node)
   {
-    return;
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
   }
 
-  for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
+  node->symbol = symbol;
+  node->frequency = frequency;
+  node->left = NULL;
+  node->right = NULL;
+  node->code_length = 0;
+  memset(node->code, 0, sizeof(node->code));
+
+  return node;
+}
+
+Result shannon_tree_build(ShannonTree* tree, const Byte* data, Size size)
+{
+  if (!tree || !data || size == 0)
   {
-    if (tree->nodes[i])
-    {
-      if (tree->nodes[i]->left == NULL && tree->nodes[i]->right == NULL)
-      {
-        free(tree->nodes[i]);
-      }
-      tree->nodes[i] = NULL;
-    }
+    return RESULT_INVALID_ARGUMENT;
   }
 
-  if (tree->root && tree->root->left == NULL && tree->root->right == NULL)
+  DWord frequencies[SHANNON_MAX_SYMBOLS] = {0};
+  for (Size i = 0; i < size; i++)
   {
-    free(tree->root);
+    frequencies[data[i]]++;
   }
 
-  free(tree);
+  return shannon_tree_build_from_frequencies(tree, frequencies);
 }
 
-Result shannon_tree_build(ShannonTree* tree, const Byte* data, Size size)
+Result shannon_tree_build_from_frequencies(ShannonTree* tree,
+                                           const DWord* frequencies)
 {
-  if (!tree || !data || size == 0)
+  if (!tree || !frequencies)
   {
     return RESULT_INVALID_ARGUMENT;
   }
 
-  DWord frequencies[SHANNON_MAX_SYMBOLS] = {0};
   int symbol_count = 0;
-
-  for (Size i = 0; i < size; i++)
+  Size size = 0;
+  for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
   {
-    if (frequencies[data[i]] == 0)
+    if (frequencies[i] > 0)
     {
       symbol_count++;
+      size += frequencies[i];
     }
-    frequencies[data[i]]++;
+  }
+
+  if (symbol_count == 0)
+  {
+    return RESULT_INVALID_ARGUMENT;
   }
 
   ShannonSymbol* symbols =
     (ShannonSymbol*)malloc(sizeof(ShannonSymbol) * symbol_count);
   if (!symbols)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return RESULT_MEMORY_ERROR;
   }
 
+  reset_tree(tree);
+
   int index = 0;
   for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
   {
@@ -202,41 +308,35 @@ Result shannon_tree_build(ShannonTree* tree, const Byte* data, Size size)
 
   for (int i = 0; i < symbol_count; i++)
   {
-    ShannonNode* node = malloc(sizeof(ShannonNode));
+    ShannonNode* node =
+      create_node(tree, symbols[i].symbol, symbols[i].frequency);
     if (!node)
     {
       free(symbols);
+      reset_tree(tree);
       return RESULT_MEMORY_ERROR;
     }
 
-    node->symbol = symbols[i].symbol;
-    node->frequency = symbols[i].frequency;
-    node->left = NULL;
-    node->right = NULL;
-    node->code_length = 0;
-    memset(node->code, 0, sizeof(node->code));
-
     tree->nodes[symbols[i].symbol] = node;
   }
 
-  tree->root = malloc(sizeof(ShannonNode));
+  tree->root = create_node(tree, 0, size);
   if (!tree->root)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
-
     free(symbols);
+    reset_tree(tree);
     return RESULT_MEMORY_ERROR;
   }
 
-  tree->root->symbol = 0;
-  tree->root->frequency = size;
-  tree->root->left = NULL;
-  tree->root->right = NULL;
-  tree->root->code_length = 0;
-
   Byte current_code[SHANNON_MAX_CODE_LENGTH] = {0};
   generate_shannon_codes(tree, symbols, 0, symbol_count, current_code, 0);
 
+  if (symbol_count == 1)
+  {
+    tree->code_lengths[symbols[0].symbol] = 1;  // Единственному символу - 1 бит
+  }
+  assign_canonical_codes(tree);
+
   free(symbols);
   return RESULT_OK;
 }
@@ -257,39 +357,45 @@ Size shannon_calculate_size(const ShannonTree* tree, const Byte* data,
 
   Size bytes = (bit_count + 7) / 8;
 
-  printf("[SHANNON] Расчет размера: %zu байт -> %zu бит -> %zu байт\n", size,
-         bit_count, bytes);
+  LOG_DEBUG("[SHANNON] Расчет размера: %zu байт -> %zu бит -> %zu байт\n", size,
+            bit_count, bytes);
 
   return bytes;
 }
 
-Result shannon_compress(const Byte* input, Size input_size, Byte** output,
-                        Size* output_size, const ShannonTree* tree)
+Size shannon_compress_bound(Size input_size)
+{
+  return input_size * (SHANNON_MAX_CODE_LENGTH / 8);
+}
+
+Result shannon_compress_into(const Byte* input, Size input_size, Byte* output,
+                             Size output_capacity, Size* output_size,
+                             const ShannonTree* tree)
 {
   if (!input || !output || !output_size || !tree || input_size == 0)
   {
-    printf("[SHANNON] Ошибка: неверные параметры в shannon_compress\n");
+    LOG_ERROR("[SHANNON] Ошибка: неверные параметры в shannon_compress\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[SHANNON] Начало сжатия, размер данных: %zu байт\n", input_size);
+  LOG_DEBUG("[SHANNON] Начало сжатия, размер данных: %zu байт\n", input_size);
 
   Size compressed_size = shannon_calculate_size(tree, input, input_size);
   if (compressed_size == 0)
   {
-    printf("[SHANNON] Ошибка: расчетный размер сжатия = 0\n");
+    LOG_ERROR("[SHANNON] Ошибка: расчетный размер сжатия = 0\n");
     return RESULT_ERROR;
   }
 
-  Byte* compressed = malloc(compressed_size);
-  if (!compressed)
+  if (compressed_size > output_capacity)
   {
-    printf("[SHANNON] Ошибка выделения памяти для сжатых данных\n");
-    return RESULT_MEMORY_ERROR;
+    LOG_ERROR("[SHANNON] Ошибка: выходной буфер (%zu байт) меньше сжатых "
+              "данных (%zu байт)\n", output_capacity, compressed_size);
+    return RESULT_ERROR;
   }
 
+  Byte* compressed = output;
   memset(compressed, 0, compressed_size);
-  printf("[SHANNON] Выделено %zu байт для сжатых данных\n", compressed_size);
 
   Size bit_position = 0;
   for (Size i = 0; i < input_size; i++)
@@ -300,8 +406,7 @@ Result shannon_compress(const Byte* input, Size input_size, Byte** output,
 
     if (length == 0)
     {
-      printf("[SHANNON] ВНИМАНИЕ: символ 0x%02X не имеет кода!\n", symbol);
-      free(compressed);
+      LOG_WARN("[SHANNON] ВНИМАНИЕ: символ 0x%02X не имеет кода!\n", symbol);
       return RESULT_ERROR;
     }
 
@@ -324,16 +429,42 @@ Result shannon_compress(const Byte* input, Size input_size, Byte** output,
     bit_position++;  // Дополняем до границы байта
   }
 
-  printf("[SHANNON] Сжатие завершено. Использовано бит: %zu\n", bit_position);
-  printf("[SHANNON] Первые 16 байт сжатых данных: ");
-  for (Size i = 0; i < 16 && i < compressed_size; i++)
+  LOG_DEBUG("[SHANNON] Сжатие завершено. Использовано бит: %zu\n",
+            bit_position);
+  LOG_DEBUG_DUMP("[SHANNON] Первые 16 байт сжатых данных", compressed,
+                 compressed_size, 16);
+
+  *output_size = compressed_size;
+  return RESULT_OK;
+}
+
+Result shannon_compress(const Byte* input, Size input_size, Byte** output,
+                        Size* output_size, const ShannonTree* tree)
+{
+  if (!input || !output || !output_size || !tree || input_size == 0)
+  {
+    LOG_ERROR("[SHANNON] Ошибка: неверные параметры в shannon_compress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  // Размер известен заранее, поэтому буфер выделяется точно по нему
+  Size capacity = shannon_calculate_size(tree, input, input_size);
+  Byte* compressed = malloc(capacity > 0 ? capacity : 1);
+  if (!compressed)
+  {
+    LOG_ERROR("[SHANNON] Ошибка выделения памяти для сжатых данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Result result = shannon_compress_into(input, input_size, compressed,
+                                        capacity, output_size, tree);
+  if (result != RESULT_OK)
   {
-    printf("%02X ", compressed[i]);
+    free(compressed);
+    return result;
   }
-  printf("\n");
 
   *output = compressed;
-  *output_size = compressed_size;
   return RESULT_OK;
 }
 
@@ -347,192 +478,319 @@ static ShannonNode* find_symbol_node(const ShannonTree* tree, Byte symbol)
   return tree->nodes[symbol];
 }
 
-Result shannon_decompress(const Byte* input, Size input_size, Byte** output,
-                          Size* output_size, const ShannonTree* tree)
+static Result reserve_decode_subtable(ShannonDecodeTable* table, int bits,
+                                      Size* offset)
 {
-  if (!input || !output || !output_size || !tree || input_size == 0)
+  Size count = (Size)1 << bits;
+  if (table->entry_count + count > table->capacity)
   {
-    printf("[SHANNON] Ошибка: неверные параметры в shannon_decompress\n");
-    return RESULT_INVALID_ARGUMENT;
+    Size new_capacity = table->capacity * 2;
+    while (new_capacity < table->entry_count + count)
+    {
+      new_capacity *= 2;
+    }
+
+    ShannonDecodeEntry* entries =
+      realloc(table->entries, new_capacity * sizeof(ShannonDecodeEntry));
+    if (!entries)
+    {
+      LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+      return RESULT_MEMORY_ERROR;
+    }
+
+    table->entries = entries;
+    table->capacity = new_capacity;
   }
 
-  printf("[SHANNON] Начало декомпрессии\n");
-  printf("[SHANNON] Размер входных данных: %zu байт\n", input_size);
-  printf("[SHANNON] Ожидаемый выходной размер: %zu байт\n", *output_size);
+  *offset = table->entry_count;
+  memset(&table->entries[*offset], 0, count * sizeof(ShannonDecodeEntry));
+  table->entry_count += count;
+  return RESULT_OK;
+}
 
-  if (input_size == 0)
+static Result insert_decode_code(ShannonDecodeTable* table, const Byte* code,
+                                 Byte length, Byte symbol)
+{
+  Size table_offset = 0;
+  int table_bits = SHANNON_PRIMARY_TABLE_BITS;
+  int consumed = 0;
+
+  while (length - consumed > table_bits)
   {
-    printf("[SHANNON] Ошибка: входные данные пустые\n");
-    return RESULT_INVALID_ARGUMENT;
+    Size index = 0;
+    for (int i = 0; i < table_bits; i++)
+    {
+      index = (index << 1) | code[consumed + i];
+    }
+
+    ShannonDecodeEntry* entry = &table->entries[table_offset + index];
+    if (entry->kind == SHANNON_ENTRY_SYMBOL)
+    {
+      return RESULT_ERROR;  // Код не является префиксным
+    }
+
+    if (entry->kind == SHANNON_ENTRY_INVALID)
+    {
+      Size subtable_offset;
+      Result result =
+        reserve_decode_subtable(table, SHANNON_SUBTABLE_BITS, &subtable_offset);
+      if (result != RESULT_OK)
+      {
+        return result;
+      }
+
+      // Таблица могла переместиться при расширении
+      entry = &table->entries[table_offset + index];
+      entry->kind = SHANNON_ENTRY_LINK;
+      entry->value = (DWord)subtable_offset;
+    }
+
+    table_offset = entry->value;
+    consumed += table_bits;
+    table_bits = SHANNON_SUBTABLE_BITS;
   }
 
-  printf("[SHANNON] Первые 16 байт сжатых данных: ");
-  for (Size i = 0; i < 16 && i < input_size; i++)
+  int remaining = length - consumed;
+  Size prefix = 0;
+  for (int i = 0; i < remaining; i++)
   {
-    printf("%02X ", input[i]);
+    prefix = (prefix << 1) | code[consumed + i];
   }
-  printf("\n");
 
-  Byte* decompressed_data = malloc(*output_size);
-  if (decompressed_data == NULL)
+  Size first = prefix << (table_bits - remaining);
+  Size count = (Size)1 << (table_bits - remaining);
+  for (Size i = first; i < first + count; i++)
   {
-    printf(
-      "[SHANNON] Ошибка выделения памяти для декомпрессированных данных\n");
-    return RESULT_MEMORY_ERROR;
+    ShannonDecodeEntry* entry = &table->entries[table_offset + i];
+    if (entry->kind != SHANNON_ENTRY_INVALID)
+    {
+      return RESULT_ERROR;
+    }
+
+    entry->kind = SHANNON_ENTRY_SYMBOL;
+    entry->value = symbol;
+    entry->length = (Byte)remaining;
   }
 
-  typedef struct
+  return RESULT_OK;
+}
+
+// Строит многоуровневую таблицу декодирования: первичная таблица
+// индексируется SHANNON_PRIMARY_TABLE_BITS битами, более длинные коды
+// продолжаются в подтаблицах по SHANNON_SUBTABLE_BITS бит. Таблица строится
+// по фактическим кодам, поэтому подходит и для неканонических кодов из
+// архивов старого формата.
+static Result build_decode_table(const ShannonTree* tree,
+                                 ShannonDecodeTable* table)
+{
+  table->entries = NULL;
+  table->entry_count = 0;
+  table->capacity = 0;
+
+  Size primary_count = (Size)1 << SHANNON_PRIMARY_TABLE_BITS;
+  table->entries = malloc(primary_count * 2 * sizeof(ShannonDecodeEntry));
+  if (!table->entries)
   {
-    Byte code[SHANNON_MAX_CODE_LENGTH];
-    Byte length;
-    Byte symbol;
-  } CodeTableEntry;
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return RESULT_MEMORY_ERROR;
+  }
+  table->capacity = primary_count * 2;
 
-  CodeTableEntry code_table[SHANNON_MAX_SYMBOLS];
-  int table_size = 0;
+  Size primary_offset;
+  Result result = reserve_decode_subtable(table, SHANNON_PRIMARY_TABLE_BITS,
+                                          &primary_offset);
 
-  for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
+  for (int i = 0; i < SHANNON_MAX_SYMBOLS && result == RESULT_OK; i++)
   {
-    if (tree->code_lengths[i] > 0)
+    Byte length = tree->code_lengths[i];
+    if (length == 0)
+    {
+      continue;
+    }
+
+    if (length > SHANNON_MAX_CODE_LENGTH)
     {
-      code_table[table_size].symbol = (Byte)i;
-      code_table[table_size].length = tree->code_lengths[i];
-      memcpy(code_table[table_size].code, tree->codes[i],
-             tree->code_lengths[i]);
-      table_size++;
+      result = RESULT_ERROR;
+      break;
     }
+
+    result = insert_decode_code(table, tree->codes[i], length, (Byte)i);
+  }
+
+  if (result != RESULT_OK)
+  {
+    free(table->entries);
+    table->entries = NULL;
+  }
+
+  return result;
+}
+
+Result shannon_decompress_into(const Byte* input, Size input_size,
+                               Byte* output, Size* output_size,
+                               const ShannonTree* tree)
+{
+  if (!input || !output || !output_size || !tree || input_size == 0)
+  {
+    LOG_ERROR("[SHANNON] Ошибка: неверные параметры в shannon_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  LOG_DEBUG("[SHANNON] Начало декомпрессии\n");
+  LOG_DEBUG("[SHANNON] Размер входных данных: %zu байт\n", input_size);
+  LOG_DEBUG("[SHANNON] Ожидаемый выходной размер: %zu байт\n", *output_size);
+
+  if (input_size == 0)
+  {
+    LOG_ERROR("[SHANNON] Ошибка: входные данные пустые\n");
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  LOG_DEBUG_DUMP("[SHANNON] Первые 16 байт сжатых данных", input,
+                 input_size, 16);
+
+  Byte* decompressed_data = output;
+
+  ShannonDecodeTable table;
+  Result result = build_decode_table(tree, &table);
+  if (result != RESULT_OK)
+  {
+    LOG_ERROR("[SHANNON] Ошибка построения таблицы декодирования\n");
+    return result;
   }
 
+  LOG_DEBUG("[SHANNON] Таблица декодирования: %zu записей\n",
+            table.entry_count);
+
+  const Size total_bits = input_size * 8;
   Size bit_position = 0;
+  Size byte_position = 0;
   Size decompressed_position = 0;
+  QWord bit_buffer = 0;
+  int buffered_bits = 0;
 
-  printf("[SHANNON] Начало декодирования...\n");
-  printf("[SHANNON] Всего битов для чтения: %zu\n", input_size * 8);
+  LOG_DEBUG("[SHANNON] Начало декодирования...\n");
+  LOG_DEBUG("[SHANNON] Всего битов для чтения: %zu\n", total_bits);
 
-  while (decompressed_position < *output_size && bit_position < input_size * 8)
+  while (decompressed_position < *output_size && bit_position < total_bits)
   {
-    Byte current_code[SHANNON_MAX_CODE_LENGTH] = {0};
-    Byte current_length = 0;
+    Size table_offset = 0;
+    int table_bits = SHANNON_PRIMARY_TABLE_BITS;
+    const ShannonDecodeEntry* entry;
 
-    while (current_length < SHANNON_MAX_CODE_LENGTH &&
-           bit_position < input_size * 8)
+    for (;;)
     {
-      Size byte_index = bit_position / 8;
-      Size bit_index = 7 - (bit_position % 8);
-      Byte bit = (input[byte_index] >> bit_index) & 1;
-      bit_position++;
-
-      current_code[current_length++] = bit;
-
-      for (int i = 0; i < table_size; i++)
+      // Подкачка: за концом входа буфер дополняется нулями
+      while (buffered_bits <= 56)
       {
-        if (code_table[i].length == current_length)
-        {
-          bool match = true;
-          for (int j = 0; j < current_length; j++)
-          {
-            if (current_code[j] != code_table[i].code[j])
-            {
-              match = false;
-              break;
-            }
-          }
-
-          if (match)
-          {
-            Byte symbol = code_table[i].symbol;
-            decompressed_data[decompressed_position] = symbol;
-
-            if (decompressed_position < 10)
-            {
-              printf(
-                "[SHANNON] Декодирован символ %u (0x%02X '%c') на позиции %zu "
-                "(бит %zu)\n",
-                symbol, symbol, isprint(symbol) ? symbol : '.',
-                decompressed_position, bit_position);
-            }
+        Byte next = byte_position < input_size ? input[byte_position] : 0;
+        bit_buffer |= (QWord)next << (56 - buffered_bits);
+        byte_position++;
+        buffered_bits += 8;
+      }
 
-            decompressed_position++;
-            goto found_symbol;
-          }
-        }
+      entry = &table.entries[table_offset + (bit_buffer >> (64 - table_bits))];
+      if (entry->kind != SHANNON_ENTRY_LINK)
+      {
+        break;
       }
+
+      bit_buffer <<= table_bits;
+      buffered_bits -= table_bits;
+      bit_position += table_bits;
+      table_offset = entry->value;
+      table_bits = SHANNON_SUBTABLE_BITS;
     }
 
-    printf("[SHANNON] Ошибка: не найден символ для кода длиной %u\n",
-           current_length);
-    free(decompressed_data);
-    return RESULT_ERROR;
+    if (entry->kind == SHANNON_ENTRY_INVALID)
+    {
+      LOG_ERROR("[SHANNON] Ошибка: не найден символ для кода на бите %zu\n",
+                bit_position);
+      free(table.entries);
+        return RESULT_ERROR;
+    }
 
-  found_symbol:
-    continue;
-  }
+    bit_buffer <<= entry->length;
+    buffered_bits -= entry->length;
+    bit_position += entry->length;
 
-  printf("[SHANNON] Декомпрессия завершена\n");
-  printf("[SHANNON] Декомпрессировано байт: %zu из %zu ожидаемых\n",
-         decompressed_position, *output_size);
+    if (bit_position > total_bits)
+    {
+      break;  // Код выходит за пределы входных данных
+    }
 
-  printf("[SHANNON] Первые 16 байт декомпрессированных данных: ");
-  for (Size i = 0; i < 16 && i < decompressed_position; i++)
-  {
-    printf("%02X ", decompressed_data[i]);
-  }
-  printf(" (");
-  for (Size i = 0; i < 16 && i < decompressed_position; i++)
-  {
-    printf("%c", isprint(decompressed_data[i]) ? decompressed_data[i] : '.');
+    Byte symbol = (Byte)entry->value;
+    decompressed_data[decompressed_position] = symbol;
+
+    if (decompressed_position < 10)
+    {
+      LOG_TRACE("[SHANNON] Декодирован символ %u (0x%02X '%c') на позиции %zu "
+                "(бит %zu)\n", symbol, symbol, isprint(symbol) ? symbol : '.',
+                decompressed_position, bit_position);
+    }
+
+    decompressed_position++;
   }
-  printf(")\n");
+
+  free(table.entries);
+
+  LOG_DEBUG("[SHANNON] Декомпрессия завершена\n");
+  LOG_DEBUG("[SHANNON] Декомпрессировано байт: %zu из %zu ожидаемых\n",
+            decompressed_position, *output_size);
+
+  LOG_DEBUG_DUMP("[SHANNON] Первые 16 байт декомпрессированных данных",
+                 decompressed_data, decompressed_position, 16);
 
   if (decompressed_position != *output_size)
   {
-    printf(
-      "[SHANNON] ВНИМАНИЕ: Размер не совпадает! Ожидалось: %zu, получено: "
-      "%zu\n",
-      *output_size, decompressed_position);
+    LOG_WARN("[SHANNON] ВНИМАНИЕ: Размер не совпадает! Ожидалось: %zu, "
+             "получено: " "%zu\n", *output_size, decompressed_position);
 
     if (decompressed_position == 0)
     {
-      printf(
-        "[SHANNON] КРИТИЧЕСКАЯ ОШИБКА: не декомпрессировано ни одного "
-        "байта!\n");
-      free(decompressed_data);
-      return RESULT_ERROR;
+      LOG_ERROR("[SHANNON] КРИТИЧЕСКАЯ ОШИБКА: не декомпрессировано ни одного "
+                "байта!\n");
+        return RESULT_ERROR;
     }
 
     *output_size = decompressed_position;
   }
 
-  *output = decompressed_data;
   return RESULT_OK;
 }
 
-static void serialize_node(const ShannonNode* node, Byte* buffer,
-                           Size* position, Size max_position)
+Result shannon_decompress(const Byte* input, Size input_size, Byte** output,
+                          Size* output_size, const ShannonTree* tree)
 {
-  if (!node || *position >= max_position)
+  if (!input || !output || !output_size || !tree || input_size == 0)
   {
-    return;
+    LOG_ERROR("[SHANNON] Ошибка: неверные параметры в shannon_decompress\n");
+    return RESULT_INVALID_ARGUMENT;
   }
 
-  if (!node->left && !node->right)
+  Byte* decompressed_data = malloc(*output_size > 0 ? *output_size : 1);
+  if (decompressed_data == NULL)
   {
-    if (*position + 2 + node->code_length > max_position)
-    {
-      return;
-    }
-
-    buffer[(*position)++] = 1;                  // Флаг листа
-    buffer[(*position)++] = node->symbol;       // Символ
-    buffer[(*position)++] = node->code_length;  // Длина кода
+    LOG_ERROR("[SHANNON] Ошибка выделения памяти для декомпрессированных "
+              "данных\n");
+    return RESULT_MEMORY_ERROR;
+  }
 
-    for (int i = 0; i < node->code_length && *position < max_position; i++)
-    {
-      buffer[(*position)++] = node->code[i];
-    }
+  Result result = shannon_decompress_into(input, input_size, decompressed_data,
+                                          output_size, tree);
+  if (result != RESULT_OK)
+  {
+    free(decompressed_data);
+    return result;
   }
+
+  *output = decompressed_data;
+  return RESULT_OK;
 }
 
+// Компактный формат: маркер SHANNON_TREE_FORMAT_LENGTHS, число символов
+// минус один и пары (символ, длина кода). Сами коды канонические и
+// восстанавливаются по длинам.
 Result shannon_serialize_tree(const ShannonTree* tree, Byte** data, Size* size)
 {
   if (!tree || !data || !size)
@@ -540,49 +798,111 @@ Result shannon_serialize_tree(const ShannonTree* tree, Byte** data, Size* size)
     return RESULT_INVALID_ARGUMENT;
   }
 
-  Size buffer_size = (Size)SHANNON_MAX_SYMBOLS * (3 + SHANNON_MAX_CODE_LENGTH);
+  Size symbol_count = 0;
+  for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
+  {
+    if (tree->code_lengths[i] > 0)
+    {
+      symbol_count++;
+    }
+  }
+
+  if (symbol_count == 0)
+  {
+    return RESULT_ERROR;
+  }
+
+  Size buffer_size = 2 + symbol_count * 2;
   Byte* buffer = malloc(buffer_size);
   if (!buffer)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
     return RESULT_MEMORY_ERROR;
   }
 
-  memset(buffer, 0, buffer_size);
   Size position = 0;
+  buffer[position++] = SHANNON_TREE_FORMAT_LENGTHS;
+  buffer[position++] = (Byte)(symbol_count - 1);
 
   for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
   {
-    if (tree->nodes[i])
+    if (tree->code_lengths[i] > 0)
     {
-      serialize_node(tree->nodes[i], buffer, &position, buffer_size);
+      buffer[position++] = (Byte)i;
+      buffer[position++] = tree->code_lengths[i];
     }
   }
 
-  if (position == 0)
+  *data = buffer;
+  *size = position;
+  return RESULT_OK;
+}
+
+static ShannonNode* create_leaf_node(ShannonTree* tree, Byte symbol,
+                                     Byte code_length, const Byte* code)
+{
+  ShannonNode* node = create_node(tree, symbol, 0);
+  if (!node)
+  {
+    return NULL;
+  }
+
+  node->code_length = code_length;
+  memcpy(node->code, code, code_length);
+
+  return node;
+}
+
+static Result deserialize_code_lengths(ShannonTree* tree, const Byte* data,
+                                       Size size, int* node_count)
+{
+  if (size < 2)
   {
-    free(buffer);
     return RESULT_ERROR;
   }
 
-  *data = malloc(position);
-  if (!*data)
+  Size symbol_count = (Size)data[1] + 1;
+  if (size < 2 + symbol_count * 2)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
+    LOG_ERROR("[SHANNON] Ошибка: таблица длин кодов обрезана\n");
+    return RESULT_ERROR;
+  }
 
-    free(buffer);
-    return RESULT_MEMORY_ERROR;
+  for (Size i = 0; i < symbol_count; i++)
+  {
+    Byte symbol = data[2 + i * 2];
+    Byte length = data[3 + i * 2];
+    if (length == 0 || length > SHANNON_MAX_CODE_LENGTH)
+    {
+      LOG_ERROR("[SHANNON] Ошибка: недопустимая длина кода %u\n", length);
+      return RESULT_ERROR;
+    }
+    tree->code_lengths[symbol] = length;
   }
 
-  memcpy(*data, buffer, position);
-  *size = position;
+  assign_canonical_codes(tree);
+
+  for (int i = 0; i < SHANNON_MAX_SYMBOLS; i++)
+  {
+    if (tree->code_lengths[i] == 0)
+    {
+      continue;
+    }
+
+    tree->nodes[i] =
+      create_leaf_node(tree, (Byte)i, tree->code_lengths[i], tree->codes[i]);
+    if (!tree->nodes[i])
+    {
+      return RESULT_MEMORY_ERROR;
+    }
+    (*node_count)++;
+  }
 
-  free(buffer);
   return RESULT_OK;
 }
 
-static ShannonNode* deserialize_node(const Byte* buffer, Size* position,
-                                     Size max_position)
+static ShannonNode* deserialize_node(ShannonTree* tree, const Byte* buffer,
+                                     Size* position, Size max_position)
 {
   if (*position + 3 > max_position)
   {
@@ -598,28 +918,15 @@ static ShannonNode* deserialize_node(const Byte* buffer, Size* position,
   Byte symbol = buffer[(*position)++];
   Byte code_length = buffer[(*position)++];
 
-  if (*position + code_length > max_position)
-  {
-    return NULL;
-  }
-
-  ShannonNode* node = malloc(sizeof(ShannonNode));
-  if (!node)
+  if (code_length > SHANNON_MAX_CODE_LENGTH ||
+      *position + code_length > max_position)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
     return NULL;
   }
 
-  node->symbol = symbol;
-  node->frequency = 0;
-  node->left = NULL;
-  node->right = NULL;
-  node->code_length = code_length;
-
-  for (int i = 0; i < code_length; i++)
-  {
-    node->code[i] = buffer[(*position)++];
-  }
+  ShannonNode* node =
+    create_leaf_node(tree, symbol, code_length, &buffer[*position]);
+  *position += code_length;
 
   return node;
 }
@@ -628,53 +935,52 @@ Result shannon_deserialize_tree(ShannonTree* tree, const Byte* data, Size size)
 {
   if (!tree || !data || size == 0)
   {
-    printf("[SHANNON] Ошибка: неверные параметры для десериализации дерева\n");
+    LOG_ERROR("[SHANNON] Ошибка: неверные параметры для десериализации "
+              "дерева\n");
     return RESULT_INVALID_ARGUMENT;
   }
 
-  printf("[SHANNON] Десериализация дерева размером %zu байт\n", size);
-  printf("[SHANNON] Первые 16 байт данных дерева: ");
-  for (Size i = 0; i < 16 && i < size; i++)
-  {
-    printf("%02X ", data[i]);
-  }
-  printf("\n");
+  LOG_DEBUG("[SHANNON] Десериализация дерева размером %zu байт\n", size);
+  LOG_DEBUG_DUMP("[SHANNON] Первые 16 байт данных дерева", data, size, 16);
 
-  memset((void*)tree->nodes, 0, sizeof(tree->nodes));
-  memset(tree->code_lengths, 0, sizeof(tree->code_lengths));
-  memset(tree->codes, 0, sizeof(tree->codes));
+  reset_tree(tree);
 
-  Size position = 0;
   int node_count = 0;
 
-  while (position < size)
+  if (data[0] == SHANNON_TREE_FORMAT_LENGTHS)
   {
-    ShannonNode* node = deserialize_node(data, &position, size);
-    if (!node)
+    Result result = deserialize_code_lengths(tree, data, size, &node_count);
+    if (result != RESULT_OK)
     {
-      break;
+      return result;
     }
+  }
+  else
+  {
+    // Старый формат: узлы с явными кодами
+    Size position = 0;
+    while (position < size)
+    {
+      ShannonNode* node = deserialize_node(tree, data, &position, size);
+      if (!node)
+      {
+        break;
+      }
 
-    tree->nodes[node->symbol] = node;
-    tree->code_lengths[node->symbol] = node->code_length;
-    memcpy(tree->codes[node->symbol], node->code, node->code_length);
-    node_count++;
+      tree->nodes[node->symbol] = node;
+      tree->code_lengths[node->symbol] = node->code_length;
+      memcpy(tree->codes[node->symbol], node->code, node->code_length);
+      node_count++;
+    }
   }
 
-  printf("[SHANNON] Дерево десериализовано, узлов: %d\n", node_count);
+  LOG_DEBUG("[SHANNON] Дерево десериализовано, узлов: %d\n", node_count);
 
-  tree->root = malloc(sizeof(ShannonNode));
+  tree->root = create_node(tree, 0, 0);
   if (!tree->root)
   {
-    printf("Произошла ошибка при выделении памяти!\n");
     return RESULT_MEMORY_ERROR;
   }
 
-  tree->root->symbol = 0;
-  tree->root->frequency = 0;
-  tree->root->left = NULL;
-  tree->root->right = NULL;
-  tree->root->code_length = 0;
-
   return RESULT_OK;
 }
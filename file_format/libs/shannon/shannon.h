@@ -1,6 +1,7 @@
 #ifndef SHANNON_SHANNON_H
 #define SHANNON_SHANNON_H
 
+#include "arena.h"
 #include "types.h"
 
 #define SHANNON_MAX_SYMBOLS 256
@@ -20,6 +21,7 @@ typedef struct
 {
   ShannonNode* root;
   ShannonNode* nodes[SHANNON_MAX_SYMBOLS];
+  Arena* arena;  // Узлы дерева, освобождаются одним вызовом
   Byte codes[SHANNON_MAX_SYMBOLS][SHANNON_MAX_CODE_LENGTH];
   Byte code_lengths[SHANNON_MAX_SYMBOLS];
 } ShannonTree;
@@ -27,6 +29,9 @@ typedef struct
 ShannonTree* shannon_tree_create(void);
 void shannon_tree_destroy(ShannonTree* tree);
 Result shannon_tree_build(ShannonTree* tree, const Byte* data, Size size);
+// Построение по готовой таблице частот SHANNON_MAX_SYMBOLS символов
+Result shannon_tree_build_from_frequencies(ShannonTree* tree,
+                                           const DWord* frequencies);
 
 Result shannon_compress(const Byte* input, Size input_size, Byte** output,
                         Size* output_size, const ShannonTree* tree);
@@ -34,6 +39,15 @@ Result shannon_compress(const Byte* input, Size input_size, Byte** output,
 Result shannon_decompress(const Byte* input, Size input_size, Byte** output,
                           Size* output_size, const ShannonTree* tree);
 
+// Варианты с буфером вызывающего кода, семантика как у lz77_*_into
+Size shannon_compress_bound(Size input_size);
+Result shannon_compress_into(const Byte* input, Size input_size, Byte* output,
+                             Size output_capacity, Size* output_size,
+                             const ShannonTree* tree);
+Result shannon_decompress_into(const Byte* input, Size input_size,
+                               Byte* output, Size* output_size,
+                               const ShannonTree* tree);
+
 Result shannon_serialize_tree(const ShannonTree* tree, Byte** data, Size* size);
 Result shannon_deserialize_tree(ShannonTree* tree, const Byte* data, Size size);
 
@@ -0,0 +1,363 @@
+#include "stats.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alloc_counters.h"
+#include "log.h"
+
+#define STATS_INITIAL_CAPACITY 64
+
+// Закрытый интервал; хранится для трассировки, сводки строятся по ним же
+typedef struct
+{
+  StatsStage stage;
+  char label[STATS_LABEL_LIMIT];
+  QWord start_ns;
+  QWord wall_ns;
+  QWord cpu_ns;
+  QWord bytes_in;
+  QWord bytes_out;
+  QWord allocations;
+  QWord allocated_bytes;
+  long thread_id;
+} StatsEvent;
+
+typedef struct
+{
+  char name[STATS_LABEL_LIMIT];
+  QWord value;
+} StatsCounter;
+
+struct Stats
+{
+  StatsEvent* events;
+  Size event_count;
+  Size event_capacity;
+  StatsCounter counters[STATS_COUNTER_LIMIT];
+  Size counter_count;
+  QWord origin_ns;
+  pthread_mutex_t lock;
+};
+
+static const char* stats_stage_names[] = {
+  "walk", "train", "compress", "decompress", "crc", "read", "write"};
+
+static QWord stats_clock_ns(clockid_t clock)
+{
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (QWord)now.tv_sec * 1000000000ULL + (QWord)now.tv_nsec;
+}
+
+Stats* stats_create(void)
+{
+  Stats* stats = (Stats*)malloc(sizeof(Stats));
+  if (stats == NULL)
+  {
+    LOG_ERROR("Произошла ошибка при выделении памяти!\n");
+    return NULL;
+  }
+
+  stats->events = NULL;
+  stats->event_count = 0;
+  stats->event_capacity = 0;
+  stats->counter_count = 0;
+  stats->origin_ns = stats_clock_ns(CLOCK_MONOTONIC);
+  pthread_mutex_init(&stats->lock, NULL);
+
+  return stats;
+}
+
+void stats_destroy(Stats* self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  pthread_mutex_destroy(&self->lock);
+  free(self->events);
+  free(self);
+}
+
+void stats_span_begin(Stats* self, StatsSpan* span, StatsStage stage,
+                      const char* label)
+{
+  if (span == NULL)
+  {
+    return;
+  }
+
+  span->active = false;
+  if (self == NULL)
+  {
+    return;
+  }
+
+  span->stage = stage;
+  snprintf(span->label, sizeof(span->label), "%s", label ? label : "");
+  AllocCounters allocations = alloc_counters_get();
+  span->allocations_start = allocations.allocations;
+  span->allocated_bytes_start = allocations.bytes;
+  span->cpu_start_ns = stats_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+  span->wall_start_ns = stats_clock_ns(CLOCK_MONOTONIC);
+  span->active = true;
+}
+
+void stats_span_end(Stats* self, StatsSpan* span, QWord bytes_in,
+                    QWord bytes_out)
+{
+  if (self == NULL || span == NULL || !span->active)
+  {
+    return;
+  }
+
+  QWord wall_end_ns = stats_clock_ns(CLOCK_MONOTONIC);
+  QWord cpu_end_ns = stats_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+  AllocCounters allocations = alloc_counters_get();
+  span->active = false;
+
+  pthread_mutex_lock(&self->lock);
+
+  if (self->event_count == self->event_capacity)
+  {
+    Size new_capacity = self->event_capacity ? self->event_capacity * 2
+                                             : STATS_INITIAL_CAPACITY;
+    StatsEvent* new_events = (StatsEvent*)realloc(
+      self->events, new_capacity * sizeof(StatsEvent));
+    if (new_events == NULL)
+    {
+      pthread_mutex_unlock(&self->lock);
+      LOG_WARN("Предупреждение: интервал статистики потерян (нет памяти)\n");
+      return;
+    }
+
+    self->events = new_events;
+    self->event_capacity = new_capacity;
+  }
+
+  StatsEvent* event = &self->events[self->event_count++];
+  event->stage = span->stage;
+  memcpy(event->label, span->label, sizeof(event->label));
+  event->start_ns = span->wall_start_ns - self->origin_ns;
+  event->wall_ns = wall_end_ns - span->wall_start_ns;
+  event->cpu_ns = cpu_end_ns - span->cpu_start_ns;
+  event->bytes_in = bytes_in;
+  event->bytes_out = bytes_out;
+  // Интервал открывается и закрывается в одном потоке
+  event->allocations = allocations.allocations - span->allocations_start;
+  event->allocated_bytes = allocations.bytes - span->allocated_bytes_start;
+  event->thread_id = (long)gettid();
+
+  pthread_mutex_unlock(&self->lock);
+}
+
+void stats_count(Stats* self, const char* name, QWord delta)
+{
+  if (self == NULL || name == NULL)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&self->lock);
+
+  Size i = 0;
+  while (i < self->counter_count &&
+         strncmp(self->counters[i].name, name, STATS_LABEL_LIMIT) != 0)
+  {
+    i++;
+  }
+
+  if (i == self->counter_count)
+  {
+    if (self->counter_count == STATS_COUNTER_LIMIT)
+    {
+      pthread_mutex_unlock(&self->lock);
+      LOG_WARN("Предупреждение: счетчик статистики %s потерян\n", name);
+      return;
+    }
+
+    snprintf(self->counters[i].name, STATS_LABEL_LIMIT, "%s", name);
+    self->counters[i].value = 0;
+    self->counter_count++;
+  }
+
+  self->counters[i].value += delta;
+  pthread_mutex_unlock(&self->lock);
+}
+
+QWord stats_get_counter(const Stats* self, const char* name)
+{
+  if (self == NULL || name == NULL)
+  {
+    return 0;
+  }
+
+  for (Size i = 0; i < self->counter_count; i++)
+  {
+    if (strncmp(self->counters[i].name, name, STATS_LABEL_LIMIT) == 0)
+    {
+      return self->counters[i].value;
+    }
+  }
+
+  return 0;
+}
+
+static void stats_accumulate(StatsTotals* totals, const StatsEvent* event)
+{
+  totals->calls++;
+  totals->wall_ns += event->wall_ns;
+  totals->cpu_ns += event->cpu_ns;
+  totals->bytes_in += event->bytes_in;
+  totals->bytes_out += event->bytes_out;
+  totals->allocations += event->allocations;
+  totals->allocated_bytes += event->allocated_bytes;
+}
+
+StatsTotals stats_get_totals(const Stats* self, StatsStage stage,
+                             const char* label)
+{
+  StatsTotals totals;
+  memset(&totals, 0, sizeof(totals));
+
+  if (self == NULL)
+  {
+    return totals;
+  }
+
+  for (Size i = 0; i < self->event_count; i++)
+  {
+    const StatsEvent* event = &self->events[i];
+    if (event->stage == stage &&
+        (label == NULL || strcmp(event->label, label) == 0))
+    {
+      stats_accumulate(&totals, event);
+    }
+  }
+
+  return totals;
+}
+
+const char* stats_stage_name(StatsStage stage)
+{
+  if ((int)stage < 0 || stage >= STATS_STAGE_COUNT)
+  {
+    return "unknown";
+  }
+
+  return stats_stage_names[stage];
+}
+
+// Первое событие с такой же парой этап + метка
+static bool stats_is_first_occurrence(const Stats* self, Size index)
+{
+  const StatsEvent* event = &self->events[index];
+  for (Size i = 0; i < index; i++)
+  {
+    if (self->events[i].stage == event->stage &&
+        strcmp(self->events[i].label, event->label) == 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Result stats_write_json(const Stats* self, FILE* stream)
+{
+  if (self == NULL || stream == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  QWord elapsed_ns = stats_clock_ns(CLOCK_MONOTONIC) - self->origin_ns;
+
+  fprintf(stream, "{\n");
+  fprintf(stream, "  \"wall_ms\": %.3f,\n", (double)elapsed_ns / 1e6);
+  fprintf(stream, "  \"stages\": [");
+
+  bool first = true;
+  for (Size i = 0; i < self->event_count; i++)
+  {
+    if (!stats_is_first_occurrence(self, i))
+    {
+      continue;
+    }
+
+    const StatsEvent* event = &self->events[i];
+    StatsTotals totals = stats_get_totals(self, event->stage, event->label);
+
+    fprintf(stream, "%s\n    {\"stage\": \"%s\", \"label\": \"%s\", ",
+            first ? "" : ",", stats_stage_name(event->stage), event->label);
+    fprintf(stream, "\"calls\": %u, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, ",
+            totals.calls, (double)totals.wall_ns / 1e6,
+            (double)totals.cpu_ns / 1e6);
+    fprintf(stream, "\"bytes_in\": %llu, \"bytes_out\": %llu, ",
+            (unsigned long long)totals.bytes_in,
+            (unsigned long long)totals.bytes_out);
+    fprintf(stream, "\"allocations\": %llu, \"allocated_bytes\": %llu}",
+            (unsigned long long)totals.allocations,
+            (unsigned long long)totals.allocated_bytes);
+    first = false;
+  }
+
+  fprintf(stream, "%s]", first ? "" : "\n  ");
+
+  if (self->counter_count > 0)
+  {
+    fprintf(stream, ",\n  \"counters\": {");
+    for (Size i = 0; i < self->counter_count; i++)
+    {
+      fprintf(stream, "%s\n    \"%s\": %llu", i > 0 ? "," : "",
+              self->counters[i].name,
+              (unsigned long long)self->counters[i].value);
+    }
+    fprintf(stream, "\n  }");
+  }
+
+  fprintf(stream, "\n}\n");
+
+  return ferror(stream) ? RESULT_IO_ERROR : RESULT_OK;
+}
+
+Result stats_write_trace(const Stats* self, FILE* stream)
+{
+  if (self == NULL || stream == NULL)
+  {
+    return RESULT_INVALID_ARGUMENT;
+  }
+
+  long process_id = (long)getpid();
+
+  fprintf(stream, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+  for (Size i = 0; i < self->event_count; i++)
+  {
+    const StatsEvent* event = &self->events[i];
+    const char* stage_name = stats_stage_name(event->stage);
+
+    fprintf(stream, "%s\n  {\"name\": \"%s%s%s\", \"cat\": \"%s\", ",
+            i > 0 ? "," : "", stage_name, event->label[0] ? ":" : "",
+            event->label, stage_name);
+    fprintf(stream, "\"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, ",
+            (double)event->start_ns / 1e3, (double)event->wall_ns / 1e3);
+    fprintf(stream, "\"pid\": %ld, \"tid\": %ld, ", process_id,
+            event->thread_id);
+    fprintf(stream,
+            "\"args\": {\"bytes_in\": %llu, \"bytes_out\": %llu, "
+            "\"cpu_us\": %.3f, \"allocations\": %llu}}",
+            (unsigned long long)event->bytes_in,
+            (unsigned long long)event->bytes_out, (double)event->cpu_ns / 1e3,
+            (unsigned long long)event->allocations);
+  }
+
+  fprintf(stream, "\n]}\n");
+
+  return ferror(stream) ? RESULT_IO_ERROR : RESULT_OK;
+}
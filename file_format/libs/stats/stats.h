@@ -0,0 +1,75 @@
+#ifndef STATS_STATS_H
+#define STATS_STATS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "types.h"
+
+#define STATS_LABEL_LIMIT 32
+#define STATS_COUNTER_LIMIT 32
+
+typedef enum
+{
+  STATS_STAGE_WALK,        // Обход директорий и чтение файлов
+  STATS_STAGE_TRAIN,       // Анализ данных и построение модели
+  STATS_STAGE_COMPRESS,    // Сжатие файла
+  STATS_STAGE_DECOMPRESS,  // Распаковка файла
+  STATS_STAGE_CRC,         // Расчет и проверка контрольных сумм
+  STATS_STAGE_READ,        // Чтение архива
+  STATS_STAGE_WRITE,       // Запись архива или извлеченных файлов
+  STATS_STAGE_COUNT
+} StatsStage;
+
+typedef struct Stats Stats;
+
+// Открытый интервал измерения. Хранится на стеке вызывающего кода
+typedef struct
+{
+  StatsStage stage;
+  char label[STATS_LABEL_LIMIT];
+  QWord wall_start_ns;
+  QWord cpu_start_ns;
+  QWord allocations_start;
+  QWord allocated_bytes_start;
+  bool active;
+} StatsSpan;
+
+// Сводка по этапу (или по паре этап + метка)
+typedef struct
+{
+  DWord calls;
+  QWord wall_ns;
+  QWord cpu_ns;
+  QWord bytes_in;
+  QWord bytes_out;
+  QWord allocations;      // Обращения арен и рабочих буферов к куче
+  QWord allocated_bytes;  // Запрошено у кучи этими обращениями
+} StatsTotals;
+
+Stats* stats_create(void);
+void stats_destroy(Stats* self);
+
+// При self == NULL оба вызова ничего не делают, поэтому код с
+// необязательной статистикой не требует дополнительных проверок.
+// Повторное завершение уже закрытого интервала игнорируется
+void stats_span_begin(Stats* self, StatsSpan* span, StatsStage stage,
+                      const char* label);
+void stats_span_end(Stats* self, StatsSpan* span, QWord bytes_in,
+                    QWord bytes_out);
+
+// Именованный счетчик событий без замера времени (попадания в кэш и т.п.).
+// Счетчики сверх STATS_COUNTER_LIMIT теряются с предупреждением
+void stats_count(Stats* self, const char* name, QWord delta);
+QWord stats_get_counter(const Stats* self, const char* name);
+
+// label == NULL суммирует все метки этапа
+StatsTotals stats_get_totals(const Stats* self, StatsStage stage,
+                             const char* label);
+const char* stats_stage_name(StatsStage stage);
+
+Result stats_write_json(const Stats* self, FILE* stream);
+// Формат Trace Event (chrome://tracing, Perfetto)
+Result stats_write_trace(const Stats* self, FILE* stream);
+
+#endif  // STATS_STATS_H
@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compressed_archive_builder.h"
+#include "compressed_archive_reader.h"
+#include "fixture.h"
+#include "log.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+// Исходные данные из двух символов, дописываются файлы со всеми 256
+#define SOURCE_SIZE 8000
+#define APPEND_SIZE (64 * 1024)
+
+static DWord random_state = 2463534242U;
+
+static void fill_random(Byte* data, Size size)
+{
+  for (Size i = 0; i < size; i++)
+  {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    data[i] = (Byte)random_state;
+  }
+}
+
+static bool create_sources(void)
+{
+  Byte source[SOURCE_SIZE];
+  for (Size i = 0; i < sizeof(source); i++)
+  {
+    source[i] = (Byte)((i / 4) % 2 == 0 ? 'a' : 'b');
+  }
+
+  // mixed: знакомые символы вперемешку с новыми
+  Byte* data = malloc(APPEND_SIZE);
+  if (data == NULL)
+  {
+    return false;
+  }
+  fill_random(data, APPEND_SIZE);
+  bool created = mkdir("src", 0755) == 0 && mkdir("add", 0755) == 0 &&
+                 fixture_write_file("src/ab", source, sizeof(source)) &&
+                 fixture_write_file("add/random", data, APPEND_SIZE);
+  for (Size i = 0; i < APPEND_SIZE; i += 3)
+  {
+    data[i] = 'a';
+  }
+  created = created && fixture_write_file("add/mixed", data, APPEND_SIZE);
+  fill_random(data, APPEND_SIZE);
+  created = created && fixture_write_file("add/second", data, APPEND_SIZE);
+  free(data);
+  return created;
+}
+
+static Result append_file(const char* path)
+{
+  CompressedArchiveBuilder* builder =
+    compressed_archive_builder_open_append("append.arc");
+  if (builder == NULL)
+  {
+    return RESULT_ERROR;
+  }
+
+  Result result = compressed_archive_builder_add_file(builder, path);
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_builder_finalize(builder);
+  }
+  compressed_archive_builder_destroy(builder);
+  return result;
+}
+
+// Все записи архива совпадают с исходными файлами
+static void check_archive(const char* name, DWord expected_count)
+{
+  CompressedArchiveReader* reader =
+    compressed_archive_reader_create("append.arc");
+  if (reader == NULL)
+  {
+    fprintf(stderr, "%s: архив не открывается\n", name);
+    test_failures++;
+    return;
+  }
+
+  DWord count = compressed_archive_reader_get_file_count(reader);
+  TEST_CHECK(count == expected_count);
+  for (DWord i = 0; i < count; i++)
+  {
+    const char* filename = compressed_archive_reader_get_filename(reader, i);
+    Byte* expected = NULL;
+    Byte* actual = NULL;
+    Size expected_size = 0;
+    Size actual_size = 0;
+    TEST_CHECK(compressed_archive_reader_extract_file(reader, i, "out") ==
+               RESULT_OK);
+    if (!fixture_load_file(filename, &expected, &expected_size) ||
+        !fixture_load_file("out", &actual, &actual_size) ||
+        actual_size != expected_size ||
+        memcmp(actual, expected, expected_size) != 0)
+    {
+      fprintf(stderr, "%s: %s извлечен неверно\n", name, filename);
+      test_failures++;
+    }
+    free(actual);
+    free(expected);
+  }
+
+  compressed_archive_reader_destroy(reader);
+}
+
+static QWord archive_size(void)
+{
+  struct stat status;
+  return stat("append.arc", &status) == 0 ? (QWord)status.st_size : 0;
+}
+
+// Модель архива знает только 'a' и 'b': дописанные байты, которых в ней не
+// было, все равно сжимаются, а повторная дозапись не портит прежнюю
+static void test_unseen_symbols(const FixtureArchive* archive)
+{
+  if (fixture_build_archive(archive, "append.arc", "src") != RESULT_OK)
+  {
+    fprintf(stderr, "%s: не удалось построить архив\n", archive->algorithm);
+    test_failures++;
+    return;
+  }
+
+  TEST_CHECK(append_file("add/random") == RESULT_OK);
+  check_archive(archive->algorithm, 2);
+  TEST_CHECK(append_file("add/mixed") == RESULT_OK);
+  check_archive(archive->algorithm, 3);
+  TEST_CHECK(append_file("add/second") == RESULT_OK);
+  check_archive(archive->algorithm, 4);
+}
+
+// Файл пропадает между добавлением и finalize: дозапись падает после того,
+// как первая новая запись уже записана, и архив возвращается к прежнему
+static void test_failed_append(void)
+{
+  const FixtureArchive archive = {"huffman", NULL, false, 0, 0};
+  Byte data[SOURCE_SIZE] = {0};
+  TEST_CHECK(fixture_build_archive(&archive, "append.arc", "src") ==
+             RESULT_OK);
+  TEST_CHECK(append_file("add/random") == RESULT_OK);
+  TEST_CHECK(fixture_write_file("gone", data, sizeof(data)));
+
+  QWord size = archive_size();
+  CompressedArchiveBuilder* builder =
+    compressed_archive_builder_open_append("append.arc");
+  TEST_CHECK(builder != NULL);
+  if (builder == NULL)
+  {
+    return;
+  }
+
+  TEST_CHECK(compressed_archive_builder_add_file(builder, "add/mixed") ==
+             RESULT_OK);
+  TEST_CHECK(compressed_archive_builder_add_file(builder, "gone") ==
+             RESULT_OK);
+  TEST_CHECK(unlink("gone") == 0);
+  TEST_CHECK(compressed_archive_builder_finalize(builder) != RESULT_OK);
+  compressed_archive_builder_destroy(builder);
+
+  TEST_CHECK(archive_size() == size);
+  check_archive("failed", 2);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  char directory[256];
+  if (!fixture_enter("append_test", directory, sizeof(directory)))
+  {
+    fprintf(stderr, "Не удалось подготовить рабочий каталог\n");
+    return 1;
+  }
+  TEST_CHECK(create_sources());
+
+  const FixtureArchive archives[] = {
+    {"huffman", NULL, false, 0, 0},
+    {"shannon", NULL, false, 0, 0},
+    {"arithmetic", NULL, false, 0, 0},
+    {"lzh", NULL, false, 0, 0},
+    {"huffman", "lz77", false, 0, 0},
+  };
+  for (Size i = 0; i < sizeof(archives) / sizeof(archives[0]); i++)
+  {
+    test_unseen_symbols(&archives[i]);
+  }
+  test_failed_append();
+
+  fixture_leave(directory);
+  return TEST_EXIT();
+}
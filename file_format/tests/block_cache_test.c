@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "block_cache.h"
+#include "log.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+#define BLOCK_SIZE 1024
+
+static Byte block_data[4 * BLOCK_SIZE];
+
+static bool is_cached(BlockCache* cache, DWord entry, DWord block)
+{
+  Byte byte;
+  return block_cache_read(cache, entry, block, 0, 1, &byte);
+}
+
+static DWord insert(BlockCache* cache, DWord entry, DWord block, Size size)
+{
+  DWord evicted = 0;
+  TEST_CHECK(block_cache_insert(cache, entry, block, block_data, size,
+                                &evicted) == RESULT_OK);
+  return evicted;
+}
+
+// Вытесняется блок, к которому дольше всего не обращались, а не самый
+// старый по вставке
+static void test_lru_order(void)
+{
+  BlockCache* cache = block_cache_create(4 * BLOCK_SIZE);
+  TEST_CHECK(cache != NULL);
+
+  for (DWord block = 0; block < 4; block++)
+  {
+    TEST_CHECK(insert(cache, 1, block, BLOCK_SIZE) == 0);
+  }
+  TEST_CHECK(is_cached(cache, 1, 0));
+
+  TEST_CHECK(insert(cache, 1, 4, BLOCK_SIZE) == 1);
+  TEST_CHECK(is_cached(cache, 1, 0));
+  TEST_CHECK(!is_cached(cache, 1, 1));
+
+  // Блок двойного размера вытесняет два самых давних
+  TEST_CHECK(insert(cache, 2, 0, 2 * BLOCK_SIZE) == 2);
+  TEST_CHECK(!is_cached(cache, 1, 2));
+  TEST_CHECK(!is_cached(cache, 1, 3));
+  TEST_CHECK(is_cached(cache, 1, 0));
+  TEST_CHECK(is_cached(cache, 1, 4));
+  TEST_CHECK(is_cached(cache, 2, 0));
+
+  // Блок больше предела не кэшируется и ничего не вытесняет
+  TEST_CHECK(insert(cache, 3, 0, 4 * BLOCK_SIZE + 1) == 0);
+  TEST_CHECK(!is_cached(cache, 3, 0));
+  TEST_CHECK(is_cached(cache, 1, 0));
+  TEST_CHECK(is_cached(cache, 2, 0));
+
+  // Повторная вставка того же ключа ничего не меняет
+  TEST_CHECK(insert(cache, 1, 0, BLOCK_SIZE) == 0);
+  TEST_CHECK(is_cached(cache, 1, 4));
+
+  block_cache_destroy(cache);
+}
+
+static void test_partial_reads(void)
+{
+  BlockCache* cache = block_cache_create(4 * BLOCK_SIZE);
+  TEST_CHECK(cache != NULL);
+  insert(cache, 7, 3, BLOCK_SIZE);
+
+  Byte buffer[BLOCK_SIZE];
+  TEST_CHECK(block_cache_read(cache, 7, 3, 1000, 24, buffer));
+  TEST_CHECK(memcmp(buffer, block_data + 1000, 24) == 0);
+  TEST_CHECK(block_cache_read(cache, 7, 3, BLOCK_SIZE, 0, buffer));
+  TEST_CHECK(!block_cache_read(cache, 7, 3, 1000, 25, buffer));
+  TEST_CHECK(!block_cache_read(cache, 7, 3, BLOCK_SIZE + 1, 0, buffer));
+  TEST_CHECK(!block_cache_read(cache, 3, 7, 0, 1, buffer));
+
+  block_cache_destroy(cache);
+}
+
+// Много мелких блоков при малом пределе: таблица растет, а в кэше
+// остаются только последние вставленные
+static void test_many_small_blocks(void)
+{
+  const DWord capacity = 100;
+  const DWord total = 1000;
+  BlockCache* cache = block_cache_create(capacity * 64);
+  TEST_CHECK(cache != NULL);
+
+  DWord evicted = 0;
+  for (DWord block = 0; block < total; block++)
+  {
+    evicted += insert(cache, block % 3, block, 64);
+  }
+  TEST_CHECK(evicted == total - capacity);
+
+  DWord cached = 0;
+  for (DWord block = 0; block < total; block++)
+  {
+    bool present = is_cached(cache, block % 3, block);
+    TEST_CHECK(present == (block >= total - capacity));
+    cached += present ? 1 : 0;
+  }
+  TEST_CHECK(cached == capacity);
+
+  block_cache_destroy(cache);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  for (Size i = 0; i < sizeof(block_data); i++)
+  {
+    block_data[i] = (Byte)(i * 31 + i / 256);
+  }
+
+  test_lru_order();
+  test_partial_reads();
+  test_many_small_blocks();
+  return TEST_EXIT();
+}
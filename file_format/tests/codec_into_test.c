@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arithmetic.h"
+#include "log.h"
+#include "lz77.h"
+#include "lzh.h"
+#include "rle.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+#define SAMPLE_SIZE (64 * 1024)
+
+typedef struct
+{
+  const char* name;
+  const Byte* data;
+  Size size;
+} Sample;
+
+// Текст с повторами, все 256 значений байта и псевдослучайный шум
+static void fill_samples(Byte* text, Byte* alphabet, Byte* noise)
+{
+  const char* words = "archive block volume extent dictionary window ";
+  Size words_size = strlen(words);
+  for (Size i = 0; i < SAMPLE_SIZE; i++)
+  {
+    text[i] = (Byte)words[(i * 7 / 5) % words_size];
+    alphabet[i] = (Byte)(i * 131);
+  }
+
+  DWord state = 2463534242U;
+  for (Size i = 0; i < SAMPLE_SIZE; i++)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    noise[i] = (Byte)state;
+  }
+}
+
+static void check_decoded(const char* codec, const Sample* sample,
+                          const Byte* decoded, Size decoded_size)
+{
+  if (decoded_size != sample->size ||
+      memcmp(decoded, sample->data, sample->size) != 0)
+  {
+    fprintf(stderr, "%s/%s: данные после распаковки не совпадают\n", codec,
+            sample->name);
+    test_failures++;
+  }
+}
+
+static void test_arithmetic(const Sample* sample)
+{
+  ArithmeticModel* model = arithmetic_model_create();
+  Size capacity = arithmetic_compress_bound(sample->size);
+  Byte* compressed = malloc(capacity);
+  Byte* decoded = malloc(sample->size);
+  TEST_CHECK(model != NULL && compressed != NULL && decoded != NULL);
+
+  Size compressed_size = 0;
+  TEST_CHECK(arithmetic_model_build(model, sample->data, sample->size) ==
+             RESULT_OK);
+  TEST_CHECK(arithmetic_compress_into(sample->data, sample->size, compressed,
+                                      capacity, &compressed_size,
+                                      model) == RESULT_OK);
+
+  Size decoded_size = sample->size;
+  TEST_CHECK(arithmetic_decompress_into(compressed, compressed_size, decoded,
+                                        &decoded_size, model) == RESULT_OK);
+  check_decoded("arithmetic", sample, decoded, decoded_size);
+
+  // Буфер меньше результата - ошибка, а не запись за его границу
+  if (compressed_size > 1)
+  {
+    Size small_size = 0;
+    TEST_CHECK(arithmetic_compress_into(sample->data, sample->size, compressed,
+                                        compressed_size - 1, &small_size,
+                                        model) != RESULT_OK);
+  }
+
+  free(decoded);
+  free(compressed);
+  arithmetic_model_destroy(model);
+}
+
+static void test_lz77(const Sample* sample)
+{
+  Byte prefix = lz77_analyze_prefix(sample->data, sample->size);
+  Size capacity = lz77_compress_bound(sample->size);
+  Byte* compressed = malloc(capacity);
+  Byte* decoded = malloc(sample->size);
+  TEST_CHECK(compressed != NULL && decoded != NULL);
+
+  Size compressed_size = 0;
+  TEST_CHECK(lz77_compress_into(sample->data, sample->size, compressed,
+                                capacity, &compressed_size,
+                                prefix) == RESULT_OK);
+
+  Size decoded_size = sample->size;
+  TEST_CHECK(lz77_decompress_into(compressed, compressed_size, decoded,
+                                  &decoded_size, prefix) == RESULT_OK);
+  check_decoded("lz77", sample, decoded, decoded_size);
+
+  free(decoded);
+  free(compressed);
+}
+
+static void test_lzh(const Sample* sample, Byte level)
+{
+  Size capacity = lzh_compress_bound(sample->size);
+  Byte* compressed = malloc(capacity);
+  Byte* decoded = malloc(sample->size);
+  TEST_CHECK(compressed != NULL && decoded != NULL);
+
+  Size compressed_size = 0;
+  TEST_CHECK(lzh_compress_into(sample->data, sample->size, compressed,
+                               capacity, &compressed_size,
+                               level) == RESULT_OK);
+
+  Size decoded_size = sample->size;
+  TEST_CHECK(lzh_decompress_into(compressed, compressed_size, decoded,
+                                 &decoded_size) == RESULT_OK);
+  check_decoded("lzh", sample, decoded, decoded_size);
+
+  free(decoded);
+  free(compressed);
+}
+
+// Поврежденные потоки varint: длины с переполнением суммы, блок за концом
+// входа и поток короче ожидаемого - ошибка, а не запись за буфер
+static void test_rle_varint_corrupt(void)
+{
+  RLEContext context = {0, RLE_FORMAT_VARINT};
+  Byte output[64];
+
+  // Серии по 2^63 - 1, 2^63 - 1 и 7 байт: сумма длин переполняет Size и
+  // без проверки превращается в 5
+  Byte huge_runs[24];
+  for (Size run = 0; run < 2; run++)
+  {
+    memset(huge_runs + run * 11, 0xFF, 9);
+    huge_runs[run * 11 + 9] = 0x01;
+    huge_runs[run * 11 + 10] = (Byte)('a' + run);
+  }
+  huge_runs[22] = (7 << 1) | 1;
+  huge_runs[23] = 'c';
+  Byte* decoded = NULL;
+  Size decoded_size = 0;
+  TEST_CHECK(rle_decompress(huge_runs, sizeof(huge_runs), &decoded,
+                            &decoded_size, &context) != RESULT_OK);
+  free(decoded);
+
+  // Литеральный участок из 10 байт, от которого во входе только 3
+  const Byte cut_literal[] = {10 << 1, 'a', 'b', 'c'};
+  Size output_size = sizeof(output);
+  TEST_CHECK(rle_decompress_into(cut_literal, sizeof(cut_literal), output,
+                                 &output_size, &context) != RESULT_OK);
+
+  // Серия из 5 байт при ожидаемых 8
+  const Byte short_run[] = {(5 << 1) | 1, 'x'};
+  output_size = 8;
+  TEST_CHECK(rle_decompress_into(short_run, sizeof(short_run), output,
+                                 &output_size, &context) != RESULT_OK);
+  output_size = 5;
+  TEST_CHECK(rle_decompress_into(short_run, sizeof(short_run), output,
+                                 &output_size, &context) == RESULT_OK);
+  TEST_CHECK(output_size == 5 && memcmp(output, "xxxxx", 5) == 0);
+}
+
+static void test_rle_varint(const Sample* sample)
+{
+  RLEContext context = {0, RLE_FORMAT_VARINT};
+  Size capacity = rle_compress_bound(sample->size);
+  Byte* compressed = malloc(capacity);
+  Byte* decoded = malloc(sample->size);
+  TEST_CHECK(compressed != NULL && decoded != NULL);
+
+  Size compressed_size = 0;
+  TEST_CHECK(rle_compress_into(sample->data, sample->size, compressed,
+                               capacity, &compressed_size,
+                               &context) == RESULT_OK);
+
+  Size decoded_size = sample->size;
+  TEST_CHECK(rle_decompress_into(compressed, compressed_size, decoded,
+                                 &decoded_size, &context) == RESULT_OK);
+  check_decoded("rle-varint", sample, decoded, decoded_size);
+
+  free(decoded);
+  free(compressed);
+}
+
+int main(void)
+{
+  // Ожидаемые ошибки (переполнение буфера) не засоряют вывод теста
+  log_set_level(LOG_LEVEL_OFF);
+
+  Byte* text = malloc(SAMPLE_SIZE);
+  Byte* alphabet = malloc(SAMPLE_SIZE);
+  Byte* noise = malloc(SAMPLE_SIZE);
+  if (text == NULL || alphabet == NULL || noise == NULL)
+  {
+    return 1;
+  }
+  fill_samples(text, alphabet, noise);
+
+  const Sample samples[] = {
+    {"text", text, SAMPLE_SIZE},
+    {"alphabet", alphabet, SAMPLE_SIZE},
+    {"noise", noise, SAMPLE_SIZE},
+    {"one-byte", text, 1},
+  };
+
+  for (Size i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+  {
+    test_arithmetic(&samples[i]);
+    test_lz77(&samples[i]);
+    test_lzh(&samples[i], LZH_LEVEL_MIN);
+    test_lzh(&samples[i], LZH_LEVEL_MAX);
+    test_rle_varint(&samples[i]);
+  }
+  test_rle_varint_corrupt();
+
+  free(noise);
+  free(alphabet);
+  free(text);
+  return TEST_EXIT();
+}
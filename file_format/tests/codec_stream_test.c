@@ -0,0 +1,214 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codec.h"
+#include "log.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+// Маленькие блоки, чтобы кадров было много, и куски ввода/вывода не
+// кратные блоку
+#define BLOCK_SIZE 2048
+#define DATA_SIZE (48 * 1024)
+#define CHUNK_SIZE 1000
+#define OUTPUT_CHUNK_SIZE 777
+
+typedef struct
+{
+  Byte* data;
+  Size size;
+  Size capacity;
+} Buffer;
+
+static bool buffer_append(Buffer* buffer, const Byte* data, Size size)
+{
+  if (buffer->size + size > buffer->capacity)
+  {
+    Size capacity = (buffer->size + size) * 2;
+    Byte* grown = realloc(buffer->data, capacity);
+    if (grown == NULL)
+    {
+      return false;
+    }
+    buffer->data = grown;
+    buffer->capacity = capacity;
+  }
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+  return true;
+}
+
+// Прогоняет input через поток кусками по CHUNK_SIZE с выходом по
+// OUTPUT_CHUNK_SIZE байт
+static Result run_stream(const Codec* codec, CodecDirection direction,
+                         const Byte* input, Size input_size, Buffer* output)
+{
+  CodecStream* stream = codec_stream_create(codec, direction, BLOCK_SIZE);
+  if (stream == NULL)
+  {
+    return RESULT_MEMORY_ERROR;
+  }
+
+  Byte chunk[OUTPUT_CHUNK_SIZE];
+  Result result = codec_stream_begin(stream);
+  Size position = 0;
+  while (result == RESULT_OK && position < input_size)
+  {
+    Size size = input_size - position;
+    size = size < CHUNK_SIZE ? size : CHUNK_SIZE;
+    Size consumed = 0;
+    Size produced = 0;
+    result = codec_stream_process(stream, input + position, size, &consumed,
+                                  chunk, sizeof(chunk), &produced);
+    position += consumed;
+    if (result == RESULT_OK && !buffer_append(output, chunk, produced))
+    {
+      result = RESULT_MEMORY_ERROR;
+    }
+  }
+
+  bool finished = false;
+  while (result == RESULT_OK && !finished)
+  {
+    Size produced = 0;
+    result =
+      codec_stream_end(stream, chunk, sizeof(chunk), &produced, &finished);
+    if (result == RESULT_OK && !buffer_append(output, chunk, produced))
+    {
+      result = RESULT_MEMORY_ERROR;
+    }
+  }
+
+  codec_stream_destroy(stream);
+  return result;
+}
+
+// Кусок случайных байт, повторенный со сдвигом, и текст с перекошенным
+// распределением байт: повторы видны только через окно прошлых блоков,
+// а модель блока в 2 КиБ дорога по сравнению с данными
+static void fill_data(Byte* data)
+{
+  DWord state = 2463534242U;
+  Byte pattern[3000];
+  for (Size i = 0; i < sizeof(pattern); i++)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    pattern[i] = (Byte)state;
+  }
+
+  const char* words = "stream frame window history model ";
+  Size words_size = strlen(words);
+  for (Size i = 0; i < DATA_SIZE; i++)
+  {
+    data[i] = i < DATA_SIZE / 2 ? pattern[i % sizeof(pattern)]
+                                : (Byte)words[(i * 7 / 5) % words_size];
+  }
+}
+
+static void test_round_trip(const Codec* codec, const Byte* data)
+{
+  Buffer encoded = {NULL, 0, 0};
+  Buffer decoded = {NULL, 0, 0};
+  TEST_CHECK(run_stream(codec, CODEC_DIRECTION_ENCODE, data, DATA_SIZE,
+                        &encoded) == RESULT_OK);
+  TEST_CHECK(run_stream(codec, CODEC_DIRECTION_DECODE, encoded.data,
+                        encoded.size, &decoded) == RESULT_OK);
+  if (decoded.size != DATA_SIZE ||
+      memcmp(decoded.data, data, DATA_SIZE) != 0)
+  {
+    fprintf(stderr, "%s: данные после распаковки не совпадают\n",
+            codec->name);
+    test_failures++;
+  }
+
+  // Те же блоки, сжатые каждый в своем потоке, без истории
+  Size independent_size = 0;
+  for (Size offset = 0; offset < DATA_SIZE; offset += BLOCK_SIZE)
+  {
+    Buffer block = {NULL, 0, 0};
+    TEST_CHECK(run_stream(codec, CODEC_DIRECTION_ENCODE, data + offset,
+                          BLOCK_SIZE, &block) == RESULT_OK);
+    independent_size += block.size;
+    free(block.data);
+  }
+
+  // Кодеки с историей выигрывают у независимых блоков, остальные не
+  // проигрывают
+  bool stateful = strcmp(codec->name, "none") != 0 &&
+                  strncmp(codec->name, "rle", 3) != 0 &&
+                  strcmp(codec->name, "lz78") != 0;
+  Size terminators = (DATA_SIZE / BLOCK_SIZE - 1) * CODEC_FRAME_HEADER_SIZE;
+  if (stateful ? encoded.size >= independent_size - terminators
+               : encoded.size != independent_size - terminators)
+  {
+    fprintf(stderr, "%s: поток %zu байт, независимые блоки %zu байт\n",
+            codec->name, encoded.size, independent_size);
+    test_failures++;
+  }
+
+  free(decoded.data);
+  free(encoded.data);
+}
+
+// Кадр с моделью истории в начале потока - ошибка, а не чтение пустой
+// истории. Второй блок текста сжимается моделью истории (model_size == 0)
+static void test_history_frame_first(const Byte* data)
+{
+  const Codec* codec = codec_find("huffman");
+  const Byte* text = data + DATA_SIZE - 2 * BLOCK_SIZE;
+  Buffer encoded = {NULL, 0, 0};
+  TEST_CHECK(codec != NULL &&
+             run_stream(codec, CODEC_DIRECTION_ENCODE, text, 2 * BLOCK_SIZE,
+                        &encoded) == RESULT_OK);
+
+  // Размер первого кадра - из поля packed_size его заголовка
+  Size first_size = 0;
+  if (encoded.size >= CODEC_FRAME_HEADER_SIZE)
+  {
+    first_size = CODEC_FRAME_HEADER_SIZE + encoded.data[4] +
+                 ((Size)encoded.data[5] << 8);
+  }
+  if (first_size == 0 ||
+      first_size + CODEC_FRAME_HEADER_SIZE + 4 > encoded.size)
+  {
+    TEST_CHECK(false);
+    free(encoded.data);
+    return;
+  }
+
+  Byte* second = encoded.data + first_size;
+  TEST_CHECK(memcmp(second + CODEC_FRAME_HEADER_SIZE, "\0\0\0\0", 4) == 0);
+
+  Buffer decoded = {NULL, 0, 0};
+  TEST_CHECK(run_stream(codec, CODEC_DIRECTION_DECODE, second,
+                        encoded.size - first_size, &decoded) != RESULT_OK);
+
+  free(decoded.data);
+  free(encoded.data);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  Byte* data = malloc(DATA_SIZE);
+  if (data == NULL)
+  {
+    return 1;
+  }
+  fill_data(data);
+
+  for (Size i = 0; i < codec_count(); i++)
+  {
+    test_round_trip(codec_get(i), data);
+  }
+  test_history_frame_first(data);
+
+  free(data);
+  return TEST_EXIT();
+}
@@ -0,0 +1,269 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "compressed_archive_reader.h"
+#include "fixture.h"
+#include "log.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+#define BASE_SIZE (192 * 1024)
+#define PREFIX_SIZE (40 * 1024 + 11)
+#define SOURCE_COUNT 4
+
+static DWord random_state = 2463534242U;
+
+static DWord next_random(void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+static void fill_random(Byte* data, Size size)
+{
+  for (Size i = 0; i < size; i++)
+  {
+    data[i] = (Byte)next_random();
+  }
+}
+
+// base - уникальные данные; copy повторяет base целиком, twice - дважды
+// (вторая половина ссылается на первую), prefixed - base после новых данных
+static bool create_sources(Byte* base)
+{
+  Byte* twice = malloc(2 * BASE_SIZE);
+  Byte* prefixed = malloc(PREFIX_SIZE + BASE_SIZE);
+  if (twice == NULL || prefixed == NULL)
+  {
+    free(prefixed);
+    free(twice);
+    return false;
+  }
+
+  fill_random(base, BASE_SIZE);
+  memcpy(twice, base, BASE_SIZE);
+  memcpy(twice + BASE_SIZE, base, BASE_SIZE);
+  fill_random(prefixed, PREFIX_SIZE);
+  memcpy(prefixed + PREFIX_SIZE, base, BASE_SIZE);
+
+  bool created =
+    mkdir("src", 0755) == 0 &&
+    fixture_write_file("src/base", base, BASE_SIZE) &&
+    fixture_write_file("src/copy", base, BASE_SIZE) &&
+    fixture_write_file("src/twice", twice, 2 * BASE_SIZE) &&
+    fixture_write_file("src/prefixed", prefixed, PREFIX_SIZE + BASE_SIZE);
+  free(prefixed);
+  free(twice);
+  return created;
+}
+
+static void check_entry(CompressedArchiveReader* reader, DWord index)
+{
+  const char* filename = compressed_archive_reader_get_filename(reader, index);
+  Byte* expected = NULL;
+  Size expected_size = 0;
+  if (!fixture_load_file(filename, &expected, &expected_size))
+  {
+    fprintf(stderr, "%s: не удалось прочитать исходный файл\n", filename);
+    test_failures++;
+    return;
+  }
+
+  Byte* actual = NULL;
+  Size actual_size = 0;
+  TEST_CHECK(compressed_archive_reader_get_file_size(reader, index) ==
+             expected_size);
+  TEST_CHECK(compressed_archive_reader_extract_file(reader, index, "out") ==
+             RESULT_OK);
+  if (!fixture_load_file("out", &actual, &actual_size) ||
+      actual_size != expected_size ||
+      memcmp(actual, expected, expected_size) != 0)
+  {
+    fprintf(stderr, "%s: извлеченные данные не совпадают\n", filename);
+    test_failures++;
+  }
+
+  // Диапазон поперек границы повтора внутри twice и в середине файла
+  Byte range[4096];
+  QWord offset = expected_size / 2 - sizeof(range) / 2;
+  TEST_CHECK(compressed_archive_reader_read_range(reader, index, offset,
+                                                  sizeof(range),
+                                                  range) == RESULT_OK);
+  TEST_CHECK(memcmp(range, expected + offset, sizeof(range)) == 0);
+
+  free(actual);
+  free(expected);
+}
+
+static void test_round_trip(const FixtureArchive* archive)
+{
+  if (fixture_build_archive(archive, "dedup.arc", "src") != RESULT_OK)
+  {
+    fprintf(stderr, "%s: не удалось построить архив\n", archive->algorithm);
+    test_failures++;
+    return;
+  }
+
+  // Повторы хранятся один раз: в архиве base и новый префикс
+  struct stat status;
+  TEST_CHECK(stat("dedup.arc", &status) == 0);
+  TEST_CHECK(status.st_size < 2 * BASE_SIZE);
+
+  CompressedArchiveReader* reader =
+    compressed_archive_reader_create("dedup.arc");
+  TEST_CHECK(reader != NULL);
+  if (reader == NULL)
+  {
+    return;
+  }
+
+  DWord count = compressed_archive_reader_get_file_count(reader);
+  TEST_CHECK(count == SOURCE_COUNT);
+  for (DWord i = 0; i < count; i++)
+  {
+    check_entry(reader, i);
+  }
+
+  compressed_archive_reader_destroy(reader);
+}
+
+// Карта copy: размер BASE_SIZE и единственный участок - весь base
+static Byte* find_copy_map(Byte* archive, Size size)
+{
+  Byte pattern[sizeof(QWord) + sizeof(DWord)];
+  QWord data_size = BASE_SIZE;
+  DWord run_count = 1;
+  memcpy(pattern, &data_size, sizeof(QWord));
+  memcpy(pattern + sizeof(QWord), &run_count, sizeof(DWord));
+
+  Size map_size = sizeof(DWord) + sizeof(pattern) + sizeof(DWord) +
+                  2 * sizeof(QWord);
+  for (Size i = sizeof(DWord); i + map_size <= size; i++)
+  {
+    QWord run_offset = 0;
+    QWord run_length = 0;
+    Byte* run = archive + i + sizeof(pattern) + sizeof(DWord);
+    memcpy(&run_offset, run, sizeof(QWord));
+    memcpy(&run_length, run + sizeof(QWord), sizeof(QWord));
+    if (memcmp(archive + i, pattern, sizeof(pattern)) == 0 &&
+        run_offset == 0 && run_length == BASE_SIZE)
+    {
+      return archive + i - sizeof(DWord);
+    }
+  }
+  return NULL;
+}
+
+typedef enum
+{
+  CORRUPT_ENTRY_INDEX,
+  CORRUPT_RUN_COUNT,
+  CORRUPT_SOURCE_INDEX,
+  CORRUPT_RUN_LENGTH,
+  CORRUPT_DATA_SIZE,
+} Corruption;
+
+// Смещения полей карты: DWord запись, QWord размер, DWord число участков,
+// затем участок (DWord источник, QWord смещение, QWord длина)
+static void corrupt_map(Byte* map, Corruption corruption)
+{
+  DWord word = 0;
+  QWord value = 0;
+  switch (corruption)
+  {
+    case CORRUPT_ENTRY_INDEX:
+      word = 1000;
+      memcpy(map, &word, sizeof(word));
+      break;
+    case CORRUPT_RUN_COUNT:
+      memcpy(map + 12, &word, sizeof(word));
+      break;
+    case CORRUPT_SOURCE_INDEX:
+      word = SOURCE_COUNT;
+      memcpy(map + 16, &word, sizeof(word));
+      break;
+    case CORRUPT_RUN_LENGTH:
+      value = BASE_SIZE + 1;
+      memcpy(map + 28, &value, sizeof(value));
+      break;
+    case CORRUPT_DATA_SIZE:
+      value = BASE_SIZE - 1;
+      memcpy(map + 4, &value, sizeof(value));
+      break;
+  }
+}
+
+static void test_corrupt_maps(void)
+{
+  const FixtureArchive archive = {"none", NULL, true, 0, 0};
+  Byte* original = NULL;
+  Size size = 0;
+  if (fixture_build_archive(&archive, "dedup.arc", "src") != RESULT_OK ||
+      !fixture_load_file("dedup.arc", &original, &size))
+  {
+    TEST_CHECK(false);
+    free(original);
+    return;
+  }
+
+  Byte* map = find_copy_map(original, size);
+  Byte* copy = malloc(size);
+  TEST_CHECK(map != NULL && copy != NULL);
+  for (int corruption = CORRUPT_ENTRY_INDEX;
+       map != NULL && copy != NULL && corruption <= CORRUPT_DATA_SIZE;
+       corruption++)
+  {
+    memcpy(copy, original, size);
+    corrupt_map(copy + (map - original), (Corruption)corruption);
+    TEST_CHECK(fixture_write_file("corrupt.arc", copy, size));
+
+    CompressedArchiveReader* reader =
+      compressed_archive_reader_create("corrupt.arc");
+    if (reader != NULL)
+    {
+      fprintf(stderr, "Повреждение %d: архив открыт\n", corruption);
+      test_failures++;
+      compressed_archive_reader_destroy(reader);
+    }
+  }
+
+  free(copy);
+  free(original);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  char directory[256];
+  Byte* base = malloc(BASE_SIZE);
+  if (base == NULL ||
+      !fixture_enter("dedup_test", directory, sizeof(directory)))
+  {
+    fprintf(stderr, "Не удалось подготовить рабочий каталог\n");
+    return 1;
+  }
+  TEST_CHECK(create_sources(base));
+
+  const FixtureArchive archives[] = {
+    {"none", NULL, true, 0, 0},
+    {"lzh", NULL, true, 0, 0},
+    {"huffman", "lz77", true, 0, 0},
+  };
+  for (Size i = 0; i < sizeof(archives) / sizeof(archives[0]); i++)
+  {
+    test_round_trip(&archives[i]);
+  }
+  test_corrupt_maps();
+
+  fixture_leave(directory);
+  free(base);
+  return TEST_EXIT();
+}
@@ -0,0 +1,109 @@
+#include "fixture.h"
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compressed_archive_builder.h"
+
+bool fixture_enter(const char* name, char* directory, Size directory_size)
+{
+  const char* tmp = getenv("TMPDIR");
+  snprintf(directory, directory_size, "%s/%s.XXXXXX",
+           tmp != NULL ? tmp : "/tmp", name);
+  return mkdtemp(directory) != NULL && chdir(directory) == 0;
+}
+
+static int remove_path(const char* path, const struct stat* status, int flag,
+                       struct FTW* walk)
+{
+  (void)status;
+  (void)flag;
+  (void)walk;
+  return remove(path);
+}
+
+void fixture_leave(const char* directory)
+{
+  if (chdir("/") == 0)
+  {
+    nftw(directory, remove_path, 16, FTW_DEPTH | FTW_PHYS);
+  }
+}
+
+bool fixture_write_file(const char* path, const Byte* data, Size size)
+{
+  FILE* file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    return false;
+  }
+  bool written = fwrite(data, 1, size, file) == size;
+  return fclose(file) == 0 && written;
+}
+
+bool fixture_load_file(const char* path, Byte** data, Size* size)
+{
+  FILE* file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  *size = (Size)ftell(file);
+  fseek(file, 0, SEEK_SET);
+  *data = malloc(*size > 0 ? *size : 1);
+  bool loaded = *data != NULL && fread(*data, 1, *size, file) == *size;
+  fclose(file);
+  return loaded;
+}
+
+Result fixture_build_archive(const FixtureArchive* archive, const char* path,
+                             const char* source)
+{
+  CompressedArchiveBuilder* builder = compressed_archive_builder_create(path);
+  if (builder == NULL)
+  {
+    return RESULT_ERROR;
+  }
+
+  Result result =
+    compressed_archive_builder_set_algorithm(builder, archive->algorithm);
+  if (result == RESULT_OK && archive->secondary_algorithm != NULL)
+  {
+    result = compressed_archive_builder_set_secondary_algorithm(
+      builder, archive->secondary_algorithm);
+    if (result == RESULT_OK)
+    {
+      result = compressed_archive_builder_set_two_staged(builder, true);
+    }
+  }
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_builder_set_dedup(builder, archive->dedup);
+  }
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_builder_set_solid_block_size(
+      builder, archive->solid_block_size);
+  }
+  if (result == RESULT_OK && archive->volume_size > 0)
+  {
+    result =
+      compressed_archive_builder_set_volume_size(builder, archive->volume_size);
+  }
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_builder_add_directory(builder, source);
+  }
+  if (result == RESULT_OK)
+  {
+    result = compressed_archive_builder_finalize(builder);
+  }
+
+  compressed_archive_builder_destroy(builder);
+  return result;
+}
@@ -0,0 +1,31 @@
+#ifndef TESTS_FIXTURE_H
+#define TESTS_FIXTURE_H
+
+#include <stdbool.h>
+
+#include "types.h"
+
+// Параметры тестового архива; нулевые поля - значения по умолчанию
+typedef struct
+{
+  const char* algorithm;
+  const char* secondary_algorithm;  // NULL - одноэтапное сжатие
+  bool dedup;
+  Size solid_block_size;
+  QWord volume_size;
+} FixtureArchive;
+
+// Рабочий каталог теста во временном каталоге (TMPDIR или /tmp); тест
+// переходит в него, а fixture_leave удаляет его со всем содержимым
+bool fixture_enter(const char* name, char* directory, Size directory_size);
+void fixture_leave(const char* directory);
+
+bool fixture_write_file(const char* path, const Byte* data, Size size);
+// Содержимое файла целиком; освобождается вызывающим
+bool fixture_load_file(const char* path, Byte** data, Size* size);
+
+// Архив path из всех файлов каталога source
+Result fixture_build_archive(const FixtureArchive* archive, const char* path,
+                             const char* source);
+
+#endif  // TESTS_FIXTURE_H
@@ -0,0 +1,272 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "block_cache.h"
+#include "compressed_archive_header.h"
+#include "compressed_archive_reader.h"
+#include "fixture.h"
+#include "log.h"
+#include "stats.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+#define TEXT_SIZE (200 * 1024 + 77)
+#define SPARSE_EXTENT (8 * 1024)
+#define SPARSE_HOLE (256 * 1024)
+#define SMALL_FILES 24
+#define RANDOM_RANGES 64
+#define CACHE_LIMIT (2 * TWO_STAGE_CHUNK_SIZE + 1024)
+
+typedef struct
+{
+  const char* name;
+  FixtureArchive archive;
+} ArchiveCase;
+
+typedef struct
+{
+  Byte* data;
+  Size size;
+} Reference;
+
+static DWord random_state = 2463534242U;
+
+static DWord next_random(void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+// Сжимаемый текст: слова из небольшого словаря в случайном порядке
+static void fill_text(Byte* data, Size size)
+{
+  static const char* words[] = {"archive ", "block ",  "volume ", "extent ",
+                                "range ",   "cache ",  "frame ",  "hole ",
+                                "solid ",   "stored ", "\n"};
+  Size position = 0;
+  while (position < size)
+  {
+    const char* word = words[next_random() % (sizeof(words) / sizeof(*words))];
+    for (Size i = 0; word[i] != '\0' && position < size; i++)
+    {
+      data[position++] = (Byte)word[i];
+    }
+  }
+}
+
+// Три области данных, разделенные дырами, и дыра в конце файла
+static bool write_sparse_file(const char* path, const Byte* text)
+{
+  int descriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (descriptor < 0)
+  {
+    return false;
+  }
+
+  bool written = true;
+  for (int i = 0; i < 3 && written; i++)
+  {
+    off_t offset = (off_t)i * (SPARSE_EXTENT + SPARSE_HOLE);
+    written = pwrite(descriptor, text + i * SPARSE_EXTENT, SPARSE_EXTENT,
+                     offset) == SPARSE_EXTENT;
+  }
+  written = written && ftruncate(descriptor, 3 * (off_t)(SPARSE_EXTENT +
+                                                         SPARSE_HOLE)) == 0;
+  return close(descriptor) == 0 && written;
+}
+
+static bool create_sources(const Byte* text)
+{
+  if (mkdir("src", 0755) != 0 ||
+      !fixture_write_file("src/text", text, TEXT_SIZE) ||
+      !fixture_write_file("src/copy", text, TEXT_SIZE) ||
+      !write_sparse_file("src/sparse", text))
+  {
+    return false;
+  }
+
+  for (int i = 0; i < SMALL_FILES; i++)
+  {
+    char path[32];
+    snprintf(path, sizeof(path), "src/small%02d", i);
+    if (!fixture_write_file(path, text + i * 1000, 100 + (Size)i * 37))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void check_range(CompressedArchiveReader* reader, DWord index,
+                        const Reference* reference, QWord offset, Size length,
+                        Byte* buffer)
+{
+  memset(buffer, 0xAA, length);
+  Result result =
+    compressed_archive_reader_read_range(reader, index, offset, length, buffer);
+  if (result != RESULT_OK ||
+      memcmp(buffer, reference->data + offset, length) != 0)
+  {
+    fprintf(stderr, "%s: диапазон [%llu, +%zu) прочитан неверно\n",
+            compressed_archive_reader_get_filename(reader, index),
+            (unsigned long long)offset, length);
+    test_failures++;
+  }
+}
+
+static void check_entry(CompressedArchiveReader* reader, DWord index,
+                        const Reference* reference, Byte* buffer)
+{
+  Size size = reference->size;
+  TEST_CHECK(compressed_archive_reader_get_file_size(reader, index) == size);
+
+  check_range(reader, index, reference, 0, size, buffer);
+
+  // Диапазоны через границы кадров двухэтапной записи
+  for (Size edge = TWO_STAGE_CHUNK_SIZE; edge < size;
+       edge += TWO_STAGE_CHUNK_SIZE)
+  {
+    check_range(reader, index, reference, edge - 3, size - edge < 3 ? 3 : 6,
+                buffer);
+    check_range(reader, index, reference, edge - 1, 1, buffer);
+    check_range(reader, index, reference, edge, 1, buffer);
+  }
+
+  // Внутри дыры, через ее начало и через ее конец, хвостовая дыра
+  if (size == 3 * (SPARSE_EXTENT + SPARSE_HOLE))
+  {
+    check_range(reader, index, reference, SPARSE_EXTENT + 1000, 4096, buffer);
+    check_range(reader, index, reference, SPARSE_EXTENT - 10, 20, buffer);
+    check_range(reader, index, reference, SPARSE_EXTENT + SPARSE_HOLE - 10,
+                20, buffer);
+    check_range(reader, index, reference, size - 100, 100, buffer);
+  }
+
+  for (int i = 0; i < RANDOM_RANGES && size > 0; i++)
+  {
+    QWord offset = next_random() % size;
+    Size length = (Size)(next_random() % (size - offset) % 70000) + 1;
+    check_range(reader, index, reference, offset, length, buffer);
+  }
+
+  // Пустой диапазон допустим в любой точке файла, включая его конец
+  TEST_CHECK(compressed_archive_reader_read_range(reader, index, 0, 0,
+                                                  buffer) == RESULT_OK);
+  TEST_CHECK(compressed_archive_reader_read_range(reader, index, size, 0,
+                                                  NULL) == RESULT_OK);
+
+  // Диапазон за концом файла - ошибка
+  TEST_CHECK(compressed_archive_reader_read_range(reader, index, size + 1, 0,
+                                                  buffer) != RESULT_OK);
+  TEST_CHECK(compressed_archive_reader_read_range(reader, index, size, 1,
+                                                  buffer) != RESULT_OK);
+  if (size > 0)
+  {
+    TEST_CHECK(compressed_archive_reader_read_range(
+                 reader, index, size - 1, 2, buffer) != RESULT_OK);
+  }
+}
+
+// cache == NULL - читатель держит только последний блок
+static void check_archive(const char* path, BlockCache* cache, Stats* stats,
+                          Byte* buffer)
+{
+  CompressedArchiveReader* reader = compressed_archive_reader_create(path);
+  TEST_CHECK(reader != NULL);
+  if (reader == NULL)
+  {
+    return;
+  }
+  if (cache != NULL)
+  {
+    TEST_CHECK(compressed_archive_reader_set_block_cache(reader, cache) ==
+               RESULT_OK);
+    TEST_CHECK(compressed_archive_reader_set_stats(reader, stats) ==
+               RESULT_OK);
+  }
+
+  DWord count = compressed_archive_reader_get_file_count(reader);
+  TEST_CHECK(count == SMALL_FILES + 3);
+  for (DWord i = 0; i < count; i++)
+  {
+    Reference reference;
+    const char* filename = compressed_archive_reader_get_filename(reader, i);
+    if (!fixture_load_file(filename, &reference.data, &reference.size))
+    {
+      fprintf(stderr, "%s: не удалось прочитать исходный файл\n", filename);
+      test_failures++;
+      continue;
+    }
+    check_entry(reader, i, &reference, buffer);
+    free(reference.data);
+  }
+
+  TEST_CHECK(compressed_archive_reader_read_range(reader, count, 0, 0,
+                                                  buffer) != RESULT_OK);
+  compressed_archive_reader_destroy(reader);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  char directory[256];
+  Byte* text = malloc(TEXT_SIZE);
+  Byte* buffer = malloc(3 * (SPARSE_EXTENT + SPARSE_HOLE));
+  if (text == NULL || buffer == NULL ||
+      !fixture_enter("range_read_test", directory, sizeof(directory)))
+  {
+    fprintf(stderr, "Не удалось подготовить рабочий каталог\n");
+    return 1;
+  }
+
+  fill_text(text, TEXT_SIZE);
+  TEST_CHECK(create_sources(text));
+
+  const ArchiveCase cases[] = {
+    {"none", {"none", NULL, false, 0, 0}},
+    {"huffman", {"huffman", NULL, false, 0, 0}},
+    {"two-staged", {"huffman", "lz77", false, 0, 0}},
+    {"dedup-solid", {"lzh", NULL, true, 4096, 0}},
+  };
+
+  for (Size i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    char path[64];
+    snprintf(path, sizeof(path), "%s.arc", cases[i].name);
+    if (fixture_build_archive(&cases[i].archive, path, "src") != RESULT_OK)
+    {
+      fprintf(stderr, "%s: не удалось построить архив\n", cases[i].name);
+      test_failures++;
+      continue;
+    }
+    check_archive(path, NULL, NULL, buffer);
+
+    // Кэш на пару кадров: блоки постоянно вытесняются и читаются заново
+    BlockCache* cache = block_cache_create(CACHE_LIMIT);
+    Stats* stats = stats_create();
+    TEST_CHECK(cache != NULL && stats != NULL);
+    check_archive(path, cache, stats, buffer);
+    if (cases[i].archive.secondary_algorithm != NULL)
+    {
+      TEST_CHECK(stats_get_counter(stats, "block_cache_hits") > 0);
+      TEST_CHECK(stats_get_counter(stats, "block_cache_evictions") > 0);
+    }
+    stats_destroy(stats);
+    block_cache_destroy(cache);
+  }
+
+  fixture_leave(directory);
+  free(buffer);
+  free(text);
+  return TEST_EXIT();
+}
@@ -0,0 +1,243 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "compressed_archive_reader.h"
+#include "fixture.h"
+#include "log.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+// Двенадцать файлов по 3000 байт в блоках по 16 КиБ: блоки по пять, пять
+// и две записи. Несжатый архив блоков не строит
+#define MEMBER_SIZE 3000
+#define MEMBER_COUNT 12
+#define BLOCK_SIZE (16 * 1024)
+#define BLOCK_MEMBERS 5
+#define BLOCK_COUNT 3
+// DWord первая запись, DWord число записей и три QWord
+#define BLOCK_RECORD_SIZE (2 * sizeof(DWord) + 3 * sizeof(QWord))
+
+static void fill_member(Byte* data, int member)
+{
+  static const char* words[] = {"solid ", "block ", "member ", "entry ",
+                                "stream ", "\n"};
+  Size position = 0;
+  for (DWord word = (DWord)member; position < MEMBER_SIZE;
+       word = word * 7 + 3)
+  {
+    const char* text = words[word % 6];
+    for (Size i = 0; text[i] != '\0' && position < MEMBER_SIZE; i++)
+    {
+      data[position++] = (Byte)text[i];
+    }
+  }
+}
+
+static bool create_sources(void)
+{
+  if (mkdir("src", 0755) != 0)
+  {
+    return false;
+  }
+
+  Byte data[MEMBER_SIZE];
+  for (int i = 0; i < MEMBER_COUNT; i++)
+  {
+    char path[32];
+    snprintf(path, sizeof(path), "src/member%02d", i);
+    fill_member(data, i);
+    if (!fixture_write_file(path, data, sizeof(data)))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void check_entry(CompressedArchiveReader* reader, DWord index)
+{
+  const char* filename = compressed_archive_reader_get_filename(reader, index);
+  Byte* expected = NULL;
+  Byte* actual = NULL;
+  Size expected_size = 0;
+  Size actual_size = 0;
+  TEST_CHECK(fixture_load_file(filename, &expected, &expected_size));
+  TEST_CHECK(compressed_archive_reader_extract_file(reader, index, "out") ==
+             RESULT_OK);
+  if (!fixture_load_file("out", &actual, &actual_size) ||
+      actual_size != expected_size ||
+      memcmp(actual, expected, expected_size) != 0)
+  {
+    fprintf(stderr, "%s: извлеченные данные не совпадают\n", filename);
+    test_failures++;
+  }
+
+  Byte range[100];
+  TEST_CHECK(compressed_archive_reader_read_range(
+               reader, index, MEMBER_SIZE - sizeof(range), sizeof(range),
+               range) == RESULT_OK);
+  TEST_CHECK(expected != NULL &&
+             memcmp(range, expected + MEMBER_SIZE - sizeof(range),
+                    sizeof(range)) == 0);
+
+  free(actual);
+  free(expected);
+}
+
+static void test_round_trip(const FixtureArchive* archive)
+{
+  if (fixture_build_archive(archive, "solid.arc", "src") != RESULT_OK)
+  {
+    fprintf(stderr, "%s: не удалось построить архив\n", archive->algorithm);
+    test_failures++;
+    return;
+  }
+
+  CompressedArchiveReader* reader =
+    compressed_archive_reader_create("solid.arc");
+  TEST_CHECK(reader != NULL);
+  if (reader == NULL)
+  {
+    return;
+  }
+
+  DWord count = compressed_archive_reader_get_file_count(reader);
+  TEST_CHECK(count == MEMBER_COUNT);
+  // Первая единица распаковки - весь первый блок
+  TEST_CHECK(compressed_archive_reader_get_unit_end(reader, 0) ==
+             BLOCK_MEMBERS);
+  for (DWord i = 0; i < count; i++)
+  {
+    QWord tested = 0;
+    TEST_CHECK(compressed_archive_reader_test_file(reader, i, &tested) ==
+               RESULT_OK);
+    TEST_CHECK(tested == MEMBER_SIZE);
+    check_entry(reader, i);
+  }
+
+  compressed_archive_reader_destroy(reader);
+}
+
+// Таблица блоков: число блоков, затем первый блок (0, BLOCK_MEMBERS) с
+// размером данных BLOCK_MEMBERS * MEMBER_SIZE
+static Byte* find_block_table(Byte* archive, Size size)
+{
+  const DWord head[] = {BLOCK_COUNT, 0, BLOCK_MEMBERS};
+  const QWord data_size = BLOCK_MEMBERS * MEMBER_SIZE;
+  Size table_size = sizeof(DWord) + BLOCK_COUNT * BLOCK_RECORD_SIZE;
+  for (Size i = 0; i + table_size <= size; i++)
+  {
+    if (memcmp(archive + i, head, sizeof(head)) == 0 &&
+        memcmp(archive + i + sizeof(DWord) + BLOCK_RECORD_SIZE -
+                 sizeof(QWord),
+               &data_size, sizeof(QWord)) == 0)
+    {
+      return archive + i;
+    }
+  }
+  return NULL;
+}
+
+typedef enum
+{
+  CORRUPT_DATA_SIZE,
+  CORRUPT_EMPTY_BLOCK,
+  CORRUPT_FIRST_ENTRY,
+  CORRUPT_OVERLAP,
+} Corruption;
+
+static void corrupt_table(Byte* table, Corruption corruption)
+{
+  Byte* first = table + sizeof(DWord);
+  Byte* second = first + BLOCK_RECORD_SIZE;
+  DWord word = 0;
+  QWord value = BLOCK_MEMBERS * MEMBER_SIZE + 1;
+  switch (corruption)
+  {
+    case CORRUPT_DATA_SIZE:
+      memcpy(first + BLOCK_RECORD_SIZE - sizeof(QWord), &value,
+             sizeof(value));
+      break;
+    case CORRUPT_EMPTY_BLOCK:
+      memcpy(second + sizeof(DWord), &word, sizeof(word));
+      break;
+    case CORRUPT_FIRST_ENTRY:
+      word = MEMBER_COUNT;
+      memcpy(second, &word, sizeof(word));
+      break;
+    case CORRUPT_OVERLAP:
+      word = BLOCK_MEMBERS - 1;
+      memcpy(second, &word, sizeof(word));
+      break;
+  }
+}
+
+static void test_corrupt_tables(void)
+{
+  const FixtureArchive archive = {"huffman", NULL, false, BLOCK_SIZE, 0};
+  Byte* original = NULL;
+  Size size = 0;
+  if (fixture_build_archive(&archive, "solid.arc", "src") != RESULT_OK ||
+      !fixture_load_file("solid.arc", &original, &size))
+  {
+    TEST_CHECK(false);
+    free(original);
+    return;
+  }
+
+  Byte* table = find_block_table(original, size);
+  Byte* copy = malloc(size);
+  TEST_CHECK(table != NULL && copy != NULL);
+  for (int corruption = CORRUPT_DATA_SIZE;
+       table != NULL && copy != NULL && corruption <= CORRUPT_OVERLAP;
+       corruption++)
+  {
+    memcpy(copy, original, size);
+    corrupt_table(copy + (table - original), (Corruption)corruption);
+    TEST_CHECK(fixture_write_file("corrupt.arc", copy, size));
+
+    CompressedArchiveReader* reader =
+      compressed_archive_reader_create("corrupt.arc");
+    if (reader != NULL)
+    {
+      fprintf(stderr, "Повреждение %d: архив открыт\n", corruption);
+      test_failures++;
+      compressed_archive_reader_destroy(reader);
+    }
+  }
+
+  free(copy);
+  free(original);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  char directory[256];
+  if (!fixture_enter("solid_test", directory, sizeof(directory)))
+  {
+    fprintf(stderr, "Не удалось подготовить рабочий каталог\n");
+    return 1;
+  }
+  TEST_CHECK(create_sources());
+
+  const FixtureArchive archives[] = {
+    {"huffman", NULL, false, BLOCK_SIZE, 0},
+    {"lzh", NULL, false, BLOCK_SIZE, 0},
+    {"huffman", "lz77", false, BLOCK_SIZE, 0},
+  };
+  for (Size i = 0; i < sizeof(archives) / sizeof(archives[0]); i++)
+  {
+    test_round_trip(&archives[i]);
+  }
+  test_corrupt_tables();
+
+  fixture_leave(directory);
+  return TEST_EXIT();
+}
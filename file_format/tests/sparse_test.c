@@ -0,0 +1,250 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compressed_archive_reader.h"
+#include "fixture.h"
+#include "log.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+#define EXTENT_SIZE (16 * 1024)
+#define HOLE_SIZE (512 * 1024)
+#define EXTENT_COUNT 3
+#define LOGICAL_SIZE ((QWord)EXTENT_COUNT * (EXTENT_SIZE + HOLE_SIZE))
+// QWord полный размер, DWord число областей и пары QWord на область
+#define MAP_SIZE (sizeof(QWord) + sizeof(DWord) + EXTENT_COUNT * 16)
+
+static void fill_extent(Byte* data, Size size, DWord seed)
+{
+  for (Size i = 0; i < size; i++)
+  {
+    data[i] = (Byte)("sparse extent "[(i + seed) % 14] ^ (i / 97));
+  }
+}
+
+// Области с данными, разделенные дырами, и дыра в конце файла. Первые две
+// области одинаковы, чтобы при дедупликации карта была и у повторов
+static bool write_sparse_file(const char* path)
+{
+  int descriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (descriptor < 0)
+  {
+    return false;
+  }
+
+  Byte extent[EXTENT_SIZE];
+  bool written = true;
+  for (int i = 0; i < EXTENT_COUNT && written; i++)
+  {
+    fill_extent(extent, sizeof(extent), i == 2 ? 5 : 0);
+    off_t offset = (off_t)i * (EXTENT_SIZE + HOLE_SIZE);
+    written = pwrite(descriptor, extent, sizeof(extent), offset) ==
+              (ssize_t)sizeof(extent);
+  }
+  written = written && ftruncate(descriptor, (off_t)LOGICAL_SIZE) == 0;
+  return close(descriptor) == 0 && written;
+}
+
+static void check_same_file(const char* expected_path, const char* path)
+{
+  Byte* expected = NULL;
+  Byte* actual = NULL;
+  Size expected_size = 0;
+  Size actual_size = 0;
+  bool loaded = fixture_load_file(expected_path, &expected, &expected_size) &&
+                fixture_load_file(path, &actual, &actual_size);
+  if (!loaded || expected_size != actual_size ||
+      memcmp(expected, actual, expected_size) != 0)
+  {
+    fprintf(stderr, "%s: содержимое не совпадает с %s\n", path,
+            expected_path);
+    test_failures++;
+  }
+  free(actual);
+  free(expected);
+}
+
+static void test_round_trip(const FixtureArchive* archive)
+{
+  if (fixture_build_archive(archive, "sparse.arc", "src") != RESULT_OK)
+  {
+    fprintf(stderr, "%s: не удалось построить архив\n", archive->algorithm);
+    test_failures++;
+    return;
+  }
+
+  CompressedArchiveReader* reader =
+    compressed_archive_reader_create("sparse.arc");
+  TEST_CHECK(reader != NULL);
+  if (reader == NULL)
+  {
+    return;
+  }
+
+  DWord count = compressed_archive_reader_get_file_count(reader);
+  TEST_CHECK(count == 2);
+  for (DWord i = 0; i < count; i++)
+  {
+    const char* filename = compressed_archive_reader_get_filename(reader, i);
+    if (strcmp(filename, "src/sparse") == 0)
+    {
+      TEST_CHECK(compressed_archive_reader_get_file_size(reader, i) ==
+                 LOGICAL_SIZE);
+    }
+    TEST_CHECK(compressed_archive_reader_extract_file(reader, i, "out") ==
+               RESULT_OK);
+    check_same_file(filename, "out");
+  }
+
+  compressed_archive_reader_destroy(reader);
+}
+
+// Карта ищется по полному размеру и числу областей, за которыми идет
+// первая область (0, EXTENT_SIZE)
+static Byte* find_sparse_map(Byte* archive, Size size)
+{
+  Byte pattern[sizeof(QWord) + sizeof(DWord) + 2 * sizeof(QWord)];
+  QWord logical_size = LOGICAL_SIZE;
+  DWord extent_count = EXTENT_COUNT;
+  QWord first_offset = 0;
+  QWord first_length = EXTENT_SIZE;
+  memcpy(pattern, &logical_size, sizeof(QWord));
+  memcpy(pattern + 8, &extent_count, sizeof(DWord));
+  memcpy(pattern + 12, &first_offset, sizeof(QWord));
+  memcpy(pattern + 20, &first_length, sizeof(QWord));
+
+  for (Size i = 0; i + MAP_SIZE <= size; i++)
+  {
+    if (memcmp(archive + i, pattern, sizeof(pattern)) == 0)
+    {
+      return archive + i;
+    }
+  }
+  return NULL;
+}
+
+static QWord* extent_field(Byte* map, DWord extent, DWord field)
+{
+  return (QWord*)(map + sizeof(QWord) + sizeof(DWord) + extent * 16 +
+                  field * sizeof(QWord));
+}
+
+typedef enum
+{
+  CORRUPT_OVERLAP,
+  CORRUPT_PAST_END,
+  CORRUPT_SIZE_MISMATCH,
+  CORRUPT_ZERO_LENGTH,
+  CORRUPT_EXTENT_COUNT,
+} Corruption;
+
+static void corrupt_map(Byte* map, Corruption corruption)
+{
+  QWord value = 0;
+  switch (corruption)
+  {
+    case CORRUPT_OVERLAP:
+      value = EXTENT_SIZE / 2;
+      memcpy(extent_field(map, 1, 0), &value, sizeof(value));
+      break;
+    case CORRUPT_PAST_END:
+      value = LOGICAL_SIZE;
+      memcpy(extent_field(map, 2, 0), &value, sizeof(value));
+      break;
+    case CORRUPT_SIZE_MISMATCH:
+      value = EXTENT_SIZE + 1;
+      memcpy(extent_field(map, 2, 1), &value, sizeof(value));
+      break;
+    case CORRUPT_ZERO_LENGTH:
+      memcpy(extent_field(map, 1, 1), &value, sizeof(value));
+      break;
+    case CORRUPT_EXTENT_COUNT:
+      memset(map + sizeof(QWord), 0xFF, sizeof(DWord));
+      break;
+  }
+}
+
+// Поврежденная карта отвергается при открытии архива, а не приводит к
+// чтению за пределами распакованных данных при извлечении
+static void test_corrupt_maps(void)
+{
+  const FixtureArchive archive = {"none", NULL, false, 0, 0};
+  Byte* original = NULL;
+  Size size = 0;
+  if (fixture_build_archive(&archive, "sparse.arc", "src") != RESULT_OK ||
+      !fixture_load_file("sparse.arc", &original, &size))
+  {
+    TEST_CHECK(false);
+    free(original);
+    return;
+  }
+
+  Size map_offset = 0;
+  Byte* map = find_sparse_map(original, size);
+  TEST_CHECK(map != NULL);
+  if (map != NULL)
+  {
+    map_offset = (Size)(map - original);
+  }
+
+  Byte* copy = malloc(size);
+  for (int corruption = CORRUPT_OVERLAP;
+       map != NULL && copy != NULL && corruption <= CORRUPT_EXTENT_COUNT;
+       corruption++)
+  {
+    memcpy(copy, original, size);
+    corrupt_map(copy + map_offset, (Corruption)corruption);
+    TEST_CHECK(fixture_write_file("corrupt.arc", copy, size));
+
+    CompressedArchiveReader* reader =
+      compressed_archive_reader_create("corrupt.arc");
+    if (reader != NULL)
+    {
+      fprintf(stderr, "Повреждение %d: архив открыт\n", corruption);
+      test_failures++;
+      compressed_archive_reader_destroy(reader);
+    }
+  }
+
+  free(copy);
+  free(original);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  char directory[256];
+  if (!fixture_enter("sparse_test", directory, sizeof(directory)))
+  {
+    fprintf(stderr, "Не удалось подготовить рабочий каталог\n");
+    return 1;
+  }
+
+  Byte plain[EXTENT_SIZE];
+  fill_extent(plain, sizeof(plain), 0);
+  TEST_CHECK(mkdir("src", 0755) == 0);
+  TEST_CHECK(write_sparse_file("src/sparse"));
+  TEST_CHECK(fixture_write_file("src/plain", plain, sizeof(plain)));
+
+  const FixtureArchive archives[] = {
+    {"none", NULL, false, 0, 0},
+    {"huffman", NULL, false, 0, 0},
+    {"lzh", NULL, true, 0, 0},
+  };
+  for (Size i = 0; i < sizeof(archives) / sizeof(archives[0]); i++)
+  {
+    test_round_trip(&archives[i]);
+  }
+  test_corrupt_maps();
+
+  fixture_leave(directory);
+  return TEST_EXIT();
+}
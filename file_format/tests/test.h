@@ -0,0 +1,23 @@
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+#include <stdio.h>
+
+// Проверка без прерывания: тест досчитывает до конца и сообщает обо всех
+// несовпадениях, итог - через TEST_EXIT
+extern int test_failures;
+
+#define TEST_CHECK(condition)                                       \
+  do                                                                \
+  {                                                                 \
+    if (!(condition))                                               \
+    {                                                               \
+      fprintf(stderr, "%s:%d: не выполнено: %s\n", __FILE__,       \
+              __LINE__, #condition);                                \
+      test_failures++;                                              \
+    }                                                               \
+  } while (0)
+
+#define TEST_EXIT() (test_failures == 0 ? 0 : 1)
+
+#endif  // TESTS_TEST_H
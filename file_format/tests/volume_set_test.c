@@ -0,0 +1,177 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compressed_archive_reader.h"
+#include "file.h"
+#include "fixture.h"
+#include "log.h"
+#include "test.h"
+#include "types.h"
+
+int test_failures = 0;
+
+// Томов в каждом наборе в разы больше, чем доступно дескрипторов
+#define DESCRIPTOR_LIMIT 32
+#define FILE_VOLUME_SIZE 512
+#define FILE_DATA_SIZE (300 * 1024)
+#define ARCHIVE_VOLUME_SIZE 4096
+#define ARCHIVE_DATA_SIZE (600 * 1024 + 123)
+#define HEADER_SIZE 16
+
+static Byte pattern_at(QWord position)
+{
+  return (Byte)(position * 131 + position / 7);
+}
+
+static void fill_pattern(Byte* data, Size size)
+{
+  for (Size i = 0; i < size; i++)
+  {
+    data[i] = pattern_at(i);
+  }
+}
+
+// Запись кусками через границы томов и правка заголовка в первом томе
+// после того, как он давно закрыт
+static void write_volume_file(const Byte* data, const Byte* header)
+{
+  File* file = file_create("data");
+  TEST_CHECK(file != NULL);
+  TEST_CHECK(file_open_for_write(file) == RESULT_OK);
+  TEST_CHECK(file_split_volumes(file, FILE_VOLUME_SIZE) == RESULT_OK);
+
+  for (Size position = 0; position < FILE_DATA_SIZE; position += 1000)
+  {
+    Size part = FILE_DATA_SIZE - position < 1000 ? FILE_DATA_SIZE - position
+                                                 : 1000;
+    TEST_CHECK(file_write_bytes(file, data + position, part) == RESULT_OK);
+  }
+
+  TEST_CHECK(file_seek(file, 0, SEEK_SET) == RESULT_OK);
+  TEST_CHECK(file_write_bytes(file, header, HEADER_SIZE) == RESULT_OK);
+  TEST_CHECK(file_seek(file, 0, SEEK_END) == RESULT_OK);
+  TEST_CHECK(file_close(file) == RESULT_OK);
+  file_destroy(file);
+}
+
+static void test_file_volumes(void)
+{
+  Byte* data = malloc(FILE_DATA_SIZE);
+  Byte* buffer = malloc(FILE_DATA_SIZE);
+  if (data == NULL || buffer == NULL)
+  {
+    TEST_CHECK(false);
+    return;
+  }
+  fill_pattern(data, FILE_DATA_SIZE);
+
+  Byte header[HEADER_SIZE];
+  memset(header, 0x5A, sizeof(header));
+  write_volume_file(data, header);
+  memcpy(data, header, sizeof(header));
+
+  File* file = file_create("data");
+  TEST_CHECK(file != NULL);
+  TEST_CHECK(file_open_for_read_volumes(file) == RESULT_OK);
+  TEST_CHECK(file_get_volume_count(file) ==
+             (FILE_DATA_SIZE + FILE_VOLUME_SIZE - 1) / FILE_VOLUME_SIZE);
+
+  // Целиком - параллельными порциями, затем короткие участки через границы
+  TEST_CHECK(file_read_at(file, buffer, FILE_DATA_SIZE, 0) == RESULT_OK);
+  TEST_CHECK(memcmp(buffer, data, FILE_DATA_SIZE) == 0);
+  for (QWord edge = FILE_VOLUME_SIZE; edge < FILE_DATA_SIZE;
+       edge += 37 * FILE_VOLUME_SIZE)
+  {
+    TEST_CHECK(file_read_at(file, buffer, 10, edge - 5) == RESULT_OK);
+    TEST_CHECK(memcmp(buffer, data + edge - 5, 10) == 0);
+  }
+  TEST_CHECK(file_read_at(file, buffer, 1, FILE_DATA_SIZE) != RESULT_OK);
+
+  TEST_CHECK(file_close(file) == RESULT_OK);
+  file_destroy(file);
+  free(buffer);
+  free(data);
+}
+
+static void test_archive_volumes(const char* algorithm, const Byte* data,
+                                 Byte* buffer)
+{
+  const FixtureArchive archive = {algorithm, NULL, false, 0,
+                                  ARCHIVE_VOLUME_SIZE};
+  if (fixture_build_archive(&archive, "arc", "src") != RESULT_OK)
+  {
+    fprintf(stderr, "%s: не удалось построить архив\n", algorithm);
+    test_failures++;
+    return;
+  }
+
+  CompressedArchiveReader* reader = compressed_archive_reader_create("arc");
+  TEST_CHECK(reader != NULL);
+  if (reader == NULL)
+  {
+    return;
+  }
+
+  TEST_CHECK(compressed_archive_reader_verify_header(reader) == RESULT_OK);
+  DWord count = compressed_archive_reader_get_file_count(reader);
+  TEST_CHECK(count == 2);
+  for (DWord i = 0; i < count; i++)
+  {
+    QWord size = compressed_archive_reader_get_file_size(reader, i);
+    QWord tested = 0;
+    TEST_CHECK(compressed_archive_reader_test_file(reader, i, &tested) ==
+               RESULT_OK);
+    TEST_CHECK(tested == size);
+    TEST_CHECK(compressed_archive_reader_read_range(reader, i, 0, (Size)size,
+                                                    buffer) == RESULT_OK);
+    TEST_CHECK(memcmp(buffer, data, (Size)size) == 0);
+  }
+
+  compressed_archive_reader_destroy(reader);
+}
+
+int main(void)
+{
+  log_set_level(LOG_LEVEL_OFF);
+
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+  {
+    return 1;
+  }
+  limit.rlim_cur = DESCRIPTOR_LIMIT;
+  if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+  {
+    fprintf(stderr, "Не удалось ограничить число дескрипторов\n");
+    return 1;
+  }
+
+  char directory[256];
+  Byte* data = malloc(ARCHIVE_DATA_SIZE);
+  Byte* buffer = malloc(ARCHIVE_DATA_SIZE);
+  if (data == NULL || buffer == NULL ||
+      !fixture_enter("volume_set_test", directory, sizeof(directory)))
+  {
+    fprintf(stderr, "Не удалось подготовить рабочий каталог\n");
+    return 1;
+  }
+
+  test_file_volumes();
+
+  fill_pattern(data, ARCHIVE_DATA_SIZE);
+  TEST_CHECK(mkdir("src", 0755) == 0);
+  TEST_CHECK(fixture_write_file("src/large", data, ARCHIVE_DATA_SIZE));
+  TEST_CHECK(fixture_write_file("src/small", data, 5000));
+  test_archive_volumes("none", data, buffer);
+  test_archive_volumes("huffman", data, buffer);
+
+  fixture_leave(directory);
+  free(buffer);
+  free(data);
+  return TEST_EXIT();
+}